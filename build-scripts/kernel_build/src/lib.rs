@@ -6,6 +6,7 @@ mod cfiles;
 mod constant;
 mod kconfig;
 mod utils;
+mod vdso;
 mod version_gen;
 
 /// 运行构建
@@ -14,5 +15,6 @@ pub fn run() {
 
     crate::cfiles::CFilesBuilder::build();
     crate::kconfig::KConfigBuilder::build();
+    crate::vdso::VdsoBuilder::build();
     crate::version_gen::generate_version();
 }
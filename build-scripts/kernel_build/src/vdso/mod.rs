@@ -0,0 +1,69 @@
+use std::{env, path::PathBuf, process::Command};
+
+use crate::utils::cargo_handler::{CargoHandler, TargetArch};
+
+/// vDSO源码所在目录
+const VDSO_SRC_DIR: &str = "src/arch/x86_64/vdso";
+/// 参与编译的C源文件
+const VDSO_SOURCES: [&str; 2] = ["vclock_gettime.c", "vgetcpu.c"];
+
+/// 构建vDSO镜像
+///
+/// vDSO是一个独立的共享对象，不能和内核的C文件一起编译成静态库，因此这里直接调用C编译器链接，
+/// 产物的路径通过环境变量`DRAGONOS_VDSO_IMAGE`交给内核用`include_bytes!`嵌入。
+/// 目前只有x86_64提供vDSO。
+pub struct VdsoBuilder;
+
+impl VdsoBuilder {
+    pub fn build() {
+        if CargoHandler::target_arch() != TargetArch::X86_64 {
+            return;
+        }
+
+        let src_dir = PathBuf::from(VDSO_SRC_DIR);
+        let out = PathBuf::from(env::var("OUT_DIR").unwrap()).join("vdso.so");
+
+        let mut cmd = cc::Build::new().get_compiler().to_command();
+        cmd.args([
+            "-m64",
+            "-O2",
+            "-fPIC",
+            "-shared",
+            "-nostdlib",
+            "-ffreestanding",
+            "-fno-builtin",
+            "-fno-stack-protector",
+            "-fno-common",
+            "-mcmodel=small",
+            "-fasynchronous-unwind-tables",
+            "-Wall",
+            "-Wno-unused-parameter",
+            "-Wl,-soname=linux-vdso.so.1",
+            "-Wl,--hash-style=both",
+            "-Wl,--eh-frame-hdr",
+            "-Wl,-Bsymbolic",
+            "-Wl,--no-undefined",
+            "-Wl,-z,max-page-size=4096",
+            "-Wl,-z,noexecstack",
+            "-Wl,--build-id=none",
+            "-Wl,-s",
+        ]);
+        cmd.arg(format!("-Wl,-T,{}", src_dir.join("vdso.lds").display()));
+        cmd.arg("-o").arg(&out);
+        for src in VDSO_SOURCES {
+            cmd.arg(src_dir.join(src));
+        }
+
+        let status = cmd.status().expect("failed to run C compiler for vdso");
+        if !status.success() {
+            panic!("failed to build vdso: {:?}", cmd);
+        }
+
+        let mut deps: Vec<PathBuf> = VDSO_SOURCES.iter().map(|s| src_dir.join(s)).collect();
+        deps.push(src_dir.join("vdso.h"));
+        deps.push(src_dir.join("vdso.lds"));
+        CargoHandler::emit_rerun_if_files_changed(&deps);
+
+        println!("cargo:rustc-env=DRAGONOS_VDSO_IMAGE={}", out.display());
+    }
+}
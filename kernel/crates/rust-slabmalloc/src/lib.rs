@@ -9,6 +9,8 @@
 //!  * A `SCAllocator` allocates objects of exactly one size.
 //!    It stores the objects and meta-data in one or multiple `AllocablePage` objects.
 //!  * A trait `AllocablePage` that defines the page-type from which we allocate objects.
+//!  * A `ZoneMagazines` caches free objects of every size class in front of a
+//!    `ZoneAllocator` (one instance per CPU) and moves them in batches.
 //!
 //! Lastly, it provides two default `AllocablePage` implementations `ObjectPage` and `LargeObjectPage`:
 //!  * A `ObjectPage` that is 4 KiB in size and contains allocated objects and associated meta-data.
@@ -27,10 +29,12 @@
 #![allow(clippy::needless_return)]
 extern crate alloc;
 
+mod magazine;
 mod pages;
 mod sc;
 mod zone;
 
+pub use magazine::*;
 pub use pages::*;
 pub use sc::*;
 pub use zone::*;
@@ -0,0 +1,189 @@
+//! Per-CPU object magazines that sit in front of a [`ZoneAllocator`].
+//!
+//! A `Magazine` is a small LIFO stack of free objects of one size class.
+//! The user of this crate keeps one [`ZoneMagazines`] per CPU and serves the
+//! common alloc/free path from it without touching the (shared) zone.
+//! Only when a magazine runs empty or full it is refilled from / drained to
+//! the zone in batches of [`MAGAZINE_BATCH`] objects, so the shared lock
+//! is taken once per batch instead of once per object.
+//!
+//! Objects that live in a magazine are still accounted as allocated by the
+//! zone, so their pages can not be reclaimed until the magazine is drained.
+
+use crate::*;
+
+/// How many objects a single magazine can hold.
+pub const MAGAZINE_CAPACITY: usize = 32;
+
+/// How many objects are moved between a magazine and the zone at once.
+pub const MAGAZINE_BATCH: usize = MAGAZINE_CAPACITY / 2;
+
+/// A fixed-size stack of free objects of exactly one size class.
+pub struct Magazine {
+    objs: [*mut u8; MAGAZINE_CAPACITY],
+    len: usize,
+}
+
+impl Magazine {
+    pub const fn new() -> Magazine {
+        Magazine {
+            objs: [ptr::null_mut(); MAGAZINE_CAPACITY],
+            len: 0,
+        }
+    }
+
+    /// Number of cached objects.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn is_full(&self) -> bool {
+        self.len == MAGAZINE_CAPACITY
+    }
+
+    /// Take the most recently cached (cache-hot) object.
+    pub fn pop(&mut self) -> Option<NonNull<u8>> {
+        if self.len == 0 {
+            return None;
+        }
+        self.len -= 1;
+        NonNull::new(self.objs[self.len])
+    }
+
+    /// Cache a free object, gives it back if the magazine is full.
+    pub fn push(&mut self, ptr: NonNull<u8>) -> Result<(), NonNull<u8>> {
+        if self.is_full() {
+            return Err(ptr);
+        }
+        self.objs[self.len] = ptr.as_ptr();
+        self.len += 1;
+        Ok(())
+    }
+}
+
+/// The cached objects are owned exclusively by the magazine, so it may be
+/// handed to (and drained by) another CPU.
+unsafe impl Send for Magazine {}
+
+impl Default for Magazine {
+    fn default() -> Magazine {
+        Magazine::new()
+    }
+}
+
+/// One magazine for every base size class of a [`ZoneAllocator`].
+pub struct ZoneMagazines {
+    mags: [Magazine; ZoneAllocator::MAX_BASE_SIZE_CLASSES],
+}
+
+impl ZoneMagazines {
+    pub const fn new() -> ZoneMagazines {
+        ZoneMagazines {
+            mags: [const { Magazine::new() }; ZoneAllocator::MAX_BASE_SIZE_CLASSES],
+        }
+    }
+
+    /// Returns the size class a request with `layout` can be served from,
+    /// or `None` if it has to bypass the magazines.
+    ///
+    /// Objects of a class are always aligned to the class size, so any
+    /// object of the class satisfies a request with `align <= class size`.
+    /// Requests with a stricter alignment go to the zone directly.
+    pub fn class_of(layout: Layout) -> Option<usize> {
+        let idx = ZoneAllocator::size_class_index(layout.size())?;
+        if layout.align() > ZoneMagazines::class_size(idx) {
+            return None;
+        }
+        Some(idx)
+    }
+
+    /// Object size of size class `idx`.
+    pub const fn class_size(idx: usize) -> usize {
+        8 << idx
+    }
+
+    /// A layout that addresses exactly one object of size class `idx` in the zone.
+    pub fn class_layout(idx: usize) -> Layout {
+        let size = ZoneMagazines::class_size(idx);
+        unsafe { Layout::from_size_align_unchecked(size, size) }
+    }
+
+    pub fn pop(&mut self, idx: usize) -> Option<NonNull<u8>> {
+        self.mags[idx].pop()
+    }
+
+    pub fn push(&mut self, idx: usize, ptr: NonNull<u8>) -> Result<(), NonNull<u8>> {
+        self.mags[idx].push(ptr)
+    }
+
+    pub fn magazine_mut(&mut self, idx: usize) -> &mut Magazine {
+        &mut self.mags[idx]
+    }
+
+    /// Total bytes held by all magazines.
+    pub fn cached_bytes(&self) -> usize {
+        self.mags
+            .iter()
+            .enumerate()
+            .map(|(idx, mag)| mag.len() * ZoneMagazines::class_size(idx))
+            .sum()
+    }
+}
+
+impl Default for ZoneMagazines {
+    fn default() -> ZoneMagazines {
+        ZoneMagazines::new()
+    }
+}
+
+impl<'a> ZoneAllocator<'a> {
+    /// Moves up to `count` objects of size class `idx` from the zone into `mag`.
+    ///
+    /// Stops early if the zone runs out of memory (the caller may `refill`
+    /// the zone and try again). Returns how many objects were moved.
+    pub fn fill_magazine(&mut self, idx: usize, mag: &mut Magazine, count: usize) -> usize {
+        let layout = ZoneMagazines::class_layout(idx);
+        let mut moved = 0;
+        while moved < count && !mag.is_full() {
+            match self.allocate(layout) {
+                Ok(ptr) => {
+                    let _ = mag.push(ptr);
+                    moved += 1;
+                }
+                Err(_) => break,
+            }
+        }
+        moved
+    }
+
+    /// Returns up to `count` of the coldest objects in `mag` (size class `idx`)
+    /// to the zone, keeping the recently freed (cache-hot) ones cached.
+    ///
+    /// Pages that become empty may be handed back through `slab_callback`.
+    /// Returns how many objects were drained.
+    ///
+    /// # Safety
+    /// All objects in `mag` must have been allocated from this zone.
+    pub unsafe fn drain_magazine(
+        &mut self,
+        idx: usize,
+        mag: &mut Magazine,
+        count: usize,
+        slab_callback: &'static dyn CallBack,
+    ) -> usize {
+        let layout = ZoneMagazines::class_layout(idx);
+        let drained = core::cmp::min(count, mag.len);
+        for obj in mag.objs[..drained].iter() {
+            let ptr = NonNull::new_unchecked(*obj);
+            self.deallocate(ptr, layout, slab_callback)
+                .expect("Couldn't drain magazine");
+        }
+        mag.objs.copy_within(drained..mag.len, 0);
+        mag.len -= drained;
+        drained
+    }
+}
@@ -634,6 +634,95 @@ pub fn issue_9() -> Result<(), AllocationError> {
     Ok(())
 }
 
+#[test]
+pub fn magazine_push_pop_lifo() {
+    let mut mag = Magazine::new();
+    let mut objs = [0u64; MAGAZINE_CAPACITY + 1];
+
+    for obj in objs[..MAGAZINE_CAPACITY].iter_mut() {
+        let ptr = NonNull::new(obj as *mut u64 as *mut u8).unwrap();
+        assert!(mag.push(ptr).is_ok());
+    }
+    assert!(mag.is_full());
+
+    let overflow = NonNull::new(&mut objs[MAGAZINE_CAPACITY] as *mut u64 as *mut u8).unwrap();
+    assert_eq!(mag.push(overflow), Err(overflow));
+
+    for obj in objs[..MAGAZINE_CAPACITY].iter_mut().rev() {
+        assert_eq!(mag.pop().unwrap().as_ptr(), obj as *mut u64 as *mut u8);
+    }
+    assert!(mag.is_empty());
+    assert!(mag.pop().is_none());
+}
+
+#[test]
+pub fn magazine_class_of() {
+    let l = Layout::from_size_align(24, 8).unwrap();
+    assert_eq!(ZoneMagazines::class_of(l), Some(2));
+    assert_eq!(ZoneMagazines::class_size(2), 32);
+
+    // Alignment stricter than the class size bypasses the magazines.
+    let l = Layout::from_size_align(8, 64).unwrap();
+    assert_eq!(ZoneMagazines::class_of(l), None);
+
+    let l = Layout::from_size_align(4096, 8).unwrap();
+    assert_eq!(ZoneMagazines::class_of(l), None);
+}
+
+#[test]
+pub fn magazine_fill_and_drain() -> Result<(), AllocationError> {
+    let _ = env_logger::try_init();
+    let mut pager = Pager::new();
+    let mut zone: ZoneAllocator = Default::default();
+    let mut mags = ZoneMagazines::new();
+
+    let layout = Layout::from_size_align(64, 8).unwrap();
+    let idx = ZoneMagazines::class_of(layout).unwrap();
+
+    // Empty zone: nothing to batch.
+    assert_eq!(
+        zone.fill_magazine(idx, mags.magazine_mut(idx), MAGAZINE_BATCH),
+        0
+    );
+
+    let page = pager.allocate_page().expect("Can't allocate a page");
+    unsafe { zone.refill(layout, page)? };
+    let free_before = zone.free_space();
+
+    let filled = zone.fill_magazine(idx, mags.magazine_mut(idx), MAGAZINE_BATCH);
+    assert_eq!(filled, MAGAZINE_BATCH);
+    assert_eq!(mags.cached_bytes(), MAGAZINE_BATCH * 64);
+    assert_eq!(
+        zone.free_space(),
+        free_before - (MAGAZINE_BATCH * 64) as u64
+    );
+
+    let mut objs = Vec::new();
+    while let Some(ptr) = mags.pop(idx) {
+        assert_eq!(ptr.as_ptr() as usize % 64, 0);
+        objs.push(ptr);
+    }
+    let unique: HashSet<_> = objs.iter().map(|p| p.as_ptr()).collect();
+    assert_eq!(unique.len(), MAGAZINE_BATCH, "object handed out twice");
+    for ptr in objs {
+        mags.push(idx, ptr).unwrap();
+    }
+
+    let drained = unsafe {
+        zone.drain_magazine(
+            idx,
+            mags.magazine_mut(idx),
+            MAGAZINE_CAPACITY,
+            &SlabCallback,
+        )
+    };
+    assert_eq!(drained, MAGAZINE_BATCH);
+    assert!(mags.magazine_mut(idx).is_empty());
+    assert_eq!(zone.free_space(), free_before);
+
+    Ok(())
+}
+
 /// 归还slab_page给buddy的回调
 struct SlabCallback;
 impl CallBack for SlabCallback {
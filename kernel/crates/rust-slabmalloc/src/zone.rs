@@ -90,6 +90,15 @@ impl<'a> ZoneAllocator<'a> {
         }
     }
 
+    /// Index of the `SCAllocator` serving objects of `requested_size`,
+    /// or `None` if the size is not supported by the zone.
+    pub fn size_class_index(requested_size: usize) -> Option<usize> {
+        match ZoneAllocator::get_slab(requested_size) {
+            Slab::Base(idx) => Some(idx),
+            Slab::Unsupported => None,
+        }
+    }
+
     /// Figure out index into zone array to get the correct slab allocator for that size.
     fn get_slab(requested_size: usize) -> Slab {
         match requested_size {
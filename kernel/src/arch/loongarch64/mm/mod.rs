@@ -14,6 +14,13 @@ pub type PageMapper = crate::mm::page::PageMapper<LoongArch64MMArch, LockedFrame
 #[derive(Debug, Clone, Copy, Hash)]
 pub struct LoongArch64MMArch;
 
+/// CSR.ASID
+const LOONGARCH_CSR_ASID: usize = 0x18;
+/// CSR.PGDL，低半地址空间的页目录基址
+const LOONGARCH_CSR_PGDL: usize = 0x19;
+/// CSR.ASID中ASID字段所在的位
+const LOONGARCH_ASID_MASK: usize = 0x3ff;
+
 impl MemoryManagementArch for LoongArch64MMArch {
     const PAGE_FAULT_ENABLED: bool = false;
 
@@ -121,6 +128,35 @@ impl MemoryManagementArch for LoongArch64MMArch {
         todo!()
     }
 
+    fn user_asid_count() -> usize {
+        // CSR.ASID的ASIDBITS字段（23:16）给出实现的ASID位数，ASID 0留给set_table
+        let asid: usize;
+        unsafe {
+            core::arch::asm!("csrrd {0}, {csr}", out(reg) asid, csr = const LOONGARCH_CSR_ASID)
+        };
+        let bits = (asid >> 16) & 0xff;
+        (1usize << bits) - 1
+    }
+
+    unsafe fn switch_user_table(table: crate::mm::PhysAddr, asid: usize, flush: bool) {
+        let hw_asid = asid + 1;
+        let cur: usize;
+        core::arch::asm!("csrrd {0}, {csr}", out(reg) cur, csr = const LOONGARCH_CSR_ASID);
+        let val = (cur & !LOONGARCH_ASID_MASK) | hw_asid;
+        core::arch::asm!("csrwr {0}, {csr}", inout(reg) val => _, csr = const LOONGARCH_CSR_ASID);
+        core::arch::asm!("csrwr {0}, {csr}", inout(reg) table.data() => _, csr = const LOONGARCH_CSR_PGDL);
+        if flush {
+            // 刷新该ASID下所有G=0的条目
+            core::arch::asm!("invtlb 0x4, {0}, $zero", in(reg) hw_asid);
+        }
+    }
+
+    unsafe fn invalidate_current_asid() {
+        let asid: usize;
+        core::arch::asm!("csrrd {0}, {csr}", out(reg) asid, csr = const LOONGARCH_CSR_ASID);
+        core::arch::asm!("invtlb 0x4, {0}, $zero", in(reg) asid & LOONGARCH_ASID_MASK);
+    }
+
     fn virt_is_valid(virt: crate::mm::VirtAddr) -> bool {
         todo!()
     }
@@ -168,6 +204,13 @@ impl FrameAllocator for LockedFrameAllocator {
     }
 }
 
+impl LockedFrameAllocator {
+    /// 把所有CPU缓存的页帧归还给buddy，返回归还的页数
+    pub fn drain_percpu_pages(&self) -> usize {
+        todo!("LockedFrameAllocator::drain_percpu_pages")
+    }
+}
+
 /// 获取保护标志的映射表
 ///
 ///
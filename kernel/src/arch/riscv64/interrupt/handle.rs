@@ -14,6 +14,7 @@ use crate::{
     exception::softirq::do_softirq,
     process::{utils::current_pcb_flags, ProcessFlags, ProcessManager},
     sched::{SchedMode, SchedPolicy, __schedule},
+    time::tick_sched::{tick_nohz_irq_enter, tick_nohz_irq_exit},
 };
 
 type ExceptionHandler = fn(&mut TrapFrame) -> Result<(), SystemError>;
@@ -41,10 +42,12 @@ static EXCEPTION_HANDLERS: [ExceptionHandler; 16] = [
 unsafe extern "C" fn riscv64_do_irq(trap_frame: &mut TrapFrame) {
     if trap_frame.cause.is_interrupt() {
         crate::rcu::irq_enter();
+        tick_nohz_irq_enter();
         riscv64_do_interrupt(trap_frame);
         let irq_outermost = crate::rcu::irq_is_outermost();
         if irq_outermost {
             do_softirq();
+            tick_nohz_irq_exit();
         }
 
         let should_schedule = current_pcb_flags().contains(ProcessFlags::NEED_SCHEDULE)
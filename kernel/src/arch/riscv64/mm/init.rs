@@ -155,6 +155,7 @@ pub(super) unsafe fn riscv_mm_init() -> Result<(), SystemError> {
         // debug!("New page table enabled");
     }
     debug!("Successfully enabled new page table");
+    RiscV64MMArch::init_asid();
     info!("riscv mm init done");
 
     return Ok(());
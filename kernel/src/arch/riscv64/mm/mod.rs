@@ -1,3 +1,5 @@
+use core::sync::atomic::{AtomicUsize, Ordering};
+
 use riscv::register::satp;
 use sbi_rt::{HartMask, SbiRet};
 use system_error::SystemError;
@@ -10,6 +12,7 @@ use crate::{
         allocator::{
             buddy::BuddyAllocator,
             page_frame::{FrameAllocator, PageFrameCount, PageFrameUsage, PhysPageFrame},
+            pcp::{pcp_adjust_usage, pcp_allocate, pcp_drain_all, pcp_free},
         },
         kernel_mapper::KernelMapper,
         page::{EntryFlags, PageEntry, PAGE_1G_SHIFT},
@@ -37,11 +40,33 @@ pub(self) static mut KERNEL_END_VA: VirtAddr = VirtAddr::new(0);
 
 pub(self) static INNER_ALLOCATOR: SpinLock<Option<BuddyAllocator<MMArch>>> = SpinLock::new(None);
 
+/// satp.ASID中实现了的最大ASID，0表示不支持ASID。ASID 0留给set_table加载的页表。
+static MAX_ASID: AtomicUsize = AtomicUsize::new(0);
+
 /// RiscV64的内存管理架构结构体(sv39)
 #[derive(Debug, Clone, Copy, Hash)]
 pub struct RiscV64MMArch;
 
 impl RiscV64MMArch {
+    /// 探测satp.ASID实现了哪些位（ASIDLEN）
+    ///
+    /// 向ASID字段写入全1后读回，未实现的位读出为0。
+    pub(super) unsafe fn init_asid() {
+        let old = satp::read();
+        satp::set(satp::Mode::Sv39, 0xffff, old.ppn());
+        let max_asid = satp::read().asid();
+        satp::set(satp::Mode::Sv39, old.asid(), old.ppn());
+        riscv::asm::sfence_vma_all();
+        MAX_ASID.store(max_asid, Ordering::Relaxed);
+        log::info!("riscv: {} ASIDs available", max_asid);
+    }
+
+    /// 刷新`asid`下的所有非全局条目
+    #[inline(always)]
+    unsafe fn flush_asid(asid: usize) {
+        core::arch::asm!("sfence.vma zero, {0}", in(reg) asid, options(nostack));
+    }
+
     /// 使远程cpu的TLB中，指定地址范围的页失效
     #[allow(dead_code)]
     pub fn remote_invalidate_page(
@@ -160,7 +185,8 @@ impl MemoryManagementArch for RiscV64MMArch {
     }
 
     unsafe fn invalidate_page(address: VirtAddr) {
-        riscv::asm::sfence_vma(0, address.data());
+        // rs2为zero时刷新所有ASID中的该地址
+        core::arch::asm!("sfence.vma {0}, zero", in(reg) address.data(), options(nostack));
     }
 
     unsafe fn invalidate_all() {
@@ -182,6 +208,30 @@ impl MemoryManagementArch for RiscV64MMArch {
         satp::set(satp::Mode::Sv39, 0, ppn);
     }
 
+    fn user_asid_count() -> usize {
+        MAX_ASID.load(Ordering::Relaxed)
+    }
+
+    unsafe fn switch_user_table(table: PhysAddr, asid: usize, flush: bool) {
+        if MAX_ASID.load(Ordering::Relaxed) == 0 {
+            Self::set_table(PageTableKind::User, table);
+            return;
+        }
+        let hw_asid = asid + 1;
+        satp::set(satp::Mode::Sv39, hw_asid, PhysPageFrame::new(table).ppn());
+        if flush {
+            Self::flush_asid(hw_asid);
+        }
+    }
+
+    unsafe fn invalidate_current_asid() {
+        if MAX_ASID.load(Ordering::Relaxed) == 0 {
+            riscv::asm::sfence_vma_all();
+        } else {
+            Self::flush_asid(satp::read().asid());
+        }
+    }
+
     fn virt_is_valid(virt: VirtAddr) -> bool {
         virt.is_canonical()
     }
@@ -352,15 +402,22 @@ pub struct LockedFrameAllocator;
 
 impl FrameAllocator for LockedFrameAllocator {
     unsafe fn allocate(&mut self, count: PageFrameCount) -> Option<(PhysAddr, PageFrameCount)> {
-        if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
-            return allocator.allocate(count);
-        } else {
-            return None;
+        if let Some(r) = pcp_allocate(&INNER_ALLOCATOR, count) {
+            return Some(r);
+        }
+        let r = INNER_ALLOCATOR.lock_irqsave().as_mut()?.allocate(count);
+        if r.is_none() && pcp_drain_all(&INNER_ALLOCATOR) != 0 {
+            // 各CPU缓存中的页帧归还后，可能可以合并出更大的块
+            return INNER_ALLOCATOR.lock_irqsave().as_mut()?.allocate(count);
         }
+        return r;
     }
 
     unsafe fn free(&mut self, address: crate::mm::PhysAddr, count: PageFrameCount) {
         assert!(count.data().is_power_of_two());
+        if pcp_free(&INNER_ALLOCATOR, address, count) {
+            return;
+        }
         if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
             return allocator.free(address, count);
         }
@@ -368,9 +425,16 @@ impl FrameAllocator for LockedFrameAllocator {
 
     unsafe fn usage(&self) -> PageFrameUsage {
         if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
-            return allocator.usage();
+            return pcp_adjust_usage(allocator.usage());
         } else {
             panic!("usage error");
         }
     }
 }
+
+impl LockedFrameAllocator {
+    /// 把所有CPU缓存的页帧归还给buddy，返回归还的页数
+    pub fn drain_percpu_pages(&self) -> usize {
+        unsafe { pcp_drain_all(&INNER_ALLOCATOR) }
+    }
+}
@@ -2,13 +2,25 @@ use core::hint::spin_loop;
 
 use log::error;
 
-use crate::{arch::CurrentIrqArch, exception::InterruptArch, process::ProcessManager};
+use crate::{
+    arch::CurrentIrqArch,
+    exception::InterruptArch,
+    process::ProcessManager,
+    sched::{balance::newidle_balance, SchedMode, __schedule},
+    time::tick_sched::tick_nohz_idle_stop_tick,
+};
 
 impl ProcessManager {
     /// 每个核的idle进程
     pub fn arch_idle_func() -> ! {
         loop {
+            // 从其他cpu拉到任务时立即调度，不用等下一次中断
+            if newidle_balance() {
+                __schedule(SchedMode::SM_NONE);
+                continue;
+            }
             if CurrentIrqArch::is_irq_enabled() {
+                tick_nohz_idle_stop_tick();
                 crate::rcu::enter_idle();
                 riscv::asm::wfi();
                 crate::rcu::exit_idle();
@@ -178,7 +178,7 @@ impl ProcessManager {
         // 当前 CPU 加入 next active_cpus，加载 satp 后再清 prev active_cpus。
         // 临时双 membership 只会多发 IPI；反向窗口会让 remote shootdown 漏掉
         // 已经加载 next mm 的 CPU。
-        // 顺序：set(next) -> make_current(next) -> clear(prev) -> tlb_state_set_loaded_mm(next)
+        // 顺序：set(next) -> switch_mm_irqs_off(next) -> clear(prev)
         // 与 x86_64 switch_process 保持一致 (见 kernel/src/arch/x86_64/process/mod.rs:switch_process)。
         // 如果 next 没有 user mm，则保留当前 CPU 已加载的 mm，进入 lazy-TLB 模式。
         let next_addr_space = next.basic().user_vm();
@@ -199,7 +199,7 @@ impl ProcessManager {
                 next_mm.active_cpus_set(cpu);
             }
 
-            next_mm.make_current();
+            unsafe { crate::mm::tlb::switch_mm_irqs_off(&next_mm) };
             compiler_fence(Ordering::SeqCst);
 
             if !same_mm {
@@ -207,7 +207,9 @@ impl ProcessManager {
                     prev_mm.active_cpus_clear(cpu);
                 }
             }
-            unsafe { crate::mm::tlb::tlb_state_set_loaded_mm(next_mm.clone()) };
+        } else {
+            // 内核线程沿用当前mm，不需要修改页表的shootdown可以跳过本CPU
+            unsafe { crate::mm::tlb::enter_lazy_tlb() };
         }
         compiler_fence(Ordering::SeqCst);
 
@@ -304,6 +304,10 @@ pub const SYS_FACCESSAT2: usize = 439;
 pub const SYS_PROCESS_MADVISE: usize = 440;
 pub const SYS_EPOLL_PWAIT2: usize = 441;
 pub const SYS_MOUNT_SETATTR: usize = 442;
+pub const SYS_FUTEX_WAITV: usize = 449;
+pub const SYS_FUTEX_WAKE: usize = 454;
+pub const SYS_FUTEX_WAIT: usize = 455;
+pub const SYS_FUTEX_REQUEUE: usize = 456;
 pub const SYS_SYSCALLS: usize = 443;
 
 // ===以下是为了代码一致性，才定义的调用号===
@@ -615,6 +619,10 @@ pub fn syscall_number_to_str(syscall_number: usize) -> &'static str {
         441 => "SYS_EPOLL_PWAIT2",
         442 => "SYS_MOUNT_SETATTR",
         443 => "SYS_SYSCALLS",
+        449 => "SYS_FUTEX_WAITV",
+        454 => "SYS_FUTEX_WAKE",
+        455 => "SYS_FUTEX_WAIT",
+        456 => "SYS_FUTEX_REQUEUE",
         _ => "UNKNOWN",
     }
 }
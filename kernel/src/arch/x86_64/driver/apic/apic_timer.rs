@@ -21,6 +21,7 @@ use crate::mm::percpu::PerCpu;
 use crate::smp::core::smp_get_processor_id;
 use crate::smp::cpu::ProcessorId;
 use crate::time::clocksource::HZ;
+use crate::time::jiffies::TICK_NESC;
 use crate::time::tick_common::tick_handle_periodic;
 use alloc::string::ToString;
 use alloc::sync::Arc;
@@ -143,6 +144,22 @@ fn init_ap_apic_timer() {
     debug!("init_ap_apic_timer done");
 }
 
+/// 让本cpu的APIC定时器在`ns`纳秒之后单次触发
+///
+/// 计数值超出32位时截断为最大值，此时中断会提前到来，由tick代码重新编程
+pub fn apic_timer_program_oneshot_ns(ns: u64) {
+    let cpu_id = smp_get_processor_id();
+    let mut local_apic_timer = local_apic_timer_instance_mut(cpu_id);
+    local_apic_timer.program_oneshot_ns(ns);
+}
+
+/// 恢复本cpu的APIC定时器周期模式
+pub fn apic_timer_resume_periodic() {
+    let cpu_id = smp_get_processor_id();
+    let mut local_apic_timer = local_apic_timer_instance_mut(cpu_id);
+    local_apic_timer.resume_periodic();
+}
+
 pub(super) struct LocalApicTimerIntrController;
 
 impl LocalApicTimerIntrController {
@@ -300,6 +317,36 @@ impl LocalApicTimer {
         self.set_initial_cnt(initial_count);
     }
 
+    /// 切换到单次模式，`ns`纳秒之后触发一次中断
+    ///
+    /// `initial_count`仍保存周期模式下每个tick的计数值，既用于换算纳秒，也供恢复周期模式使用。
+    /// 已经处于单次模式时只写初始计数，高精度模式下每次中断都会重新编程
+    fn program_oneshot_ns(&mut self, ns: u64) {
+        let count = (self.initial_count as u128 * ns as u128)
+            .div_ceil(TICK_NESC as u128)
+            .clamp(1, u32::MAX as u128) as u64;
+        if !matches!(self.mode, LocalApicTimerMode::Oneshot) {
+            self.mode = LocalApicTimerMode::Oneshot;
+            self.setup_lvt(
+                APIC_TIMER_IRQ_NUM.data() as u8,
+                false,
+                LocalApicTimerMode::Oneshot,
+            );
+        }
+        // 写入初始计数时开始倒数
+        CurrentApic.set_timer_initial_count(count);
+    }
+
+    fn resume_periodic(&mut self) {
+        self.mode = LocalApicTimerMode::Periodic;
+        self.setup_lvt(
+            APIC_TIMER_IRQ_NUM.data() as u8,
+            false,
+            LocalApicTimerMode::Periodic,
+        );
+        self.set_initial_cnt(self.initial_count);
+    }
+
     fn setup_lvt(&mut self, vector: u8, mask: bool, mode: LocalApicTimerMode) {
         let mode: u32 = mode as u32;
         let data = (mode << 17) | (vector as u32) | (if mask { 1 << 16 } else { 0 });
@@ -1,4 +1,10 @@
-use crate::{arch::MMArch, libs::elf::ElfArch, mm::MemoryManagementArch};
+use system_error::SystemError;
+
+use crate::{
+    arch::MMArch,
+    libs::elf::ElfArch,
+    mm::{ucontext::InnerAddressSpace, MemoryManagementArch, VirtAddr},
+};
 
 #[derive(Debug, Clone, Copy, Hash)]
 pub struct X86_64ElfArch;
@@ -7,4 +13,10 @@ impl ElfArch for X86_64ElfArch {
     const ELF_ET_DYN_BASE: usize = MMArch::USER_END_VADDR.data() / 3 * 2;
 
     const ELF_PAGE_SIZE: usize = MMArch::PAGE_SIZE;
+
+    fn arch_setup_additional_pages(
+        user_vm: &mut InnerAddressSpace,
+    ) -> Result<Option<VirtAddr>, SystemError> {
+        super::vdso::arch_setup_additional_pages(user_vm)
+    }
 }
@@ -3,7 +3,7 @@ use core::{
     sync::atomic::{compiler_fence, Ordering},
 };
 
-use log::debug;
+use log::{debug, warn};
 use system_error::SystemError;
 use x86::dtables::DescriptorTablePointer;
 
@@ -21,7 +21,7 @@ use super::{
         hpet::{hpet_init, hpet_instance},
         tsc::TSCManager,
     },
-    MMArch,
+    vdso, MMArch,
 };
 
 mod boot;
@@ -123,6 +123,10 @@ pub fn setup_arch_post() -> Result<(), SystemError> {
     }
     TSCManager::init().expect("tsc init failed");
 
+    if let Err(e) = vdso::vdso_init() {
+        warn!("vdso init failed: {:?}", e);
+    }
+
     return Ok(());
 }
 
@@ -5,6 +5,7 @@ use crate::{
     exception::{irqdesc::irq_desc_manager, softirq::do_softirq, IrqNumber},
     process::{utils::current_pcb_flags, ProcessFlags, ProcessManager},
     sched::{SchedMode, SchedPolicy, __schedule},
+    time::tick_sched::{tick_nohz_irq_enter, tick_nohz_irq_exit},
 };
 
 use super::TrapFrame;
@@ -18,6 +19,7 @@ unsafe extern "C" fn x86_64_do_irq(trap_frame: &mut TrapFrame, vector: u32) {
     }
 
     crate::rcu::irq_enter();
+    tick_nohz_irq_enter();
 
     // 由于x86上面，虚拟中断号与物理中断号是一一对应的，所以这里直接使用vector作为中断号来查询irqdesc
 
@@ -38,6 +40,7 @@ unsafe extern "C" fn x86_64_do_irq(trap_frame: &mut TrapFrame, vector: u32) {
     let irq_outermost = crate::rcu::irq_is_outermost();
     if irq_outermost {
         do_softirq();
+        tick_nohz_irq_exit();
     }
 
     // 检测当前进程是否可被调度
@@ -18,7 +18,7 @@ use crate::{
     mm::{
         fault::{FaultFlags, PageFaultHandler, PageFaultMessage},
         ucontext::{AddressSpace, LockedVMA},
-        VirtAddr, VmFaultReason, VmFlags,
+        PageTableKind, VirtAddr, VmFaultReason, VmFlags,
     },
     process::ProcessManager,
 };
@@ -314,8 +314,16 @@ impl X86_64MMArch {
             false // 不是内核访问，继续正常流程
         };
 
+        // 空闲页过少时先同步回收一批页面。只在用户态缺页时进行，
+        // 内核态访问用户地址时调用者可能持有其他锁
+        if regs.is_from_user() {
+            crate::mm::swap::vmscan::try_to_free_pages();
+        }
+
         let current_address_space: Arc<AddressSpace> = AddressSpace::current().unwrap();
-        let mut space_guard = current_address_space.write();
+        // 缺页只持有地址空间的读锁，同一进程中不同区域的缺页可以并行处理，
+        // 页表的修改由分裂PTE锁串行化（见`AddressSpace::pte_lock`）。只有扩展栈需要写锁。
+        let mut space_guard = current_address_space.read();
         let mut fault;
         loop {
             let vma = space_guard.mappings.find_nearest(address);
@@ -385,15 +393,28 @@ impl X86_64MMArch {
                         send_segv_maperr();
                         return;
                     }
-                    space_guard
-                        .extend_stack(extension_size)
-                        .unwrap_or_else(|_| {
-                            panic!(
-                                "user stack extend failed, error_code: {:?}, address: {:#x}",
-                                error_code,
-                                address.data(),
-                            )
-                        });
+                    drop(space_guard);
+                    {
+                        let mut write_guard = current_address_space.write();
+                        // 等待写锁期间其他线程可能已经扩展了栈
+                        let extended = write_guard
+                            .mappings
+                            .find_nearest(address)
+                            .is_some_and(|vma| vma.lock().region().contains(address));
+                        if !extended {
+                            write_guard
+                                .extend_stack(extension_size)
+                                .unwrap_or_else(|_| {
+                                    panic!(
+                                        "user stack extend failed, error_code: {:?}, address: {:#x}",
+                                        error_code,
+                                        address.data(),
+                                    )
+                                });
+                        }
+                    }
+                    space_guard = current_address_space.read();
+                    continue;
                 } else {
                     log::error!(
                         "pid: {} No mapped vma, error_code: {:?},rip:{:#x}, address: {:#x}, flags: {:?}",
@@ -430,12 +451,19 @@ impl X86_64MMArch {
                 send_segv_accerr();
                 return;
             }
-            let mapper = &mut space_guard.user_mapper.utable;
+            // 读锁下不能借用地址空间中的映射器，使用指向同一页表的临时映射器
+            let mut mapper = unsafe {
+                PageMapper::new(
+                    PageTableKind::User,
+                    current_address_space.table_paddr(),
+                    LockedFrameAllocator,
+                )
+            };
             let message = PageFaultMessage::new(
                 vma.clone(),
                 address,
                 flags,
-                mapper,
+                &mut mapper,
                 current_address_space.clone(),
             );
 
@@ -18,10 +18,12 @@ use crate::libs::lib_ui::screen_manager::scm_disable_put_to_window;
 use crate::libs::spinlock::SpinLock;
 
 use crate::mm::allocator::page_frame::{FrameAllocator, PageFrameCount, PageFrameUsage};
+use crate::mm::allocator::pcp::{pcp_adjust_usage, pcp_allocate, pcp_drain_all, pcp_free};
 use crate::mm::memblock::mem_block_manager;
 use crate::mm::ucontext::LockedVMA;
 use crate::{
-    arch::MMArch,
+    arch::{CurrentIrqArch, MMArch},
+    exception::InterruptArch,
     mm::allocator::{buddy::BuddyAllocator, bump::BumpAllocator},
 };
 
@@ -71,6 +73,33 @@ pub struct X86_64MMArch;
 /// XD标志位是否被保留
 static XD_RESERVED: AtomicBool = AtomicBool::new(false);
 
+/// 是否开启了PCID（CR4.PCIDE），开启后用户页表按ASID加载，切换时不必刷新TLB
+static PCID_ENABLED: AtomicBool = AtomicBool::new(false);
+/// 是否支持INVPCID指令
+static INVPCID_SUPPORTED: AtomicBool = AtomicBool::new(false);
+
+/// CR3中页表物理地址所在的位
+const CR3_ADDR_MASK: usize = 0x000f_ffff_ffff_f000;
+/// CR3中PCID所在的位
+const CR3_PCID_MASK: usize = 0xfff;
+/// 写CR3时设置此位，不刷新新PCID下缓存的条目
+const CR3_NOFLUSH: usize = 1 << 63;
+
+/// INVPCID：刷新指定PCID中的单个地址（不包括全局条目）
+const INVPCID_TYPE_INDIV_ADDR: u64 = 0;
+/// INVPCID：刷新所有PCID的条目，包括全局条目
+const INVPCID_TYPE_ALL_INCL_GLOBAL: u64 = 2;
+
+unsafe fn invpcid(kind: u64, pcid: usize, addr: usize) {
+    let desc: [u64; 2] = [pcid as u64, addr as u64];
+    asm!(
+        "invpcid {0}, xmmword ptr [{1}]",
+        in(reg) kind,
+        in(reg) desc.as_ptr(),
+        options(nostack, preserves_flags)
+    );
+}
+
 impl MemoryManagementArch for X86_64MMArch {
     /// X86目前支持缺页中断
     const PAGE_FAULT_ENABLED: bool = true;
@@ -145,6 +174,7 @@ impl MemoryManagementArch for X86_64MMArch {
         }
 
         Self::init_xd_rsvd();
+        Self::init_pcid();
 
         let bootstrap_info = X86_64MMBootstrapInfo {
             kernel_load_base_paddr: _default_kernel_load_base as usize,
@@ -178,15 +208,33 @@ impl MemoryManagementArch for X86_64MMArch {
     /// @brief 刷新TLB中，关于指定虚拟地址的条目
     unsafe fn invalidate_page(address: VirtAddr) {
         compiler_fence(Ordering::SeqCst);
-        asm!("invlpg [{0}]", in(reg) address.data(), options(nostack, preserves_flags));
+        // 内核映射没有设置Global位，开启PCID后每个PCID下都可能缓存了它，
+        // 而invlpg只刷新当前PCID
+        if PCID_ENABLED.load(Ordering::Relaxed) && address.data() >= Self::PHYS_OFFSET {
+            Self::invalidate_kernel_page(address);
+        } else {
+            asm!("invlpg [{0}]", in(reg) address.data(), options(nostack, preserves_flags));
+        }
         compiler_fence(Ordering::SeqCst);
     }
 
     /// @brief 刷新TLB中，所有的条目
     unsafe fn invalidate_all() {
         compiler_fence(Ordering::SeqCst);
-        // 通过设置cr3寄存器，来刷新整个TLB
-        Self::set_table(PageTableKind::User, Self::table(PageTableKind::User));
+        if !PCID_ENABLED.load(Ordering::Relaxed) {
+            // 通过设置cr3寄存器，来刷新整个TLB
+            Self::set_table(PageTableKind::User, Self::table(PageTableKind::User));
+        } else if INVPCID_SUPPORTED.load(Ordering::Relaxed) {
+            invpcid(INVPCID_TYPE_ALL_INCL_GLOBAL, 0, 0);
+        } else {
+            // 重新加载CR3只刷新当前PCID；翻转CR4.PGE会刷新所有PCID的条目
+            use x86::controlregs::{cr4, cr4_write, Cr4};
+            let irq_guard = CurrentIrqArch::save_and_disable_irq();
+            let val = cr4();
+            cr4_write(val ^ Cr4::CR4_ENABLE_GLOBAL_PAGES);
+            cr4_write(val);
+            drop(irq_guard);
+        }
         compiler_fence(Ordering::SeqCst);
     }
 
@@ -197,7 +245,7 @@ impl MemoryManagementArch for X86_64MMArch {
                 compiler_fence(Ordering::SeqCst);
                 let cr3 = x86::controlregs::cr3() as usize;
                 compiler_fence(Ordering::SeqCst);
-                return PhysAddr::new(cr3);
+                return PhysAddr::new(cr3 & CR3_ADDR_MASK);
             }
             _ => {
                 todo!("Unsupported table kind: {:?}", table_kind);
@@ -212,6 +260,37 @@ impl MemoryManagementArch for X86_64MMArch {
         compiler_fence(Ordering::SeqCst);
     }
 
+    fn user_asid_count() -> usize {
+        if PCID_ENABLED.load(Ordering::Relaxed) {
+            // PCID 0留给set_table加载的页表
+            CR3_PCID_MASK
+        } else {
+            0
+        }
+    }
+
+    unsafe fn switch_user_table(table: PhysAddr, asid: usize, flush: bool) {
+        if !PCID_ENABLED.load(Ordering::Relaxed) {
+            Self::set_table(PageTableKind::User, table);
+            return;
+        }
+        let mut cr3 = table.data() | Self::asid_to_pcid(asid);
+        if !flush {
+            cr3 |= CR3_NOFLUSH;
+        }
+        compiler_fence(Ordering::SeqCst);
+        asm!("mov cr3, {}", in(reg) cr3, options(nostack, preserves_flags));
+        compiler_fence(Ordering::SeqCst);
+    }
+
+    unsafe fn invalidate_current_asid() {
+        // 不带NOFLUSH位重新加载CR3，只刷新当前PCID下的条目
+        compiler_fence(Ordering::SeqCst);
+        let cr3 = x86::controlregs::cr3() as usize;
+        asm!("mov cr3, {}", in(reg) cr3, options(nostack, preserves_flags));
+        compiler_fence(Ordering::SeqCst);
+    }
+
     /// @brief 判断虚拟地址是否合法
     fn virt_is_valid(virt: VirtAddr) -> bool {
         return virt.is_canonical();
@@ -548,6 +627,60 @@ impl X86_64MMArch {
         compiler_fence(Ordering::SeqCst);
     }
 
+    /// 检测PCID/INVPCID并在BSP上开启PCID
+    fn init_pcid() {
+        let cpuid = raw_cpuid::CpuId::new();
+        let pcid = cpuid.get_feature_info().is_some_and(|f| f.has_pcid());
+        let invpcid = cpuid
+            .get_extended_feature_info()
+            .is_some_and(|f| f.has_invpcid());
+        PCID_ENABLED.store(pcid, Ordering::Relaxed);
+        INVPCID_SUPPORTED.store(pcid && invpcid, Ordering::Relaxed);
+        Self::init_current_cpu_pcid();
+        info!("PCID: {}, INVPCID: {}", pcid, pcid && invpcid);
+    }
+
+    /// 在当前CPU上开启CR4.PCIDE
+    ///
+    /// CR4同样是每CPU状态，AP启动时也要调用。此时CR3中的PCID必须为0。
+    pub(crate) fn init_current_cpu_pcid() {
+        if !PCID_ENABLED.load(Ordering::Relaxed) {
+            return;
+        }
+        unsafe {
+            use x86::controlregs::{cr4, cr4_write, Cr4};
+            let mut val = cr4();
+            if !val.contains(Cr4::CR4_ENABLE_PCID) {
+                val.insert(Cr4::CR4_ENABLE_PCID);
+                cr4_write(val);
+            }
+        }
+    }
+
+    /// 用户地址空间的ASID对应的PCID，PCID 0留给set_table
+    #[inline(always)]
+    fn asid_to_pcid(asid: usize) -> usize {
+        asid + 1
+    }
+
+    /// 在所有可能使用过的PCID中刷新一个内核地址
+    unsafe fn invalidate_kernel_page(address: VirtAddr) {
+        if INVPCID_SUPPORTED.load(Ordering::Relaxed) {
+            invpcid(INVPCID_TYPE_INDIV_ADDR, 0, address.data());
+            for asid in 0..crate::mm::tlb::nr_dyn_asids() {
+                invpcid(
+                    INVPCID_TYPE_INDIV_ADDR,
+                    Self::asid_to_pcid(asid),
+                    address.data(),
+                );
+            }
+        } else {
+            // 其他PCID在下一次被使用时整体刷新
+            asm!("invlpg [{0}]", in(reg) address.data(), options(nostack, preserves_flags));
+            crate::mm::tlb::invalidate_other_asids();
+        }
+    }
+
     /// 判断XD标志位是否被保留
     pub fn is_xd_reserved() -> bool {
         // 若硬件不支持 NX/XD，则返回 true，表示执行位不可用；否则遵从检测结果
@@ -773,15 +906,22 @@ pub struct LockedFrameAllocator;
 impl FrameAllocator for LockedFrameAllocator {
     unsafe fn allocate(&mut self, mut count: PageFrameCount) -> Option<(PhysAddr, PageFrameCount)> {
         count = count.next_power_of_two();
-        if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
-            return allocator.allocate(count);
-        } else {
-            return None;
+        if let Some(r) = pcp_allocate(&INNER_ALLOCATOR, count) {
+            return Some(r);
         }
+        let r = INNER_ALLOCATOR.lock_irqsave().as_mut()?.allocate(count);
+        if r.is_none() && pcp_drain_all(&INNER_ALLOCATOR) != 0 {
+            // 各CPU缓存中的页帧归还后，可能可以合并出更大的块
+            return INNER_ALLOCATOR.lock_irqsave().as_mut()?.allocate(count);
+        }
+        return r;
     }
 
     unsafe fn free(&mut self, address: crate::mm::PhysAddr, count: PageFrameCount) {
         assert!(count.data().is_power_of_two());
+        if pcp_free(&INNER_ALLOCATOR, address, count) {
+            return;
+        }
         if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
             return allocator.free(address, count);
         }
@@ -789,13 +929,20 @@ impl FrameAllocator for LockedFrameAllocator {
 
     unsafe fn usage(&self) -> PageFrameUsage {
         if let Some(ref mut allocator) = *INNER_ALLOCATOR.lock_irqsave() {
-            return allocator.usage();
+            return pcp_adjust_usage(allocator.usage());
         } else {
             panic!("usage error");
         }
     }
 }
 
+impl LockedFrameAllocator {
+    /// 把所有CPU缓存的页帧归还给buddy，返回归还的页数
+    pub fn drain_percpu_pages(&self) -> usize {
+        unsafe { pcp_drain_all(&INNER_ALLOCATOR) }
+    }
+}
+
 /// 获取内核地址默认的页面标志
 pub unsafe fn kernel_page_flags<A: MemoryManagementArch>(virt: VirtAddr) -> EntryFlags<A> {
     let info: X86_64MMBootstrapInfo = BOOTSTRAP_MM_INFO.unwrap();
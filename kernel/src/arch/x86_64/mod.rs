@@ -24,6 +24,7 @@ pub mod sched;
 pub mod smp;
 pub mod syscall;
 pub mod time;
+pub mod vdso;
 pub mod vm;
 
 pub use self::pci::pci::X86_64PciArch as PciArch;
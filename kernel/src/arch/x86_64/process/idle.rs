@@ -6,18 +6,29 @@ use crate::{
     arch::CurrentIrqArch,
     exception::InterruptArch,
     process::{ProcessFlags, ProcessManager},
-    sched::{SchedMode, __schedule},
+    sched::{balance::newidle_balance, SchedMode, __schedule},
+    time::tick_sched::tick_nohz_idle_stop_tick,
 };
 
 impl ProcessManager {
     /// 每个核的idle进程
     pub fn arch_idle_func() -> ! {
+        // 每次进入idle（包括从别的任务切换回来）先尝试从其他cpu拉任务
+        let mut newly_idle = true;
         loop {
             let pcb = ProcessManager::current_pcb();
             if pcb.flags().contains(ProcessFlags::NEED_SCHEDULE) {
                 __schedule(SchedMode::SM_NONE);
+                newly_idle = true;
+            }
+            if newly_idle {
+                newly_idle = false;
+                if newidle_balance() {
+                    continue;
+                }
             }
             if CurrentIrqArch::is_irq_enabled() {
+                tick_nohz_idle_stop_tick();
                 crate::rcu::enter_idle();
                 unsafe {
                     x86::halt();
@@ -430,7 +430,7 @@ impl ProcessManager {
         // next mm so concurrent remote shootdowns cannot miss the CPU after CR3
         // changes. Keep the previous bit until after the hardware switch; the
         // temporary double membership is safe and may only cause an extra IPI.
-        // Order: set(next) → set CR3 → clear(prev) → update per-CPU TlbState.
+        // Order: set(next) → switch_mm_irqs_off (CR3 + TlbState) → clear(prev).
         //
         // If next has no user mm, keep the current loaded mm in lazy-TLB mode.
         let same_mm = match (prev_active_mm.as_ref(), next_addr_space.as_ref()) {
@@ -443,7 +443,8 @@ impl ProcessManager {
                 next_mm.active_cpus_set(cpu);
             }
 
-            next_mm.make_current();
+            // 同一个mm的线程之间切换不重新加载CR3；不同mm优先复用本CPU上的PCID
+            crate::mm::tlb::switch_mm_irqs_off(&next_mm);
             compiler_fence(Ordering::SeqCst);
 
             if !same_mm {
@@ -451,8 +452,9 @@ impl ProcessManager {
                     prev_mm.active_cpus_clear(cpu);
                 }
             }
-            // Update per-CPU TlbState: hardware-loaded mm and generation
-            crate::mm::tlb::tlb_state_set_loaded_mm(next_mm.clone());
+        } else {
+            // 内核线程沿用当前mm，不需要修改页表的shootdown可以跳过本CPU
+            crate::mm::tlb::enter_lazy_tlb();
         }
         compiler_fence(Ordering::SeqCst);
         // 切换内核栈
@@ -692,6 +694,8 @@ pub(crate) fn stop_this_cpu() -> ! {
     }
 
     crate::rcu::cpu_offline(cpu_id);
+    crate::time::timer::timer_migrate_cpu(cpu_id);
+    crate::time::hrtimer::hrtimer_migrate_cpu(cpu_id);
     // 将当前cpu标记为offline
     smp_cpu_manager().set_online_cpu(cpu_id, false);
     CurrentApic.disable_local_apic();
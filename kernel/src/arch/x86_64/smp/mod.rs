@@ -7,7 +7,7 @@ use core::{
 
 use kdepends::memoffset::offset_of;
 use log::debug;
-use raw_cpuid::CpuId;
+use raw_cpuid::{CpuId, TopologyType};
 use system_error::SystemError;
 
 use crate::{
@@ -24,6 +24,7 @@ use crate::{
         core::smp_get_processor_id,
         cpu::{smp_cpu_manager, CpuHpCpuState, ProcessorId, SmpCpuManager},
         init::smp_ap_start_stage2,
+        topology::CpuTopologyId,
         SMPArch,
     },
 };
@@ -89,6 +90,7 @@ unsafe extern "C" fn smp_ap_start_stage1() -> ! {
     let id = smp_get_processor_id();
     debug!("smp_ap_start_stage1: id: {}\n", id.data());
     X86_64MMArch::init_current_cpu_nxe();
+    X86_64MMArch::init_current_cpu_pcid();
 
     let current_idle = ProcessManager::idle_pcb()[smp_get_processor_id().data() as usize].clone();
 
@@ -227,6 +229,19 @@ impl SMPArch for X86_64SMPArch {
         return Ok(());
     }
 
+    fn topology_id(cpu_id: ProcessorId) -> CpuTopologyId {
+        let Some((smt_shift, llc_shift, package_shift)) = Self::apic_id_shifts() else {
+            return CpuTopologyId::flat(cpu_id);
+        };
+
+        let apic_id = SMP_BOOT_DATA.phys_id(cpu_id.data() as usize) as u32;
+        CpuTopologyId {
+            core_id: apic_id >> smt_shift,
+            llc_id: apic_id >> llc_shift,
+            package_id: apic_id >> package_shift,
+        }
+    }
+
     fn start_cpu(cpu_id: ProcessorId, _cpu_hpstate: &CpuHpCpuState) -> Result<(), SystemError> {
         Self::copy_smp_start_code();
         let init_assert_delay_ns = Self::ap_init_assert_delay_ns();
@@ -250,6 +265,41 @@ impl SMPArch for X86_64SMPArch {
 }
 
 impl X86_64SMPArch {
+    /// 从CPUID读取APIC ID中SMT、LLC和封装编号所在的位移
+    ///
+    /// - leaf 0xB给出SMT层和核心层的位移，核心层的位移就是封装编号的位移；
+    /// - leaf 4中最后一级缓存的EAX[25:14]是共享这一缓存的逻辑cpu数的上限，
+    ///   取以2为底的对数向上取整就是LLC编号的位移。
+    ///
+    /// 不支持leaf 0xB时返回None，调用者退化为平坦拓扑。
+    fn apic_id_shifts() -> Option<(u32, u32, u32)> {
+        let cpuid = CpuId::new();
+        let mut smt_shift = None;
+        let mut package_shift = None;
+        for level in cpuid.get_extended_topology_info()? {
+            match level.level_type() {
+                TopologyType::SMT => smt_shift = Some(level.shift_right_for_next_apic_id()),
+                TopologyType::Core => package_shift = Some(level.shift_right_for_next_apic_id()),
+                _ => {}
+            }
+        }
+        let smt_shift = smt_shift.unwrap_or(0);
+        let package_shift = package_shift.unwrap_or(smt_shift).max(smt_shift);
+
+        let llc_shift = cpuid
+            .get_cache_parameters()
+            .and_then(|caches| caches.max_by_key(|cache| cache.level()))
+            .map(|llc| {
+                (llc.max_cores_for_cache() as u32)
+                    .next_power_of_two()
+                    .trailing_zeros()
+            })
+            .map(|shift| shift.clamp(smt_shift, package_shift))
+            .unwrap_or(package_shift);
+
+        Some((smt_shift, llc_shift, package_shift))
+    }
+
     const SMP_CODE_START: usize = 0x20000;
 
     #[inline(always)]
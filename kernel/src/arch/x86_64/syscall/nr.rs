@@ -360,6 +360,10 @@ pub const SYS_FACCESSAT2: usize = 439;
 pub const SYS_PROCESS_MADVISE: usize = 440;
 pub const SYS_EPOLL_PWAIT2: usize = 441;
 pub const SYS_MOUNT_SETATTR: usize = 442;
+pub const SYS_FUTEX_WAITV: usize = 449;
+pub const SYS_FUTEX_WAKE: usize = 454;
+pub const SYS_FUTEX_WAIT: usize = 455;
+pub const SYS_FUTEX_REQUEUE: usize = 456;
 
 pub fn syscall_number_to_str(syscall_number: usize) -> &'static str {
     match syscall_number {
@@ -718,6 +722,10 @@ pub fn syscall_number_to_str(syscall_number: usize) -> &'static str {
         440 => "SYS_PROCESS_MADVISE",
         441 => "SYS_EPOLL_PWAIT2",
         442 => "SYS_MOUNT_SETATTR",
+        449 => "SYS_FUTEX_WAITV",
+        454 => "SYS_FUTEX_WAKE",
+        455 => "SYS_FUTEX_WAIT",
+        456 => "SYS_FUTEX_REQUEUE",
         _ => "UNKNOWN",
     }
 }
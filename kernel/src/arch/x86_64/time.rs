@@ -1,6 +1,9 @@
 use crate::time::{clocksource::HZ, TimeArch};
 
-use super::driver::tsc::TSCManager;
+use super::driver::{
+    apic::apic_timer::{apic_timer_program_oneshot_ns, apic_timer_resume_periodic},
+    tsc::TSCManager,
+};
 
 /// 这个是系统jiffies时钟源的固有频率（不是调频之后的）
 pub const CLOCK_TICK_RATE: u32 = HZ as u32 * 1000000;
@@ -26,4 +29,13 @@ impl TimeArch for X86_64TimeArch {
     fn cycles2ns(cycles: usize) -> usize {
         cycles * 1000000 / TSCManager::cpu_khz() as usize
     }
+
+    fn clockevent_program_oneshot(ns: u64) -> bool {
+        apic_timer_program_oneshot_ns(ns);
+        true
+    }
+
+    fn clockevent_resume_periodic() {
+        apic_timer_resume_periodic();
+    }
 }
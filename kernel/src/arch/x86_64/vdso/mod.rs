@@ -0,0 +1,238 @@
+//! x86_64的vDSO
+//!
+//! vDSO镜像在构建时由 build-scripts/kernel_build 从本目录的C源码编译得到，内核启动时把它拷贝到
+//! 物理页中，exec时映射到每个进程的用户地址空间，并通过AT_SYSINFO_EHDR告知用户程序（libc）。
+//!
+//! 映射布局（与 vdso.lds 一致）：
+//!
+//! ```text
+//! [vvar_page][pvclock_page][vDSO镜像 ...]
+//!                           ^ vdso_base
+//! ```
+//!
+//! - vvar_page：timekeeping维护的 [`VdsoData`]，用户态只读
+//! - pvclock_page：kvm-clock中cpu0的时间信息页；不在KVM中时是一个全零页，vDSO不会使用它
+
+use alloc::{sync::Arc, vec::Vec};
+use log::info;
+use system_error::SystemError;
+use x86::{
+    cpuid::CpuId,
+    msr::{wrmsr, IA32_TSC_AUX},
+};
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    driver::clocksource::kvm_clock::kvm_clock_vdso_page,
+    libs::align::page_align_up,
+    mm::{
+        allocator::page_frame::{PageFrameCount, PhysPageFrame, VirtPageFrame},
+        page::{page_manager, DeferredFlusher, EntryFlags, Page, PageFlags, PageType},
+        syscall::ProtFlags,
+        ucontext::{InnerAddressSpace, PhysmapParams, VMA},
+        MemoryManagementArch, PhysAddr, VirtAddr, VmFlags,
+    },
+    smp::core::smp_get_processor_id,
+    time::{
+        syscall::SYS_TIMEZONE,
+        timekeeping::timekeeping_vsyscall_init,
+        vsyscall::{vdso_data_register, VdsoData, VDSO_GETCPU_NONE, VDSO_GETCPU_RDTSCP},
+    },
+};
+
+/// 构建脚本编译出的vDSO镜像
+static VDSO_IMAGE: &[u8] = include_bytes!(env!("DRAGONOS_VDSO_IMAGE"));
+
+/// 位于vDSO镜像之前的vvar页数，需要与 vdso.lds 中的 VVAR_PAGES 保持一致
+const VVAR_PAGES: usize = 2;
+
+static mut VDSO_PAGES: Option<VdsoPages> = None;
+
+#[derive(Debug)]
+struct VdsoPages {
+    /// vDSO数据页
+    vvar: PhysAddr,
+    /// 映射到pvclock_page处的页
+    pvclock: PhysAddr,
+    /// vDSO镜像的起始物理页
+    image: PhysAddr,
+    image_pages: PageFrameCount,
+    /// 持有页面的引用，这些页面在整个系统运行期间都不会释放
+    _pages: Vec<Arc<Page>>,
+}
+
+fn cpu_has_rdtscp() -> bool {
+    CpuId::new()
+        .get_extended_processor_and_feature_identifiers()
+        .is_some_and(|f| f.has_rdtscp())
+}
+
+/// 把当前cpu的编号写入IA32_TSC_AUX，供vDSO的getcpu通过rdtscp读取
+///
+/// 每个cpu启动时都需要调用一次
+pub fn vdso_setup_getcpu() {
+    if !cpu_has_rdtscp() {
+        return;
+    }
+    // 低12位是cpu号，其余位是numa节点号（目前只有节点0）
+    let aux = smp_get_processor_id().data() as u64 & 0xfff;
+    unsafe { wrmsr(IA32_TSC_AUX, aux) };
+}
+
+/// 初始化vDSO：分配vvar页，拷贝镜像，并让timekeeping开始更新vvar页
+///
+/// 需要在时钟源硬件初始化之后调用
+#[inline(never)]
+pub fn vdso_init() -> Result<(), SystemError> {
+    if VDSO_IMAGE.len() < 4 || &VDSO_IMAGE[0..4] != b"\x7fELF" {
+        return Err(SystemError::ENOEXEC);
+    }
+
+    let image_pages = PageFrameCount::from_bytes(page_align_up(VDSO_IMAGE.len())).unwrap();
+    // vvar页和备用的pvclock页，新分配的页面都已清零
+    let (vvar, mut pages) = page_manager().create_pages(
+        PageType::Normal,
+        PageFlags::PG_UNEVICTABLE,
+        &mut LockedFrameAllocator,
+        PageFrameCount::new(VVAR_PAGES),
+    )?;
+    let (image, image_page_list) = page_manager().create_pages(
+        PageType::Normal,
+        PageFlags::PG_UNEVICTABLE,
+        &mut LockedFrameAllocator,
+        image_pages,
+    )?;
+    pages.extend(image_page_list);
+
+    unsafe {
+        let dst = MMArch::phys_2_virt(image).unwrap();
+        core::ptr::copy_nonoverlapping(
+            VDSO_IMAGE.as_ptr(),
+            dst.data() as *mut u8,
+            VDSO_IMAGE.len(),
+        );
+    }
+
+    let pvclock = kvm_clock_vdso_page().unwrap_or(vvar.add(MMArch::PAGE_SIZE));
+
+    unsafe {
+        VDSO_PAGES = Some(VdsoPages {
+            vvar,
+            pvclock,
+            image,
+            image_pages,
+            _pages: pages,
+        });
+    }
+
+    vdso_setup_getcpu();
+    let getcpu_mode = if cpu_has_rdtscp() {
+        VDSO_GETCPU_RDTSCP
+    } else {
+        VDSO_GETCPU_NONE
+    };
+    let data = unsafe { &*(MMArch::phys_2_virt(vvar).unwrap().data() as *const VdsoData) };
+    vdso_data_register(data, &SYS_TIMEZONE, getcpu_mode);
+    timekeeping_vsyscall_init();
+
+    info!(
+        "vdso: image {} bytes, pvclock {}",
+        VDSO_IMAGE.len(),
+        if pvclock == vvar.add(MMArch::PAGE_SIZE) {
+            "unavailable"
+        } else {
+            "mapped"
+        }
+    );
+    Ok(())
+}
+
+fn vdso_pages() -> Option<&'static VdsoPages> {
+    unsafe { VDSO_PAGES.as_ref() }
+}
+
+fn map_vdso_pages(
+    user_vm: &mut InnerAddressSpace,
+    phys: PhysAddr,
+    dest: VirtAddr,
+    count: PageFrameCount,
+    vm_flags: VmFlags,
+    prot: ProtFlags,
+) -> Result<(), SystemError> {
+    let params = PhysmapParams {
+        phys: PhysPageFrame::new(phys),
+        destination: VirtPageFrame::new(dest),
+        count,
+        vm_flags,
+        flags: EntryFlags::from_prot_flags(prot, true),
+        shm_id: None,
+    };
+    // 新映射的区域之前没有页表项，不需要刷新TLB
+    let vma = VMA::physmap(
+        params,
+        &mut user_vm.user_mapper.utable,
+        DeferredFlusher::new(),
+    )?;
+    user_vm.mappings.insert_vma(vma);
+    Ok(())
+}
+
+/// 把vvar页和vDSO镜像映射到新程序的地址空间中
+///
+/// ## 返回值
+///
+/// vDSO镜像的起始地址；vDSO未初始化时返回None
+pub fn arch_setup_additional_pages(
+    user_vm: &mut InnerAddressSpace,
+) -> Result<Option<VirtAddr>, SystemError> {
+    let Some(vdso) = vdso_pages() else {
+        return Ok(None);
+    };
+
+    let size = (VVAR_PAGES + vdso.image_pages.data()) * MMArch::PAGE_SIZE;
+    let region = user_vm
+        .mappings
+        .find_free(MMArch::USER_STACK_START.add(MMArch::PAGE_SIZE), size)
+        .ok_or(SystemError::ENOMEM)?;
+    let vvar_start = region.start();
+    let vdso_base = vvar_start.add(VVAR_PAGES * MMArch::PAGE_SIZE);
+
+    let vvar_flags = VmFlags::VM_READ
+        | VmFlags::VM_MAYREAD
+        | VmFlags::VM_IO
+        | VmFlags::VM_PFNMAP
+        | VmFlags::VM_DONTEXPAND
+        | VmFlags::VM_DONTDUMP;
+    map_vdso_pages(
+        user_vm,
+        vdso.vvar,
+        vvar_start,
+        PageFrameCount::ONE,
+        vvar_flags,
+        ProtFlags::PROT_READ,
+    )?;
+    map_vdso_pages(
+        user_vm,
+        vdso.pvclock,
+        vvar_start.add(MMArch::PAGE_SIZE),
+        PageFrameCount::ONE,
+        vvar_flags,
+        ProtFlags::PROT_READ,
+    )?;
+    map_vdso_pages(
+        user_vm,
+        vdso.image,
+        vdso_base,
+        vdso.image_pages,
+        VmFlags::VM_READ
+            | VmFlags::VM_EXEC
+            | VmFlags::VM_MAYREAD
+            | VmFlags::VM_MAYWRITE
+            | VmFlags::VM_MAYEXEC
+            | VmFlags::VM_DONTEXPAND,
+        ProtFlags::PROT_READ | ProtFlags::PROT_EXEC,
+    )?;
+
+    user_vm.vdso_base = vdso_base;
+    Ok(Some(vdso_base))
+}
@@ -0,0 +1,176 @@
+/*
+ * vDSO中的 clock_gettime/gettimeofday/time
+ *
+ * 时钟源是TSC或者带稳定标志的kvm-clock时，直接在用户态读计数器，再用内核发布在vvar页中的
+ * cycle_last/mult/shift换算成纳秒，算法与内核的 getnstimeofday/ktime_get 相同；
+ * 其它时钟源以及不支持的clockid退回系统调用。
+ * COARSE时钟和time()只读取内核在每个tick刷新的快照，不需要读计数器。
+ */
+#include "vdso.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+#define CLOCK_MONOTONIC_RAW 4
+#define CLOCK_REALTIME_COARSE 5
+#define CLOCK_MONOTONIC_COARSE 6
+#define CLOCK_BOOTTIME 7
+
+#define __NR_gettimeofday 96
+#define __NR_clock_gettime 228
+
+struct __kernel_timespec {
+    s64 tv_sec;
+    long tv_nsec;
+};
+
+struct __kernel_old_timeval {
+    long tv_sec;
+    long tv_usec;
+};
+
+struct timezone {
+    int tz_minuteswest;
+    int tz_dsttime;
+};
+
+static inline u64 rdtsc_ordered(void)
+{
+    u32 lo, hi;
+
+    /* lfence保证rdtsc不会早于之前的读seq执行 */
+    __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi)::"memory");
+    return ((u64)hi << 32) | lo;
+}
+
+/*
+ * 读取kvm-clock，与内核的 pvclock_clocksource_read_nowd 相同。
+ * 只有在宿主机保证各vcpu的pvclock一致（TSC_STABLE）时，读cpu0的时间信息才是对的，否则返回~0退回系统调用。
+ */
+static u64 vread_pvclock(void)
+{
+    const struct pvclock_vcpu_time_info *pvti = &pvclock_page;
+    u32 version;
+    u64 delta, ret;
+    s8 shift;
+
+    do {
+        version = READ_ONCE(pvti->version) & ~1U;
+        barrier();
+        if (!(READ_ONCE(pvti->flags) & PVCLOCK_TSC_STABLE_BIT))
+            return ~0ULL;
+
+        delta = rdtsc_ordered() - READ_ONCE(pvti->tsc_timestamp);
+        shift = READ_ONCE(pvti->tsc_shift);
+        if (shift < 0)
+            delta >>= -shift;
+        else
+            delta <<= shift;
+        ret = READ_ONCE(pvti->system_time) +
+              (u64)(((unsigned __int128)delta * READ_ONCE(pvti->tsc_to_system_mul)) >> 32);
+        barrier();
+    } while (READ_ONCE(pvti->version) != version);
+
+    return ret;
+}
+
+/* 高精度时钟，返回非0表示需要退回系统调用 */
+static int do_hres(const struct vdso_data *vd, int clk, struct __kernel_timespec *ts)
+{
+    u64 cycles, sec, ns;
+    u32 seq;
+
+    do {
+        seq = vdso_read_begin(vd);
+        switch (READ_ONCE(vd->clock_mode)) {
+        case VDSO_CLOCKMODE_TSC:
+            cycles = rdtsc_ordered();
+            break;
+        case VDSO_CLOCKMODE_PVCLOCK:
+            cycles = vread_pvclock();
+            if (cycles == ~0ULL)
+                return -1;
+            break;
+        default:
+            return -1;
+        }
+        ns = ((cycles - vd->cycle_last) & vd->mask) * vd->mult;
+        ns = vd->basetime[clk].nsec + (ns >> vd->shift);
+        sec = vd->basetime[clk].sec;
+    } while (vdso_read_retry(vd, seq));
+
+    ts->tv_sec = sec + ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+    return 0;
+}
+
+static void do_coarse(const struct vdso_data *vd, int clk, struct __kernel_timespec *ts)
+{
+    u32 seq;
+
+    do {
+        seq = vdso_read_begin(vd);
+        ts->tv_sec = vd->basetime[clk].sec;
+        ts->tv_nsec = vd->basetime[clk].nsec;
+    } while (vdso_read_retry(vd, seq));
+}
+
+int __vdso_clock_gettime(int clock, struct __kernel_timespec *ts)
+{
+    const struct vdso_data *vd = &vvar_page;
+
+    switch (clock) {
+    case CLOCK_REALTIME:
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_BOOTTIME:
+        if (do_hres(vd, clock, ts) == 0)
+            return 0;
+        break;
+    case CLOCK_REALTIME_COARSE:
+    case CLOCK_MONOTONIC_COARSE:
+        do_coarse(vd, clock, ts);
+        return 0;
+    default:
+        break;
+    }
+
+    return vdso_syscall3(__NR_clock_gettime, clock, (long)ts, 0);
+}
+
+int clock_gettime(int, struct __kernel_timespec *)
+    __attribute__((weak, alias("__vdso_clock_gettime")));
+
+int __vdso_gettimeofday(struct __kernel_old_timeval *tv, struct timezone *tz)
+{
+    const struct vdso_data *vd = &vvar_page;
+
+    if (tv) {
+        struct __kernel_timespec ts;
+
+        if (do_hres(vd, CLOCK_REALTIME, &ts))
+            return vdso_syscall3(__NR_gettimeofday, (long)tv, (long)tz, 0);
+        tv->tv_sec = ts.tv_sec;
+        tv->tv_usec = ts.tv_nsec / 1000;
+    }
+    if (tz) {
+        tz->tz_minuteswest = READ_ONCE(vd->tz_minuteswest);
+        tz->tz_dsttime = READ_ONCE(vd->tz_dsttime);
+    }
+    return 0;
+}
+
+int gettimeofday(struct __kernel_old_timeval *, struct timezone *)
+    __attribute__((weak, alias("__vdso_gettimeofday")));
+
+long __vdso_time(long *t)
+{
+    long secs = READ_ONCE(vvar_page.basetime[CLOCK_REALTIME_COARSE].sec);
+
+    if (t)
+        *t = secs;
+    return secs;
+}
+
+long time(long *) __attribute__((weak, alias("__vdso_time")));
@@ -0,0 +1,98 @@
+/*
+ * vDSO的公共定义
+ *
+ * struct vdso_data 是vDSO与内核共享的数据页（vvar）布局，必须与
+ * kernel/src/time/vsyscall.rs 中的 VdsoData 保持一致。
+ * 内核在更新数据前后各把seq加一，用户态读到奇数或前后两次seq不同则重试。
+ */
+#ifndef __DRAGONOS_VDSO_H__
+#define __DRAGONOS_VDSO_H__
+
+typedef unsigned int u32;
+typedef int s32;
+typedef unsigned long long u64;
+typedef long long s64;
+typedef signed char s8;
+typedef unsigned char u8;
+
+#define VDSO_CLOCKMODE_NONE 0
+#define VDSO_CLOCKMODE_TSC 1
+#define VDSO_CLOCKMODE_PVCLOCK 2
+
+#define VDSO_GETCPU_NONE 0
+#define VDSO_GETCPU_RDTSCP 1
+
+/* 按clockid索引，只用到 REALTIME/MONOTONIC/MONOTONIC_RAW/各COARSE/BOOTTIME */
+#define VDSO_BASES 8
+
+struct vdso_timestamp {
+    u64 sec;
+    u64 nsec;
+};
+
+struct vdso_data {
+    u32 seq;
+    u32 clock_mode;
+    u64 cycle_last;
+    u64 mask;
+    u32 mult;
+    u32 shift;
+    struct vdso_timestamp basetime[VDSO_BASES];
+    s32 tz_minuteswest;
+    s32 tz_dsttime;
+    u32 getcpu_mode;
+};
+
+_Static_assert(sizeof(struct vdso_data) == 176, "vdso_data layout mismatch");
+
+/* KVM pvclock 的每cpu时间信息，与 arch/x86_64/pvclock.rs 一致 */
+struct pvclock_vcpu_time_info {
+    u32 version;
+    u32 pad0;
+    u64 tsc_timestamp;
+    u64 system_time;
+    u32 tsc_to_system_mul;
+    s8 tsc_shift;
+    u8 flags;
+    u8 pad[2];
+};
+
+#define PVCLOCK_TSC_STABLE_BIT (1 << 0)
+
+/* 由vdso.lds定义，位于vDSO镜像之前的vvar页 */
+extern struct vdso_data vvar_page __attribute__((visibility("hidden")));
+extern struct pvclock_vcpu_time_info pvclock_page __attribute__((visibility("hidden")));
+
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define barrier() __asm__ __volatile__("" ::: "memory")
+
+static inline u32 vdso_read_begin(const struct vdso_data *vd)
+{
+    u32 seq;
+
+    while ((seq = READ_ONCE(vd->seq)) & 1)
+        __asm__ __volatile__("pause" ::: "memory");
+    /* x86上读操作之间不会乱序，只需要阻止编译器重排 */
+    barrier();
+    return seq;
+}
+
+static inline int vdso_read_retry(const struct vdso_data *vd, u32 start)
+{
+    barrier();
+    return READ_ONCE(vd->seq) != start;
+}
+
+/* 快速路径不可用时退回系统调用 */
+static inline long vdso_syscall3(long nr, long a0, long a1, long a2)
+{
+    long ret;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(nr), "D"(a0), "S"(a1), "d"(a2)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+#endif
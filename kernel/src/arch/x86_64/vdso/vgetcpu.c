@@ -0,0 +1,26 @@
+/*
+ * vDSO中的 getcpu
+ *
+ * 内核在每个cpu上把 IA32_TSC_AUX 设置为 (node << 12) | cpu，rdtscp 读出来即可；
+ * 处理器不支持rdtscp时退回系统调用。
+ */
+#include "vdso.h"
+
+#define __NR_getcpu 309
+
+long __vdso_getcpu(unsigned *cpu, unsigned *node, void *unused)
+{
+    u32 aux;
+
+    if (READ_ONCE(vvar_page.getcpu_mode) != VDSO_GETCPU_RDTSCP)
+        return vdso_syscall3(__NR_getcpu, (long)cpu, (long)node, (long)unused);
+
+    __asm__ __volatile__("rdtscp" : "=c"(aux)::"eax", "edx");
+    if (cpu)
+        *cpu = aux & 0xfff;
+    if (node)
+        *node = aux >> 12;
+    return 0;
+}
+
+long getcpu(unsigned *, unsigned *, void *) __attribute__((weak, alias("__vdso_getcpu")));
@@ -4,7 +4,7 @@ use crate::arch::vm::mmu::kvm_mmu::PageLevel;
 use crate::arch::vm::mmu::mmu_internal::KvmPageFault;
 use crate::arch::MMArch;
 use crate::mm::allocator::page_frame::FrameAllocator;
-use crate::mm::page::{page_manager_lock, EntryFlags, PageEntry, PageFlags, PageFlush, PageType};
+use crate::mm::page::{page_manager, EntryFlags, PageEntry, PageFlags, PageFlush, PageType};
 use crate::mm::{MemoryManagementArch, PhysAddr, VirtAddr};
 use crate::smp::core::smp_get_processor_id;
 use crate::smp::cpu::AtomicProcessorId;
@@ -361,8 +361,7 @@ impl EptPageMapper {
                 // let hpa: PhysAddr = unsafe { self.frame_allocator.allocate_one() }?;
                 // debug!("Allocate hpa: {:?}", hpa);
                 // 修改全局页管理器
-                let mut page_manager_guard = page_manager_lock();
-                let page = page_manager_guard
+                let page = page_manager()
                     .create_one_page(
                         PageType::Normal,
                         PageFlags::empty(),
@@ -370,7 +369,6 @@ impl EptPageMapper {
                     )
                     .ok()?;
                 let hpa = page.phys_address();
-                drop(page_manager_guard);
                 // 清空这个页帧
                 unsafe {
                     MMArch::write_bytes(MMArch::phys_2_virt(hpa).unwrap(), 0, MMArch::PAGE_SIZE)
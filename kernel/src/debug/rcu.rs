@@ -37,6 +37,26 @@ impl KernFSCallback for RcuDirCallBack {
     }
 }
 
+/// 读取open时生成的报告
+fn read_report(
+    data: KernCallbackData,
+    buf: &mut [u8],
+    offset: usize,
+) -> Result<usize, SystemError> {
+    let report = match data.file_private_data() {
+        Some(KernFilePrivateData::RcuSelftestReport(report)) => report,
+        _ => return Err(SystemError::EINVAL),
+    };
+    let bytes = report.as_bytes();
+    if offset >= bytes.len() {
+        return Ok(0);
+    }
+
+    let len = buf.len().min(bytes.len() - offset);
+    buf[..len].copy_from_slice(&bytes[offset..offset + len]);
+    Ok(len)
+}
+
 #[derive(Debug)]
 struct RcuSelftestCallBack;
 
@@ -54,18 +74,42 @@ impl KernFSCallback for RcuSelftestCallBack {
         buf: &mut [u8],
         offset: usize,
     ) -> Result<usize, SystemError> {
-        let report = match data.file_private_data() {
-            Some(KernFilePrivateData::RcuSelftestReport(report)) => report,
-            _ => return Err(SystemError::EINVAL),
-        };
-        let bytes = report.as_bytes();
-        if offset >= bytes.len() {
-            return Ok(0);
-        }
-
-        let len = buf.len().min(bytes.len() - offset);
-        buf[..len].copy_from_slice(&bytes[offset..offset + len]);
-        Ok(len)
+        read_report(data, buf, offset)
+    }
+
+    fn write(
+        &self,
+        _data: KernCallbackData,
+        _buf: &[u8],
+        _offset: usize,
+    ) -> Result<usize, SystemError> {
+        Err(SystemError::EPERM)
+    }
+
+    fn poll(&self, _data: KernCallbackData) -> Result<PollStatus, SystemError> {
+        Ok(PollStatus::READ)
+    }
+}
+
+/// 打开时运行吞吐量/延迟压力测试
+#[derive(Debug)]
+struct RcuStressCallBack;
+
+impl KernFSCallback for RcuStressCallBack {
+    fn open(&self, mut data: KernCallbackData) -> Result<(), SystemError> {
+        let report = crate::rcu::run_debug_stress();
+        data.file_private_data_mut()
+            .replace(KernFilePrivateData::RcuSelftestReport(report));
+        Ok(())
+    }
+
+    fn read(
+        &self,
+        data: KernCallbackData,
+        buf: &mut [u8],
+        offset: usize,
+    ) -> Result<usize, SystemError> {
+        read_report(data, buf, offset)
     }
 
     fn write(
@@ -100,5 +144,13 @@ pub fn init_debugfs_rcu() -> Result<(), SystemError> {
         Some(&RcuSelftestCallBack),
     )?;
 
+    rcu_root.add_file(
+        "stress".to_string(),
+        InodeMode::S_IRUGO,
+        Some(4096),
+        None,
+        Some(&RcuStressCallBack),
+    )?;
+
     Ok(())
 }
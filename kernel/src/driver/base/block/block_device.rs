@@ -389,6 +389,11 @@ pub trait BlockDevice: Device {
         Ok(())
     }
 
+    /// 作为交换设备时，交换槽位被释放的通知
+    ///
+    /// `[lba_start, lba_start + count)`中的数据不再需要，内存型设备可以借此释放存储。
+    fn swap_slot_free_notify(&self, _lba_start: BlockId, _count: usize) {}
+
     /// 提交异步BIO请求（默认不支持，由驱动选择性实现）
     fn submit_bio(&self, _bio: Arc<super::bio::BioRequest>) -> Result<(), SystemError> {
         Err(SystemError::ENOSYS)
@@ -1,4 +1,7 @@
-use core::{fmt::Formatter, sync::atomic::AtomicU32};
+use core::{
+    fmt::Formatter,
+    sync::atomic::{AtomicU32, AtomicUsize, Ordering},
+};
 
 use alloc::{string::ToString, sync::Arc, vec::Vec};
 use hashbrown::HashMap;
@@ -8,8 +11,11 @@ use unified_init::macros::unified_init;
 use crate::{
     driver::base::{
         block::gendisk::GenDisk,
-        device::{device_number::Major, DevName},
-        kobject::KObject,
+        device::{
+            device_number::{DeviceNumber, Major},
+            DevName,
+        },
+        kobject::{CommonKobj, KObject},
     },
     filesystem::{
         devfs::{devfs_register, devfs_unregister},
@@ -18,11 +24,13 @@ use crate::{
     },
     init::initcall::INITCALL_POSTCORE,
     libs::mutex::{Mutex, MutexGuard},
+    mm::readahead::VM_READAHEAD_PAGES,
 };
 
 use super::{
     block_device::{BlockDevice, GeneralBlockRange},
     gendisk::GenDiskMap,
+    sysfs::{block_sysfs_add, block_sysfs_remove},
 };
 
 static mut BLOCK_DEV_MANAGER: Option<BlockDevManager> = None;
@@ -92,9 +100,39 @@ impl BlockDevManager {
             return Err(e);
         }
 
+        // /sys/block/<disk> 只用于调整参数，创建失败不影响设备使用
+        match block_sysfs_add(&dev) {
+            Ok(kobj) => dev.blkdev_meta().inner().sysfs_kobj = Some(kobj),
+            Err(e) => log::warn!("Failed to create /sys/block/{}: {:?}", dev_name, e),
+        }
+
         Ok(())
     }
 
+    /// 按设备名（如`vda`）查找已注册的块设备
+    pub fn lookup_by_name(&self, name: &str) -> Option<Arc<dyn BlockDevice>> {
+        self.inner()
+            .disks
+            .values()
+            .find(|dev| dev.dev_name().name() == name)
+            .cloned()
+    }
+
+    /// 查找设备号`devnum`对应的分区或整盘所在的块设备
+    pub fn lookup_by_devnum(&self, devnum: DeviceNumber) -> Option<Arc<dyn BlockDevice>> {
+        self.inner()
+            .disks
+            .values()
+            .find(|dev| {
+                dev.blkdev_meta()
+                    .inner()
+                    .gendisks
+                    .values()
+                    .any(|gendisk| gendisk.device_num() == devnum)
+            })
+            .cloned()
+    }
+
     /// Detect partitions without holding the global block manager lock.
     fn prepare_gendisks(
         &self,
@@ -274,6 +312,11 @@ impl BlockDevManager {
 
         let mut meta_inner = blk_meta.inner();
         meta_inner.gendisks.clear();
+        let sysfs_kobj = meta_inner.sysfs_kobj.take();
+        drop(meta_inner);
+        if let Some(kobj) = sysfs_kobj {
+            block_sysfs_remove(kobj);
+        }
         Ok(())
     }
 
@@ -387,12 +430,16 @@ pub struct BlockDevMeta {
     pub devname: DevName,
     pub major: Major,
     pub base_minor: u32,
+    /// 该设备上文件的最大预读窗口（页数），即`/sys/block/<disk>/queue/read_ahead_kb`
+    ra_pages: AtomicUsize,
     inner: Mutex<InnerBlockDevMeta>,
 }
 
 pub struct InnerBlockDevMeta {
     pub gendisks: GenDiskMap,
     pub dev_idx: usize,
+    /// `/sys/block/<disk>`目录
+    sysfs_kobj: Option<Arc<CommonKobj>>,
 }
 
 impl BlockDevMeta {
@@ -401,13 +448,23 @@ impl BlockDevMeta {
             devname,
             major,
             base_minor: block_dev_manager().next_minor(major),
+            ra_pages: AtomicUsize::new(VM_READAHEAD_PAGES),
             inner: Mutex::new(InnerBlockDevMeta {
                 gendisks: GenDiskMap::new(),
                 dev_idx: 0, // 默认索引为0
+                sysfs_kobj: None,
             }),
         }
     }
 
+    pub fn ra_pages(&self) -> usize {
+        self.ra_pages.load(Ordering::Relaxed)
+    }
+
+    pub fn set_ra_pages(&self, pages: usize) {
+        self.ra_pages.store(pages, Ordering::Relaxed);
+    }
+
     pub(crate) fn inner(&self) -> MutexGuard<'_, InnerBlockDevMeta> {
         self.inner.lock()
     }
@@ -4,6 +4,7 @@ pub mod block_device;
 pub mod disk_info;
 pub mod gendisk;
 pub mod manager;
+mod sysfs;
 
 #[derive(Debug)]
 #[allow(dead_code)]
@@ -0,0 +1,156 @@
+//! `/sys/block/<disk>`下的块设备队列属性
+//!
+//! 目前只提供`queue/read_ahead_kb`（该设备上文件的最大预读窗口）和
+//! `queue/logical_block_size`，格式与Linux相同。
+
+use alloc::{
+    string::{String, ToString},
+    sync::Arc,
+};
+use system_error::SystemError;
+
+use crate::{
+    arch::MMArch,
+    driver::base::kobject::{
+        CommonKobj, DynamicKObjKType, KObjType, KObject, KObjectManager, KObjectSysFSOps,
+    },
+    filesystem::{
+        sysfs::{
+            file::sysfs_emit_str, Attribute, AttributeGroup, SysFSOps, SysFSOpsSupport,
+            SYSFS_ATTR_MODE_RO, SYSFS_ATTR_MODE_RW,
+        },
+        vfs::InodeMode,
+    },
+    libs::spinlock::SpinLock,
+    mm::MemoryManagementArch,
+};
+
+use super::{block_device::BlockDevice, manager::block_dev_manager};
+
+/// `/sys/block`目录，第一次注册块设备时创建
+static SYS_BLOCK_KOBJ: SpinLock<Option<Arc<CommonKobj>>> = SpinLock::new(None);
+
+fn sys_block_kobj() -> Result<Arc<CommonKobj>, SystemError> {
+    let mut guard = SYS_BLOCK_KOBJ.lock();
+    if let Some(kobj) = guard.as_ref() {
+        return Ok(kobj.clone());
+    }
+    let kobj = CommonKobj::new("block".to_string());
+    KObjectManager::init_and_add_kobj(kobj.clone(), Some(&DynamicKObjKType))?;
+    *guard = Some(kobj.clone());
+    Ok(kobj)
+}
+
+/// 为块设备创建`/sys/block/<disk>`目录
+pub(super) fn block_sysfs_add(dev: &Arc<dyn BlockDevice>) -> Result<Arc<CommonKobj>, SystemError> {
+    let parent = sys_block_kobj()? as Arc<dyn KObject>;
+    let kobj = CommonKobj::new(dev.dev_name().to_string());
+    kobj.set_parent(Some(Arc::downgrade(&parent)));
+    KObjectManager::init_and_add_kobj(kobj.clone(), Some(&BlockDiskKObjType))?;
+    Ok(kobj)
+}
+
+pub(super) fn block_sysfs_remove(kobj: Arc<CommonKobj>) {
+    KObjectManager::remove_kobj(kobj);
+}
+
+#[derive(Debug)]
+struct BlockDiskKObjType;
+
+impl KObjType for BlockDiskKObjType {
+    fn sysfs_ops(&self) -> Option<&dyn SysFSOps> {
+        Some(&KObjectSysFSOps)
+    }
+
+    fn attribute_groups(&self) -> Option<&'static [&'static dyn AttributeGroup]> {
+        Some(&[&BlockQueueAttrGroup])
+    }
+
+    fn release(&self, _kobj: Arc<dyn KObject>) {}
+}
+
+#[derive(Debug)]
+struct BlockQueueAttrGroup;
+
+impl AttributeGroup for BlockQueueAttrGroup {
+    fn name(&self) -> Option<&str> {
+        Some("queue")
+    }
+
+    fn attrs(&self) -> &[&'static dyn Attribute] {
+        &[&AttrReadAheadKb, &AttrLogicalBlockSize]
+    }
+
+    fn is_visible(
+        &self,
+        _kobj: Arc<dyn KObject>,
+        attr: &'static dyn Attribute,
+    ) -> Option<InodeMode> {
+        Some(attr.mode())
+    }
+}
+
+fn bdev_of(kobj: Arc<dyn KObject>) -> Result<Arc<dyn BlockDevice>, SystemError> {
+    let name: String = kobj.name();
+    block_dev_manager()
+        .lookup_by_name(&name)
+        .ok_or(SystemError::ENODEV)
+}
+
+#[derive(Debug)]
+struct AttrReadAheadKb;
+
+impl Attribute for AttrReadAheadKb {
+    fn name(&self) -> &str {
+        "read_ahead_kb"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RW
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW | SysFSOpsSupport::ATTR_STORE
+    }
+
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let bdev = bdev_of(kobj)?;
+        let kb = bdev.blkdev_meta().ra_pages() * (MMArch::PAGE_SIZE >> 10);
+        sysfs_emit_str(buf, &format!("{}\n", kb))
+    }
+
+    fn store(&self, kobj: Arc<dyn KObject>, buf: &[u8]) -> Result<usize, SystemError> {
+        let bdev = bdev_of(kobj)?;
+        let s = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        let kb: usize = s
+            .trim_end_matches('\0')
+            .trim()
+            .parse()
+            .map_err(|_| SystemError::EINVAL)?;
+        bdev.blkdev_meta()
+            .set_ra_pages(kb / (MMArch::PAGE_SIZE >> 10));
+        Ok(buf.len())
+    }
+}
+
+#[derive(Debug)]
+struct AttrLogicalBlockSize;
+
+impl Attribute for AttrLogicalBlockSize {
+    fn name(&self) -> &str {
+        "logical_block_size"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW
+    }
+
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let bdev = bdev_of(kobj)?;
+        sysfs_emit_str(buf, &format!("{}\n", bdev.block_size()))
+    }
+}
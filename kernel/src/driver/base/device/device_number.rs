@@ -35,6 +35,8 @@ impl Major {
     pub const MMC_BLK_MAJOR: Self = Self::new(179);
     /// PMEM block device
     pub const PMEM_BLK_MAJOR: Self = Self::new(259);
+    /// 压缩内存块设备
+    pub const ZRAM_MAJOR: Self = Self::new(252);
 
     pub const HVC_MAJOR: Self = Self::new(229);
 
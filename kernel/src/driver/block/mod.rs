@@ -1,3 +1,4 @@
 pub mod loop_device;
 pub mod pmem;
 pub mod virtio_blk;
+pub mod zram;
@@ -0,0 +1,779 @@
+use alloc::{
+    boxed::Box,
+    string::{String, ToString},
+    sync::{Arc, Weak},
+    vec,
+    vec::Vec,
+};
+use core::{
+    any::Any,
+    fmt::Debug,
+    sync::atomic::{AtomicU64, AtomicUsize, Ordering},
+};
+use system_error::SystemError;
+
+use crate::{
+    arch::MMArch,
+    driver::base::{
+        block::{
+            block_device::{BlockDevice, BlockId, GeneralBlockRange, LBA_SIZE},
+            disk_info::Partition,
+            manager::{block_dev_manager, BlockDevMeta},
+        },
+        class::Class,
+        device::{
+            bus::Bus,
+            device_number::{DeviceNumber, Major},
+            driver::Driver,
+            DevName, Device, DeviceCommonData, DeviceType, IdTable,
+        },
+        kobject::{KObjType, KObject, KObjectCommonData, KObjectState, LockedKObjectState},
+        kset::KSet,
+    },
+    filesystem::{
+        devfs::{DevFS, DeviceINode, LockedDevFSInode},
+        kernfs::KernFSInode,
+        vfs::{utils::DName, FilePrivateData, IndexNode, InodeFlags, InodeId, InodeMode, Metadata},
+    },
+    libs::{
+        mutex::{Mutex, MutexGuard},
+        rwlock::RwLock,
+        rwsem::{RwSemReadGuard, RwSemWriteGuard},
+        spinlock::{SpinLock, SpinLockGuard},
+    },
+    mm::MemoryManagementArch,
+    time::timekeep::ktime_get_real_ns,
+};
+
+use super::zcomp::{zcomp_compress, zcomp_decompress};
+
+const ZRAM_BASENAME: &str = "zram";
+/// 每页包含的扇区数
+const SECTORS_PER_PAGE: usize = MMArch::PAGE_SIZE / LBA_SIZE;
+/// 压缩后超过这个大小的页面按原样保存，解压它们得不偿失
+const ZRAM_HUGE_THRESHOLD: usize = MMArch::PAGE_SIZE / 4 * 3;
+
+/// 一个zram页面的存储方式
+#[derive(Debug, Default)]
+enum ZramSlot {
+    /// 从未写入或已被丢弃，读出全0
+    #[default]
+    Empty,
+    /// 整页由同一个u64重复填充（常见的是全0页），不占用存储
+    Same(u64),
+    /// LZ4压缩后的数据
+    Compressed(Box<[u8]>),
+    /// 不可压缩的页面，按原样保存
+    Huge(Box<[u8]>),
+}
+
+impl ZramSlot {
+    /// 保存这个页面占用的字节数
+    fn stored_size(&self) -> usize {
+        match self {
+            ZramSlot::Empty | ZramSlot::Same(_) => 0,
+            ZramSlot::Compressed(data) | ZramSlot::Huge(data) => data.len(),
+        }
+    }
+}
+
+/// 与Linux zram的`mm_stat`、`io_stat`对应的统计，以及压缩/解压的吞吐统计
+#[derive(Debug, Default)]
+pub struct ZramStats {
+    /// 保存的页面数（含same-filled页面）
+    pub pages_stored: AtomicUsize,
+    /// 压缩数据占用的字节数（huge页面按整页计）
+    pub compr_data_size: AtomicUsize,
+    /// 压缩数据占用字节数的历史最大值
+    pub max_used: AtomicUsize,
+    pub same_pages: AtomicUsize,
+    pub huge_pages: AtomicUsize,
+    /// 自设备初始化以来出现过的huge页面总数
+    pub huge_pages_since: AtomicUsize,
+
+    pub num_reads: AtomicU64,
+    pub num_writes: AtomicU64,
+    pub failed_reads: AtomicU64,
+    pub failed_writes: AtomicU64,
+    pub invalid_io: AtomicU64,
+    /// 交换槽位释放时丢弃的页面数
+    pub notify_free: AtomicU64,
+
+    /// 送入压缩器的字节数与耗时
+    pub comp_bytes: AtomicU64,
+    pub comp_ns: AtomicU64,
+    /// 解压出的字节数与耗时
+    pub decomp_bytes: AtomicU64,
+    pub decomp_ns: AtomicU64,
+}
+
+impl ZramStats {
+    fn reset(&self) {
+        for counter in [
+            &self.pages_stored,
+            &self.compr_data_size,
+            &self.max_used,
+            &self.same_pages,
+            &self.huge_pages,
+            &self.huge_pages_since,
+        ] {
+            counter.store(0, Ordering::Relaxed);
+        }
+        for counter in [
+            &self.num_reads,
+            &self.num_writes,
+            &self.failed_reads,
+            &self.failed_writes,
+            &self.invalid_io,
+            &self.notify_free,
+            &self.comp_bytes,
+            &self.comp_ns,
+            &self.decomp_bytes,
+            &self.decomp_ns,
+        ] {
+            counter.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+#[derive(Debug)]
+struct InnerZramBlockDevice {
+    device_common: DeviceCommonData,
+    kobject_common: KObjectCommonData,
+}
+
+#[cast_to([sync] Device, DeviceINode)]
+pub struct ZramBlockDevice {
+    blkdev_meta: BlockDevMeta,
+    inner: SpinLock<InnerZramBlockDevice>,
+    locked_kobj_state: LockedKObjectState,
+    self_ref: Weak<Self>,
+    parent: RwLock<Weak<LockedDevFSInode>>,
+    fs: RwLock<Weak<DevFS>>,
+    raw_dev: DeviceNumber,
+    /// 设备大小（字节），为0表示尚未初始化
+    disksize: AtomicUsize,
+    /// 串行化disksize的设置与reset
+    init_lock: Mutex<()>,
+    table: SpinLock<Vec<ZramSlot>>,
+    stats: ZramStats,
+}
+
+impl Debug for ZramBlockDevice {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("ZramBlockDevice")
+            .field("devname", &self.blkdev_meta.devname)
+            .field("disksize", &self.disksize())
+            .finish()
+    }
+}
+
+impl ZramBlockDevice {
+    pub(super) fn new(id: usize) -> Arc<Self> {
+        let devname = DevName::new(format!("{ZRAM_BASENAME}{id}"), id);
+
+        Arc::new_cyclic(|self_ref| {
+            let blkdev_meta = BlockDevMeta::new(devname, Major::ZRAM_MAJOR);
+            let raw_dev = DeviceNumber::new(blkdev_meta.major, blkdev_meta.base_minor);
+
+            Self {
+                blkdev_meta,
+                inner: SpinLock::new(InnerZramBlockDevice {
+                    device_common: DeviceCommonData::default(),
+                    kobject_common: KObjectCommonData::default(),
+                }),
+                locked_kobj_state: LockedKObjectState::default(),
+                self_ref: self_ref.clone(),
+                parent: RwLock::new(Weak::default()),
+                fs: RwLock::new(Weak::default()),
+                raw_dev,
+                disksize: AtomicUsize::new(0),
+                init_lock: Mutex::new(()),
+                table: SpinLock::new(Vec::new()),
+                stats: ZramStats::default(),
+            }
+        })
+    }
+
+    fn inner(&self) -> SpinLockGuard<'_, InnerZramBlockDevice> {
+        self.inner.lock_irqsave()
+    }
+
+    pub fn disksize(&self) -> usize {
+        self.disksize.load(Ordering::Acquire)
+    }
+
+    pub fn stats(&self) -> &ZramStats {
+        &self.stats
+    }
+
+    /// 槽位表本身占用的内存
+    pub fn table_size(&self) -> usize {
+        self.table.lock().len() * core::mem::size_of::<ZramSlot>()
+    }
+
+    /// 设置设备大小并注册块设备（写入sysfs的`disksize`）
+    ///
+    /// 块设备层在注册时缓存设备的容量，因此zram直到设置了大小才出现在`/dev`中，
+    /// 修改大小需要先reset。
+    pub fn set_disksize(&self, size: usize) -> Result<(), SystemError> {
+        let _guard = self.init_lock.lock();
+        if self.disksize() != 0 {
+            return Err(SystemError::EBUSY);
+        }
+        let size = size / MMArch::PAGE_SIZE * MMArch::PAGE_SIZE;
+        if size == 0 {
+            return Err(SystemError::EINVAL);
+        }
+
+        let mut slots = Vec::new();
+        slots
+            .try_reserve_exact(size / MMArch::PAGE_SIZE)
+            .map_err(|_| SystemError::ENOMEM)?;
+        slots.resize_with(size / MMArch::PAGE_SIZE, ZramSlot::default);
+        *self.table.lock() = slots;
+        self.stats.reset();
+        self.disksize.store(size, Ordering::Release);
+
+        let dev = self.self_ref.upgrade().unwrap() as Arc<dyn BlockDevice>;
+        if let Err(e) = block_dev_manager().register(dev) {
+            self.disksize.store(0, Ordering::Release);
+            drop(core::mem::take(&mut *self.table.lock()));
+            return Err(e);
+        }
+        log::info!(
+            "zram: /dev/{} initialized, disksize={:#x}",
+            self.blkdev_meta.devname.name(),
+            size
+        );
+        Ok(())
+    }
+
+    /// 注销块设备并释放所有数据（写入sysfs的`reset`）
+    pub fn reset(&self) -> Result<(), SystemError> {
+        let _guard = self.init_lock.lock();
+        if self.disksize() == 0 {
+            return Ok(());
+        }
+        let dev = self.self_ref.upgrade().unwrap() as Arc<dyn BlockDevice>;
+        if crate::mm::swap::swapfile::swap_uses_block_device(&dev) {
+            return Err(SystemError::EBUSY);
+        }
+        block_dev_manager().unregister(&dev)?;
+
+        self.disksize.store(0, Ordering::Release);
+        let slots = core::mem::take(&mut *self.table.lock());
+        drop(slots);
+        self.stats.reset();
+        Ok(())
+    }
+
+    fn nr_pages(&self) -> usize {
+        self.disksize() / MMArch::PAGE_SIZE
+    }
+
+    /// 按照页面内容决定存储方式，压缩在槽位表的锁之外进行
+    fn encode_page(&self, data: &[u8]) -> ZramSlot {
+        if let Some(pattern) = same_filled_pattern(data) {
+            return ZramSlot::Same(pattern);
+        }
+
+        let start = ktime_get_real_ns();
+        let compressed = zcomp_compress(data, ZRAM_HUGE_THRESHOLD, |out| {
+            out.map(|out| Box::<[u8]>::from(out))
+        });
+        let elapsed = ktime_get_real_ns().saturating_sub(start).max(0) as u64;
+        self.stats
+            .comp_bytes
+            .fetch_add(data.len() as u64, Ordering::Relaxed);
+        self.stats.comp_ns.fetch_add(elapsed, Ordering::Relaxed);
+
+        match compressed {
+            Some(data) => ZramSlot::Compressed(data),
+            None => ZramSlot::Huge(Box::from(data)),
+        }
+    }
+
+    /// 把`slot`放入第`index`页，调用者持有槽位表的锁。返回被替换的旧槽位
+    fn replace_slot(&self, table: &mut [ZramSlot], index: usize, slot: ZramSlot) -> ZramSlot {
+        let old = core::mem::replace(&mut table[index], slot);
+        self.account_slot(&old, false);
+        self.account_slot(&table[index], true);
+        old
+    }
+
+    fn account_slot(&self, slot: &ZramSlot, add: bool) {
+        let stats = &self.stats;
+        let update = |counter: &AtomicUsize, val: usize| {
+            if add {
+                counter.fetch_add(val, Ordering::Relaxed);
+            } else {
+                counter.fetch_sub(val, Ordering::Relaxed);
+            }
+        };
+        match slot {
+            ZramSlot::Empty => return,
+            ZramSlot::Same(_) => update(&stats.same_pages, 1),
+            ZramSlot::Huge(_) => {
+                update(&stats.huge_pages, 1);
+                if add {
+                    stats.huge_pages_since.fetch_add(1, Ordering::Relaxed);
+                }
+            }
+            ZramSlot::Compressed(_) => {}
+        }
+        update(&stats.pages_stored, 1);
+        update(&stats.compr_data_size, slot.stored_size());
+        if add {
+            stats.max_used.fetch_max(
+                stats.compr_data_size.load(Ordering::Relaxed),
+                Ordering::Relaxed,
+            );
+        }
+    }
+
+    /// 把槽位的内容解码到`dst`（一整页）中
+    fn decode_slot(&self, slot: &ZramSlot, dst: &mut [u8]) -> Result<(), SystemError> {
+        match slot {
+            ZramSlot::Empty => dst.fill(0),
+            ZramSlot::Same(pattern) => {
+                for chunk in dst.chunks_exact_mut(8) {
+                    chunk.copy_from_slice(&pattern.to_ne_bytes());
+                }
+            }
+            ZramSlot::Huge(data) => dst.copy_from_slice(data),
+            ZramSlot::Compressed(data) => {
+                let start = ktime_get_real_ns();
+                let len = zcomp_decompress(data, dst)?;
+                let elapsed = ktime_get_real_ns().saturating_sub(start).max(0) as u64;
+                if len != dst.len() {
+                    return Err(SystemError::EIO);
+                }
+                self.stats
+                    .decomp_bytes
+                    .fetch_add(len as u64, Ordering::Relaxed);
+                self.stats.decomp_ns.fetch_add(elapsed, Ordering::Relaxed);
+            }
+        }
+        Ok(())
+    }
+
+    fn read_page(&self, index: usize, dst: &mut [u8]) -> Result<(), SystemError> {
+        let table = self.table.lock();
+        let slot = table.get(index).ok_or(SystemError::EINVAL)?;
+        self.decode_slot(slot, dst).inspect_err(|e| {
+            log::error!("zram: failed to decode page {}: {:?}", index, e);
+        })
+    }
+
+    fn write_page(&self, index: usize, data: &[u8]) -> Result<(), SystemError> {
+        let slot = self.encode_page(data);
+        let mut table = self.table.lock();
+        if index >= table.len() {
+            return Err(SystemError::EINVAL);
+        }
+        let old = self.replace_slot(&mut table, index, slot);
+        drop(table);
+        drop(old);
+        Ok(())
+    }
+
+    /// 只写入页面的一部分：先解码整页，修改后重新编码
+    ///
+    /// 整个读-改-写过程都持有槽位表的锁，保证同一页上的并发部分写不会相互覆盖。
+    fn write_partial_page(
+        &self,
+        index: usize,
+        offset: usize,
+        data: &[u8],
+    ) -> Result<(), SystemError> {
+        let mut page = vec![0u8; MMArch::PAGE_SIZE];
+        let mut table = self.table.lock();
+        let slot = table.get(index).ok_or(SystemError::EINVAL)?;
+        self.decode_slot(slot, &mut page)?;
+        page[offset..offset + data.len()].copy_from_slice(data);
+        let slot = self.encode_page(&page);
+        let old = self.replace_slot(&mut table, index, slot);
+        drop(table);
+        drop(old);
+        Ok(())
+    }
+
+    /// 丢弃从`index`开始的`count`页，之后读出全0
+    fn discard_pages(&self, index: usize, count: usize) -> usize {
+        let mut freed = Vec::new();
+        let mut table = self.table.lock();
+        let end = (index + count).min(table.len());
+        for i in index.min(end)..end {
+            if !matches!(table[i], ZramSlot::Empty) {
+                freed.push(self.replace_slot(&mut table, i, ZramSlot::Empty));
+            }
+        }
+        drop(table);
+        freed.len()
+    }
+
+    fn check_io(&self, lba: BlockId, count: usize, buf_len: usize) -> Result<usize, SystemError> {
+        let len = count.checked_mul(LBA_SIZE).ok_or(SystemError::EOVERFLOW)?;
+        let end = lba
+            .checked_add(count)
+            .and_then(|end| end.checked_mul(LBA_SIZE))
+            .ok_or(SystemError::EOVERFLOW)?;
+        if len > buf_len || end > self.disksize() {
+            self.stats.invalid_io.fetch_add(1, Ordering::Relaxed);
+            return Err(SystemError::EINVAL);
+        }
+        Ok(len)
+    }
+}
+
+/// 页面由同一个u64重复填充时返回这个值
+fn same_filled_pattern(data: &[u8]) -> Option<u64> {
+    let mut words = data
+        .chunks_exact(8)
+        .map(|c| u64::from_ne_bytes(c.try_into().unwrap()));
+    let first = words.next()?;
+    words.all(|w| w == first).then_some(first)
+}
+
+impl IndexNode for ZramBlockDevice {
+    fn fs(&self) -> Arc<dyn crate::filesystem::vfs::FileSystem> {
+        self.fs
+            .read()
+            .upgrade()
+            .expect("ZramBlockDevice fs is not set")
+    }
+
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn read_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        _buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        Err(SystemError::ENOSYS)
+    }
+
+    fn write_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        _buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        Err(SystemError::ENOSYS)
+    }
+
+    fn list(&self) -> Result<Vec<String>, SystemError> {
+        Err(SystemError::ENOSYS)
+    }
+
+    fn metadata(&self) -> Result<Metadata, SystemError> {
+        let size = self.disksize();
+        Ok(Metadata {
+            dev_id: 0,
+            inode_id: InodeId::new(0),
+            size: size as i64,
+            blk_size: LBA_SIZE,
+            blocks: size / LBA_SIZE,
+            atime: Default::default(),
+            mtime: Default::default(),
+            ctime: Default::default(),
+            btime: Default::default(),
+            file_type: crate::filesystem::vfs::FileType::BlockDevice,
+            mode: InodeMode::from_bits_truncate(0o660),
+            flags: InodeFlags::empty(),
+            nlinks: 1,
+            uid: 0,
+            gid: 0,
+            raw_dev: self.raw_dev,
+        })
+    }
+
+    fn parent(&self) -> Result<Arc<dyn IndexNode>, SystemError> {
+        let parent = self.parent.read();
+        if let Some(parent) = parent.upgrade() {
+            return Ok(parent as Arc<dyn IndexNode>);
+        }
+        Err(SystemError::ENOENT)
+    }
+
+    fn close(&self, _data: MutexGuard<FilePrivateData>) -> Result<(), SystemError> {
+        Ok(())
+    }
+
+    fn dname(&self) -> Result<DName, SystemError> {
+        Ok(DName::from(self.blkdev_meta.devname.clone().as_ref()))
+    }
+
+    fn open(
+        &self,
+        _data: MutexGuard<FilePrivateData>,
+        _mode: &crate::filesystem::vfs::file::FileFlags,
+    ) -> Result<(), SystemError> {
+        Ok(())
+    }
+}
+
+impl DeviceINode for ZramBlockDevice {
+    fn set_fs(&self, fs: Weak<DevFS>) {
+        *self.fs.write() = fs;
+    }
+
+    fn set_parent(&self, parent: Weak<LockedDevFSInode>) {
+        *self.parent.write() = parent;
+    }
+}
+
+impl BlockDevice for ZramBlockDevice {
+    fn dev_name(&self) -> &DevName {
+        &self.blkdev_meta.devname
+    }
+
+    fn blkdev_meta(&self) -> &BlockDevMeta {
+        &self.blkdev_meta
+    }
+
+    fn disk_range(&self) -> GeneralBlockRange {
+        let blocks = self.disksize() / LBA_SIZE;
+        GeneralBlockRange::new(0, blocks).unwrap_or(GeneralBlockRange {
+            lba_start: 0,
+            lba_end: 0,
+        })
+    }
+
+    fn read_at_sync(
+        &self,
+        lba_id_start: BlockId,
+        count: usize,
+        buf: &mut [u8],
+    ) -> Result<usize, SystemError> {
+        if count == 0 {
+            return Ok(0);
+        }
+        let len = self.check_io(lba_id_start, count, buf.len())?;
+        self.stats.num_reads.fetch_add(1, Ordering::Relaxed);
+
+        let mut page = Vec::new();
+        let mut pos = lba_id_start * LBA_SIZE;
+        let mut done = 0;
+        while done < len {
+            let index = pos / MMArch::PAGE_SIZE;
+            let offset = pos % MMArch::PAGE_SIZE;
+            let chunk = (len - done).min(MMArch::PAGE_SIZE - offset);
+            let r = if chunk == MMArch::PAGE_SIZE {
+                self.read_page(index, &mut buf[done..done + chunk])
+            } else {
+                page.resize(MMArch::PAGE_SIZE, 0);
+                self.read_page(index, &mut page).map(|_| {
+                    buf[done..done + chunk].copy_from_slice(&page[offset..offset + chunk]);
+                })
+            };
+            if let Err(e) = r {
+                self.stats.failed_reads.fetch_add(1, Ordering::Relaxed);
+                return Err(e);
+            }
+            pos += chunk;
+            done += chunk;
+        }
+        Ok(len)
+    }
+
+    fn write_at_sync(
+        &self,
+        lba_id_start: BlockId,
+        count: usize,
+        buf: &[u8],
+    ) -> Result<usize, SystemError> {
+        if count == 0 {
+            return Ok(0);
+        }
+        let len = self.check_io(lba_id_start, count, buf.len())?;
+        self.stats.num_writes.fetch_add(1, Ordering::Relaxed);
+
+        let mut pos = lba_id_start * LBA_SIZE;
+        let mut done = 0;
+        while done < len {
+            let index = pos / MMArch::PAGE_SIZE;
+            let offset = pos % MMArch::PAGE_SIZE;
+            let chunk = (len - done).min(MMArch::PAGE_SIZE - offset);
+            let data = &buf[done..done + chunk];
+            let r = if chunk == MMArch::PAGE_SIZE {
+                self.write_page(index, data)
+            } else {
+                self.write_partial_page(index, offset, data)
+            };
+            if let Err(e) = r {
+                self.stats.failed_writes.fetch_add(1, Ordering::Relaxed);
+                return Err(e);
+            }
+            pos += chunk;
+            done += chunk;
+        }
+        Ok(len)
+    }
+
+    fn sync(&self) -> Result<(), SystemError> {
+        Ok(())
+    }
+
+    fn blk_size_log2(&self) -> u8 {
+        9
+    }
+
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn device(&self) -> Arc<dyn Device> {
+        self.self_ref.upgrade().unwrap()
+    }
+
+    fn block_size(&self) -> usize {
+        LBA_SIZE
+    }
+
+    fn partitions(&self) -> Vec<Arc<Partition>> {
+        Vec::new()
+    }
+
+    fn swap_slot_free_notify(&self, lba_start: BlockId, count: usize) {
+        // 只丢弃完整覆盖的页面
+        let first = lba_start.div_ceil(SECTORS_PER_PAGE);
+        let end = (lba_start + count) / SECTORS_PER_PAGE;
+        if end > first {
+            let freed = self.discard_pages(first, end - first);
+            self.stats
+                .notify_free
+                .fetch_add(freed as u64, Ordering::Relaxed);
+        }
+    }
+}
+
+impl Device for ZramBlockDevice {
+    fn dev_type(&self) -> DeviceType {
+        DeviceType::Block
+    }
+
+    fn id_table(&self) -> IdTable {
+        IdTable::new(ZRAM_BASENAME.to_string(), Some(self.raw_dev))
+    }
+
+    fn bus(&self) -> Option<Weak<dyn Bus>> {
+        self.inner().device_common.bus.clone()
+    }
+
+    fn set_bus(&self, bus: Option<Weak<dyn Bus>>) {
+        self.inner().device_common.bus = bus;
+    }
+
+    fn class(&self) -> Option<Arc<dyn Class>> {
+        let mut guard = self.inner();
+        let class = guard.device_common.class.clone()?.upgrade();
+        if class.is_none() {
+            guard.device_common.class = None;
+        }
+        class
+    }
+
+    fn set_class(&self, class: Option<Weak<dyn Class>>) {
+        self.inner().device_common.class = class;
+    }
+
+    fn driver(&self) -> Option<Arc<dyn Driver>> {
+        let mut guard = self.inner();
+        let driver = guard.device_common.driver.clone()?.upgrade();
+        if driver.is_none() {
+            guard.device_common.driver = None;
+        }
+        driver
+    }
+
+    fn set_driver(&self, driver: Option<Weak<dyn Driver>>) {
+        self.inner().device_common.driver = driver;
+    }
+
+    fn is_dead(&self) -> bool {
+        false
+    }
+
+    fn can_match(&self) -> bool {
+        self.inner().device_common.can_match
+    }
+
+    fn set_can_match(&self, can_match: bool) {
+        self.inner().device_common.can_match = can_match;
+    }
+
+    fn state_synced(&self) -> bool {
+        true
+    }
+
+    fn dev_parent(&self) -> Option<Weak<dyn Device>> {
+        self.inner().device_common.get_parent_weak_or_clear()
+    }
+
+    fn set_dev_parent(&self, parent: Option<Weak<dyn Device>>) {
+        self.inner().device_common.parent = parent;
+    }
+}
+
+impl KObject for ZramBlockDevice {
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn set_inode(&self, inode: Option<Arc<KernFSInode>>) {
+        self.inner().kobject_common.kern_inode = inode;
+    }
+
+    fn inode(&self) -> Option<Arc<KernFSInode>> {
+        self.inner().kobject_common.kern_inode.clone()
+    }
+
+    fn parent(&self) -> Option<Weak<dyn KObject>> {
+        self.inner().kobject_common.parent.clone()
+    }
+
+    fn set_parent(&self, parent: Option<Weak<dyn KObject>>) {
+        self.inner().kobject_common.parent = parent;
+    }
+
+    fn kset(&self) -> Option<Arc<KSet>> {
+        self.inner().kobject_common.kset.clone()
+    }
+
+    fn set_kset(&self, kset: Option<Arc<KSet>>) {
+        self.inner().kobject_common.kset = kset;
+    }
+
+    fn kobj_type(&self) -> Option<&'static dyn KObjType> {
+        self.inner().kobject_common.kobj_type
+    }
+
+    fn name(&self) -> String {
+        self.dev_name().to_string()
+    }
+
+    fn set_name(&self, _name: String) {}
+
+    fn kobj_state(&self) -> RwSemReadGuard<'_, KObjectState> {
+        self.locked_kobj_state.read()
+    }
+
+    fn kobj_state_mut(&self) -> RwSemWriteGuard<'_, KObjectState> {
+        self.locked_kobj_state.write()
+    }
+
+    fn set_kobj_state(&self, state: KObjectState) {
+        *self.locked_kobj_state.write() = state;
+    }
+
+    fn set_kobj_type(&self, ktype: Option<&'static dyn KObjType>) {
+        self.inner().kobject_common.kobj_type = ktype;
+    }
+}
@@ -0,0 +1,225 @@
+//! LZ4块格式（block format）的压缩与解压
+//!
+//! 只实现zram需要的单块压缩：不带帧头、校验和，输入输出都是完整的缓冲区。
+//! 压缩使用单个哈希表的贪心匹配（与LZ4的fast模式相同），
+//! 产生的数据可以被任何标准的LZ4块解压器解开。
+//!
+//! 一个块由若干个序列组成，每个序列的格式为：
+//!
+//! ```text
+//! token | [字面量长度扩展] | 字面量 | offset(u16 LE) | [匹配长度扩展]
+//! ```
+//!
+//! token的高4位是字面量长度，低4位是匹配长度减去`MINMATCH`，
+//! 取值为15时后面跟着若干个扩展字节（255表示继续）。
+//! 最后一个序列只有字面量，没有offset。
+
+use system_error::SystemError;
+
+/// 最短匹配长度
+const MINMATCH: usize = 4;
+/// 块末尾的这些字节必须是字面量
+const LAST_LITERALS: usize = 5;
+/// 距离块末尾不足这些字节时不再开始新的匹配
+const MFLIMIT: usize = 12;
+/// offset字段是u16
+const MAX_DISTANCE: usize = u16::MAX as usize;
+/// 未找到匹配时，每失败`1 << SKIP_TRIGGER`次步长加一，快速跳过不可压缩的数据
+const SKIP_TRIGGER: usize = 6;
+
+const HASH_LOG: usize = 12;
+/// 压缩时使用的哈希表的项数
+pub const HASH_TABLE_SIZE: usize = 1 << HASH_LOG;
+
+#[inline(always)]
+fn read_u32(src: &[u8], pos: usize) -> u32 {
+    u32::from_le_bytes([src[pos], src[pos + 1], src[pos + 2], src[pos + 3]])
+}
+
+#[inline(always)]
+fn hash(seq: u32) -> usize {
+    (seq.wrapping_mul(2654435761) >> (32 - HASH_LOG)) as usize
+}
+
+/// 向输出缓冲区写入数据，空间不足时返回None
+struct Sink<'a> {
+    buf: &'a mut [u8],
+    pos: usize,
+}
+
+impl Sink<'_> {
+    #[inline(always)]
+    fn push(&mut self, byte: u8) -> Option<()> {
+        *self.buf.get_mut(self.pos)? = byte;
+        self.pos += 1;
+        Some(())
+    }
+
+    #[inline(always)]
+    fn extend(&mut self, data: &[u8]) -> Option<()> {
+        self.buf
+            .get_mut(self.pos..self.pos + data.len())?
+            .copy_from_slice(data);
+        self.pos += data.len();
+        Some(())
+    }
+
+    fn push_len(&mut self, mut len: usize) -> Option<()> {
+        while len >= 255 {
+            self.push(255)?;
+            len -= 255;
+        }
+        self.push(len as u8)
+    }
+
+    /// 写入一个序列，`matched`为(offset, 匹配长度)，最后一个序列为None
+    fn sequence(&mut self, literals: &[u8], matched: Option<(usize, usize)>) -> Option<()> {
+        let lit_len = literals.len();
+        let ml_code = matched.map_or(0, |(_, len)| len - MINMATCH);
+        self.push(((lit_len.min(15) << 4) | ml_code.min(15)) as u8)?;
+        if lit_len >= 15 {
+            self.push_len(lit_len - 15)?;
+        }
+        self.extend(literals)?;
+        if let Some((offset, _)) = matched {
+            self.extend(&(offset as u16).to_le_bytes())?;
+            if ml_code >= 15 {
+                self.push_len(ml_code - 15)?;
+            }
+        }
+        Some(())
+    }
+}
+
+/// 把`src`压缩到`dst`中
+///
+/// ## 参数
+///
+/// - `table`: 长度为`HASH_TABLE_SIZE`的哈希表，内容不需要初始化
+///
+/// ## 返回值
+///
+/// 压缩后的长度；`dst`放不下压缩结果时返回None，调用者应按不可压缩处理
+pub fn compress(src: &[u8], dst: &mut [u8], table: &mut [u32]) -> Option<usize> {
+    assert_eq!(table.len(), HASH_TABLE_SIZE);
+    debug_assert!(src.len() <= u32::MAX as usize);
+    table.fill(0);
+
+    let mut sink = Sink { buf: dst, pos: 0 };
+    let mut anchor = 0;
+
+    if src.len() > MFLIMIT {
+        // 匹配只能从match_limit之前开始，并且不能越过match_end
+        let match_limit = src.len() - MFLIMIT;
+        let match_end = src.len() - LAST_LITERALS;
+        let mut ip = 1;
+        table[hash(read_u32(src, 0))] = 0;
+
+        while ip < match_limit {
+            let seq = read_u32(src, ip);
+            let h = hash(seq);
+            let candidate = table[h] as usize;
+            table[h] = ip as u32;
+
+            if candidate >= ip || ip - candidate > MAX_DISTANCE || read_u32(src, candidate) != seq {
+                ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                continue;
+            }
+
+            let mut len = MINMATCH;
+            while ip + len < match_end && src[candidate + len] == src[ip + len] {
+                len += 1;
+            }
+            // 向前扩展匹配，吃掉尚未输出的字面量
+            let (mut start, mut back) = (ip, candidate);
+            while start > anchor && back > 0 && src[start - 1] == src[back - 1] {
+                start -= 1;
+                back -= 1;
+                len += 1;
+            }
+
+            sink.sequence(&src[anchor..start], Some((start - back, len)))?;
+            ip = start + len;
+            anchor = ip;
+            // 匹配末尾附近的位置也记入哈希表，提高下一次命中的概率
+            if ip - 2 < match_limit {
+                table[hash(read_u32(src, ip - 2))] = (ip - 2) as u32;
+            }
+        }
+    }
+
+    sink.sequence(&src[anchor..], None)?;
+    Some(sink.pos)
+}
+
+fn read_len(src: &[u8], pos: &mut usize) -> Result<usize, SystemError> {
+    let mut len = 0usize;
+    loop {
+        let byte = *src.get(*pos).ok_or(SystemError::EINVAL)?;
+        *pos += 1;
+        len = len.checked_add(byte as usize).ok_or(SystemError::EINVAL)?;
+        if byte != 255 {
+            return Ok(len);
+        }
+    }
+}
+
+/// 把LZ4块`src`解压到`dst`中
+///
+/// 会检查所有长度和offset，损坏的数据只会返回EINVAL，不会越界访问。
+///
+/// ## 返回值
+///
+/// 解压后的长度
+pub fn decompress(src: &[u8], dst: &mut [u8]) -> Result<usize, SystemError> {
+    let mut ip = 0;
+    let mut op = 0;
+    loop {
+        let token = *src.get(ip).ok_or(SystemError::EINVAL)?;
+        ip += 1;
+
+        let mut lit_len = (token >> 4) as usize;
+        if lit_len == 15 {
+            lit_len += read_len(src, &mut ip)?;
+        }
+        let literals = src.get(ip..ip + lit_len).ok_or(SystemError::EINVAL)?;
+        dst.get_mut(op..op + lit_len)
+            .ok_or(SystemError::EINVAL)?
+            .copy_from_slice(literals);
+        ip += lit_len;
+        op += lit_len;
+
+        if ip == src.len() {
+            return Ok(op);
+        }
+
+        let offset = match src.get(ip..ip + 2) {
+            Some(bytes) => u16::from_le_bytes([bytes[0], bytes[1]]) as usize,
+            None => return Err(SystemError::EINVAL),
+        };
+        ip += 2;
+        if offset == 0 || offset > op {
+            return Err(SystemError::EINVAL);
+        }
+
+        let mut len = (token & 0xf) as usize;
+        if len == 15 {
+            len += read_len(src, &mut ip)?;
+        }
+        len += MINMATCH;
+        if op + len > dst.len() {
+            return Err(SystemError::EINVAL);
+        }
+
+        let start = op - offset;
+        if offset >= len {
+            dst.copy_within(start..start + len, op);
+        } else {
+            // 重叠的匹配（例如重复的短模式）必须逐字节复制
+            for i in 0..len {
+                dst[op + i] = dst[start + i];
+            }
+        }
+        op += len;
+    }
+}
@@ -0,0 +1,74 @@
+//! zram 压缩内存块设备
+//!
+//! 写入的数据按页用LZ4压缩后保存在内核堆中，可以用作交换设备或临时磁盘。
+//! 由同一个u64重复填充的页面（例如全0页）只记录填充值，不占用存储；
+//! 压缩后仍然很大的页面按原样保存。作为交换设备时，交换槽位被释放的同时
+//! 丢弃对应的页面（见`BlockDevice::swap_slot_free_notify`）。
+//!
+//! 使用方法与Linux相同：
+//!
+//! ```text
+//! echo 256M > /sys/devices/virtual/block/zram0/disksize
+//! swapon /dev/zram0
+//! ```
+//!
+//! # 模块结构
+//!
+//! - `lz4`: LZ4块格式的压缩与解压
+//! - `zcomp`: 每CPU的压缩流
+//! - `device`: zram块设备及其页面表
+//! - `sysfs`: 控制与统计属性
+
+mod device;
+mod lz4;
+mod sysfs;
+mod zcomp;
+
+use alloc::{string::ToString, sync::Arc, vec::Vec};
+use system_error::SystemError;
+use unified_init::macros::unified_init;
+
+use crate::{
+    driver::base::{
+        device::sys_devices_virtual_kobj,
+        kobject::{CommonKobj, DynamicKObjKType, KObject, KObjectManager},
+    },
+    init::initcall::INITCALL_DEVICE,
+    libs::spinlock::SpinLock,
+};
+
+pub use self::device::{ZramBlockDevice, ZramStats};
+
+/// 启动时创建的zram设备数量
+const ZRAM_NUM_DEVICES: usize = 1;
+
+static ZRAM_DEVICES: SpinLock<Vec<Arc<ZramBlockDevice>>> = SpinLock::new(Vec::new());
+
+/// 根据编号获取zram设备
+pub fn zram_device(id: usize) -> Option<Arc<ZramBlockDevice>> {
+    ZRAM_DEVICES.lock().get(id).cloned()
+}
+
+#[unified_init(INITCALL_DEVICE)]
+fn zram_init() -> Result<(), SystemError> {
+    zcomp::zcomp_init();
+
+    // zram设备在设置disksize之前不会注册到块设备层，
+    // 控制属性直接挂在/sys/devices/virtual/block/zramN下
+    let block_kobj = CommonKobj::new("block".to_string());
+    let parent = sys_devices_virtual_kobj() as Arc<dyn KObject>;
+    block_kobj.set_parent(Some(Arc::downgrade(&parent)));
+    KObjectManager::init_and_add_kobj(block_kobj.clone(), Some(&DynamicKObjKType))?;
+
+    for id in 0..ZRAM_NUM_DEVICES {
+        let dev = ZramBlockDevice::new(id);
+        KObject::set_parent(
+            dev.as_ref(),
+            Some(Arc::downgrade(&(block_kobj.clone() as Arc<dyn KObject>))),
+        );
+        KObjectManager::init_and_add_kobj(dev.clone(), Some(&sysfs::ZramKObjType))?;
+        ZRAM_DEVICES.lock().push(dev);
+    }
+    log::info!("zram: {} device(s) created", ZRAM_NUM_DEVICES);
+    Ok(())
+}
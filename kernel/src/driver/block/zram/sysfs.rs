@@ -0,0 +1,311 @@
+//! `/sys/devices/virtual/block/zramN`下的控制与统计属性
+//!
+//! 属性的名字和格式与Linux zram保持一致（`disksize`、`reset`、`comp_algorithm`、
+//! `mm_stat`、`io_stat`），另外增加`perf_stat`导出压缩率和压缩/解压吞吐。
+
+use alloc::sync::Arc;
+use core::sync::atomic::Ordering;
+use system_error::SystemError;
+
+use crate::{
+    driver::base::kobject::{KObjType, KObject, KObjectSysFSOps},
+    filesystem::{
+        sysfs::{
+            file::sysfs_emit_str, Attribute, AttributeGroup, SysFSOps, SysFSOpsSupport,
+            SYSFS_ATTR_MODE_RO, SYSFS_ATTR_MODE_RW, SYSFS_ATTR_MODE_WO,
+        },
+        vfs::InodeMode,
+    },
+    libs::casting::DowncastArc,
+};
+
+use super::{device::ZramBlockDevice, zcomp::ZCOMP_ALGORITHM};
+
+#[derive(Debug)]
+pub(super) struct ZramKObjType;
+
+impl KObjType for ZramKObjType {
+    fn sysfs_ops(&self) -> Option<&dyn SysFSOps> {
+        Some(&KObjectSysFSOps)
+    }
+
+    fn attribute_groups(&self) -> Option<&'static [&'static dyn AttributeGroup]> {
+        Some(&[&ZramAttrGroup])
+    }
+
+    fn release(&self, _kobj: Arc<dyn KObject>) {}
+}
+
+#[derive(Debug)]
+struct ZramAttrGroup;
+
+impl AttributeGroup for ZramAttrGroup {
+    fn name(&self) -> Option<&str> {
+        None
+    }
+
+    fn attrs(&self) -> &[&'static dyn Attribute] {
+        &[
+            &AttrDisksize,
+            &AttrReset,
+            &AttrCompAlgorithm,
+            &AttrMmStat,
+            &AttrIoStat,
+            &AttrPerfStat,
+        ]
+    }
+
+    fn is_visible(
+        &self,
+        _kobj: Arc<dyn KObject>,
+        attr: &'static dyn Attribute,
+    ) -> Option<InodeMode> {
+        Some(attr.mode())
+    }
+}
+
+fn zram_of(kobj: Arc<dyn KObject>) -> Result<Arc<ZramBlockDevice>, SystemError> {
+    kobj.downcast_arc::<ZramBlockDevice>()
+        .ok_or(SystemError::EINVAL)
+}
+
+fn parse_str(buf: &[u8]) -> Result<&str, SystemError> {
+    let s = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+    Ok(s.trim_end_matches('\0').trim())
+}
+
+/// 解析带K/M/G后缀的大小
+fn parse_size(s: &str) -> Result<usize, SystemError> {
+    let (digits, shift) = match s.as_bytes().last() {
+        Some(b'k' | b'K') => (&s[..s.len() - 1], 10),
+        Some(b'm' | b'M') => (&s[..s.len() - 1], 20),
+        Some(b'g' | b'G') => (&s[..s.len() - 1], 30),
+        _ => (s, 0),
+    };
+    let val: usize = digits.parse().map_err(|_| SystemError::EINVAL)?;
+    val.checked_mul(1 << shift).ok_or(SystemError::EINVAL)
+}
+
+/// 每秒处理的MiB数，保留两位小数
+fn throughput(bytes: u64, ns: u64) -> (u64, u64) {
+    if ns == 0 {
+        return (0, 0);
+    }
+    let centi = (bytes as u128 * 1_000_000_000 * 100 / ns as u128 / (1 << 20)) as u64;
+    (centi / 100, centi % 100)
+}
+
+#[derive(Debug)]
+struct AttrDisksize;
+
+impl Attribute for AttrDisksize {
+    fn name(&self) -> &str {
+        "disksize"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RW
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW | SysFSOpsSupport::ATTR_STORE
+    }
+
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        sysfs_emit_str(buf, &format!("{}\n", zram.disksize()))
+    }
+
+    fn store(&self, kobj: Arc<dyn KObject>, buf: &[u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        let size = parse_size(parse_str(buf)?)?;
+        zram.set_disksize(size)?;
+        Ok(buf.len())
+    }
+}
+
+#[derive(Debug)]
+struct AttrReset;
+
+impl Attribute for AttrReset {
+    fn name(&self) -> &str {
+        "reset"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_WO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_STORE
+    }
+
+    fn store(&self, kobj: Arc<dyn KObject>, buf: &[u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        let val: usize = parse_str(buf)?.parse().map_err(|_| SystemError::EINVAL)?;
+        if val != 0 {
+            zram.reset()?;
+        }
+        Ok(buf.len())
+    }
+}
+
+#[derive(Debug)]
+struct AttrCompAlgorithm;
+
+impl Attribute for AttrCompAlgorithm {
+    fn name(&self) -> &str {
+        "comp_algorithm"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RW
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW | SysFSOpsSupport::ATTR_STORE
+    }
+
+    fn show(&self, _kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        sysfs_emit_str(buf, &format!("[{}]\n", ZCOMP_ALGORITHM))
+    }
+
+    /// 只支持lz4，写入其他算法返回EINVAL
+    fn store(&self, _kobj: Arc<dyn KObject>, buf: &[u8]) -> Result<usize, SystemError> {
+        if parse_str(buf)? != ZCOMP_ALGORITHM {
+            return Err(SystemError::EINVAL);
+        }
+        Ok(buf.len())
+    }
+}
+
+#[derive(Debug)]
+struct AttrMmStat;
+
+impl Attribute for AttrMmStat {
+    fn name(&self) -> &str {
+        "mm_stat"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW
+    }
+
+    /// orig_data_size compr_data_size mem_used_total mem_limit mem_used_max
+    /// same_pages pages_compacted huge_pages huge_pages_since
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        let stats = zram.stats();
+        let page_size = crate::arch::MMArch::PAGE_SIZE;
+        let table = zram.table_size();
+        let s = format!(
+            "{:>8} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8}\n",
+            stats.pages_stored.load(Ordering::Relaxed) * page_size,
+            stats.compr_data_size.load(Ordering::Relaxed),
+            stats.compr_data_size.load(Ordering::Relaxed) + table,
+            0,
+            stats.max_used.load(Ordering::Relaxed) + table,
+            stats.same_pages.load(Ordering::Relaxed),
+            0,
+            stats.huge_pages.load(Ordering::Relaxed),
+            stats.huge_pages_since.load(Ordering::Relaxed),
+        );
+        sysfs_emit_str(buf, &s)
+    }
+}
+
+#[derive(Debug)]
+struct AttrIoStat;
+
+impl Attribute for AttrIoStat {
+    fn name(&self) -> &str {
+        "io_stat"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW
+    }
+
+    /// failed_reads failed_writes invalid_io notify_free
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        let stats = zram.stats();
+        let s = format!(
+            "{:>8} {:>8} {:>8} {:>8}\n",
+            stats.failed_reads.load(Ordering::Relaxed),
+            stats.failed_writes.load(Ordering::Relaxed),
+            stats.invalid_io.load(Ordering::Relaxed),
+            stats.notify_free.load(Ordering::Relaxed),
+        );
+        sysfs_emit_str(buf, &s)
+    }
+}
+
+#[derive(Debug)]
+struct AttrPerfStat;
+
+impl Attribute for AttrPerfStat {
+    fn name(&self) -> &str {
+        "perf_stat"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW
+    }
+
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let zram = zram_of(kobj)?;
+        let stats = zram.stats();
+        let page_size = crate::arch::MMArch::PAGE_SIZE;
+        let orig = stats.pages_stored.load(Ordering::Relaxed) * page_size;
+        let compr = stats.compr_data_size.load(Ordering::Relaxed);
+        let ratio = if compr == 0 {
+            0
+        } else {
+            orig as u64 * 100 / compr as u64
+        };
+        let comp_bytes = stats.comp_bytes.load(Ordering::Relaxed);
+        let comp_ns = stats.comp_ns.load(Ordering::Relaxed);
+        let decomp_bytes = stats.decomp_bytes.load(Ordering::Relaxed);
+        let decomp_ns = stats.decomp_ns.load(Ordering::Relaxed);
+        let (comp_mb, comp_frac) = throughput(comp_bytes, comp_ns);
+        let (decomp_mb, decomp_frac) = throughput(decomp_bytes, decomp_ns);
+
+        let s = format!(
+            "compr_ratio {}.{:02}\n\
+             num_reads {}\n\
+             num_writes {}\n\
+             comp_bytes {}\n\
+             comp_ns {}\n\
+             comp_mbps {}.{:02}\n\
+             decomp_bytes {}\n\
+             decomp_ns {}\n\
+             decomp_mbps {}.{:02}\n",
+            ratio / 100,
+            ratio % 100,
+            stats.num_reads.load(Ordering::Relaxed),
+            stats.num_writes.load(Ordering::Relaxed),
+            comp_bytes,
+            comp_ns,
+            comp_mb,
+            comp_frac,
+            decomp_bytes,
+            decomp_ns,
+            decomp_mb,
+            decomp_frac,
+        );
+        sysfs_emit_str(buf, &s)
+    }
+}
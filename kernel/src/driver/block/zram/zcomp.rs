@@ -0,0 +1,71 @@
+//! 每CPU的压缩流
+//!
+//! 压缩需要一个哈希表和一个输出缓冲区。每个CPU持有一份，
+//! 并发写入不同zram页面时不会争用同一个缓冲区，也不需要在每次压缩时分配内存。
+//! 缓冲区在该CPU第一次压缩时才分配，没有使用zram的系统不会占用这部分内存。
+
+use alloc::{vec, vec::Vec};
+use system_error::SystemError;
+
+use crate::{
+    arch::MMArch,
+    libs::{lazy_init::Lazy, spinlock::SpinLock},
+    mm::{
+        percpu::{PerCpu, PerCpuVar},
+        MemoryManagementArch,
+    },
+};
+
+use super::lz4;
+
+/// 当前使用的压缩算法的名字
+pub const ZCOMP_ALGORITHM: &str = "lz4";
+
+#[derive(Debug)]
+struct ZcompStrm {
+    table: Vec<u32>,
+    buf: Vec<u8>,
+}
+
+impl ZcompStrm {
+    const fn new() -> Self {
+        Self {
+            table: Vec::new(),
+            buf: Vec::new(),
+        }
+    }
+}
+
+static ZCOMP_STREAMS: Lazy<PerCpuVar<SpinLock<ZcompStrm>>> = PerCpuVar::define_lazy();
+
+pub fn zcomp_init() {
+    let mut streams = Vec::with_capacity(PerCpu::MAX_CPU_NUM as usize);
+    for _ in 0..PerCpu::MAX_CPU_NUM {
+        streams.push(SpinLock::new(ZcompStrm::new()));
+    }
+    ZCOMP_STREAMS.init(PerCpuVar::new(streams).unwrap());
+}
+
+/// 用当前CPU的压缩流压缩一页数据
+///
+/// 压缩结果只在`f`执行期间有效；压缩后的长度超过`limit`时，`f`收到None，
+/// 调用者应按不可压缩的页面处理。
+pub fn zcomp_compress<R>(src: &[u8], limit: usize, f: impl FnOnce(Option<&[u8]>) -> R) -> R {
+    debug_assert!(limit <= MMArch::PAGE_SIZE);
+    // 持有自旋锁期间不会被抢占，即使在get()之后被迁移到其他CPU，锁也保证了独占
+    let mut strm = ZCOMP_STREAMS.get().get().lock();
+    if strm.table.is_empty() {
+        strm.table = vec![0; lz4::HASH_TABLE_SIZE];
+        strm.buf = vec![0; MMArch::PAGE_SIZE];
+    }
+    let ZcompStrm { table, buf } = &mut *strm;
+    match lz4::compress(src, &mut buf[..limit], table) {
+        Some(len) => f(Some(&buf[..len])),
+        None => f(None),
+    }
+}
+
+/// 解压一页数据，解压不需要额外的状态
+pub fn zcomp_decompress(src: &[u8], dst: &mut [u8]) -> Result<usize, SystemError> {
+    lz4::decompress(src, dst)
+}
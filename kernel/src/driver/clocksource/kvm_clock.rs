@@ -7,6 +7,7 @@ use system_error::SystemError;
 use x86::msr::wrmsr;
 
 use crate::{
+    arch::mm::LockedFrameAllocator,
     arch::{
         kvm_para,
         pvclock::{self, PvclockVcpuTimeInfo, PvclockVsyscallTimeInfo, PVCLOCK_TSC_STABLE_BIT},
@@ -14,13 +15,16 @@ use crate::{
     },
     libs::spinlock::SpinLock,
     mm::{
-        allocator::page_frame::FrameAllocator,
+        page::{page_manager, PageFlags, PageType},
         percpu::{PerCpu, PerCpuVar},
         MemoryManagementArch, PhysAddr, VirtAddr,
     },
-    smp::core::smp_get_processor_id,
+    smp::{core::smp_get_processor_id, cpu::ProcessorId},
     time::{
-        clocksource::{Clocksource, ClocksourceData, ClocksourceFlags, ClocksourceMask, CycleNum},
+        clocksource::{
+            Clocksource, ClocksourceData, ClocksourceFlags, ClocksourceMask, CycleNum,
+            VdsoClockMode,
+        },
         NSEC_PER_SEC,
     },
 };
@@ -98,6 +102,14 @@ impl Clocksource for KvmClock {
         Ok(0)
     }
 
+    fn vdso_clock_mode(&self) -> VdsoClockMode {
+        if kvm_clock_vdso_stable() {
+            VdsoClockMode::Pvclock
+        } else {
+            VdsoClockMode::None
+        }
+    }
+
     fn clocksource_data(&self) -> ClocksourceData {
         self.0.lock_irqsave().data.clone()
     }
@@ -143,14 +155,15 @@ fn ensure_kvm_clock_pages() {
 }
 
 fn alloc_clock_page() -> Result<KvmClockPage, SystemError> {
-    let phys = unsafe { crate::arch::mm::LockedFrameAllocator.allocate_one() }
-        .ok_or(SystemError::ENOMEM)?;
+    // 经由page_manager分配，cpu0的页会被vDSO映射到用户态
+    let page = page_manager().create_one_page(
+        PageType::Normal,
+        PageFlags::PG_UNEVICTABLE,
+        &mut LockedFrameAllocator,
+    )?;
+    let phys = page.phys_address();
     let virt = unsafe { MMArch::phys_2_virt(phys) }.ok_or(SystemError::EINVAL)?;
 
-    unsafe {
-        MMArch::write_bytes(virt, 0, MMArch::PAGE_SIZE);
-    }
-
     Ok(KvmClockPage { phys, virt })
 }
 
@@ -180,6 +193,27 @@ fn this_cpu_pvti() -> Option<&'static PvclockVcpuTimeInfo> {
     Some(unsafe { &(*ptr).pvti })
 }
 
+/// 返回可供vDSO映射的pvclock页（cpu0的时间信息页）
+///
+/// 用户态总是读取cpu0的页，只有在[`kvm_clock_vdso_stable`]成立时结果才正确
+pub fn kvm_clock_vdso_page() -> Option<PhysAddr> {
+    if !KVM_CLOCK_READY.load(Ordering::SeqCst) {
+        return None;
+    }
+    let page = unsafe { kvm_clock_pages().force_get(ProcessorId::new(0)) };
+    page.is_valid().then_some(page.phys)
+}
+
+/// 宿主机是否保证各vcpu的pvclock一致（TSC_STABLE），此时任意cpu读cpu0的页都是正确的
+fn kvm_clock_vdso_stable() -> bool {
+    if kvm_clock_vdso_page().is_none() {
+        return false;
+    }
+    let page = unsafe { kvm_clock_pages().force_get(ProcessorId::new(0)) };
+    let pvti = unsafe { &(*(page.virt.data() as *const PvclockVsyscallTimeInfo)).pvti };
+    pvclock::pvclock_read_flags(pvti) & PVCLOCK_TSC_STABLE_BIT != 0
+}
+
 fn write_system_time_msr(phys: PhysAddr) {
     let msr = MSR_KVM_SYSTEM_TIME.load(Ordering::SeqCst);
     if msr == 0 {
@@ -9,7 +9,10 @@ use crate::{
     arch::{driver::tsc::TSCManager, CurrentTimeArch},
     libs::spinlock::SpinLock,
     time::{
-        clocksource::{Clocksource, ClocksourceData, ClocksourceFlags, ClocksourceMask, CycleNum},
+        clocksource::{
+            Clocksource, ClocksourceData, ClocksourceFlags, ClocksourceMask, CycleNum,
+            VdsoClockMode,
+        },
         TimeArch,
     },
 };
@@ -62,6 +65,20 @@ impl Clocksource for TscClocksource {
         CycleNum::new(CurrentTimeArch::get_cycles() as u64)
     }
 
+    fn vdso_clock_mode(&self) -> VdsoClockMode {
+        // 被watchdog判定为不稳定的TSC不能在用户态直接读取
+        if self
+            .0
+            .lock_irqsave()
+            .data
+            .flags
+            .contains(ClocksourceFlags::CLOCK_SOURCE_UNSTABLE)
+        {
+            return VdsoClockMode::None;
+        }
+        VdsoClockMode::Tsc
+    }
+
     fn clocksource_data(&self) -> ClocksourceData {
         let inner = self.0.lock_irqsave();
         inner.data.clone()
@@ -1,22 +1,35 @@
 use crate::driver::net::{types::InterfaceFlags, Iface};
+use crate::exception::softirq::{softirq_vectors, SoftirqNumber, SoftirqVec};
 use crate::init::initcall::INITCALL_SUBSYS;
-use crate::libs::spinlock::{SpinLock, SpinLockGuard};
-use crate::libs::wait_queue::WaitQueue;
-use crate::process::kthread::{KernelThreadClosure, KernelThreadMechanism};
-use crate::process::ProcessState;
-use alloc::boxed::Box;
-use alloc::string::ToString;
+use crate::libs::spinlock::SpinLock;
+use crate::mm::percpu::PerCpu;
+use crate::smp::core::smp_get_processor_id;
+use crate::time::timer::{clock, next_n_us_timer_jiffies};
+use alloc::collections::VecDeque;
 use alloc::sync::{Arc, Weak};
-use alloc::vec::Vec;
-use core::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+use core::sync::atomic::{AtomicU32, Ordering};
 use system_error::SystemError;
 use unified_init::macros::unified_init;
 
-lazy_static! {
-    //todo 按照软中断的做法，这里应该是每个CPU一个列表，但目前只实现单CPU版本
-    static ref GLOBAL_NAPI_MANAGER: Arc<NapiManager> = NapiManager::new();
+/// 一次NET_RX软中断最多处理的工作量，每轮询一个NAPI实例消耗它的`weight`
+const NETDEV_BUDGET: usize = 300;
+/// 一次NET_RX软中断最长的处理时间
+const NETDEV_BUDGET_USECS: u64 = 2000;
+
+/// 每个cpu的收包数据
+///
+/// https://elixir.bootlin.com/linux/v6.13/source/include/linux/netdevice.h#L3264
+struct SoftnetData {
+    /// 被调度到本cpu、等待轮询的NAPI实例
+    poll_list: SpinLock<VecDeque<Arc<NapiStruct>>>,
 }
 
+static SOFTNET_DATA: [SoftnetData; PerCpu::MAX_CPU_NUM as usize] = [const {
+    SoftnetData {
+        poll_list: SpinLock::new(VecDeque::new()),
+    }
+}; PerCpu::MAX_CPU_NUM as usize];
+
 /// # NAPI 结构体
 ///
 /// https://elixir.bootlin.com/linux/v6.13/source/include/linux/netdevice.h#L359
@@ -95,195 +108,104 @@ bitflags! {
 #[inline(never)]
 #[unified_init(INITCALL_SUBSYS)]
 pub fn napi_init() -> Result<(), SystemError> {
-    // 软中断做法
-    // let napi_handler = Arc::new(NapiSoftirq::default());
-    // softirq_vectors()
-    //     .register_softirq(SoftirqNumber::NetReceive, napi_handler)
-    //     .expect("Failed to register napi softirq");
-
-    // 软中断的方式无法唤醒 :(
-    // 使用一个专门的内核线程来处理NAPI轮询，模拟软中断的行为，相当于ksoftirq :)
-
-    let closure: Box<dyn Fn() -> i32 + Send + Sync + 'static> = Box::new(move || {
-        net_rx_action();
-        0
-    });
-    let closure = KernelThreadClosure::EmptyClosure((closure, ()));
-    let name = "napi_handler".to_string();
-    let _pcb = KernelThreadMechanism::create_and_run(closure, name)
-        .ok_or("")
-        .expect("create napi_handler thread failed");
+    // NAPI轮询会持有可睡眠的锁，NET_RX由各cpu的ksoftirqd在进程上下文中执行
+    softirq_vectors()
+        .register_softirq(SoftirqNumber::NetRx, Arc::new(NetRxSoftirq))
+        .expect("Failed to register napi softirq");
 
     log::info!("napi initialized successfully");
     Ok(())
 }
 
-fn net_rx_action() {
-    loop {
-        // 这里直接将全局的NAPI管理器的napi_list取出，清空全局的列表，避免占用锁时间过长
-        let mut inner = GLOBAL_NAPI_MANAGER.inner();
-        let mut poll_list = inner.napi_list.clone();
-        inner.napi_list.clear();
-        drop(inner);
-
-        // log::info!("NAPI softirq processing {} instances", poll_list.len());
-
-        while let Some(napi) = poll_list.pop() {
-            let has_work_left = napi.poll();
-            // log::info!("yes");
-
-            if has_work_left {
-                poll_list.push(napi);
-            } else {
-                napi_complete(napi);
-            }
-        }
+#[derive(Debug)]
+struct NetRxSoftirq;
 
-        // log::info!("napi softirq iteration complete")
+impl SoftirqVec for NetRxSoftirq {
+    fn run(&self) {
+        net_rx_action();
+    }
+}
 
-        // 若 budget 用尽后仍有 backlog，必须继续自驱动处理，不能依赖新的外部唤醒。
-        // 否则 loopback/TCP 大流量场景下，发送端已经结束后不会再触发 napi_schedule()，
-        // 剩余包会永久滞留在 backlog 中，接收端 read()/recv() 就会偶发卡死。
-        if !poll_list.is_empty() {
-            let mut inner = GLOBAL_NAPI_MANAGER.inner();
-            inner.napi_list.extend(poll_list);
-            inner.has_pending_signal.store(true, Ordering::SeqCst);
-            drop(inner);
-            continue;
+/// 轮询本cpu上被调度的NAPI实例
+///
+/// https://elixir.bootlin.com/linux/v6.13/source/net/core/dev.c#L7016
+fn net_rx_action() {
+    let sd = &SOFTNET_DATA[smp_get_processor_id().data() as usize];
+    let end = next_n_us_timer_jiffies(NETDEV_BUDGET_USECS);
+    let mut budget = NETDEV_BUDGET as isize;
+
+    // 取出当前的列表，轮询期间不持锁，新调度的实例会加到sd.poll_list上
+    let mut list = core::mem::take(&mut *sd.poll_list.lock_irqsave());
+    let mut repoll = VecDeque::new();
+
+    while let Some(napi) = list.pop_front() {
+        budget -= napi.weight as isize;
+        // 还有工作没做完，或者轮询期间又被调度过，留到下一轮
+        if napi.poll() || !napi_complete(&napi) {
+            repoll.push_back(napi);
         }
 
-        // 关键竞态：
-        // `poll()` / `poll_egress()` 期间，loopback Tx 可能再次调用 `napi_schedule()`，
-        // 把“新产生的 ingress 工作”塞回全局 `napi_list`。
-        //
-        // 由于本轮处理的是循环开始时快照出的 `poll_list`，如果这里不重新检查全局列表，
-        // 就可能出现：
-        // 1) 当前本地 `poll_list` 已空；
-        // 2) 但全局 `napi_list` 已被并发加入了新工作；
-        // 3) 当前线程仍把 `has_pending_signal` 清零并睡眠。
-        //
-        // 对 loopback/TCP 大包发送，这会把“send 过程中产生的后续本地收包”永久遗落，
-        // 直到下一次外部网络事件才被重新推进，从而表现为 recv() 偶发永久卡住。
-        let inner = GLOBAL_NAPI_MANAGER.inner();
-        if !inner.napi_list.is_empty() {
-            inner.has_pending_signal.store(true, Ordering::SeqCst);
-            drop(inner);
-            continue;
+        if budget <= 0 || clock() >= end {
+            break;
         }
+    }
 
-        // 只有确认全局队列也为空时，才真正进入睡眠。
-        inner.has_pending_signal.store(false, Ordering::SeqCst);
-        drop(inner);
-
-        let _ = wq_wait_event_interruptible!(
-            GLOBAL_NAPI_MANAGER.wait_queue(),
-            GLOBAL_NAPI_MANAGER
-                .inner()
-                .has_pending_signal
-                .load(Ordering::SeqCst),
-            {}
-        );
+    // 没处理到的排在最前面，本轮新调度的其次，需要再次轮询的放到最后
+    let mut guard = sd.poll_list.lock_irqsave();
+    list.append(&mut guard);
+    list.append(&mut repoll);
+    *guard = list;
+    // 若 budget 用尽后仍有 backlog，必须继续自驱动处理，不能依赖新的外部唤醒。
+    // 否则 loopback/TCP 大流量场景下，发送端已经结束后不会再触发 napi_schedule()，
+    // 剩余包会永久滞留在 backlog 中，接收端 read()/recv() 就会偶发卡死。
+    if !guard.is_empty() {
+        softirq_vectors().raise_softirq(SoftirqNumber::NetRx);
     }
 }
 
 /// 标记这个napi任务已经完成
-pub fn napi_complete(napi: Arc<NapiStruct>) {
-    napi.state
-        .fetch_and(!NapiState::SCHED.bits(), Ordering::SeqCst);
+///
+/// ## 返回值
+///
+/// 轮询期间又被调度过（MISSED）时返回false，实例仍处于SCHED状态，调用者需要再次轮询它
+pub fn napi_complete(napi: &NapiStruct) -> bool {
+    let prev = napi
+        .state
+        .fetch_update(Ordering::SeqCst, Ordering::SeqCst, |v| {
+            if v & NapiState::MISSED.bits() != 0 {
+                Some(v & !NapiState::MISSED.bits())
+            } else {
+                Some(v & !NapiState::SCHED.bits())
+            }
+        })
+        .unwrap();
+    prev & NapiState::MISSED.bits() == 0
 }
 
 /// 标记这个napi任务加入处理队列，已被调度
+///
+/// 实例挂到当前cpu（即收到中断的cpu）的poll_list上，由该cpu的NET_RX软中断轮询。
+/// 已经被调度的实例只记下MISSED，由正在轮询它的cpu负责再轮询一次
 pub fn napi_schedule(napi: Arc<NapiStruct>) {
-    let current_state = NapiState::from_bits_truncate(
-        napi.state
-            .fetch_or(NapiState::SCHED.bits(), Ordering::SeqCst),
-    );
-
-    if !current_state.contains(NapiState::SCHED) {
-        let new_state = current_state.union(NapiState::SCHED);
-        // log::info!("NAPI instance {} scheduled", napi.napi_id);
-        napi.state.store(new_state.bits(), Ordering::SeqCst);
-    }
-
-    let mut inner = GLOBAL_NAPI_MANAGER.inner();
-    inner.napi_list.push(napi);
-    inner.has_pending_signal.store(true, Ordering::SeqCst);
-
-    GLOBAL_NAPI_MANAGER.wakeup();
-
-    // softirq_vectors().raise_softirq(SoftirqNumber::NetReceive);
-}
-
-pub struct NapiManager {
-    inner: SpinLock<NapiManagerInner>,
-    wait_queue: WaitQueue,
-}
-
-impl NapiManager {
-    pub fn new() -> Arc<Self> {
-        let inner = SpinLock::new(NapiManagerInner {
-            has_pending_signal: AtomicBool::new(false),
-            napi_list: Vec::new(),
-        });
-        Arc::new(Self {
-            inner,
-            wait_queue: WaitQueue::default(),
+    let prev = napi
+        .state
+        .fetch_update(Ordering::SeqCst, Ordering::SeqCst, |v| {
+            if v & NapiState::SCHED.bits() != 0 {
+                Some(v | NapiState::MISSED.bits())
+            } else {
+                Some(v | NapiState::SCHED.bits())
+            }
         })
+        .unwrap();
+    if prev & NapiState::SCHED.bits() != 0 {
+        return;
     }
 
-    pub fn inner(&self) -> SpinLockGuard<'_, NapiManagerInner> {
-        // 必须使用 lock_irqsave() 关闭中断，因为 napi_schedule() 可能在中断上下文中被调用
-        // 如果使用普通的 lock()，当内核线程持有锁时发生中断，中断处理程序试图获取同一把锁会死锁
-        self.inner.lock_irqsave()
-    }
-
-    pub fn wait_queue(&self) -> &WaitQueue {
-        &self.wait_queue
-    }
-
-    pub fn wakeup(&self) {
-        self.wait_queue.wakeup(Some(ProcessState::Blocked(true)));
-    }
-}
-
-pub struct NapiManagerInner {
-    has_pending_signal: AtomicBool,
-    napi_list: Vec<Arc<NapiStruct>>,
+    // 关中断保证入队和raise在同一个cpu上
+    let mut guard = SOFTNET_DATA[smp_get_processor_id().data() as usize]
+        .poll_list
+        .lock_irqsave();
+    guard.push_back(napi);
+    softirq_vectors().raise_softirq(SoftirqNumber::NetRx);
+    drop(guard);
 }
-
-// 下面的是软中断的做法，无法唤醒，做个记录
-
-// #[derive(Debug)]
-// pub struct NapiSoftirq {
-//     running: AtomicBool,
-// }
-
-// impl Default for NapiSoftirq {
-//     fn default() -> Self {
-//         Self {
-//             running: AtomicBool::new(false),
-//         }
-//     }
-// }
-
-// impl SoftirqVec for NapiSoftirq {
-//     fn run(&self) {
-//         log::info!("NAPI softirq running");
-//         if self
-//             .running
-//             .compare_exchange(
-//                 false,
-//                 true,
-//                 core::sync::atomic::Ordering::SeqCst,
-//                 core::sync::atomic::Ordering::SeqCst,
-//             )
-//             .is_ok()
-//         {
-//             net_rx_action();
-//             self.running
-//                 .store(false, core::sync::atomic::Ordering::SeqCst);
-//         } else {
-//             log::warn!("NAPI softirq is already running");
-//         }
-//     }
-// }
@@ -68,6 +68,11 @@ impl IrqHandler for KickCpuIpiHandler {
         #[cfg(target_arch = "x86_64")]
         CurrentApic.send_eoi();
 
+        // 别的cpu可能往本cpu的hrtimer队列上放了更早的定时器
+        crate::time::clockevents::clockevents_kick_check();
+        // 加速宽限期可能在等本cpu报告静止状态
+        crate::rcu::rcu_exp_handler();
+
         // 被其他 CPU kick 时只挂起抢占请求，实际调度由顶层中断出口在
         // RCU IRQ 上下文结束后统一执行。
         ProcessManager::current_pcb()
@@ -3,11 +3,11 @@ use core::{
     intrinsics::unlikely,
     mem::{self, MaybeUninit},
     ptr::null_mut,
-    sync::atomic::{compiler_fence, fence, AtomicI16, Ordering},
+    sync::atomic::{compiler_fence, fence, AtomicBool, AtomicI16, Ordering},
 };
 
-use alloc::{boxed::Box, sync::Arc, vec::Vec};
-use log::{debug, info};
+use alloc::{boxed::Box, format, sync::Arc, vec::Vec};
+use log::{debug, info, warn};
 use num_traits::FromPrimitive;
 use system_error::SystemError;
 
@@ -15,16 +15,39 @@ use crate::{
     arch::CurrentIrqArch,
     exception::bottom_half,
     exception::InterruptArch,
-    libs::rwlock::RwLock,
+    libs::{rwlock::RwLock, wait_queue::WaitQueue},
     mm::percpu::{PerCpu, PerCpuVar},
-    process::ProcessManager,
-    sched::cputime::IrqTime,
-    smp::{core::smp_get_processor_id, cpu::ProcessorId},
-    time::timer::clock,
+    process::{
+        kthread::{KernelThreadClosure, KernelThreadMechanism},
+        ProcessManager,
+    },
+    sched::{cputime::IrqTime, sched_yield},
+    smp::{
+        core::smp_get_processor_id,
+        cpu::{smp_cpu_manager, ProcessorId},
+    },
+    time::timer::{clock, next_n_us_timer_jiffies},
 };
 
 const MAX_SOFTIRQ_NUM: u64 = 64;
 const MAX_SOFTIRQ_RESTART: i32 = 20;
+/// 一次`do_softirq`最长的处理时间，超过之后剩下的软中断交给ksoftirqd
+const MAX_SOFTIRQ_TIME_US: u64 = 2000;
+
+/// 处理函数可能睡眠的软中断：只在本cpu的ksoftirqd中以进程上下文执行，
+/// 中断退出和开启下半部时不处理它们
+const SOFTIRQ_THREADED: VecStatus = VecStatus::NET_RX;
+
+lazy_static! {
+    /// 每个cpu的ksoftirqd在这里等待软中断
+    static ref KSOFTIRQD_WAIT: Vec<WaitQueue> = (0..PerCpu::MAX_CPU_NUM)
+        .map(|_| WaitQueue::default())
+        .collect();
+}
+
+/// 已经创建了ksoftirqd的cpu
+static KSOFTIRQD_SPAWNED: [AtomicBool; PerCpu::MAX_CPU_NUM as usize] =
+    [const { AtomicBool::new(false) }; PerCpu::MAX_CPU_NUM as usize];
 
 static mut __CPU_PENDING: Option<Box<[VecStatus; PerCpu::MAX_CPU_NUM as usize]>> = None;
 static mut __SORTIRQ_VECTORS: *mut Softirq = null_mut();
@@ -42,6 +65,8 @@ pub fn softirq_init() -> Result<(), SystemError> {
             cpu_pending[i as usize] = VecStatus::default();
         }
     }
+    // 避免第一次在中断上下文中初始化
+    lazy_static::initialize(&KSOFTIRQD_WAIT);
     info!("Softirq initialized.");
     return Ok(());
 }
@@ -69,6 +94,12 @@ pub enum SoftirqNumber {
     TIMER = 0,
     VideoRefresh = 1, //帧缓冲区刷新软中断
     TASKLET = 2,
+    /// 调度器负载均衡
+    SCHED = 3,
+    /// 软中断模式的高精度定时器
+    HRTIMER = 4,
+    /// 网络收包（NAPI轮询），在ksoftirqd中执行
+    NetRx = 5,
 }
 
 impl From<u64> for SoftirqNumber {
@@ -83,6 +114,9 @@ bitflags! {
         const TIMER = 1 << 0;
         const VIDEO_REFRESH = 1 << 1;
         const TASKLET = 1 << 2;
+        const SCHED = 1 << 3;
+        const HRTIMER = 1 << 4;
+        const NET_RX = 1 << 5;
     }
 }
 
@@ -196,68 +230,88 @@ impl Softirq {
         let _preempt_guard = SoftirqPreemptGuard;
 
         // TODO pcb的flags未修改
-        let end = clock() + 500 * 2;
+        let end = next_n_us_timer_jiffies(MAX_SOFTIRQ_TIME_US);
         let cpu_id = smp_get_processor_id();
         let mut max_restart = MAX_SOFTIRQ_RESTART;
         loop {
             compiler_fence(Ordering::SeqCst);
-            let pending = cpu_pending(cpu_id).bits;
-            cpu_pending(cpu_id).bits = 0;
+            let pending = cpu_pending(cpu_id).difference(SOFTIRQ_THREADED);
+            cpu_pending(cpu_id).remove(pending);
             compiler_fence(Ordering::SeqCst);
 
             unsafe { CurrentIrqArch::interrupt_enable() };
-            if pending != 0 {
-                for i in 0..MAX_SOFTIRQ_NUM {
-                    if pending & (1 << i) == 0 {
-                        continue;
-                    }
-
-                    let table_guard = self.table.read_irqsave();
-                    let softirq_func = table_guard[i as usize].clone();
-                    drop(table_guard);
-                    if softirq_func.is_none() {
-                        continue;
-                    }
-
-                    let prev_count: usize = ProcessManager::current_pcb().preempt_count();
-
-                    softirq_func.as_ref().unwrap().run();
-                    if unlikely(prev_count != ProcessManager::current_pcb().preempt_count()) {
-                        debug!(
-                            "entered softirq {:?} with preempt_count {:?},exited with {:?}",
-                            i,
-                            prev_count,
-                            ProcessManager::current_pcb().preempt_count()
-                        );
-                        unsafe { ProcessManager::current_pcb().set_preempt_count(prev_count) };
-                    }
-                }
-            }
+            self.run_pending(pending);
             unsafe { CurrentIrqArch::interrupt_disable() };
             max_restart -= 1;
             compiler_fence(Ordering::SeqCst);
-            if cpu_pending(cpu_id).is_empty() {
-                compiler_fence(Ordering::SeqCst);
-                if clock() < end && max_restart > 0 {
-                    continue;
-                } else {
-                    break;
-                }
-            } else {
-                // TODO：当有softirqd时 唤醒它
+            if cpu_pending(cpu_id).difference(SOFTIRQ_THREADED).is_empty()
+                || clock() >= end
+                || max_restart <= 0
+            {
                 break;
             }
         }
+
+        // 处理不完的（或者只能在线程中处理的）软中断交给ksoftirqd
+        if !cpu_pending(cpu_id).is_empty() {
+            wakeup_softirqd(cpu_id);
+        }
+    }
+
+    /// 依次调用`pending`中各个软中断的处理函数
+    fn run_pending(&self, pending: VecStatus) {
+        for i in 0..MAX_SOFTIRQ_NUM {
+            if pending.bits & (1 << i) == 0 {
+                continue;
+            }
+
+            let table_guard = self.table.read_irqsave();
+            let softirq_func = table_guard[i as usize].clone();
+            drop(table_guard);
+            if softirq_func.is_none() {
+                continue;
+            }
+
+            let prev_count: usize = ProcessManager::current_pcb().preempt_count();
+
+            softirq_func.as_ref().unwrap().run();
+            if unlikely(prev_count != ProcessManager::current_pcb().preempt_count()) {
+                debug!(
+                    "entered softirq {:?} with preempt_count {:?},exited with {:?}",
+                    i,
+                    prev_count,
+                    ProcessManager::current_pcb().preempt_count()
+                );
+                unsafe { ProcessManager::current_pcb().set_preempt_count(prev_count) };
+            }
+        }
+    }
+
+    /// 在ksoftirqd中以进程上下文执行线程化的软中断
+    fn run_threaded(&self, cpu_id: ProcessorId) {
+        let pending = {
+            let _irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+            let pending = cpu_pending(cpu_id).intersection(SOFTIRQ_THREADED);
+            cpu_pending(cpu_id).remove(pending);
+            pending
+        };
+        self.run_pending(pending);
     }
 
     pub fn raise_softirq(&self, softirq_num: SoftirqNumber) {
         let guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
         let processor_id = smp_get_processor_id();
 
-        cpu_pending(processor_id).insert(VecStatus::from(softirq_num));
+        let vec = VecStatus::from(softirq_num);
+        cpu_pending(processor_id).insert(vec);
 
         compiler_fence(Ordering::SeqCst);
 
+        // 线程化的软中断不会在中断退出时执行，需要唤醒ksoftirqd
+        if SOFTIRQ_THREADED.intersects(vec) {
+            wakeup_softirqd(processor_id);
+        }
+
         drop(guard);
         // debug!("raise_softirq exited");
     }
@@ -316,3 +370,59 @@ pub fn do_softirq() {
     IrqTime::irqtime_account_irq(ProcessManager::current_pcb(), false);
     fence(Ordering::SeqCst);
 }
+
+/// 本cpu是否有待处理的软中断
+fn local_softirq_pending(cpu_id: ProcessorId) -> bool {
+    let _irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+    compiler_fence(Ordering::SeqCst);
+    !cpu_pending(cpu_id).is_empty()
+}
+
+#[inline]
+fn wakeup_softirqd(cpu_id: ProcessorId) {
+    KSOFTIRQD_WAIT[cpu_id.data() as usize].wakeup(None);
+}
+
+/// `ksoftirqd/N`：绑定在cpu N上，处理中断退出时来不及处理的软中断和线程化的软中断
+fn ksoftirqd_thread(cpu: usize) -> i32 {
+    let cpu_id = ProcessorId::new(cpu as u32);
+    loop {
+        KSOFTIRQD_WAIT[cpu].wait_until(|| local_softirq_pending(cpu_id).then_some(()));
+
+        // 普通软中断和中断退出时一样，在关抢占的上下文中执行
+        {
+            let _irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+            do_softirq();
+        }
+        softirq_vectors().run_threaded(cpu_id);
+
+        if local_softirq_pending(cpu_id) {
+            // 还有工作，先让本cpu上的其他任务运行
+            sched_yield();
+        }
+    }
+}
+
+/// 为已经上线、还没有ksoftirqd的cpu创建ksoftirqd
+///
+/// 在`do_initcalls`之前（只有启动cpu在线）和`smp_init`之后各调用一次
+pub fn ksoftirqd_init() {
+    let manager = smp_cpu_manager();
+    for cpu_id in manager.present_cpus().iter_cpu() {
+        let cpu = cpu_id.data() as usize;
+        if !manager.is_online_cpu(cpu_id) || KSOFTIRQD_SPAWNED[cpu].swap(true, Ordering::AcqRel) {
+            continue;
+        }
+
+        let closure = KernelThreadClosure::UsizeClosure((Box::new(ksoftirqd_thread), cpu));
+        match KernelThreadMechanism::create_on_cpu(closure, format!("ksoftirqd/{}", cpu), cpu_id) {
+            Some(pcb) => {
+                ProcessManager::wakeup(&pcb).ok();
+            }
+            None => {
+                warn!("Failed to create ksoftirqd for cpu {}", cpu);
+                KSOFTIRQD_SPAWNED[cpu].store(false, Ordering::Release);
+            }
+        }
+    }
+}
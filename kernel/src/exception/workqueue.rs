@@ -1,18 +1,110 @@
-use alloc::{boxed::Box, collections::VecDeque, string::ToString, sync::Arc};
+//! 工作队列
+//!
+//! 工作项不再由每个队列独占的一个线程执行，而是交给工作者池（worker pool）：每个cpu一个
+//! 绑定池，另外还有一个所有非绑定队列共享的池。工作者在执行工作项的过程中睡眠时（等待IO、
+//! 锁等），调度器会通知它所在的池（`wq_worker_sleeping`），池里已经没有在运行的工作者而
+//! 还有待执行的工作项时，唤醒一个空闲工作者或者让管理线程创建新的工作者，一个阻塞的工作项
+//! 不会再卡住其他的延迟任务。
+//!
+//! 每个队列在每个池上有一个`PoolWorkqueue`，负责`max_active`限制：超过限制的工作项先停在
+//! `inactive`上，前面的工作项执行完之后再放进池子。
+//!
+//! 工作项的`pending`位表示谁拥有它：入队时置位成功的一方负责把它放进链表，
+//! 从链表上取走它（开始执行或者被取消）的一方负责清除。
+//!
+//! 锁顺序：`PoolWorkqueue` → `WorkerPool` → `Work::exec`
+
+use alloc::{
+    boxed::Box,
+    collections::VecDeque,
+    format,
+    string::{String, ToString},
+    sync::Arc,
+    vec::Vec,
+};
+use core::{
+    any::Any,
+    fmt::Debug,
+    hint::spin_loop,
+    sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering},
+};
 use lazy_static::lazy_static;
 use log;
+use system_error::SystemError;
 
 use crate::{
-    libs::{spinlock::SpinLock, wait_queue::WaitQueue},
+    driver::base::{
+        device::sys_devices_virtual_kobj,
+        kobject::{CommonKobj, DynamicKObjKType, KObject, KObjectManager},
+    },
+    filesystem::{
+        sysfs::{
+            file::sysfs_emit_str, sysfs_instance, Attribute, AttributeGroup, SysFSOpsSupport,
+            SYSFS_ATTR_MODE_RO,
+        },
+        vfs::InodeMode,
+    },
+    libs::{
+        spinlock::{SpinLock, SpinLockGuard},
+        wait_queue::WaitQueue,
+    },
+    mm::percpu::PerCpu,
     process::{
         kthread::{KernelThreadClosure, KernelThreadMechanism},
-        ProcessControlBlock,
+        ProcessControlBlock, ProcessFlags, ProcessManager,
+    },
+    smp::{core::smp_get_processor_id, cpu::ProcessorId},
+    time::{
+        timekeeping::ktime_get,
+        timer::{next_n_us_timer_jiffies, Timer, TimerFunction},
+        Duration,
     },
 };
 
+bitflags! {
+    pub struct WqFlags: u32 {
+        /// 工作项不绑定cpu，交给共享的非绑定池执行
+        const UNBOUND = 1 << 0;
+    }
+}
+
+/// 每个`PoolWorkqueue`默认允许同时执行的工作项数
+pub const WQ_DFL_ACTIVE: usize = 256;
+/// `max_active`的上限
+pub const WQ_MAX_ACTIVE: usize = 512;
+/// 单个工作者池最多的工作者数，防止大量阻塞的工作项无限制地创建线程
+const WORKER_POOL_MAX_WORKERS: usize = 128;
+/// 空闲超过这个时间的多余工作者会退出
+const WORKER_IDLE_TIMEOUT: Duration = Duration::from_secs(300);
+/// 空闲工作者数相对忙碌工作者数的上限比例，超过时多余的空闲工作者退出
+const MAX_IDLE_WORKERS_RATIO: usize = 4;
+
+#[inline]
+fn now_ns() -> u64 {
+    ktime_get().max(0) as u64
+}
+
+struct WorkExec {
+    /// 工作项正在某个工作者上执行
+    running: bool,
+    /// 执行期间又入队了一次，执行完之后由该工作者放进这个`PoolWorkqueue`
+    deferred: Option<Arc<PoolWorkqueue>>,
+    /// 最近一次入队的`PoolWorkqueue`，取消时在它的链表上查找
+    pwq: Option<Arc<PoolWorkqueue>>,
+    /// 最近一次入队的时刻（ns）
+    queued_at: u64,
+    /// 入队次数
+    queued: u64,
+    /// 执行完或者被取消的次数，追上`queued`时没有在途的实例
+    done: u64,
+}
+
 /// Represents a work item to be executed in a workqueue.
 pub struct Work {
     func: Box<dyn Fn() + Send + Sync>,
+    pending: AtomicBool,
+    exec: SpinLock<WorkExec>,
+    done_wait: WaitQueue,
 }
 
 impl Work {
@@ -21,85 +113,803 @@ impl Work {
     where
         F: Fn() + Send + Sync + 'static,
     {
-        Arc::new(Self { func: Box::new(f) })
+        Arc::new(Self {
+            func: Box::new(f),
+            pending: AtomicBool::new(false),
+            exec: SpinLock::new(WorkExec {
+                running: false,
+                deferred: None,
+                pwq: None,
+                queued_at: 0,
+                queued: 0,
+                done: 0,
+            }),
+            done_wait: WaitQueue::default(),
+        })
     }
 
     /// Execute the work item.
     pub fn run(&self) {
         (self.func)();
     }
+
+    /// 工作项是否已经入队、还没有开始执行
+    pub fn is_pending(&self) -> bool {
+        self.pending.load(Ordering::Acquire)
+    }
+
+    /// 从链表上摘下还没有开始执行的工作项
+    ///
+    /// ## 返回值
+    ///
+    /// 工作项原本处于pending状态、被这次调用摘下时返回true
+    fn grab_pending(self: &Arc<Self>) -> bool {
+        loop {
+            if !self.pending.load(Ordering::Acquire) {
+                return false;
+            }
+
+            let mut exec = self.exec.lock_irqsave();
+            if let Some(pwq) = exec.deferred.take() {
+                self.pending.store(false, Ordering::Release);
+                exec.done += 1;
+                drop(exec);
+                pwq.stats.dequeued();
+                return true;
+            }
+            let pwq = exec.pwq.clone();
+            drop(exec);
+
+            if let Some(pwq) = pwq {
+                if pwq.try_remove(self) {
+                    self.exec.lock_irqsave().done += 1;
+                    pwq.stats.dequeued();
+                    return true;
+                }
+            }
+            // 入队者已经拿到pending但还没有放进链表（或者定时器还没到期），等它完成
+            spin_loop();
+        }
+    }
+}
+
+impl Debug for Work {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("Work")
+            .field("pending", &self.is_pending())
+            .finish()
+    }
+}
+
+/// 队列的统计信息，所有`PoolWorkqueue`共享
+#[derive(Debug, Default)]
+struct WqStats {
+    nr_queued: AtomicU64,
+    nr_started: AtomicU64,
+    nr_completed: AtomicU64,
+    /// 已经入队、还没有开始执行的工作项数
+    depth: AtomicUsize,
+    max_depth: AtomicUsize,
+    /// 从入队到开始执行的等待时间
+    latency_sum_ns: AtomicU64,
+    latency_max_ns: AtomicU64,
+}
+
+impl WqStats {
+    fn queued(&self) {
+        self.nr_queued.fetch_add(1, Ordering::Relaxed);
+        let depth = self.depth.fetch_add(1, Ordering::Relaxed) + 1;
+        self.max_depth.fetch_max(depth, Ordering::Relaxed);
+    }
+
+    fn dequeued(&self) {
+        self.depth.fetch_sub(1, Ordering::Relaxed);
+    }
+
+    fn started(&self, latency_ns: u64) {
+        self.dequeued();
+        self.nr_started.fetch_add(1, Ordering::Relaxed);
+        self.latency_sum_ns.fetch_add(latency_ns, Ordering::Relaxed);
+        self.latency_max_ns.fetch_max(latency_ns, Ordering::Relaxed);
+    }
+
+    fn latency_avg_us(&self) -> u64 {
+        let started = self.nr_started.load(Ordering::Relaxed);
+        if started == 0 {
+            return 0;
+        }
+        self.latency_sum_ns.load(Ordering::Relaxed) / started / 1000
+    }
+}
+
+struct PendingWork {
+    work: Arc<Work>,
+    pwq: Arc<PoolWorkqueue>,
+}
+
+struct WorkerPoolInner {
+    worklist: VecDeque<PendingWork>,
+    nr_workers: usize,
+    nr_idle: usize,
+    /// 已经请求管理线程为本池创建工作者，还没有完成
+    manager_pending: bool,
+    next_worker_id: usize,
+}
+
+impl WorkerPoolInner {
+    fn too_many_idle(&self) -> bool {
+        let nr_busy = self.nr_workers - self.nr_idle;
+        self.nr_idle > 2 && (self.nr_idle - 2) * MAX_IDLE_WORKERS_RATIO >= nr_busy
+    }
+}
+
+/// 工作者池：一组执行工作项的内核线程
+struct WorkerPool {
+    /// 绑定池所在的cpu，非绑定池为None
+    cpu: Option<ProcessorId>,
+    inner: SpinLock<WorkerPoolInner>,
+    /// 正在执行工作项、没有睡眠的工作者数，只在持有`inner`时修改
+    nr_running: AtomicUsize,
+    idle_wait: WaitQueue,
+}
+
+impl WorkerPool {
+    fn new(cpu: Option<ProcessorId>) -> Arc<Self> {
+        Arc::new(Self {
+            cpu,
+            inner: SpinLock::new(WorkerPoolInner {
+                worklist: VecDeque::new(),
+                nr_workers: 0,
+                nr_idle: 0,
+                manager_pending: false,
+                next_worker_id: 0,
+            }),
+            nr_running: AtomicUsize::new(0),
+            idle_wait: WaitQueue::default(),
+        })
+    }
+
+    fn has_work(&self) -> bool {
+        !self.inner.lock_irqsave().worklist.is_empty()
+    }
+
+    fn push(self: &Arc<Self>, item: PendingWork) {
+        let mut inner = self.inner.lock_irqsave();
+        inner.worklist.push_back(item);
+        if self.nr_running.load(Ordering::Relaxed) == 0 {
+            self.wake_up_worker(&mut inner);
+        }
+    }
+
+    /// 没有工作者在运行而还有工作项时调用：唤醒一个空闲工作者，没有空闲的就请求创建
+    fn wake_up_worker(self: &Arc<Self>, inner: &mut SpinLockGuard<WorkerPoolInner>) {
+        if inner.nr_idle > 0 {
+            self.idle_wait.wakeup(None);
+        } else {
+            self.request_worker(inner);
+        }
+    }
+
+    fn request_worker(self: &Arc<Self>, inner: &mut SpinLockGuard<WorkerPoolInner>) {
+        if inner.manager_pending || inner.nr_workers >= WORKER_POOL_MAX_WORKERS {
+            return;
+        }
+        inner.manager_pending = true;
+        WQ_MANAGER_REQUESTS.lock_irqsave().push_back(self.clone());
+        WQ_MANAGER_WAIT.wakeup(None);
+    }
+
+    /// 由管理线程调用，创建一个工作者
+    fn create_worker(self: &Arc<Self>) {
+        let (id, name) = {
+            let mut inner = self.inner.lock_irqsave();
+            let id = inner.next_worker_id;
+            inner.next_worker_id += 1;
+            // 线程启动前就算作空闲，避免在它启动期间重复请求
+            inner.nr_workers += 1;
+            inner.nr_idle += 1;
+            let name = match self.cpu {
+                Some(cpu) => format!("kworker/{}:{}", cpu.data(), id),
+                None => format!("kworker/u:{}", id),
+            };
+            (id, name)
+        };
+
+        let worker = Arc::new(Worker {
+            pool: self.clone(),
+            idle: AtomicBool::new(true),
+            sleeping: AtomicBool::new(false),
+        });
+        let closure = KernelThreadClosure::EmptyClosure((
+            Box::new(move || worker_thread(worker.clone())),
+            (),
+        ));
+        let pcb = match self.cpu {
+            Some(cpu) => KernelThreadMechanism::create_on_cpu(closure, name, cpu),
+            None => KernelThreadMechanism::create(closure, name),
+        };
+
+        match pcb {
+            Some(pcb) => {
+                ProcessManager::wakeup(&pcb).ok();
+            }
+            None => {
+                log::error!("workqueue: failed to create worker {} for pool", id);
+                let mut inner = self.inner.lock_irqsave();
+                inner.nr_workers -= 1;
+                inner.nr_idle -= 1;
+            }
+        }
+    }
+}
+
+/// 一个队列在一个工作者池上的部分
+struct PoolWorkqueue {
+    pool: Arc<WorkerPool>,
+    max_active: usize,
+    inner: SpinLock<PoolWorkqueueInner>,
+    stats: Arc<WqStats>,
+}
+
+struct PoolWorkqueueInner {
+    /// 已经放进池子（排队或者正在执行）的工作项数
+    nr_active: usize,
+    /// 因为`max_active`限制还不能放进池子的工作项
+    inactive: VecDeque<Arc<Work>>,
+}
+
+impl PoolWorkqueue {
+    fn insert(self: &Arc<Self>, work: Arc<Work>) {
+        let mut inner = self.inner.lock_irqsave();
+        if inner.nr_active >= self.max_active {
+            inner.inactive.push_back(work);
+            return;
+        }
+        inner.nr_active += 1;
+        self.pool.push(PendingWork {
+            work,
+            pwq: self.clone(),
+        });
+    }
+
+    /// 一个工作项执行完（或者从池子里被取消），放进下一个被`max_active`挡住的工作项
+    fn work_done(self: &Arc<Self>) {
+        let mut inner = self.inner.lock_irqsave();
+        inner.nr_active -= 1;
+        if let Some(work) = inner.inactive.pop_front() {
+            inner.nr_active += 1;
+            self.pool.push(PendingWork {
+                work,
+                pwq: self.clone(),
+            });
+        }
+    }
+
+    /// 在链表上查找并摘下`work`，找到时清除它的pending位
+    fn try_remove(self: &Arc<Self>, work: &Arc<Work>) -> bool {
+        let mut inner = self.inner.lock_irqsave();
+        if let Some(pos) = inner.inactive.iter().position(|w| Arc::ptr_eq(w, work)) {
+            inner.inactive.remove(pos);
+            work.pending.store(false, Ordering::Release);
+            return true;
+        }
+
+        let mut pool_inner = self.pool.inner.lock_irqsave();
+        let Some(pos) = pool_inner
+            .worklist
+            .iter()
+            .position(|p| Arc::ptr_eq(&p.work, work))
+        else {
+            return false;
+        };
+        pool_inner.worklist.remove(pos);
+        work.pending.store(false, Ordering::Release);
+        inner.nr_active -= 1;
+        if let Some(next) = inner.inactive.pop_front() {
+            inner.nr_active += 1;
+            pool_inner.worklist.push_back(PendingWork {
+                work: next,
+                pwq: self.clone(),
+            });
+        }
+        true
+    }
+}
+
+/// 工作者线程，通过内核线程私有数据和pcb关联
+struct Worker {
+    pool: Arc<WorkerPool>,
+    /// 处于空闲状态，不计入`nr_running`
+    idle: AtomicBool,
+    /// 执行工作项时睡眠了，已经从`nr_running`中扣除
+    sleeping: AtomicBool,
 }
 
-/// A workqueue that manages a list of works and a worker thread.
+impl Worker {
+    /// 离开空闲状态，调用者持有池锁
+    fn leave_idle(&self, inner: &mut SpinLockGuard<WorkerPoolInner>) {
+        inner.nr_idle -= 1;
+        self.idle.store(false, Ordering::Relaxed);
+        self.pool.nr_running.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// 进入空闲状态，调用者持有池锁
+    fn enter_idle(&self, inner: &mut SpinLockGuard<WorkerPoolInner>) {
+        inner.nr_idle += 1;
+        self.idle.store(true, Ordering::Relaxed);
+        self.pool.nr_running.fetch_sub(1, Ordering::Relaxed);
+    }
+
+    /// 执行池子里的工作项，直到没有工作项或者有别的工作者在运行
+    fn process_worklist(&self) {
+        let pool = &self.pool;
+        loop {
+            let mut inner = pool.inner.lock_irqsave();
+            // 其他工作者从睡眠中醒来时让出，避免同时运行的工作者过多
+            let keep_working =
+                !inner.worklist.is_empty() && pool.nr_running.load(Ordering::Relaxed) <= 1;
+            if !keep_working {
+                self.enter_idle(&mut inner);
+                if !inner.worklist.is_empty() && pool.nr_running.load(Ordering::Relaxed) == 0 {
+                    pool.wake_up_worker(&mut inner);
+                }
+                return;
+            }
+
+            let PendingWork { work, pwq } = inner.worklist.pop_front().unwrap();
+            let queued_at = {
+                let mut exec = work.exec.lock_irqsave();
+                exec.running = true;
+                // 先标记running再清除pending：此后再入队的实例会看到它正在执行，
+                // 等执行完再放进池子
+                work.pending.store(false, Ordering::Release);
+                exec.queued_at
+            };
+            drop(inner);
+
+            pwq.stats.started(now_ns().saturating_sub(queued_at));
+            work.run();
+
+            let deferred = {
+                let mut exec = work.exec.lock_irqsave();
+                exec.running = false;
+                exec.done += 1;
+                exec.deferred.take()
+            };
+            work.done_wait.wake_all();
+            pwq.stats.nr_completed.fetch_add(1, Ordering::Relaxed);
+            pwq.work_done();
+            if let Some(next) = deferred {
+                next.insert(work);
+            }
+        }
+    }
+}
+
+fn worker_thread(worker: Arc<Worker>) -> i32 {
+    let pcb = ProcessManager::current_pcb();
+    if let Some(kthread) = pcb
+        .worker_private()
+        .as_mut()
+        .and_then(|x| x.kernel_thread_mut())
+    {
+        kthread.set_data(Some(worker.clone() as Arc<dyn Any + Send + Sync>));
+    }
+    pcb.flags().insert(ProcessFlags::WQ_WORKER);
+    drop(pcb);
+
+    let pool = worker.pool.clone();
+    loop {
+        let timed_out = pool
+            .idle_wait
+            .wait_event_interruptible_timeout(|| pool.has_work(), Some(WORKER_IDLE_TIMEOUT))
+            .is_err();
+
+        let mut inner = pool.inner.lock_irqsave();
+        if inner.worklist.is_empty() {
+            if timed_out && inner.too_many_idle() {
+                inner.nr_idle -= 1;
+                inner.nr_workers -= 1;
+                drop(inner);
+                ProcessManager::current_pcb()
+                    .flags()
+                    .remove(ProcessFlags::WQ_WORKER);
+                return 0;
+            }
+            continue;
+        }
+
+        worker.leave_idle(&mut inner);
+        // 池子里总留一个空闲工作者，当前工作者睡眠时可以立即接手
+        if inner.nr_idle == 0 {
+            pool.request_worker(&mut inner);
+        }
+        drop(inner);
+
+        worker.process_worklist();
+    }
+}
+
+fn current_worker(pcb: &Arc<ProcessControlBlock>) -> Option<Arc<Worker>> {
+    let data = pcb
+        .worker_private()
+        .as_ref()
+        .and_then(|x| x.kernel_thread())
+        .and_then(|x| x.data())?;
+    data.downcast::<Worker>().ok()
+}
+
+/// 工作者线程即将睡眠，由`schedule()`调用（中断已关闭）
+///
+/// 池子里没有其他在运行的工作者而还有工作项时，另派一个工作者
+pub fn wq_worker_sleeping(pcb: &Arc<ProcessControlBlock>) {
+    let Some(worker) = current_worker(pcb) else {
+        return;
+    };
+    if worker.idle.load(Ordering::Relaxed) || worker.sleeping.load(Ordering::Relaxed) {
+        return;
+    }
+    worker.sleeping.store(true, Ordering::Relaxed);
+
+    let pool = &worker.pool;
+    let mut inner = pool.inner.lock_irqsave();
+    if pool.nr_running.fetch_sub(1, Ordering::Relaxed) == 1 && !inner.worklist.is_empty() {
+        pool.wake_up_worker(&mut inner);
+    }
+}
+
+/// 工作者线程从睡眠中恢复运行，由`schedule()`调用
+pub fn wq_worker_running(pcb: &Arc<ProcessControlBlock>) {
+    let Some(worker) = current_worker(pcb) else {
+        return;
+    };
+    if !worker.sleeping.load(Ordering::Relaxed) {
+        return;
+    }
+    let _inner = worker.pool.inner.lock_irqsave();
+    worker.pool.nr_running.fetch_add(1, Ordering::Relaxed);
+    worker.sleeping.store(false, Ordering::Relaxed);
+}
+
+lazy_static! {
+    static ref BOUND_POOLS: Vec<Arc<WorkerPool>> = (0..PerCpu::MAX_CPU_NUM)
+        .map(|cpu| WorkerPool::new(Some(ProcessorId::new(cpu))))
+        .collect();
+    static ref UNBOUND_POOL: Arc<WorkerPool> = WorkerPool::new(None);
+    /// 等待管理线程创建工作者的池
+    static ref WQ_MANAGER_REQUESTS: SpinLock<VecDeque<Arc<WorkerPool>>> =
+        SpinLock::new(VecDeque::new());
+    static ref WQ_MANAGER_WAIT: WaitQueue = WaitQueue::default();
+}
+
+/// 管理线程：创建工作者需要等待kthreadd，不能在入队或者调度路径上完成
+fn wq_manager_thread() -> i32 {
+    loop {
+        let _ = WQ_MANAGER_WAIT.wait_event_interruptible(
+            || !WQ_MANAGER_REQUESTS.lock_irqsave().is_empty(),
+            None::<fn()>,
+        );
+        while let Some(pool) = WQ_MANAGER_REQUESTS.lock_irqsave().pop_front() {
+            pool.create_worker();
+            let mut inner = pool.inner.lock_irqsave();
+            inner.manager_pending = false;
+            // 新工作者启动之前，池里的工作者可能又都睡眠了
+            if !inner.worklist.is_empty() && pool.nr_running.load(Ordering::Relaxed) == 0 {
+                pool.wake_up_worker(&mut inner);
+            }
+        }
+    }
+}
+
+/// A workqueue that dispatches works onto shared worker pools.
 pub struct WorkQueue {
-    queue: SpinLock<VecDeque<Arc<Work>>>,
-    wait_queue: Arc<WaitQueue>,
-    worker: SpinLock<Option<Arc<ProcessControlBlock>>>,
+    name: String,
+    flags: WqFlags,
+    max_active: usize,
+    /// 绑定队列每个cpu一个，非绑定队列只有一个
+    pwqs: Vec<Arc<PoolWorkqueue>>,
+    stats: Arc<WqStats>,
+    sysfs_registered: AtomicBool,
+    /// sysfs中的目录
+    #[allow(dead_code)]
+    kobj: SpinLock<Option<Arc<CommonKobj>>>,
 }
 
 impl WorkQueue {
-    /// Create a new workqueue with the given name.
-    /// This will spawn a kernel thread with the given name.
+    /// Create a new unbound workqueue with the given name and the default `max_active`.
     pub fn new(name: &str) -> Arc<Self> {
+        Self::alloc(name, WqFlags::UNBOUND, 0)
+    }
+
+    /// 创建工作队列
+    ///
+    /// ## 参数
+    ///
+    /// - `flags`：`WqFlags::UNBOUND`表示工作项可以在任意cpu上执行，否则在入队的cpu上执行
+    /// - `max_active`：每个cpu（非绑定队列为整个队列）同时执行的工作项上限，0表示默认值
+    pub fn alloc(name: &str, flags: WqFlags, max_active: usize) -> Arc<Self> {
+        let max_active = if max_active == 0 {
+            WQ_DFL_ACTIVE
+        } else {
+            max_active.min(WQ_MAX_ACTIVE)
+        };
+        let stats = Arc::new(WqStats::default());
+        let new_pwq = |pool: &Arc<WorkerPool>| {
+            Arc::new(PoolWorkqueue {
+                pool: pool.clone(),
+                max_active,
+                inner: SpinLock::new(PoolWorkqueueInner {
+                    nr_active: 0,
+                    inactive: VecDeque::new(),
+                }),
+                stats: stats.clone(),
+            })
+        };
+        let pwqs = if flags.contains(WqFlags::UNBOUND) {
+            alloc::vec![new_pwq(&*UNBOUND_POOL)]
+        } else {
+            BOUND_POOLS.iter().map(new_pwq).collect()
+        };
+
         let wq = Arc::new(Self {
-            queue: SpinLock::new(VecDeque::new()),
-            wait_queue: Arc::new(WaitQueue::default()),
-            worker: SpinLock::new(None),
+            name: name.to_string(),
+            flags,
+            max_active,
+            pwqs,
+            stats,
+            sysfs_registered: AtomicBool::new(false),
+            kobj: SpinLock::new(None),
         });
+        WORKQUEUES.lock_irqsave().push(wq.clone());
+        if WQ_SYSFS_READY.load(Ordering::Acquire) {
+            wq.sysfs_register();
+        }
+        wq
+    }
 
-        // Create worker thread
-        let wq_clone = wq.clone();
-        let closure = Box::new(move || worker_loop(wq_clone.clone()));
-        let kt_closure = KernelThreadClosure::EmptyClosure((closure, ()));
+    #[allow(dead_code)]
+    pub fn name(&self) -> &str {
+        &self.name
+    }
 
-        let worker_pcb = KernelThreadMechanism::create_and_run(kt_closure, name.to_string())
-            .expect("Failed to create workqueue worker");
+    fn select_pwq(&self) -> &Arc<PoolWorkqueue> {
+        if self.flags.contains(WqFlags::UNBOUND) {
+            &self.pwqs[0]
+        } else {
+            &self.pwqs[smp_get_processor_id().data() as usize]
+        }
+    }
 
-        *wq.worker.lock() = Some(worker_pcb);
+    /// 把工作项放进队列，调用者已经拿到了它的pending位
+    fn __queue_work(&self, work: Arc<Work>) {
+        let pwq = self.select_pwq().clone();
+        pwq.stats.queued();
+        let mut exec = work.exec.lock_irqsave();
+        exec.queued += 1;
+        exec.queued_at = now_ns();
+        exec.pwq = Some(pwq.clone());
+        if exec.running {
+            // 保证同一个工作项不会在两个工作者上同时执行
+            exec.deferred = Some(pwq);
+            return;
+        }
+        drop(exec);
+        pwq.insert(work);
+    }
 
-        wq
+    /// 工作项入队。它已经在队列里等待执行时什么都不做，返回false
+    ///
+    /// 可以在中断上下文中调用
+    pub fn queue_work(&self, work: Arc<Work>) -> bool {
+        if work.pending.swap(true, Ordering::AcqRel) {
+            return false;
+        }
+        self.__queue_work(work);
+        true
     }
 
     /// Enqueue a work item to the workqueue.
     pub fn enqueue(&self, work: Arc<Work>) {
-        self.queue.lock().push_back(work);
-        self.wait_queue.wakeup(None);
+        self.queue_work(work);
+    }
+
+    /// 延迟`delay`之后把工作项入队。它已经在等待（定时器或者队列中）时返回false
+    pub fn queue_delayed_work(self: &Arc<Self>, dwork: &Arc<DelayedWork>, delay: Duration) -> bool {
+        if dwork.work.pending.swap(true, Ordering::AcqRel) {
+            return false;
+        }
+        if delay.total_micros() == 0 {
+            self.__queue_work(dwork.work.clone());
+            return true;
+        }
+
+        let timer = Timer::new(
+            Box::new(DelayedWorkTimer {
+                dwork: dwork.clone(),
+                wq: self.clone(),
+            }),
+            next_n_us_timer_jiffies(delay.total_micros()),
+        );
+        *dwork.timer.lock_irqsave() = Some(timer.clone());
+        timer.activate();
+        true
+    }
+
+    /// 在`/sys/devices/virtual/workqueue/`下创建队列的目录
+    fn sysfs_register(&self) {
+        if self.sysfs_registered.swap(true, Ordering::AcqRel) {
+            return;
+        }
+        let Some(parent) = WQ_SYSFS_KOBJ.lock_irqsave().clone() else {
+            return;
+        };
+        let kobj = CommonKobj::new(self.name.clone());
+        kobj.set_parent(Some(Arc::downgrade(&(parent as Arc<dyn KObject>))));
+        if let Err(e) = KObjectManager::init_and_add_kobj(kobj.clone(), Some(&DynamicKObjKType)) {
+            log::warn!("Failed to add workqueue {} to sysfs: {:?}", self.name, e);
+            return;
+        }
+        sysfs_instance()
+            .create_groups(&(kobj.clone() as Arc<dyn KObject>), &[&WqAttrGroup])
+            .unwrap_or_else(|e| {
+                log::warn!(
+                    "Failed to create sysfs attributes for workqueue {}: {:?}",
+                    self.name,
+                    e
+                );
+            });
+        *self.kobj.lock_irqsave() = Some(kobj);
     }
 }
 
-/// The main loop for the worker thread.
-fn worker_loop(wq: Arc<WorkQueue>) -> i32 {
-    loop {
-        // Wait for work
-        let _ = wq
-            .wait_queue
-            .wait_event_interruptible(|| !wq.queue.lock().is_empty(), None::<fn()>);
+/// 在定时器到期之后入队的工作项
+pub struct DelayedWork {
+    work: Arc<Work>,
+    timer: SpinLock<Option<Arc<Timer>>>,
+}
 
-        // Process works
-        loop {
-            let work = wq.queue.lock().pop_front();
-            match work {
-                Some(w) => w.run(),
-                None => break,
-            }
+impl DelayedWork {
+    pub fn new<F>(f: F) -> Arc<Self>
+    where
+        F: Fn() + Send + Sync + 'static,
+    {
+        Arc::new(Self {
+            work: Work::new(f),
+            timer: SpinLock::new(None),
+        })
+    }
+
+    pub fn work(&self) -> &Arc<Work> {
+        &self.work
+    }
+}
+
+struct DelayedWorkTimer {
+    dwork: Arc<DelayedWork>,
+    wq: Arc<WorkQueue>,
+}
+
+impl Debug for DelayedWorkTimer {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("DelayedWorkTimer")
+            .field("wq", &self.wq.name)
+            .finish()
+    }
+}
+
+impl TimerFunction for DelayedWorkTimer {
+    fn run(&mut self) -> Result<(), SystemError> {
+        self.dwork.timer.lock_irqsave().take();
+        self.wq.__queue_work(self.dwork.work.clone());
+        Ok(())
+    }
+}
+
+/// 等待工作项最近一次入队的实例执行完
+///
+/// 不能在该工作项自身中调用
+///
+/// ## 返回值
+///
+/// 确实等待了时返回true
+pub fn flush_work(work: &Arc<Work>) -> bool {
+    let target = {
+        let exec = work.exec.lock_irqsave();
+        if exec.done >= exec.queued {
+            return false;
         }
+        exec.queued
+    };
+    work.done_wait
+        .wait_until(|| (work.exec.lock_irqsave().done >= target).then_some(()));
+    true
+}
+
+/// 取消还没有开始执行的工作项，并等待正在执行的实例结束
+///
+/// 延迟工作项要用`cancel_delayed_work_sync`，否则会一直等到定时器到期
+///
+/// ## 返回值
+///
+/// 工作项在调用时处于pending状态时返回true
+pub fn cancel_work_sync(work: &Arc<Work>) -> bool {
+    let cancelled = work.grab_pending();
+    work.done_wait
+        .wait_until(|| (!work.exec.lock_irqsave().running).then_some(()));
+    cancelled
+}
+
+/// 取消延迟工作项：定时器还没有到期时直接撤销，否则按`cancel_work_sync`处理
+pub fn cancel_delayed_work_sync(dwork: &Arc<DelayedWork>) -> bool {
+    let timer = dwork.timer.lock_irqsave().take();
+    let stolen = timer.is_some_and(|t| t.cancel());
+    if stolen {
+        // 定时器持有的pending位归我们所有
+        dwork.work.pending.store(false, Ordering::Release);
     }
+    cancel_work_sync(&dwork.work) || stolen
+}
+
+/// 立即执行还在定时器上等待的延迟工作项，然后等待它执行完
+#[allow(dead_code)]
+pub fn flush_delayed_work(wq: &Arc<WorkQueue>, dwork: &Arc<DelayedWork>) -> bool {
+    let timer = dwork.timer.lock_irqsave().take();
+    if timer.is_some_and(|t| t.cancel()) {
+        wq.__queue_work(dwork.work.clone());
+    }
+    flush_work(&dwork.work)
 }
 
 lazy_static! {
-    /// The system-wide default workqueue.
-    pub static ref SYSTEM_WQ: Arc<WorkQueue> = WorkQueue::new("events");
+    /// The system-wide default workqueue, bound to the cpu that queues the work.
+    pub static ref SYSTEM_WQ: Arc<WorkQueue> = WorkQueue::alloc("events", WqFlags::empty(), 0);
+    /// 不绑定cpu的系统队列，适合执行时间较长的工作项
+    pub static ref SYSTEM_UNBOUND_WQ: Arc<WorkQueue> =
+        WorkQueue::alloc("events_unbound", WqFlags::UNBOUND, WQ_MAX_ACTIVE);
+    static ref WORKQUEUES: SpinLock<Vec<Arc<WorkQueue>>> = SpinLock::new(Vec::new());
+    static ref WQ_SYSFS_KOBJ: SpinLock<Option<Arc<CommonKobj>>> = SpinLock::new(None);
 }
 
+static WQ_SYSFS_READY: AtomicBool = AtomicBool::new(false);
+
 /// Schedule a work item to the system default workqueue.
-pub fn schedule_work(work: Arc<Work>) {
-    SYSTEM_WQ.enqueue(work);
+pub fn schedule_work(work: Arc<Work>) -> bool {
+    SYSTEM_WQ.queue_work(work)
+}
+
+/// 延迟`delay`之后把工作项放进系统默认队列
+pub fn schedule_delayed_work(dwork: &Arc<DelayedWork>, delay: Duration) -> bool {
+    SYSTEM_WQ.queue_delayed_work(dwork, delay)
+}
+
+/// 创建`/sys/devices/virtual/workqueue`，并注册已经存在的队列
+fn workqueue_sysfs_init() {
+    let kobj = CommonKobj::new("workqueue".to_string());
+    kobj.set_parent(Some(Arc::downgrade(
+        &(sys_devices_virtual_kobj() as Arc<dyn KObject>),
+    )));
+    if let Err(e) = KObjectManager::init_and_add_kobj(kobj.clone(), Some(&DynamicKObjKType)) {
+        log::warn!("Failed to add workqueue kobject to sysfs: {:?}", e);
+        return;
+    }
+    *WQ_SYSFS_KOBJ.lock_irqsave() = Some(kobj);
+    WQ_SYSFS_READY.store(true, Ordering::Release);
+
+    let wqs = WORKQUEUES.lock_irqsave().clone();
+    for wq in wqs.iter() {
+        wq.sysfs_register();
+    }
 }
 
 /// Initialize the workqueue subsystem.
 pub fn workqueue_init() {
-    // Trigger lazy_static initialization
+    let closure = KernelThreadClosure::EmptyClosure((Box::new(wq_manager_thread), ()));
+    KernelThreadMechanism::create_and_run(closure, "kworker_manager".to_string())
+        .expect("Failed to create workqueue manager");
+
     lazy_static::initialize(&SYSTEM_WQ);
+    lazy_static::initialize(&SYSTEM_UNBOUND_WQ);
+    workqueue_sysfs_init();
     test_workqueue();
 }
 
@@ -107,5 +917,119 @@ fn test_workqueue() {
     let work = Work::new(|| {
         log::info!("Workqueue test: Hello from worker thread!");
     });
-    schedule_work(work);
+    schedule_work(work.clone());
+    flush_work(&work);
+
+    // 还没有到期的延迟工作项可以直接撤销
+    let dwork = DelayedWork::new(|| {
+        log::warn!("Workqueue test: cancelled delayed work ran");
+    });
+    schedule_delayed_work(&dwork, Duration::from_secs(10));
+    if !cancel_delayed_work_sync(&dwork) || dwork.work().is_pending() {
+        log::warn!("Workqueue test: failed to cancel delayed work");
+    }
+}
+
+/// `/sys/devices/virtual/workqueue/<name>/`下的只读属性
+struct WqAttr {
+    name: &'static str,
+    show: fn(&WorkQueue) -> u64,
+}
+
+impl Debug for WqAttr {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("WqAttr").field("name", &self.name).finish()
+    }
+}
+
+impl Attribute for WqAttr {
+    fn name(&self) -> &str {
+        self.name
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RO
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW
+    }
+
+    fn show(&self, kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let name = kobj.name();
+        let wq = WORKQUEUES
+            .lock_irqsave()
+            .iter()
+            .find(|wq| wq.name == name)
+            .cloned()
+            .ok_or(SystemError::ENOENT)?;
+        sysfs_emit_str(buf, &format!("{}\n", (self.show)(&wq)))
+    }
+}
+
+static WQ_ATTRS: [WqAttr; 8] = [
+    WqAttr {
+        name: "per_cpu",
+        show: |wq| !wq.flags.contains(WqFlags::UNBOUND) as u64,
+    },
+    WqAttr {
+        name: "max_active",
+        show: |wq| wq.max_active as u64,
+    },
+    WqAttr {
+        name: "nr_queued",
+        show: |wq| wq.stats.nr_queued.load(Ordering::Relaxed),
+    },
+    WqAttr {
+        name: "nr_completed",
+        show: |wq| wq.stats.nr_completed.load(Ordering::Relaxed),
+    },
+    WqAttr {
+        name: "depth",
+        show: |wq| wq.stats.depth.load(Ordering::Relaxed) as u64,
+    },
+    WqAttr {
+        name: "max_depth",
+        show: |wq| wq.stats.max_depth.load(Ordering::Relaxed) as u64,
+    },
+    WqAttr {
+        name: "latency_avg_us",
+        show: |wq| wq.stats.latency_avg_us(),
+    },
+    WqAttr {
+        name: "latency_max_us",
+        show: |wq| wq.stats.latency_max_ns.load(Ordering::Relaxed) / 1000,
+    },
+];
+
+static WQ_ATTR_REFS: [&dyn Attribute; 8] = [
+    &WQ_ATTRS[0],
+    &WQ_ATTRS[1],
+    &WQ_ATTRS[2],
+    &WQ_ATTRS[3],
+    &WQ_ATTRS[4],
+    &WQ_ATTRS[5],
+    &WQ_ATTRS[6],
+    &WQ_ATTRS[7],
+];
+
+#[derive(Debug)]
+struct WqAttrGroup;
+
+impl AttributeGroup for WqAttrGroup {
+    fn name(&self) -> Option<&str> {
+        None
+    }
+
+    fn attrs(&self) -> &[&'static dyn Attribute] {
+        &WQ_ATTR_REFS
+    }
+
+    fn is_visible(
+        &self,
+        _kobj: Arc<dyn KObject>,
+        attr: &'static dyn Attribute,
+    ) -> Option<InodeMode> {
+        Some(attr.mode())
+    }
 }
@@ -1,5 +1,8 @@
 use crate::{
-    driver::base::{block::gendisk::GenDisk, device::device_number::DeviceNumber},
+    driver::base::{
+        block::{gendisk::GenDisk, manager::block_dev_manager},
+        device::device_number::DeviceNumber,
+    },
     filesystem::{
         ext4::inode::{Ext4Inode, InodeDirtyState},
         vfs::{
@@ -14,6 +17,7 @@ use crate::{
     libs::mutex::Mutex,
     mm::{
         fault::{PageFaultHandler, PageFaultMessage},
+        readahead::VM_READAHEAD_PAGES,
         VmFaultReason,
     },
     process::ProcessManager,
@@ -92,6 +96,13 @@ impl FileSystem for Ext4FileSystem {
         "ext4"
     }
 
+    fn ra_pages(&self) -> usize {
+        block_dev_manager()
+            .lookup_by_devnum(self.raw_dev)
+            .map(|bdev| bdev.blkdev_meta().ra_pages())
+            .unwrap_or(VM_READAHEAD_PAGES)
+    }
+
     fn super_block(&self) -> vfs::SuperBlock {
         vfs::SuperBlock::new(Magic::EXT4_MAGIC, another_ext4::BLOCK_SIZE as u64, 255)
     }
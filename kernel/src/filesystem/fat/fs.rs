@@ -456,6 +456,10 @@ impl FileSystem for FATFileSystem {
         "fat"
     }
 
+    fn ra_pages(&self) -> usize {
+        self.gendisk.block_device().blkdev_meta().ra_pages()
+    }
+
     fn super_block(&self) -> SuperBlock {
         let mut sb = SuperBlock::new(
             Magic::FAT_MAGIC,
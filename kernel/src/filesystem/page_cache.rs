@@ -1,7 +1,6 @@
 use core::sync::atomic::{AtomicBool, AtomicU64, AtomicU8, AtomicUsize, Ordering};
 
 use alloc::{
-    collections::BTreeSet,
     sync::{Arc, Weak},
     vec::Vec,
 };
@@ -11,12 +10,13 @@ use system_error::SystemError;
 use super::vfs::{
     mount::record_writeback_error_for_fs, FilePrivateData, IndexNode, WritebackControl,
 };
-use crate::exception::workqueue::{schedule_work, Work, WorkQueue};
+use crate::exception::workqueue::{schedule_work, Work, WorkQueue, WqFlags};
 use crate::libs::errseq::{ErrSeq, ErrSeqValue};
 use crate::libs::mutex::MutexGuard;
 use crate::libs::rwsem::{RwSem, RwSemReadGuard, RwSemWriteGuard};
 use crate::libs::spinlock::SpinLock;
 use crate::libs::wait_queue::WaitQueue;
+use crate::libs::xarray::{XArray, XaMark, XA_MARK_0, XA_MARK_1, XA_MARK_2};
 use crate::mm::page::FileMapInfo;
 use crate::mm::page_cache_stats as pc_stats;
 use crate::mm::ucontext::LockedVMA;
@@ -26,8 +26,9 @@ use crate::{
     arch::MMArch,
     libs::mutex::Mutex,
     mm::{
+        lru::{count_vm_events, mark_page_accessed, VmEvent},
         mmu_gather::MmuGather,
-        page::{page_manager_lock, page_reclaimer_lock, Page, PageFlags},
+        page::{page_manager, page_reclaimer_lock, Page, PageFlags},
         ucontext::AddressSpace,
         MemoryManagementArch,
     },
@@ -37,8 +38,15 @@ use lazy_static::lazy_static;
 
 static PAGE_CACHE_ID: AtomicUsize = AtomicUsize::new(0);
 
-const PAGECACHE_IO_WORKERS: usize = 4;
-static PAGECACHE_IO_RR: AtomicUsize = AtomicUsize::new(0);
+/// 页面处于Dirty状态，或者在回写期间再次被写脏
+const PAGECACHE_TAG_DIRTY: XaMark = XA_MARK_0;
+/// 页面正在回写
+const PAGECACHE_TAG_WRITEBACK: XaMark = XA_MARK_1;
+/// 本轮数据完整性回写需要写出的页面（见`PageCacheManager::writeback_tagged`）
+const PAGECACHE_TAG_TOWRITE: XaMark = XA_MARK_2;
+
+/// 页面缓存IO队列同时执行的工作项上限
+const PAGECACHE_IO_MAX_ACTIVE: usize = 16;
 
 #[derive(Debug, Default)]
 struct FileVmaIndex {
@@ -97,19 +105,13 @@ impl MmFilePageGroup {
 }
 
 lazy_static! {
-    static ref PAGECACHE_IO_WQS: Vec<Arc<WorkQueue>> = {
-        let mut wqs = Vec::new();
-        for i in 0..PAGECACHE_IO_WORKERS {
-            wqs.push(WorkQueue::new(&format!("pagecache-io-{i}")));
-        }
-        wqs
-    };
+    static ref PAGECACHE_IO_WQ: Arc<WorkQueue> =
+        WorkQueue::alloc("pagecache-io", WqFlags::UNBOUND, PAGECACHE_IO_MAX_ACTIVE);
     static ref PAGECACHE_REGISTRY: SpinLock<Vec<Weak<PageCache>>> = SpinLock::new(Vec::new());
 }
 
 fn schedule_pagecache_io(work: Arc<Work>) {
-    let idx = PAGECACHE_IO_RR.fetch_add(1, Ordering::Relaxed) % PAGECACHE_IO_WQS.len();
-    PAGECACHE_IO_WQS[idx].enqueue(work);
+    PAGECACHE_IO_WQ.queue_work(work);
 }
 
 fn register_page_cache(cache: &Arc<PageCache>) {
@@ -254,6 +256,10 @@ impl PageCacheBackend for AsyncPageCacheBackend {
 #[derive(Debug)]
 pub struct PageCache {
     id: usize,
+    /// 页索引到页面的映射，与`InnerPageCache`共享
+    ///
+    /// 查找不需要获取`inner`锁；插入和删除仍然在`inner`锁内进行。
+    pages: Arc<XArray<PageEntry>>,
     inner: Mutex<InnerPageCache>,
     inode: Lazy<Weak<dyn IndexNode>>,
     backend: Lazy<Arc<dyn PageCacheBackend>>,
@@ -271,8 +277,7 @@ pub struct PageCache {
 pub struct InnerPageCache {
     #[allow(unused)]
     id: usize,
-    pages: HashMap<usize, Arc<PageEntry>>,
-    dirty_pages: BTreeSet<usize>,
+    pages: Arc<XArray<PageEntry>>,
     page_cache_ref: Weak<PageCache>,
 }
 
@@ -324,6 +329,15 @@ pub struct CopyItem {
     sub_len: usize,
 }
 
+/// 一次读写中的第`i`个页面是否应该标记为被访问
+///
+/// 从页面中间开始的第一个页面通常是上一次顺序读写的延续，不重复标记，
+/// 否则按小块顺序读一个文件会把每个页面都提升到活跃链表（与Linux filemap_read的处理相同）。
+#[inline(always)]
+fn should_mark_accessed(i: usize, item: &CopyItem) -> bool {
+    i != 0 || item.page_offset == 0
+}
+
 #[derive(Debug)]
 pub struct PageIoWaiter {
     completion: Completion,
@@ -374,6 +388,12 @@ impl PageState {
 struct PageEntry {
     page: Arc<Page>,
     state: AtomicU8,
+    /// 预读标记（相当于Linux的PG_readahead）
+    ///
+    /// 读到带标记的页面时发起下一个异步预读窗口。标记放在这里而不是页面标志中，
+    /// 因为页面标志受页面锁保护，而异步读取在I/O期间一直持有页面锁，
+    /// 读者检查标记时不应等待这个页面的I/O完成。
+    readahead: AtomicBool,
     wait_queue: WaitQueue,
 }
 
@@ -457,12 +477,13 @@ impl PageCacheManager {
     }
 
     pub fn prefetch_page(&self, page_index: usize) -> Result<(), SystemError> {
-        self.upgrade()?.start_async_read(page_index)
+        self.upgrade()?.start_async_read(page_index, false)?;
+        Ok(())
     }
 
     pub fn update_page(&self, page_index: usize) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        if let Some(entry) = cache.inner.lock().get_entry(page_index) {
+        if let Some(entry) = cache.pages.load(page_index) {
             let state = entry.state();
             if state == PageState::Loading {
                 let _ = entry.wait_ready()?;
@@ -487,23 +508,13 @@ impl PageCacheManager {
     pub fn get_page_any(&self, page_index: usize) -> Option<Arc<Page>> {
         self.upgrade()
             .ok()
-            .and_then(|cache| cache.lock().get_page(page_index))
+            .and_then(|cache| cache.pages.load(page_index))
+            .map(|entry| entry.page.clone())
     }
 
     pub fn sync(&self) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        let dirty_entries: Vec<(usize, Arc<PageEntry>)> = {
-            let inner = cache.inner.lock();
-            inner
-                .dirty_pages
-                .iter()
-                .filter_map(|idx| inner.pages.get(idx).cloned().map(|entry| (*idx, entry)))
-                .collect()
-        };
-
-        for (page_index, entry) in dirty_entries {
-            Self::writeback_entry(&cache, page_index, entry)?;
-        }
+        Self::writeback_tagged(&cache, 0, usize::MAX)?;
 
         // 脏页写完后调 write_inode 回写元数据。
         if let Some(inode) = cache.inode().and_then(|w| w.upgrade()) {
@@ -524,17 +535,36 @@ impl PageCacheManager {
 
     pub fn writeback_range(&self, start_index: usize, end_index: usize) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        let dirty_entries: Vec<(usize, Arc<PageEntry>)> = {
-            let inner = cache.inner.lock();
-            inner
-                .dirty_pages
-                .range(start_index..=end_index)
-                .filter_map(|idx| inner.pages.get(idx).cloned().map(|entry| (*idx, entry)))
-                .collect()
-        };
+        Self::writeback_tagged(&cache, start_index, end_index)
+    }
 
-        for (page_index, entry) in dirty_entries {
-            Self::writeback_entry(&cache, page_index, entry)?;
+    /// 同步回写`[start_index, end_index]`内的脏页
+    ///
+    /// 先把此刻的脏页打上TOWRITE标记，再只回写带TOWRITE标记的页面（与Linux的
+    /// tag_pages_for_writeback相同），回写期间新写脏的页面留给下一次回写，
+    /// 不会让持续写入的文件上的fsync无法结束。
+    fn writeback_tagged(
+        cache: &Arc<PageCache>,
+        start_index: usize,
+        end_index: usize,
+    ) -> Result<(), SystemError> {
+        cache.pages.tag_range(
+            start_index,
+            end_index,
+            PAGECACHE_TAG_DIRTY,
+            PAGECACHE_TAG_TOWRITE,
+        );
+        let entries = cache.pages.collect_range(
+            start_index,
+            end_index,
+            Some(PAGECACHE_TAG_TOWRITE),
+            usize::MAX,
+        );
+
+        for (page_index, entry) in entries {
+            let result = Self::writeback_entry(cache, page_index, entry);
+            cache.pages.clear_mark(page_index, PAGECACHE_TAG_TOWRITE);
+            result?;
         }
 
         Ok(())
@@ -546,22 +576,14 @@ impl PageCacheManager {
         end_index: usize,
     ) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        let entries: Vec<Arc<PageEntry>> = {
-            let inner = cache.inner.lock();
-            inner
-                .pages
-                .iter()
-                .filter_map(|(idx, entry)| {
-                    if *idx >= start_index && *idx <= end_index {
-                        Some(entry.clone())
-                    } else {
-                        None
-                    }
-                })
-                .collect()
-        };
-
-        for entry in entries {
+        let entries = cache.pages.collect_range(
+            start_index,
+            end_index,
+            Some(PAGECACHE_TAG_WRITEBACK),
+            usize::MAX,
+        );
+
+        for (_, entry) in entries {
             Self::wait_writeback_entry(entry)?;
         }
 
@@ -574,14 +596,12 @@ impl PageCacheManager {
         end_index: usize,
     ) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        let dirty_entries: Vec<(usize, Arc<PageEntry>)> = {
-            let inner = cache.inner.lock();
-            inner
-                .dirty_pages
-                .range(start_index..=end_index)
-                .filter_map(|idx| inner.pages.get(idx).cloned().map(|entry| (*idx, entry)))
-                .collect()
-        };
+        let dirty_entries = cache.pages.collect_range(
+            start_index,
+            end_index,
+            Some(PAGECACHE_TAG_DIRTY),
+            usize::MAX,
+        );
 
         for (page_index, entry) in dirty_entries {
             Self::start_writeback_entry(&cache, page_index, entry)?;
@@ -611,7 +631,7 @@ impl PageCacheManager {
 
     pub fn writeback_page(&self, page_index: usize) -> Result<(), SystemError> {
         let cache = self.upgrade()?;
-        let entry = match cache.inner.lock().get_entry(page_index) {
+        let entry = match cache.pages.load(page_index) {
             Some(entry) => entry,
             None => return Ok(()),
         };
@@ -649,8 +669,7 @@ impl PageCacheManager {
                     }
                     drop(guard);
                     entry.set_state(PageState::Dirty);
-                    let mut inner = cache.inner.lock();
-                    inner.dirty_pages.insert(page_index);
+                    cache.pages.set_mark(page_index, PAGECACHE_TAG_DIRTY);
                     continue;
                 }
                 PageState::Dirty => {
@@ -665,8 +684,7 @@ impl PageCacheManager {
                 .is_ok()
             {
                 cache.account_state_transition(PageState::Dirty, PageState::Writeback);
-                let mut inner = cache.inner.lock();
-                inner.dirty_pages.remove(&page_index);
+                cache.set_writeback_tags(page_index);
                 return Ok(true);
             }
         }
@@ -692,8 +710,7 @@ impl PageCacheManager {
                     }
                     drop(guard);
                     entry.set_state(PageState::Dirty);
-                    let mut inner = cache.inner.lock();
-                    inner.dirty_pages.insert(page_index);
+                    cache.pages.set_mark(page_index, PAGECACHE_TAG_DIRTY);
                     continue;
                 }
                 PageState::Dirty => {
@@ -709,8 +726,7 @@ impl PageCacheManager {
                 .is_ok()
             {
                 cache.account_state_transition(PageState::Dirty, PageState::Writeback);
-                let mut inner = cache.inner.lock();
-                inner.dirty_pages.remove(&page_index);
+                cache.set_writeback_tags(page_index);
                 return Ok(true);
             }
         }
@@ -731,8 +747,8 @@ impl PageCacheManager {
             }
             cache.account_state_transition(PageState::Writeback, PageState::Dirty);
             entry.set_state(PageState::Dirty);
-            let mut inner = cache.inner.lock();
-            inner.dirty_pages.insert(page_index);
+            cache.pages.set_mark(page_index, PAGECACHE_TAG_DIRTY);
+            cache.pages.clear_mark(page_index, PAGECACHE_TAG_WRITEBACK);
             entry.wait_queue.wake_all();
             return Err(e);
         }
@@ -743,15 +759,14 @@ impl PageCacheManager {
             if guard.flags().contains(PageFlags::PG_DIRTY) {
                 cache.account_state_transition(PageState::Writeback, PageState::Dirty);
                 entry.set_state(PageState::Dirty);
-                let mut inner = cache.inner.lock();
-                inner.dirty_pages.insert(page_index);
+                cache.pages.set_mark(page_index, PAGECACHE_TAG_DIRTY);
             } else {
                 cache.account_state_transition(PageState::Writeback, PageState::UpToDate);
                 entry.set_state(PageState::UpToDate);
-                let mut inner = cache.inner.lock();
-                inner.dirty_pages.remove(&page_index);
+                cache.pages.clear_mark(page_index, PAGECACHE_TAG_DIRTY);
             }
         }
+        cache.pages.clear_mark(page_index, PAGECACHE_TAG_WRITEBACK);
         entry.wait_queue.wake_all();
         Ok(())
     }
@@ -917,6 +932,7 @@ impl PageEntry {
         Self {
             page,
             state: AtomicU8::new(state as u8),
+            readahead: AtomicBool::new(false),
             wait_queue: WaitQueue::default(),
         }
     }
@@ -966,22 +982,24 @@ impl PageEntry {
 }
 
 impl InnerPageCache {
-    pub fn new(page_cache_ref: Weak<PageCache>, id: usize) -> InnerPageCache {
+    pub fn new(
+        page_cache_ref: Weak<PageCache>,
+        id: usize,
+        pages: Arc<XArray<PageEntry>>,
+    ) -> InnerPageCache {
         Self {
             id,
-            pages: HashMap::new(),
-            dirty_pages: BTreeSet::new(),
+            pages,
             page_cache_ref,
         }
     }
 
     pub fn get_page(&self, offset: usize) -> Option<Arc<Page>> {
-        self.pages.get(&offset).map(|entry| entry.page.clone())
+        self.pages.load(offset).map(|entry| entry.page.clone())
     }
 
     pub fn remove_page(&mut self, offset: usize) -> Option<Arc<Page>> {
-        let entry = self.pages.remove(&offset)?;
-        self.dirty_pages.remove(&offset);
+        let entry = self.pages.erase(offset)?;
         if let Some(cache) = self.page_cache_ref.upgrade() {
             cache.account_entry_remove(entry.state());
         }
@@ -989,34 +1007,32 @@ impl InnerPageCache {
     }
 
     fn get_entry(&self, offset: usize) -> Option<Arc<PageEntry>> {
-        self.pages.get(&offset).cloned()
+        self.pages.load(offset)
     }
 
     fn insert_entry(&mut self, offset: usize, entry: Arc<PageEntry>) {
-        self.pages.insert(offset, entry);
+        self.pages.store(offset, entry);
         if let Some(cache) = self.page_cache_ref.upgrade() {
             cache.account_entry_insert();
         }
     }
 
-    fn is_page_ready(&self, offset: usize) -> bool {
-        self.pages
-            .get(&offset)
-            .map(|entry| entry.state().is_ready())
-            .unwrap_or(false)
-    }
-
     pub fn resize(&mut self, len: usize) -> Result<(), SystemError> {
         let page_num = page_align_up(len) / MMArch::PAGE_SIZE;
 
         let mut reclaimer = page_reclaimer_lock();
-        for (i, entry) in self.pages.drain_filter(|index, entry| {
-            *index >= page_num && entry.state().is_ready() && entry.state() != PageState::Writeback
-        }) {
-            self.dirty_pages.remove(&i);
-            let _ = reclaimer.remove_page(&entry.page.phys_address());
+        for (i, entry) in self
+            .pages
+            .collect_range(page_num, usize::MAX, None, usize::MAX)
+        {
+            let state = entry.state();
+            if !state.is_ready() || state == PageState::Writeback {
+                continue;
+            }
+            self.pages.erase(i);
+            let _ = reclaimer.remove_page(&entry.page);
             if let Some(cache) = self.page_cache_ref.upgrade() {
-                cache.account_entry_remove(entry.state());
+                cache.account_entry_remove(state);
             }
         }
 
@@ -1042,25 +1058,20 @@ impl InnerPageCache {
     fn evict_pages_inner(&mut self, range: Option<(usize, usize)>, policy: EvictPolicy) -> usize {
         let mut evicted = 0;
         let mut page_reclaimer = page_reclaimer_lock();
-        let indices: Vec<usize> = match range {
-            Some((start, end)) => (start..=end).collect(),
-            None => self.pages.keys().cloned().collect(),
-        };
+        let (start, end) = range.unwrap_or((0, usize::MAX));
 
-        for idx in indices {
-            if let Some(entry) = self.pages.get(&idx) {
-                if !policy.can_evict(entry) {
-                    continue;
-                }
-                if Arc::strong_count(&entry.page) > 3 {
-                    continue;
-                }
-                if let Some(removed_page) = self.remove_page(idx) {
-                    let paddr = removed_page.phys_address();
-                    page_manager_lock().remove_page(&paddr);
-                    let _ = page_reclaimer.remove_page(&paddr);
-                    evicted += 1;
-                }
+        for (idx, entry) in self.pages.collect_range(start, end, None, usize::MAX) {
+            if !policy.can_evict(&entry) {
+                continue;
+            }
+            if Arc::strong_count(&entry.page) > 3 {
+                continue;
+            }
+            if let Some(removed_page) = self.remove_page(idx) {
+                let paddr = removed_page.phys_address();
+                page_manager().remove_page(&paddr);
+                let _ = page_reclaimer.remove_page(&removed_page);
+                evicted += 1;
             }
         }
 
@@ -1082,8 +1093,8 @@ impl InnerPageCache {
 impl Drop for InnerPageCache {
     fn drop(&mut self) {
         // log::debug!("page cache drop");
-        let mut page_manager = page_manager_lock();
-        for entry in self.pages.values() {
+        let page_manager = page_manager();
+        for (_, entry) in self.pages.collect_range(0, usize::MAX, None, usize::MAX) {
             if let Some(cache) = self.page_cache_ref.upgrade() {
                 cache.account_entry_remove(entry.state());
             }
@@ -1100,9 +1111,11 @@ impl PageCache {
         backend: Option<Arc<dyn PageCacheBackend>>,
     ) -> Arc<PageCache> {
         let id = PAGE_CACHE_ID.fetch_add(1, Ordering::SeqCst);
+        let pages = Arc::new(XArray::new());
         let cache = Arc::new_cyclic(|weak| Self {
             id,
-            inner: Mutex::new(InnerPageCache::new(weak.clone(), id)),
+            pages: pages.clone(),
+            inner: Mutex::new(InnerPageCache::new(weak.clone(), id, pages)),
             inode: {
                 let v: Lazy<Weak<dyn IndexNode>> = Lazy::new();
                 if let Some(inode) = inode {
@@ -1165,9 +1178,20 @@ impl PageCache {
         self.id
     }
 
-    /// Fast check for dirty pages (no full dirty-set traversal, just emptiness test).
+    /// Fast check for dirty pages (only tests the DIRTY tag of the root node).
     pub fn has_dirty_pages(&self) -> bool {
-        !self.inner.lock().dirty_pages.is_empty()
+        self.pages.marked(PAGECACHE_TAG_DIRTY)
+    }
+
+    fn clear_state_tags(&self, page_index: usize) {
+        self.pages.clear_mark(page_index, PAGECACHE_TAG_DIRTY);
+        self.pages.clear_mark(page_index, PAGECACHE_TAG_WRITEBACK);
+    }
+
+    /// 页面进入Writeback状态时更新它的标记
+    fn set_writeback_tags(&self, page_index: usize) {
+        self.pages.set_mark(page_index, PAGECACHE_TAG_WRITEBACK);
+        self.pages.clear_mark(page_index, PAGECACHE_TAG_DIRTY);
     }
 
     pub fn inode(&self) -> Option<Weak<dyn IndexNode>> {
@@ -1339,15 +1363,12 @@ impl PageCache {
         self.unmap_mapping_pages(hole_start_page, None)?;
 
         let first_full_truncate_page = page_align_up(new_size) >> MMArch::PAGE_SHIFT;
-        let truncate_indices: Vec<usize> = {
-            let guard = self.inner.lock();
-            guard
-                .pages
-                .keys()
-                .copied()
-                .filter(|index| *index >= first_full_truncate_page)
-                .collect()
-        };
+        let truncate_indices: Vec<usize> = self
+            .pages
+            .collect_range(first_full_truncate_page, usize::MAX, None, usize::MAX)
+            .into_iter()
+            .map(|(index, _)| index)
+            .collect();
 
         for page_index in truncate_indices {
             loop {
@@ -1384,9 +1405,9 @@ impl PageCache {
                     // The page is no longer reachable from this page cache, so it must not
                     // remain on the file-page reclaimer LRU even if existing mappings still
                     // keep its Page metadata alive via page_manager.
-                    let _ = page_reclaimer_lock().remove_page(&paddr);
+                    let _ = page_reclaimer_lock().remove_page(&page);
                     if can_remove_from_manager {
-                        page_manager_lock().remove_page(&paddr);
+                        page_manager().remove_page(&paddr);
                     }
                 }
                 break;
@@ -1567,7 +1588,7 @@ impl PageCache {
         page_cache_ref: Weak<PageCache>,
         page_index: usize,
     ) -> Result<Arc<Page>, SystemError> {
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         page_manager_guard.create_one_page(
             PageType::File(FileMapInfo {
                 page_cache: page_cache_ref,
@@ -1621,18 +1642,7 @@ impl PageCache {
         page_index: usize,
         populate_backend: bool,
     ) -> Result<Arc<PageEntry>, SystemError> {
-        let mut page_cache_ref = None;
-        let mut existing_entry = None;
-        {
-            let guard = self.inner.lock();
-            if let Some(entry) = guard.get_entry(page_index) {
-                existing_entry = Some(entry);
-            } else {
-                page_cache_ref = Some(guard.page_cache_ref.clone());
-            }
-        }
-
-        if let Some(entry) = existing_entry {
+        if let Some(entry) = self.pages.load(page_index) {
             let state = entry.state();
             if state.is_ready() {
                 return Ok(entry);
@@ -1640,14 +1650,14 @@ impl PageCache {
             if state == PageState::Error {
                 return Err(SystemError::EIO);
             }
+            if populate_backend {
+                count_vm_events(VmEvent::FileRaStall, 1);
+            }
             let _ = entry.wait_ready()?;
             return Ok(entry);
         }
 
-        let mut page = Some(self.allocate_page(
-            page_cache_ref.expect("page_cache_ref should exist"),
-            page_index,
-        )?);
+        let mut page = Some(self.allocate_page(self.manager.owner.clone(), page_index)?);
 
         let (entry, need_populate) = {
             let mut guard = self.inner.lock();
@@ -1674,11 +1684,15 @@ impl PageCache {
             if state == PageState::Error {
                 return Err(SystemError::EIO);
             }
+            if populate_backend {
+                count_vm_events(VmEvent::FileRaStall, 1);
+            }
             let _ = entry.wait_ready()?;
             return Ok(entry);
         }
 
         let populate_result = if populate_backend {
+            count_vm_events(VmEvent::FileRaStall, 1);
             self.populate_page_from_backend(page_index, &entry.page)
         } else {
             self.populate_page_zero(&entry.page)
@@ -1703,11 +1717,7 @@ impl PageCache {
         let mut guard = self.inner.lock();
         if let Some(current) = guard.get_entry(page_index) {
             if Arc::ptr_eq(&current, entry) {
-                guard.pages.remove(&page_index);
-                guard.dirty_pages.remove(&page_index);
-                if let Some(cache) = guard.page_cache_ref.upgrade() {
-                    cache.account_entry_remove(entry.state());
-                }
+                guard.remove_page(page_index);
             }
         }
         self.discard_unlinked_page(&entry.page);
@@ -1722,62 +1732,36 @@ impl PageCache {
             if entry.state() != PageState::Error {
                 return;
             }
-            guard.dirty_pages.remove(&page_index);
-            let removed = guard.pages.remove(&page_index);
-            if let Some(entry) = removed.as_ref() {
-                if let Some(cache) = guard.page_cache_ref.upgrade() {
-                    cache.account_entry_remove(entry.state());
-                }
-            }
-            removed
+            guard.remove_page(page_index)
         };
 
-        if let Some(entry) = removed {
-            self.discard_unlinked_page(&entry.page);
+        if let Some(page) = removed {
+            self.discard_unlinked_page(&page);
         }
     }
 
     fn discard_unlinked_page(&self, page: &Arc<Page>) {
         let paddr = page.phys_address();
-        page_manager_lock().remove_page(&paddr);
-        let _ = page_reclaimer_lock().remove_page(&paddr);
+        page_manager().remove_page(&paddr);
+        let _ = page_reclaimer_lock().remove_page(page);
     }
 
-    fn start_async_read(&self, page_index: usize) -> Result<(), SystemError> {
-        let mut existing_entry = None;
-        let mut page_cache_ref = None;
-        {
-            let guard = self.inner.lock();
-            if let Some(entry) = guard.get_entry(page_index) {
-                existing_entry = Some(entry);
-            } else {
-                page_cache_ref = Some(guard.page_cache_ref.clone());
-            }
-        }
-
-        if let Some(entry) = existing_entry {
-            let state = entry.state();
-            if matches!(
-                state,
-                PageState::Loading | PageState::Writeback | PageState::Error
-            ) {
-                return Ok(());
-            }
-            return Ok(());
+    /// 为不在缓存中的页面发起异步读取，返回是否发起了读取
+    fn start_async_read(&self, page_index: usize, marker: bool) -> Result<bool, SystemError> {
+        if self.pages.load(page_index).is_some() {
+            return Ok(false);
         }
 
-        let page = self.allocate_page(
-            page_cache_ref.expect("page_cache_ref should exist"),
-            page_index,
-        )?;
+        let page = self.allocate_page(self.manager.owner.clone(), page_index)?;
 
         let entry = {
             let mut guard = self.inner.lock();
             if guard.get_entry(page_index).is_some() {
                 self.discard_unlinked_page(&page);
-                return Ok(());
+                return Ok(false);
             }
             let entry = Arc::new(PageEntry::new(page, PageState::Loading));
+            entry.readahead.store(marker, Ordering::Relaxed);
             guard.insert_entry(page_index, entry.clone());
             entry
         };
@@ -1816,17 +1800,18 @@ impl PageCache {
             entry_clone.wait_queue.wake_all();
         });
         schedule_work(work);
-        Ok(())
+        Ok(true)
     }
 
     pub fn is_page_ready(&self, page_index: usize) -> bool {
-        self.inner.lock().is_page_ready(page_index)
+        self.pages
+            .load(page_index)
+            .is_some_and(|entry| entry.state().is_ready())
     }
 
     pub fn get_ready_page(&self, page_index: usize) -> Option<Arc<Page>> {
-        let guard = self.inner.lock();
-        guard
-            .get_entry(page_index)
+        self.pages
+            .load(page_index)
             .filter(|entry| entry.state().is_ready())
             .map(|entry| entry.page.clone())
     }
@@ -1840,10 +1825,10 @@ impl PageCache {
     }
 
     pub fn mark_page_dirty(&self, page_index: usize) {
-        let mut guard = self.inner.lock();
+        let guard = self.inner.lock();
         if let Some(entry) = guard.get_entry(page_index) {
             let old_state = entry.state();
-            guard.dirty_pages.insert(page_index);
+            self.pages.set_mark(page_index, PAGECACHE_TAG_DIRTY);
             if old_state == PageState::Writeback {
                 return;
             }
@@ -1853,34 +1838,34 @@ impl PageCache {
     }
 
     pub fn mark_page_writeback(&self, page_index: usize) {
-        let mut guard = self.inner.lock();
+        let guard = self.inner.lock();
         if let Some(entry) = guard.get_entry(page_index) {
             let old_state = entry.state();
             self.account_state_transition(old_state, PageState::Writeback);
             entry.set_state(PageState::Writeback);
-            guard.dirty_pages.remove(&page_index);
+            self.set_writeback_tags(page_index);
         }
     }
 
     pub fn mark_page_uptodate(&self, page_index: usize) {
-        let mut guard = self.inner.lock();
+        let guard = self.inner.lock();
         if let Some(entry) = guard.get_entry(page_index) {
             let old_state = entry.state();
             self.account_state_transition(old_state, PageState::UpToDate);
             entry.set_state(PageState::UpToDate);
-            guard.dirty_pages.remove(&page_index);
+            self.clear_state_tags(page_index);
         }
     }
 
     pub fn mark_page_error(&self, page_index: usize, error: SystemError) {
         self.record_writeback_error_with_superblock(error);
-        let mut guard = self.inner.lock();
+        let guard = self.inner.lock();
         if let Some(entry) = guard.get_entry(page_index) {
             let old_state = entry.state();
             self.account_state_transition(old_state, PageState::Error);
             entry.set_state(PageState::Error);
             entry.wait_queue.wake_all();
-            guard.dirty_pages.remove(&page_index);
+            self.clear_state_tags(page_index);
         }
     }
 
@@ -1896,11 +1881,54 @@ impl PageCache {
         Ok(())
     }
 
-    pub fn read_pages(&self, start_page_index: usize, page_num: usize) -> Result<(), SystemError> {
+    /// 为`[start_page_index, start_page_index + page_num)`中不在缓存里的页面发起异步读取
+    ///
+    /// 如果`marker`处的页面是本次新读取的，给它打上预读标记。返回发起读取的页数。
+    pub fn read_pages(
+        &self,
+        start_page_index: usize,
+        page_num: usize,
+        marker: Option<usize>,
+    ) -> Result<usize, SystemError> {
+        let mut submitted = 0;
         for i in 0..page_num {
-            self.start_async_read(start_page_index + i)?;
+            let index = start_page_index + i;
+            if self.start_async_read(index, marker == Some(index))? {
+                submitted += 1;
+            }
         }
-        Ok(())
+        Ok(submitted)
+    }
+
+    /// 清除`page_index`处页面的预读标记，返回清除前是否带有标记
+    ///
+    /// 页面不在缓存中时返回None。
+    pub fn test_clear_readahead(&self, page_index: usize) -> Option<bool> {
+        let entry = self.pages.load(page_index)?;
+        Some(
+            entry.readahead.load(Ordering::Relaxed)
+                && entry.readahead.swap(false, Ordering::Relaxed),
+        )
+    }
+
+    /// 从`index`开始向后找第一个不在缓存中的页，最多检查`max_scan`页
+    ///
+    /// 都在缓存中时返回`index + max_scan`（与Linux的page_cache_next_miss相同）。
+    pub fn next_miss(&self, index: usize, max_scan: usize) -> usize {
+        (index..index.saturating_add(max_scan))
+            .find(|idx| self.pages.load(*idx).is_none())
+            .unwrap_or(index.saturating_add(max_scan))
+    }
+
+    /// 从`index`开始向前找第一个不在缓存中的页，最多检查`max_scan`页
+    ///
+    /// 一直到第0页都在缓存中时返回None。
+    pub fn prev_miss(&self, index: usize, max_scan: usize) -> Option<usize> {
+        let lowest = index.saturating_sub(max_scan.saturating_sub(1));
+        (lowest..=index)
+            .rev()
+            .find(|idx| self.pages.load(*idx).is_none())
+            .or(if lowest == 0 { None } else { Some(lowest - 1) })
     }
 
     /// 两阶段读取：持锁收集拷贝项，解锁后拷贝到目标缓冲区，避免用户缺页导致自锁
@@ -1949,7 +1977,7 @@ impl PageCache {
         }
 
         let mut dst_offset = 0;
-        for item in copies {
+        for (i, item) in copies.into_iter().enumerate() {
             // 先prefault，避免在持锁后触发缺页
             let byte = volatile_read!(buf[dst_offset]);
             volatile_write!(buf[dst_offset], byte);
@@ -1959,6 +1987,10 @@ impl PageCache {
                     &page_guard.as_slice()[item.page_offset..item.page_offset + item.sub_len],
                 );
             }
+            drop(page_guard);
+            if should_mark_accessed(i, &item) {
+                mark_page_accessed(&item.entry.page);
+            }
             dst_offset += item.sub_len;
         }
 
@@ -2004,7 +2036,10 @@ impl PageCache {
         }
 
         let mut src_offset = 0;
-        for item in copies {
+        for (i, item) in copies.into_iter().enumerate() {
+            if should_mark_accessed(i, &item) {
+                mark_page_accessed(&item.entry.page);
+            }
             // 预触发用户缓冲区当前段，避免后续在持页锁时缺页
             let _ = volatile_read!(buf[src_offset]);
             let mut page_guard = item.entry.page.write();
@@ -0,0 +1,96 @@
+//! /proc/lock_stat - 休眠锁的按类争用统计
+//!
+//! 每行对应一个锁类别（Mutex/RwSem的初始化位置）：加锁次数、快速路径失败次数、
+//! 在乐观自旋/等待队列中拿到锁的次数，以及自旋和睡眠各自花费的时间（微秒）。
+//! 统计需要先通过 /proc/sys/kernel/lock_stat 打开；向本文件写入0清零所有统计。
+
+use crate::libs::mutex::MutexGuard;
+use crate::{
+    filesystem::{
+        procfs::{
+            template::{Builder, FileOps, ProcFileBuilder},
+            utils::proc_read,
+        },
+        vfs::{FilePrivateData, IndexNode, InodeMode},
+    },
+    libs::lock_stat::{lock_stat_clear, lock_stat_snapshot},
+};
+use alloc::{
+    format,
+    string::String,
+    sync::{Arc, Weak},
+};
+use core::{fmt::Write, sync::atomic::Ordering};
+use system_error::SystemError;
+
+/// /proc/lock_stat 文件的 FileOps 实现
+#[derive(Debug)]
+pub struct LockStatFileOps;
+
+impl LockStatFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::from_bits_truncate(0o644))
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+
+    fn generate_content() -> String {
+        let mut data = format!(
+            "{:<56} {:<5} {:>12} {:>10} {:>13} {:>14} {:>12} {:>12}\n",
+            "class",
+            "type",
+            "acquisitions",
+            "contended",
+            "spin_acquired",
+            "sleep_acquired",
+            "spin_us",
+            "sleep_us"
+        );
+
+        for stats in lock_stat_snapshot() {
+            let site = stats.site();
+            let _ = writeln!(
+                data,
+                "{:<56} {:<5} {:>12} {:>10} {:>13} {:>14} {:>12} {:>12}",
+                format!("{}:{}:{}", site.file(), site.line(), site.column()),
+                stats.kind().name(),
+                stats.acquisitions.load(Ordering::Relaxed),
+                stats.contended.load(Ordering::Relaxed),
+                stats.spin_acquired.load(Ordering::Relaxed),
+                stats.sleep_acquired.load(Ordering::Relaxed),
+                stats.spin_ns.load(Ordering::Relaxed) / 1000,
+                stats.sleep_ns.load(Ordering::Relaxed) / 1000,
+            );
+        }
+        data
+    }
+}
+
+impl FileOps for LockStatFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = Self::generate_content();
+        proc_read(offset, len, buf, content.as_bytes())
+    }
+
+    fn write_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let input = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        if input.trim() != "0" {
+            return Err(SystemError::EINVAL);
+        }
+        lock_stat_clear();
+        Ok(buf.len())
+    }
+}
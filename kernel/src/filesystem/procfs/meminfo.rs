@@ -13,7 +13,9 @@ use crate::{
         vfs::{FilePrivateData, IndexNode, InodeMode},
     },
     mm::allocator::page_frame::FrameAllocator,
+    mm::huge_memory::{self, HPAGE_PMD_SIZE},
     mm::page_cache_stats,
+    mm::swap::{swap_state::swap_cache_pages, swapfile::swap_totals},
 };
 use alloc::{
     borrow::ToOwned,
@@ -64,8 +66,22 @@ impl MeminfoFileOps {
                 .as_bytes()
                 .to_owned(),
         );
-        data.append(&mut format!("SwapTotal:\t{} kB\n", 0u64).as_bytes().to_owned());
-        data.append(&mut format!("SwapFree:\t{} kB\n", 0u64).as_bytes().to_owned());
+        data.append(
+            &mut format!("SwapCached:\t{} kB\n", swap_cache_pages() as u64 * page_kb)
+                .as_bytes()
+                .to_owned(),
+        );
+        let (swap_total, swap_free) = swap_totals();
+        data.append(
+            &mut format!("SwapTotal:\t{} kB\n", swap_total as u64 * page_kb)
+                .as_bytes()
+                .to_owned(),
+        );
+        data.append(
+            &mut format!("SwapFree:\t{} kB\n", swap_free as u64 * page_kb)
+                .as_bytes()
+                .to_owned(),
+        );
         data.append(
             &mut format!("Dirty:\t\t{} kB\n", stats.file_dirty * page_kb)
                 .as_bytes()
@@ -93,6 +109,12 @@ impl MeminfoFileOps {
                 .to_owned(),
         );
         data.append(&mut format!("SUnreclaim:\t{} kB\n", 0u64).as_bytes().to_owned());
+        let anon_huge_kb = huge_memory::thp_stats().nr_anon_thps * (HPAGE_PMD_SIZE >> 10) as u64;
+        data.append(
+            &mut format!("AnonHugePages:\t{} kB\n", anon_huge_kb)
+                .as_bytes()
+                .to_owned(),
+        );
 
         // 去除多余的 \0 并在结尾添加 \0
         trim_string(&mut data);
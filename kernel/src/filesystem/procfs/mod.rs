@@ -19,17 +19,21 @@ pub mod klog;
 pub mod kmsg;
 mod kmsg_file;
 mod loadavg;
+mod lock_stat;
 mod meminfo;
 mod mount;
 mod net;
 mod pid;
 pub mod root;
 mod self_;
+mod slab_magazines;
 mod stat;
+mod swaps;
 mod sys;
 mod syscall;
 pub(super) mod template;
 mod thread_self;
+mod tlb_shootdown;
 mod utils;
 mod version;
 mod version_signature;
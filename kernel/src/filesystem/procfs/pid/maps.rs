@@ -142,7 +142,19 @@ fn generate_maps_content(target: &ProcPidTarget) -> Result<Vec<u8>, SystemError>
             let inode = f.inode();
             format_dev_inode_and_path(Some(inode.as_ref()), &root_prefix)
         } else {
-            format_dev_inode_and_path(None, &root_prefix)
+            let (dev_ino, mut tail) = format_dev_inode_and_path(None, &root_prefix);
+            // vDSO镜像及其前方的vvar页按Linux的习惯命名，调试器依赖[vdso]定位镜像
+            let vdso_base = as_guard.vdso_base;
+            if vdso_base.data() != 0 {
+                if region.start() == vdso_base {
+                    tail.push_str(" [vdso]");
+                } else if region.end() == vdso_base {
+                    tail.push_str(" [vvar_vclock]");
+                } else if region.end() == vdso_base - MMArch::PAGE_SIZE {
+                    tail.push_str(" [vvar]");
+                }
+            }
+            (dev_ino, tail)
         };
 
         let line = format!(
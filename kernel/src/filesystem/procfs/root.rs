@@ -11,17 +11,21 @@ use crate::{
             cpuinfo::CpuInfoFileOps,
             kmsg_file::KmsgFileOps,
             loadavg::LoadavgFileOps,
+            lock_stat::LockStatFileOps,
             meminfo::MeminfoFileOps,
             net::NetDirOps,
             pid::PidDirOps,
             self_::SelfSymOps,
+            slab_magazines::SlabMagazinesFileOps,
             stat::StatFileOps,
+            swaps::SwapsFileOps,
             sys::SysDirOps,
             template::{
                 lookup_child_from_table, populate_children_from_table, DirOps, ProcDir,
                 ProcDirBuilder,
             },
             thread_self::ThreadSelfSymOps,
+            tlb_shootdown::TlbShootdownFileOps,
             version::VersionFileOps,
             version_signature::VersionSignatureFileOps,
             vmstat::VmstatFileOps,
@@ -88,6 +92,7 @@ impl RootDirOps {
         ("cpuinfo", CpuInfoFileOps::new_inode),
         ("kmsg", KmsgFileOps::new_inode),
         ("loadavg", LoadavgFileOps::new_inode),
+        ("lock_stat", LockStatFileOps::new_inode),
         ("meminfo", MeminfoFileOps::new_inode),
         (
             "mounts",
@@ -95,9 +100,12 @@ impl RootDirOps {
         ),
         ("net", NetDirOps::new_inode),
         ("self", SelfSymOps::new_inode),
+        ("slab_magazines", SlabMagazinesFileOps::new_inode),
         ("stat", StatFileOps::new_inode),
+        ("swaps", SwapsFileOps::new_inode),
         ("sys", SysDirOps::new_inode),
         ("thread-self", ThreadSelfSymOps::new_inode),
+        ("tlb_shootdown", TlbShootdownFileOps::new_inode),
         ("version", VersionFileOps::new_inode),
         ("version_signature", VersionSignatureFileOps::new_inode),
         ("vmstat", VmstatFileOps::new_inode),
@@ -0,0 +1,76 @@
+//! /proc/slab_magazines - slab per-cpu对象缓存的命中统计
+//!
+//! 每行对应一个CPU，用于确认小对象分配是否已经离开全局slab锁。
+
+use crate::libs::mutex::MutexGuard;
+use crate::{
+    filesystem::{
+        procfs::{
+            template::{Builder, FileOps, ProcFileBuilder},
+            utils::{proc_read, trim_string},
+        },
+        vfs::{FilePrivateData, IndexNode, InodeMode},
+    },
+    mm::allocator::slab::slab_cpu_stat,
+    smp::cpu::smp_cpu_manager,
+};
+use alloc::{borrow::ToOwned, format, sync::Arc, sync::Weak, vec::Vec};
+use core::sync::atomic::Ordering;
+use system_error::SystemError;
+
+/// /proc/slab_magazines 文件的 FileOps 实现
+#[derive(Debug)]
+pub struct SlabMagazinesFileOps;
+
+impl SlabMagazinesFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::S_IRUGO)
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+
+    fn generate_content() -> Vec<u8> {
+        let mut data: Vec<u8> = Vec::new();
+        data.append(
+            &mut "cpu alloc_hit alloc_miss free_hit free_miss bypass\n"
+                .as_bytes()
+                .to_owned(),
+        );
+
+        for cpu_id in smp_cpu_manager().present_cpus().iter_cpu() {
+            let Some(stat) = slab_cpu_stat(cpu_id) else {
+                continue;
+            };
+            data.append(
+                &mut format!(
+                    "cpu{} {} {} {} {} {}\n",
+                    cpu_id.data(),
+                    stat.alloc_hit.load(Ordering::Relaxed),
+                    stat.alloc_miss.load(Ordering::Relaxed),
+                    stat.free_hit.load(Ordering::Relaxed),
+                    stat.free_miss.load(Ordering::Relaxed),
+                    stat.bypass.load(Ordering::Relaxed),
+                )
+                .as_bytes()
+                .to_owned(),
+            );
+        }
+
+        trim_string(&mut data);
+        data
+    }
+}
+
+impl FileOps for SlabMagazinesFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = Self::generate_content();
+        proc_read(offset, len, buf, &content)
+    }
+}
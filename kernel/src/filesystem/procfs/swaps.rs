@@ -0,0 +1,66 @@
+//! /proc/swaps - 已启用的交换空间
+//!
+//! 格式与Linux相同：文件名、类型、大小与已用量（KB）、优先级。
+
+use crate::libs::mutex::MutexGuard;
+use crate::{
+    filesystem::{
+        procfs::{
+            template::{Builder, FileOps, ProcFileBuilder},
+            utils::{proc_read, trim_string},
+        },
+        vfs::{FilePrivateData, IndexNode, InodeMode},
+    },
+    mm::swap::swapfile::swaps_lines,
+};
+use alloc::{borrow::ToOwned, format, sync::Arc, sync::Weak, vec::Vec};
+use system_error::SystemError;
+
+/// /proc/swaps 文件的 FileOps 实现
+#[derive(Debug)]
+pub struct SwapsFileOps;
+
+impl SwapsFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::S_IRUGO)
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+
+    fn generate_content() -> Vec<u8> {
+        let mut data: Vec<u8> = Vec::new();
+        data.append(
+            &mut "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+                .as_bytes()
+                .to_owned(),
+        );
+
+        for line in swaps_lines() {
+            data.append(
+                &mut format!(
+                    "{:<40}{:<16}{}\t\t{}\t\t{}\n",
+                    line.name, line.kind, line.size_kb, line.used_kb, line.prio
+                )
+                .as_bytes()
+                .to_owned(),
+            );
+        }
+
+        trim_string(&mut data);
+        data
+    }
+}
+
+impl FileOps for SwapsFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = Self::generate_content();
+        proc_read(offset, len, buf, &content)
+    }
+}
@@ -11,7 +11,10 @@ use crate::{
         },
         vfs::{FilePrivateData, IndexNode, InodeMode},
     },
-    libs::mutex::MutexGuard,
+    libs::{
+        lock_stat::{lock_stat_enabled, lock_stat_set_enabled},
+        mutex::MutexGuard,
+    },
 };
 use alloc::{
     format,
@@ -73,6 +76,16 @@ impl DirOps for KernelDirOps {
                 cached_children.insert(name.to_string(), inode.clone());
                 return Ok(inode);
             }
+            "lock_stat" => {
+                let mut cached_children = dir.cached_children().write();
+                if let Some(child) = cached_children.get(name) {
+                    return Ok(child.clone());
+                }
+
+                let inode = LockStatSwitchFileOps::new_inode(dir.self_ref_weak().clone());
+                cached_children.insert(name.to_string(), inode.clone());
+                return Ok(inode);
+            }
             _ => Err(SystemError::ENOENT),
         }
     }
@@ -92,6 +105,9 @@ impl DirOps for KernelDirOps {
             .or_insert_with(|| {
                 OverflowIdFileOps::new_inode(dir.self_ref_weak().clone(), OverflowIdKind::Gid)
             });
+        cached_children
+            .entry("lock_stat".to_string())
+            .or_insert_with(|| LockStatSwitchFileOps::new_inode(dir.self_ref_weak().clone()));
     }
 }
 
@@ -223,3 +239,49 @@ impl FileOps for OverflowIdFileOps {
         Ok(buf.len())
     }
 }
+
+/// /proc/sys/kernel/lock_stat：打开（1）或关闭（0）休眠锁的争用统计，统计结果见 /proc/lock_stat
+#[derive(Debug)]
+pub struct LockStatSwitchFileOps;
+
+impl LockStatSwitchFileOps {
+    fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::from_bits_truncate(0o644))
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+}
+
+impl FileOps for LockStatSwitchFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = alloc::format!("{}\n", lock_stat_enabled() as u32);
+        proc_read(offset, len, buf, content.as_bytes())
+    }
+
+    fn write_at(
+        &self,
+        offset: usize,
+        _len: usize,
+        buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        if offset > 0 {
+            return Ok(buf.len());
+        }
+
+        let input = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        match input.trim() {
+            "0" => lock_stat_set_enabled(false),
+            "1" => lock_stat_set_enabled(true),
+            _ => return Err(SystemError::EINVAL),
+        }
+        Ok(buf.len())
+    }
+}
@@ -3,12 +3,16 @@
 use crate::libs::mutex::MutexGuard;
 use crate::{
     filesystem::{
-        procfs::template::{Builder, DirOps, FileOps, ProcDir, ProcDirBuilder, ProcFileBuilder},
+        procfs::{
+            template::{Builder, DirOps, FileOps, ProcDir, ProcDirBuilder, ProcFileBuilder},
+            utils::proc_read,
+        },
         vfs::{FilePrivateData, IndexNode, InodeMode},
     },
-    mm::{page::PageReclaimer, page_cache_stats},
+    mm::{allocator::slab::slab_drain_cpu_caches, lru, page::PageReclaimer, page_cache_stats, tlb},
 };
 use alloc::{
+    format,
     string::ToString,
     sync::{Arc, Weak},
     vec::Vec,
@@ -37,18 +41,21 @@ impl DirOps for VmDirOps {
         dir: &ProcDir<Self>,
         name: &str,
     ) -> Result<Arc<dyn IndexNode>, SystemError> {
-        if name == "drop_caches" {
-            let mut cached_children = dir.cached_children().write();
-            if let Some(child) = cached_children.get(name) {
-                return Ok(child.clone());
-            }
-
-            let inode = DropCachesFileOps::new_inode(dir.self_ref_weak().clone());
-            cached_children.insert(name.to_string(), inode.clone());
-            return Ok(inode);
+        let new_inode = match name {
+            "drop_caches" => DropCachesFileOps::new_inode,
+            "min_free_kbytes" => MinFreeKbytesFileOps::new_inode,
+            "tlb_single_page_flush_ceiling" => TlbFlushCeilingFileOps::new_inode,
+            _ => return Err(SystemError::ENOENT),
+        };
+
+        let mut cached_children = dir.cached_children().write();
+        if let Some(child) = cached_children.get(name) {
+            return Ok(child.clone());
         }
 
-        Err(SystemError::ENOENT)
+        let inode = new_inode(dir.self_ref_weak().clone());
+        cached_children.insert(name.to_string(), inode.clone());
+        Ok(inode)
     }
 
     fn populate_children(&self, dir: &ProcDir<Self>) {
@@ -56,6 +63,12 @@ impl DirOps for VmDirOps {
         cached_children
             .entry("drop_caches".to_string())
             .or_insert_with(|| DropCachesFileOps::new_inode(dir.self_ref_weak().clone()));
+        cached_children
+            .entry("min_free_kbytes".to_string())
+            .or_insert_with(|| MinFreeKbytesFileOps::new_inode(dir.self_ref_weak().clone()));
+        cached_children
+            .entry("tlb_single_page_flush_ceiling".to_string())
+            .or_insert_with(|| TlbFlushCeilingFileOps::new_inode(dir.self_ref_weak().clone()));
     }
 }
 
@@ -93,7 +106,7 @@ impl DropCachesFileOps {
         }
 
         if drop_slab {
-            log::warn!("drop_caches: drop_slab not supported");
+            slab_drain_cpu_caches();
         }
 
         if quiet {
@@ -127,3 +140,86 @@ impl FileOps for DropCachesFileOps {
         Self::write_config(buf)
     }
 }
+
+/// /proc/sys/vm/min_free_kbytes 文件的 FileOps 实现
+///
+/// 修改后`low`/`high`水位随之重新计算。
+#[derive(Debug)]
+pub struct MinFreeKbytesFileOps;
+
+impl MinFreeKbytesFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::from_bits_truncate(0o644))
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+}
+
+impl FileOps for MinFreeKbytesFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = format!("{}\n", lru::min_free_kbytes());
+        proc_read(offset, len, buf, content.as_bytes())
+    }
+
+    fn write_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let input = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        let value: usize = input.trim().parse().map_err(|_| SystemError::EINVAL)?;
+        lru::set_min_free_kbytes(value);
+        PageReclaimer::wakeup_claim_thread();
+        Ok(buf.len())
+    }
+}
+
+/// /proc/sys/vm/tlb_single_page_flush_ceiling 文件的 FileOps 实现
+///
+/// 一次shootdown超过这么多页时改为整体刷新TLB
+#[derive(Debug)]
+pub struct TlbFlushCeilingFileOps;
+
+impl TlbFlushCeilingFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::from_bits_truncate(0o644))
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+}
+
+impl FileOps for TlbFlushCeilingFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = format!("{}\n", tlb::tlb_single_page_flush_ceiling());
+        proc_read(offset, len, buf, content.as_bytes())
+    }
+
+    fn write_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let input = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        let value: usize = input.trim().parse().map_err(|_| SystemError::EINVAL)?;
+        tlb::set_tlb_single_page_flush_ceiling(value);
+        Ok(buf.len())
+    }
+}
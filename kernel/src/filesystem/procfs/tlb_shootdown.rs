@@ -0,0 +1,77 @@
+//! /proc/tlb_shootdown - 每个CPU的TLB shootdown统计
+//!
+//! 每行对应一个CPU：发出/收到的shootdown IPI数、因对方处于lazy TLB或已经追上
+//! tlb_gen而省掉的IPI数、整体刷新次数和逐页刷新的页数。
+
+use crate::libs::mutex::MutexGuard;
+use crate::{
+    filesystem::{
+        procfs::{
+            template::{Builder, FileOps, ProcFileBuilder},
+            utils::{proc_read, trim_string},
+        },
+        vfs::{FilePrivateData, IndexNode, InodeMode},
+    },
+    mm::tlb::tlb_cpu_stat,
+    smp::cpu::smp_cpu_manager,
+};
+use alloc::{borrow::ToOwned, format, sync::Arc, sync::Weak, vec::Vec};
+use core::sync::atomic::Ordering;
+use system_error::SystemError;
+
+/// /proc/tlb_shootdown 文件的 FileOps 实现
+#[derive(Debug)]
+pub struct TlbShootdownFileOps;
+
+impl TlbShootdownFileOps {
+    pub fn new_inode(parent: Weak<dyn IndexNode>) -> Arc<dyn IndexNode> {
+        ProcFileBuilder::new(Self, InodeMode::S_IRUGO)
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+
+    fn generate_content() -> Vec<u8> {
+        let mut data: Vec<u8> = Vec::new();
+        data.append(
+            &mut "cpu ipi_sent ipi_received ipi_skipped flush_all pages_flushed\n"
+                .as_bytes()
+                .to_owned(),
+        );
+
+        for cpu_id in smp_cpu_manager().present_cpus().iter_cpu() {
+            let Some(stat) = tlb_cpu_stat(cpu_id) else {
+                continue;
+            };
+            data.append(
+                &mut format!(
+                    "cpu{} {} {} {} {} {}\n",
+                    cpu_id.data(),
+                    stat.ipi_sent.load(Ordering::Relaxed),
+                    stat.ipi_received.load(Ordering::Relaxed),
+                    stat.ipi_skipped.load(Ordering::Relaxed),
+                    stat.flush_all.load(Ordering::Relaxed),
+                    stat.pages_flushed.load(Ordering::Relaxed),
+                )
+                .as_bytes()
+                .to_owned(),
+            );
+        }
+
+        trim_string(&mut data);
+        data
+    }
+}
+
+impl FileOps for TlbShootdownFileOps {
+    fn read_at(
+        &self,
+        offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        let content = Self::generate_content();
+        proc_read(offset, len, buf, &content)
+    }
+}
@@ -9,7 +9,11 @@ use crate::{
         },
         vfs::{FilePrivateData, IndexNode, InodeMode},
     },
-    mm::page_cache_stats,
+    mm::{
+        huge_memory,
+        lru::{self, VmEvent},
+        page_cache_stats, swap, tlb,
+    },
 };
 use alloc::{borrow::ToOwned, format, sync::Arc, sync::Weak, vec::Vec};
 use system_error::SystemError;
@@ -24,6 +28,26 @@ enum VmstatSource {
     Shmem,
     Unevictable,
     DropPagecache,
+    AnonThps,
+    ThpFaultAlloc,
+    ThpFaultFallback,
+    ThpCollapseAlloc,
+    ThpCollapseAllocFailed,
+    ThpSplitPmd,
+    Pswpin,
+    Pswpout,
+    SwapRa,
+    SwapRaHit,
+    TlbRemoteFlush,
+    TlbRemoteFlushReceived,
+    TlbLocalFlushAll,
+    TlbLocalFlushOne,
+    FreePages,
+    ActiveFile,
+    InactiveFile,
+    IsolatedFile,
+    InactiveAnon,
+    Event(VmEvent),
 }
 
 #[derive(Clone, Copy, Debug)]
@@ -37,11 +61,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     // enum zone_stat_item counters
     VmstatField {
         name: "nr_free_pages",
-        source: VmstatSource::Zero,
+        source: VmstatSource::FreePages,
     },
     VmstatField {
         name: "nr_zone_inactive_anon",
-        source: VmstatSource::Zero,
+        source: VmstatSource::InactiveAnon,
     },
     VmstatField {
         name: "nr_zone_active_anon",
@@ -49,11 +73,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "nr_zone_inactive_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::InactiveFile,
     },
     VmstatField {
         name: "nr_zone_active_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::ActiveFile,
     },
     VmstatField {
         name: "nr_zone_unevictable",
@@ -74,7 +98,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     // enum node_stat_item counters
     VmstatField {
         name: "nr_inactive_anon",
-        source: VmstatSource::Zero,
+        source: VmstatSource::InactiveAnon,
     },
     VmstatField {
         name: "nr_active_anon",
@@ -82,11 +106,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "nr_inactive_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::InactiveFile,
     },
     VmstatField {
         name: "nr_active_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::ActiveFile,
     },
     VmstatField {
         name: "nr_unevictable",
@@ -106,7 +130,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "nr_isolated_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::IsolatedFile,
     },
     VmstatField {
         name: "workingset_nodes",
@@ -186,7 +210,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "nr_anon_transparent_hugepages",
-        source: VmstatSource::Zero,
+        source: VmstatSource::AnonThps,
     },
     VmstatField {
         name: "nr_vmscan_write",
@@ -252,11 +276,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pswpin",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Pswpin,
     },
     VmstatField {
         name: "pswpout",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Pswpout,
     },
     VmstatField {
         name: "pgalloc_normal",
@@ -268,7 +292,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "allocstall_normal",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::AllocStall),
     },
     VmstatField {
         name: "allocstall_movable",
@@ -288,11 +312,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pgactivate",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgActivate),
     },
     VmstatField {
         name: "pgdeactivate",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgDeactivate),
     },
     VmstatField {
         name: "pglazyfree",
@@ -312,7 +336,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pgrefill",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgRefill),
     },
     VmstatField {
         name: "pgreuse",
@@ -320,11 +344,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pgsteal_kswapd",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgStealKswapd),
     },
     VmstatField {
         name: "pgsteal_direct",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgStealDirect),
     },
     VmstatField {
         name: "pgsteal_khugepaged",
@@ -344,11 +368,11 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pgscan_kswapd",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgScanKswapd),
     },
     VmstatField {
         name: "pgscan_direct",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgScanDirect),
     },
     VmstatField {
         name: "pgscan_khugepaged",
@@ -360,19 +384,19 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pgscan_anon",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgScanAnon),
     },
     VmstatField {
         name: "pgscan_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgScanFile),
     },
     VmstatField {
         name: "pgsteal_anon",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgStealAnon),
     },
     VmstatField {
         name: "pgsteal_file",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PgStealFile),
     },
     VmstatField {
         name: "pginodesteal",
@@ -396,7 +420,7 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
     },
     VmstatField {
         name: "pageoutrun",
-        source: VmstatSource::Zero,
+        source: VmstatSource::Event(VmEvent::PageOutRun),
     },
     VmstatField {
         name: "pgrotated",
@@ -442,6 +466,66 @@ const VMSTAT_FIELDS: &[VmstatField] = &[
         name: "unevictable_pgs_stranded",
         source: VmstatSource::Zero,
     },
+    VmstatField {
+        name: "thp_fault_alloc",
+        source: VmstatSource::ThpFaultAlloc,
+    },
+    VmstatField {
+        name: "thp_fault_fallback",
+        source: VmstatSource::ThpFaultFallback,
+    },
+    VmstatField {
+        name: "thp_collapse_alloc",
+        source: VmstatSource::ThpCollapseAlloc,
+    },
+    VmstatField {
+        name: "thp_collapse_alloc_failed",
+        source: VmstatSource::ThpCollapseAllocFailed,
+    },
+    VmstatField {
+        name: "thp_split_pmd",
+        source: VmstatSource::ThpSplitPmd,
+    },
+    VmstatField {
+        name: "nr_tlb_remote_flush",
+        source: VmstatSource::TlbRemoteFlush,
+    },
+    VmstatField {
+        name: "nr_tlb_remote_flush_received",
+        source: VmstatSource::TlbRemoteFlushReceived,
+    },
+    VmstatField {
+        name: "nr_tlb_local_flush_all",
+        source: VmstatSource::TlbLocalFlushAll,
+    },
+    VmstatField {
+        name: "nr_tlb_local_flush_one",
+        source: VmstatSource::TlbLocalFlushOne,
+    },
+    VmstatField {
+        name: "swap_ra",
+        source: VmstatSource::SwapRa,
+    },
+    VmstatField {
+        name: "swap_ra_hit",
+        source: VmstatSource::SwapRaHit,
+    },
+    VmstatField {
+        name: "file_ra",
+        source: VmstatSource::Event(VmEvent::FileRa),
+    },
+    VmstatField {
+        name: "file_ra_sync",
+        source: VmstatSource::Event(VmEvent::FileRaSync),
+    },
+    VmstatField {
+        name: "file_ra_async",
+        source: VmstatSource::Event(VmEvent::FileRaAsync),
+    },
+    VmstatField {
+        name: "file_ra_stall",
+        source: VmstatSource::Event(VmEvent::FileRaStall),
+    },
 ];
 
 /// /proc/vmstat 文件的 FileOps 实现
@@ -458,6 +542,11 @@ impl VmstatFileOps {
 
     fn generate_vmstat_content() -> Vec<u8> {
         let stats = page_cache_stats::snapshot();
+        let thp = huge_memory::thp_stats();
+        let swap = swap::swap_stats();
+        let tlb = tlb::tlb_flush_stats();
+        let lru_stats = lru::lru_stats();
+        let free_pages = lru::nr_free_pages() as u64;
         let mut data: Vec<u8> = Vec::new();
 
         for field in VMSTAT_FIELDS {
@@ -470,6 +559,26 @@ impl VmstatFileOps {
                 VmstatSource::Shmem => stats.shmem_pages,
                 VmstatSource::Unevictable => stats.unevictable,
                 VmstatSource::DropPagecache => stats.drop_pagecache,
+                VmstatSource::AnonThps => thp.nr_anon_thps,
+                VmstatSource::ThpFaultAlloc => thp.fault_alloc,
+                VmstatSource::ThpFaultFallback => thp.fault_fallback,
+                VmstatSource::ThpCollapseAlloc => thp.collapse_alloc,
+                VmstatSource::ThpCollapseAllocFailed => thp.collapse_alloc_failed,
+                VmstatSource::ThpSplitPmd => thp.split_pmd,
+                VmstatSource::Pswpin => swap.pswpin,
+                VmstatSource::Pswpout => swap.pswpout,
+                VmstatSource::SwapRa => swap.swap_ra,
+                VmstatSource::SwapRaHit => swap.swap_ra_hit,
+                VmstatSource::TlbRemoteFlush => tlb.ipi_sent,
+                VmstatSource::TlbRemoteFlushReceived => tlb.ipi_received,
+                VmstatSource::TlbLocalFlushAll => tlb.flush_all,
+                VmstatSource::TlbLocalFlushOne => tlb.pages_flushed,
+                VmstatSource::FreePages => free_pages,
+                VmstatSource::ActiveFile => lru_stats.nr_active_file as u64,
+                VmstatSource::InactiveFile => lru_stats.nr_inactive_file as u64,
+                VmstatSource::IsolatedFile => lru_stats.nr_isolated_file as u64,
+                VmstatSource::InactiveAnon => lru_stats.nr_inactive_anon as u64,
+                VmstatSource::Event(event) => lru::vm_event(event),
             };
             data.append(&mut format!("{} {}\n", field.name, value).as_bytes().to_owned());
         }
@@ -0,0 +1,412 @@
+//! timerfd：通过文件描述符读取定时器的到期次数
+//!
+//! 每个timerfd持有一个软中断模式的hrtimer，到期时累加到期次数并唤醒读者和epoll。
+//! 周期定时器在回调中直接推后重新入队，错过的周期计入到期次数。
+
+use super::vfs::PollableInode;
+use crate::arch::MMArch;
+use crate::filesystem::epoll::event_poll::LockedEPItemLinkedList;
+use crate::filesystem::vfs::file::FileFlags;
+use crate::filesystem::vfs::InodeMode;
+use crate::filesystem::{
+    epoll::{event_poll::EventPoll, EPollEventType, EPollItem},
+    vfs::{FilePrivateData, FileSystem, FileType, FsInfo, IndexNode, Magic, Metadata, SuperBlock},
+};
+use crate::libs::mutex::MutexGuard;
+use crate::libs::spinlock::SpinLock;
+use crate::libs::wait_queue::WaitQueue;
+use crate::mm::MemoryManagementArch;
+use crate::process::posix_timer::PosixItimerspec;
+use crate::process::ProcessManager;
+use crate::time::{
+    hrtimer::{
+        hrtimer_clock_to_ktime, hrtimer_forward, HrTimer, HrTimerFunction, HrTimerMode,
+        HrTimerRestart,
+    },
+    sleep::timespec_to_ktime,
+    syscall::PosixClockID,
+    timekeep::ktime_t,
+    timekeeping::ktime_get,
+    PosixTimeSpec,
+};
+use alloc::boxed::Box;
+use alloc::string::String;
+use alloc::sync::{Arc, Weak};
+use alloc::vec::Vec;
+use core::any::Any;
+use system_error::SystemError;
+
+lazy_static::lazy_static! {
+    static ref TIMERFD_FS: Arc<TimerFdFs> = Arc::new(TimerFdFs);
+}
+
+/// TimerFd 文件系统
+///
+/// 与 EventFdFs 一样是不挂载的伪文件系统，Linux 中 timerfd 属于 anon_inode
+#[derive(Debug)]
+pub struct TimerFdFs;
+
+impl TimerFdFs {
+    /// 获取全局 TimerFdFs 实例
+    pub fn instance() -> Arc<TimerFdFs> {
+        TIMERFD_FS.clone()
+    }
+}
+
+impl FileSystem for TimerFdFs {
+    fn root_inode(&self) -> Arc<dyn IndexNode> {
+        // timerfd 不是挂载的文件系统，这里返回一个未启动的 timerfd 作为占位符
+        TimerFdInode::new(PosixClockID::Monotonic, TimerFdFlags::empty())
+    }
+
+    fn info(&self) -> FsInfo {
+        FsInfo {
+            blk_dev_id: 0,
+            max_name_len: 255,
+        }
+    }
+
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn name(&self) -> &str {
+        "timerfd"
+    }
+
+    fn super_block(&self) -> SuperBlock {
+        SuperBlock::new(Magic::ANON_INODE_FS_MAGIC, MMArch::PAGE_SIZE as u64, 255)
+    }
+}
+
+bitflags! {
+    pub struct TimerFdFlags: u32 {
+        /// Set the close-on-exec (FD_CLOEXEC) flag on the new file descriptor
+        const TFD_CLOEXEC = 0o2000000;
+        /// Set the O_NONBLOCK file status flag on the new open file description
+        const TFD_NONBLOCK = 0o0004000;
+    }
+
+    pub struct TimerFdSetFlags: u32 {
+        /// it_value 是定时器所用时钟的绝对时刻
+        const TFD_TIMER_ABSTIME = 1 << 0;
+        /// 墙上时间被修改时取消定时器。系统还没有 clock_was_set 通知，暂时只接受该标志
+        const TFD_TIMER_CANCEL_ON_SET = 1 << 1;
+    }
+}
+
+#[derive(Debug)]
+struct TimerFdState {
+    clockid: PosixClockID,
+    flags: TimerFdFlags,
+    /// 上次 read 以来的到期次数
+    ticks: u64,
+    interval: PosixTimeSpec,
+    /// 下一次到期的时刻（单调时钟），未启动时为 None
+    expires: Option<ktime_t>,
+    timer: Option<Arc<HrTimer>>,
+    /// 每次 settime 递增，回调据此识别已经被替换掉的旧定时器
+    arm_seq: u64,
+}
+
+#[derive(Debug)]
+pub struct TimerFdInode {
+    /// 定时器回调在软中断中访问，使用关中断的自旋锁
+    state: SpinLock<TimerFdState>,
+    wait_queue: WaitQueue,
+    epitems: LockedEPItemLinkedList,
+    self_ref: Weak<TimerFdInode>,
+}
+
+impl TimerFdInode {
+    pub fn new(clockid: PosixClockID, flags: TimerFdFlags) -> Arc<Self> {
+        Arc::new_cyclic(|self_ref| TimerFdInode {
+            state: SpinLock::new(TimerFdState {
+                clockid,
+                flags,
+                ticks: 0,
+                interval: PosixTimeSpec::default(),
+                expires: None,
+                timer: None,
+                arm_seq: 0,
+            }),
+            wait_queue: WaitQueue::default(),
+            epitems: LockedEPItemLinkedList::default(),
+            self_ref: self_ref.clone(),
+        })
+    }
+
+    fn readable(&self) -> bool {
+        self.state.lock_irqsave().ticks > 0
+    }
+
+    fn do_poll(state: &TimerFdState) -> usize {
+        let mut events = EPollEventType::empty();
+        if state.ticks != 0 {
+            events |= EPollEventType::EPOLLIN | EPollEventType::EPOLLRDNORM;
+        }
+        events.bits() as usize
+    }
+
+    fn current_value(state: &TimerFdState) -> PosixItimerspec {
+        let mut out = PosixItimerspec {
+            it_interval: state.interval,
+            ..Default::default()
+        };
+        if let Some(expires) = state.expires {
+            // 已到期但还没有重新入队的周期定时器仍视为在运行，报告最小的剩余时间
+            let remaining = expires.saturating_sub(ktime_get()).max(1);
+            out.it_value = PosixTimeSpec::from_ns(remaining as u64);
+        }
+        out
+    }
+
+    /// 获取定时器的剩余时间和周期
+    pub fn gettime(&self) -> PosixItimerspec {
+        Self::current_value(&self.state.lock_irqsave())
+    }
+
+    /// 启动或者停止定时器，返回之前的设置
+    pub fn settime(
+        &self,
+        new_value: &PosixItimerspec,
+        flags: TimerFdSetFlags,
+    ) -> Result<PosixItimerspec, SystemError> {
+        validate_timespec(&new_value.it_interval)?;
+        validate_timespec(&new_value.it_value)?;
+
+        let mut state = self.state.lock_irqsave();
+        let old = Self::current_value(&state);
+
+        if let Some(old_timer) = state.timer.take() {
+            old_timer.cancel();
+        }
+        state.expires = None;
+        state.ticks = 0;
+        state.arm_seq = state.arm_seq.wrapping_add(1);
+        state.interval = new_value.it_interval;
+
+        // it_value 为 0 => disarm
+        if new_value.it_value.is_empty() {
+            return Ok(old);
+        }
+
+        // 绝对时刻已经过去时定时器立即到期
+        let value = timespec_to_ktime(&new_value.it_value);
+        let expires = if flags.contains(TimerFdSetFlags::TFD_TIMER_ABSTIME) {
+            hrtimer_clock_to_ktime(state.clockid, value).ok_or(SystemError::EINVAL)?
+        } else {
+            ktime_get().saturating_add(value)
+        };
+
+        let helper = Box::new(TimerFdHelper {
+            inode: self.self_ref.clone(),
+            arm_seq: state.arm_seq,
+        });
+        let timer = HrTimer::new(helper, HrTimerMode::Soft);
+        state.expires = Some(expires);
+        state.timer = Some(timer.clone());
+        timer.start(expires);
+        Ok(old)
+    }
+
+    /// 定时器到期：累加到期次数，返回周期定时器下一次的到期时刻
+    fn expire(&self, arm_seq: u64, expires: ktime_t, now: ktime_t) -> HrTimerRestart {
+        let mut state = self.state.lock_irqsave();
+        if state.arm_seq != arm_seq || state.expires.is_none() {
+            return HrTimerRestart::NoRestart;
+        }
+
+        let interval = timespec_to_ktime(&state.interval);
+        let restart = if interval > 0 {
+            let mut next = expires;
+            let overruns = hrtimer_forward(&mut next, now, interval);
+            state.ticks = state.ticks.saturating_add(overruns.max(1));
+            state.expires = Some(next);
+            HrTimerRestart::Restart(next)
+        } else {
+            state.ticks = state.ticks.saturating_add(1);
+            state.expires = None;
+            state.timer = None;
+            HrTimerRestart::NoRestart
+        };
+        drop(state);
+
+        self.wait_queue.wakeup_all(None);
+        let _ = EventPoll::wakeup_epoll(
+            &self.epitems,
+            EPollEventType::EPOLLIN | EPollEventType::EPOLLRDNORM,
+        );
+        restart
+    }
+}
+
+impl Drop for TimerFdInode {
+    fn drop(&mut self) {
+        if let Some(timer) = self.state.lock_irqsave().timer.take() {
+            timer.cancel();
+        }
+    }
+}
+
+#[derive(Debug)]
+struct TimerFdHelper {
+    inode: Weak<TimerFdInode>,
+    arm_seq: u64,
+}
+
+impl HrTimerFunction for TimerFdHelper {
+    fn run(&mut self, expires: ktime_t, now: ktime_t) -> HrTimerRestart {
+        match self.inode.upgrade() {
+            Some(inode) => inode.expire(self.arm_seq, expires, now),
+            None => HrTimerRestart::NoRestart,
+        }
+    }
+}
+
+impl PollableInode for TimerFdInode {
+    fn poll(&self, _private_data: &FilePrivateData) -> Result<usize, SystemError> {
+        Ok(Self::do_poll(&self.state.lock_irqsave()))
+    }
+
+    fn add_epitem(
+        &self,
+        epitem: Arc<EPollItem>,
+        _private_data: &FilePrivateData,
+    ) -> Result<(), SystemError> {
+        self.epitems.lock_irqsave().push_back(epitem);
+        Ok(())
+    }
+
+    fn remove_epitem(
+        &self,
+        epitem: &Arc<EPollItem>,
+        _private_data: &FilePrivateData,
+    ) -> Result<(), SystemError> {
+        let mut guard = self.epitems.lock_irqsave();
+        let len = guard.len();
+        guard.retain(|x| !Arc::ptr_eq(x, epitem));
+        if len != guard.len() {
+            return Ok(());
+        }
+        Err(SystemError::ENOENT)
+    }
+}
+
+impl IndexNode for TimerFdInode {
+    fn is_stream(&self) -> bool {
+        true
+    }
+
+    fn open(
+        &self,
+        _data: MutexGuard<FilePrivateData>,
+        _flags: &FileFlags,
+    ) -> Result<(), SystemError> {
+        Ok(())
+    }
+
+    fn close(&self, _data: MutexGuard<FilePrivateData>) -> Result<(), SystemError> {
+        Ok(())
+    }
+
+    /// # 读取上次读取以来的到期次数（8 字节）并清零
+    ///
+    /// 还没有到期时，TFD_NONBLOCK 以 EAGAIN 失败，否则阻塞到下一次到期
+    fn read_at(
+        &self,
+        _offset: usize,
+        len: usize,
+        buf: &mut [u8],
+        data_guard: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        drop(data_guard);
+        if len < 8 {
+            return Err(SystemError::EINVAL);
+        }
+
+        loop {
+            {
+                let mut state = self.state.lock_irqsave();
+                if state.ticks > 0 {
+                    let ticks = core::mem::take(&mut state.ticks);
+                    drop(state);
+                    buf[..8].copy_from_slice(&ticks.to_ne_bytes());
+                    return Ok(8);
+                }
+                if state.flags.contains(TimerFdFlags::TFD_NONBLOCK) {
+                    return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+                }
+            }
+            self.wait_queue
+                .wait_event_interruptible(|| self.readable(), None::<fn()>)?;
+        }
+    }
+
+    fn write_at(
+        &self,
+        _offset: usize,
+        _len: usize,
+        _buf: &[u8],
+        _data: MutexGuard<FilePrivateData>,
+    ) -> Result<usize, SystemError> {
+        Err(SystemError::EINVAL)
+    }
+
+    fn metadata(&self) -> Result<Metadata, SystemError> {
+        let meta = Metadata {
+            mode: InodeMode::from_bits_truncate(0o600),
+            file_type: FileType::File,
+            ..Default::default()
+        };
+        Ok(meta)
+    }
+
+    fn resize(&self, _len: usize) -> Result<(), SystemError> {
+        Ok(())
+    }
+
+    fn fs(&self) -> Arc<dyn FileSystem> {
+        TimerFdFs::instance()
+    }
+
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn list(&self) -> Result<Vec<String>, SystemError> {
+        Err(SystemError::EINVAL)
+    }
+
+    fn as_pollable_inode(&self) -> Result<&dyn PollableInode, SystemError> {
+        Ok(self)
+    }
+
+    fn absolute_path(&self) -> Result<String, SystemError> {
+        Ok(String::from("anon_inode:[timerfd]"))
+    }
+}
+
+fn validate_timespec(ts: &PosixTimeSpec) -> Result<(), SystemError> {
+    if ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= 1_000_000_000 {
+        return Err(SystemError::EINVAL);
+    }
+    Ok(())
+}
+
+/// 在`fd`对应的 timerfd 上执行`f`：`fd`无效时返回 EBADF，不是 timerfd 时返回 EINVAL
+pub fn with_timerfd<R>(
+    fd: i32,
+    f: impl FnOnce(&TimerFdInode) -> Result<R, SystemError>,
+) -> Result<R, SystemError> {
+    let file = ProcessManager::current_pcb()
+        .fd_table()
+        .read()
+        .get_file_by_fd(fd)
+        .ok_or(SystemError::EBADF)?;
+    let inode = file.inode();
+    let timerfd = inode
+        .downcast_ref::<TimerFdInode>()
+        .ok_or(SystemError::EINVAL)?;
+    f(timerfd)
+}
@@ -35,8 +35,10 @@ use crate::{
     ipc::{kill::send_signal_to_pid, pipe::PipeFsPrivateData},
     libs::{casting::DowncastArc, errseq::ErrSeqValue, mutex::Mutex, rwsem::RwSem},
     mm::{
-        page::PageFlags,
-        readahead::{page_cache_async_readahead, page_cache_sync_readahead, FileReadaheadState},
+        readahead::{
+            page_cache_async_readahead, page_cache_sync_readahead, FileReadaheadState,
+            VM_READAHEAD_PAGES,
+        },
         MemoryManagementArch,
     },
     process::{
@@ -806,6 +808,13 @@ impl File {
             .map(|mnt_inode| mnt_inode.mount_fs().sample_wb_error())
             .unwrap_or(0);
 
+        // 常规文件的预读窗口上限取自所在的块设备
+        let ra_pages = if file_type == FileType::File {
+            inode.fs().ra_pages()
+        } else {
+            VM_READAHEAD_PAGES
+        };
+
         let f = File {
             open_file_id: alloc_open_file_id(),
             inode,
@@ -818,7 +827,7 @@ impl File {
             cred: ProcessManager::current_pcb().cred(),
             owner: Mutex::new(FileOwner::new()),
             posix_lock_key,
-            ra_state: Mutex::new(FileReadaheadState::new()),
+            ra_state: Mutex::new(FileReadaheadState::new(ra_pages)),
             wb_error_seq: Mutex::new(wb_error_seq),
             sb_error_seq: Mutex::new(sb_error_seq),
         };
@@ -1004,39 +1013,36 @@ impl File {
         let start_page = offset >> MMArch::PAGE_SHIFT;
         let end_page = (offset + len - 1) >> MMArch::PAGE_SHIFT;
 
-        let (async_trigger_page, missing_page) = {
-            let mut async_trigger_page = None;
-            let mut missing_page = None;
-
-            for index in start_page..=end_page {
-                match page_cache.manager().peek_page(index) {
-                    Some(page) if page.read().flags().contains(PageFlags::PG_READAHEAD) => {
-                        async_trigger_page = Some((index, page.clone()));
-                        break;
-                    }
-                    None => {
-                        missing_page = Some(index);
-                        break;
-                    }
-                    _ => {}
-                }
-            }
-            (async_trigger_page, missing_page)
-        };
+        // 找到请求范围内第一个缺失的页面或者带预读标记的页面。
+        // 正在读取中的页面也算命中：它已经是某个预读窗口的一部分。
+        for index in start_page..=end_page {
+            let hit_marker = match page_cache.test_clear_readahead(index) {
+                None => false,
+                Some(true) => true,
+                Some(false) => continue,
+            };
 
-        if let Some((index, page)) = async_trigger_page {
             let mut ra_state = self.ra_state.lock().clone();
             let req_pages = end_page - index + 1;
-            page.write().remove_flags(PageFlags::PG_READAHEAD);
-
-            page_cache_async_readahead(&page_cache, &self.inode, &mut ra_state, index, req_pages)?;
-            *self.ra_state.lock() = ra_state;
-        } else if let Some(index) = missing_page {
-            let mut ra_state = self.ra_state.lock().clone();
-            let req_pages = end_page - index + 1;
-
-            page_cache_sync_readahead(&page_cache, &self.inode, &mut ra_state, index, req_pages)?;
+            if hit_marker {
+                page_cache_async_readahead(
+                    &page_cache,
+                    &self.inode,
+                    &mut ra_state,
+                    index,
+                    req_pages,
+                )?;
+            } else {
+                page_cache_sync_readahead(
+                    &page_cache,
+                    &self.inode,
+                    &mut ra_state,
+                    index,
+                    req_pages,
+                )?;
+            }
             *self.ra_state.lock() = ra_state;
+            break;
         }
         Ok(())
     }
@@ -1362,6 +1362,7 @@ bitflags! {
         const MOUNT_MAGIC = 61267;
         const PIPEFS_MAGIC = 0x50495045;
         const EVENTFD_MAGIC = 0x45564446; // "EVDF" in ASCII
+        const ANON_INODE_FS_MAGIC = 0x09041934;
         const OVERLAYFS_MAGIC = 0x794c7630;
     }
 }
@@ -1422,6 +1423,13 @@ pub trait FileSystem: Any + Sync + Send + Debug {
         true // 默认支持 readahead
     }
 
+    /// @brief 该文件系统上文件的最大预读窗口（页数）
+    ///
+    /// 块设备文件系统应返回所在块设备的设置（`/sys/block/<disk>/queue/read_ahead_kb`）
+    fn ra_pages(&self) -> usize {
+        crate::mm::readahead::VM_READAHEAD_PAGES
+    }
+
     /// @brief 本函数用于实现动态转换。
     /// 具体的文件系统在实现本函数时，最简单的方式就是：直接返回self
     fn as_any_ref(&self) -> &dyn Any;
@@ -1688,6 +1688,9 @@ impl FileSystem for MountFS {
     fn support_readahead(&self) -> bool {
         self.inner_filesystem.support_readahead()
     }
+    fn ra_pages(&self) -> usize {
+        self.inner_filesystem.ra_pages()
+    }
     fn root_inode(&self) -> Arc<dyn IndexNode> {
         // A mounted filesystem's root inode is always its own mount root wrapper.
         // Returning the parent mount's root breaks mount-root checks such as pivot_root(2).
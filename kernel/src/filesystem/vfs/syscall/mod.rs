@@ -56,6 +56,9 @@ mod sys_select;
 mod sys_statfs;
 mod sys_statx;
 mod sys_symlinkat;
+mod sys_timerfd_create;
+mod sys_timerfd_gettime;
+mod sys_timerfd_settime;
 mod sys_truncate;
 mod sys_unlinkat;
 mod sys_utimensat;
@@ -0,0 +1,75 @@
+use crate::arch::interrupt::TrapFrame;
+use crate::arch::syscall::nr::SYS_TIMERFD_CREATE;
+use crate::filesystem::timerfd::{TimerFdFlags, TimerFdInode};
+use crate::filesystem::vfs::file::{File, FileFlags};
+use crate::process::ProcessManager;
+use crate::syscall::table::FormattedSyscallParam;
+use crate::syscall::table::Syscall;
+use crate::time::syscall::PosixClockID;
+use alloc::vec::Vec;
+use system_error::SystemError;
+
+/// System call handler for the `timerfd_create` syscall
+pub struct SysTimerFdCreateHandle;
+
+impl SysTimerFdCreateHandle {
+    fn clockid(args: &[usize]) -> i32 {
+        args[0] as i32
+    }
+
+    fn flags(args: &[usize]) -> u32 {
+        args[1] as u32
+    }
+}
+
+impl Syscall for SysTimerFdCreateHandle {
+    fn num_args(&self) -> usize {
+        2
+    }
+
+    /// Creates a timerfd on CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME.
+    ///
+    /// # Arguments
+    /// * `args` - Array containing:
+    ///   - args[0]: Clock id
+    ///   - args[1]: Flags (u32): TFD_CLOEXEC, TFD_NONBLOCK
+    ///
+    /// # Returns
+    /// * `Ok(usize)` - File descriptor on success
+    /// * `Err(SystemError)` - Error code if operation fails
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let clockid = PosixClockID::try_from(Self::clockid(args))?;
+        if !matches!(
+            clockid,
+            PosixClockID::Realtime | PosixClockID::Monotonic | PosixClockID::Boottime
+        ) {
+            return Err(SystemError::EINVAL);
+        }
+        let flags = TimerFdFlags::from_bits(Self::flags(args)).ok_or(SystemError::EINVAL)?;
+
+        let inode = TimerFdInode::new(clockid, flags);
+        let cloexec = flags.contains(TimerFdFlags::TFD_CLOEXEC);
+        let mut filemode = FileFlags::O_RDWR;
+        if cloexec {
+            filemode |= FileFlags::O_CLOEXEC;
+        }
+        if flags.contains(TimerFdFlags::TFD_NONBLOCK) {
+            filemode |= FileFlags::O_NONBLOCK;
+        }
+        let file = File::new(inode, filemode)?;
+        let binding = ProcessManager::current_pcb().fd_table();
+        let mut fd_table_guard = binding.write();
+        fd_table_guard
+            .alloc_fd(file, None, cloexec)
+            .map(|x| x as usize)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("clockid", format!("{}", Self::clockid(args))),
+            FormattedSyscallParam::new("flags", format!("{:#x}", Self::flags(args))),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_TIMERFD_CREATE, SysTimerFdCreateHandle);
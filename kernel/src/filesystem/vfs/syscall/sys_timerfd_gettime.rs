@@ -0,0 +1,51 @@
+use crate::arch::interrupt::TrapFrame;
+use crate::arch::syscall::nr::SYS_TIMERFD_GETTIME;
+use crate::filesystem::timerfd::with_timerfd;
+use crate::process::posix_timer::PosixItimerspec;
+use crate::syscall::table::FormattedSyscallParam;
+use crate::syscall::table::Syscall;
+use crate::syscall::user_access::UserBufferWriter;
+use alloc::vec::Vec;
+use core::mem::size_of;
+use system_error::SystemError;
+
+/// System call handler for the `timerfd_gettime` syscall
+pub struct SysTimerFdGettimeHandle;
+
+impl SysTimerFdGettimeHandle {
+    fn fd(args: &[usize]) -> i32 {
+        args[0] as i32
+    }
+
+    fn curr_value(args: &[usize]) -> *mut PosixItimerspec {
+        args[1] as *mut PosixItimerspec
+    }
+}
+
+impl Syscall for SysTimerFdGettimeHandle {
+    fn num_args(&self) -> usize {
+        2
+    }
+
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let curr_value_ptr = Self::curr_value(args);
+        if curr_value_ptr.is_null() {
+            return Err(SystemError::EFAULT);
+        }
+        let val = with_timerfd(Self::fd(args), |timerfd| Ok(timerfd.gettime()))?;
+        let mut writer = UserBufferWriter::new(curr_value_ptr, size_of::<PosixItimerspec>(), true)?;
+        writer
+            .buffer_protected(0)?
+            .write_one::<PosixItimerspec>(0, &val)?;
+        Ok(0)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("fd", format!("{}", Self::fd(args))),
+            FormattedSyscallParam::new("curr_value", format!("{:#x}", args[1])),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_TIMERFD_GETTIME, SysTimerFdGettimeHandle);
@@ -0,0 +1,70 @@
+use crate::arch::interrupt::TrapFrame;
+use crate::arch::syscall::nr::SYS_TIMERFD_SETTIME;
+use crate::filesystem::timerfd::{with_timerfd, TimerFdSetFlags};
+use crate::process::posix_timer::PosixItimerspec;
+use crate::syscall::table::FormattedSyscallParam;
+use crate::syscall::table::Syscall;
+use crate::syscall::user_access::{UserBufferReader, UserBufferWriter};
+use alloc::vec::Vec;
+use core::mem::size_of;
+use system_error::SystemError;
+
+/// System call handler for the `timerfd_settime` syscall
+pub struct SysTimerFdSettimeHandle;
+
+impl SysTimerFdSettimeHandle {
+    fn fd(args: &[usize]) -> i32 {
+        args[0] as i32
+    }
+
+    fn flags(args: &[usize]) -> u32 {
+        args[1] as u32
+    }
+
+    fn new_value(args: &[usize]) -> *const PosixItimerspec {
+        args[2] as *const PosixItimerspec
+    }
+
+    fn old_value(args: &[usize]) -> *mut PosixItimerspec {
+        args[3] as *mut PosixItimerspec
+    }
+}
+
+impl Syscall for SysTimerFdSettimeHandle {
+    fn num_args(&self) -> usize {
+        4
+    }
+
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let flags = TimerFdSetFlags::from_bits(Self::flags(args)).ok_or(SystemError::EINVAL)?;
+        let new_value_ptr = Self::new_value(args);
+        if new_value_ptr.is_null() {
+            return Err(SystemError::EFAULT);
+        }
+        let reader = UserBufferReader::new(new_value_ptr, size_of::<PosixItimerspec>(), true)?;
+        let new_value = reader.buffer_protected(0)?.read_one::<PosixItimerspec>(0)?;
+
+        let old = with_timerfd(Self::fd(args), |timerfd| timerfd.settime(&new_value, flags))?;
+
+        let old_value_ptr = Self::old_value(args);
+        if !old_value_ptr.is_null() {
+            let mut writer =
+                UserBufferWriter::new(old_value_ptr, size_of::<PosixItimerspec>(), true)?;
+            writer
+                .buffer_protected(0)?
+                .write_one::<PosixItimerspec>(0, &old)?;
+        }
+        Ok(0)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("fd", format!("{}", Self::fd(args))),
+            FormattedSyscallParam::new("flags", format!("{:#x}", Self::flags(args))),
+            FormattedSyscallParam::new("new_value", format!("{:#x}", args[2])),
+            FormattedSyscallParam::new("old_value", format!("{:#x}", args[3])),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_TIMERFD_SETTIME, SysTimerFdSettimeHandle);
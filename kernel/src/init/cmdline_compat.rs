@@ -17,15 +17,13 @@ kernel_cmdline_param_arg!(NOREPLACE_SMP_PARAM, "noreplace-smp", false, false);
 // DragonOS does not have panic timeout reboot handling yet.
 kernel_cmdline_param_kv!(PANIC_TIMEOUT_PARAM, panic, "");
 
-// Audit, md raid autodetect, early printk target selection, mitigation policy,
-// and high-resolution timer mode are not implemented as Linux-compatible
-// runtime controls yet. Register them so Linux-known boot parameters do not
+// Audit, md raid autodetect, early printk target selection and mitigation
+// policy are not implemented as Linux-compatible runtime controls yet. Register them so Linux-known boot parameters do not
 // leak into init env.
 kernel_cmdline_param_kv!(AUDIT_PARAM, audit, "");
 kernel_cmdline_param_kv!(RAID_PARAM, raid, "");
 kernel_cmdline_param_kv!(EARLY_PRINTK_PARAM, earlyprintk, "");
 kernel_cmdline_param_kv!(MITIGATIONS_PARAM, mitigations, "");
-kernel_cmdline_param_kv!(HIGHRES_PARAM, highres, "");
 
 // TSC policy options are Linux/x86-specific. DragonOS currently consumes them
 // for compatibility without changing TSC watchdog/reliability state.
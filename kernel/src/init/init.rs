@@ -26,7 +26,8 @@ use crate::{
     smp::{early_smp_init, SMPArch},
     syscall::{syscall_init, Syscall},
     time::{
-        clocksource::clocksource_boot_finish, timekeeping::timekeeping_init, timer::timer_init,
+        clocksource::clocksource_boot_finish, hrtimer::hrtimer_init, timekeeping::timekeeping_init,
+        timer::timer_init,
     },
 };
 use log::warn;
@@ -101,6 +102,7 @@ fn do_start_kernel() {
     timekeeping_init();
     time_init();
     timer_init();
+    hrtimer_init();
     kthread_init();
     setup_arch_post().expect("setup_arch_post failed");
     clocksource_boot_finish();
@@ -107,10 +107,16 @@ fn kernel_init() -> Result<(), SystemError> {
 
 #[inline(never)]
 fn kenrel_init_freeable() -> Result<(), SystemError> {
+    // 启动cpu的ksoftirqd，此后raise的线程化软中断才有线程处理
+    crate::exception::softirq::ksoftirqd_init();
     do_initcalls().unwrap_or_else(|err| {
         panic!("Failed to initialize subsystems: {:?}", err);
     });
     smp_init();
+    crate::exception::softirq::ksoftirqd_init();
+    crate::sched::sched_init_smp();
+    crate::time::clockevents::tick_oneshot_init();
+    crate::time::tick_sched::tick_nohz_init();
     crate::exception::workqueue::workqueue_init();
     return Ok(());
 }
@@ -3,7 +3,7 @@ use crate::{
     libs::align::page_align_up,
     mm::{
         allocator::page_frame::{FrameAllocator, PageFrameCount, PhysPageFrame},
-        page::{page_manager_lock, PageFlags, PageType},
+        page::{page_manager, PageFlags, PageType},
         PhysAddr,
     },
     process::{cred::Cred, ProcessManager, RawPid},
@@ -169,7 +169,7 @@ impl ShmManager {
         let page_count =
             PageFrameCount::from_bytes(page_align_up(size)).ok_or(SystemError::EINVAL)?;
         // 创建共享内存page，并添加到PAGE_MANAGER中
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         let (paddr, _page) = page_manager_guard.create_pages(
             PageType::Shm,
             PageFlags::PG_UNEVICTABLE,
@@ -331,7 +331,7 @@ impl ShmManager {
         let id = kernel_shm.kern_ipc_perm.id;
         let map_count = kernel_shm.map_count();
 
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         if map_count > 0 {
             // 设置共享内存物理页当映射计数等于0时可被回收
             // TODO 后续需要加入到lru中
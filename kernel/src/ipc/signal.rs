@@ -19,10 +19,7 @@ use crate::{
     process::{
         pid::PidType, ProcessControlBlock, ProcessFlags, ProcessManager, ProcessSignalInfo, RawPid,
     },
-    time::{
-        sleep::nanosleep, syscall::PosixClockID, timekeeping::getnstimeofday, Instant,
-        PosixTimeSpec,
-    },
+    time::{sleep::clock_nanosleep_until, syscall::PosixClockID, Instant},
 };
 
 /// Send a kernel-originated signal to the current task.
@@ -1072,41 +1069,6 @@ pub struct PollRestartBlockData {
     pub timeout_instant: Option<Instant>,
 }
 
-fn ktime_now(clockid: PosixClockID) -> PosixTimeSpec {
-    match clockid {
-        PosixClockID::Realtime => getnstimeofday(),
-        PosixClockID::Monotonic | PosixClockID::Boottime => getnstimeofday(),
-        PosixClockID::ProcessCPUTimeID => {
-            let pcb = ProcessManager::current_pcb();
-            PosixTimeSpec::from_ns(pcb.process_cputime_ns())
-        }
-        PosixClockID::ThreadCPUTimeID => {
-            let pcb = ProcessManager::current_pcb();
-            PosixTimeSpec::from_ns(pcb.thread_cputime_ns())
-        }
-        _ => getnstimeofday(),
-    }
-}
-
-fn calc_remaining(deadline: &PosixTimeSpec, now: &PosixTimeSpec) -> PosixTimeSpec {
-    let mut sec = deadline.tv_sec - now.tv_sec;
-    let mut nsec = deadline.tv_nsec - now.tv_nsec;
-    if nsec < 0 {
-        sec -= 1;
-        nsec += 1_000_000_000;
-    }
-    if sec < 0 {
-        return PosixTimeSpec {
-            tv_sec: 0,
-            tv_nsec: 0,
-        };
-    }
-    PosixTimeSpec {
-        tv_sec: sec,
-        tv_nsec: nsec,
-    }
-}
-
 /// Nanosleep 的重启函数：根据保存的 deadline/clockid 继续等待或重启
 #[derive(Debug)]
 pub struct RestartFnNanosleep;
@@ -1151,15 +1113,7 @@ impl RestartFn for RestartFnNanosleep {
                         )
                     }
                 }
-                _ => {
-                    let now = ktime_now(*clockid);
-                    let remain = calc_remaining(deadline, &now);
-                    if remain.tv_sec == 0 && remain.tv_nsec == 0 {
-                        Ok(())
-                    } else {
-                        nanosleep(remain).map(|_| ())
-                    }
-                }
+                _ => clock_nanosleep_until(*clockid, deadline),
             };
 
             match wait_res {
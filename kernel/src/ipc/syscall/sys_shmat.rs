@@ -9,7 +9,7 @@ use crate::{
     mm::{
         allocator::page_frame::{PageFrameCount, PhysPageFrame, VirtPageFrame},
         mmu_gather::MmuGather,
-        page::{page_manager_lock, DeferredFlusher, EntryFlags},
+        page::{page_manager, DeferredFlusher, EntryFlags},
         syscall::ProtFlags,
         ucontext::{AddressSpace, PhysmapParams, VMA},
         VirtAddr, VmFlags,
@@ -109,7 +109,7 @@ pub(super) fn do_kernel_shmat(
             }
 
             // 将该虚拟内存区域映射到共享内存区域
-            let mut page_manager_guard = page_manager_lock();
+            let page_manager_guard = page_manager();
             let mut virt = VirtPageFrame::new(vaddr);
             for _ in 0..count.data() {
                 let r = unsafe {
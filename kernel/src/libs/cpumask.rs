@@ -208,4 +208,39 @@ impl AtomicCpuMask {
     pub fn first_and(&self, rhs: &CpuMask) -> Option<ProcessorId> {
         rhs.iter_cpu().find(|&cpu| self.get(cpu))
     }
+
+    /// 对掩码做一次快照，从`start`开始（到末尾后回绕）依次返回同时在`rhs`中置位的cpu
+    ///
+    /// 只遍历快照中置位的位，全零的字直接跳过
+    pub fn iter_and_wrap<'a>(
+        &self,
+        rhs: &'a CpuMask,
+        start: ProcessorId,
+    ) -> impl Iterator<Item = ProcessorId> + 'a {
+        let words: [u64; ATOMIC_CPUMASK_WORDS] =
+            core::array::from_fn(|i| self.words[i].load(Ordering::Relaxed));
+        let start = (start.data() as usize) % (ATOMIC_CPUMASK_WORDS * BITS_PER_WORD);
+        let (start_word, start_bit) = (start / BITS_PER_WORD, start % BITS_PER_WORD);
+
+        // 起始字的高位部分、其余的字、最后回到起始字的低位部分
+        let high = words[start_word] & (u64::MAX << start_bit);
+        let low = words[start_word] & !(u64::MAX << start_bit);
+        core::iter::once((start_word, high))
+            .chain((1..ATOMIC_CPUMASK_WORDS).map(move |i| {
+                let w = (start_word + i) % ATOMIC_CPUMASK_WORDS;
+                (w, words[w])
+            }))
+            .chain(core::iter::once((start_word, low)))
+            .flat_map(|(w, mut bits)| {
+                core::iter::from_fn(move || {
+                    if bits == 0 {
+                        return None;
+                    }
+                    let bit = bits.trailing_zeros() as usize;
+                    bits &= bits - 1;
+                    Some(ProcessorId::new((w * BITS_PER_WORD + bit) as u32))
+                })
+            })
+            .filter(move |&cpu| rhs.get(cpu).unwrap_or(false))
+    }
 }
@@ -43,6 +43,18 @@ use crate::libs::rwsem::RwSemWriteGuard;
 pub trait ElfArch: Clone + Copy + Debug {
     const ELF_ET_DYN_BASE: usize;
     const ELF_PAGE_SIZE: usize;
+
+    /// 在新程序的地址空间中映射架构相关的附加页（如vDSO）
+    ///
+    /// ## 返回值
+    ///
+    /// - `Ok(Some(addr))`：vDSO镜像的起始地址，通过AT_SYSINFO_EHDR传给用户程序
+    /// - `Ok(None)`：该架构没有vDSO
+    fn arch_setup_additional_pages(
+        _user_vm: &mut InnerAddressSpace,
+    ) -> Result<Option<VirtAddr>, SystemError> {
+        Ok(None)
+    }
 }
 
 #[derive(Debug)]
@@ -684,6 +696,7 @@ impl ElfLoader {
     /// - `param`：执行参数
     /// - `entrypoint_vaddr`：程序入口地址
     /// - `phdr_vaddr`：程序头表地址
+    /// - `vdso_base`：vDSO镜像的起始地址
     /// - `elf_header`：ELF文件头
     fn create_auxv(
         &self,
@@ -691,6 +704,7 @@ impl ElfLoader {
         entrypoint_vaddr: VirtAddr,
         phdr_vaddr: Option<VirtAddr>,
         interpreter_base: Option<VirtAddr>,
+        vdso_base: Option<VirtAddr>,
         ehdr: &elf::file::FileHeader<AnyEndian>,
     ) -> Result<(), ExecError> {
         use crate::process::rseq::{ORIG_RSEQ_SIZE, RSEQ_ALIGN};
@@ -715,6 +729,11 @@ impl ElfLoader {
             AtType::Base as u8,
             interpreter_base.unwrap_or(VirtAddr::new(0)).data(),
         );
+        if let Some(vdso_base) = vdso_base {
+            init_info
+                .auxv
+                .insert(AtType::SysInfoEhdr as u8, vdso_base.data());
+        }
 
         // 添加 rseq 相关的 auxv
         init_info
@@ -1211,11 +1230,14 @@ impl BinaryLoader for ElfLoader {
         }
         // debug!("to create auxv");
         let mut user_vm = binding.write();
+        let vdso_base = CurrentElfArch::arch_setup_additional_pages(&mut user_vm)
+            .map_err(ExecError::SystemError)?;
         self.create_auxv(
             param,
             program_entrypoint,
             phdr_vaddr,
             interpreter_base,
+            vdso_base,
             &ehdr,
         )?;
 
@@ -52,3 +52,21 @@ pub const FUTEX_OWNER_DIED: u32 = 0x40000000;
 #[allow(dead_code)]
 pub const FUTEX_TID_MASK: u32 = 0x3fffffff;
 pub const FUTEX_BITSET_MATCH_ANY: u32 = 0xffffffff;
+
+// futex2接口（futex_waitv/futex_wake/futex_wait/futex_requeue）的标志位
+/// futex字的大小
+pub const FUTEX2_SIZE_U8: u32 = 0x00;
+pub const FUTEX2_SIZE_U16: u32 = 0x01;
+pub const FUTEX2_SIZE_U32: u32 = 0x02;
+pub const FUTEX2_SIZE_U64: u32 = 0x03;
+pub const FUTEX2_SIZE_MASK: u32 = 0x03;
+/// futex字后面紧跟一个u32的NUMA节点号
+pub const FUTEX2_NUMA: u32 = 0x04;
+/// 与FUTEX_PRIVATE_FLAG相同
+pub const FUTEX2_PRIVATE: u32 = 128;
+pub const FUTEX2_VALID_MASK: u32 = FUTEX2_SIZE_MASK | FUTEX2_NUMA | FUTEX2_PRIVATE;
+/// NUMA节点号未指定
+pub const FUTEX_NO_NODE: u32 = u32::MAX;
+
+/// futex_waitv一次最多等待的futex数量
+pub const FUTEX_WAITV_MAX: usize = 128;
@@ -2,15 +2,17 @@ use alloc::{
     boxed::Box,
     collections::LinkedList,
     sync::{Arc, Weak},
+    vec::Vec,
 };
 use core::{
     hash::{Hash, Hasher},
     intrinsics::{likely, unlikely},
     mem,
     ops::{Deref, DerefMut},
-    sync::atomic::{AtomicU32, Ordering},
+    sync::atomic::{fence, AtomicU32, AtomicU8, AtomicUsize, Ordering},
 };
-use log::warn;
+use jhash::jhash2;
+use log::{info, warn};
 
 use hashbrown::HashMap;
 use system_error::SystemError;
@@ -20,10 +22,12 @@ use crate::{
     exception::InterruptArch,
     libs::{
         mutex::{Mutex, MutexGuard},
+        spinlock::SpinLock,
         wait_queue::{Waiter, Waker},
     },
     mm::{ucontext::AddressSpace, MemoryManagementArch, VirtAddr},
     process::{ProcessControlBlock, ProcessManager, RawPid},
+    smp::cpu::smp_cpu_manager,
     syscall::user_access::{UserBufferReader, UserBufferWriter},
     time::{
         timer::{next_n_us_timer_jiffies, Timer, TimerFunction},
@@ -35,23 +39,112 @@ use super::constant::*;
 
 static mut FUTEX_DATA: Option<FutexData> = None;
 
+/// 每个cpu对应的哈希槽位数，与Linux futex_init()一致
+const FUTEX_HASH_SLOTS_PER_CPU: usize = 256;
+
+type FutexMap = HashMap<FutexKey, FutexHashBucket>;
+
+/// futex哈希表的一个槽位
+///
+/// 哈希到同一槽位的futex共用一把锁，不同槽位互不干扰。
+/// 槽位锁使用Mutex而不是自旋锁：等待/PI路径持锁访问用户态的futex字，可能发生缺页。
+/// 持锁时间很短，争用时Mutex会先乐观自旋，效果与自旋锁接近。
+pub struct FutexHashSlot {
+    /// 在本槽位上排队（或正准备排队）的普通等待者数量
+    ///
+    /// 等待者先增加计数再读取futex字，唤醒者先修改futex字再读取计数，
+    /// 因此唤醒者读到0时可以不加锁直接返回（对标Linux futex_hb_waiters_pending）
+    waiters: AtomicUsize,
+    map: Mutex<FutexMap>,
+}
+
+impl FutexHashSlot {
+    #[inline]
+    pub fn lock(&self) -> MutexGuard<'_, FutexMap> {
+        self.map.lock()
+    }
+
+    #[inline]
+    pub fn waiters_inc(&self, n: usize) {
+        self.waiters.fetch_add(n, Ordering::SeqCst);
+    }
+
+    #[inline]
+    pub fn waiters_dec(&self, n: usize) {
+        if n != 0 {
+            self.waiters.fetch_sub(n, Ordering::SeqCst);
+        }
+    }
+
+    /// 是否可能有等待者；返回false时一定没有需要唤醒的任务
+    #[inline]
+    pub fn has_waiters(&self) -> bool {
+        fence(Ordering::SeqCst);
+        self.waiters.load(Ordering::SeqCst) != 0
+    }
+}
+
 pub struct FutexData {
-    data: Mutex<HashMap<FutexKey, FutexHashBucket>>,
+    slots: Vec<FutexHashSlot>,
+    /// 槽位数减一（槽位数是2的幂）
+    mask: usize,
 }
 
 impl FutexData {
-    pub fn futex_map() -> MutexGuard<'static, HashMap<FutexKey, FutexHashBucket>> {
-        unsafe { FUTEX_DATA.as_ref().unwrap().data.lock() }
+    #[inline]
+    fn get() -> &'static FutexData {
+        unsafe { FUTEX_DATA.as_ref().unwrap() }
+    }
+
+    #[inline]
+    fn slot_index(key: &FutexKey) -> usize {
+        (key.hash32() as usize) & Self::get().mask
+    }
+
+    /// 获取key所在的槽位
+    #[inline]
+    pub fn slot(key: &FutexKey) -> &'static FutexHashSlot {
+        let data = Self::get();
+        &data.slots[Self::slot_index(key)]
+    }
+
+    /// 锁住key所在的槽位
+    pub fn futex_map(key: &FutexKey) -> MutexGuard<'static, FutexMap> {
+        Self::slot(key).lock()
+    }
+
+    /// 按槽位下标从小到大的顺序锁住两个key所在的槽位，避免ABBA死锁
+    ///
+    /// ## 返回值
+    ///
+    /// (key1所在槽位的锁, key2所在槽位的锁)；两个key在同一槽位时第二项为None
+    pub fn futex_map_pair(
+        key1: &FutexKey,
+        key2: &FutexKey,
+    ) -> (
+        MutexGuard<'static, FutexMap>,
+        Option<MutexGuard<'static, FutexMap>>,
+    ) {
+        let data = Self::get();
+        let (idx1, idx2) = (Self::slot_index(key1), Self::slot_index(key2));
+        if idx1 == idx2 {
+            return (data.slots[idx1].lock(), None);
+        }
+        if idx1 < idx2 {
+            let guard1 = data.slots[idx1].lock();
+            let guard2 = data.slots[idx2].lock();
+            (guard1, Some(guard2))
+        } else {
+            let guard2 = data.slots[idx2].lock();
+            let guard1 = data.slots[idx1].lock();
+            (guard1, Some(guard2))
+        }
     }
 
     pub fn try_remove(key: &FutexKey) -> Option<FutexHashBucket> {
-        unsafe {
-            let mut guard = FUTEX_DATA.as_ref().unwrap().data.lock();
-            if let Some(futex) = guard.get(key) {
-                if futex.chain.is_empty() && futex.pi_waiters.is_empty() && futex.pi_owner == 0 {
-                    return guard.remove(key);
-                }
-            }
+        let mut guard = Self::futex_map(key);
+        if guard.get(key).is_some_and(|futex| futex.is_unused()) {
+            return guard.remove(key);
         }
         None
     }
@@ -59,6 +152,16 @@ impl FutexData {
 
 pub struct Futex;
 
+/// futex_waitv的一个等待项
+#[derive(Debug, Clone, Copy)]
+pub struct FutexWaitvEntry {
+    pub uaddr: VirtAddr,
+    /// 期望的futex值
+    pub val: u32,
+    /// 是否为进程间共享的futex
+    pub shared: bool,
+}
+
 // 对于同一个futex的进程或线程将会在这个bucket等待
 pub struct FutexHashBucket {
     // 该futex维护的等待队列
@@ -82,11 +185,17 @@ impl FutexHashBucket {
     pub fn contains(&self, futex_q: &FutexObj) -> bool {
         self.chain
             .iter()
-            .filter(|x| Arc::ptr_eq(&x.waker, &futex_q.waker) && x.key == futex_q.key)
+            .filter(|x| Arc::ptr_eq(&x.waker, &futex_q.waker) && x.key() == futex_q.key())
             .count()
             != 0
     }
 
+    /// 没有任何等待者，也不再记录PI持有者，可以从槽位中删除
+    #[inline]
+    pub fn is_unused(&self) -> bool {
+        self.chain.is_empty() && self.pi_waiters.is_empty() && self.pi_owner == 0
+    }
+
     #[inline(always)]
     pub fn enqueue(&mut self, futex_q: Arc<FutexObj>) {
         self.chain.push_back(futex_q);
@@ -101,6 +210,11 @@ impl FutexHashBucket {
         bitset: Option<u32>,
         nr_wake: u32,
     ) -> Result<usize, SystemError> {
+        // FUTEX_WAIT_REQUEUE_PI的等待者只能由FUTEX_CMP_REQUEUE_PI处理（与Linux一致）
+        if self.has_requeue_pi_waiters() {
+            return Err(SystemError::EINVAL);
+        }
+
         let mut count = 0;
         // 记录初始队列长度，确保只遍历一次
         let initial_len = self.chain.len();
@@ -109,7 +223,7 @@ impl FutexHashBucket {
         while processed < initial_len && count < nr_wake {
             if let Some(futex_q) = self.chain.pop_front() {
                 // 检查key是否匹配
-                if futex_q.key != key {
+                if !futex_q.key_matches(&key) {
                     // key不匹配，放回队列尾部
                     self.chain.push_back(futex_q);
                     processed += 1;
@@ -142,23 +256,97 @@ impl FutexHashBucket {
         Ok(count as usize)
     }
 
-    /// 将FutexObj从bucket中删除
-    pub fn remove_by_waker(&mut self, waker: &Arc<Waker>) -> bool {
-        let before = self.chain.len();
-        self.chain
-            .extract_if(|x| Arc::ptr_eq(&x.waker, waker))
-            .for_each(drop);
-        before != self.chain.len()
+    /// 队列中是否有FUTEX_WAIT_REQUEUE_PI的等待者
+    pub fn has_requeue_pi_waiters(&self) -> bool {
+        self.chain.iter().any(|q| q.requeue_pi.is_some())
     }
 }
 
 #[derive(Debug)]
 pub struct FutexObj {
     pub(super) waker: Arc<Waker>,
-    pub(super) key: FutexKey,
+    /// 当前排队所在的futex；FUTEX_CMP_REQUEUE会在持有新旧两个槽位锁时修改它
+    key: SpinLock<FutexKey>,
     pub(super) bitset: u32,
     pub(super) tid: u32,
-    // TODO: 优先级继承
+    /// FUTEX_WAIT_REQUEUE_PI的等待者：只能被FUTEX_CMP_REQUEUE_PI转移到的PI futex
+    pub(super) requeue_pi: Option<FutexKey>,
+    /// FUTEX_CMP_REQUEUE_PI对该等待者做了什么，见`REQUEUE_*`
+    pub(super) requeue_state: AtomicU8,
+}
+
+/// 仍在普通futex上等待
+pub(super) const REQUEUE_NONE: u8 = 0;
+/// 已经被转移到PI futex的等待队列上
+pub(super) const REQUEUE_PI_QUEUED: u8 = 1;
+/// 转移时直接替它拿到了PI futex
+pub(super) const REQUEUE_PI_LOCKED: u8 = 2;
+
+impl FutexObj {
+    pub fn new(waker: Arc<Waker>, key: FutexKey, bitset: u32, tid: u32) -> Self {
+        Self {
+            waker,
+            key: SpinLock::new(key),
+            bitset,
+            tid,
+            requeue_pi: None,
+            requeue_state: AtomicU8::new(REQUEUE_NONE),
+        }
+    }
+
+    /// 标记为FUTEX_WAIT_REQUEUE_PI的等待者，`target`为之后要转移到的PI futex
+    pub fn with_requeue_pi(mut self, target: FutexKey) -> Self {
+        self.requeue_pi = Some(target);
+        self
+    }
+
+    pub fn key(&self) -> FutexKey {
+        self.key.lock().clone()
+    }
+
+    fn key_matches(&self, key: &FutexKey) -> bool {
+        *self.key.lock() == *key
+    }
+
+    pub(super) fn set_key(&self, key: FutexKey) {
+        *self.key.lock() = key;
+    }
+
+    /// 把自己从所在的槽位中摘下来（对标Linux unqueue_me）
+    ///
+    /// ## 返回值
+    ///
+    /// 仍在队列中（没有被唤醒）时返回true
+    pub(super) fn unqueue(&self) -> bool {
+        loop {
+            let key = self.key();
+            let slot = FutexData::slot(&key);
+            let mut guard = slot.lock();
+            // 加锁期间可能被requeue到了别的futex上，重新定位
+            if !self.key_matches(&key) {
+                continue;
+            }
+
+            let Some(bucket) = guard.get_mut(&key) else {
+                return false;
+            };
+            // futex_waitv的多个等待项共用同一个waker，这里按对象本身删除
+            let before = bucket.chain.len();
+            bucket
+                .chain
+                .extract_if(|x| core::ptr::eq(x.as_ref(), self))
+                .for_each(drop);
+            let removed = before != bucket.chain.len();
+            if bucket.is_unused() {
+                guard.remove(&key);
+            }
+            drop(guard);
+            if removed {
+                slot.waiters_dec(1);
+            }
+            return removed;
+        }
+    }
 }
 
 #[derive(Debug)]
@@ -194,6 +382,36 @@ pub struct FutexKey {
     key: InnerFutexKey,
 }
 
+impl FutexKey {
+    /// 计算key在futex哈希表中的散列值，相等的key一定得到相同的值
+    fn hash32(&self) -> u32 {
+        let (kind, a, b): (u32, u64, u64) = match &self.key {
+            InnerFutexKey::Private(p) => {
+                let mm = p
+                    .address_space
+                    .as_ref()
+                    .map(|w| w.as_ptr() as u64)
+                    .unwrap_or(0);
+                (0, mm, p.address)
+            }
+            InnerFutexKey::Shared(s) => match s.kind {
+                SharedKeyKind::File { dev, ino } => (1, dev ^ ino.rotate_left(32), s.page_offset),
+                SharedKeyKind::SharedAnon { id } => (2, id, s.page_offset),
+                SharedKeyKind::PrivateAnonShared { as_id } => (3, as_id, s.page_offset),
+            },
+        };
+        let words = [
+            kind,
+            (a >> 32) as u32,
+            a as u32,
+            (b >> 32) as u32,
+            b as u32,
+            self.offset,
+        ];
+        jhash2(&words, 0)
+    }
+}
+
 /// 共享 futex 的类型
 #[derive(Hash, PartialEq, Eq, Clone, Debug)]
 pub enum SharedKeyKind {
@@ -247,12 +465,25 @@ impl PartialEq for PrivateKey {
 
 impl Futex {
     /// ### 初始化FUTEX_DATA
+    ///
+    /// 槽位数按cpu数量缩放，需要在smp准备好cpu信息之后调用
     pub fn init() {
+        let cpus = smp_cpu_manager().possible_cpus_count().max(1) as usize;
+        let nr_slots = (FUTEX_HASH_SLOTS_PER_CPU * cpus).next_power_of_two();
+        let mut slots = Vec::with_capacity(nr_slots);
+        for _ in 0..nr_slots {
+            slots.push(FutexHashSlot {
+                waiters: AtomicUsize::new(0),
+                map: Mutex::new(HashMap::new()),
+            });
+        }
         unsafe {
             FUTEX_DATA = Some(FutexData {
-                data: Mutex::new(HashMap::new()),
+                slots,
+                mask: nr_slots - 1,
             })
         };
+        info!("futex hash table: {} slots", nr_slots);
     }
 
     /// ### 让当前进程在指定futex上等待直到futex_wake显式唤醒
@@ -274,64 +505,34 @@ impl Futex {
             FutexAccess::FutexRead,
         )?;
 
-        let mut futex_map_guard = FutexData::futex_map();
-        let bucket = futex_map_guard.get_mut(&key);
-        let bucket_mut = match bucket {
-            Some(bucket) => bucket,
-            None => {
-                let bucket = FutexHashBucket::new();
-                futex_map_guard.insert(key.clone(), bucket);
-                futex_map_guard.get_mut(&key).unwrap()
-            }
-        };
-
-        // 使用UserBuffer读取futex
-        let user_reader =
-            UserBufferReader::new(uaddr.as_ptr::<u32>(), core::mem::size_of::<u32>(), true)?;
-
-        // 从用户空间读取到futex的val
-        let mut uval = 0;
-
-        // 读取
-        // 这里只尝试一种方式去读取用户空间，与linux不太一致
-        // 对于linux，如果bucket被锁住时读取失败，将会将bucket解锁后重新读取
-        user_reader.copy_one_from_user::<u32>(&mut uval, 0)?;
+        let slot = FutexData::slot(&key);
+        // 先登记为等待者再读取futex值，与futex_wake中先改值后检查等待者的顺序配对
+        slot.waiters_inc(1);
+        let mut futex_map_guard = slot.lock();
 
-        // 不满足wait条件，返回错误
-        if uval != val {
-            return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+        // 读取失败或不满足wait条件，返回错误
+        if let Err(e) = Self::check_futex_val(uaddr, val) {
+            drop(futex_map_guard);
+            slot.waiters_dec(1);
+            return Err(e);
         }
 
         let (waiter, waker) = Waiter::new_pair();
         // 创建超时计时器任务
-        let mut timer = None;
-        if let Some(time) = abs_time {
-            let sec = time.tv_sec;
-            let nsec = time.tv_nsec;
-            let total_us = (nsec / 1000 + sec * 1_000_000) as u64;
-
-            // 如果超时时间为0，直接返回ETIMEDOUT
-            if total_us == 0 {
-                return Err(SystemError::ETIMEDOUT);
+        let timer = match Self::futex_timer(abs_time, &waker) {
+            Ok(timer) => timer,
+            Err(e) => {
+                drop(futex_map_guard);
+                slot.waiters_dec(1);
+                return Err(e);
             }
+        };
 
-            let jiffies = next_n_us_timer_jiffies(total_us);
-            let wake_up = Timer::new(
-                Box::new(WakerTimer {
-                    waker: waker.clone(),
-                }),
-                jiffies,
-            );
-            timer = Some(wake_up);
-        }
-
-        let futex_q = Arc::new(FutexObj {
-            waker: waker.clone(),
-            key: key.clone(),
-            bitset,
-            tid: 0,
-        });
-        bucket_mut.enqueue(futex_q.clone());
+        let futex_q = Arc::new(FutexObj::new(waker.clone(), key.clone(), bitset, 0));
+        futex_map_guard
+            .entry(key)
+            .or_insert_with(FutexHashBucket::new)
+            .enqueue(futex_q.clone());
 
         // 在入队后激活定时器，避免短超时在阻塞之前触发造成唤醒丢失
         if let Some(ref t) = timer {
@@ -349,18 +550,11 @@ impl Futex {
         // 3. 信号唤醒 - futex_q 仍在队列中
         // 4. 伪唤醒 - futex_q 仍在队列中
 
-        let mut futex_map_guard = FutexData::futex_map();
-
         // 首先检查超时
         let is_timeout = timer.as_ref().is_some_and(|t| t.timeout());
 
-        // 从队列中移除自身（如果仍在队列）
-        let in_queue = futex_map_guard
-            .get_mut(&key)
-            .map(|bucket| bucket.remove_by_waker(&waker))
-            .unwrap_or(false);
-
-        drop(futex_map_guard);
+        // 从队列中移除自身（如果仍在队列）；期间可能已被requeue到其他futex
+        let in_queue = futex_q.unqueue();
 
         // 取消定时器
         if let Some(timer) = timer {
@@ -385,6 +579,103 @@ impl Futex {
         Ok(0)
     }
 
+    /// ### 同时在多个futex上等待，任意一个被唤醒即返回（futex_waitv）
+    ///
+    /// 所有等待项共用同一个waker，分别挂到各自的槽位上。
+    ///
+    /// ### 参数
+    /// - `entries`：等待项，最多[`FUTEX_WAITV_MAX`]个
+    /// - `timeout`：相对超时时间
+    ///
+    /// ### 返回值
+    /// 被唤醒的等待项的下标；有多个时返回最小的那个
+    pub fn futex_wait_multiple(
+        entries: &[FutexWaitvEntry],
+        timeout: Option<PosixTimeSpec>,
+    ) -> Result<usize, SystemError> {
+        let keys = entries
+            .iter()
+            .map(|e| Self::get_futex_key(e.uaddr, e.shared, FutexAccess::FutexRead))
+            .collect::<Result<Vec<_>, _>>()?;
+
+        let (waiter, waker) = Waiter::new_pair();
+        // 定时器只创建一次，伪唤醒后重新排队时不会延长超时时间。
+        // 超时时间为0时不睡眠，但仍然要先检查各个futex的值
+        let (timer, zero_timeout) = match Self::futex_timer(timeout, &waker) {
+            Ok(timer) => (timer, false),
+            Err(_) => (None, true),
+        };
+        if let Some(ref t) = timer {
+            t.activate();
+        }
+
+        let res = loop {
+            let mut queued: Vec<Arc<FutexObj>> = Vec::with_capacity(entries.len());
+            let mut setup_err = None;
+            for (entry, key) in entries.iter().zip(keys.iter()) {
+                let slot = FutexData::slot(key);
+                slot.waiters_inc(1);
+                let mut guard = slot.lock();
+                if let Err(e) = Self::check_futex_val(entry.uaddr, entry.val) {
+                    drop(guard);
+                    slot.waiters_dec(1);
+                    setup_err = Some(e);
+                    break;
+                }
+                let futex_q = Arc::new(FutexObj::new(
+                    waker.clone(),
+                    key.clone(),
+                    FUTEX_BITSET_MATCH_ANY,
+                    0,
+                ));
+                guard
+                    .entry(key.clone())
+                    .or_insert_with(FutexHashBucket::new)
+                    .enqueue(futex_q.clone());
+                drop(guard);
+                queued.push(futex_q);
+            }
+
+            if let Some(e) = setup_err {
+                // 排队过程中可能已经有futex被唤醒，此时以唤醒为准（与Linux一致）
+                break Self::unqueue_multiple(&queued).ok_or(e);
+            }
+            if zero_timeout {
+                break Self::unqueue_multiple(&queued).ok_or(SystemError::ETIMEDOUT);
+            }
+
+            let wait_res = waiter.wait(true);
+            let is_timeout = timer.as_ref().is_some_and(|t| t.timeout());
+
+            if let Some(idx) = Self::unqueue_multiple(&queued) {
+                break Ok(idx);
+            }
+            if is_timeout {
+                break Err(SystemError::ETIMEDOUT);
+            }
+            if wait_res.is_err() || ProcessManager::current_pcb().has_pending_signal() {
+                break Err(SystemError::EINTR);
+            }
+            // 伪唤醒，重新检查并排队
+        };
+
+        if let Some(timer) = timer {
+            timer.cancel();
+        }
+        res
+    }
+
+    /// 把futex_waitv的所有等待项摘下来，返回其中已被唤醒的最小下标
+    fn unqueue_multiple(queued: &[Arc<FutexObj>]) -> Option<usize> {
+        let mut woken = None;
+        for (i, futex_q) in queued.iter().enumerate() {
+            if !futex_q.unqueue() && woken.is_none() {
+                woken = Some(i);
+            }
+        }
+        woken
+    }
+
     // ### 唤醒指定futex上挂起的最多nr_wake个进程
     ///
     /// ### Linux 语义
@@ -407,8 +698,16 @@ impl Futex {
             FutexAccess::FutexRead,
         )?;
 
-        let mut binding = FutexData::futex_map();
-        let bucket_mut = binding.entry(key.clone()).or_insert(FutexHashBucket::new());
+        let slot = FutexData::slot(&key);
+        // 槽位上没有等待者时不加锁，直接返回
+        if !slot.has_waiters() {
+            return Ok(0);
+        }
+
+        let mut binding = slot.lock();
+        let Some(bucket_mut) = binding.get_mut(&key) else {
+            return Ok(0);
+        };
 
         // 确保后面的唤醒操作是有意义的
         if bucket_mut.chain.is_empty() {
@@ -419,11 +718,15 @@ impl Futex {
         let effective_nr_wake = if nr_wake == 0 { 1 } else { nr_wake };
 
         // 从队列中唤醒
+        let before = bucket_mut.chain.len();
         let count = bucket_mut.wake_up(key.clone(), Some(bitset), effective_nr_wake)?;
+        let removed = before - bucket_mut.chain.len();
 
+        if bucket_mut.is_unused() {
+            binding.remove(&key);
+        }
         drop(binding);
-
-        FutexData::try_remove(&key);
+        slot.waiters_dec(removed);
 
         Ok(count)
     }
@@ -442,9 +745,8 @@ impl Futex {
             return Err(SystemError::EINVAL);
         }
 
-        // 暂时不支持优先级继承
         if requeue_pi {
-            return Err(SystemError::ENOSYS);
+            return Self::futex_cmp_requeue_pi(uaddr1, flags, uaddr2, nr_wake, nr_requeue, cmpval);
         }
 
         let key1 = Self::get_futex_key(
@@ -452,54 +754,92 @@ impl Futex {
             flags.contains(FutexFlag::FLAGS_SHARED),
             FutexAccess::FutexRead,
         )?;
-        let key2 = Self::get_futex_key(uaddr2, flags.contains(FutexFlag::FLAGS_SHARED), {
-            match requeue_pi {
-                true => FutexAccess::FutexWrite,
-                false => FutexAccess::FutexRead,
-            }
-        })?;
+        let key2 = Self::get_futex_key(
+            uaddr2,
+            flags.contains(FutexFlag::FLAGS_SHARED),
+            FutexAccess::FutexRead,
+        )?;
 
-        if requeue_pi && key1 == key2 {
-            return Err(SystemError::EINVAL);
-        }
+        let slot1 = FutexData::slot(&key1);
+        let slot2 = FutexData::slot(&key2);
+        // 先在目标槽位上占一个等待者计数，避免转移过程中key2上的FUTEX_WAKE
+        // 因为看不到等待者而直接返回（对标Linux futex_requeue）
+        slot2.waiters_inc(1);
+        let (mut guard1, mut guard2) = FutexData::futex_map_pair(&key1, &key2);
 
+        // 在持有槽位锁时比较futex值，与futex_wait中的检查互斥
         if likely(cmpval.is_some()) {
-            let uval_reader =
-                UserBufferReader::new(uaddr1.as_ptr::<u32>(), core::mem::size_of::<u32>(), true)?;
-            let curval = uval_reader.read_one_from_user::<u32>(0)?;
+            let curval =
+                UserBufferReader::new(uaddr1.as_ptr::<u32>(), core::mem::size_of::<u32>(), true)
+                    .and_then(|reader| reader.read_one_from_user::<u32>(0).map(|v| *v));
 
             // 判断是否满足条件
-            if *curval != cmpval.unwrap() {
-                return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+            let check = match curval {
+                Err(e) => Err(e),
+                Ok(v) if v != cmpval.unwrap() => Err(SystemError::EAGAIN_OR_EWOULDBLOCK),
+                Ok(_) => Ok(()),
+            };
+            if let Err(e) = check {
+                drop(guard2);
+                drop(guard1);
+                slot2.waiters_dec(1);
+                return Err(e);
             }
         }
 
-        let mut futex_data_guard = FutexData::futex_map();
-        if !requeue_pi {
-            // 唤醒nr_wake个进程
-            let bucket_1_mut = futex_data_guard.get_mut(&key1).ok_or(SystemError::EINVAL)?;
-            let ret = bucket_1_mut.wake_up(key1.clone(), None, nr_wake as u32)?;
-            // 将bucket1中最多nr_requeue个任务转移到bucket2
-            for _ in 0..nr_requeue {
-                let bucket_1_mut = futex_data_guard.get_mut(&key1).ok_or(SystemError::EINVAL)?;
-                let futex_q = bucket_1_mut.chain.pop_front();
-                match futex_q {
-                    Some(futex_q) => {
-                        let bucket_2_mut =
-                            futex_data_guard.get_mut(&key2).ok_or(SystemError::EINVAL)?;
-                        bucket_2_mut.chain.push_back(futex_q);
-                    }
-                    None => {
-                        break;
-                    }
-                }
+        // 没有等待者，与Linux一样返回0
+        let Some(bucket_1_mut) = guard1.get_mut(&key1) else {
+            drop(guard2);
+            drop(guard1);
+            slot2.waiters_dec(1);
+            return Ok(0);
+        };
+        let before = bucket_1_mut.chain.len();
+        // 唤醒nr_wake个进程
+        let ret = match bucket_1_mut.wake_up(key1.clone(), None, nr_wake as u32) {
+            Ok(ret) => ret,
+            Err(e) => {
+                drop(guard2);
+                drop(guard1);
+                slot2.waiters_dec(1);
+                return Err(e);
+            }
+        };
+        // 将bucket1中最多nr_requeue个任务转移到bucket2
+        let mut requeued = Vec::new();
+        while requeued.len() < nr_requeue as usize {
+            match bucket_1_mut.chain.pop_front() {
+                Some(futex_q) => requeued.push(futex_q),
+                None => break,
             }
+        }
+        let removed = before - bucket_1_mut.chain.len();
+        if bucket_1_mut.is_unused() {
+            guard1.remove(&key1);
+        }
 
-            return Ok(ret);
-        } else {
-            // 暂时不支持优先级继承
-            todo!()
+        let nr_requeued = requeued.len();
+        if nr_requeued != 0 {
+            slot2.waiters_inc(nr_requeued);
+            let map2 = match guard2.as_mut() {
+                Some(guard2) => guard2,
+                None => &mut guard1,
+            };
+            let bucket_2_mut = map2
+                .entry(key2.clone())
+                .or_insert_with(FutexHashBucket::new);
+            for futex_q in requeued {
+                futex_q.set_key(key2.clone());
+                bucket_2_mut.chain.push_back(futex_q);
+            }
         }
+        drop(guard2);
+        drop(guard1);
+        slot1.waiters_dec(removed);
+        slot2.waiters_dec(1);
+
+        // 返回值为唤醒与转移的等待者总数
+        Ok(ret + nr_requeued)
     }
 
     /// ### 唤醒futex上的进程的同时进行一些操作
@@ -523,23 +863,20 @@ impl Futex {
             FutexAccess::FutexWrite,
         )?;
 
-        let mut futex_data_guard = FutexData::futex_map();
         let mut wake_count = 0;
 
         // 若 uaddr1 没有关联任何等待者，则按照 Linux 行为返回 0 而不是 EINVAL。
-        if let Some(bucket1) = futex_data_guard.get_mut(&key1) {
-            // 唤醒uaddr1中的进程
-            wake_count += bucket1.wake_up(key1, None, nr_wake as u32)?;
-        }
+        // 唤醒uaddr1中的进程
+        wake_count += Self::wake_key(&key1, nr_wake as u32)?;
 
+        // 两个槽位分别加锁：等待者在槽位锁内检查futex值并入队，
+        // 所以先修改uaddr2再锁住它的槽位唤醒，不会漏掉等待者
         match Self::futex_atomic_op_inuser(op as u32, uaddr2) {
             Ok(ret) => {
                 // 操作成功则唤醒uaddr2中的进程
                 if ret {
                     // 若 uaddr2 没有关联任何等待者，则按照 Linux 行为跳过唤醒，而不是返回 EINVAL。
-                    if let Some(bucket2) = futex_data_guard.get_mut(&key2) {
-                        wake_count += bucket2.wake_up(key2, None, nr_wake2 as u32)?;
-                    }
+                    wake_count += Self::wake_key(&key2, nr_wake2 as u32)?;
                 }
             }
             Err(e) => {
@@ -551,6 +888,65 @@ impl Futex {
         Ok(wake_count)
     }
 
+    /// 读取用户态的futex字，检查它是否仍等于`val`
+    ///
+    /// 这里只尝试一种方式去读取用户空间，与linux不太一致。
+    /// 对于linux，如果bucket被锁住时读取失败，将会将bucket解锁后重新读取
+    pub(super) fn check_futex_val(uaddr: VirtAddr, val: u32) -> Result<(), SystemError> {
+        let mut uval = 0;
+        UserBufferReader::new(uaddr.as_ptr::<u32>(), core::mem::size_of::<u32>(), true)?
+            .copy_one_from_user::<u32>(&mut uval, 0)?;
+        if uval != val {
+            return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+        }
+        Ok(())
+    }
+
+    /// 为相对超时时间`timeout`创建（未激活的）唤醒定时器
+    ///
+    /// 超时时间为0时返回ETIMEDOUT
+    pub(super) fn futex_timer(
+        timeout: Option<PosixTimeSpec>,
+        waker: &Arc<Waker>,
+    ) -> Result<Option<Arc<Timer>>, SystemError> {
+        let Some(time) = timeout else {
+            return Ok(None);
+        };
+        let total_us = (time.tv_nsec / 1000 + time.tv_sec * 1_000_000) as u64;
+        if total_us == 0 {
+            return Err(SystemError::ETIMEDOUT);
+        }
+        let jiffies = next_n_us_timer_jiffies(total_us);
+        Ok(Some(Timer::new(
+            Box::new(WakerTimer {
+                waker: waker.clone(),
+            }),
+            jiffies,
+        )))
+    }
+
+    /// 唤醒key上最多nr_wake个等待者（不检查bitset），供FUTEX_WAKE_OP使用
+    fn wake_key(key: &FutexKey, nr_wake: u32) -> Result<usize, SystemError> {
+        let slot = FutexData::slot(key);
+        if !slot.has_waiters() {
+            return Ok(0);
+        }
+
+        let mut guard = slot.lock();
+        let Some(bucket) = guard.get_mut(key) else {
+            return Ok(0);
+        };
+        let before = bucket.chain.len();
+        let count = bucket.wake_up(key.clone(), None, nr_wake)?;
+        let removed = before - bucket.chain.len();
+        if bucket.is_unused() {
+            guard.remove(key);
+        }
+        drop(guard);
+        slot.waiters_dec(removed);
+        Ok(count)
+    }
+
     pub(super) fn get_futex_key(
         uaddr: VirtAddr,
         fshared: bool,
@@ -1070,24 +1466,10 @@ impl RobustListHead {
         let key_private = Futex::get_futex_key(futex_uaddr, false, FutexAccess::FutexWrite).ok();
         let key_shared = Futex::get_futex_key(futex_uaddr, true, FutexAccess::FutexWrite).ok();
 
-        let key = {
-            let guard = FutexData::futex_map();
-            let mut chosen = None;
-            if let Some(k) = key_private.as_ref() {
-                if guard.get(k).is_some() {
-                    chosen = Some(k.clone());
-                }
-            }
-            if chosen.is_none() {
-                if let Some(k) = key_shared.as_ref() {
-                    if guard.get(k).is_some() {
-                        chosen = Some(k.clone());
-                    }
-                }
-            }
-            drop(guard);
-            chosen
-        };
+        let key = [key_private, key_shared]
+            .into_iter()
+            .flatten()
+            .find(|k| FutexData::futex_map(k).get(k).is_some());
 
         loop {
             let owner = uval & FUTEX_TID_MASK;
@@ -1096,7 +1478,7 @@ impl RobustListHead {
             }
 
             if let Some(ref key) = key {
-                let mut futex_map_guard = FutexData::futex_map();
+                let mut futex_map_guard = FutexData::futex_map(key);
                 let bucket = match futex_map_guard.get_mut(key) {
                     Some(bucket) => bucket,
                     None => {
@@ -1,4 +1,4 @@
-use alloc::{boxed::Box, sync::Arc};
+use alloc::{boxed::Box, sync::Arc, vec::Vec};
 use core::sync::atomic::{AtomicU32, Ordering};
 
 use system_error::SystemError;
@@ -9,7 +9,10 @@ use crate::{
             constant::{
                 FutexFlag, FUTEX_BITSET_MATCH_ANY, FUTEX_OWNER_DIED, FUTEX_TID_MASK, FUTEX_WAITERS,
             },
-            futex::{Futex, FutexAccess, FutexData, FutexHashBucket, FutexObj},
+            futex::{
+                Futex, FutexAccess, FutexData, FutexHashBucket, FutexObj, REQUEUE_PI_LOCKED,
+                REQUEUE_PI_QUEUED,
+            },
         },
         wait_queue::{Waiter, Waker},
     },
@@ -77,7 +80,7 @@ impl Futex {
                     Ordering::SeqCst,
                 ) {
                     Ok(_) => {
-                        let mut futex_map_guard = FutexData::futex_map();
+                        let mut futex_map_guard = FutexData::futex_map(&key);
                         if let Some(bucket) = futex_map_guard.get_mut(&key) {
                             bucket.pi_owner = current_tid;
                         }
@@ -95,12 +98,12 @@ impl Futex {
             }
 
             let (waiter, waker) = Waiter::new_pair();
-            let futex_q = Arc::new(FutexObj {
-                waker: waker.clone(),
-                key: key.clone(),
-                bitset: FUTEX_BITSET_MATCH_ANY,
-                tid: current_tid,
-            });
+            let futex_q = Arc::new(FutexObj::new(
+                waker.clone(),
+                key.clone(),
+                FUTEX_BITSET_MATCH_ANY,
+                current_tid,
+            ));
 
             let mut timer = None;
             if let Some(time) = timeout {
@@ -120,7 +123,7 @@ impl Futex {
                 timer = Some(wake_up);
             }
 
-            let mut futex_map_guard = FutexData::futex_map();
+            let mut futex_map_guard = FutexData::futex_map(&key);
             let bucket_mut = futex_map_guard
                 .entry(key.clone())
                 .or_insert(FutexHashBucket::new());
@@ -179,7 +182,7 @@ impl Futex {
 
             let is_timeout = timer.as_ref().is_some_and(|t| t.timeout());
 
-            let mut futex_map_guard = FutexData::futex_map();
+            let mut futex_map_guard = FutexData::futex_map(&key);
             if let Some(bucket) = futex_map_guard.get_mut(&key) {
                 let mut in_queue = false;
                 bucket
@@ -282,7 +285,7 @@ impl Futex {
                 return Err(SystemError::EPERM);
             }
 
-            let mut futex_map_guard = FutexData::futex_map();
+            let mut futex_map_guard = FutexData::futex_map(&key);
             let bucket_opt = futex_map_guard.get_mut(&key);
             let bucket = match bucket_opt {
                 None => {
@@ -377,7 +380,7 @@ impl Futex {
             }
 
             if cur_owner != 0 {
-                let mut futex_map_guard = FutexData::futex_map();
+                let mut futex_map_guard = FutexData::futex_map(&key);
                 let bucket = futex_map_guard
                     .entry(key.clone())
                     .or_insert(FutexHashBucket::new());
@@ -419,7 +422,7 @@ impl Futex {
                 continue;
             }
 
-            let mut futex_map_guard = FutexData::futex_map();
+            let mut futex_map_guard = FutexData::futex_map(&key);
             if let Some(bucket) = futex_map_guard.get_mut(&key) {
                 bucket.pi_owner = current_tid;
             }
@@ -431,4 +434,259 @@ impl Futex {
             return Ok(0);
         }
     }
+
+    /// ## FUTEX_WAIT_REQUEUE_PI - 在普通futex上等待，之后被转移到PI futex
+    ///
+    /// 条件变量的等待端：先在`uaddr`上等待，FUTEX_CMP_REQUEUE_PI会把等待者直接转移到
+    /// PI futex `uaddr2`的等待队列上（或者直接替它拿到`uaddr2`），返回时当前线程持有`uaddr2`。
+    ///
+    /// ### 参数
+    /// - `uaddr`: 普通futex（条件变量）
+    /// - `val`: `uaddr`的期望值
+    /// - `timeout`: 可选的相对超时时间
+    /// - `bitset`: 不能为0
+    /// - `uaddr2`: PI futex（互斥锁）
+    ///
+    /// ### 返回值
+    /// - `Ok(0)`: 已经持有`uaddr2`
+    /// - `Err(SystemError::EAGAIN_OR_EWOULDBLOCK)`: `uaddr`的值不等于`val`，或者在被转移之前被唤醒
+    /// - `Err(SystemError::ETIMEDOUT)`: 超时
+    /// - `Err(SystemError::EINTR)`: 被信号中断
+    pub fn futex_wait_requeue_pi(
+        uaddr: VirtAddr,
+        flags: FutexFlag,
+        val: u32,
+        timeout: Option<PosixTimeSpec>,
+        bitset: u32,
+        uaddr2: VirtAddr,
+    ) -> Result<usize, SystemError> {
+        if bitset == 0 {
+            return Err(SystemError::EINVAL);
+        }
+
+        let current_tid = ProcessManager::current_pcb().task_pid_vnr().data() as u32;
+        let shared = flags.contains(FutexFlag::FLAGS_SHARED);
+        let key = Self::get_futex_key(uaddr, shared, FutexAccess::FutexRead)?;
+        let key2 = Self::get_futex_key(uaddr2, shared, FutexAccess::FutexWrite)?;
+        if key == key2 {
+            return Err(SystemError::EINVAL);
+        }
+
+        let slot = FutexData::slot(&key);
+        slot.waiters_inc(1);
+        let mut futex_map_guard = slot.lock();
+        if let Err(e) = Self::check_futex_val(uaddr, val) {
+            drop(futex_map_guard);
+            slot.waiters_dec(1);
+            return Err(e);
+        }
+
+        let (waiter, waker) = Waiter::new_pair();
+        let timer = match Self::futex_timer(timeout, &waker) {
+            Ok(timer) => timer,
+            Err(e) => {
+                drop(futex_map_guard);
+                slot.waiters_dec(1);
+                return Err(e);
+            }
+        };
+
+        let futex_q = Arc::new(
+            FutexObj::new(waker.clone(), key.clone(), bitset, current_tid)
+                .with_requeue_pi(key2.clone()),
+        );
+        futex_map_guard
+            .entry(key)
+            .or_insert_with(FutexHashBucket::new)
+            .enqueue(futex_q.clone());
+        if let Some(ref t) = timer {
+            t.activate();
+        }
+        drop(futex_map_guard);
+
+        let atomic_futex2 = unsafe { AtomicU32::from_ptr(uaddr2.as_ptr::<u32>()) };
+        let res = loop {
+            let wait_res = waiter.wait(true);
+            let is_timeout = timer.as_ref().is_some_and(|t| t.timeout());
+            let interrupted =
+                wait_res.is_err() || ProcessManager::current_pcb().has_pending_signal();
+
+            // 还没有被转移
+            if futex_q.unqueue() {
+                break Err(if is_timeout {
+                    SystemError::ETIMEDOUT
+                } else if interrupted {
+                    SystemError::EINTR
+                } else {
+                    SystemError::EAGAIN_OR_EWOULDBLOCK
+                });
+            }
+
+            match futex_q.requeue_state.load(Ordering::Acquire) {
+                REQUEUE_PI_LOCKED => break Ok(0),
+                REQUEUE_PI_QUEUED => {}
+                _ => break Err(SystemError::EAGAIN_OR_EWOULDBLOCK),
+            }
+
+            // 已经在uaddr2的PI等待队列上：要么futex_unlock_pi把锁交给了自己，要么继续等
+            let mut futex_map_guard = FutexData::futex_map(&key2);
+            let Some(bucket) = futex_map_guard.get_mut(&key2) else {
+                break Ok(0);
+            };
+            let mut in_queue = false;
+            if is_timeout || interrupted {
+                bucket
+                    .pi_waiters
+                    .extract_if(|x| Arc::ptr_eq(x, &futex_q))
+                    .for_each(|_| in_queue = true);
+            } else {
+                in_queue = bucket.pi_waiters.iter().any(|x| Arc::ptr_eq(x, &futex_q));
+            }
+            if !in_queue {
+                // 被移出队列只可能是拿到了锁
+                break Ok(0);
+            }
+            if is_timeout || interrupted {
+                if bucket.pi_waiters.is_empty() {
+                    atomic_futex2.fetch_and(!FUTEX_WAITERS, Ordering::SeqCst);
+                }
+                break Err(if is_timeout {
+                    SystemError::ETIMEDOUT
+                } else {
+                    SystemError::EINTR
+                });
+            }
+            // 伪唤醒，继续在PI futex上等待
+        };
+
+        if let Some(timer) = timer {
+            timer.cancel();
+        }
+        res?;
+        if (atomic_futex2.load(Ordering::SeqCst) & FUTEX_OWNER_DIED) != 0 {
+            return Err(SystemError::EOWNERDEAD);
+        }
+        Ok(0)
+    }
+
+    /// ## FUTEX_CMP_REQUEUE_PI - 把普通futex上的等待者转移到PI futex上
+    ///
+    /// 条件变量广播时不唤醒所有等待者：`uaddr2`空闲时替队首的等待者拿到锁并唤醒它，
+    /// 其余最多`nr_requeue`个等待者直接挂到`uaddr2`的PI等待队列上，由之后的解锁逐个交接。
+    ///
+    /// ### 返回值
+    /// 拿到锁的等待者与被转移的等待者的总数
+    pub(super) fn futex_cmp_requeue_pi(
+        uaddr1: VirtAddr,
+        flags: FutexFlag,
+        uaddr2: VirtAddr,
+        nr_wake: i32,
+        nr_requeue: i32,
+        cmpval: Option<u32>,
+    ) -> Result<usize, SystemError> {
+        // 与Linux一致，只允许唤醒一个等待者
+        if nr_wake != 1 {
+            return Err(SystemError::EINVAL);
+        }
+        let cmpval = cmpval.ok_or(SystemError::EINVAL)?;
+
+        let shared = flags.contains(FutexFlag::FLAGS_SHARED);
+        let key1 = Self::get_futex_key(uaddr1, shared, FutexAccess::FutexRead)?;
+        let key2 = Self::get_futex_key(uaddr2, shared, FutexAccess::FutexWrite)?;
+        if key1 == key2 {
+            return Err(SystemError::EINVAL);
+        }
+
+        let slot1 = FutexData::slot(&key1);
+        let (mut guard1, mut guard2) = FutexData::futex_map_pair(&key1, &key2);
+        Self::check_futex_val(uaddr1, cmpval)?;
+
+        let Some(bucket1) = guard1.get_mut(&key1) else {
+            return Ok(0);
+        };
+        // 所有等待者都必须是以uaddr2为目标的FUTEX_WAIT_REQUEUE_PI等待者
+        if bucket1
+            .chain
+            .iter()
+            .any(|q| q.requeue_pi.as_ref() != Some(&key2))
+        {
+            return Err(SystemError::EINVAL);
+        }
+
+        let atomic_futex2 = unsafe { AtomicU32::from_ptr(uaddr2.as_ptr::<u32>()) };
+        let before = bucket1.chain.len();
+
+        // uaddr2空闲时直接替队首的等待者加锁（对标Linux futex_proxy_trylock_atomic）
+        let mut locked = None;
+        if let Some(top) = bucket1.chain.front().cloned() {
+            loop {
+                let uval2 = atomic_futex2.load(Ordering::SeqCst);
+                if (uval2 & FUTEX_TID_MASK) != 0 {
+                    break;
+                }
+                let desired = top.tid | (uval2 & (FUTEX_OWNER_DIED | FUTEX_WAITERS));
+                if atomic_futex2
+                    .compare_exchange(uval2, desired, Ordering::SeqCst, Ordering::SeqCst)
+                    .is_ok()
+                {
+                    bucket1.chain.pop_front();
+                    locked = Some(top);
+                    break;
+                }
+            }
+        }
+
+        let mut requeued = Vec::new();
+        while requeued.len() < nr_requeue as usize {
+            match bucket1.chain.pop_front() {
+                Some(futex_q) => requeued.push(futex_q),
+                None => break,
+            }
+        }
+        let removed = before - bucket1.chain.len();
+        if bucket1.is_unused() {
+            guard1.remove(&key1);
+        }
+
+        let nr_requeued = requeued.len();
+        if locked.is_some() || nr_requeued != 0 {
+            let map2 = match guard2.as_mut() {
+                Some(guard2) => guard2,
+                None => &mut guard1,
+            };
+            let bucket2 = map2
+                .entry(key2.clone())
+                .or_insert_with(FutexHashBucket::new);
+            if let Some(ref top) = locked {
+                bucket2.pi_owner = top.tid;
+                top.requeue_state
+                    .store(REQUEUE_PI_LOCKED, Ordering::Release);
+            }
+            if nr_requeued != 0 {
+                if bucket2.pi_owner == 0 {
+                    bucket2.pi_owner = atomic_futex2.load(Ordering::SeqCst) & FUTEX_TID_MASK;
+                }
+                for futex_q in requeued {
+                    futex_q.set_key(key2.clone());
+                    futex_q
+                        .requeue_state
+                        .store(REQUEUE_PI_QUEUED, Ordering::Release);
+                    bucket2.pi_waiters.push_back(futex_q);
+                }
+                atomic_futex2.fetch_or(FUTEX_WAITERS, Ordering::SeqCst);
+            }
+        }
+        drop(guard2);
+        drop(guard1);
+        slot1.waiters_dec(removed);
+
+        let nr_locked = match locked {
+            Some(top) => {
+                top.waker.wake();
+                1
+            }
+            None => 0,
+        };
+        Ok(nr_locked + nr_requeued)
+    }
 }
@@ -1,2 +1,3 @@
 pub mod sys_futex;
+pub mod sys_futex2;
 pub mod sys_robust_futex;
@@ -202,34 +202,8 @@ pub(super) fn do_futex(
         }
         FutexArg::FUTEX_WAIT_BITSET => {
             // Linux 语义：WAIT_BITSET 的超时为绝对时间（clock_nanosleep 风格）。
-            // 这里将绝对截止时间转换为相对剩余时间，past 则立即 ETIMEDOUT。
-            let adjusted_timeout = if let Some(deadline) = timeout {
-                // 校验 timespec 合法性
-                if deadline.tv_nsec < 0 || deadline.tv_nsec >= 1_000_000_000 {
-                    return Err(SystemError::EINVAL);
-                }
-
-                // 选择时钟：若带 FUTEX_CLOCK_REALTIME 则使用 realtime；否则使用 monotonic（当前实现等价）
-                let now = crate::time::timekeeping::getnstimeofday();
-
-                // 计算剩余时间 = deadline - now，若 <=0 则立即超时
-                let mut sec = deadline.tv_sec - now.tv_sec;
-                let mut nsec = deadline.tv_nsec - now.tv_nsec;
-                if nsec < 0 {
-                    nsec += 1_000_000_000;
-                    sec -= 1;
-                }
-                if sec < 0 || (sec == 0 && nsec == 0) {
-                    return Err(SystemError::ETIMEDOUT);
-                }
-
-                Some(PosixTimeSpec {
-                    tv_sec: sec,
-                    tv_nsec: nsec,
-                })
-            } else {
-                None
-            };
+            let adjusted_timeout =
+                abs_timeout_to_relative(timeout, flags.contains(FutexFlag::FLAGS_CLOCKRT))?;
 
             return Futex::futex_wait(uaddr, flags, val, adjusted_timeout, val3);
         }
@@ -286,13 +260,64 @@ pub(super) fn do_futex(
             return Futex::futex_trylock_pi(uaddr, flags);
         }
         FutexArg::FUTEX_WAIT_REQUEUE_PI => {
-            todo!()
+            let adjusted_timeout =
+                abs_timeout_to_relative(timeout, flags.contains(FutexFlag::FLAGS_CLOCKRT))?;
+            return Futex::futex_wait_requeue_pi(uaddr, flags, val, adjusted_timeout, val3, uaddr2);
         }
         FutexArg::FUTEX_CMP_REQUEUE_PI => {
-            todo!()
+            return Futex::futex_requeue(
+                uaddr,
+                flags,
+                uaddr2,
+                val as i32,
+                val2 as i32,
+                Some(val3),
+                true,
+            );
         }
         _ => {
             return Err(SystemError::ENOSYS);
         }
     }
 }
+
+/// 将绝对截止时间转换为相对剩余时间，已经过去则返回ETIMEDOUT
+///
+/// ## 参数
+///
+/// - `deadline`：绝对截止时间
+/// - `realtime`：截止时间基于CLOCK_REALTIME，否则基于CLOCK_MONOTONIC
+pub(super) fn abs_timeout_to_relative(
+    deadline: Option<PosixTimeSpec>,
+    realtime: bool,
+) -> Result<Option<PosixTimeSpec>, SystemError> {
+    let Some(deadline) = deadline else {
+        return Ok(None);
+    };
+    // 校验 timespec 合法性
+    if deadline.tv_nsec < 0 || deadline.tv_nsec >= 1_000_000_000 {
+        return Err(SystemError::EINVAL);
+    }
+
+    let now = if realtime {
+        crate::time::timekeeping::getnstimeofday()
+    } else {
+        crate::time::syscall::posix_clock_now(crate::time::syscall::PosixClockID::Monotonic)
+    };
+
+    // 计算剩余时间 = deadline - now，若 <=0 则立即超时
+    let mut sec = deadline.tv_sec - now.tv_sec;
+    let mut nsec = deadline.tv_nsec - now.tv_nsec;
+    if nsec < 0 {
+        nsec += 1_000_000_000;
+        sec -= 1;
+    }
+    if sec < 0 || (sec == 0 && nsec == 0) {
+        return Err(SystemError::ETIMEDOUT);
+    }
+
+    Ok(Some(PosixTimeSpec {
+        tv_sec: sec,
+        tv_nsec: nsec,
+    }))
+}
@@ -0,0 +1,359 @@
+//! futex2系列系统调用：futex_waitv、futex_wake、futex_wait、futex_requeue
+//!
+//! 与多路复用的`futex`系统调用不同，这组接口用独立的标志位描述每个futex字
+//! （大小、NUMA节点、是否私有），并且支持一次等待多个futex。
+
+use system_error::SystemError;
+
+use crate::libs::futex::{
+    constant::*,
+    futex::{Futex, FutexWaitvEntry},
+};
+
+use crate::{
+    arch::{
+        interrupt::TrapFrame,
+        syscall::nr::{SYS_FUTEX_REQUEUE, SYS_FUTEX_WAIT, SYS_FUTEX_WAITV, SYS_FUTEX_WAKE},
+    },
+    mm::{access_ok, VirtAddr},
+    syscall::{
+        table::{FormattedSyscallParam, Syscall},
+        user_access::UserBufferReader,
+    },
+    time::PosixTimeSpec,
+};
+use alloc::string::ToString;
+use alloc::vec::Vec;
+
+use super::sys_futex::abs_timeout_to_relative;
+
+const CLOCK_REALTIME: i32 = 0;
+const CLOCK_MONOTONIC: i32 = 1;
+
+/// 用户态的`struct futex_waitv`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+struct PosixFutexWaitv {
+    val: u64,
+    uaddr: u64,
+    flags: u32,
+    __reserved: u32,
+}
+
+/// 校验futex2标志位与futex字，返回该futex是否为进程间共享
+///
+/// 目前只支持32位的futex字。带FUTEX2_NUMA时futex字后面紧跟一个u32的节点号，
+/// 本内核只有一个NUMA节点，节点号只能是0或者FUTEX_NO_NODE。
+fn futex2_validate(uaddr: VirtAddr, flags: u32, val: u64) -> Result<bool, SystemError> {
+    if flags & !FUTEX2_VALID_MASK != 0 {
+        return Err(SystemError::EINVAL);
+    }
+    match flags & FUTEX2_SIZE_MASK {
+        FUTEX2_SIZE_U32 => {}
+        FUTEX2_SIZE_U8 | FUTEX2_SIZE_U16 | FUTEX2_SIZE_U64 => return Err(SystemError::EINVAL),
+        _ => unreachable!(),
+    }
+    if val > u32::MAX as u64 {
+        return Err(SystemError::EINVAL);
+    }
+
+    let numa = flags & FUTEX2_NUMA != 0;
+    let size = if numa {
+        2 * core::mem::size_of::<u32>()
+    } else {
+        core::mem::size_of::<u32>()
+    };
+    if uaddr.data() % size != 0 {
+        return Err(SystemError::EINVAL);
+    }
+    access_ok(uaddr, size)?;
+
+    if numa {
+        let reader = UserBufferReader::new(uaddr.as_ptr::<u32>(), size, true)?;
+        let node = *reader.read_one_from_user::<u32>(core::mem::size_of::<u32>())?;
+        if node != FUTEX_NO_NODE && node != 0 {
+            return Err(SystemError::EINVAL);
+        }
+    }
+
+    Ok(flags & FUTEX2_PRIVATE == 0)
+}
+
+/// 读取用户态的绝对超时时间并转换为相对时间
+fn futex2_timeout(
+    utime: usize,
+    clockid: i32,
+    from_user: bool,
+) -> Result<Option<PosixTimeSpec>, SystemError> {
+    if utime == 0 {
+        return Ok(None);
+    }
+    let realtime = match clockid {
+        CLOCK_REALTIME => true,
+        CLOCK_MONOTONIC => false,
+        _ => return Err(SystemError::EINVAL),
+    };
+    let reader = UserBufferReader::new(
+        utime as *const PosixTimeSpec,
+        core::mem::size_of::<PosixTimeSpec>(),
+        from_user,
+    )?;
+    let deadline = *reader.read_one_from_user::<PosixTimeSpec>(0)?;
+    abs_timeout_to_relative(Some(deadline), realtime)
+}
+
+/// 读取用户态的futex_waitv数组
+fn read_waitv(
+    waiters: usize,
+    nr: usize,
+    from_user: bool,
+) -> Result<Vec<PosixFutexWaitv>, SystemError> {
+    let reader = UserBufferReader::new(
+        waiters as *const PosixFutexWaitv,
+        nr * core::mem::size_of::<PosixFutexWaitv>(),
+        from_user,
+    )?;
+    let mut vs = vec![PosixFutexWaitv::default(); nr];
+    reader.copy_from_user(&mut vs, 0)?;
+    Ok(vs)
+}
+
+/// 校验一个futex_waitv等待项
+fn waitv_entry(v: &PosixFutexWaitv) -> Result<FutexWaitvEntry, SystemError> {
+    if v.__reserved != 0 {
+        return Err(SystemError::EINVAL);
+    }
+    let uaddr = VirtAddr::new(v.uaddr as usize);
+    let shared = futex2_validate(uaddr, v.flags, v.val)?;
+    Ok(FutexWaitvEntry {
+        uaddr,
+        val: v.val as u32,
+        shared,
+    })
+}
+
+fn futex2_flags(shared: bool) -> FutexFlag {
+    if shared {
+        FutexFlag::FLAGS_SHARED
+    } else {
+        FutexFlag::FLAGS_MATCH_NONE
+    }
+}
+
+/// System call handler for the `futex_waitv` syscall
+///
+/// Waits on up to `FUTEX_WAITV_MAX` futexes at once and returns the index of the one that woke us.
+pub struct SysFutexWaitvHandle;
+
+impl Syscall for SysFutexWaitvHandle {
+    fn num_args(&self) -> usize {
+        5
+    }
+
+    /// Handles the `futex_waitv` system call
+    ///
+    /// # Arguments
+    /// * `args` - Array containing:
+    ///   - args[0]: waiters - Pointer to an array of `struct futex_waitv`
+    ///   - args[1]: nr_futexes - Number of entries in `waiters`
+    ///   - args[2]: flags - Must be 0
+    ///   - args[3]: timeout - Absolute timeout (*const PosixTimeSpec) or 0
+    ///   - args[4]: clockid - CLOCK_MONOTONIC or CLOCK_REALTIME
+    ///
+    /// # Returns
+    /// * `Ok(usize)` - Index of the woken futex
+    /// * `Err(SystemError)` - EAGAIN if a futex value did not match, ETIMEDOUT, EINTR, ...
+    fn handle(&self, args: &[usize], frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let waiters = args[0];
+        let nr = args[1] as u32 as usize;
+        let flags = args[2] as u32;
+
+        if flags != 0 || waiters == 0 || nr == 0 || nr > FUTEX_WAITV_MAX {
+            return Err(SystemError::EINVAL);
+        }
+
+        let timeout = futex2_timeout(args[3], args[4] as i32, frame.is_from_user())?;
+        let entries = read_waitv(waiters, nr, frame.is_from_user())?
+            .iter()
+            .map(waitv_entry)
+            .collect::<Result<Vec<_>, _>>()?;
+
+        Futex::futex_wait_multiple(&entries, timeout)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("waiters", format!("{:#x}", args[0])),
+            FormattedSyscallParam::new("nr_futexes", (args[1] as u32).to_string()),
+            FormattedSyscallParam::new("flags", format!("{:#x}", args[2] as u32)),
+            FormattedSyscallParam::new("timeout", format!("{:#x}", args[3])),
+            FormattedSyscallParam::new("clockid", (args[4] as i32).to_string()),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_FUTEX_WAITV, SysFutexWaitvHandle);
+
+/// System call handler for the futex2 `futex_wake` syscall
+pub struct SysFutexWakeHandle;
+
+impl Syscall for SysFutexWakeHandle {
+    fn num_args(&self) -> usize {
+        4
+    }
+
+    /// Handles the `futex_wake` system call
+    ///
+    /// # Arguments
+    /// * `args` - Array containing:
+    ///   - args[0]: uaddr - Futex word
+    ///   - args[1]: mask - Bitset of waiters to wake
+    ///   - args[2]: nr - Maximum number of waiters to wake
+    ///   - args[3]: flags - FUTEX2_* flags
+    ///
+    /// # Returns
+    /// * `Ok(usize)` - Number of woken waiters
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let uaddr = VirtAddr::new(args[0]);
+        let mask = args[1];
+        let nr = args[2] as i32;
+        let flags = args[3] as u32;
+
+        if mask == 0 || mask > u32::MAX as usize {
+            return Err(SystemError::EINVAL);
+        }
+        let shared = futex2_validate(uaddr, flags, 0)?;
+        if nr <= 0 {
+            return Ok(0);
+        }
+
+        Futex::futex_wake(uaddr, futex2_flags(shared), nr as u32, mask as u32)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("uaddr", format!("{:#x}", args[0])),
+            FormattedSyscallParam::new("mask", format!("{:#x}", args[1])),
+            FormattedSyscallParam::new("nr", (args[2] as i32).to_string()),
+            FormattedSyscallParam::new("flags", format!("{:#x}", args[3] as u32)),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_FUTEX_WAKE, SysFutexWakeHandle);
+
+/// System call handler for the futex2 `futex_wait` syscall
+pub struct SysFutexWaitHandle;
+
+impl Syscall for SysFutexWaitHandle {
+    fn num_args(&self) -> usize {
+        6
+    }
+
+    /// Handles the `futex_wait` system call
+    ///
+    /// # Arguments
+    /// * `args` - Array containing:
+    ///   - args[0]: uaddr - Futex word
+    ///   - args[1]: val - Expected value
+    ///   - args[2]: mask - Bitset of this waiter
+    ///   - args[3]: flags - FUTEX2_* flags
+    ///   - args[4]: timeout - Absolute timeout (*const PosixTimeSpec) or 0
+    ///   - args[5]: clockid - CLOCK_MONOTONIC or CLOCK_REALTIME
+    ///
+    /// # Returns
+    /// * `Ok(0)` - Woken up
+    fn handle(&self, args: &[usize], frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let uaddr = VirtAddr::new(args[0]);
+        let val = args[1] as u64;
+        let mask = args[2];
+        let flags = args[3] as u32;
+
+        if mask == 0 || mask > u32::MAX as usize {
+            return Err(SystemError::EINVAL);
+        }
+        let shared = futex2_validate(uaddr, flags, val)?;
+        let timeout = futex2_timeout(args[4], args[5] as i32, frame.is_from_user())?;
+
+        Futex::futex_wait(
+            uaddr,
+            futex2_flags(shared),
+            val as u32,
+            timeout,
+            mask as u32,
+        )
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("uaddr", format!("{:#x}", args[0])),
+            FormattedSyscallParam::new("val", args[1].to_string()),
+            FormattedSyscallParam::new("mask", format!("{:#x}", args[2])),
+            FormattedSyscallParam::new("flags", format!("{:#x}", args[3] as u32)),
+            FormattedSyscallParam::new("timeout", format!("{:#x}", args[4])),
+            FormattedSyscallParam::new("clockid", (args[5] as i32).to_string()),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_FUTEX_WAIT, SysFutexWaitHandle);
+
+/// System call handler for the futex2 `futex_requeue` syscall
+pub struct SysFutexRequeueHandle;
+
+impl Syscall for SysFutexRequeueHandle {
+    fn num_args(&self) -> usize {
+        4
+    }
+
+    /// Handles the `futex_requeue` system call
+    ///
+    /// # Arguments
+    /// * `args` - Array containing:
+    ///   - args[0]: waiters - Pointer to two `struct futex_waitv`: source (with the expected value) and target
+    ///   - args[1]: flags - Must be 0
+    ///   - args[2]: nr_wake - Number of waiters to wake
+    ///   - args[3]: nr_requeue - Number of waiters to move to the target futex
+    ///
+    /// # Returns
+    /// * `Ok(usize)` - Number of woken plus requeued waiters
+    fn handle(&self, args: &[usize], frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        let waiters = args[0];
+        let flags = args[1] as u32;
+        let nr_wake = args[2] as i32;
+        let nr_requeue = args[3] as i32;
+
+        if flags != 0 || waiters == 0 {
+            return Err(SystemError::EINVAL);
+        }
+
+        let vs = read_waitv(waiters, 2, frame.is_from_user())?;
+        let from = waitv_entry(&vs[0])?;
+        let to = waitv_entry(&vs[1])?;
+        // 目前两个futex的共享属性必须相同
+        if from.shared != to.shared {
+            return Err(SystemError::EINVAL);
+        }
+
+        Futex::futex_requeue(
+            from.uaddr,
+            futex2_flags(from.shared),
+            to.uaddr,
+            nr_wake,
+            nr_requeue,
+            Some(from.val),
+            false,
+        )
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("waiters", format!("{:#x}", args[0])),
+            FormattedSyscallParam::new("flags", format!("{:#x}", args[1] as u32)),
+            FormattedSyscallParam::new("nr_wake", (args[2] as i32).to_string()),
+            FormattedSyscallParam::new("nr_requeue", (args[3] as i32).to_string()),
+        ]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_FUTEX_REQUEUE, SysFutexRequeueHandle);
@@ -0,0 +1,215 @@
+//! 休眠锁的按类争用统计（/proc/lock_stat）
+//!
+//! 与lockdep一样，以锁的初始化位置（`Mutex::new`/`RwSem::new`的调用处）作为锁的类别，
+//! 同一处代码创建出的所有锁实例共享一份统计。统计默认关闭，通过 /proc/sys/kernel/lock_stat
+//! 打开；关闭时加锁路径上只多一次relaxed读。
+
+use core::{
+    intrinsics::likely,
+    panic::Location,
+    ptr::null_mut,
+    sync::atomic::{AtomicBool, AtomicPtr, AtomicU64, Ordering},
+};
+
+use alloc::{boxed::Box, collections::BTreeMap, vec::Vec};
+
+use crate::{arch::CurrentTimeArch, libs::spinlock::SpinLock, time::TimeArch};
+
+static LOCK_STAT_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// 所有已经登记的锁类别，键为(初始化位置, 锁的种类)
+static LOCK_CLASSES: SpinLock<
+    BTreeMap<(&'static str, u32, u32, LockKind), &'static LockClassStats>,
+> = SpinLock::new(BTreeMap::new());
+
+#[inline(always)]
+pub fn lock_stat_enabled() -> bool {
+    LOCK_STAT_ENABLED.load(Ordering::Relaxed)
+}
+
+pub fn lock_stat_set_enabled(enabled: bool) {
+    LOCK_STAT_ENABLED.store(enabled, Ordering::Relaxed);
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+pub enum LockKind {
+    Mutex,
+    RwSem,
+}
+
+impl LockKind {
+    pub fn name(&self) -> &'static str {
+        match self {
+            LockKind::Mutex => "mutex",
+            LockKind::RwSem => "rwsem",
+        }
+    }
+}
+
+/// 一个锁类别的统计
+#[derive(Debug)]
+pub struct LockClassStats {
+    site: &'static Location<'static>,
+    kind: LockKind,
+    /// 加锁成功的次数
+    pub acquisitions: AtomicU64,
+    /// 没能在快速路径上拿到锁的次数
+    pub contended: AtomicU64,
+    /// 在乐观自旋中拿到锁的次数
+    pub spin_acquired: AtomicU64,
+    /// 进入等待队列之后拿到锁的次数
+    pub sleep_acquired: AtomicU64,
+    /// 乐观自旋花费的总时间（纳秒）
+    pub spin_ns: AtomicU64,
+    /// 在等待队列中花费的总时间（纳秒）
+    pub sleep_ns: AtomicU64,
+}
+
+impl LockClassStats {
+    pub fn site(&self) -> &'static Location<'static> {
+        self.site
+    }
+
+    pub fn kind(&self) -> LockKind {
+        self.kind
+    }
+
+    fn clear(&self) {
+        self.acquisitions.store(0, Ordering::Relaxed);
+        self.contended.store(0, Ordering::Relaxed);
+        self.spin_acquired.store(0, Ordering::Relaxed);
+        self.sleep_acquired.store(0, Ordering::Relaxed);
+        self.spin_ns.store(0, Ordering::Relaxed);
+        self.sleep_ns.store(0, Ordering::Relaxed);
+    }
+}
+
+/// 嵌在每个锁实例中的类别信息
+#[derive(Debug)]
+pub struct LockClass {
+    site: &'static Location<'static>,
+    kind: LockKind,
+    /// 第一次需要记录统计时才去登记，之后缓存在这里
+    stats: AtomicPtr<LockClassStats>,
+}
+
+impl LockClass {
+    pub const fn new(site: &'static Location<'static>, kind: LockKind) -> Self {
+        Self {
+            site,
+            kind,
+            stats: AtomicPtr::new(null_mut()),
+        }
+    }
+
+    #[inline(always)]
+    fn stats(&self) -> Option<&'static LockClassStats> {
+        if likely(!lock_stat_enabled()) {
+            return None;
+        }
+        let ptr = self.stats.load(Ordering::Acquire);
+        if likely(!ptr.is_null()) {
+            return Some(unsafe { &*ptr });
+        }
+        self.register()
+    }
+
+    #[cold]
+    fn register(&self) -> Option<&'static LockClassStats> {
+        // 登记时要分配内存，如果分配路径上又有锁走到这里，放弃这一次统计，避免自死锁
+        let mut classes = LOCK_CLASSES.try_lock().ok()?;
+        let key = (
+            self.site.file(),
+            self.site.line(),
+            self.site.column(),
+            self.kind,
+        );
+        let stats = *classes.entry(key).or_insert_with(|| {
+            Box::leak(Box::new(LockClassStats {
+                site: self.site,
+                kind: self.kind,
+                acquisitions: AtomicU64::new(0),
+                contended: AtomicU64::new(0),
+                spin_acquired: AtomicU64::new(0),
+                sleep_acquired: AtomicU64::new(0),
+                spin_ns: AtomicU64::new(0),
+                sleep_ns: AtomicU64::new(0),
+            }))
+        });
+        drop(classes);
+        self.stats.store(
+            stats as *const LockClassStats as *mut LockClassStats,
+            Ordering::Release,
+        );
+        Some(stats)
+    }
+
+    /// 在快速路径上拿到了锁
+    #[inline(always)]
+    pub fn acquired(&self) {
+        if let Some(stats) = self.stats() {
+            stats.acquisitions.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// 快速路径失败，开始计时
+    #[inline]
+    pub fn contended(&self) -> Option<LockContention> {
+        let stats = self.stats()?;
+        stats.contended.fetch_add(1, Ordering::Relaxed);
+        Some(LockContention {
+            stats,
+            start: CurrentTimeArch::get_cycles(),
+        })
+    }
+}
+
+/// 一次争用的计时
+#[derive(Debug)]
+pub struct LockContention {
+    stats: &'static LockClassStats,
+    start: usize,
+}
+
+impl LockContention {
+    fn lap(&mut self) -> u64 {
+        let now = CurrentTimeArch::get_cycles();
+        let ns = CurrentTimeArch::cycles2ns(now.wrapping_sub(self.start)) as u64;
+        self.start = now;
+        ns
+    }
+
+    /// 乐观自旋结束
+    pub fn spin_end(&mut self, acquired: bool) {
+        let ns = self.lap();
+        self.stats.spin_ns.fetch_add(ns, Ordering::Relaxed);
+        if acquired {
+            self.stats.spin_acquired.fetch_add(1, Ordering::Relaxed);
+            self.stats.acquisitions.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// 在等待队列中的等待结束（`acquired`为false表示被信号打断）
+    pub fn sleep_end(mut self, acquired: bool) {
+        let ns = self.lap();
+        self.stats.sleep_ns.fetch_add(ns, Ordering::Relaxed);
+        if acquired {
+            self.stats.sleep_acquired.fetch_add(1, Ordering::Relaxed);
+            self.stats.acquisitions.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+}
+
+/// 获取所有锁类别的统计，按争用次数从多到少排列
+pub fn lock_stat_snapshot() -> Vec<&'static LockClassStats> {
+    let mut classes: Vec<&'static LockClassStats> = LOCK_CLASSES.lock().values().copied().collect();
+    classes.sort_by_key(|s| core::cmp::Reverse(s.contended.load(Ordering::Relaxed)));
+    classes
+}
+
+/// 清零所有统计
+pub fn lock_stat_clear() {
+    for stats in LOCK_CLASSES.lock().values() {
+        stats.clear();
+    }
+}
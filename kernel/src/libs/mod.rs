@@ -10,9 +10,11 @@ pub mod keyboard_parser;
 pub mod lazy_init;
 pub mod lib_ui;
 pub mod lock_free_flags;
+pub mod lock_stat;
 pub mod mutex;
 pub mod notifier;
 pub mod once;
+pub mod osq_lock;
 #[macro_use]
 pub mod printk;
 pub mod rbtree;
@@ -22,6 +24,7 @@ pub mod rwsem;
 pub mod semaphore;
 pub mod spinlock;
 pub mod vec_cursor;
+pub mod xarray;
 #[macro_use]
 pub mod volatile;
 pub mod futex;
@@ -1,21 +1,47 @@
 use core::{
     cell::UnsafeCell,
+    intrinsics::likely,
     ops::{Deref, DerefMut},
-    sync::atomic::{AtomicBool, Ordering},
+    panic::Location,
+    sync::atomic::{AtomicUsize, Ordering},
 };
 
 use system_error::SystemError;
 
-use crate::libs::wait_queue::WaitQueue;
+use crate::libs::{
+    lock_stat::{LockClass, LockKind},
+    osq_lock::{
+        optimistic_spin, LockOwner, OptimisticSpinQueue, SpinAttempt, SPIN_UNOWNED_UNBOUNDED,
+    },
+    wait_queue::WaitQueue,
+};
+
+/// 锁已被持有
+const MUTEX_LOCKED: usize = 1 << 0;
+/// 锁正在交给等待队列中的任务：快速路径、自旋者和try_lock都不能再抢锁
+const MUTEX_HANDOFF: usize = 1 << 1;
+
+/// wait_until在第一次睡眠之前会尝试加锁两次（入队前一次，入队后一次），之后的尝试都发生在被唤醒之后。
+/// 被唤醒后仍然没抢到锁的等待者设置MUTEX_HANDOFF，要求把锁交给等待队列
+const MUTEX_HANDOFF_ATTEMPTS: u32 = 2;
 
 /// @brief Mutex互斥量结构体
 /// 请注意！由于Mutex属于休眠锁，因此，如果您的代码可能在中断上下文内执行，请勿采用Mutex！
+///
+/// 锁被占用且持有者正在其他cpu上运行时，加锁者先乐观自旋（见[`super::osq_lock`]），
+/// 持有者睡眠或者自己需要重新调度时才进入等待队列。
 #[derive(Debug)]
 pub struct Mutex<T> {
     /// 该Mutex保护的数据
     data: UnsafeCell<T>,
-    /// Mutex锁状态
-    lock: AtomicBool,
+    /// Mutex锁状态（MUTEX_LOCKED | MUTEX_HANDOFF）
+    state: AtomicUsize,
+    /// 持有者，供乐观自旋判断持有者是否在运行
+    owner: LockOwner,
+    /// 乐观自旋者的排队锁
+    osq: OptimisticSpinQueue,
+    /// 锁类别（初始化位置），用于/proc/lock_stat
+    class: LockClass,
     /// 等待队列（Waiter/Waker 机制避免唤醒丢失）
     wait_queue: WaitQueue,
 }
@@ -32,11 +58,17 @@ unsafe impl<T: Sync> Sync for MutexGuard<'_, T> {}
 
 impl<T> Mutex<T> {
     /// @brief 初始化一个新的Mutex对象
+    ///
+    /// 调用处即为这把锁在/proc/lock_stat中的类别
     #[allow(dead_code)]
+    #[track_caller]
     pub const fn new(value: T) -> Self {
         return Self {
             data: UnsafeCell::new(value),
-            lock: AtomicBool::new(false),
+            state: AtomicUsize::new(0),
+            owner: LockOwner::new(),
+            osq: OptimisticSpinQueue::new(),
+            class: LockClass::new(Location::caller(), LockKind::Mutex),
             wait_queue: WaitQueue::default(),
         };
     }
@@ -46,7 +78,58 @@ impl<T> Mutex<T> {
     #[inline(always)]
     #[allow(dead_code)]
     pub fn lock(&self) -> MutexGuard<'_, T> {
-        self.wait_queue.wait_until(|| self.try_lock().ok())
+        if likely(self.acquire_lock()) {
+            self.owner.set_current();
+            self.class.acquired();
+            return MutexGuard { lock: self };
+        }
+        self.lock_slowpath()
+    }
+
+    #[inline(never)]
+    fn lock_slowpath(&self) -> MutexGuard<'_, T> {
+        let mut contention = self.class.contended();
+
+        let spun = optimistic_spin(&self.osq, &self.owner, SPIN_UNOWNED_UNBOUNDED, || {
+            if self.state.load(Ordering::Relaxed) & MUTEX_HANDOFF != 0 {
+                SpinAttempt::Stop
+            } else if self.acquire_lock() {
+                SpinAttempt::Acquired
+            } else {
+                SpinAttempt::Busy
+            }
+        });
+        if let Some(contention) = contention.as_mut() {
+            contention.spin_end(spun);
+        }
+        if spun {
+            self.owner.set_current();
+            return MutexGuard { lock: self };
+        }
+
+        let mut attempts = 0;
+        let guard = self.wait_queue.wait_until(|| {
+            attempts += 1;
+            // 还没睡过的任务和新来的加锁者一样，不能抢正在交接的锁
+            let woken = attempts > MUTEX_HANDOFF_ATTEMPTS;
+            let acquired = if woken {
+                self.acquire_lock_waiter()
+            } else {
+                self.acquire_lock()
+            };
+            if acquired {
+                return Some(MutexGuard { lock: self });
+            }
+            if woken {
+                self.state.fetch_or(MUTEX_HANDOFF, Ordering::Relaxed);
+            }
+            None
+        });
+        self.owner.set_current();
+        if let Some(contention) = contention {
+            contention.sleep_end(true);
+        }
+        guard
     }
 
     /// @brief 尝试对Mutex加锁。如果加锁失败，不会将当前进程加入等待队列。
@@ -56,6 +139,8 @@ impl<T> Mutex<T> {
     #[allow(dead_code)]
     pub fn try_lock(&self) -> Result<MutexGuard<'_, T>, SystemError> {
         if self.acquire_lock() {
+            self.owner.set_current();
+            self.class.acquired();
             return Ok(MutexGuard { lock: self });
         }
         Err(SystemError::EBUSY)
@@ -65,18 +150,40 @@ impl<T> Mutex<T> {
     ///
     /// 本函数只能是私有的，且只能被守卫的drop方法调用，否则将无法保证并发安全。
     fn unlock(&self) {
+        self.owner.clear();
         self.release_lock();
         self.wait_queue.wake_one();
     }
 
+    /// 快速路径、自旋者和try_lock加锁：锁正在交接给等待者时失败
     fn acquire_lock(&self) -> bool {
-        self.lock
-            .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+        self.state
+            .compare_exchange(0, MUTEX_LOCKED, Ordering::Acquire, Ordering::Relaxed)
             .is_ok()
     }
 
+    /// 等待队列中的任务加锁：不受MUTEX_HANDOFF限制，成功时清除MUTEX_HANDOFF
+    fn acquire_lock_waiter(&self) -> bool {
+        let mut state = self.state.load(Ordering::Relaxed);
+        loop {
+            if state & MUTEX_LOCKED != 0 {
+                return false;
+            }
+            match self.state.compare_exchange_weak(
+                state,
+                MUTEX_LOCKED,
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => return true,
+                Err(s) => state = s,
+            }
+        }
+    }
+
+    /// 只清除MUTEX_LOCKED，保留MUTEX_HANDOFF
     fn release_lock(&self) {
-        self.lock.store(false, Ordering::Release);
+        self.state.fetch_and(!MUTEX_LOCKED, Ordering::Release);
     }
 }
 
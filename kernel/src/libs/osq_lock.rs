@@ -0,0 +1,348 @@
+//! 休眠锁的乐观自旋（optimistic spinning）
+//!
+//! 休眠锁被占用时，如果持有者正在另一个cpu上运行，它很可能马上就会放锁，此时原地自旋等待
+//! 比进入等待队列、经历两次上下文切换要便宜得多。这里提供[`Mutex`](super::mutex::Mutex)与
+//! [`RwSem`](super::rwsem::RwSem)共用的三个部件（对标Linux kernel/locking/osq_lock.c、mutex.c）：
+//!
+//! - [`OptimisticSpinQueue`]：MCS排队锁。同一时刻只有队首的一个cpu在锁字上自旋，
+//!   其余自旋者各自在本cpu的节点上等待，避免一群cpu反复争抢同一条cache line；
+//! - [`LockOwner`]：记录持有者加锁时所在的cpu与该cpu的任务切换次数，
+//!   自旋者据此判断持有者是否仍在运行，而不需要访问（可能已经释放的）持有者pcb；
+//! - [`optimistic_spin`]：自旋的主循环。持有者睡眠、当前任务需要重新调度时立即放弃，
+//!   由调用者转入等待队列。
+
+use core::{
+    hint::spin_loop,
+    intrinsics::unlikely,
+    sync::atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering},
+};
+
+use crate::{
+    arch::CurrentTimeArch,
+    mm::percpu::PerCpu,
+    process::{preempt::PreemptGuard, ProcessControlBlock, ProcessFlags, ProcessManager},
+    sched::cpu_switch_seq,
+    smp::{core::smp_get_processor_id, cpu::ProcessorId},
+    time::TimeArch,
+};
+
+/// 队列为空
+const OSQ_UNLOCKED: u32 = 0;
+
+/// 每个cpu在MCS队列中的节点
+///
+/// 自旋期间抢占是关闭的，且休眠锁不会在中断上下文中使用，因此一个cpu同一时刻最多只在一个队列中排队
+#[derive(Debug)]
+struct OsqNode {
+    /// 后继节点的编码（cpu号+1），0表示没有
+    next: AtomicU32,
+    /// 前驱节点的编码
+    prev: AtomicU32,
+    /// 前驱放锁时把它置为true
+    locked: AtomicBool,
+}
+
+static OSQ_NODES: [OsqNode; PerCpu::MAX_CPU_NUM as usize] = [const {
+    OsqNode {
+        next: AtomicU32::new(0),
+        prev: AtomicU32::new(0),
+        locked: AtomicBool::new(false),
+    }
+}; PerCpu::MAX_CPU_NUM as usize];
+
+#[inline(always)]
+fn encode_cpu(cpu: ProcessorId) -> u32 {
+    cpu.data() + 1
+}
+
+#[inline(always)]
+fn decode_cpu(val: u32) -> &'static OsqNode {
+    &OSQ_NODES[(val - 1) as usize]
+}
+
+#[inline(always)]
+fn need_resched(pcb: &ProcessControlBlock) -> bool {
+    pcb.flags().contains(ProcessFlags::NEED_SCHEDULE)
+}
+
+/// 乐观自旋者的MCS排队锁
+///
+/// 与普通MCS锁不同，排队中的自旋者需要重新调度时可以中途退出队列（见[`Self::lock`]）。
+#[derive(Debug, Default)]
+pub struct OptimisticSpinQueue {
+    /// 队尾节点的编码（cpu号+1），0表示队列为空
+    tail: AtomicU32,
+}
+
+impl OptimisticSpinQueue {
+    pub const fn new() -> Self {
+        Self {
+            tail: AtomicU32::new(OSQ_UNLOCKED),
+        }
+    }
+
+    /// 排队成为唯一的自旋者
+    ///
+    /// 调用者必须已经关闭抢占，并在返回true之后调用[`Self::unlock`]。
+    ///
+    /// ## 返回值
+    ///
+    /// - true：轮到当前cpu自旋
+    /// - false：排队期间需要重新调度，已经退出队列
+    fn lock(&self, pcb: &ProcessControlBlock) -> bool {
+        let curr = encode_cpu(smp_get_processor_id());
+        let node = decode_cpu(curr);
+        node.locked.store(false, Ordering::Relaxed);
+        node.next.store(0, Ordering::Relaxed);
+
+        let old = self.tail.swap(curr, Ordering::AcqRel);
+        if old == OSQ_UNLOCKED {
+            return true;
+        }
+
+        let mut prev = old;
+        node.prev.store(prev, Ordering::Relaxed);
+        decode_cpu(prev).next.store(curr, Ordering::Release);
+
+        loop {
+            if node.locked.load(Ordering::Acquire) {
+                return true;
+            }
+            if unlikely(need_resched(pcb)) {
+                break;
+            }
+            spin_loop();
+        }
+
+        // 退出队列分三步，与Linux osq_lock()相同：
+        // A: 断开前驱指向自己的next
+        loop {
+            let prev_node = decode_cpu(prev);
+            if prev_node.next.load(Ordering::Relaxed) == curr
+                && prev_node
+                    .next
+                    .compare_exchange(curr, 0, Ordering::AcqRel, Ordering::Relaxed)
+                    .is_ok()
+            {
+                break;
+            }
+            // 前驱正在把锁交给自己
+            if node.locked.load(Ordering::Acquire) {
+                return true;
+            }
+            spin_loop();
+            // 前驱可能也在退出队列，重新读取
+            prev = node.prev.load(Ordering::Relaxed);
+        }
+
+        // B: 稳定住自己的后继（或者把队尾改回前驱）
+        let next = self.wait_next(node, curr, prev);
+        if next == 0 {
+            return false;
+        }
+
+        // C: 把前驱和后继接起来
+        decode_cpu(next).prev.store(prev, Ordering::Relaxed);
+        decode_cpu(prev).next.store(next, Ordering::Relaxed);
+        false
+    }
+
+    /// 等待节点的后继入队完成并摘下它；如果自己是队尾，则把队尾改为`prev`并返回0
+    fn wait_next(&self, node: &OsqNode, curr: u32, prev: u32) -> u32 {
+        loop {
+            if self.tail.load(Ordering::Relaxed) == curr
+                && self
+                    .tail
+                    .compare_exchange(curr, prev, Ordering::AcqRel, Ordering::Relaxed)
+                    .is_ok()
+            {
+                return 0;
+            }
+
+            // 必须用swap摘下next，否则后继在退出队列时会认为自己的前驱仍然有效
+            if node.next.load(Ordering::Relaxed) != 0 {
+                let next = node.next.swap(0, Ordering::AcqRel);
+                if next != 0 {
+                    return next;
+                }
+            }
+            spin_loop();
+        }
+    }
+
+    /// 把自旋的资格交给队列中的下一个cpu
+    fn unlock(&self) {
+        let curr = encode_cpu(smp_get_processor_id());
+        if self
+            .tail
+            .compare_exchange(curr, OSQ_UNLOCKED, Ordering::Release, Ordering::Relaxed)
+            .is_ok()
+        {
+            return;
+        }
+
+        let node = decode_cpu(curr);
+        let mut next = node.next.swap(0, Ordering::AcqRel);
+        if next == 0 {
+            next = self.wait_next(node, curr, OSQ_UNLOCKED);
+        }
+        if next != 0 {
+            decode_cpu(next).locked.store(true, Ordering::Release);
+        }
+    }
+}
+
+/// 休眠锁的持有者
+///
+/// 编码为`(切换次数 << 16) | (cpu号 + 1)`，0表示未知（未加锁，或者持有者是读者）。
+#[derive(Debug, Default)]
+pub struct LockOwner(AtomicU64);
+
+const OWNER_CPU_MASK: u64 = 0xffff;
+const OWNER_SEQ_SHIFT: u32 = 16;
+
+impl LockOwner {
+    pub const fn new() -> Self {
+        Self(AtomicU64::new(0))
+    }
+
+    /// 把当前任务记录为持有者，获得锁之后调用
+    ///
+    /// 不关抢占：如果读cpu号与切换次数之间发生了迁移，记录下来的切换次数会在那个cpu
+    /// 下一次切换时失效，自旋者最多多等一个调度周期。
+    #[inline]
+    pub fn set_current(&self) {
+        if unlikely(!ProcessManager::initialized()) {
+            return;
+        }
+        let Some(cpu) = ProcessManager::current_pcb().sched_info().on_cpu() else {
+            return;
+        };
+        let seq = cpu_switch_seq(cpu);
+        self.0.store(
+            (seq << OWNER_SEQ_SHIFT) | encode_cpu(cpu) as u64,
+            Ordering::Relaxed,
+        );
+    }
+
+    /// 放锁之前调用
+    #[inline]
+    pub fn clear(&self) {
+        self.0.store(0, Ordering::Relaxed);
+    }
+
+    /// 持有者是否正在`self_cpu`以外的cpu上运行
+    #[inline]
+    fn running(owner: u64, self_cpu: u32) -> bool {
+        let cpu = (owner & OWNER_CPU_MASK) as u32;
+        if cpu == self_cpu {
+            return false;
+        }
+        let seq = cpu_switch_seq(ProcessorId::new(cpu - 1));
+        (seq << OWNER_SEQ_SHIFT) >> OWNER_SEQ_SHIFT == owner >> OWNER_SEQ_SHIFT
+    }
+
+    /// 在持有者不变且仍在运行时自旋
+    ///
+    /// ## 返回值
+    ///
+    /// - true：持有者变了（通常是放锁了），值得再试一次
+    /// - false：持有者已经不在运行，或者当前任务需要重新调度
+    fn spin_on_owner(&self, owner: u64, self_cpu: u32, pcb: &ProcessControlBlock) -> bool {
+        while self.0.load(Ordering::Relaxed) == owner {
+            if !Self::running(owner, self_cpu) || unlikely(need_resched(pcb)) {
+                return false;
+            }
+            spin_loop();
+        }
+        true
+    }
+}
+
+/// 自旋过程中的一次加锁尝试的结果
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SpinAttempt {
+    /// 获得了锁
+    Acquired,
+    /// 锁仍被占用
+    Busy,
+    /// 不允许再自旋（例如锁正在交给等待队列中的任务）
+    Stop,
+}
+
+/// 持有者未知时一直自旋，直到需要重新调度
+pub const SPIN_UNOWNED_UNBOUNDED: u64 = u64::MAX;
+
+/// 乐观自旋等待锁
+///
+/// ## 参数
+///
+/// - `osq`：锁的自旋者队列
+/// - `owner`：锁的持有者
+/// - `unowned_budget_ns`：锁被占用但持有者未知（读者持有）时最多自旋的时间
+/// - `attempt`：尝试加锁
+///
+/// ## 返回值
+///
+/// 在自旋中获得了锁时返回true；返回false时调用者应当转入等待队列。
+pub fn optimistic_spin<F>(
+    osq: &OptimisticSpinQueue,
+    owner: &LockOwner,
+    unowned_budget_ns: u64,
+    mut attempt: F,
+) -> bool
+where
+    F: FnMut() -> SpinAttempt,
+{
+    if unlikely(!ProcessManager::initialized()) {
+        return false;
+    }
+
+    let _preempt = PreemptGuard::new();
+    let pcb = ProcessManager::current_pcb();
+    let self_cpu = encode_cpu(smp_get_processor_id());
+
+    // 持有者已经睡眠时，自旋没有意义（mutex_can_spin_on_owner）
+    let o = owner.0.load(Ordering::Relaxed);
+    if need_resched(&pcb) || (o != 0 && !LockOwner::running(o, self_cpu)) {
+        return false;
+    }
+
+    if !osq.lock(&pcb) {
+        return false;
+    }
+
+    let start = CurrentTimeArch::get_cycles();
+    let mut acquired = false;
+    loop {
+        match attempt() {
+            SpinAttempt::Acquired => {
+                acquired = true;
+                break;
+            }
+            SpinAttempt::Stop => break,
+            SpinAttempt::Busy => {}
+        }
+
+        let o = owner.0.load(Ordering::Relaxed);
+        if o != 0 {
+            if !owner.spin_on_owner(o, self_cpu, &pcb) {
+                break;
+            }
+        } else if unowned_budget_ns != SPIN_UNOWNED_UNBOUNDED
+            && CurrentTimeArch::cycles2ns(CurrentTimeArch::get_cycles().wrapping_sub(start)) as u64
+                > unowned_budget_ns
+        {
+            break;
+        }
+
+        // 持有者未知时（刚加锁还没来得及记录，或者是读者持有），只能靠need_resched限制自旋
+        if unlikely(need_resched(&pcb)) {
+            break;
+        }
+        spin_loop();
+    }
+
+    osq.unlock();
+    acquired
+}
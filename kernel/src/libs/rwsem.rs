@@ -6,6 +6,7 @@ use core::{
     cell::UnsafeCell,
     marker::PhantomData,
     ops::{Deref, DerefMut},
+    panic::Location,
     sync::atomic::{
         AtomicUsize,
         Ordering::{AcqRel, Acquire, Relaxed, Release},
@@ -17,7 +18,11 @@ use system_error::SystemError;
 
 use crate::process::ProcessManager;
 
-use super::wait_queue::{WaitQueue, Waiter};
+use super::{
+    lock_stat::{LockClass, LockContention, LockKind},
+    osq_lock::{optimistic_spin, LockOwner, OptimisticSpinQueue, SpinAttempt},
+    wait_queue::{WaitQueue, Waiter},
+};
 
 /// A mutex that provides data access to either one writer or many readers.
 ///
@@ -42,6 +47,14 @@ use super::wait_queue::{WaitQueue, Waiter};
 /// - **Bit 60:** Reader overflow detection (set when count reaches 2^60).
 /// - **Bits 59-0:** Reader mutex count.
 ///
+/// # Optimistic spinning
+///
+/// A writer that fails the fast path spins (see [`super::osq_lock`]) while the
+/// lock is held by a writer running on another CPU, or for a short, bounded
+/// time while it is held by readers. Spinning is only attempted while nobody
+/// sleeps on the semaphore, so the existing fairness towards queued waiters
+/// (and `writer_waiters` blocking new readers) is preserved.
+///
 /// # Safety
 ///
 /// Avoid using `RwSem` in an interrupt context, as it may result in sleeping
@@ -51,6 +64,11 @@ pub struct RwSem<T: ?Sized> {
     lock: AtomicUsize,
     waiters: AtomicUsize,
     writer_waiters: AtomicUsize,
+    /// The current writer, used by optimistic spinning.
+    owner: LockOwner,
+    osq: OptimisticSpinQueue,
+    /// Lock class (the construction site) for `/proc/lock_stat`.
+    class: LockClass,
     queue: WaitQueue,
     val: UnsafeCell<T>,
 }
@@ -61,6 +79,9 @@ const UPGRADEABLE_READER: usize = 1 << (usize::BITS - 2);
 const BEING_UPGRADED: usize = 1 << (usize::BITS - 3);
 const MAX_READER: usize = 1 << (usize::BITS - 4);
 
+/// Upper bound of spinning on a reader-owned semaphore, in nanoseconds.
+const READER_OWNED_SPIN_MAX_NS: u64 = 25_000;
+
 /// Read guard for [`RwSem`].
 #[derive(Debug)]
 pub struct RwSemReadGuard<'a, T: ?Sized + 'a> {
@@ -100,12 +121,18 @@ unsafe impl<T: ?Sized + Sync> Sync for RwSemUpgradeableGuard<'_, T> {}
 
 impl<T> RwSem<T> {
     /// Creates a new read-write semaphore with an initial value.
+    ///
+    /// The caller's location is the lock class reported in `/proc/lock_stat`.
+    #[track_caller]
     pub const fn new(val: T) -> Self {
         Self {
             val: UnsafeCell::new(val),
             lock: AtomicUsize::new(0),
             waiters: AtomicUsize::new(0),
             writer_waiters: AtomicUsize::new(0),
+            owner: LockOwner::new(),
+            osq: OptimisticSpinQueue::new(),
+            class: LockClass::new(Location::caller(), LockKind::RwSem),
             queue: WaitQueue::default(),
         }
     }
@@ -119,10 +146,11 @@ impl<T: ?Sized> RwSem<T> {
     #[track_caller]
     pub fn read(&self) -> RwSemReadGuard<'_, T> {
         if let Some(guard) = self.try_read() {
+            self.class.acquired();
             return guard;
         }
 
-        self.wait_read(false).unwrap()
+        self.wait_read(false, self.class.contended()).unwrap()
     }
 
     /// Acquires a write mutex and sleep until it can be acquired.
@@ -133,11 +161,16 @@ impl<T: ?Sized> RwSem<T> {
     pub fn write(&self) -> RwSemWriteGuard<'_, T> {
         if self.waiters.load(Acquire) == 0 || ProcessManager::current_pcb().preempt_count() != 0 {
             if let Some(guard) = self.try_write() {
+                self.class.acquired();
                 return guard;
             }
         }
 
-        self.wait_write(false).unwrap()
+        let mut contention = self.class.contended();
+        if let Some(guard) = self.write_spin(&mut contention) {
+            return guard;
+        }
+        self.wait_write(false, contention).unwrap()
     }
 
     /// Acquires a upread mutex and sleep until it can be acquired.
@@ -146,30 +179,73 @@ impl<T: ?Sized> RwSem<T> {
     #[track_caller]
     pub fn upread(&self) -> RwSemUpgradeableGuard<'_, T> {
         if let Some(guard) = self.try_upread() {
+            self.class.acquired();
             return guard;
         }
 
-        self.wait_upread(false).unwrap()
+        self.wait_upread(false, self.class.contended()).unwrap()
     }
 
     /// Blocking read acquire (interruptible).
     pub fn read_interruptible(&self) -> Result<RwSemReadGuard<'_, T>, SystemError> {
         if let Some(guard) = self.try_read() {
+            self.class.acquired();
             return Ok(guard);
         }
 
-        self.wait_read(true)
+        self.wait_read(true, self.class.contended())
     }
 
     /// Blocking write acquire (interruptible).
     pub fn write_interruptible(&self) -> Result<RwSemWriteGuard<'_, T>, SystemError> {
         if self.waiters.load(Acquire) == 0 || ProcessManager::current_pcb().preempt_count() != 0 {
             if let Some(guard) = self.try_write() {
+                self.class.acquired();
                 return Ok(guard);
             }
         }
 
-        self.wait_write(true)
+        let mut contention = self.class.contended();
+        if let Some(guard) = self.write_spin(&mut contention) {
+            return Ok(guard);
+        }
+        self.wait_write(true, contention)
+    }
+
+    /// Spins for the write lock while that is likely cheaper than sleeping.
+    ///
+    /// Gives up as soon as someone is queued on the semaphore, so a spinning
+    /// writer never steals the lock from a sleeping one.
+    fn write_spin(
+        &self,
+        contention: &mut Option<LockContention>,
+    ) -> Option<RwSemWriteGuard<'_, T>> {
+        if self.waiters.load(Acquire) != 0 {
+            return None;
+        }
+
+        // Like Linux's rwsem, a reader-owned semaphore is only spun on for a
+        // while that grows with the number of readers.
+        let readers = (self.lock.load(Relaxed) & (MAX_READER - 1)) as u64;
+        let budget = ((20 + readers) * 1000 / 2).min(READER_OWNED_SPIN_MAX_NS);
+
+        let mut guard = None;
+        let spun = optimistic_spin(&self.osq, &self.owner, budget, || {
+            if self.waiters.load(Relaxed) != 0 {
+                return SpinAttempt::Stop;
+            }
+            match self.try_write() {
+                Some(g) => {
+                    guard = Some(g);
+                    SpinAttempt::Acquired
+                }
+                None => SpinAttempt::Busy,
+            }
+        });
+        if let Some(contention) = contention.as_mut() {
+            contention.spin_end(spun);
+        }
+        guard
     }
 
     /// Attempts to acquire a read lock.
@@ -208,6 +284,7 @@ impl<T: ?Sized> RwSem<T> {
             .compare_exchange(0, WRITER, Acquire, Relaxed)
             .is_ok()
         {
+            self.owner.set_current();
             Some(RwSemWriteGuard {
                 inner: self,
                 _nosend: PhantomData,
@@ -247,7 +324,19 @@ impl<T: ?Sized> RwSem<T> {
         self.val.get_mut()
     }
 
-    fn wait_read(&self, interruptible: bool) -> Result<RwSemReadGuard<'_, T>, SystemError> {
+    fn wait_read(
+        &self,
+        interruptible: bool,
+        contention: Option<LockContention>,
+    ) -> Result<RwSemReadGuard<'_, T>, SystemError> {
+        let result = self.do_wait_read(interruptible);
+        if let Some(contention) = contention {
+            contention.sleep_end(result.is_ok());
+        }
+        result
+    }
+
+    fn do_wait_read(&self, interruptible: bool) -> Result<RwSemReadGuard<'_, T>, SystemError> {
         self.waiters.fetch_add(1, AcqRel);
         let (waiter, waker) = Waiter::new_pair();
 
@@ -271,7 +360,19 @@ impl<T: ?Sized> RwSem<T> {
         }
     }
 
-    fn wait_write(&self, interruptible: bool) -> Result<RwSemWriteGuard<'_, T>, SystemError> {
+    fn wait_write(
+        &self,
+        interruptible: bool,
+        contention: Option<LockContention>,
+    ) -> Result<RwSemWriteGuard<'_, T>, SystemError> {
+        let result = self.do_wait_write(interruptible);
+        if let Some(contention) = contention {
+            contention.sleep_end(result.is_ok());
+        }
+        result
+    }
+
+    fn do_wait_write(&self, interruptible: bool) -> Result<RwSemWriteGuard<'_, T>, SystemError> {
         let writer_waiter = self.begin_writer_wait();
         self.waiters.fetch_add(1, AcqRel);
         let (waiter, waker) = Waiter::new_pair();
@@ -314,6 +415,18 @@ impl<T: ?Sized> RwSem<T> {
     fn wait_upread(
         &self,
         interruptible: bool,
+        contention: Option<LockContention>,
+    ) -> Result<RwSemUpgradeableGuard<'_, T>, SystemError> {
+        let result = self.do_wait_upread(interruptible);
+        if let Some(contention) = contention {
+            contention.sleep_end(result.is_ok());
+        }
+        result
+    }
+
+    fn do_wait_upread(
+        &self,
+        interruptible: bool,
     ) -> Result<RwSemUpgradeableGuard<'_, T>, SystemError> {
         self.waiters.fetch_add(1, AcqRel);
         let (waiter, waker) = Waiter::new_pair();
@@ -391,6 +504,7 @@ impl<'a, T> RwSemWriteGuard<'a, T> {
     /// downgrade process.
     fn try_downgrade(self) -> Result<RwSemUpgradeableGuard<'a, T>, Self> {
         let inner = self.inner;
+        inner.owner.clear();
         let res = self
             .inner
             .lock
@@ -404,6 +518,7 @@ impl<'a, T> RwSemWriteGuard<'a, T> {
                 _nosend: PhantomData,
             })
         } else {
+            inner.owner.set_current();
             Err(self)
         }
     }
@@ -411,6 +526,7 @@ impl<'a, T> RwSemWriteGuard<'a, T> {
 
 impl<T: ?Sized> Drop for RwSemWriteGuard<'_, T> {
     fn drop(&mut self) {
+        self.inner.owner.clear();
         self.inner.lock.fetch_and(!WRITER, Release);
 
         // When the current writer releases, wake up all the sleeping threads.
@@ -459,6 +575,7 @@ impl<'a, T> RwSemUpgradeableGuard<'a, T> {
         );
         if res.is_ok() {
             let inner = self.inner;
+            inner.owner.set_current();
             // Drop the upgradeable guard to clear the UPGRADEABLE_READER bit,
             // matching the asterinas semantics and avoiding a phantom upreader.
             core::mem::drop(self);
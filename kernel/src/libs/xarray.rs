@@ -0,0 +1,537 @@
+//! 支持RCU无锁查找的基数树（XArray）
+//!
+//! 以`usize`为索引保存`Arc<T>`。树的每个节点有64个槽位，叶子节点（`shift == 0`）
+//! 的槽位保存值，内部节点的槽位保存子节点，因此槽位中的指针不需要额外的类型标记。
+//!
+//! - 查找（`load`/`get_mark`）只进入RCU读临界区，不获取任何锁；
+//! - 修改（`store`/`erase`/`set_mark`/`clear_mark`）由内部的`xa_lock`串行化，
+//!   被替换或删除的值和节点在宽限期结束后才释放；
+//! - 每个条目可以带最多`XA_MAX_MARKS`个标记。内部节点的标记位表示对应子树中
+//!   存在带该标记的条目，按标记遍历时可以整棵跳过没有标记的子树。
+//!
+//! 与Linux的XArray相比，这里没有多索引条目、值条目和预留条目。
+
+use alloc::{boxed::Box, sync::Arc, vec::Vec};
+use core::{
+    marker::PhantomData,
+    ptr,
+    sync::atomic::{AtomicPtr, AtomicU64, AtomicU8, AtomicUsize, Ordering},
+};
+
+use crate::{
+    libs::spinlock::SpinLock,
+    rcu::{rcu_assign_pointer, rcu_defer, rcu_defer_drop, rcu_dereference, rcu_read_lock},
+};
+
+const XA_CHUNK_SHIFT: usize = 6;
+const XA_CHUNK_SIZE: usize = 1 << XA_CHUNK_SHIFT;
+const XA_CHUNK_MASK: usize = XA_CHUNK_SIZE - 1;
+/// 每个条目最多可以带的标记数
+pub const XA_MAX_MARKS: usize = 3;
+
+/// 条目标记
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct XaMark(u8);
+
+pub const XA_MARK_0: XaMark = XaMark(0);
+pub const XA_MARK_1: XaMark = XaMark(1);
+pub const XA_MARK_2: XaMark = XaMark(2);
+
+struct XaNode<T> {
+    /// 本节点一个槽位覆盖的索引位数
+    shift: u8,
+    /// 在父节点中的槽位号
+    offset: AtomicU8,
+    /// 非空槽位的个数
+    count: AtomicU8,
+    parent: AtomicPtr<XaNode<T>>,
+    slots: [AtomicPtr<()>; XA_CHUNK_SIZE],
+    marks: [AtomicU64; XA_MAX_MARKS],
+}
+
+impl<T> XaNode<T> {
+    fn alloc(shift: usize, parent: *mut XaNode<T>, offset: usize) -> *mut XaNode<T> {
+        Box::into_raw(Box::new(Self {
+            shift: shift as u8,
+            offset: AtomicU8::new(offset as u8),
+            count: AtomicU8::new(0),
+            parent: AtomicPtr::new(parent),
+            slots: [const { AtomicPtr::new(ptr::null_mut()) }; XA_CHUNK_SIZE],
+            marks: [const { AtomicU64::new(0) }; XA_MAX_MARKS],
+        }))
+    }
+
+    #[inline(always)]
+    fn shift(&self) -> usize {
+        self.shift as usize
+    }
+
+    #[inline(always)]
+    fn is_leaf(&self) -> bool {
+        self.shift == 0
+    }
+
+    #[inline(always)]
+    fn slot_of(&self, index: usize) -> usize {
+        (index >> self.shift()) & XA_CHUNK_MASK
+    }
+
+    /// 以本节点为根时能容纳的最大索引
+    #[inline(always)]
+    fn max_index(&self) -> usize {
+        let bits = self.shift() + XA_CHUNK_SHIFT;
+        if bits >= usize::BITS as usize {
+            usize::MAX
+        } else {
+            (1 << bits) - 1
+        }
+    }
+
+    #[inline(always)]
+    fn marked(&self, mark: XaMark, slot: usize) -> bool {
+        self.marks[mark.0 as usize].load(Ordering::Relaxed) & (1 << slot) != 0
+    }
+
+    #[inline(always)]
+    fn any_marked(&self, mark: XaMark) -> bool {
+        self.marks[mark.0 as usize].load(Ordering::Relaxed) != 0
+    }
+}
+
+/// 把节点指针送到RCU回调中释放
+struct DeferredNode<T>(*mut XaNode<T>);
+
+// SAFETY: 节点已经从树中摘下，回调是它唯一的使用者
+unsafe impl<T> Send for DeferredNode<T> {}
+
+impl<T> DeferredNode<T> {
+    fn free(self) {
+        // SAFETY: 指针由`XaNode::alloc`创建，并且只被释放一次
+        drop(unsafe { Box::from_raw(self.0) });
+    }
+}
+
+pub struct XArray<T: Send + Sync + 'static> {
+    head: AtomicPtr<XaNode<T>>,
+    /// 串行化所有修改操作
+    xa_lock: SpinLock<()>,
+    len: AtomicUsize,
+    _marker: PhantomData<Arc<T>>,
+}
+
+// SAFETY: 树中只保存`Arc<T>`，读者通过RCU访问，修改由xa_lock串行化
+unsafe impl<T: Send + Sync + 'static> Send for XArray<T> {}
+unsafe impl<T: Send + Sync + 'static> Sync for XArray<T> {}
+
+impl<T: Send + Sync + 'static> core::fmt::Debug for XArray<T> {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("XArray").field("len", &self.len()).finish()
+    }
+}
+
+impl<T: Send + Sync + 'static> Default for XArray<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl<T: Send + Sync + 'static> XArray<T> {
+    pub const fn new() -> Self {
+        Self {
+            head: AtomicPtr::new(ptr::null_mut()),
+            xa_lock: SpinLock::new(()),
+            len: AtomicUsize::new(0),
+            _marker: PhantomData,
+        }
+    }
+
+    /// 条目个数
+    pub fn len(&self) -> usize {
+        self.len.load(Ordering::Relaxed)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 在RCU读临界区内找到`index`对应的叶子节点
+    ///
+    /// 返回的引用只在调用者的RCU读临界区内有效。
+    fn walk_rcu(&self, index: usize) -> Option<(&XaNode<T>, usize)> {
+        let mut node = rcu_dereference(&self.head);
+        if node.is_null() {
+            return None;
+        }
+        // SAFETY: 节点在宽限期结束之前不会被释放
+        let mut n = unsafe { &*node };
+        if index > n.max_index() {
+            return None;
+        }
+        loop {
+            let slot = n.slot_of(index);
+            if n.is_leaf() {
+                return Some((n, slot));
+            }
+            node = rcu_dereference(&n.slots[slot]) as *mut XaNode<T>;
+            if node.is_null() {
+                return None;
+            }
+            n = unsafe { &*node };
+        }
+    }
+
+    /// 无锁查找`index`处的条目
+    pub fn load(&self, index: usize) -> Option<Arc<T>> {
+        let _guard = rcu_read_lock();
+        let (leaf, slot) = self.walk_rcu(index)?;
+        let raw = rcu_dereference(&leaf.slots[slot]) as *const T;
+        if raw.is_null() {
+            return None;
+        }
+        // SAFETY: 槽位持有一个由Arc::into_raw得到的引用，
+        // 被删除后要等宽限期结束才释放，所以这里可以安全地增加引用计数
+        unsafe {
+            Arc::increment_strong_count(raw);
+            Some(Arc::from_raw(raw))
+        }
+    }
+
+    /// 无锁查询`index`处的条目是否带有`mark`标记
+    pub fn get_mark(&self, index: usize, mark: XaMark) -> bool {
+        let _guard = rcu_read_lock();
+        self.walk_rcu(index)
+            .is_some_and(|(leaf, slot)| leaf.marked(mark, slot))
+    }
+
+    /// 是否存在带有`mark`标记的条目
+    pub fn marked(&self, mark: XaMark) -> bool {
+        let _guard = rcu_read_lock();
+        let root = rcu_dereference(&self.head);
+        !root.is_null() && unsafe { &*root }.any_marked(mark)
+    }
+
+    /// 持有xa_lock时找到`index`对应的叶子节点和槽位
+    fn walk_locked(&self, index: usize) -> Option<(*mut XaNode<T>, usize)> {
+        let mut node = self.head.load(Ordering::Relaxed);
+        if node.is_null() || index > unsafe { &*node }.max_index() {
+            return None;
+        }
+        loop {
+            let n = unsafe { &*node };
+            let slot = n.slot_of(index);
+            if n.is_leaf() {
+                return Some((node, slot));
+            }
+            node = n.slots[slot].load(Ordering::Relaxed) as *mut XaNode<T>;
+            if node.is_null() {
+                return None;
+            }
+        }
+    }
+
+    /// 增加树的高度，直到根节点可以容纳`index`
+    fn expand(&self, index: usize) {
+        let mut root = self.head.load(Ordering::Relaxed);
+        if root.is_null() {
+            let mut shift = 0;
+            while shift + XA_CHUNK_SHIFT < usize::BITS as usize
+                && index >> (shift + XA_CHUNK_SHIFT) != 0
+            {
+                shift += XA_CHUNK_SHIFT;
+            }
+            rcu_assign_pointer(&self.head, XaNode::alloc(shift, ptr::null_mut(), 0));
+            return;
+        }
+        while index > unsafe { &*root }.max_index() {
+            let old = unsafe { &*root };
+            let new_root = XaNode::alloc(old.shift() + XA_CHUNK_SHIFT, ptr::null_mut(), 0);
+            let n = unsafe { &*new_root };
+            n.slots[0].store(root as *mut (), Ordering::Relaxed);
+            n.count.store(1, Ordering::Relaxed);
+            for mark in 0..XA_MAX_MARKS {
+                if old.any_marked(XaMark(mark as u8)) {
+                    n.marks[mark].store(1, Ordering::Relaxed);
+                }
+            }
+            old.parent.store(new_root, Ordering::Relaxed);
+            old.offset.store(0, Ordering::Relaxed);
+            rcu_assign_pointer(&self.head, new_root);
+            root = new_root;
+        }
+    }
+
+    /// 在`index`处保存`value`，返回被替换的旧条目
+    pub fn store(&self, index: usize, value: Arc<T>) -> Option<Arc<T>> {
+        let _lock = self.xa_lock.lock();
+        self.expand(index);
+
+        let mut node = self.head.load(Ordering::Relaxed);
+        loop {
+            let n = unsafe { &*node };
+            let slot = n.slot_of(index);
+            if n.is_leaf() {
+                let new_raw = Arc::into_raw(value) as *mut ();
+                // AcqRel交换同时起到rcu_assign_pointer的发布作用
+                let old = n.slots[slot].swap(new_raw, Ordering::AcqRel) as *const T;
+                if old.is_null() {
+                    n.count.fetch_add(1, Ordering::Relaxed);
+                    self.len.fetch_add(1, Ordering::Relaxed);
+                    return None;
+                }
+                // SAFETY: 旧指针是槽位持有的引用；读者可能还没来得及增加计数，
+                // 所以树持有的这个引用要在宽限期之后才释放
+                let old = unsafe { Arc::from_raw(old) };
+                rcu_defer_drop(old.clone());
+                return Some(old);
+            }
+            let mut child = n.slots[slot].load(Ordering::Relaxed) as *mut XaNode<T>;
+            if child.is_null() {
+                child = XaNode::alloc(n.shift() - XA_CHUNK_SHIFT, node, slot);
+                rcu_assign_pointer(&n.slots[slot], child as *mut ());
+                n.count.fetch_add(1, Ordering::Relaxed);
+            }
+            node = child;
+        }
+    }
+
+    /// 删除`index`处的条目并清除它的所有标记，返回被删除的条目
+    pub fn erase(&self, index: usize) -> Option<Arc<T>> {
+        let _lock = self.xa_lock.lock();
+        let (leaf, slot) = self.walk_locked(index)?;
+        let n = unsafe { &*leaf };
+        let old = n.slots[slot].swap(ptr::null_mut(), Ordering::AcqRel) as *const T;
+        if old.is_null() {
+            return None;
+        }
+        for mark in 0..XA_MAX_MARKS {
+            self.clear_mark_locked(leaf, slot, XaMark(mark as u8));
+        }
+        n.count.fetch_sub(1, Ordering::Relaxed);
+        self.len.fetch_sub(1, Ordering::Relaxed);
+        self.delete_empty_nodes(leaf);
+        self.shrink();
+
+        let old = unsafe { Arc::from_raw(old) };
+        rcu_defer_drop(old.clone());
+        Some(old)
+    }
+
+    /// 从`node`开始向上删除已经为空的节点
+    fn delete_empty_nodes(&self, mut node: *mut XaNode<T>) {
+        loop {
+            let n = unsafe { &*node };
+            if n.count.load(Ordering::Relaxed) != 0 {
+                return;
+            }
+            let parent = n.parent.load(Ordering::Relaxed);
+            if parent.is_null() {
+                rcu_assign_pointer(&self.head, ptr::null_mut());
+            } else {
+                let p = unsafe { &*parent };
+                let offset = n.offset.load(Ordering::Relaxed) as usize;
+                p.slots[offset].store(ptr::null_mut(), Ordering::Release);
+                p.count.fetch_sub(1, Ordering::Relaxed);
+            }
+            Self::free_node(node);
+            if parent.is_null() {
+                return;
+            }
+            node = parent;
+        }
+    }
+
+    /// 根节点只有第0个槽位时降低树的高度
+    fn shrink(&self) {
+        loop {
+            let root = self.head.load(Ordering::Relaxed);
+            if root.is_null() {
+                return;
+            }
+            let r = unsafe { &*root };
+            if r.is_leaf() || r.count.load(Ordering::Relaxed) != 1 {
+                return;
+            }
+            let child = r.slots[0].load(Ordering::Relaxed) as *mut XaNode<T>;
+            if child.is_null() {
+                return;
+            }
+            // 旧的根节点在宽限期内仍然指向child，正在遍历它的读者不受影响
+            unsafe { &*child }
+                .parent
+                .store(ptr::null_mut(), Ordering::Relaxed);
+            rcu_assign_pointer(&self.head, child);
+            Self::free_node(root);
+        }
+    }
+
+    fn free_node(node: *mut XaNode<T>) {
+        let deferred = DeferredNode(node);
+        rcu_defer(move || deferred.free());
+    }
+
+    /// 给`index`处的条目加上`mark`标记，条目不存在时什么也不做
+    pub fn set_mark(&self, index: usize, mark: XaMark) {
+        let _lock = self.xa_lock.lock();
+        let Some((leaf, slot)) = self.walk_locked(index) else {
+            return;
+        };
+        if unsafe { &*leaf }.slots[slot]
+            .load(Ordering::Relaxed)
+            .is_null()
+        {
+            return;
+        }
+        let (mut node, mut slot) = (leaf, slot);
+        loop {
+            let n = unsafe { &*node };
+            let bit = 1u64 << slot;
+            let old = n.marks[mark.0 as usize].fetch_or(bit, Ordering::Relaxed);
+            if old & bit != 0 {
+                return;
+            }
+            let parent = n.parent.load(Ordering::Relaxed);
+            if parent.is_null() {
+                return;
+            }
+            slot = n.offset.load(Ordering::Relaxed) as usize;
+            node = parent;
+        }
+    }
+
+    /// 清除`index`处条目的`mark`标记
+    pub fn clear_mark(&self, index: usize, mark: XaMark) {
+        let _lock = self.xa_lock.lock();
+        if let Some((leaf, slot)) = self.walk_locked(index) {
+            self.clear_mark_locked(leaf, slot, mark);
+        }
+    }
+
+    fn clear_mark_locked(&self, mut node: *mut XaNode<T>, mut slot: usize, mark: XaMark) {
+        loop {
+            let n = unsafe { &*node };
+            let bit = 1u64 << slot;
+            let old = n.marks[mark.0 as usize].fetch_and(!bit, Ordering::Relaxed);
+            // 本节点还有其他带标记的槽位时，父节点的标记位保持不变
+            if old & bit == 0 || old & !bit != 0 {
+                return;
+            }
+            let parent = n.parent.load(Ordering::Relaxed);
+            if parent.is_null() {
+                return;
+            }
+            slot = n.offset.load(Ordering::Relaxed) as usize;
+            node = parent;
+        }
+    }
+
+    /// 收集索引在`[start, end]`内的条目，按索引升序排列
+    ///
+    /// `mark`不为None时只收集带该标记的条目，没有该标记的子树会被整体跳过。
+    /// 最多收集`limit`个条目。
+    pub fn collect_range(
+        &self,
+        start: usize,
+        end: usize,
+        mark: Option<XaMark>,
+        limit: usize,
+    ) -> Vec<(usize, Arc<T>)> {
+        let mut out = Vec::new();
+        if start > end || limit == 0 {
+            return out;
+        }
+        let _lock = self.xa_lock.lock();
+        let root = self.head.load(Ordering::Relaxed);
+        if !root.is_null() {
+            Self::collect_node(root, 0, start, end, mark, limit, &mut out);
+        }
+        out
+    }
+
+    fn collect_node(
+        node: *mut XaNode<T>,
+        base: usize,
+        start: usize,
+        end: usize,
+        mark: Option<XaMark>,
+        limit: usize,
+        out: &mut Vec<(usize, Arc<T>)>,
+    ) {
+        let n = unsafe { &*node };
+        let shift = n.shift();
+        let span_max = base.saturating_add(n.max_index());
+        if start > span_max || end < base {
+            return;
+        }
+        let first = if start > base {
+            ((start - base) >> shift) & XA_CHUNK_MASK
+        } else {
+            0
+        };
+        let last = if end < span_max {
+            ((end - base) >> shift) & XA_CHUNK_MASK
+        } else {
+            XA_CHUNK_MASK
+        };
+        for slot in first..=last {
+            if out.len() >= limit {
+                return;
+            }
+            if mark.is_some_and(|m| !n.marked(m, slot)) {
+                continue;
+            }
+            let entry = n.slots[slot].load(Ordering::Relaxed);
+            if entry.is_null() {
+                continue;
+            }
+            let index = base + (slot << shift);
+            if n.is_leaf() {
+                let raw = entry as *const T;
+                // SAFETY: 持有xa_lock，槽位中的引用不会被并发释放
+                let value = unsafe {
+                    Arc::increment_strong_count(raw);
+                    Arc::from_raw(raw)
+                };
+                out.push((index, value));
+            } else {
+                Self::collect_node(entry as *mut XaNode<T>, index, start, end, mark, limit, out);
+            }
+        }
+    }
+
+    /// 给`[start, end]`内所有带`from`标记的条目加上`to`标记，返回处理的条目数
+    ///
+    /// 用于数据完整性回写：先把当时的脏页标记为待写，再只回写带待写标记的页面，
+    /// 回写期间新产生的脏页不会让回写无法结束。
+    pub fn tag_range(&self, start: usize, end: usize, from: XaMark, to: XaMark) -> usize {
+        let tagged = self.collect_range(start, end, Some(from), usize::MAX);
+        for (index, _) in tagged.iter() {
+            self.set_mark(*index, to);
+        }
+        tagged.len()
+    }
+}
+
+impl<T: Send + Sync + 'static> Drop for XArray<T> {
+    fn drop(&mut self) {
+        let root = *self.head.get_mut();
+        if root.is_null() {
+            return;
+        }
+        // 持有&mut self时不存在读者，直接释放所有节点和条目
+        fn free_subtree<T>(node: *mut XaNode<T>) {
+            let n = unsafe { Box::from_raw(node) };
+            for slot in n.slots.iter() {
+                let entry = slot.load(Ordering::Relaxed);
+                if entry.is_null() {
+                    continue;
+                }
+                if n.is_leaf() {
+                    drop(unsafe { Arc::from_raw(entry as *const T) });
+                } else {
+                    free_subtree(entry as *mut XaNode<T>);
+                }
+            }
+        }
+        free_subtree(root);
+    }
+}
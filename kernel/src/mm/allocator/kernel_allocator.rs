@@ -15,12 +15,12 @@ use core::{
 
 use super::{
     page_frame::{FrameAllocator, PageFrameCount},
-    slab::SLABALLOCATOR,
+    slab::{slab_cpu_cache_alloc, slab_cpu_cache_free, SLABALLOCATOR},
+    zeroed_pool::zeroed_pool_alloc_one,
 };
 
 /// 类kmalloc的分配器应当实现的trait
 pub trait LocalAlloc {
-    #[allow(dead_code)]
     unsafe fn local_alloc(&self, layout: Layout) -> *mut u8;
     unsafe fn local_alloc_zeroed(&self, layout: Layout) -> *mut u8;
     unsafe fn local_dealloc(&self, ptr: *mut u8, layout: Layout);
@@ -69,6 +69,9 @@ impl LocalAlloc for KernelAllocator {
                 .map(|x| x.as_mut_ptr())
                 .unwrap_or_default();
         } else {
+            if let Some(ptr) = slab_cpu_cache_alloc(layout) {
+                return ptr;
+            }
             let mut guard = SLABALLOCATOR.lock_irqsave();
             if let Some(ref mut slab) = *guard {
                 return slab.allocate(layout);
@@ -79,6 +82,13 @@ impl LocalAlloc for KernelAllocator {
 
     unsafe fn local_alloc_zeroed(&self, layout: Layout) -> *mut u8 {
         if allocator_select_condition(layout) {
+            // 单页请求优先使用kzerod预先清零的页面
+            if page_align_up(layout.size()) == MMArch::PAGE_SIZE {
+                if let Some(paddr) = zeroed_pool_alloc_one() {
+                    let vaddr = unsafe { MMArch::phys_2_virt(paddr).unwrap() };
+                    return vaddr.data() as *mut u8;
+                }
+            }
             return self
                 .alloc_in_buddy(layout)
                 .map(|x| {
@@ -88,16 +98,20 @@ impl LocalAlloc for KernelAllocator {
                 })
                 .unwrap_or_default();
         } else {
-            let mut guard = SLABALLOCATOR.lock_irqsave();
-            if let Some(ref mut slab) = *guard {
-                let ptr = slab.allocate(layout);
-                drop(guard);
-                if !ptr.is_null() {
-                    core::ptr::write_bytes(ptr, 0, layout.size());
+            let ptr = match slab_cpu_cache_alloc(layout) {
+                Some(ptr) => ptr,
+                None => {
+                    let mut guard = SLABALLOCATOR.lock_irqsave();
+                    match guard.as_mut() {
+                        Some(slab) => slab.allocate(layout),
+                        None => return core::ptr::null_mut(),
+                    }
                 }
-                return ptr;
+            };
+            if !ptr.is_null() {
+                core::ptr::write_bytes(ptr, 0, layout.size());
             }
-            return core::ptr::null_mut();
+            return ptr;
         }
     }
 
@@ -105,6 +119,9 @@ impl LocalAlloc for KernelAllocator {
         if allocator_select_condition(layout) {
             self.free_in_buddy(ptr, layout)
         } else {
+            if slab_cpu_cache_free(ptr, layout) {
+                return;
+            }
             let mut guard = SLABALLOCATOR.lock_irqsave();
             if let Some(ref mut slab) = *guard {
                 slab.deallocate(ptr, layout).unwrap()
@@ -116,7 +133,8 @@ impl LocalAlloc for KernelAllocator {
 /// 为内核slab分配器实现GlobalAlloc特性
 unsafe impl GlobalAlloc for KernelAllocator {
     unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
-        let r = self.local_alloc_zeroed(layout);
+        // 调用者会自行初始化整块内存，不需要清零
+        let r = self.local_alloc(layout);
         if allocator_select_condition(layout) {
             alloc_debug_log(klog_types::LogSource::Buddy, layout, r);
         } else {
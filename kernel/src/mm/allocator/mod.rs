@@ -2,4 +2,6 @@ pub mod buddy;
 pub mod bump;
 pub mod kernel_allocator;
 pub mod page_frame;
+pub mod pcp;
 pub mod slab;
+pub mod zeroed_pool;
@@ -0,0 +1,215 @@
+//! 每CPU页帧缓存（per-cpu pages）
+//!
+//! 小阶（order <= `PCP_MAX_ORDER`）的页帧分配/释放优先在本CPU的缓存中完成，
+//! 只有缓存为空或超过高水位时，才批量地从buddy补充/归还页帧，
+//! 从而避免每次缺页都去竞争全局的buddy锁。
+//!
+//! 每个阶的缓存是一个双端队列：队头是最近释放的（cache-hot）页帧，
+//! 分配从队头取；超过高水位时从队尾（cold）归还给buddy。
+//!
+//! 锁顺序：per-cpu缓存锁 -> buddy锁。
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use alloc::{collections::VecDeque, vec::Vec};
+
+use crate::{
+    arch::MMArch,
+    libs::{lazy_init::Lazy, spinlock::SpinLock},
+    mm::{
+        percpu::{PerCpu, PerCpuVar},
+        PhysAddr,
+    },
+    smp::cpu::ProcessorId,
+};
+
+use super::{
+    buddy::BuddyAllocator,
+    page_frame::{FrameAllocator, PageFrameCount, PageFrameUsage},
+};
+
+/// 由每CPU缓存处理的最大阶
+pub const PCP_MAX_ORDER: usize = 3;
+const PCP_ORDERS: usize = PCP_MAX_ORDER + 1;
+
+/// 各架构中被全局锁保护的buddy分配器
+pub type LockedBuddy = SpinLock<Option<BuddyAllocator<MMArch>>>;
+
+/// 每个阶的水位线
+#[derive(Debug, Clone, Copy)]
+struct PcpWatermark {
+    /// 缓存中的块数超过该值时，归还`batch`个最冷的块
+    high: usize,
+    /// 一次从buddy补充/向buddy归还的块数
+    batch: usize,
+}
+
+const PCP_WATERMARKS: [PcpWatermark; PCP_ORDERS] = [
+    PcpWatermark {
+        high: 192,
+        batch: 32,
+    },
+    PcpWatermark { high: 32, batch: 8 },
+    PcpWatermark { high: 16, batch: 4 },
+    PcpWatermark { high: 8, batch: 2 },
+];
+
+static PCP: Lazy<PerCpuVar<SpinLock<PerCpuPages>>> = PerCpuVar::define_lazy();
+
+/// 所有CPU缓存中的页帧总数（以页为单位）
+static PCP_CACHED_FRAMES: AtomicUsize = AtomicUsize::new(0);
+
+/// 一个CPU上各阶的页帧缓存
+struct PerCpuPages {
+    lists: [VecDeque<PhysAddr>; PCP_ORDERS],
+}
+
+impl PerCpuPages {
+    fn new() -> Self {
+        Self {
+            // 预留足够的容量，保证在分配器路径上push不会再次申请内存
+            lists: core::array::from_fn(|order| {
+                let wm = PCP_WATERMARKS[order];
+                VecDeque::with_capacity(wm.high + wm.batch)
+            }),
+        }
+    }
+
+    /// 从队尾归还最多`count`个最冷的块给buddy，返回归还的页数
+    unsafe fn drain(
+        &mut self,
+        buddy: &mut BuddyAllocator<MMArch>,
+        order: usize,
+        count: usize,
+    ) -> usize {
+        let block = PageFrameCount::new(1 << order);
+        let mut freed = 0;
+        for _ in 0..count {
+            let Some(paddr) = self.lists[order].pop_back() else {
+                break;
+            };
+            buddy.free(paddr, block);
+            freed += block.data();
+        }
+        PCP_CACHED_FRAMES.fetch_sub(freed, Ordering::Relaxed);
+        freed
+    }
+}
+
+/// 初始化每CPU页帧缓存，在此之前所有分配都直接走buddy
+pub fn pcp_init() {
+    let mut pcps = Vec::with_capacity(PerCpu::MAX_CPU_NUM as usize);
+    for _ in 0..PerCpu::MAX_CPU_NUM {
+        pcps.push(SpinLock::new(PerCpuPages::new()));
+    }
+    PCP.init(PerCpuVar::new(pcps).unwrap());
+}
+
+/// 判断`count`个页帧的请求能否由每CPU缓存处理，返回对应的阶
+#[inline]
+fn pcp_order(count: PageFrameCount) -> Option<usize> {
+    let count = count.data();
+    if !count.is_power_of_two() || count > (1 << PCP_MAX_ORDER) {
+        return None;
+    }
+    Some(count.trailing_zeros() as usize)
+}
+
+/// 从本CPU的缓存中分配页帧
+///
+/// 缓存为空时，批量从buddy补充`batch`个块。
+/// 返回None表示该请求应直接交给buddy处理。
+pub unsafe fn pcp_allocate(
+    buddy: &LockedBuddy,
+    count: PageFrameCount,
+) -> Option<(PhysAddr, PageFrameCount)> {
+    let order = pcp_order(count)?;
+    let mut pages = PCP.try_get()?.get().lock_irqsave();
+    let list = &mut pages.lists[order];
+
+    if list.is_empty() {
+        let wm = PCP_WATERMARKS[order];
+        let mut guard = buddy.lock_irqsave();
+        let allocator = guard.as_mut()?;
+        let mut refilled = 0;
+        while refilled < wm.batch && list.len() < list.capacity() {
+            match allocator.allocate(count) {
+                Some((paddr, _)) => list.push_back(paddr),
+                None => break,
+            }
+            refilled += 1;
+        }
+        drop(guard);
+        PCP_CACHED_FRAMES.fetch_add(refilled << order, Ordering::Relaxed);
+    }
+
+    let paddr = list.pop_front()?;
+    PCP_CACHED_FRAMES.fetch_sub(count.data(), Ordering::Relaxed);
+    Some((paddr, count))
+}
+
+/// 把页帧放回本CPU的缓存
+///
+/// 缓存超过高水位时，先把`batch`个最冷的块归还给buddy。
+/// 返回false表示页帧未被缓存，调用者需要直接释放给buddy。
+pub unsafe fn pcp_free(buddy: &LockedBuddy, address: PhysAddr, count: PageFrameCount) -> bool {
+    let Some(order) = pcp_order(count) else {
+        return false;
+    };
+    let Some(pcp) = PCP.try_get() else {
+        return false;
+    };
+    let mut pages = pcp.get().lock_irqsave();
+
+    let wm = PCP_WATERMARKS[order];
+    if pages.lists[order].len() >= wm.high {
+        let mut guard = buddy.lock_irqsave();
+        let Some(allocator) = guard.as_mut() else {
+            return false;
+        };
+        pages.drain(allocator, order, wm.batch);
+    }
+
+    let list = &mut pages.lists[order];
+    if list.len() >= list.capacity() {
+        return false;
+    }
+    list.push_front(address);
+    PCP_CACHED_FRAMES.fetch_add(count.data(), Ordering::Relaxed);
+    true
+}
+
+/// 把指定CPU缓存中的所有页帧归还给buddy（CPU下线时调用），返回归还的页数
+pub unsafe fn pcp_drain_cpu(buddy: &LockedBuddy, cpu: ProcessorId) -> usize {
+    let Some(pcp) = PCP.try_get() else {
+        return 0;
+    };
+    let mut pages = pcp.force_get(cpu).lock_irqsave();
+    let mut guard = buddy.lock_irqsave();
+    let Some(allocator) = guard.as_mut() else {
+        return 0;
+    };
+    let mut freed = 0;
+    for order in 0..PCP_ORDERS {
+        let len = pages.lists[order].len();
+        freed += pages.drain(allocator, order, len);
+    }
+    freed
+}
+
+/// 把所有CPU缓存中的页帧归还给buddy（内存紧张时调用），返回归还的页数
+pub unsafe fn pcp_drain_all(buddy: &LockedBuddy) -> usize {
+    if PCP_CACHED_FRAMES.load(Ordering::Relaxed) == 0 {
+        return 0;
+    }
+    (0..PerCpu::MAX_CPU_NUM)
+        .map(|cpu| pcp_drain_cpu(buddy, ProcessorId::new(cpu)))
+        .sum()
+}
+
+/// buddy统计的使用量中包含了缓存在各CPU上的页帧，把它们算作空闲页
+pub fn pcp_adjust_usage(usage: PageFrameUsage) -> PageFrameUsage {
+    let cached = PCP_CACHED_FRAMES.load(Ordering::Relaxed);
+    let used = PageFrameCount::new(usage.used().data().saturating_sub(cached));
+    PageFrameUsage::new(used, usage.total())
+}
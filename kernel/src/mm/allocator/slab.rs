@@ -1,15 +1,24 @@
-use core::{alloc::Layout, ptr::NonNull, sync::atomic::AtomicBool};
+use core::{
+    alloc::Layout,
+    ptr::NonNull,
+    sync::atomic::{AtomicBool, AtomicU64, Ordering},
+};
 
-use alloc::boxed::Box;
+use alloc::{boxed::Box, vec::Vec};
 use log::debug;
 use slabmalloc::*;
 
-use crate::libs::spinlock::SpinLock;
+use crate::libs::{lazy_init::Lazy, spinlock::SpinLock};
+use crate::mm::percpu::{PerCpu, PerCpuVar};
+use crate::smp::cpu::ProcessorId;
 use crate::{arch::MMArch, mm::MemoryManagementArch, KERNEL_ALLOCATOR};
 
 // 全局slab分配器
 pub(crate) static SLABALLOCATOR: SpinLock<Option<SlabAllocator>> = SpinLock::new(None);
 
+/// 每个CPU的slab对象缓存
+static SLAB_CPU_CACHES: Lazy<PerCpuVar<SlabCpuCache>> = PerCpuVar::define_lazy();
+
 // slab初始化状态
 pub(crate) static mut SLABINITSTATE: AtomicBool = AtomicBool::new(false);
 
@@ -35,15 +44,7 @@ impl SlabAllocator {
         match self.zone.allocate(layout) {
             Ok(nptr) => nptr.as_ptr(),
             Err(AllocationError::OutOfMemory) => {
-                let boxed_page = ObjectPage::new();
-                assert_eq!(
-                    (boxed_page.as_ref() as *const ObjectPage as usize) & (MMArch::PAGE_SIZE - 1),
-                    0
-                );
-                let leaked_page = Box::leak(boxed_page);
-                self.zone
-                    .refill(layout, leaked_page)
-                    .expect("Could not refill?");
+                self.refill_page(layout);
                 self.zone
                     .allocate(layout)
                     .expect("Should succeed after refill")
@@ -53,6 +54,36 @@ impl SlabAllocator {
         }
     }
 
+    /// 从buddy申请一个新的slab页，补充给`layout`对应的SCAllocator
+    unsafe fn refill_page(&mut self, layout: Layout) {
+        let boxed_page = ObjectPage::new();
+        assert_eq!(
+            (boxed_page.as_ref() as *const ObjectPage as usize) & (MMArch::PAGE_SIZE - 1),
+            0
+        );
+        let leaked_page = Box::leak(boxed_page);
+        self.zone
+            .refill(layout, leaked_page)
+            .expect("Could not refill?");
+    }
+
+    /// 从zone中批量取出第`idx`个大小类的对象，放入magazine
+    ///
+    /// zone中没有空闲对象时，会先补充一个新的slab页。返回放入的对象数量。
+    unsafe fn fill_magazine(&mut self, idx: usize, mag: &mut Magazine) -> usize {
+        let filled = self.zone.fill_magazine(idx, mag, MAGAZINE_BATCH);
+        if filled != 0 {
+            return filled;
+        }
+        self.refill_page(ZoneMagazines::class_layout(idx));
+        self.zone.fill_magazine(idx, mag, MAGAZINE_BATCH)
+    }
+
+    /// 把magazine中最多`count`个对象归还给zone
+    unsafe fn drain_magazine(&mut self, idx: usize, mag: &mut Magazine, count: usize) -> usize {
+        self.zone.drain_magazine(idx, mag, count, &SLAB_CALLBACK)
+    }
+
     /// 释放内存空间
     pub(crate) unsafe fn deallocate(
         &mut self,
@@ -75,6 +106,13 @@ pub unsafe fn slab_init() {
     debug!("trying to init a slab_allocator");
     *SLABALLOCATOR.lock_irqsave() = Some(SlabAllocator::new());
     SLABINITSTATE = true.into();
+
+    // 全局slab可用之后才能为per-cpu缓存本身分配内存
+    let mut caches = Vec::with_capacity(PerCpu::MAX_CPU_NUM as usize);
+    for _ in 0..PerCpu::MAX_CPU_NUM {
+        caches.push(SlabCpuCache::new());
+    }
+    SLAB_CPU_CACHES.init(PerCpuVar::new(caches).unwrap());
 }
 
 pub unsafe fn slab_usage() -> SlabUsage {
@@ -85,6 +123,136 @@ pub unsafe fn slab_usage() -> SlabUsage {
         .unwrap_or_else(|| SlabUsage::new(0, 0))
 }
 
+/// 每个CPU在全局slab分配器前面的对象缓存（magazine）
+///
+/// 快路径只用`try_lock`获取本CPU的锁，既不关中断也不会自旋等待。
+/// 如果获取失败（例如中断处理函数打断了本CPU上正在进行的分配），
+/// 就直接退回到全局的`SLABALLOCATOR`。
+/// 锁顺序：per-cpu缓存锁 -> `SLABALLOCATOR`。
+struct SlabCpuCache {
+    mags: SpinLock<ZoneMagazines>,
+    stat: SlabCpuStat,
+}
+
+impl SlabCpuCache {
+    fn new() -> Self {
+        Self {
+            mags: SpinLock::new(ZoneMagazines::new()),
+            stat: SlabCpuStat::default(),
+        }
+    }
+}
+
+/// per-cpu slab缓存的命中统计
+#[derive(Debug, Default)]
+pub struct SlabCpuStat {
+    /// 直接从magazine分配成功的次数
+    pub alloc_hit: AtomicU64,
+    /// magazine为空，需要从全局zone批量补充的次数
+    pub alloc_miss: AtomicU64,
+    /// 直接放回magazine的释放次数
+    pub free_hit: AtomicU64,
+    /// magazine已满，需要批量归还给全局zone的次数
+    pub free_miss: AtomicU64,
+    /// 本CPU的缓存被占用，退回全局slab的次数
+    pub bypass: AtomicU64,
+}
+
+impl SlabCpuStat {
+    #[inline]
+    fn inc(counter: &AtomicU64) {
+        counter.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+/// 尝试从本CPU的magazine中分配对象
+///
+/// 返回None表示该请求需要走全局slab分配器。
+pub(crate) unsafe fn slab_cpu_cache_alloc(layout: Layout) -> Option<*mut u8> {
+    let idx = ZoneMagazines::class_of(layout)?;
+    let cache = SLAB_CPU_CACHES.try_get()?.get();
+    let Ok(mut mags) = cache.mags.try_lock() else {
+        SlabCpuStat::inc(&cache.stat.bypass);
+        return None;
+    };
+
+    let ptr = match mags.pop(idx) {
+        Some(ptr) => {
+            SlabCpuStat::inc(&cache.stat.alloc_hit);
+            ptr
+        }
+        None => {
+            SlabCpuStat::inc(&cache.stat.alloc_miss);
+            let mut guard = SLABALLOCATOR.lock_irqsave();
+            let slab = guard.as_mut()?;
+            slab.fill_magazine(idx, mags.magazine_mut(idx));
+            drop(guard);
+            mags.pop(idx)?
+        }
+    };
+    Some(ptr.as_ptr())
+}
+
+/// 尝试把对象放回本CPU的magazine
+///
+/// 返回false表示对象未被缓存，调用者需要把它交还给全局slab分配器。
+pub(crate) unsafe fn slab_cpu_cache_free(ptr: *mut u8, layout: Layout) -> bool {
+    let Some(idx) = ZoneMagazines::class_of(layout) else {
+        return false;
+    };
+    let Some(nptr) = NonNull::new(ptr) else {
+        return false;
+    };
+    let Some(caches) = SLAB_CPU_CACHES.try_get() else {
+        return false;
+    };
+    let cache = caches.get();
+    let Ok(mut mags) = cache.mags.try_lock() else {
+        SlabCpuStat::inc(&cache.stat.bypass);
+        return false;
+    };
+
+    match mags.push(idx, nptr) {
+        Ok(()) => {
+            SlabCpuStat::inc(&cache.stat.free_hit);
+            true
+        }
+        Err(nptr) => {
+            SlabCpuStat::inc(&cache.stat.free_miss);
+            let mut guard = SLABALLOCATOR.lock_irqsave();
+            if let Some(slab) = guard.as_mut() {
+                slab.drain_magazine(idx, mags.magazine_mut(idx), MAGAZINE_BATCH);
+            }
+            drop(guard);
+            mags.push(idx, nptr).is_ok()
+        }
+    }
+}
+
+/// 把所有CPU的magazine中缓存的对象归还给全局slab分配器，
+/// 使其中空闲的slab页可以被回收（drop_caches等场景）
+pub fn slab_drain_cpu_caches() {
+    let Some(caches) = SLAB_CPU_CACHES.try_get() else {
+        return;
+    };
+    for cpu in 0..PerCpu::MAX_CPU_NUM {
+        let cache = unsafe { caches.force_get(ProcessorId::new(cpu)) };
+        let mut mags = cache.mags.lock();
+        let mut guard = SLABALLOCATOR.lock_irqsave();
+        if let Some(slab) = guard.as_mut() {
+            for idx in 0..ZoneAllocator::MAX_BASE_SIZE_CLASSES {
+                unsafe { slab.drain_magazine(idx, mags.magazine_mut(idx), MAGAZINE_CAPACITY) };
+            }
+        }
+    }
+}
+
+/// 获取指定CPU的slab缓存统计
+pub fn slab_cpu_stat(cpu: ProcessorId) -> Option<&'static SlabCpuStat> {
+    let caches = SLAB_CPU_CACHES.try_get()?;
+    Some(unsafe { &caches.force_get(cpu).stat })
+}
+
 /// 归还slab_page给buddy的回调
 pub struct SlabCallback;
 impl CallBack for SlabCallback {
@@ -0,0 +1,146 @@
+//! 预清零页面池
+//!
+//! `alloc_zeroed`申请单个页面时，优先从这里取出已经清零的页面，
+//! 避免在分配路径上做`write_bytes`。池子由`kzerod`内核线程在系统空闲时
+//! 从buddy中取页、清零后补充；内存紧张时由页面回收线程归还给buddy。
+
+use alloc::string::ToString;
+use log::info;
+use system_error::SystemError;
+use unified_init::macros::unified_init;
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    init::initcall::INITCALL_CORE,
+    libs::spinlock::SpinLock,
+    mm::{MemoryManagementArch, PhysAddr},
+    process::kthread::{KernelThreadClosure, KernelThreadMechanism},
+    sched::loadavg,
+    smp::cpu::smp_cpu_manager,
+    time::{sleep::nanosleep, PosixTimeSpec},
+};
+
+use super::page_frame::{FrameAllocator, PageFrameCount};
+
+/// 池中最多保存的清零页数量（2MB）
+const ZEROED_POOL_CAPACITY: usize = 512;
+/// kzerod每轮最多清零的页数，清零完一批后让出CPU
+const ZEROED_POOL_BATCH: usize = 32;
+/// 空闲页少于该值时，kzerod不再从buddy取页
+const ZEROED_POOL_MIN_FREE_PAGES: usize = 8192;
+
+static ZEROED_POOL: SpinLock<ZeroedPagePool> = SpinLock::new(ZeroedPagePool::new());
+
+/// 已清零的order-0页面栈
+///
+/// 使用定长数组保存，避免在内存分配路径上再次申请内存。
+struct ZeroedPagePool {
+    pages: [PhysAddr; ZEROED_POOL_CAPACITY],
+    len: usize,
+}
+
+impl ZeroedPagePool {
+    const fn new() -> Self {
+        Self {
+            pages: [PhysAddr::new(0); ZEROED_POOL_CAPACITY],
+            len: 0,
+        }
+    }
+
+    fn pop(&mut self) -> Option<PhysAddr> {
+        if self.len == 0 {
+            return None;
+        }
+        self.len -= 1;
+        Some(self.pages[self.len])
+    }
+
+    fn push(&mut self, paddr: PhysAddr) -> Result<(), PhysAddr> {
+        if self.len == ZEROED_POOL_CAPACITY {
+            return Err(paddr);
+        }
+        self.pages[self.len] = paddr;
+        self.len += 1;
+        Ok(())
+    }
+}
+
+/// 从池中取出一个已清零的物理页
+pub fn zeroed_pool_alloc_one() -> Option<PhysAddr> {
+    ZEROED_POOL.lock_irqsave().pop()
+}
+
+/// 当前池中的页面数量
+pub fn zeroed_pool_pages() -> usize {
+    ZEROED_POOL.lock_irqsave().len
+}
+
+/// 把池中所有页面归还给buddy，返回归还的页数
+pub fn zeroed_pool_drain() -> usize {
+    let mut drained = 0;
+    while let Some(paddr) = zeroed_pool_alloc_one() {
+        unsafe { LockedFrameAllocator.free_one(paddr) };
+        drained += 1;
+    }
+    drained
+}
+
+/// 系统中可运行的任务数不超过CPU数量时，认为有CPU是空闲的
+fn system_has_idle_cpu() -> bool {
+    loadavg::nr_running() <= smp_cpu_manager().present_cpus_count()
+}
+
+/// 清零一批页面放入池中，返回池是否已满
+fn zeroed_pool_fill_batch() -> bool {
+    let usage = unsafe { LockedFrameAllocator.usage() };
+    if usage.free().data() < ZEROED_POOL_MIN_FREE_PAGES + ZEROED_POOL_BATCH {
+        return true;
+    }
+
+    for _ in 0..ZEROED_POOL_BATCH {
+        if zeroed_pool_pages() >= ZEROED_POOL_CAPACITY {
+            return true;
+        }
+
+        let Some(paddr) = (unsafe { LockedFrameAllocator.allocate_one() }) else {
+            return true;
+        };
+        unsafe {
+            let vaddr = MMArch::phys_2_virt(paddr).unwrap();
+            MMArch::write_bytes(vaddr, 0, MMArch::PAGE_SIZE);
+        }
+        if let Err(paddr) = ZEROED_POOL.lock_irqsave().push(paddr) {
+            unsafe { LockedFrameAllocator.free(paddr, PageFrameCount::ONE) };
+            return true;
+        }
+    }
+    false
+}
+
+/// kzerod线程初始化函数
+#[unified_init(INITCALL_CORE)]
+fn kzerod_init() -> Result<(), SystemError> {
+    let closure = KernelThreadClosure::StaticEmptyClosure((&(kzerod_thread as fn() -> i32), ()));
+    KernelThreadMechanism::create_and_run(closure, "kzerod".to_string())
+        .ok_or("")
+        .expect("create kzerod thread failed");
+    info!("kzerod started");
+    Ok(())
+}
+
+/// kzerod线程：仅在有空闲CPU时分批清零页面
+fn kzerod_thread() -> i32 {
+    loop {
+        let sleep_ms = if !system_has_idle_cpu() {
+            100
+        } else if zeroed_pool_fill_batch() {
+            1000
+        } else {
+            10
+        };
+        let _ = nanosleep(PosixTimeSpec::new(
+            sleep_ms / 1000,
+            (sleep_ms % 1000) * 1_000_000,
+        ));
+    }
+}
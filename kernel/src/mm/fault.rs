@@ -6,12 +6,15 @@ use core::{
 };
 
 use alloc::sync::Arc;
+use system_error::SystemError;
 
 use crate::{
     arch::{mm::PageMapper, MMArch},
     libs::align::align_down,
     mm::{
-        page::{page_manager_lock, EntryFlags},
+        huge_memory,
+        page::{page_manager, EntryFlags},
+        swap::{self, swap_state, SwapEntry},
         ucontext::{AddressSpace, InnerAddressSpace, LockedVMA},
         VirtAddr, VmFaultReason, VmFlags,
     },
@@ -132,6 +135,13 @@ impl PageFaultHandler {
         }
     }
 
+    /// 建立私有匿名页（包括写时复制得到的页面）的反向映射，并使其可以被换出
+    fn attach_anon_page(page: &Arc<Page>, vma: &Arc<LockedVMA>, mlocked: bool, address: VirtAddr) {
+        Self::attach_fault_mapped_page(page, vma, mlocked);
+        page.write().set_anon_address(Some(address));
+        swap::lru_cache_add_anon(page);
+    }
+
     fn detach_fault_mapped_page(page: &Arc<Page>, vma: &Arc<LockedVMA>) {
         let mut page_guard = page.write();
         page_guard.remove_vma(vma.as_ref());
@@ -199,7 +209,10 @@ impl PageFaultHandler {
         let address = pfm.address_aligned_down();
         let vma = pfm.vma();
         let mm = pfm.mm().clone();
-        {
+        // 缺页路径只持有地址空间的读锁，页表只会在写锁下释放，因此可以无锁地遍历上层页表。
+        // PMD以上的页表很少需要分配，在整个地址空间的页表编辑锁下进行；
+        // PMD项及其指向的PTE页表由缺页地址所在区域的分裂PTE锁保护。
+        if pfm.mapper.get_entry(address, 3).is_none() {
             let _pt_edit = mm.page_table_edit();
             let mapper = &mut pfm.mapper;
             if mapper.get_entry(address, 3).is_none() {
@@ -209,12 +222,29 @@ impl PageFaultHandler {
             }
         }
         let page_flags = vma.lock().flags();
+        let write = pfm
+            .flags
+            .intersects(FaultFlags::FAULT_FLAG_WRITE | FaultFlags::FAULT_FLAG_UNSHARE);
 
         for level in 2..=3 {
             let level = MMArch::PAGE_LEVELS - level;
             {
-                let _pt_edit = mm.page_table_edit();
+                let (_pte, _pt_edit) = if level == 1 {
+                    (Some(mm.pte_lock(address)), None)
+                } else if pfm.mapper.get_entry(address, level).is_some() {
+                    continue;
+                } else {
+                    (None, Some(mm.page_table_edit()))
+                };
                 let mapper = &mut pfm.mapper;
+                if level == 1 {
+                    // PMD级：已有透明大页映射，或者可以直接建立透明大页映射
+                    if let Some(ret) =
+                        huge_memory::handle_huge_pmd_fault(mapper, &mm, &vma, address, write)
+                    {
+                        return ret;
+                    }
+                }
                 if mapper.get_entry(address, level).is_none() {
                     if vma.is_hugepage() {
                         if vma.is_anonymous() {
@@ -246,11 +276,14 @@ impl PageFaultHandler {
         // pte存在
         if let Some(mut entry) = pfm.mapper.get_entry(address, 0) {
             if !entry.present() {
-                ret = Self::do_swap_page(pfm);
-            }
-
-            if entry.protnone() && vma.is_accessible() {
-                ret = Self::do_numa_page(pfm);
+                // 非present的页表项：PROT_NONE映射或者交换页表项
+                ret = if entry.protnone() && vma.is_accessible() {
+                    Self::do_numa_page(pfm)
+                } else {
+                    Self::do_swap_page(pfm)
+                };
+                vma.lock().set_mapped(true);
+                return ret;
             }
 
             if flags.intersects(FaultFlags::FAULT_FLAG_WRITE | FaultFlags::FAULT_FLAG_UNSHARE) {
@@ -283,8 +316,12 @@ impl PageFaultHandler {
         let address = pfm.address_aligned_down();
         let vma = pfm.vma.clone();
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        let _pte = mm.pte_lock(address);
         let mapper = &mut pfm.mapper;
+        // 同一地址上的并发缺页已经由其他线程处理
+        if mapper.get_entry(address, 0).is_some() {
+            return VmFaultReason::VM_FAULT_COMPLETED;
+        }
 
         // If this is an anonymous shared mapping, use a shared backing so pages are visible across fork
         {
@@ -341,10 +378,8 @@ impl PageFaultHandler {
                 klog_types::LogSource::Buddy,
             );
             let paddr = mapper.translate(address).unwrap().0;
-            let mut page_manager_guard = page_manager_lock();
-            let page = page_manager_guard.get_unwrap(&paddr);
-            drop(page_manager_guard);
-            Self::attach_fault_mapped_page(&page, &vma, mlocked);
+            let page = page_manager().get_unwrap(&paddr);
+            Self::attach_anon_page(&page, &vma, mlocked, address);
             VmFaultReason::VM_FAULT_COMPLETED
         } else {
             VmFaultReason::VM_FAULT_OOM
@@ -398,7 +433,7 @@ impl PageFaultHandler {
         let cache_page = pfm.page.clone().unwrap();
         let mapper = &mut pfm.mapper;
 
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         if let Ok(page) =
             page_manager_guard.copy_page(&cache_page.phys_address(), mapper.allocator_mut())
         {
@@ -489,16 +524,27 @@ impl PageFaultHandler {
     ///
     /// ## 返回值
     /// - VmFaultReason: 页面错误处理信息标志
-    #[allow(unused_variables)]
     pub unsafe fn do_swap_page(pfm: &mut PageFaultMessage) -> VmFaultReason {
-        panic!(
-            "do_swap_page has not yet been implemented, 
-        fault message: {:?}, 
-        pid: {}\n",
-            pfm,
-            crate::process::ProcessManager::current_pid().data()
-        );
-        // TODO https://code.dragonos.org.cn/xref/linux-6.6.21/mm/memory.c#do_swap_page
+        let address = pfm.address_aligned_down();
+        let vma = pfm.vma.clone();
+        let mm = pfm.mm().clone();
+        let Some(entry) = pfm
+            .mapper
+            .get_entry(address, 0)
+            .and_then(|pte| SwapEntry::from_pte(&pte))
+        else {
+            return VmFaultReason::VM_FAULT_SIGBUS;
+        };
+
+        loop {
+            match swap_state::do_swap_in(pfm.mapper, &mm, &vma, address, entry) {
+                Ok(()) => return VmFaultReason::VM_FAULT_COMPLETED | VmFaultReason::VM_FAULT_MAJOR,
+                // 交换缓存中的页面在换入期间被回收，重新读入
+                Err(SystemError::EAGAIN) => continue,
+                Err(SystemError::ENOMEM) => return VmFaultReason::VM_FAULT_OOM,
+                Err(_) => return VmFaultReason::VM_FAULT_SIGBUS,
+            }
+        }
     }
 
     /// 处理NUMA的缺页异常
@@ -534,14 +580,17 @@ impl PageFaultHandler {
         let address = pfm.address_aligned_down();
         let vma = pfm.vma.clone();
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        let _pte = mm.pte_lock(address);
         let mapper = &mut pfm.mapper;
+        // 加锁前页表项可能已被其他线程升级为可写，或者被回收路径换出
+        match mapper.get_entry(address, 0) {
+            Some(entry) if entry.present() && !entry.write() => {}
+            _ => return VmFaultReason::VM_FAULT_COMPLETED,
+        }
 
         let old_paddr = mapper.translate(address).unwrap().0;
-        let mut page_manager = page_manager_lock();
-        let old_page = page_manager.get_unwrap(&old_paddr);
+        let old_page = page_manager().get_unwrap(&old_paddr);
         let map_count = old_page.read().map_count();
-        drop(page_manager);
 
         let mut entry = mapper.get_entry(address, 0).unwrap();
         let new_flags = entry.flags().set_write(true).set_dirty(true);
@@ -572,8 +621,9 @@ impl PageFaultHandler {
             mm.flush_tlb_range(address, end, MMArch::PAGE_SHIFT as u8, false);
             VmFaultReason::VM_FAULT_COMPLETED
         } else if vma.is_anonymous() {
-            // 私有匿名映射，根据引用计数判断是否拷贝页面
-            if map_count == 1 {
+            // 私有匿名映射，根据引用计数判断是否拷贝页面。
+            // 页面仍在交换缓存中、且槽位被fork出的其他交换页表项引用时，也必须拷贝
+            if map_count == 1 && swap_state::reuse_swap_page(&mut old_page.write()) {
                 // 只剩当前 mm 引用该页：直接原地升级为可写。
                 // 注意：这里 `map_count == 1` 仅代表“只有一个 VMA 在 rmap 链上映射到该物理页”，
                 // 不代表“只有一个 CPU 在运行这个 mm”，所以仍然需要 mm-aware shootdown。
@@ -586,7 +636,7 @@ impl PageFaultHandler {
                 VmFaultReason::VM_FAULT_COMPLETED
             } else {
                 let new_page = {
-                    let mut page_manager_guard = page_manager_lock();
+                    let page_manager_guard = page_manager();
                     match page_manager_guard.copy_page(&old_paddr, mapper.allocator_mut()) {
                         Ok(page) => page,
                         Err(_) => return VmFaultReason::VM_FAULT_OOM,
@@ -597,16 +647,17 @@ impl PageFaultHandler {
                 let table = mapper.get_table(address, 0).unwrap();
                 let i = table.index_of(address).unwrap();
 
-                // Copy before publishing the writable PTE. DragonOS does not yet
-                // hold a Linux-style per-PTE lock while every fault reader checks
-                // the PTE, so do not create a transient empty PTE here.
+                // Copy before publishing the writable PTE. Fault paths peek at the
+                // PTE before taking the PTE lock, so do not create a transient
+                // empty PTE here.
                 table.set_entry(i, super::page::PageEntry::new(new_paddr, new_flags));
                 mm.flush_tlb_range(address, end, MMArch::PAGE_SHIFT as u8, false);
 
-                Self::attach_fault_mapped_page(
+                Self::attach_anon_page(
                     &new_page,
                     &vma,
                     vma.lock().vm_flags().contains(VmFlags::VM_LOCKED),
+                    address,
                 );
                 Self::detach_fault_mapped_page(&old_page, &vma);
                 VmFaultReason::VM_FAULT_COMPLETED
@@ -614,7 +665,7 @@ impl PageFaultHandler {
         } else {
             // 私有文件映射，必须拷贝页面
             let new_page = {
-                let mut page_manager_guard = page_manager_lock();
+                let page_manager_guard = page_manager();
                 match page_manager_guard.copy_page(&old_paddr, mapper.allocator_mut()) {
                     Ok(page) => page,
                     Err(_) => return VmFaultReason::VM_FAULT_OOM,
@@ -627,10 +678,11 @@ impl PageFaultHandler {
             table.set_entry(i, super::page::PageEntry::new(new_paddr, new_flags));
             mm.flush_tlb_range(address, end, MMArch::PAGE_SHIFT as u8, false);
 
-            Self::attach_fault_mapped_page(
+            Self::attach_anon_page(
                 &new_page,
                 &vma,
                 vma.lock().vm_flags().contains(VmFlags::VM_LOCKED),
+                address,
             );
             Self::detach_fault_mapped_page(&old_page, &vma);
             VmFaultReason::VM_FAULT_COMPLETED
@@ -650,7 +702,7 @@ impl PageFaultHandler {
         let address = pfm.address();
         let mm = pfm.mm().clone();
         {
-            let _pt_edit = mm.page_table_edit();
+            let _pte = mm.pte_lock(address);
             let mapper = &mut pfm.mapper;
             if mapper.get_table(address, 0).is_none() {
                 mapper
@@ -695,7 +747,7 @@ impl PageFaultHandler {
 
         // 预先分配pte页表（如果不存在）
         {
-            let _pt_edit = mm.page_table_edit();
+            let _pte = mm.pte_lock(address);
             let mapper = &mut pfm.mapper;
             if mapper.get_table(address, 0).is_none() && mapper.allocate_table(address, 0).is_none()
             {
@@ -740,7 +792,8 @@ impl PageFaultHandler {
             }
         };
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        // 预映射的范围不会超出缺页地址所在的PTE页表
+        let _pte = mm.pte_lock(pfm.address());
         let mapper = &mut pfm.mapper;
         let mlocked = vma_guard.vm_flags().contains(VmFlags::VM_LOCKED);
 
@@ -879,12 +932,20 @@ impl PageFaultHandler {
         let cow_page = pfm.cow_page.clone();
         let address = pfm.address();
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        let _pte = mm.pte_lock(address);
         let mapper = &mut pfm.mapper;
 
-        let page_to_map = if flags.contains(FaultFlags::FAULT_FLAG_WRITE)
-            && !vma_guard.vm_flags().contains(VmFlags::VM_SHARED)
-        {
+        let is_cow = flags.contains(FaultFlags::FAULT_FLAG_WRITE)
+            && !vma_guard.vm_flags().contains(VmFlags::VM_SHARED);
+        // 缺页附近页预映射或者并发的缺页已经建立了映射
+        if mapper.get_entry(address, 0).is_some() {
+            if let Some(cow_page) = cow_page.filter(|_| is_cow) {
+                page_manager().remove_page(&cow_page.phys_address());
+                pfm.cow_page = None;
+            }
+            return VmFaultReason::VM_FAULT_COMPLETED;
+        }
+        let page_to_map = if is_cow {
             // 私有文件映射的写时复制
             cow_page.expect("no cow_page in PageFaultMessage")
         } else {
@@ -896,7 +957,12 @@ impl PageFaultHandler {
         let mlocked = vma_guard.vm_flags().contains(VmFlags::VM_LOCKED);
 
         mapper.map_phys(address, page_phys, vma_guard.flags());
-        Self::attach_fault_mapped_page(&page_to_map, &pfm.vma(), mlocked);
+        drop(vma_guard);
+        if is_cow {
+            Self::attach_anon_page(&page_to_map, &vma, mlocked, pfm.address_aligned_down());
+        } else {
+            Self::attach_fault_mapped_page(&page_to_map, &vma, mlocked);
+        }
         VmFaultReason::VM_FAULT_COMPLETED
     }
 
@@ -909,15 +975,16 @@ impl PageFaultHandler {
         let mlocked = guard.vm_flags().contains(VmFlags::VM_LOCKED);
         drop(guard);
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        let _pte = mm.pte_lock(address);
         let mapper = &mut pfm.mapper;
+        if mapper.get_entry(address, 0).is_some() {
+            return VmFaultReason::VM_FAULT_COMPLETED;
+        }
 
         if let Some(flush) = mapper.map(address, flags) {
             flush.flush();
-            let mut pm = page_manager_lock();
             let paddr = mapper.translate(address).unwrap().0;
-            let page = pm.get_unwrap(&paddr);
-            drop(pm);
+            let page = page_manager().get_unwrap(&paddr);
             Self::attach_fault_mapped_page(&page, &vma, mlocked);
             VmFaultReason::VM_FAULT_COMPLETED
         } else {
@@ -943,16 +1010,17 @@ impl PageFaultHandler {
         drop(vma_guard);
 
         let mm = pfm.mm().clone();
-        let _pt_edit = mm.page_table_edit();
+        let _pte = mm.pte_lock(pfm.address());
         let mapper = &mut pfm.mapper;
         for pgoff in start_pgoff..end_pgoff {
             let addr = VirtAddr::new(base.data() + ((pgoff - backing_pgoff) << MMArch::PAGE_SHIFT));
+            if mapper.get_entry(addr, 0).is_some() {
+                continue;
+            }
             if let Some(flush) = mapper.map(addr, flags) {
                 flush.flush();
-                let mut pm = page_manager_lock();
                 let paddr = mapper.translate(addr).unwrap().0;
-                let page = pm.get_unwrap(&paddr);
-                drop(pm);
+                let page = page_manager().get_unwrap(&paddr);
                 Self::attach_fault_mapped_page(&page, &vma, mlocked);
             } else {
                 return VmFaultReason::VM_FAULT_OOM;
@@ -0,0 +1,636 @@
+//! 匿名内存的透明大页（Transparent Huge Pages）
+//!
+//! 私有匿名映射缺页时，如果包含缺页地址的2MB对齐区间完全落在VMA内，
+//! 就直接分配一个2MB的物理块，用一个PMD级的大页表项映射，
+//! 省去512次4K缺页，同时减少TLB缺失。
+//!
+//! 大页中的每个4K子页仍然有自己的`Page`描述符和反向映射，因此需要只修改
+//! 大页中一部分的操作（部分munmap/mprotect/madvise、mremap、fork的写时复制），
+//! 只需先把大页表项拆分成指向同一物理块的512个PTE，再按4K页处理即可。
+//!
+//! `khugepaged`内核线程定期扫描登记过的地址空间，
+//! 把已经被4K页完整填满的2MB区间合并为大页。
+//!
+//! 目前只在x86_64上启用。
+
+use core::{
+    cmp::max,
+    sync::atomic::{AtomicU64, AtomicU8, AtomicUsize, Ordering},
+};
+
+use alloc::{
+    collections::BTreeMap,
+    string::{String, ToString},
+    sync::{Arc, Weak},
+    vec::Vec,
+};
+use log::info;
+use system_error::SystemError;
+use unified_init::macros::unified_init;
+
+use crate::{
+    arch::{
+        mm::{LockedFrameAllocator, PageMapper},
+        MMArch,
+    },
+    init::initcall::INITCALL_CORE,
+    libs::{
+        align::{align_down, align_up},
+        spinlock::SpinLock,
+    },
+    mm::{
+        allocator::page_frame::{FrameAllocator, PageFrameCount},
+        mmu_gather::MmuGather,
+        page::{
+            page_manager, EntryFlags, Page, PageEntry, PageFlags, PageFlush, PageTable, PageType,
+            PAGE_2M_SIZE,
+        },
+        ucontext::{AddressSpace, InnerAddressSpace, LockedVMA},
+        MemoryManagementArch, PhysAddr, VirtAddr, VirtRegion, VmFaultReason, VmFlags,
+    },
+    process::kthread::{KernelThreadClosure, KernelThreadMechanism},
+    time::{sleep::nanosleep, PosixTimeSpec},
+};
+
+/// PMD级大页的大小
+pub const HPAGE_PMD_SIZE: usize = PAGE_2M_SIZE;
+/// 一个PMD级大页包含的4K页数
+pub const HPAGE_PMD_NR: usize = HPAGE_PMD_SIZE / MMArch::PAGE_SIZE;
+
+/// khugepaged两轮扫描之间的间隔（毫秒）
+const KHUGEPAGED_SCAN_SLEEP_MS: i64 = 10000;
+/// khugepaged每轮最多扫描的4K页数
+const KHUGEPAGED_PAGES_TO_SCAN: usize = HPAGE_PMD_NR * 8;
+
+/// 透明大页的启用策略，对应`/sys/kernel/mm/transparent_hugepage/enabled`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum ThpMode {
+    /// 所有满足条件的私有匿名映射都使用大页
+    Always = 0,
+    /// 只有`madvise(MADV_HUGEPAGE)`过的区域使用大页
+    Madvise = 1,
+    /// 禁用透明大页
+    Never = 2,
+}
+
+impl ThpMode {
+    const ALL: [ThpMode; 3] = [ThpMode::Always, ThpMode::Madvise, ThpMode::Never];
+
+    fn name(&self) -> &'static str {
+        match self {
+            ThpMode::Always => "always",
+            ThpMode::Madvise => "madvise",
+            ThpMode::Never => "never",
+        }
+    }
+
+    pub fn parse(s: &str) -> Option<Self> {
+        Self::ALL.into_iter().find(|mode| mode.name() == s.trim())
+    }
+}
+
+static THP_MODE: AtomicU8 = AtomicU8::new(ThpMode::Always as u8);
+
+/// 当前映射为大页的匿名PMD数量
+static NR_ANON_THPS: AtomicUsize = AtomicUsize::new(0);
+static THP_FAULT_ALLOC: AtomicUsize = AtomicUsize::new(0);
+static THP_FAULT_FALLBACK: AtomicUsize = AtomicUsize::new(0);
+static THP_COLLAPSE_ALLOC: AtomicUsize = AtomicUsize::new(0);
+static THP_COLLAPSE_ALLOC_FAILED: AtomicUsize = AtomicUsize::new(0);
+static THP_SPLIT_PMD: AtomicUsize = AtomicUsize::new(0);
+
+/// 透明大页的统计信息，用于`/proc/vmstat`
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ThpStatsSnapshot {
+    pub nr_anon_thps: u64,
+    pub fault_alloc: u64,
+    pub fault_fallback: u64,
+    pub collapse_alloc: u64,
+    pub collapse_alloc_failed: u64,
+    pub split_pmd: u64,
+}
+
+pub fn thp_stats() -> ThpStatsSnapshot {
+    ThpStatsSnapshot {
+        nr_anon_thps: NR_ANON_THPS.load(Ordering::Relaxed) as u64,
+        fault_alloc: THP_FAULT_ALLOC.load(Ordering::Relaxed) as u64,
+        fault_fallback: THP_FAULT_FALLBACK.load(Ordering::Relaxed) as u64,
+        collapse_alloc: THP_COLLAPSE_ALLOC.load(Ordering::Relaxed) as u64,
+        collapse_alloc_failed: THP_COLLAPSE_ALLOC_FAILED.load(Ordering::Relaxed) as u64,
+        split_pmd: THP_SPLIT_PMD.load(Ordering::Relaxed) as u64,
+    }
+}
+
+pub fn thp_mode() -> ThpMode {
+    ThpMode::ALL[THP_MODE.load(Ordering::Relaxed) as usize]
+}
+
+pub fn set_thp_mode(mode: ThpMode) {
+    THP_MODE.store(mode as u8, Ordering::Relaxed);
+}
+
+/// 生成`enabled`文件的内容，当前策略用方括号标出，例如`[always] madvise never`
+pub fn thp_mode_string() -> String {
+    let current = thp_mode();
+    let mut s = String::new();
+    for mode in ThpMode::ALL {
+        if !s.is_empty() {
+            s.push(' ');
+        }
+        if mode == current {
+            s.push_str(&format!("[{}]", mode.name()));
+        } else {
+            s.push_str(mode.name());
+        }
+    }
+    s.push('\n');
+    s
+}
+
+/// 当前架构是否支持透明大页
+///
+/// 其他架构的大页表项标志位语义不同，暂不启用
+#[inline(always)]
+fn thp_supported() -> bool {
+    cfg!(target_arch = "x86_64")
+}
+
+/// 判断VMA是否允许使用透明大页（不考虑具体的地址区间）
+fn thp_vma_allowed(vma: &LockedVMA) -> bool {
+    if !thp_supported() {
+        return false;
+    }
+    let mode = thp_mode();
+    if mode == ThpMode::Never {
+        return false;
+    }
+
+    let guard = vma.lock();
+    let vm_flags = *guard.vm_flags();
+    if vm_flags.intersects(
+        VmFlags::VM_NOHUGEPAGE | VmFlags::VM_HUGETLB | VmFlags::VM_IO | VmFlags::VM_PFNMAP,
+    ) {
+        return false;
+    }
+    if mode == ThpMode::Madvise && !vm_flags.contains(VmFlags::VM_HUGEPAGE) {
+        return false;
+    }
+    guard.is_private_anonymous()
+}
+
+/// 判断VMA中以`haddr`开始的2MB区间能否使用透明大页映射
+pub fn thp_vma_suitable(vma: &LockedVMA, haddr: VirtAddr) -> bool {
+    if !haddr.check_aligned(HPAGE_PMD_SIZE) || !thp_vma_allowed(vma) {
+        return false;
+    }
+    let region = *vma.lock().region();
+    region.start() <= haddr && haddr + HPAGE_PMD_SIZE <= region.end()
+}
+
+#[inline(always)]
+fn huge_align_down(addr: VirtAddr) -> VirtAddr {
+    VirtAddr::new(align_down(addr.data(), HPAGE_PMD_SIZE))
+}
+
+/// 把一个大页的整个范围加入TLB刷新范围
+fn gather_huge_range(tlb: &mut MmuGather<'_>, haddr: VirtAddr) {
+    tlb.accumulate_range(haddr);
+    tlb.accumulate_range(haddr + (HPAGE_PMD_SIZE - MMArch::PAGE_SIZE));
+}
+
+/// 分配一个2MB对齐且已清零的物理块，并为其中的每个4K页创建`Page`描述符
+fn alloc_huge_page() -> Option<(PhysAddr, Vec<Arc<Page>>)> {
+    let (paddr, pages) = page_manager()
+        .create_pages(
+            PageType::Normal,
+            PageFlags::empty(),
+            &mut LockedFrameAllocator,
+            PageFrameCount::new(HPAGE_PMD_NR),
+        )
+        .ok()?;
+
+    // buddy按块大小对齐，正常情况下不会走到这里
+    if !paddr.check_aligned(HPAGE_PMD_SIZE) {
+        for page in pages.iter() {
+            page_manager().remove_page(&page.phys_address());
+        }
+        return None;
+    }
+    Some((paddr, pages))
+}
+
+fn attach_huge_pages(pages: &[Arc<Page>], vma: &Arc<LockedVMA>, mlocked: bool) {
+    for page in pages {
+        let mut page_guard = page.write();
+        page_guard.insert_vma(vma.clone());
+        if mlocked {
+            page_guard.add_flags(PageFlags::PG_UNEVICTABLE);
+        }
+    }
+}
+
+/// 在PMD级处理私有匿名映射的缺页
+///
+/// 调用者需要持有`page_table_edit`锁，且`address`所在的PMD页表已经存在。
+///
+/// ## 返回值
+/// - Some(VmFaultReason): 缺页已在PMD级处理完毕
+/// - None: 需要继续按4K页处理
+pub unsafe fn handle_huge_pmd_fault(
+    mapper: &mut PageMapper,
+    mm: &Arc<AddressSpace>,
+    vma: &Arc<LockedVMA>,
+    address: VirtAddr,
+    write: bool,
+) -> Option<VmFaultReason> {
+    if !thp_supported() {
+        return None;
+    }
+    let haddr = huge_align_down(address);
+
+    if let Some(entry) = mapper.huge_pmd(haddr) {
+        if !write || entry.write() {
+            // 其他线程已经建立了大页映射
+            return Some(VmFaultReason::VM_FAULT_COMPLETED);
+        }
+        // 写只读的大页：拆分成4K页，交给PTE级的写时复制处理
+        return match split_huge_pmd(mapper, haddr) {
+            Ok(_) => None,
+            Err(_) => Some(VmFaultReason::VM_FAULT_OOM),
+        };
+    }
+
+    if mapper.get_table(haddr, 1).is_none()
+        || mapper.get_entry(haddr, 1).is_some()
+        || !thp_vma_suitable(vma, haddr)
+    {
+        return None;
+    }
+
+    khugepaged_enter(mm);
+
+    let Some((paddr, pages)) = alloc_huge_page() else {
+        THP_FAULT_FALLBACK.fetch_add(1, Ordering::Relaxed);
+        return None;
+    };
+
+    let (flags, mlocked) = {
+        let guard = vma.lock();
+        (guard.flags(), guard.vm_flags().contains(VmFlags::VM_LOCKED))
+    };
+    attach_huge_pages(&pages, vma, mlocked);
+    mapper.replace_pmd(haddr, PageEntry::new(paddr, flags.set_huge_page(true)));
+    PageFlush::<MMArch>::new(haddr).flush();
+
+    NR_ANON_THPS.fetch_add(1, Ordering::Relaxed);
+    THP_FAULT_ALLOC.fetch_add(1, Ordering::Relaxed);
+    Some(VmFaultReason::VM_FAULT_COMPLETED)
+}
+
+/// 把`haddr`所在的PMD级大页映射拆分成512个指向同一物理块的4K页表项
+///
+/// 拆分前后虚拟地址到物理地址的对应关系不变，子页的`Page`描述符也不需要修改。
+///
+/// ## 返回值
+/// - Ok(true): 拆分了一个大页
+/// - Ok(false): 该地址不在大页映射中
+/// - Err(SystemError::ENOMEM): 无法分配页表
+pub unsafe fn split_huge_pmd(
+    mapper: &mut PageMapper,
+    haddr: VirtAddr,
+) -> Result<bool, SystemError> {
+    let Some(entry) = mapper.huge_pmd(haddr) else {
+        return Ok(false);
+    };
+    let haddr = huge_align_down(haddr);
+    let paddr = entry.address().map_err(|_| SystemError::EINVAL)?;
+    let flags = entry.flags().set_huge_page(false);
+
+    let table_paddr = mapper
+        .allocator_mut()
+        .allocate_one()
+        .ok_or(SystemError::ENOMEM)?;
+    MMArch::write_bytes(
+        MMArch::phys_2_virt(table_paddr).unwrap(),
+        0,
+        MMArch::PAGE_SIZE,
+    );
+    let table = PageTable::<MMArch>::new(haddr, table_paddr, 0);
+    for i in 0..HPAGE_PMD_NR {
+        table.set_entry(i, PageEntry::new(paddr.add(i * MMArch::PAGE_SIZE), flags));
+    }
+    mapper.replace_pmd(
+        haddr,
+        PageEntry::new(table_paddr, EntryFlags::new_page_table(true)),
+    );
+
+    NR_ANON_THPS.fetch_sub(1, Ordering::Relaxed);
+    THP_SPLIT_PMD.fetch_add(1, Ordering::Relaxed);
+    Ok(true)
+}
+
+/// 拆分与`region`相交的大页映射
+///
+/// `boundary_only`为true时只拆分跨越`region`边界的大页，完全落在区间内的大页
+/// 可以被整体处理（例如整体取消映射），不需要拆分。
+///
+/// 调用者需要持有`page_table_edit`锁，并在之后调用`tlb.finish()`。
+pub unsafe fn split_huge_pmd_range(
+    mapper: &mut PageMapper,
+    region: VirtRegion,
+    boundary_only: bool,
+    tlb: &mut MmuGather<'_>,
+) -> Result<(), SystemError> {
+    if !thp_supported() || NR_ANON_THPS.load(Ordering::Relaxed) == 0 {
+        return Ok(());
+    }
+
+    let mut split_one = |haddr: VirtAddr| -> Result<(), SystemError> {
+        if split_huge_pmd(mapper, haddr)? {
+            // 刷掉TLB中可能缓存的2MB表项
+            gather_huge_range(tlb, haddr);
+        }
+        Ok(())
+    };
+
+    if boundary_only {
+        for addr in [region.start(), region.end()] {
+            if !addr.check_aligned(HPAGE_PMD_SIZE) {
+                split_one(huge_align_down(addr))?;
+            }
+        }
+    } else {
+        let mut haddr = huge_align_down(region.start());
+        while haddr < region.end() {
+            split_one(haddr)?;
+            haddr += HPAGE_PMD_SIZE;
+        }
+    }
+    Ok(())
+}
+
+/// 取消`virt`所在的PMD级大页映射，把可以释放的子页交给`tlb`延迟释放
+///
+/// 调用者需要保证整个大页都位于要取消映射的区间内。
+///
+/// ## 返回值
+/// 如果`virt`位于大页映射中并已取消映射，返回true
+pub unsafe fn zap_huge_pmd(
+    vma: &LockedVMA,
+    mapper: &mut PageMapper,
+    virt: VirtAddr,
+    tlb: &mut MmuGather<'_>,
+) -> bool {
+    if mapper.huge_pmd(virt).is_none() {
+        return false;
+    }
+    let haddr = huge_align_down(virt);
+    let Some((paddr, _, flush, freed_tables)) = mapper.unmap_phys_with_freed_tables(haddr, true)
+    else {
+        return false;
+    };
+    flush.ignore();
+
+    let page_manager = page_manager();
+    for i in 0..HPAGE_PMD_NR {
+        let sub_paddr = paddr.add(i * MMArch::PAGE_SIZE);
+        let Some(page) = page_manager.get(&sub_paddr) else {
+            continue;
+        };
+        let can_dealloc = {
+            let mut page_guard = page.write();
+            page_guard.remove_vma(vma);
+            page_guard.can_deallocate()
+        };
+        if can_dealloc {
+            if let Some(p) = page_manager.remove_page(&sub_paddr) {
+                tlb.stash_page(p);
+            }
+        }
+    }
+
+    gather_huge_range(tlb, haddr);
+    if freed_tables {
+        tlb.note_pt_table_freed();
+    }
+    NR_ANON_THPS.fetch_sub(1, Ordering::Relaxed);
+    true
+}
+
+/// khugepaged登记表中的一个地址空间
+struct KhugepagedSlot {
+    mm: Weak<AddressSpace>,
+    /// 下一次从这个地址开始扫描
+    next: VirtAddr,
+}
+
+/// 需要khugepaged扫描的地址空间，以地址空间id为键
+static KHUGEPAGED_MMS: SpinLock<BTreeMap<u64, KhugepagedSlot>> = SpinLock::new(BTreeMap::new());
+/// 下一轮从id不小于该值的地址空间开始扫描
+static KHUGEPAGED_CURSOR: AtomicU64 = AtomicU64::new(0);
+
+/// 把地址空间登记到khugepaged
+///
+/// 在地址空间中出现可以使用大页的区域时调用（大页缺页、`madvise(MADV_HUGEPAGE)`）。
+pub fn khugepaged_enter(mm: &Arc<AddressSpace>) {
+    if !thp_supported() {
+        return;
+    }
+    KHUGEPAGED_MMS
+        .lock()
+        .entry(mm.id())
+        .or_insert_with(|| KhugepagedSlot {
+            mm: Arc::downgrade(mm),
+            next: VirtAddr::new(0),
+        });
+}
+
+/// 尝试把`haddr`开始的、已被4K页填满的2MB区间合并为一个大页
+///
+/// 调用者持有地址空间的写锁，因此合并期间不会有新的缺页。
+fn collapse_huge_page(
+    mm: &Arc<AddressSpace>,
+    inner: &mut InnerAddressSpace,
+    vma: &Arc<LockedVMA>,
+    haddr: VirtAddr,
+) -> bool {
+    let (flags, mlocked) = {
+        let guard = vma.lock();
+        (guard.flags(), guard.vm_flags().contains(VmFlags::VM_LOCKED))
+    };
+
+    let _pt_edit = mm.page_table_edit();
+    let mapper = &mut inner.user_mapper.utable;
+    let Some(pte_table) = mapper.get_table(haddr, 0) else {
+        return false;
+    };
+
+    // 只合并全部可写、且只被这个VMA映射的私有页，避免破坏写时复制
+    let page_manager = page_manager();
+    let mut old_pages: Vec<Arc<Page>> = Vec::with_capacity(HPAGE_PMD_NR);
+    for i in 0..HPAGE_PMD_NR {
+        let Some(entry) = (unsafe { pte_table.entry(i) }) else {
+            return false;
+        };
+        if !entry.present() || !entry.write() {
+            return false;
+        }
+        let Some(page) = entry.address().ok().and_then(|p| page_manager.get(&p)) else {
+            return false;
+        };
+        {
+            let page_guard = page.read();
+            if !matches!(page_guard.page_type(), PageType::Normal) || page_guard.map_count() != 1 {
+                return false;
+            }
+        }
+        // 页面管理器和这里各持有一个引用，更多的引用说明有人正在直接访问这个物理页
+        if Arc::strong_count(&page) != 2 {
+            return false;
+        }
+        old_pages.push(page);
+    }
+
+    let Some((new_paddr, new_pages)) = alloc_huge_page() else {
+        THP_COLLAPSE_ALLOC_FAILED.fetch_add(1, Ordering::Relaxed);
+        return false;
+    };
+
+    unsafe {
+        // 先断开整个PTE页表并刷新TLB，此后用户态无法再访问旧页面
+        let Some(old_pmd) = mapper.replace_pmd(haddr, PageEntry::from_usize(0)) else {
+            for page in new_pages.iter() {
+                page_manager.remove_page(&page.phys_address());
+            }
+            return false;
+        };
+        mm.flush_tlb_range(
+            haddr,
+            haddr + HPAGE_PMD_SIZE,
+            MMArch::PAGE_SHIFT as u8,
+            true,
+        );
+
+        let dst = MMArch::phys_2_virt(new_paddr).unwrap();
+        for (i, page) in old_pages.iter().enumerate() {
+            let src = MMArch::phys_2_virt(page.phys_address()).unwrap();
+            core::ptr::copy_nonoverlapping(
+                src.data() as *const u8,
+                (dst.data() + i * MMArch::PAGE_SIZE) as *mut u8,
+                MMArch::PAGE_SIZE,
+            );
+        }
+
+        attach_huge_pages(&new_pages, vma, mlocked);
+        mapper.replace_pmd(haddr, PageEntry::new(new_paddr, flags.set_huge_page(true)));
+
+        for page in old_pages {
+            page.write().remove_vma(vma);
+            page_manager.remove_page(&page.phys_address());
+        }
+        if let Ok(table_paddr) = old_pmd.address() {
+            mapper.allocator_mut().free_one(table_paddr);
+        }
+    }
+
+    NR_ANON_THPS.fetch_add(1, Ordering::Relaxed);
+    THP_COLLAPSE_ALLOC.fetch_add(1, Ordering::Relaxed);
+    true
+}
+
+/// 从`start`开始扫描一个地址空间，合并其中可以使用大页的区间
+///
+/// ## 返回值
+/// (下一次扫描的起始地址, 是否已经扫描完整个地址空间)
+fn khugepaged_scan_mm(
+    mm: &Arc<AddressSpace>,
+    start: VirtAddr,
+    budget: &mut usize,
+) -> (VirtAddr, bool) {
+    // 地址空间正忙（缺页、mmap等）时不等待，下一轮再来
+    let Some(mut guard) = mm.try_write() else {
+        return (start, false);
+    };
+
+    let mut vmas: Vec<Arc<LockedVMA>> = guard.mappings.iter_vmas().cloned().collect();
+    vmas.sort_by_key(|vma| vma.lock().region().start().data());
+
+    for vma in vmas {
+        let region = *vma.lock().region();
+        if region.end() <= start || !thp_vma_allowed(&vma) {
+            continue;
+        }
+
+        let mut haddr = VirtAddr::new(align_up(max(region.start(), start).data(), HPAGE_PMD_SIZE));
+        while haddr + HPAGE_PMD_SIZE <= region.end() {
+            if *budget == 0 {
+                return (haddr, false);
+            }
+            *budget = budget.saturating_sub(HPAGE_PMD_NR);
+
+            if guard.user_mapper.utable.huge_pmd(haddr).is_none() {
+                collapse_huge_page(mm, &mut guard, &vma, haddr);
+            }
+            haddr += HPAGE_PMD_SIZE;
+        }
+    }
+    (VirtAddr::new(0), true)
+}
+
+fn khugepaged_do_scan() {
+    if thp_mode() == ThpMode::Never {
+        return;
+    }
+
+    // 取快照后再扫描，避免扫描期间持有登记表的锁
+    let slots: Vec<(u64, Weak<AddressSpace>, VirtAddr)> = {
+        let mut mms = KHUGEPAGED_MMS.lock();
+        mms.retain(|_, slot| slot.mm.strong_count() > 0);
+        let cursor = KHUGEPAGED_CURSOR.load(Ordering::Relaxed);
+        mms.range(cursor..)
+            .chain(mms.range(..cursor))
+            .map(|(id, slot)| (*id, slot.mm.clone(), slot.next))
+            .collect()
+    };
+
+    let mut budget = KHUGEPAGED_PAGES_TO_SCAN;
+    for (id, mm, start) in slots {
+        if budget == 0 {
+            break;
+        }
+        let Some(mm) = mm.upgrade() else {
+            continue;
+        };
+        let (next, finished) = khugepaged_scan_mm(&mm, start, &mut budget);
+        if let Some(slot) = KHUGEPAGED_MMS.lock().get_mut(&id) {
+            slot.next = next;
+        }
+        KHUGEPAGED_CURSOR.store(if finished { id + 1 } else { id }, Ordering::Relaxed);
+    }
+}
+
+/// khugepaged线程初始化函数
+#[unified_init(INITCALL_CORE)]
+fn khugepaged_init() -> Result<(), SystemError> {
+    if !thp_supported() {
+        return Ok(());
+    }
+    let closure =
+        KernelThreadClosure::StaticEmptyClosure((&(khugepaged_thread as fn() -> i32), ()));
+    KernelThreadMechanism::create_and_run(closure, "khugepaged".to_string())
+        .ok_or("")
+        .expect("create khugepaged thread failed");
+    info!("khugepaged started");
+    Ok(())
+}
+
+fn khugepaged_thread() -> i32 {
+    loop {
+        khugepaged_do_scan();
+        let _ = nanosleep(PosixTimeSpec::new(
+            KHUGEPAGED_SCAN_SLEEP_MS / 1000,
+            (KHUGEPAGED_SCAN_SLEEP_MS % 1000) * 1_000_000,
+        ));
+    }
+}
@@ -8,7 +8,7 @@ use crate::{
     filesystem::procfs::kmsg::kmsg_init,
     libs::printk::PrintkWriter,
     mm::{
-        allocator::slab::slab_init,
+        allocator::{pcp::pcp_init, slab::slab_init},
         mmio_buddy::mmio_init,
         page::{page_manager_init, page_reclaimer_init},
     },
@@ -51,6 +51,8 @@ pub unsafe fn mm_init() {
 
     // init slab
     slab_init();
+    // init per-cpu page frame lists
+    pcp_init();
 
     // enable mmio
     mmio_init();
@@ -0,0 +1,385 @@
+//! 文件页的活跃/非活跃LRU与回收水位
+//!
+//! 页缓存页面先进入非活跃链表。页面在非活跃链表上被第二次访问时才提升到活跃链表，
+//! 回收只从非活跃链表的尾部进行；非活跃链表相对活跃链表过短时，才从活跃链表的尾部
+//! 把最近没有被访问的页面降级到非活跃链表。这样一次大的顺序读只会在非活跃链表中
+//! 轮转，不会冲掉活跃链表中的热点页面。
+//!
+//! 页面在LRU中的位置和访问位保存在`Page`的原子字段中（`PageLruState`），
+//! 标记访问不需要任何锁。加入LRU、提升到活跃链表的操作先记录在每CPU的批次中，
+//! 攒够`LRU_BATCH_SIZE`个后再一次性取得回收器锁处理（对应Linux的pagevec）。
+//!
+//! 回收线程（kswapd）由空闲页水位驱动：空闲页低于`low`时被唤醒，
+//! 回收到高于`high`为止；低于`min`时缺页路径直接同步回收。
+
+use core::sync::atomic::{AtomicU64, AtomicU8, AtomicUsize, Ordering};
+
+use alloc::{sync::Arc, vec::Vec};
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    libs::{lazy_init::Lazy, spinlock::SpinLock},
+    mm::{
+        allocator::page_frame::FrameAllocator,
+        page::{page_reclaimer_lock, Page, PageReclaimer},
+        percpu::{PerCpu, PerCpuVar},
+        MemoryManagementArch,
+    },
+    smp::cpu::ProcessorId,
+};
+
+/// 每CPU批次的容量，与Linux的PAGEVEC_SIZE相同
+const LRU_BATCH_SIZE: usize = 15;
+/// 每轮回收的最少页数
+pub const SWAP_CLUSTER_MAX: usize = 32;
+
+/// 页面所在的LRU链表
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LruList {
+    /// 不在LRU上
+    None = 0,
+    /// 在每CPU批次中等待加入非活跃链表
+    Pending = 1,
+    Inactive = 2,
+    Active = 3,
+    /// 被回收路径从链表上摘下，正在尝试回收
+    Isolated = 4,
+}
+
+impl LruList {
+    const MASK: u8 = 0x7;
+
+    fn from_bits(bits: u8) -> Self {
+        match bits & Self::MASK {
+            1 => LruList::Pending,
+            2 => LruList::Inactive,
+            3 => LruList::Active,
+            4 => LruList::Isolated,
+            _ => LruList::None,
+        }
+    }
+}
+
+/// 页面在LRU中的状态：所在链表 + 访问位（对应Linux的PG_lru/PG_active/PG_referenced）
+///
+/// 链表状态只在持有回收器锁时改变（`Pending`除外），访问位可以随时设置。
+#[derive(Debug)]
+pub struct PageLruState(AtomicU8);
+
+impl PageLruState {
+    const REFERENCED: u8 = 0x8;
+
+    pub const fn new() -> Self {
+        Self(AtomicU8::new(LruList::None as u8))
+    }
+
+    pub fn list(&self) -> LruList {
+        LruList::from_bits(self.0.load(Ordering::Acquire))
+    }
+
+    /// 链表状态为`from`时改为`to`，保留访问位。返回是否成功
+    pub fn transition(&self, from: LruList, to: LruList) -> bool {
+        self.0
+            .fetch_update(Ordering::AcqRel, Ordering::Acquire, |v| {
+                (LruList::from_bits(v) == from).then_some((v & !LruList::MASK) | to as u8)
+            })
+            .is_ok()
+    }
+
+    /// 无条件设置链表状态，返回原来的状态
+    pub fn set_list(&self, to: LruList) -> LruList {
+        let old = self
+            .0
+            .fetch_update(Ordering::AcqRel, Ordering::Acquire, |v| {
+                Some((v & !LruList::MASK) | to as u8)
+            })
+            .unwrap();
+        LruList::from_bits(old)
+    }
+
+    /// 设置访问位，返回之前是否已经设置
+    pub fn set_referenced(&self) -> bool {
+        self.0.fetch_or(Self::REFERENCED, Ordering::AcqRel) & Self::REFERENCED != 0
+    }
+
+    /// 清除访问位，返回之前是否设置
+    pub fn test_and_clear_referenced(&self) -> bool {
+        self.0.fetch_and(!Self::REFERENCED, Ordering::AcqRel) & Self::REFERENCED != 0
+    }
+}
+
+/// 每CPU批次中的操作
+#[derive(Debug, Clone, Copy)]
+pub enum LruOp {
+    /// 加入非活跃链表
+    Add,
+    /// 从非活跃链表提升到活跃链表
+    Activate,
+}
+
+type LruBatch = Vec<(Arc<Page>, LruOp)>;
+
+static LRU_BATCHES: Lazy<PerCpuVar<SpinLock<LruBatch>>> = PerCpuVar::define_lazy();
+
+pub fn lru_batch_init() {
+    let mut batches = Vec::with_capacity(PerCpu::MAX_CPU_NUM as usize);
+    for _ in 0..PerCpu::MAX_CPU_NUM {
+        batches.push(SpinLock::new(Vec::new()));
+    }
+    LRU_BATCHES.init(PerCpuVar::new(batches).unwrap());
+}
+
+fn lru_batch_push(page: &Arc<Page>, op: LruOp) {
+    let Some(batches) = LRU_BATCHES.try_get() else {
+        // 每CPU批次初始化之前直接操作链表
+        page_reclaimer_lock().apply_lru_batch(alloc::vec![(page.clone(), op)]);
+        return;
+    };
+    let full = {
+        let mut batch = batches.get().lock_irqsave();
+        if batch.capacity() == 0 {
+            batch.reserve_exact(LRU_BATCH_SIZE);
+        }
+        batch.push((page.clone(), op));
+        if batch.len() < LRU_BATCH_SIZE {
+            return;
+        }
+        core::mem::replace(&mut *batch, Vec::with_capacity(LRU_BATCH_SIZE))
+    };
+    // 回收器锁是睡眠锁，必须在释放每CPU批次的自旋锁之后获取
+    page_reclaimer_lock().apply_lru_batch(full);
+}
+
+/// 把新的页缓存页面加入非活跃链表（经过每CPU批次）
+pub fn lru_cache_add(page: &Arc<Page>) {
+    if page.lru().transition(LruList::None, LruList::Pending) {
+        lru_batch_push(page, LruOp::Add);
+    }
+}
+
+/// 页缓存页面被访问（read/write/缺页）时调用
+///
+/// 第一次访问只设置访问位；访问位已经设置、且页面在非活跃链表上时，
+/// 把页面提升到活跃链表。
+pub fn mark_page_accessed(page: &Arc<Page>) {
+    let lru = page.lru();
+    if lru.set_referenced() && lru.list() == LruList::Inactive {
+        lru.test_and_clear_referenced();
+        lru_batch_push(page, LruOp::Activate);
+    }
+}
+
+/// 把当前CPU的批次提交到LRU
+pub fn lru_add_drain() {
+    let Some(batches) = LRU_BATCHES.try_get() else {
+        return;
+    };
+    let batch = core::mem::take(&mut *batches.get().lock_irqsave());
+    if !batch.is_empty() {
+        page_reclaimer_lock().apply_lru_batch(batch);
+    }
+}
+
+/// 把所有CPU的批次提交到LRU，回收和drop_caches之前调用
+pub fn lru_add_drain_all() {
+    let Some(batches) = LRU_BATCHES.try_get() else {
+        return;
+    };
+    let mut pending: LruBatch = Vec::new();
+    for cpu in 0..PerCpu::MAX_CPU_NUM {
+        let mut batch = unsafe { batches.force_get(ProcessorId::new(cpu)) }.lock_irqsave();
+        pending.append(&mut batch);
+    }
+    if !pending.is_empty() {
+        page_reclaimer_lock().apply_lru_batch(pending);
+    }
+}
+
+/// 回收是由kswapd还是由分配路径同步发起的
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ReclaimMode {
+    Kswapd,
+    Direct,
+}
+
+/// `/proc/vmstat`中与页面回收和文件预读相关的事件计数
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum VmEvent {
+    PgActivate,
+    PgDeactivate,
+    PgRefill,
+    PgStealKswapd,
+    PgStealDirect,
+    PgScanKswapd,
+    PgScanDirect,
+    PgScanAnon,
+    PgScanFile,
+    PgStealAnon,
+    PgStealFile,
+    AllocStall,
+    PageOutRun,
+    /// 预读发起读取的页数
+    FileRa,
+    /// 同步预读（读到缺失页面）次数
+    FileRaSync,
+    /// 异步预读（读到预读标记）次数
+    FileRaAsync,
+    /// 读者不得不等待页面I/O完成的次数
+    FileRaStall,
+}
+
+const NR_VM_EVENTS: usize = VmEvent::FileRaStall as usize + 1;
+
+static VM_EVENTS: [AtomicU64; NR_VM_EVENTS] = [const { AtomicU64::new(0) }; NR_VM_EVENTS];
+
+#[inline(always)]
+pub fn count_vm_events(event: VmEvent, n: usize) {
+    if n != 0 {
+        VM_EVENTS[event as usize].fetch_add(n as u64, Ordering::Relaxed);
+    }
+}
+
+pub fn vm_event(event: VmEvent) -> u64 {
+    VM_EVENTS[event as usize].load(Ordering::Relaxed)
+}
+
+/// 记录一次扫描：`scanned`个页面被检查，`stolen`个页面被回收
+pub fn count_reclaim(mode: ReclaimMode, file: bool, scanned: usize, stolen: usize) {
+    let (scan, steal) = match mode {
+        ReclaimMode::Kswapd => (VmEvent::PgScanKswapd, VmEvent::PgStealKswapd),
+        ReclaimMode::Direct => (VmEvent::PgScanDirect, VmEvent::PgStealDirect),
+    };
+    count_vm_events(scan, scanned);
+    count_vm_events(steal, stolen);
+    if file {
+        count_vm_events(VmEvent::PgScanFile, scanned);
+        count_vm_events(VmEvent::PgStealFile, stolen);
+    } else {
+        count_vm_events(VmEvent::PgScanAnon, scanned);
+        count_vm_events(VmEvent::PgStealAnon, stolen);
+    }
+}
+
+/// 各LRU链表的长度，由回收器在修改链表后更新
+pub(super) static NR_ACTIVE_FILE: AtomicUsize = AtomicUsize::new(0);
+pub(super) static NR_INACTIVE_FILE: AtomicUsize = AtomicUsize::new(0);
+pub(super) static NR_ISOLATED_FILE: AtomicUsize = AtomicUsize::new(0);
+pub(super) static NR_ANON_LRU: AtomicUsize = AtomicUsize::new(0);
+
+/// LRU链表长度的快照，用于`/proc/vmstat`和`/proc/meminfo`
+#[derive(Debug, Clone, Copy, Default)]
+pub struct LruStatsSnapshot {
+    pub nr_active_file: usize,
+    pub nr_inactive_file: usize,
+    pub nr_isolated_file: usize,
+    pub nr_inactive_anon: usize,
+}
+
+pub fn lru_stats() -> LruStatsSnapshot {
+    LruStatsSnapshot {
+        nr_active_file: NR_ACTIVE_FILE.load(Ordering::Relaxed),
+        nr_inactive_file: NR_INACTIVE_FILE.load(Ordering::Relaxed),
+        nr_isolated_file: NR_ISOLATED_FILE.load(Ordering::Relaxed),
+        nr_inactive_anon: NR_ANON_LRU.load(Ordering::Relaxed),
+    }
+}
+
+/// 非活跃链表的目标比例：活跃链表不应超过非活跃链表的`inactive_ratio`倍
+///
+/// 与Linux相同，内存小于1GB时为1，之后按sqrt(10 * 内存GB数)增长。
+pub fn inactive_ratio() -> usize {
+    let total_pages = WATERMARK_TOTAL.load(Ordering::Relaxed);
+    let gb = (total_pages * MMArch::PAGE_SIZE) >> 30;
+    if gb == 0 {
+        1
+    } else {
+        int_sqrt(10 * gb)
+    }
+}
+
+fn int_sqrt(x: usize) -> usize {
+    let mut r = 0usize;
+    while (r + 1) * (r + 1) <= x {
+        r += 1;
+    }
+    r
+}
+
+/// 空闲页水位（页）
+#[derive(Debug, Clone, Copy)]
+pub struct Watermarks {
+    /// 低于该值时分配路径同步回收
+    pub min: usize,
+    /// 低于该值时唤醒kswapd
+    pub low: usize,
+    /// kswapd回收到高于该值为止
+    pub high: usize,
+}
+
+static WATERMARK_MIN: AtomicUsize = AtomicUsize::new(0);
+static WATERMARK_TOTAL: AtomicUsize = AtomicUsize::new(0);
+
+/// 根据`min_free_kbytes`计算各水位
+///
+/// `low`和`high`在`min`之上各增加`max(min / 4, 总内存的0.1%)`，
+/// 对应Linux默认的watermark_scale_factor=10。
+pub fn watermarks() -> Watermarks {
+    let min = WATERMARK_MIN.load(Ordering::Relaxed);
+    let total = WATERMARK_TOTAL.load(Ordering::Relaxed);
+    let delta = (min / 4).max(total / 1000);
+    Watermarks {
+        min,
+        low: min + delta,
+        high: min + 2 * delta,
+    }
+}
+
+pub fn min_free_kbytes() -> usize {
+    WATERMARK_MIN.load(Ordering::Relaxed) * (MMArch::PAGE_SIZE >> 10)
+}
+
+pub fn set_min_free_kbytes(kbytes: usize) {
+    let pages = kbytes / (MMArch::PAGE_SIZE >> 10);
+    WATERMARK_MIN.store(pages, Ordering::Relaxed);
+}
+
+/// 按Linux的默认规则初始化水位：min_free_kbytes = sqrt(内存KB数 * 16)，限制在[128KB, 256MB]
+pub fn setup_watermarks() {
+    let total = unsafe { LockedFrameAllocator.usage() }.total().data();
+    WATERMARK_TOTAL.store(total, Ordering::Relaxed);
+    let total_kb = total * (MMArch::PAGE_SIZE >> 10);
+    set_min_free_kbytes(int_sqrt(total_kb * 16).clamp(128, 256 * 1024));
+    let wm = watermarks();
+    log::info!(
+        "watermarks: min={} low={} high={} pages, inactive_ratio={}",
+        wm.min,
+        wm.low,
+        wm.high,
+        inactive_ratio()
+    );
+}
+
+#[inline(always)]
+pub fn nr_free_pages() -> usize {
+    unsafe { LockedFrameAllocator.usage() }.free().data()
+}
+
+/// 每调用这么多次检查一次水位，避免每次分配页面或缺页都统计空闲页
+const WATERMARK_CHECK_INTERVAL: usize = 64;
+static WATERMARK_CHECK_COUNTER: AtomicUsize = AtomicUsize::new(0);
+
+/// 是否轮到检查一次水位
+#[inline(always)]
+pub fn watermark_check_due() -> bool {
+    WATERMARK_CHECK_COUNTER.fetch_add(1, Ordering::Relaxed) % WATERMARK_CHECK_INTERVAL == 0
+}
+
+/// 页面分配之后调用：空闲页低于`low`水位时唤醒kswapd
+///
+/// 只能在进程上下文中调用。
+pub fn wakeup_kswapd_if_low() {
+    if watermark_check_due() && nr_free_pages() < watermarks().low {
+        PageReclaimer::wakeup_claim_thread();
+    }
+}
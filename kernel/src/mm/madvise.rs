@@ -3,8 +3,12 @@ use system_error::SystemError;
 use crate::arch::{mm::PageMapper, MMArch};
 
 use super::{
-    mmu_gather::MmuGather, syscall::MadvFlags, ucontext::LockedVMA, MemoryManagementArch, VirtAddr,
-    VmFlags,
+    huge_memory::{self, HPAGE_PMD_SIZE},
+    mmu_gather::MmuGather,
+    swap::swap_state,
+    syscall::MadvFlags,
+    ucontext::LockedVMA,
+    MemoryManagementArch, VirtAddr, VmFlags,
 };
 
 impl LockedVMA {
@@ -39,6 +43,11 @@ impl LockedVMA {
 
                 while current_page < end_page {
                     let virt_addr = VirtAddr::new(current_page.data());
+                    // 区间内的透明大页整体解除映射并释放（边界上的大页已由调用者拆分）
+                    if unsafe { huge_memory::zap_huge_pmd(self, mapper, virt_addr, tlb) } {
+                        current_page = VirtAddr::new(current_page.data() + HPAGE_PMD_SIZE);
+                        continue;
+                    }
                     if let Some((_paddr, _)) = mapper.translate(virt_addr) {
                         // 只有当页面已经映射时才需要解除映射
                         unsafe {
@@ -51,6 +60,9 @@ impl LockedVMA {
                                 tlb.accumulate_range(virt_addr);
                             }
                         }
+                    } else {
+                        // 已被换出的页直接丢弃交换槽位
+                        unsafe { swap_state::zap_swap_pte(mapper, virt_addr) };
                     }
                     current_page = VirtAddr::new(current_page.data() + MMArch::PAGE_SIZE);
                 }
@@ -116,7 +128,13 @@ impl LockedVMA {
 
             MadvFlags::MADV_MERGEABLE | MadvFlags::MADV_UNMERGEABLE => {}
 
-            MadvFlags::MADV_HUGEPAGE | MadvFlags::MADV_NOHUGEPAGE => {}
+            MadvFlags::MADV_HUGEPAGE => {
+                new_flags = (new_flags & !VmFlags::VM_NOHUGEPAGE) | VmFlags::VM_HUGEPAGE
+            }
+
+            MadvFlags::MADV_NOHUGEPAGE => {
+                new_flags = (new_flags & !VmFlags::VM_HUGEPAGE) | VmFlags::VM_NOHUGEPAGE
+            }
 
             MadvFlags::MADV_COLLAPSE => {}
             _ => {}
@@ -15,7 +15,7 @@ use alloc::{sync::Arc, vec::Vec};
 use crate::{
     arch::MMArch,
     mm::{
-        page::{page_manager_lock, Page},
+        page::{page_manager, Page},
         tlb::TLB_FLUSH_ALL,
         ucontext::AddressSpace,
         MemoryManagementArch, PhysAddr, VirtAddr,
@@ -125,8 +125,7 @@ impl<'mm> MmuGather<'mm> {
     ///
     /// If `paddr` does not exist in the page_manager (e.g. a file page no longer in cache), this is a no-op.
     pub fn stash_paddr(&mut self, paddr: PhysAddr) {
-        let mut guard = page_manager_lock();
-        if let Some(p) = guard.remove_page(&paddr) {
+        if let Some(p) = page_manager().remove_page(&paddr) {
             self.pending_pages.push(p);
         }
     }
@@ -135,17 +134,17 @@ impl<'mm> MmuGather<'mm> {
     ///
     /// After this call, `start/end/freed_tables` are reset, allowing a second round of accumulation
     /// within the same gather.
+    ///
+    /// A gather that cleared no PTE and freed no page table (e.g. munmap/mprotect/madvise over pages
+    /// that were never faulted in) has nothing to shoot down and sends no IPI.
     pub fn flush_mmu_tlbonly(&mut self) {
         if let Some(mm) = self.mm {
-            if self.fullmm || self.start == VirtAddr::new(usize::MAX) {
-                mm.flush_tlb_range(
-                    VirtAddr::new(0),
-                    TLB_FLUSH_ALL,
-                    self.stride_shift,
-                    self.freed_tables || self.fullmm,
-                );
+            if self.fullmm {
+                mm.flush_tlb_range(VirtAddr::new(0), TLB_FLUSH_ALL, self.stride_shift, true);
             } else if self.start < self.end {
                 mm.flush_tlb_range(self.start, self.end, self.stride_shift, self.freed_tables);
+            } else if self.freed_tables {
+                mm.flush_tlb_range(VirtAddr::new(0), TLB_FLUSH_ALL, self.stride_shift, true);
             }
         }
         // else: teardown path -- no CPU holds a TLB entry for this mm anymore, skip shootdown.
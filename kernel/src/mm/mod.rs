@@ -25,9 +25,11 @@ pub mod allocator;
 pub mod dma;
 pub mod early_ioremap;
 pub mod fault;
+pub mod huge_memory;
 pub mod ident_map;
 pub mod init;
 pub mod kernel_mapper;
+pub mod lru;
 pub mod madvise;
 pub mod memblock;
 pub mod mincore;
@@ -39,6 +41,7 @@ pub mod page_cache_stats;
 pub mod percpu;
 pub mod readahead;
 pub mod syscall;
+pub mod swap;
 pub mod sysfs;
 pub mod tlb;
 pub mod truncate;
@@ -84,6 +87,8 @@ bitflags! {
         const VM_ARCH_1 = 0x01000000;
         const VM_WIPEONFORK = 0x02000000;
         const VM_DONTDUMP = 0x04000000;
+        const VM_HUGEPAGE = 0x20000000;
+        const VM_NOHUGEPAGE = 0x40000000;
 
         const VM_LOCKED_CLEAR_MASK = !(Self::VM_LOCKED.bits | Self::VM_LOCKONFAULT.bits);
     }
@@ -601,6 +606,26 @@ pub trait MemoryManagementArch: Clone + Copy + Debug {
     /// @brief 设置顶级页表的物理地址到处理器中
     unsafe fn set_table(table_kind: PageTableKind, table: PhysAddr);
 
+    /// 可以分配给用户地址空间的硬件地址空间标识个数（x86_64的PCID，RISC-V/LoongArch的ASID）
+    ///
+    /// 返回0表示不支持，此时每次切换用户页表都会刷新TLB。
+    fn user_asid_count() -> usize {
+        0
+    }
+
+    /// 加载用户页表，并用`asid`（从0开始编号）标记之后缓存的TLB条目
+    ///
+    /// `flush`为false时保留此前以`asid`缓存的TLB条目。不支持ASID时`asid`和`flush`被忽略，
+    /// 行为与`set_table`相同。
+    unsafe fn switch_user_table(table: PhysAddr, _asid: usize, _flush: bool) {
+        Self::set_table(PageTableKind::User, table);
+    }
+
+    /// 刷新当前ASID下缓存的TLB条目，其他ASID的条目保持不变
+    unsafe fn invalidate_current_asid() {
+        Self::invalidate_all();
+    }
+
     /// @brief 将物理地址转换为虚拟地址.
     ///
     /// @param phys 物理地址
@@ -1,16 +1,17 @@
-use alloc::{string::ToString, vec::Vec};
+use alloc::{boxed::Box, string::ToString, vec::Vec};
 use core::{
     fmt::{self, Debug, Error, Formatter},
+    hint::spin_loop,
     marker::PhantomData,
     mem,
     ops::Add,
-    sync::atomic::{compiler_fence, Ordering},
+    sync::atomic::{compiler_fence, AtomicUsize, Ordering},
 };
 use system_error::SystemError;
 use unified_init::macros::unified_init;
 
 use alloc::sync::{Arc, Weak};
-use hashbrown::{HashMap, HashSet};
+use hashbrown::HashSet;
 use log::{error, info};
 use lru::LruCache;
 
@@ -25,7 +26,11 @@ use crate::{
         mutex::{Mutex, MutexGuard},
         rwsem::{RwSem, RwSemReadGuard, RwSemUpgradeableGuard, RwSemWriteGuard},
     },
-    mm::page_cache_stats as pc_stats,
+    mm::{
+        lru::{self as page_lru, LruList, LruOp, PageLruState, ReclaimMode},
+        memblock::mem_block_manager,
+        page_cache_stats as pc_stats, swap,
+    },
     process::{ProcessControlBlock, ProcessManager},
     time::{sleep::nanosleep, PosixTimeSpec},
 };
@@ -34,6 +39,7 @@ use super::{
     allocator::page_frame::{
         deallocate_page_frames, FrameAllocator, PageFrameCount, PhysPageFrame,
     },
+    swap::SwapEntry,
     syscall::ProtFlags,
     ucontext::LockedVMA,
     MemoryManagementArch, PageTableKind, PhysAddr, VirtAddr,
@@ -47,72 +53,193 @@ pub const PAGE_1G_SHIFT: usize = 30;
 pub const PAGE_4K_SIZE: usize = 1 << PAGE_4K_SHIFT;
 pub const PAGE_2M_SIZE: usize = 1 << PAGE_2M_SHIFT;
 
-/// 全局物理页信息管理器
-pub static mut PAGE_MANAGER: Option<Mutex<PageManager>> = None;
+/// 全局物理页描述符表
+static mut PAGE_MANAGER: Option<PageManager> = None;
 
 /// 初始化PAGE_MANAGER
 pub fn page_manager_init() {
     info!("page_manager_init");
-    let page_manager = Mutex::new(PageManager::new());
+    let page_manager = PageManager::new();
 
     compiler_fence(Ordering::SeqCst);
     unsafe { PAGE_MANAGER = Some(page_manager) };
     compiler_fence(Ordering::SeqCst);
 
-    info!("page_manager_init done");
+    info!(
+        "page_manager_init done, {} sections, {} page descriptors",
+        page_manager().present_sections(),
+        page_manager().nr_descriptors()
+    );
+}
+
+#[inline(always)]
+pub fn page_manager() -> &'static PageManager {
+    unsafe { PAGE_MANAGER.as_ref().unwrap() }
 }
 
-pub fn page_manager_lock() -> MutexGuard<'static, PageManager> {
-    unsafe { PAGE_MANAGER.as_ref().unwrap().lock() }
+/// 每个section覆盖的物理地址范围（128MB）
+const PAGE_SECTION_SHIFT: usize = 27;
+const PAGES_PER_SECTION: usize = 1 << (PAGE_SECTION_SHIFT - MMArch::PAGE_SHIFT);
+
+/// 一个物理页帧的描述符
+///
+/// 保存由`Arc::into_raw`得到的`Page`指针，最低位用作该槽位的锁位。
+/// 只有在读取指针并增加引用计数、或者替换指针时才会短暂持有锁位。
+struct PageSlot(AtomicUsize);
+
+impl PageSlot {
+    const LOCKED: usize = 1;
+
+    const fn new() -> Self {
+        Self(AtomicUsize::new(0))
+    }
+
+    #[inline(always)]
+    fn is_empty(&self) -> bool {
+        self.0.load(Ordering::Acquire) & !Self::LOCKED == 0
+    }
+
+    /// 获取槽位的锁位，返回当前保存的指针
+    #[inline(always)]
+    fn lock(&self) -> *const Page {
+        ProcessManager::preempt_disable();
+        loop {
+            let val = self.0.load(Ordering::Relaxed);
+            if val & Self::LOCKED == 0
+                && self
+                    .0
+                    .compare_exchange_weak(
+                        val,
+                        val | Self::LOCKED,
+                        Ordering::Acquire,
+                        Ordering::Relaxed,
+                    )
+                    .is_ok()
+            {
+                return val as *const Page;
+            }
+            spin_loop();
+        }
+    }
+
+    /// 写入新的指针并释放锁位
+    #[inline(always)]
+    fn unlock(&self, page: *const Page) {
+        self.0.store(page as usize, Ordering::Release);
+        ProcessManager::preempt_enable();
+    }
 }
 
-// 物理页管理器
+/// 物理页描述符表
+///
+/// 按PFN直接索引的稠密数组，只为与可用物理内存区域重叠的section分配描述符。
+/// 表的结构在初始化后不再改变，因此查找不需要任何全局锁，
+/// 不同物理页之间的操作也互不干扰。
 pub struct PageManager {
-    phys2page: HashMap<PhysAddr, Arc<Page>>,
+    sections: Vec<Option<Box<[PageSlot]>>>,
 }
 
 impl PageManager {
-    pub fn new() -> Self {
-        Self {
-            phys2page: HashMap::new(),
+    /// 根据memblock中的可用物理内存区域建立描述符表
+    fn new() -> Self {
+        let mut max_section = 0;
+        for area in mem_block_manager().to_iter_available() {
+            if area.size == 0 {
+                continue;
+            }
+            let end = area.base.data() + area.size;
+            max_section = max_section.max((end - 1) >> PAGE_SECTION_SHIFT);
+        }
+
+        let mut sections: Vec<Option<Box<[PageSlot]>>> = Vec::new();
+        sections.resize_with(max_section + 1, || None);
+        for area in mem_block_manager().to_iter_available() {
+            if area.size == 0 {
+                continue;
+            }
+            let first = area.base.data() >> PAGE_SECTION_SHIFT;
+            let last = (area.base.data() + area.size - 1) >> PAGE_SECTION_SHIFT;
+            for section in sections.iter_mut().take(last + 1).skip(first) {
+                if section.is_none() {
+                    *section = Some((0..PAGES_PER_SECTION).map(|_| PageSlot::new()).collect());
+                }
+            }
         }
+        Self { sections }
+    }
+
+    /// 已分配描述符的section数量
+    pub fn present_sections(&self) -> usize {
+        self.sections.iter().filter(|s| s.is_some()).count()
+    }
+
+    /// 描述符总数
+    pub fn nr_descriptors(&self) -> usize {
+        self.present_sections() * PAGES_PER_SECTION
+    }
+
+    #[inline(always)]
+    fn slot(&self, paddr: &PhysAddr) -> Option<&PageSlot> {
+        let pfn = paddr.data() >> MMArch::PAGE_SHIFT;
+        let section = self
+            .sections
+            .get(paddr.data() >> PAGE_SECTION_SHIFT)?
+            .as_ref()?;
+        Some(&section[pfn & (PAGES_PER_SECTION - 1)])
     }
 
     #[allow(dead_code)]
     pub fn contains(&self, paddr: &PhysAddr) -> bool {
-        self.phys2page.contains_key(paddr)
+        self.slot(paddr).is_some_and(|slot| !slot.is_empty())
     }
 
-    pub fn get(&mut self, paddr: &PhysAddr) -> Option<Arc<Page>> {
-        if let Some(p) = page_reclaimer_lock().get(paddr) {
-            return Some(p);
-        }
-        self.phys2page.get(paddr).cloned()
+    pub fn get(&self, paddr: &PhysAddr) -> Option<Arc<Page>> {
+        let slot = self.slot(paddr)?;
+        let ptr = slot.lock();
+        let page = if ptr.is_null() {
+            None
+        } else {
+            // 表中持有一个强引用，在锁位保护下再增加一个
+            unsafe {
+                Arc::increment_strong_count(ptr);
+                Some(Arc::from_raw(ptr))
+            }
+        };
+        slot.unlock(ptr);
+        page
     }
 
-    pub fn get_unwrap(&mut self, paddr: &PhysAddr) -> Arc<Page> {
-        if let Some(p) = page_reclaimer_lock().get(paddr) {
-            return p;
-        }
-        self.phys2page
-            .get(paddr)
+    pub fn get_unwrap(&self, paddr: &PhysAddr) -> Arc<Page> {
+        self.get(paddr)
             .unwrap_or_else(|| panic!("Phys Page not found, {:?}", paddr))
-            .clone()
     }
 
-    fn insert(&mut self, page: &Arc<Page>) -> Result<Arc<Page>, SystemError> {
+    fn insert(&self, page: &Arc<Page>) -> Result<Arc<Page>, SystemError> {
         let phys = page.phys_address();
-        if !self.phys2page.contains_key(&phys) {
-            self.phys2page.insert(phys, page.clone());
-            Ok(page.clone())
-        } else {
+        let Some(slot) = self.slot(&phys) else {
+            log::error!("phys page: {phys:?} is not covered by page descriptor table.");
+            return Err(SystemError::EINVAL);
+        };
+        let ptr = slot.lock();
+        if !ptr.is_null() {
+            slot.unlock(ptr);
             log::error!("phys page: {phys:?} already exists.");
-            Err(SystemError::EINVAL)
+            return Err(SystemError::EINVAL);
         }
+        slot.unlock(Arc::into_raw(page.clone()));
+        Ok(page.clone())
     }
 
-    pub fn remove_page(&mut self, paddr: &PhysAddr) -> Option<Arc<Page>> {
-        self.phys2page.remove(paddr)
+    pub fn remove_page(&self, paddr: &PhysAddr) -> Option<Arc<Page>> {
+        let slot = self.slot(paddr)?;
+        let ptr = slot.lock();
+        slot.unlock(core::ptr::null());
+        if ptr.is_null() {
+            None
+        } else {
+            // 在锁位之外释放表中持有的引用，页面可能在这里被析构
+            Some(unsafe { Arc::from_raw(ptr) })
+        }
     }
 
     /// # 创建一个新页面并加入管理器
@@ -129,7 +256,7 @@ impl PageManager {
     /// - `Ok(Arc<Page>)`: 新页面
     /// - `Err(SystemError)`: 错误码
     pub fn create_one_page(
-        &mut self,
+        &self,
         page_type: PageType,
         flags: PageFlags,
         allocator: &mut dyn FrameAllocator,
@@ -156,7 +283,7 @@ impl PageManager {
     /// - `Ok((PhysAddr, Vec<Arc<Page>>))`: 页面起始物理地址，新页面集合
     /// - `Err(SystemError)`: 错误码
     pub fn create_pages(
-        &mut self,
+        &self,
         page_type: PageType,
         flags: PageFlags,
         allocator: &mut dyn FrameAllocator,
@@ -184,6 +311,7 @@ impl PageManager {
             ret.push(page);
             cur_phys = cur_phys.next();
         }
+        page_lru::wakeup_kswapd_if_low();
         Ok((start_paddr, ret))
     }
 
@@ -199,7 +327,7 @@ impl PageManager {
     /// - `Ok(Arc<Page>)`: 新页面
     /// - `Err(SystemError)`: 错误码
     pub fn copy_page(
-        &mut self,
+        &self,
         old_phys: &PhysAddr,
         allocator: &mut dyn FrameAllocator,
     ) -> Result<Arc<Page>, SystemError> {
@@ -227,10 +355,13 @@ pub fn page_reclaimer_init() {
     unsafe { PAGE_RECLAIMER = Some(page_reclaimer) };
     compiler_fence(Ordering::SeqCst);
 
+    page_lru::lru_batch_init();
+    page_lru::setup_watermarks();
+
     info!("page_reclaimer_init done");
 }
 
-/// 页面回收线程
+/// 页面回收线程（kswapd）
 static mut PAGE_RECLAIMER_THREAD: Option<Arc<ProcessControlBlock>> = None;
 
 /// 页面回收线程初始化函数
@@ -242,10 +373,10 @@ fn page_reclaimer_thread_init() -> Result<(), SystemError> {
     ));
     let pcb = crate::process::kthread::KernelThreadMechanism::create_and_run(
         closure,
-        "page_reclaim".to_string(),
+        "kswapd0".to_string(),
     )
     .ok_or("")
-    .expect("create tty_refresh thread failed");
+    .expect("create kswapd thread failed");
     unsafe {
         PAGE_RECLAIMER_THREAD = Some(pcb);
     }
@@ -253,17 +384,41 @@ fn page_reclaimer_thread_init() -> Result<(), SystemError> {
 }
 
 /// 页面回收线程执行的函数
+///
+/// 空闲页低于`low`水位时回收页缓存（以及启用交换时的匿名页），直到高于`high`水位；
+/// 否则定期回写脏页。
 fn page_reclaim_thread() -> i32 {
     loop {
-        let usage = unsafe { LockedFrameAllocator.usage() };
-        // log::info!("usage{:?}", usage);
-
-        // 保留4096个页面，总计16MB的空闲空间
-        if usage.free().data() < 4096 {
-            let page_to_free = 4096;
-            // 分离选择和回收阶段，避免长时间持有页面回收器锁导致与
-            // page_manager/page_cache 的锁顺序反转。
-            PageReclaimer::shrink_list(PageFrameCount::new(page_to_free));
+        let wmark = page_lru::watermarks();
+        if page_lru::nr_free_pages() < wmark.low {
+            page_lru::count_vm_events(page_lru::VmEvent::PageOutRun, 1);
+            // 先归还各CPU缓存的页帧和kzerod预清零的页面，再回收页缓存
+            LockedFrameAllocator.drain_percpu_pages();
+            super::allocator::zeroed_pool::zeroed_pool_drain();
+
+            loop {
+                let free = page_lru::nr_free_pages();
+                if free >= wmark.high {
+                    break;
+                }
+                let nr_to_reclaim = (wmark.high - free).max(page_lru::SWAP_CLUSTER_MAX);
+                // 分离选择和回收阶段，避免长时间持有页面回收器锁导致与
+                // page_manager/page_cache 的锁顺序反转。
+                let mut reclaimed = PageReclaimer::shrink_list(
+                    PageFrameCount::new(nr_to_reclaim),
+                    ReclaimMode::Kswapd,
+                );
+                // 页缓存回收之后仍然不足时换出匿名页
+                if reclaimed < nr_to_reclaim && swap::swap_active() {
+                    reclaimed +=
+                        swap::vmscan::shrink_anon(nr_to_reclaim - reclaimed, ReclaimMode::Kswapd);
+                }
+                if reclaimed == 0 {
+                    // 没有可以回收的页面，等待页面被访问位老化、脏页写回或交换空间释放
+                    let _ = nanosleep(PosixTimeSpec::new(0, 10_000_000));
+                    break;
+                }
+            }
         } else {
             //TODO Temporarily let page reclaim thread handle dirty page writeback; should be separated later.
             PageReclaimer::flush_dirty_pages();
@@ -282,67 +437,193 @@ pub fn page_reclaimer_lock() -> MutexGuard<'static, PageReclaimer> {
 }
 
 /// 页面回收器
+///
+/// 文件页分为活跃和非活跃两个链表，页面的链表状态保存在`Page::lru`中，
+/// 在持有回收器锁时与链表内容保持一致。
 pub struct PageReclaimer {
-    lru: LruCache<PhysAddr, Arc<Page>>,
+    /// 在非活跃链表上被再次访问过的文件页
+    active: LruCache<PhysAddr, Arc<Page>>,
+    /// 新加入的文件页，回收只从这里进行
+    inactive: LruCache<PhysAddr, Arc<Page>>,
+    /// 可以被换出的私有匿名页，只在启用了交换设备时维护
+    anon_lru: LruCache<PhysAddr, Weak<Page>>,
 }
 
 impl PageReclaimer {
     pub fn new() -> Self {
         Self {
-            lru: LruCache::unbounded(),
+            active: LruCache::unbounded(),
+            inactive: LruCache::unbounded(),
+            anon_lru: LruCache::unbounded(),
+        }
+    }
+
+    fn update_lru_stats(&self) {
+        page_lru::NR_ACTIVE_FILE.store(self.active.len(), Ordering::Relaxed);
+        page_lru::NR_INACTIVE_FILE.store(self.inactive.len(), Ordering::Relaxed);
+        page_lru::NR_ANON_LRU.store(self.anon_lru.len(), Ordering::Relaxed);
+    }
+
+    /// 把匿名页加入（或移到）匿名页LRU的最近使用端
+    pub fn add_anon_page(&mut self, page: &Arc<Page>) {
+        self.anon_lru.put(page.phys_address(), Arc::downgrade(page));
+        self.update_lru_stats();
+    }
+
+    /// 从匿名页LRU的最久未使用端取出最多`count`个页面
+    pub fn drain_anon_lru(&mut self, count: usize) -> Vec<Weak<Page>> {
+        let mut victims = Vec::new();
+        for _ in 0..count {
+            match self.anon_lru.pop_lru() {
+                Some((_paddr, page)) => victims.push(page),
+                None => break,
+            }
         }
+        self.update_lru_stats();
+        victims
     }
 
     pub fn get(&mut self, paddr: &PhysAddr) -> Option<Arc<Page>> {
-        self.lru.get(paddr).cloned()
+        self.active
+            .peek(paddr)
+            .or_else(|| self.inactive.peek(paddr))
+            .cloned()
     }
 
-    pub fn insert_page(&mut self, paddr: PhysAddr, page: &Arc<Page>) {
-        self.lru.put(paddr, page.clone());
+    /// 处理每CPU批次中积攒的LRU操作
+    pub fn apply_lru_batch(&mut self, batch: Vec<(Arc<Page>, LruOp)>) {
+        let mut activated = 0;
+        for (page, op) in batch {
+            let paddr = page.phys_address();
+            match op {
+                // 页面在等待期间可能已经被移出页缓存
+                LruOp::Add => {
+                    if page.lru().transition(LruList::Pending, LruList::Inactive) {
+                        self.inactive.put(paddr, page);
+                    }
+                }
+                LruOp::Activate => {
+                    if page.lru().transition(LruList::Inactive, LruList::Active) {
+                        self.inactive.pop(&paddr);
+                        self.active.put(paddr, page);
+                        activated += 1;
+                    }
+                }
+            }
+        }
+        page_lru::count_vm_events(page_lru::VmEvent::PgActivate, activated);
+        self.update_lru_stats();
     }
 
-    pub fn remove_page(&mut self, paddr: &PhysAddr) -> Option<Arc<Page>> {
-        self.lru.pop(paddr)
+    /// 把页面移出LRU，页面离开页缓存时调用
+    ///
+    /// 还在每CPU批次中的页面会在批次提交时被跳过；正在被回收的页面不会再被放回LRU。
+    pub fn remove_page(&mut self, page: &Arc<Page>) -> Option<Arc<Page>> {
+        let paddr = page.phys_address();
+        let removed = match page.lru().set_list(LruList::None) {
+            LruList::Inactive => self.inactive.pop(&paddr),
+            LruList::Active => self.active.pop(&paddr),
+            _ => None,
+        };
+        self.update_lru_stats();
+        removed
     }
 
-    /// lru链表缩减（对外接口，内部自行获取/释放回收器锁）
+    /// 把回收失败的页面放回LRU的最近使用端
+    fn putback_page(&mut self, page: &Arc<Page>, active: bool) {
+        let paddr = page.phys_address();
+        if active {
+            if page.lru().transition(LruList::Isolated, LruList::Active) {
+                self.active.put(paddr, page.clone());
+                page_lru::count_vm_events(page_lru::VmEvent::PgActivate, 1);
+            }
+        } else if page.lru().transition(LruList::Isolated, LruList::Inactive) {
+            self.inactive.put(paddr, page.clone());
+        }
+        self.update_lru_stats();
+    }
+
+    /// 回收最多`count`个文件页（对外接口，内部自行获取/释放回收器锁），返回回收的页数
+    ///
     /// 分两阶段：
-    /// 1) 持有回收器锁，从 LRU 中摘下目标页面列表；
+    /// 1) 持有回收器锁，必要时从活跃链表补充非活跃链表，再从非活跃链表尾部摘下页面；
     /// 2) 释放回收器锁后，逐个执行写回与回收，避免锁顺序反转。
-    pub fn shrink_list(count: PageFrameCount) {
+    pub fn shrink_list(count: PageFrameCount, mode: ReclaimMode) -> usize {
+        page_lru::lru_add_drain_all();
+
         // 阶段1：仅持有回收器锁，摘取受害者
         let victims = {
             let mut reclaimer = page_reclaimer_lock();
-            reclaimer.drain_lru(count)
+            reclaimer.shrink_active_list(count.data());
+            reclaimer.isolate_inactive(count.data())
         };
+        let scanned = victims.len();
+        page_lru::NR_ISOLATED_FILE.fetch_add(scanned, Ordering::Relaxed);
 
         // 阶段2：不持有回收器锁，安全地回收页面
-        Self::evict_pages(victims);
+        let reclaimed = Self::evict_pages(victims);
+
+        page_lru::NR_ISOLATED_FILE.fetch_sub(scanned, Ordering::Relaxed);
+        page_lru::count_reclaim(mode, true, scanned, reclaimed);
+        reclaimed
+    }
+
+    /// 非活跃链表相对活跃链表过短时，扫描活跃链表尾部的最多`nr_to_scan`个页面：
+    /// 设置了访问位的页面清除访问位后移回活跃链表头部，其余页面降级到非活跃链表
+    fn shrink_active_list(&mut self, nr_to_scan: usize) {
+        let ratio = page_lru::inactive_ratio();
+        let mut scanned = 0;
+        let mut deactivated = 0;
+        while scanned < nr_to_scan && self.inactive.len() * ratio < self.active.len() {
+            let Some((paddr, page)) = self.active.pop_lru() else {
+                break;
+            };
+            scanned += 1;
+            if page.lru().test_and_clear_referenced() {
+                self.active.put(paddr, page);
+            } else {
+                page.lru().transition(LruList::Active, LruList::Inactive);
+                self.inactive.put(paddr, page);
+                deactivated += 1;
+            }
+        }
+        page_lru::count_vm_events(page_lru::VmEvent::PgRefill, scanned);
+        page_lru::count_vm_events(page_lru::VmEvent::PgDeactivate, deactivated);
+        self.update_lru_stats();
     }
 
-    /// 从 LRU 中批量弹出页面，不做任何回收操作。
-    fn drain_lru(&mut self, count: PageFrameCount) -> Vec<Arc<Page>> {
+    /// 从非活跃链表尾部摘下最多`count`个页面，不做任何回收操作
+    ///
+    /// 只被访问过一次的页面（访问位已设置但仍在非活跃链表上）同样会被回收，
+    /// 这样顺序读过的页面不会挤占活跃链表。
+    fn isolate_inactive(&mut self, count: usize) -> Vec<Arc<Page>> {
         let mut victims = Vec::new();
-        for _ in 0..count.data() {
-            match self.lru.pop_lru() {
-                Some((_paddr, page)) => victims.push(page),
+        while victims.len() < count {
+            match self.inactive.pop_lru() {
+                Some((_paddr, page)) => {
+                    page.lru().set_list(LruList::Isolated);
+                    victims.push(page);
+                }
                 None => break,
             }
         }
+        self.update_lru_stats();
         victims
     }
 
-    /// 在不持有回收器锁的情况下，完成页面写回与回收。
-    fn evict_pages(victims: Vec<Arc<Page>>) {
+    /// 在不持有回收器锁的情况下，完成页面写回与回收，返回回收的页数
+    fn evict_pages(victims: Vec<Arc<Page>>) -> usize {
+        let mut reclaimed = 0;
         for page in victims {
             let mut guard = page.write();
             if let PageType::File(info) = guard.page_type().clone() {
                 // Never evict a file-backed page that is still mapped into any VMA.
                 // Our eviction path removes the page from page_cache/page_manager; dropping a
                 // still-mapped page will trip InnerPage::drop assertions and can crash userland.
+                // 被映射的页面正在使用中，放回活跃链表。
                 if guard.map_count() != 0 {
                     drop(guard);
-                    page_reclaimer_lock().insert_page(page.phys_address(), &page);
+                    page_reclaimer_lock().putback_page(&page, true);
                     continue;
                 }
 
@@ -369,11 +650,16 @@ impl PageReclaimer {
                     guard = page.write();
                     if guard.flags().contains(PageFlags::PG_DIRTY) {
                         drop(guard);
-                        page_reclaimer_lock().insert_page(paddr, &page);
+                        page_reclaimer_lock().putback_page(&page, false);
                         continue;
                     }
                 }
 
+                // 写回期间页面可能已经被截断并移出LRU，此时它不再属于页缓存
+                if page.lru().list() != LruList::Isolated {
+                    continue;
+                }
+
                 // 删除页面：顺序为 page_cache -> page_manager，避免原有的 reclaimer 锁参与死锁
                 //
                 // FileMapInfo 内保存 Weak<PageCache> 以避免 PageCache <-> Page 的强引用环。
@@ -381,14 +667,19 @@ impl PageReclaimer {
                 if let Some(page_cache) = info.page_cache.upgrade() {
                     if !page_cache.is_page_ready(page_index) {
                         drop(guard);
-                        page_reclaimer_lock().insert_page(paddr, &page);
+                        page_reclaimer_lock().putback_page(&page, false);
                         continue;
                     }
                     let _ = page_cache.manager().remove_page(page_index);
                 }
-                page_manager_lock().remove_page(&paddr);
+                page.lru().set_list(LruList::None);
+                page_manager().remove_page(&paddr);
+                reclaimed += 1;
+            } else {
+                page.lru().set_list(LruList::None);
             }
         }
+        reclaimed
     }
 
     /// Drop clean pagecache pages only, matching Linux drop_caches semantics.
@@ -397,6 +688,9 @@ impl PageReclaimer {
             return 0;
         }
 
+        // 每CPU批次持有页面的引用，先提交批次，使这些页面可以被丢弃
+        page_lru::lru_add_drain_all();
+
         let mut dropped = 0;
         for cache in list_page_caches() {
             dropped += cache.drop_clean_pages();
@@ -407,8 +701,10 @@ impl PageReclaimer {
 
     /// 唤醒页面回收线程
     pub fn wakeup_claim_thread() {
-        // log::info!("wakeup_claim_thread");
-        let _ = ProcessManager::wakeup(unsafe { PAGE_RECLAIMER_THREAD.as_ref().unwrap() });
+        // 回收线程创建之前可能已经有页面分配触发水位检查
+        if let Some(pcb) = unsafe { PAGE_RECLAIMER_THREAD.as_ref() } {
+            let _ = ProcessManager::wakeup(pcb);
+        }
     }
 
     /// 脏页回写函数
@@ -499,8 +795,9 @@ impl PageReclaimer {
 
     /// lru脏页刷新
     fn dirty_pages_snapshot(&self) -> Vec<Arc<Page>> {
-        self.lru
+        self.inactive
             .iter()
+            .chain(self.active.iter())
             .filter_map(|(_paddr, page)| {
                 let guard = page.read();
                 if guard.flags().contains(PageFlags::PG_DIRTY) {
@@ -513,6 +810,7 @@ impl PageReclaimer {
     }
 
     pub fn flush_dirty_pages() {
+        page_lru::lru_add_drain_all();
         let pages = {
             let reclaimer = page_reclaimer_lock();
             reclaimer.dirty_pages_snapshot()
@@ -556,6 +854,7 @@ bitflags! {
         const PG_WORKINGSET = 1 << 9;
         const PG_ERROR = 1 << 10;
         const PG_SLAB = 1 << 11;
+        const PG_SWAPCACHE = 1 << 16;
         const PG_RESERVED = 1 << 14;
         const PG_PRIVATE = 1 << 15;
         const PG_RECLAIM = 1 << 18;
@@ -570,6 +869,8 @@ pub struct Page {
     inner: RwSem<InnerPage>,
     /// 页面所在物理地址
     phys_addr: PhysAddr,
+    /// 页面在文件页LRU中的状态，不需要持有`inner`的锁即可访问
+    lru: PageLruState,
 }
 
 impl Page {
@@ -590,9 +891,10 @@ impl Page {
         let page = Arc::new(Self {
             inner: RwSem::new(inner),
             phys_addr,
+            lru: PageLruState::new(),
         });
         if page.read().flags == PageFlags::PG_LRU {
-            page_reclaimer_lock().insert_page(phys_addr, &page);
+            page_lru::lru_cache_add(&page);
         };
         page
     }
@@ -613,7 +915,10 @@ impl Page {
         new_phys: PhysAddr,
     ) -> Result<Arc<Page>, SystemError> {
         let page_type = old_guard.page_type().clone();
-        let flags = *old_guard.flags();
+        // 拷贝出的页面是一个新的匿名页，不继承交换缓存状态
+        let flags = old_guard
+            .flags()
+            .difference(PageFlags::PG_SWAPCACHE | PageFlags::PG_READAHEAD);
         let inner = InnerPage::new(new_phys, page_type, flags);
         unsafe {
             let old_vaddr =
@@ -625,6 +930,7 @@ impl Page {
         Ok(Arc::new(Self {
             inner: RwSem::new(inner),
             phys_addr: new_phys,
+            lru: PageLruState::new(),
         }))
     }
 
@@ -633,6 +939,11 @@ impl Page {
         self.phys_addr
     }
 
+    #[inline(always)]
+    pub fn lru(&self) -> &PageLruState {
+        &self.lru
+    }
+
     pub fn read(&self) -> RwSemReadGuard<'_, InnerPage> {
         self.inner.read()
     }
@@ -657,6 +968,10 @@ pub struct InnerPage {
     phys_addr: PhysAddr,
     /// 页面类型
     page_type: PageType,
+    /// 页面在交换缓存中时，对应的交换槽位
+    swap_entry: Option<SwapEntry>,
+    /// 私有匿名页被映射的虚拟地址，用于换出时的反向映射
+    anon_address: Option<VirtAddr>,
 }
 
 impl InnerPage {
@@ -666,6 +981,8 @@ impl InnerPage {
             flags,
             phys_addr,
             page_type,
+            swap_entry: None,
+            anon_address: None,
         }
     }
 
@@ -693,7 +1010,30 @@ impl InnerPage {
 
     /// 判断当前物理页是否能被回
     pub fn can_deallocate(&self) -> bool {
-        self.map_count() == 0 && !self.flags.contains(PageFlags::PG_UNEVICTABLE)
+        self.map_count() == 0
+            && !self.flags.contains(PageFlags::PG_UNEVICTABLE)
+            && self.swap_entry.is_none()
+    }
+
+    #[inline(always)]
+    pub fn swap_entry(&self) -> Option<SwapEntry> {
+        self.swap_entry
+    }
+
+    /// 设置页面在交换缓存中对应的槽位，只应由交换缓存调用
+    pub fn set_swap_entry(&mut self, entry: Option<SwapEntry>) {
+        self.swap_entry = entry;
+        self.flags.set(PageFlags::PG_SWAPCACHE, entry.is_some());
+    }
+
+    #[inline(always)]
+    pub fn anon_address(&self) -> Option<VirtAddr> {
+        self.anon_address
+    }
+
+    #[inline(always)]
+    pub fn set_anon_address(&mut self, addr: Option<VirtAddr>) {
+        self.anon_address = addr;
     }
 
     pub fn shared(&self) -> bool {
@@ -957,9 +1297,22 @@ impl<Arch: MemoryManagementArch> PageTable<Arch> {
         }
     }
 
+    /// 判断第i个页表项是否为大页映射（非最后一级页表中的叶子页表项）
+    pub unsafe fn is_huge_entry(&self, i: usize) -> bool {
+        if self.level == 0 || Arch::ENTRY_FLAG_HUGE_PAGE == 0 {
+            return false;
+        }
+        self.entry(i).is_some_and(|entry| {
+            entry.present()
+                && entry.data() & Arch::ENTRY_FLAG_HUGE_PAGE == Arch::ENTRY_FLAG_HUGE_PAGE
+        })
+    }
+
     /// 获取第i个页表项指向的下一级页表
+    ///
+    /// 如果该页表项是大页映射，它指向的是数据页而不是页表，返回None
     pub unsafe fn next_level_table(&self, index: usize) -> Option<Self> {
-        if self.level == 0 {
+        if self.level == 0 || self.is_huge_entry(index) {
             return None;
         }
 
@@ -999,9 +1352,8 @@ impl<Arch: MemoryManagementArch> PageTable<Arch> {
                             new_table.set_entry(i, entry);
                         } else {
                             let phys = allocator.allocate_one()?;
-                            let mut page_manager_guard = page_manager_lock();
                             let old_phys = entry.address().unwrap();
-                            page_manager_guard.copy_page(&old_phys, allocator).ok()?;
+                            page_manager().copy_page(&old_phys, allocator).ok()?;
                             new_table.set_entry(i, PageEntry::new(phys, entry.flags()));
                         }
                     }
@@ -1557,15 +1909,13 @@ impl<Arch: MemoryManagementArch, F: FrameAllocator> PageMapper<Arch, F> {
         virt: VirtAddr,
         flags: EntryFlags<Arch>,
     ) -> Option<PageFlush<Arch>> {
-        let mut page_manager_guard = page_manager_lock();
-        let page = page_manager_guard
+        let page = page_manager()
             .create_one_page(
                 PageType::Normal,
                 PageFlags::empty(),
                 &mut self.frame_allocator,
             )
             .ok()?;
-        drop(page_manager_guard);
         let phys = page.phys_address();
         return self.map_phys(virt, phys, flags);
     }
@@ -1586,12 +1936,27 @@ impl<Arch: MemoryManagementArch, F: FrameAllocator> PageMapper<Arch, F> {
             return None;
         }
 
-        let virt = VirtAddr::new(virt.data() & (!Arch::PAGE_NEGATIVE_MASK));
-
         // TODO： 验证flags是否合法
 
         // 创建页表项
-        let entry = PageEntry::new(phys, flags);
+        self.map_entry(virt, PageEntry::new(phys, flags))
+    }
+
+    /// 在指定的虚拟地址写入一个非present的页表项（例如交换页表项），按需分配中间页表
+    pub unsafe fn map_nonpresent(&mut self, virt: VirtAddr, entry: PageEntry<Arch>) -> Option<()> {
+        if !virt.check_aligned(Arch::PAGE_SIZE) || entry.present() {
+            return None;
+        }
+        self.map_entry(virt, entry).map(|flush| flush.ignore())
+    }
+
+    /// 把最后一级页表项设置为`entry`，按需分配中间页表
+    unsafe fn map_entry(
+        &mut self,
+        virt: VirtAddr,
+        entry: PageEntry<Arch>,
+    ) -> Option<PageFlush<Arch>> {
+        let virt = VirtAddr::new(virt.data() & (!Arch::PAGE_NEGATIVE_MASK));
         let mut table = self.table();
         loop {
             let i = table.index_of(virt)?;
@@ -1608,6 +1973,13 @@ impl<Arch: MemoryManagementArch, F: FrameAllocator> PageMapper<Arch, F> {
                 if let Some(next_table) = next_table {
                     table = next_table;
                     // debug!("Mapping {:?} to next level table...", virt);
+                } else if table.is_huge_entry(i) {
+                    // 不能覆盖已有的大页映射，调用者需要先拆分大页
+                    error!(
+                        "Try to map page inside a huge page mapping: virt={:?}",
+                        virt
+                    );
+                    return None;
                 } else {
                     // 分配下一级页表
                     let frame = self.frame_allocator.allocate_one()?;
@@ -1857,6 +2229,23 @@ impl<Arch: MemoryManagementArch, F: FrameAllocator> PageMapper<Arch, F> {
         .flatten()
     }
 
+    /// 替换已有页表中的最后一级页表项，返回旧的页表项
+    ///
+    /// 与`remap_present`一样不分配也不释放页表，只需要`&self`，
+    /// 调用者需要持有地址空间的`page_table_edit`锁。
+    pub unsafe fn replace_leaf_entry(
+        &self,
+        virt: VirtAddr,
+        entry: PageEntry<Arch>,
+    ) -> Option<(PageEntry<Arch>, PageFlush<Arch>)> {
+        self.visit(virt, |p1, i| {
+            let old = p1.entry(i)?;
+            p1.set_entry(i, entry);
+            Some((old, PageFlush::new(virt)))
+        })
+        .flatten()
+    }
+
     /// 根据虚拟地址，查找页表，获取对应的物理地址和页表项的flags
     ///
     /// ## 参数
@@ -1867,10 +2256,61 @@ impl<Arch: MemoryManagementArch, F: FrameAllocator> PageMapper<Arch, F> {
     ///
     /// 如果查找成功，返回物理地址和页表项的flags，否则返回None
     pub fn translate(&self, virt: VirtAddr) -> Option<(PhysAddr, EntryFlags<Arch>)> {
-        let entry: PageEntry<Arch> = self.visit(virt, |p1, i| unsafe { p1.entry(i) })??;
-        let paddr = entry.address().ok()?;
-        let flags = entry.flags();
-        return Some((paddr, flags));
+        let mut table = self.table();
+        unsafe {
+            loop {
+                let i = table.index_of(virt)?;
+                if table.level() == 0 {
+                    let entry = table.entry(i)?;
+                    let paddr = entry.address().ok()?;
+                    return Some((paddr, entry.flags()));
+                }
+
+                if table.is_huge_entry(i) {
+                    // 大页映射：返回虚拟地址所在的4K子页的物理地址
+                    let entry = table.entry(i)?;
+                    let huge_size = Arch::PAGE_SIZE << (table.level() * Arch::PAGE_ENTRY_SHIFT);
+                    let offset = virt.data() & (huge_size - 1) & !(Arch::PAGE_SIZE - 1);
+                    let paddr = entry.address().ok()?.add(offset);
+                    return Some((paddr, entry.flags()));
+                }
+
+                table = table.next_level_table(i)?;
+            }
+        }
+    }
+
+    /// 获取虚拟地址所在的PMD级大页映射的页表项
+    ///
+    /// 如果该地址不在大页映射中，返回None
+    pub fn huge_pmd(&self, virt: VirtAddr) -> Option<PageEntry<Arch>> {
+        let table = self.get_table(virt, 1)?;
+        let i = table.index_of(virt)?;
+        unsafe {
+            if table.is_huge_entry(i) {
+                table.entry(i)
+            } else {
+                None
+            }
+        }
+    }
+
+    /// 替换虚拟地址对应的PMD级页表项，返回原来的页表项
+    ///
+    /// 只修改页表项本身，不分配/释放任何页面，也不刷新TLB。
+    /// 用于大页映射与页表之间的相互转换（拆分/合并透明大页）。
+    pub unsafe fn replace_pmd(
+        &mut self,
+        virt: VirtAddr,
+        entry: PageEntry<Arch>,
+    ) -> Option<PageEntry<Arch>> {
+        let table = self.get_table(virt, 1)?;
+        let i = table.index_of(virt)?;
+        let old = table.entry(i)?;
+        compiler_fence(Ordering::SeqCst);
+        table.set_entry(i, entry)?;
+        compiler_fence(Ordering::SeqCst);
+        Some(old)
     }
 
     /// 取消虚拟地址的映射，释放页面，并返回页表项刷新器
@@ -2020,6 +2460,13 @@ unsafe fn unmap_phys_inner<Arch: MemoryManagementArch>(
         return Some((entry.address().ok()?, entry.flags()));
     }
 
+    // 大页映射：整个大页一起取消映射，返回大页的起始物理地址
+    if table.is_huge_entry(i) {
+        let entry = table.entry(i)?;
+        table.set_entry(i, PageEntry::from_usize(0));
+        return Some((entry.address().ok()?, entry.flags()));
+    }
+
     let subtable = table.next_level_table(i)?;
     // 递归地取消映射
     let result = unmap_phys_inner(vaddr, &subtable, unmap_parents, allocator, freed_tables)?;
@@ -2029,10 +2476,10 @@ unsafe fn unmap_phys_inner<Arch: MemoryManagementArch>(
     if unmap_parents {
         // 如果子页表已经没有映射的页面了，就取消子页表的映射
 
-        // 检查子页表中是否还有映射的页面
+        // 检查子页表中是否还有映射的页面（包括交换页表项等非present的页表项）
         let x = (0..Arch::PAGE_ENTRY_NUM)
             .map(|k| subtable.entry(k).expect("invalid page entry"))
-            .any(|e| e.present());
+            .any(|e| !e.empty());
         if !x {
             // 如果没有，就取消子页表的映射
             table.set_entry(i, PageEntry::from_usize(0));
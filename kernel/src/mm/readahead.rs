@@ -1,15 +1,28 @@
+//! 文件按需预读
+//!
+//! 算法与Linux的ondemand readahead相同：
+//! - 每个打开的文件维护一个预读窗口`[start, start + size)`，其中最后`async_size`页
+//!   是异步部分，异步部分的第一页带有预读标记；
+//! - 读到缺失的页面时发起同步预读，读到带标记的页面时提前发起下一个窗口，
+//!   窗口在顺序命中时按4倍/2倍增长到`ra_pages`；
+//! - 命中标记但和本文件的窗口对不上时（同一文件上交错的多个顺序流），
+//!   通过页缓存中已有的页面重建窗口；
+//! - 随机读只读取请求本身，并把窗口重置为空，下一次顺序读重新从初始大小开始。
+
 use crate::{
     arch::MMArch,
     filesystem::{page_cache::PageCache, vfs::IndexNode},
-    libs::ranges::merge_ranges,
-    mm::{page::PageFlags, MemoryManagementArch},
+    mm::{
+        lru::{count_vm_events, VmEvent},
+        MemoryManagementArch,
+    },
 };
-use alloc::{sync::Arc, vec::Vec};
-use num_traits::abs_sub;
+use alloc::sync::Arc;
 use system_error::SystemError;
 
+/// 默认的最大预读窗口（页数），块设备可以通过`/sys/block/<disk>/queue/read_ahead_kb`修改
 // TODO: 以后其他方面提高了io速度，可以减小到32
-pub const MAX_READAHEAD: usize = 128;
+pub const VM_READAHEAD_PAGES: usize = 128;
 
 /// 文件预读状态
 #[derive(Debug, Clone)]
@@ -20,7 +33,7 @@ pub struct FileReadaheadState {
     pub size: usize,
     /// 异步预读部分的大小（页数）
     pub async_size: usize,
-    /// 最大预读窗口大小（页数），可配置
+    /// 最大预读窗口大小（页数），可配置，为0时关闭预读
     pub ra_pages: usize,
     /// 上一次访问的页索引（用于顺序判断）
     pub prev_index: i64,
@@ -28,26 +41,34 @@ pub struct FileReadaheadState {
 
 impl FileReadaheadState {
     /// 创建新的预读状态
-    pub fn new() -> Self {
+    ///
+    /// ## 参数
+    /// - `ra_pages`: 最大预读窗口大小，一般取自文件所在块设备
+    pub fn new(ra_pages: usize) -> Self {
         Self {
             start: 0,
             size: 0,
             async_size: 0,
-            ra_pages: MAX_READAHEAD,
+            ra_pages,
             prev_index: -1,
         }
     }
 
-    /// 第一次顺序读
-    /// 可以理解为之前随机读了一次，然后紧接着顺序读下去
-    pub fn first_sequential(&self, page_index: usize) -> bool {
-        abs_sub(page_index as i64, self.prev_index) <= 1
+    /// 本次访问是否紧接着上一次访问（同一页或下一页）
+    pub fn is_sequential(&self, page_index: usize) -> bool {
+        let delta = page_index as i64 - self.prev_index;
+        (0..=1).contains(&delta)
+    }
+
+    /// 当前窗口中带预读标记的页
+    fn marker_index(&self) -> usize {
+        self.start + self.size - self.async_size
     }
 }
 
 impl Default for FileReadaheadState {
     fn default() -> Self {
-        Self::new()
+        Self::new(VM_READAHEAD_PAGES)
     }
 }
 
@@ -65,157 +86,166 @@ pub struct ReadaheadControl<'a> {
 }
 
 impl<'a> ReadaheadControl<'a> {
+    /// 第一次顺序读的窗口大小：小请求放大4倍，中等请求放大2倍
     fn get_init_ra_size(req_size: usize, max_pages: usize) -> usize {
-        let newsize = match req_size.checked_next_power_of_two() {
-            Some(newsize) => newsize,
-            None => req_size,
-        };
+        let newsize = req_size.checked_next_power_of_two().unwrap_or(req_size);
 
-        if newsize < max_pages / 32 {
+        if newsize <= max_pages / 32 {
             newsize * 4
-        } else if newsize < max_pages / 4 {
+        } else if newsize <= max_pages / 4 {
             newsize * 2
         } else {
-            newsize
+            max_pages
         }
     }
 
+    /// 顺序命中后下一个窗口的大小
     fn get_next_ra_size(cur_ra_size: usize, max_pages: usize) -> usize {
         if cur_ra_size < max_pages / 16 {
-            return 4 * cur_ra_size;
+            4 * cur_ra_size
+        } else if cur_ra_size <= max_pages / 2 {
+            2 * cur_ra_size
+        } else {
+            max_pages
         }
-        core::cmp::min(cur_ra_size * 2, max_pages)
     }
 
-    /// 执行实际的页缓存预读
-    /// 由于目前DragonOS不支持异步，
-    /// 所以直接把整个窗口同步读完
+    /// 为`[self.index, self.index + nr_to_read)`中不在缓存里的页面发起异步读取
+    ///
+    /// `lookahead_size`不为0时，在倒数第`lookahead_size`页上打预读标记，
+    /// 读到这一页时发起下一个窗口。
     fn do_page_cache_readahead(
         &self,
-        number_to_read: usize,
-        mut set_flag: bool,
+        nr_to_read: usize,
+        lookahead_size: usize,
     ) -> Result<usize, SystemError> {
-        let page_cache = self.page_cache;
-        let start_index = self.index;
-
-        if set_flag {
-            set_flag = page_cache
-                .manager()
-                .peek_page(self.ra_state.start + self.ra_state.size - self.ra_state.async_size)
-                .is_none();
-        }
-
-        let missing_pages: Vec<_> = (0..number_to_read)
-            .map(|i| start_index + i)
-            .filter(|&idx| !page_cache.is_page_ready(idx))
-            .collect();
-
-        if missing_pages.is_empty() {
+        let file_size = self.inode.metadata()?.size.max(0) as usize;
+        if file_size == 0 || nr_to_read == 0 {
             return Ok(0);
         }
-
-        let ranges = merge_ranges(&missing_pages);
-        let mut total_read = 0;
-        let file_size = self.inode.metadata()?.size.max(0) as usize;
-        if file_size == 0 {
+        let end_index = (file_size - 1) >> MMArch::PAGE_SHIFT;
+        if self.index > end_index {
             return Ok(0);
         }
+        let nr_to_read = core::cmp::min(nr_to_read, end_index - self.index + 1);
 
-        for (page_index, count) in ranges {
-            let start_offset = page_index * MMArch::PAGE_SIZE;
-            let end_offset = core::cmp::min((page_index + count) * MMArch::PAGE_SIZE, file_size);
-            if end_offset <= start_offset {
-                continue;
-            }
-            let actual_page_count =
-                (end_offset - start_offset + MMArch::PAGE_SIZE - 1) >> MMArch::PAGE_SHIFT;
-            page_cache.read_pages(page_index, actual_page_count)?;
-            total_read += actual_page_count;
-        }
+        let marker = if lookahead_size > 0 && lookahead_size <= nr_to_read {
+            Some(self.index + nr_to_read - lookahead_size)
+        } else {
+            None
+        };
 
-        if set_flag {
-            if let Some(page) = page_cache
-                .manager()
-                .peek_page(self.ra_state.start + self.ra_state.size - self.ra_state.async_size)
-            {
-                // log::debug!(
-                //     "set ra flag at {}",
-                //     self.ra_state.start + self.ra_state.size - self.ra_state.async_size
-                // );
-                page.write().add_flags(PageFlags::PG_READAHEAD);
-            }
+        let submitted = self.page_cache.read_pages(self.index, nr_to_read, marker)?;
+        count_vm_events(VmEvent::FileRa, submitted);
+        Ok(submitted)
+    }
+
+    /// 根据页缓存中`index`之前连续缓存的页面数判断是否是顺序流
+    ///
+    /// 用于同一文件上交错的多个读者：本文件的窗口属于另一个流，但页缓存里的
+    /// 历史页面说明当前位置也在被顺序读取。
+    fn try_context_readahead(&mut self, req_size: usize, max_pages: usize) -> bool {
+        let index = self.index;
+        if index == 0 {
+            return false;
+        }
+        let history = match self.page_cache.prev_miss(index - 1, max_pages) {
+            Some(head) => index - 1 - head,
+            None => index,
+        };
+        if history <= req_size {
+            return false;
         }
+        // 从文件开头起一直是顺序读，大概率会继续读下去
+        let size = if history >= index {
+            history * 2
+        } else {
+            history
+        };
 
-        Ok(total_read)
+        self.ra_state.start = index;
+        self.ra_state.size = core::cmp::min(size + req_size, max_pages);
+        self.ra_state.async_size = 1;
+        true
     }
 
     /// 按需预读算法
     ///
     /// ## 参数
-    /// - `ractl`: 预读控制器
     /// - `req_size`: 本次请求的大小（页数）
-    /// - `is_async`: 是否是异步触发
+    /// - `hit_marker`: 是否因为读到预读标记而触发
     ///
     /// ## 返回值
-    /// - `Ok(usize)`: 预读的页数
+    /// - `Ok(usize)`: 发起读取的页数
     pub fn ondemand_readahead(
         &mut self,
         req_size: usize,
-        is_async: bool,
+        hit_marker: bool,
     ) -> Result<usize, SystemError> {
-        let ra_state = &mut *self.ra_state;
-        let start_index = self.index;
-        let max_pages = core::cmp::max(ra_state.ra_pages, req_size);
-        let file_size = self.inode.metadata()?.size as usize;
-        let end_index = if file_size > 0 {
-            (file_size - 1) >> MMArch::PAGE_SHIFT
-        } else {
+        if self.ra_state.ra_pages == 0 {
             return Ok(0);
-        };
+        }
+        let max_pages = core::cmp::max(self.ra_state.ra_pages, req_size);
+        let index = self.index;
 
-        if is_async {
-            // 第二次及以后的连续读
-            let next_missing_page = {
-                (start_index..start_index + max_pages)
-                    .find(|idx| !self.page_cache.is_page_ready(*idx))
-            };
+        let readit = 'decide: {
+            if index == 0 {
+                break 'decide false;
+            }
+
+            let ra_state = &mut *self.ra_state;
+            // 正好读到了预期的位置（窗口的标记页或者窗口末尾），窗口向后推进并增长
+            if ra_state.size != 0
+                && (index == ra_state.marker_index() || index == ra_state.start + ra_state.size)
+            {
+                ra_state.start += ra_state.size;
+                ra_state.size = Self::get_next_ra_size(ra_state.size, max_pages);
+                ra_state.async_size = ra_state.size;
+                break 'decide true;
+            }
 
-            if let Some(next_missing_page) = next_missing_page {
-                if next_missing_page - start_index > max_pages {
+            // 命中了标记，但不是本文件窗口里的标记：根据已缓存的页面重建窗口
+            if hit_marker {
+                let start = self.page_cache.next_miss(index + 1, max_pages);
+                if start - index > max_pages {
                     return Ok(0);
                 }
-                ra_state.start = next_missing_page;
-                ra_state.size = ra_state.start - start_index + req_size;
+                ra_state.start = start;
+                ra_state.size = start - index + req_size;
                 ra_state.size = Self::get_next_ra_size(ra_state.size, max_pages);
                 ra_state.async_size = ra_state.size;
-            } else {
-                return Ok(0);
+                break 'decide true;
             }
-        } else if start_index == 0 || ra_state.first_sequential(start_index) {
-            // 从头读或者第一次顺序读
 
-            let mut number_to_read = Self::get_init_ra_size(req_size, max_pages);
-            if start_index + number_to_read > end_index + 1 {
-                number_to_read = (end_index + 1).saturating_sub(start_index);
+            // 大请求或者顺序读，重新开始一个窗口
+            if req_size > max_pages || ra_state.is_sequential(index) {
+                break 'decide false;
             }
 
-            if number_to_read == 0 {
-                return Ok(0);
+            if self.try_context_readahead(req_size, max_pages) {
+                break 'decide true;
             }
 
-            ra_state.start = start_index;
-            ra_state.size = number_to_read;
+            // 随机读：只读请求本身，窗口回退到初始状态
+            self.ra_state.start = index;
+            self.ra_state.size = 0;
+            self.ra_state.async_size = 0;
+            return self.do_page_cache_readahead(req_size, 0);
+        };
+
+        let ra_state = &mut *self.ra_state;
+        if !readit {
+            ra_state.start = index;
+            ra_state.size = Self::get_init_ra_size(req_size, max_pages);
             ra_state.async_size = if ra_state.size > req_size {
                 ra_state.size - req_size
             } else {
                 ra_state.size
             };
-        } else {
-            return Ok(0);
-        };
+        }
 
-        // 避免设置了标记之后立即踩中
-        if start_index == ra_state.start && ra_state.size == ra_state.async_size {
+        // 避免设置了标记之后立即踩中：把下一个窗口合并进来
+        if index == ra_state.start && ra_state.size == ra_state.async_size {
             let add_pages = Self::get_next_ra_size(ra_state.size, max_pages);
             if ra_state.size + add_pages <= max_pages {
                 ra_state.async_size = add_pages;
@@ -225,17 +255,14 @@ impl<'a> ReadaheadControl<'a> {
                 ra_state.async_size = max_pages >> 1;
             }
         }
-        // log::debug!("is_async: {}, start: {}, size: {}, async_size: {}", is_async, ra_state.start, ra_state.size, ra_state.async_size);
 
         self.index = ra_state.start;
-        let nr_to_read = ra_state.size;
-        let read_count = self.do_page_cache_readahead(nr_to_read, true)?;
-
-        Ok(read_count)
+        let (size, async_size) = (ra_state.size, ra_state.async_size);
+        self.do_page_cache_readahead(size, async_size)
     }
 }
 
-/// 同步预读入口 - 缺页时调用
+/// 同步预读入口 - 读到不在缓存中的页面时调用
 pub fn page_cache_sync_readahead(
     page_cache: &Arc<PageCache>,
     inode: &Arc<dyn IndexNode>,
@@ -243,6 +270,7 @@ pub fn page_cache_sync_readahead(
     index: usize,
     req_size: usize,
 ) -> Result<usize, SystemError> {
+    count_vm_events(VmEvent::FileRaSync, 1);
     let mut ractl = ReadaheadControl {
         page_cache,
         inode,
@@ -253,7 +281,7 @@ pub fn page_cache_sync_readahead(
     ractl.ondemand_readahead(req_size, false)
 }
 
-/// 异步预读入口 - 命中 PG_READAHEAD 标志时调用
+/// 异步预读入口 - 读到带预读标记的页面时调用
 pub fn page_cache_async_readahead(
     page_cache: &Arc<PageCache>,
     inode: &Arc<dyn IndexNode>,
@@ -261,11 +289,12 @@ pub fn page_cache_async_readahead(
     index: usize,
     req_size: usize,
 ) -> Result<usize, SystemError> {
+    count_vm_events(VmEvent::FileRaAsync, 1);
     let mut ractl = ReadaheadControl {
         page_cache,
         inode,
         ra_state,
-        index: index + 1,
+        index,
     };
 
     ractl.ondemand_readahead(req_size, true)
@@ -302,7 +331,7 @@ pub fn force_page_cache_readahead(
         let chunk = core::cmp::min(chunk, end_index - index + 1);
 
         ractl.index = index;
-        total_read += ractl.do_page_cache_readahead(chunk, false)?;
+        total_read += ractl.do_page_cache_readahead(chunk, 0)?;
 
         index += chunk;
         remaining -= chunk;
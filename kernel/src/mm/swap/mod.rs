@@ -0,0 +1,123 @@
+//! 匿名页的交换（swap）
+//!
+//! 内存紧张时，页面回收线程把不常访问的私有匿名页写到交换设备（块设备或交换文件）上，
+//! 并把映射它的页表项替换为记录了交换位置的非present页表项（swap entry）。
+//! 进程再次访问这些地址时，缺页处理把页面从交换设备读回。
+//!
+//! - `swapfile`: 交换设备的管理（swapon/swapoff）与交换槽位的分配、引用计数
+//! - `swap_state`: 交换缓存，以及换入时对相邻槽位的预读
+//! - `vmscan`: 匿名页LRU的扫描、反向映射与换出
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use alloc::sync::Arc;
+
+use crate::{
+    arch::MMArch,
+    mm::{
+        page::{page_reclaimer_lock, Page, PageEntry},
+        MemoryManagementArch,
+    },
+};
+
+pub mod swap_state;
+pub mod swapfile;
+pub mod vmscan;
+
+/// 最多同时启用的交换设备数量
+pub const MAX_SWAPFILES: usize = 1 << SWP_TYPE_BITS;
+
+/// 交换设备编号占用的位数
+const SWP_TYPE_BITS: usize = 5;
+/// 槽位号占用的位数
+const SWP_OFFSET_BITS: usize = 32;
+
+/// 最大的槽位号（不含）
+pub const SWP_OFFSET_MAX: usize = 1 << SWP_OFFSET_BITS;
+
+static PSWPIN: AtomicUsize = AtomicUsize::new(0);
+static PSWPOUT: AtomicUsize = AtomicUsize::new(0);
+static SWAP_RA: AtomicUsize = AtomicUsize::new(0);
+static SWAP_RA_HIT: AtomicUsize = AtomicUsize::new(0);
+
+/// 交换槽位的位置：交换设备编号 + 设备内的页号
+///
+/// 写入页表项时，编号和页号放在物理地址字段中，低位的标志位全部为0，
+/// 因此交换页表项既不是present的，也不会被误认为是PROT_NONE映射。
+/// 槽位0保存交换区头部，永远不会被分配，所以交换页表项一定非0。
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct SwapEntry(usize);
+
+impl SwapEntry {
+    pub fn new(ty: usize, offset: usize) -> Self {
+        debug_assert!(ty < MAX_SWAPFILES && offset < SWP_OFFSET_MAX);
+        Self((offset << SWP_TYPE_BITS) | ty)
+    }
+
+    /// 交换设备编号
+    #[inline(always)]
+    pub fn ty(&self) -> usize {
+        self.0 & (MAX_SWAPFILES - 1)
+    }
+
+    /// 设备内的页号
+    #[inline(always)]
+    pub fn offset(&self) -> usize {
+        self.0 >> SWP_TYPE_BITS
+    }
+
+    /// 编码为非present的页表项
+    #[inline(always)]
+    pub fn to_pte(&self) -> PageEntry<MMArch> {
+        PageEntry::from_usize(self.0 << MMArch::PAGE_SHIFT)
+    }
+
+    /// 从页表项中解析交换位置，不是交换页表项时返回None
+    #[inline(always)]
+    pub fn from_pte(entry: &PageEntry<MMArch>) -> Option<Self> {
+        let data = entry.data();
+        if data == 0 || data & (MMArch::PAGE_SIZE - 1) != 0 || entry.present() {
+            return None;
+        }
+        let val = data >> MMArch::PAGE_SHIFT;
+        if val >> (SWP_TYPE_BITS + SWP_OFFSET_BITS) != 0 {
+            return None;
+        }
+        Some(Self(val))
+    }
+}
+
+/// 交换相关的统计信息，用于`/proc/vmstat`
+#[derive(Debug, Clone, Copy, Default)]
+pub struct SwapStatsSnapshot {
+    pub pswpin: u64,
+    pub pswpout: u64,
+    pub swap_ra: u64,
+    pub swap_ra_hit: u64,
+}
+
+pub fn swap_stats() -> SwapStatsSnapshot {
+    SwapStatsSnapshot {
+        pswpin: PSWPIN.load(Ordering::Relaxed) as u64,
+        pswpout: PSWPOUT.load(Ordering::Relaxed) as u64,
+        swap_ra: SWAP_RA.load(Ordering::Relaxed) as u64,
+        swap_ra_hit: SWAP_RA_HIT.load(Ordering::Relaxed) as u64,
+    }
+}
+
+/// 是否有已启用的交换设备
+#[inline(always)]
+pub fn swap_active() -> bool {
+    swapfile::nr_swapfiles() != 0
+}
+
+/// 把私有匿名页加入匿名页LRU，使其可以被换出
+///
+/// 没有启用交换设备时匿名页无法回收，不做任何事，避免在缺页路径上竞争回收器锁。
+/// 启用第一个交换设备时，已有的匿名页会被统一加入LRU（见`vmscan::populate_anon_lru`）。
+pub fn lru_cache_add_anon(page: &Arc<Page>) {
+    if !swap_active() {
+        return;
+    }
+    page_reclaimer_lock().add_anon_page(page);
+}
@@ -0,0 +1,319 @@
+//! 交换缓存
+//!
+//! 正在换出、刚刚换入、或者被多个交换页表项共享的页面保存在交换缓存中，
+//! 以交换位置为键。换入时先查交换缓存，保证同一个槽位在内存中只有一份拷贝。
+//!
+//! 缺页换入时会把同一个对齐簇（`SWAP_CLUSTER_PAGES`页）中其他仍被引用的槽位
+//! 一并读入交换缓存，这些页面通常是同一时间被换出的相邻页面。
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use alloc::{sync::Arc, vec, vec::Vec};
+use hashbrown::HashMap;
+use system_error::SystemError;
+
+use crate::{
+    arch::{
+        mm::{LockedFrameAllocator, PageMapper},
+        MMArch,
+    },
+    libs::spinlock::SpinLock,
+    mm::{
+        page::{page_manager, InnerPage, Page, PageEntry, PageFlags, PageType},
+        ucontext::{AddressSpace, LockedVMA},
+        MemoryManagementArch, VirtAddr, VmFlags,
+    },
+    sched::sched_yield,
+};
+
+use super::{
+    lru_cache_add_anon,
+    swapfile::{
+        swap_cluster_range, swap_count, swap_free, swap_info_get, swapcache_clear,
+        swapcache_prepare,
+    },
+    SwapEntry, PSWPIN, SWAP_RA, SWAP_RA_HIT,
+};
+
+/// 换入预读的簇大小（页），对应Linux的page-cluster=3
+const SWAP_CLUSTER_PAGES: usize = 8;
+
+static SWAP_CACHE: SpinLock<Option<HashMap<SwapEntry, Arc<Page>>>> = SpinLock::new(None);
+static SWAP_CACHE_PAGES: AtomicUsize = AtomicUsize::new(0);
+
+/// 交换缓存中的页面数
+pub fn swap_cache_pages() -> usize {
+    SWAP_CACHE_PAGES.load(Ordering::Relaxed)
+}
+
+pub fn lookup_swap_cache(entry: SwapEntry) -> Option<Arc<Page>> {
+    SWAP_CACHE.lock().as_ref()?.get(&entry).cloned()
+}
+
+/// 把页面加入交换缓存，调用者需要已经通过`swapcache_prepare`或`get_swap_page`
+/// 为槽位标记了`SWAP_HAS_CACHE`
+pub fn add_to_swap_cache(entry: SwapEntry, page: &Arc<Page>, guard: &mut InnerPage) {
+    guard.set_swap_entry(Some(entry));
+    SWAP_CACHE
+        .lock()
+        .get_or_insert_with(HashMap::new)
+        .insert(entry, page.clone());
+    SWAP_CACHE_PAGES.fetch_add(1, Ordering::Relaxed);
+}
+
+/// 把页面移出交换缓存，并释放它对槽位的缓存引用
+pub fn delete_from_swap_cache(guard: &mut InnerPage) {
+    let Some(entry) = guard.swap_entry() else {
+        return;
+    };
+    guard.set_swap_entry(None);
+    let removed = SWAP_CACHE.lock().as_mut().and_then(|c| c.remove(&entry));
+    if removed.is_some() {
+        SWAP_CACHE_PAGES.fetch_sub(1, Ordering::Relaxed);
+    }
+    swapcache_clear(entry);
+    // 调用者持有页面的另一个引用，这里不会析构页面
+    drop(removed);
+}
+
+/// 页面不再被任何页表引用、且交换槽位也没有交换页表项引用时，把页面移出交换缓存
+///
+/// 返回页面是否已经不在交换缓存中
+pub fn try_to_free_swap(guard: &mut InnerPage) -> bool {
+    let Some(entry) = guard.swap_entry() else {
+        return true;
+    };
+    if guard.map_count() != 0 || swap_count(entry) != 0 {
+        return false;
+    }
+    delete_from_swap_cache(guard);
+    true
+}
+
+/// 写时复制缺页时判断能否原地复用交换缓存中的页面
+///
+/// 只有当没有其他交换页表项还引用同一个槽位时才能复用，复用的页面会被移出交换缓存，
+/// 交换设备上的旧内容随之作废。
+pub fn reuse_swap_page(guard: &mut InnerPage) -> bool {
+    let Some(entry) = guard.swap_entry() else {
+        return true;
+    };
+    if swap_count(entry) != 0 {
+        return false;
+    }
+    delete_from_swap_cache(guard);
+    true
+}
+
+/// 丢弃交换缓存中属于设备`ty`、且没有被任何页表引用的页面（swapoff时调用）
+pub fn drop_swap_cache_of(ty: usize) {
+    let pages: Vec<Arc<Page>> = match SWAP_CACHE.lock().as_ref() {
+        Some(cache) => cache
+            .iter()
+            .filter(|(entry, _)| entry.ty() == ty)
+            .map(|(_, page)| page.clone())
+            .collect(),
+        None => return,
+    };
+    for page in pages {
+        let mut guard = page.write();
+        if guard.map_count() == 0 && guard.swap_entry().is_some_and(|e| swap_count(e) == 0) {
+            delete_from_swap_cache(&mut guard);
+            drop(guard);
+            page_manager().remove_page(&page.phys_address());
+        }
+    }
+}
+
+/// 交换页表项被清除时，释放它对槽位的引用
+///
+/// 如果这是最后一个引用，且交换缓存中的页面没有被映射，页面也一并释放。
+/// 返回需要由调用者释放的页面。
+pub fn free_swap_and_cache(entry: SwapEntry) -> Option<Arc<Page>> {
+    swap_free(entry);
+    if swap_count(entry) != 0 {
+        return None;
+    }
+    let page = lookup_swap_cache(entry)?;
+    let mut guard = page.write();
+    if guard.swap_entry() != Some(entry) || guard.map_count() != 0 {
+        return None;
+    }
+    delete_from_swap_cache(&mut guard);
+    drop(guard);
+    page_manager().remove_page(&page.phys_address())
+}
+
+/// 清除`virt`处的交换页表项（munmap、MADV_DONTNEED等）
+///
+/// 调用者需要持有地址空间的`page_table_edit`锁。返回是否清除了交换页表项。
+pub unsafe fn zap_swap_pte(mapper: &PageMapper, virt: VirtAddr) -> bool {
+    let Some(entry) = mapper
+        .get_entry(virt, 0)
+        .and_then(|pte| SwapEntry::from_pte(&pte))
+    else {
+        return false;
+    };
+    if let Some((_, flush)) = mapper.replace_leaf_entry(virt, PageEntry::from_usize(0)) {
+        // 交换页表项不会被TLB缓存
+        flush.ignore();
+    }
+    drop(free_swap_and_cache(entry));
+    true
+}
+
+/// 为一个已经标记`SWAP_HAS_CACHE`的槽位分配页面，失败时撤销标记
+fn alloc_swap_page(entry: SwapEntry) -> Result<Arc<Page>, SystemError> {
+    page_manager()
+        .create_one_page(
+            PageType::Normal,
+            PageFlags::empty(),
+            &mut LockedFrameAllocator,
+        )
+        .inspect_err(|_| swapcache_clear(entry))
+}
+
+/// 读入失败时撤销槽位的`SWAP_HAS_CACHE`标记并释放页面
+fn abort_swap_page(entry: SwapEntry, page: Arc<Page>) {
+    swapcache_clear(entry);
+    page_manager().remove_page(&page.phys_address());
+}
+
+/// 把交换槽位读入交换缓存，同时预读同一簇中其他仍被引用的槽位
+///
+/// 页面在读入完成后才加入交换缓存；在此期间其他换入同一槽位的路径会在
+/// `swapcache_prepare`处得到EEXIST并等待。
+/// 返回交换缓存中的目标页面。槽位已经被释放时返回ENOENT，调用者应重新检查页表项。
+pub fn swapin_readahead(entry: SwapEntry) -> Result<Arc<Page>, SystemError> {
+    loop {
+        if let Some(page) = lookup_swap_cache(entry) {
+            if page.read().flags().contains(PageFlags::PG_READAHEAD) {
+                SWAP_RA_HIT.fetch_add(1, Ordering::Relaxed);
+            }
+            return Ok(page);
+        }
+        match swapcache_prepare(entry) {
+            Ok(()) => break,
+            Err(SystemError::EEXIST) => sched_yield(),
+            Err(e) => return Err(e),
+        }
+    }
+
+    let Some(si) = swap_info_get(entry.ty()) else {
+        swapcache_clear(entry);
+        return Err(SystemError::ENOENT);
+    };
+    let target = alloc_swap_page(entry)?;
+
+    // 只预读同一簇中仍被引用、且没有在交换缓存中的槽位
+    let (lo, hi) = swap_cluster_range(entry, SWAP_CLUSTER_PAGES)
+        .unwrap_or((entry.offset(), entry.offset() + 1));
+    let mut pages: Vec<(SwapEntry, Arc<Page>)> = Vec::with_capacity(hi - lo);
+    for offset in lo..hi {
+        if offset == entry.offset() {
+            pages.push((entry, target.clone()));
+            continue;
+        }
+        let ra_entry = SwapEntry::new(entry.ty(), offset);
+        if swapcache_prepare(ra_entry).is_err() {
+            continue;
+        }
+        if let Ok(page) = alloc_swap_page(ra_entry) {
+            pages.push((ra_entry, page));
+        }
+    }
+
+    // 用一次I/O读入覆盖所有需要的槽位的连续区间
+    let first = pages.first().unwrap().0.offset();
+    let last = pages.last().unwrap().0.offset();
+    let mut buf = vec![0u8; (last - first + 1) * MMArch::PAGE_SIZE];
+    if let Err(e) = si.read_pages(first, &mut buf) {
+        log::error!("swapin: read {:?} failed: {:?}", entry, e);
+        for (e, page) in pages {
+            abort_swap_page(e, page);
+        }
+        return Err(SystemError::EIO);
+    }
+
+    for (e, page) in pages {
+        let start = (e.offset() - first) * MMArch::PAGE_SIZE;
+        let mut guard = page.write();
+        unsafe { guard.copy_from_slice(&buf[start..start + MMArch::PAGE_SIZE]) };
+        if e != entry {
+            guard.add_flags(PageFlags::PG_READAHEAD);
+            SWAP_RA.fetch_add(1, Ordering::Relaxed);
+        }
+        add_to_swap_cache(e, &page, &mut guard);
+        drop(guard);
+        if e != entry {
+            lru_cache_add_anon(&page);
+        }
+        PSWPIN.fetch_add(1, Ordering::Relaxed);
+    }
+    Ok(target)
+}
+
+/// 把`addr`处的交换页表项换入内存并重新建立映射
+///
+/// 缺页处理和swapoff共用。如果页表项已经不是`entry`（被其他路径处理过），直接返回成功。
+/// 返回EAGAIN表示交换缓存中的页面在此期间被回收，调用者应重试。
+pub unsafe fn do_swap_in(
+    mapper: &mut PageMapper,
+    mm: &Arc<AddressSpace>,
+    vma: &Arc<LockedVMA>,
+    addr: VirtAddr,
+    entry: SwapEntry,
+) -> Result<(), SystemError> {
+    let page = match swapin_readahead(entry) {
+        Ok(page) => page,
+        Err(SystemError::ENOENT) => return Ok(()),
+        Err(e) => return Err(e),
+    };
+
+    let _pte = mm.pte_lock(addr);
+    let still_swapped = mapper
+        .get_entry(addr, 0)
+        .and_then(|pte| SwapEntry::from_pte(&pte))
+        == Some(entry);
+    if !still_swapped {
+        try_to_free_swap(&mut page.write());
+        return Ok(());
+    }
+
+    let (mut flags, mlocked) = {
+        let guard = vma.lock();
+        (guard.flags(), guard.vm_flags().contains(VmFlags::VM_LOCKED))
+    };
+
+    let mut guard = page.write();
+    if guard.swap_entry() != Some(entry) {
+        return Err(SystemError::EAGAIN);
+    }
+    guard.remove_flags(PageFlags::PG_READAHEAD);
+
+    // 还有其他交换页表项引用这个槽位时，以只读方式映射，写入时再走写时复制
+    let exclusive = swap_count(entry) == 1;
+    if !exclusive {
+        flags = flags.set_write(false);
+    }
+    let Some((_, flush)) =
+        mapper.replace_leaf_entry(addr, PageEntry::new(page.phys_address(), flags))
+    else {
+        return Err(SystemError::EFAULT);
+    };
+    flush.flush();
+
+    swap_free(entry);
+    if exclusive {
+        // 映射是唯一的，交换设备上的内容不再需要，下次换出时重新分配槽位
+        delete_from_swap_cache(&mut guard);
+    }
+    guard.insert_vma(vma.clone());
+    guard.set_anon_address(Some(addr));
+    if mlocked {
+        guard.add_flags(PageFlags::PG_UNEVICTABLE);
+    }
+    drop(guard);
+    lru_cache_add_anon(&page);
+    Ok(())
+}
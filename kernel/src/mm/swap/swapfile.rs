@@ -0,0 +1,653 @@
+//! 交换设备的管理与交换槽位的分配
+//!
+//! 每个交换设备用一个`SwapInfo`描述，其中的`counts`数组记录每个槽位（一页大小）的状态：
+//! 低位是引用该槽位的交换页表项个数，`SWAP_HAS_CACHE`表示槽位对应的页面在交换缓存中。
+//! 值为0的槽位是空闲的。
+//!
+//! 交换设备可以是块设备，也可以是普通文件（包括位于ext4上的文件，
+//! 以及以tmpfs/ext4中的文件为后端的loop设备）。块设备直接提交bio，
+//! 交换文件通过文件系统的直接I/O读写，不经过页缓存。
+
+use core::sync::atomic::{AtomicI32, AtomicUsize, Ordering};
+
+use alloc::{
+    string::{String, ToString},
+    sync::Arc,
+    vec,
+    vec::Vec,
+};
+use system_error::SystemError;
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    driver::base::block::{
+        block_device::{BlockDevice, LBA_SIZE},
+        gendisk::GenDisk,
+    },
+    filesystem::vfs::{
+        self, vcore::try_find_gendisk, FilePrivateData, IndexNode, InodeFlags, InodeId,
+    },
+    libs::{mutex::Mutex, rwlock::RwLock, spinlock::SpinLock},
+    mm::{allocator::page_frame::FrameAllocator, MemoryManagementArch},
+    process::ProcessManager,
+    sched::sched_yield,
+    time::{sleep::nanosleep, PosixTimeSpec},
+};
+
+use super::{swap_state, vmscan, SwapEntry, MAX_SWAPFILES, SWP_OFFSET_MAX};
+
+/// swapon标志：使用用户指定的优先级
+pub const SWAP_FLAG_PREFER: u32 = 0x8000;
+pub const SWAP_FLAG_PRIO_MASK: u32 = 0x7fff;
+pub const SWAP_FLAG_DISCARD: u32 = 0x10000;
+pub const SWAP_FLAG_DISCARD_ONCE: u32 = 0x20000;
+pub const SWAP_FLAG_DISCARD_PAGES: u32 = 0x40000;
+
+const SWAP_FLAGS_VALID: u32 = SWAP_FLAG_PRIO_MASK
+    | SWAP_FLAG_PREFER
+    | SWAP_FLAG_DISCARD
+    | SWAP_FLAG_DISCARD_ONCE
+    | SWAP_FLAG_DISCARD_PAGES;
+
+/// 槽位对应的页面在交换缓存中
+const SWAP_HAS_CACHE: u32 = 1 << 31;
+/// 不可使用的槽位（头部、坏块）
+const SWAP_MAP_BAD: u32 = u32::MAX;
+/// 单个槽位最多被引用的次数
+const SWAP_MAP_MAX: u32 = SWAP_HAS_CACHE - 2;
+
+/// 交换区头部的魔数及其在第一页中的偏移
+const SWAP_MAGIC: &[u8] = b"SWAPSPACE2";
+const SWAP_HEADER_INFO_OFFSET: usize = 1024;
+const SWAP_HEADER_BADPAGES_OFFSET: usize = 1536;
+
+/// 每页包含的扇区数
+const SECTORS_PER_PAGE: usize = MMArch::PAGE_SIZE / LBA_SIZE;
+
+static SWAP_INFO: RwLock<[Option<Arc<SwapInfo>>; MAX_SWAPFILES]> =
+    RwLock::new([const { None }; MAX_SWAPFILES]);
+/// 串行化swapon/swapoff
+static SWAPON_MUTEX: Mutex<()> = Mutex::new(());
+
+static NR_SWAPFILES: AtomicUsize = AtomicUsize::new(0);
+/// 所有可写交换设备的槽位总数
+static TOTAL_SWAP_PAGES: AtomicUsize = AtomicUsize::new(0);
+/// 所有可写交换设备的空闲槽位数
+static NR_SWAP_PAGES: AtomicUsize = AtomicUsize::new(0);
+/// 未指定优先级时，新交换设备的优先级依次递减
+static LEAST_PRIORITY: AtomicI32 = AtomicI32::new(0);
+
+/// 交换设备的后端
+#[derive(Debug)]
+enum SwapBackend {
+    Block(Arc<GenDisk>),
+    File(Arc<dyn IndexNode>),
+}
+
+impl SwapBackend {
+    /// 从`offset`页开始读取`buf.len()`字节
+    fn read_pages(&self, offset: usize, buf: &mut [u8]) -> Result<(), SystemError> {
+        match self {
+            SwapBackend::Block(disk) => {
+                let lba = disk.block_offset_2_disk_blkid(offset * SECTORS_PER_PAGE);
+                let bio = disk
+                    .block_device()
+                    .submit_bio_read(lba, buf.len() / LBA_SIZE)?;
+                let data = bio.wait()?;
+                if data.len() < buf.len() {
+                    return Err(SystemError::EIO);
+                }
+                buf.copy_from_slice(&data[..buf.len()]);
+                Ok(())
+            }
+            SwapBackend::File(inode) => {
+                let pos = offset * MMArch::PAGE_SIZE;
+                let len = buf.len();
+                let guard = Mutex::new(FilePrivateData::Unused);
+                let r = match inode.read_direct(pos, len, buf, guard.lock()) {
+                    Err(SystemError::ENOSYS) => inode.read_at(pos, len, buf, guard.lock()),
+                    r => r,
+                };
+                if r? != len {
+                    return Err(SystemError::EIO);
+                }
+                Ok(())
+            }
+        }
+    }
+
+    /// 把一页数据写到第`offset`页
+    fn write_page(&self, offset: usize, buf: &[u8]) -> Result<(), SystemError> {
+        match self {
+            SwapBackend::Block(disk) => {
+                let lba = disk.block_offset_2_disk_blkid(offset * SECTORS_PER_PAGE);
+                disk.block_device()
+                    .submit_bio_write(lba, buf.len() / LBA_SIZE, buf)?
+                    .wait()?;
+                Ok(())
+            }
+            SwapBackend::File(inode) => {
+                let pos = offset * MMArch::PAGE_SIZE;
+                let len = buf.len();
+                let guard = Mutex::new(FilePrivateData::Unused);
+                let r = match inode.write_direct(pos, len, buf, guard.lock()) {
+                    Err(SystemError::ENOSYS) => inode.write_at(pos, len, buf, guard.lock()),
+                    r => r,
+                };
+                if r? != len {
+                    return Err(SystemError::EIO);
+                }
+                Ok(())
+            }
+        }
+    }
+
+    /// 后端的大小（页）
+    fn nr_pages(&self) -> Result<usize, SystemError> {
+        match self {
+            SwapBackend::Block(disk) => Ok(disk.range().len() / SECTORS_PER_PAGE),
+            SwapBackend::File(inode) => {
+                Ok(inode.metadata()?.size.max(0) as usize / MMArch::PAGE_SIZE)
+            }
+        }
+    }
+
+    /// 槽位被释放时通知块设备（例如zram可以立即丢弃压缩数据）
+    fn slot_free_notify(&self, offset: usize) {
+        if let SwapBackend::Block(disk) = self {
+            let lba = disk.block_offset_2_disk_blkid(offset * SECTORS_PER_PAGE);
+            disk.block_device()
+                .swap_slot_free_notify(lba, SECTORS_PER_PAGE);
+        }
+    }
+
+    fn kind(&self) -> &'static str {
+        match self {
+            SwapBackend::Block(_) => "partition",
+            SwapBackend::File(_) => "file",
+        }
+    }
+}
+
+/// 用于判断两个路径是否指向同一个交换设备
+#[derive(Debug, Clone, PartialEq, Eq)]
+enum SwapIdentity {
+    Block(usize),
+    File(usize, InodeId),
+}
+
+/// 交换设备的槽位状态
+#[derive(Debug)]
+struct SwapMap {
+    counts: Vec<u32>,
+    /// 已使用的槽位数
+    inuse: usize,
+    /// 下一次分配开始扫描的位置
+    cursor: usize,
+    /// 是否允许分配新的槽位（swapoff期间为false）
+    writeok: bool,
+}
+
+/// 一个已启用的交换设备
+#[derive(Debug)]
+pub struct SwapInfo {
+    ty: usize,
+    prio: i16,
+    flags: u32,
+    backend: SwapBackend,
+    identity: SwapIdentity,
+    name: String,
+    /// 可用的槽位数（不含头部和坏块）
+    pages: usize,
+    map: SpinLock<SwapMap>,
+}
+
+impl SwapInfo {
+    pub fn read_pages(&self, offset: usize, buf: &mut [u8]) -> Result<(), SystemError> {
+        self.backend.read_pages(offset, buf)
+    }
+
+    pub fn write_page(&self, offset: usize, buf: &[u8]) -> Result<(), SystemError> {
+        self.backend.write_page(offset, buf)
+    }
+
+    /// 槽位数组的长度
+    pub fn max(&self) -> usize {
+        self.map.lock().counts.len()
+    }
+
+    /// 已使用的槽位数
+    pub fn inuse(&self) -> usize {
+        self.map.lock().inuse
+    }
+
+    /// 释放槽位，并通知后端这一页的数据不再需要
+    fn free_slot(&self, map: &mut SwapMap, offset: usize) {
+        map.counts[offset] = 0;
+        map.inuse -= 1;
+        if map.writeok {
+            NR_SWAP_PAGES.fetch_add(1, Ordering::Relaxed);
+        }
+        self.backend.slot_free_notify(offset);
+    }
+}
+
+/// 块设备`dev`（或它的某个分区）是否正被用作交换设备
+pub fn swap_uses_block_device(dev: &Arc<dyn BlockDevice>) -> bool {
+    SWAP_INFO
+        .read()
+        .iter()
+        .flatten()
+        .any(|si| match &si.backend {
+            SwapBackend::Block(disk) => {
+                Arc::as_ptr(&disk.block_device()) as *const u8 == Arc::as_ptr(dev) as *const u8
+            }
+            SwapBackend::File(_) => false,
+        })
+}
+
+/// 已启用的交换设备数量
+#[inline(always)]
+pub fn nr_swapfiles() -> usize {
+    NR_SWAPFILES.load(Ordering::Relaxed)
+}
+
+/// 所有交换设备的总页数与空闲页数
+pub fn swap_totals() -> (usize, usize) {
+    (
+        TOTAL_SWAP_PAGES.load(Ordering::Relaxed),
+        NR_SWAP_PAGES.load(Ordering::Relaxed),
+    )
+}
+
+pub fn swap_info_get(ty: usize) -> Option<Arc<SwapInfo>> {
+    SWAP_INFO.read().get(ty)?.clone()
+}
+
+fn swap_info_for(entry: SwapEntry) -> Result<Arc<SwapInfo>, SystemError> {
+    let si = swap_info_get(entry.ty()).ok_or(SystemError::EINVAL)?;
+    if entry.offset() >= si.max() {
+        return Err(SystemError::EINVAL);
+    }
+    Ok(si)
+}
+
+/// 分配一个交换槽位
+///
+/// 从优先级最高的可写交换设备中分配，分配到的槽位带有`SWAP_HAS_CACHE`标记，
+/// 调用者需要随后把页面加入交换缓存。
+pub fn get_swap_page() -> Option<SwapEntry> {
+    if NR_SWAP_PAGES.load(Ordering::Relaxed) == 0 {
+        return None;
+    }
+    let mut infos: Vec<Arc<SwapInfo>> = SWAP_INFO.read().iter().flatten().cloned().collect();
+    infos.sort_by(|a, b| b.prio.cmp(&a.prio));
+
+    for si in infos {
+        let mut map = si.map.lock();
+        if !map.writeok || map.inuse >= si.pages {
+            continue;
+        }
+        let len = map.counts.len();
+        let start = map.cursor;
+        for i in 0..len {
+            let offset = (start + i) % len;
+            if map.counts[offset] == 0 {
+                map.counts[offset] = SWAP_HAS_CACHE;
+                map.inuse += 1;
+                map.cursor = offset + 1;
+                NR_SWAP_PAGES.fetch_sub(1, Ordering::Relaxed);
+                return Some(SwapEntry::new(si.ty, offset));
+            }
+        }
+    }
+    None
+}
+
+/// 为一个新的交换页表项增加槽位的引用计数
+pub fn swap_duplicate(entry: SwapEntry) -> Result<(), SystemError> {
+    let si = swap_info_for(entry)?;
+    let mut map = si.map.lock();
+    let count = &mut map.counts[entry.offset()];
+    if *count == 0 || *count == SWAP_MAP_BAD {
+        return Err(SystemError::ENOENT);
+    }
+    if *count & !SWAP_HAS_CACHE >= SWAP_MAP_MAX {
+        return Err(SystemError::ENOMEM);
+    }
+    *count += 1;
+    Ok(())
+}
+
+/// 一个交换页表项被移除时，减少槽位的引用计数，没有任何引用时释放槽位
+pub fn swap_free(entry: SwapEntry) {
+    let Ok(si) = swap_info_for(entry) else {
+        log::warn!("swap_free: bad swap entry {:?}", entry);
+        return;
+    };
+    let mut map = si.map.lock();
+    let offset = entry.offset();
+    let count = map.counts[offset];
+    if count & !SWAP_HAS_CACHE == 0 || count == SWAP_MAP_BAD {
+        log::warn!("swap_free: unused swap entry {:?}", entry);
+        return;
+    }
+    if count - 1 == 0 {
+        si.free_slot(&mut map, offset);
+    } else {
+        map.counts[offset] = count - 1;
+    }
+}
+
+/// 准备把槽位读入交换缓存
+///
+/// ## 返回值
+/// - Ok(()): 成功标记`SWAP_HAS_CACHE`，调用者负责读入页面
+/// - Err(SystemError::EEXIST): 页面已经（或正在被其他人读入）在交换缓存中
+/// - Err(SystemError::ENOENT): 槽位已经被释放
+pub fn swapcache_prepare(entry: SwapEntry) -> Result<(), SystemError> {
+    let si = swap_info_for(entry)?;
+    let mut map = si.map.lock();
+    let count = &mut map.counts[entry.offset()];
+    if *count == SWAP_MAP_BAD || *count & !SWAP_HAS_CACHE == 0 {
+        return Err(SystemError::ENOENT);
+    }
+    if *count & SWAP_HAS_CACHE != 0 {
+        return Err(SystemError::EEXIST);
+    }
+    *count |= SWAP_HAS_CACHE;
+    Ok(())
+}
+
+/// 页面离开交换缓存时清除`SWAP_HAS_CACHE`，没有任何引用时释放槽位
+pub fn swapcache_clear(entry: SwapEntry) {
+    let Ok(si) = swap_info_for(entry) else {
+        return;
+    };
+    let mut map = si.map.lock();
+    let offset = entry.offset();
+    let count = map.counts[offset];
+    if count == SWAP_MAP_BAD || count & SWAP_HAS_CACHE == 0 {
+        return;
+    }
+    if count == SWAP_HAS_CACHE {
+        si.free_slot(&mut map, offset);
+    } else {
+        map.counts[offset] = count & !SWAP_HAS_CACHE;
+    }
+}
+
+/// 引用槽位的交换页表项个数
+pub fn swap_count(entry: SwapEntry) -> usize {
+    let Ok(si) = swap_info_for(entry) else {
+        return 0;
+    };
+    let count = si.map.lock().counts[entry.offset()];
+    if count == SWAP_MAP_BAD {
+        return 0;
+    }
+    (count & !SWAP_HAS_CACHE) as usize
+}
+
+/// `offset`所在的对齐簇中，正在被交换页表项引用的槽位范围`[start, end)`
+pub fn swap_cluster_range(entry: SwapEntry, cluster: usize) -> Option<(usize, usize)> {
+    let si = swap_info_for(entry).ok()?;
+    let map = si.map.lock();
+    let base = entry.offset() & !(cluster - 1);
+    let end = core::cmp::min(base + cluster, map.counts.len());
+    let used = |off: usize| {
+        let c = map.counts[off];
+        c != SWAP_MAP_BAD && c & !SWAP_HAS_CACHE != 0
+    };
+    let start = (base..end).find(|off| used(*off))?;
+    let last = (base..end).rev().find(|off| used(*off))?;
+    Some((start, last + 1))
+}
+
+/// 根据路径找到对应的inode，并确定交换后端
+fn resolve_swap_target(
+    path: &str,
+) -> Result<(Arc<dyn IndexNode>, SwapBackend, SwapIdentity), SystemError> {
+    let pcb = ProcessManager::current_pcb();
+    let (begin, rest) = vfs::utils::user_path_at(&pcb, vfs::fcntl::AtFlags::AT_FDCWD.bits(), path)?;
+    let inode = begin.lookup_follow_symlink(&rest, vfs::VFS_MAX_FOLLOW_SYMLINK_TIMES)?;
+    let md = inode.metadata()?;
+    match md.file_type {
+        vfs::FileType::BlockDevice => {
+            let disk = try_find_gendisk(inode.dname()?.0.as_str()).ok_or(SystemError::ENODEV)?;
+            let identity = SwapIdentity::Block(Arc::as_ptr(&disk) as *const u8 as usize);
+            Ok((inode, SwapBackend::Block(disk), identity))
+        }
+        vfs::FileType::File => {
+            let identity = SwapIdentity::File(md.dev_id, md.inode_id);
+            Ok((inode.clone(), SwapBackend::File(inode), identity))
+        }
+        vfs::FileType::Dir => Err(SystemError::EISDIR),
+        _ => Err(SystemError::EINVAL),
+    }
+}
+
+fn read_u32(page: &[u8], offset: usize) -> u32 {
+    u32::from_ne_bytes(page[offset..offset + 4].try_into().unwrap())
+}
+
+/// 解析交换区头部，建立槽位数组
+///
+/// 返回(槽位数组, 可用槽位数)
+fn setup_swap_map(backend: &SwapBackend) -> Result<(Vec<u32>, usize), SystemError> {
+    let mut header = vec![0u8; MMArch::PAGE_SIZE];
+    backend.read_pages(0, &mut header)?;
+
+    if &header[MMArch::PAGE_SIZE - SWAP_MAGIC.len()..] != SWAP_MAGIC {
+        log::warn!("swapon: unable to find swap-space signature");
+        return Err(SystemError::EINVAL);
+    }
+    let version = read_u32(&header, SWAP_HEADER_INFO_OFFSET);
+    if version != 1 {
+        log::warn!("swapon: unable to handle swap header version {}", version);
+        return Err(SystemError::EINVAL);
+    }
+    let last_page = read_u32(&header, SWAP_HEADER_INFO_OFFSET + 4) as usize;
+    let nr_badpages = read_u32(&header, SWAP_HEADER_INFO_OFFSET + 8) as usize;
+
+    let maxpages = (last_page + 1).min(backend.nr_pages()?).min(SWP_OFFSET_MAX);
+    if maxpages <= 1 {
+        return Err(SystemError::EINVAL);
+    }
+    let max_badpages = (MMArch::PAGE_SIZE - SWAP_MAGIC.len() - SWAP_HEADER_BADPAGES_OFFSET) / 4;
+    if nr_badpages > max_badpages {
+        return Err(SystemError::EINVAL);
+    }
+
+    let mut counts = vec![0u32; maxpages];
+    counts[0] = SWAP_MAP_BAD;
+    let mut nr_good = maxpages - 1;
+    for i in 0..nr_badpages {
+        let page = read_u32(&header, SWAP_HEADER_BADPAGES_OFFSET + i * 4) as usize;
+        if page == 0 || page > last_page {
+            return Err(SystemError::EINVAL);
+        }
+        if page < maxpages && counts[page] != SWAP_MAP_BAD {
+            counts[page] = SWAP_MAP_BAD;
+            nr_good -= 1;
+        }
+    }
+    if nr_good == 0 {
+        return Err(SystemError::EINVAL);
+    }
+    Ok((counts, nr_good))
+}
+
+fn set_swapfile_flag(inode: &Arc<dyn IndexNode>, set: bool) {
+    let Ok(mut md) = inode.metadata() else {
+        return;
+    };
+    md.flags.set(InodeFlags::S_SWAPFILE, set);
+    let _ = inode.set_metadata(&md);
+}
+
+/// 启用交换设备
+pub fn swapon(path: &str, flags: u32) -> Result<(), SystemError> {
+    if flags & !SWAP_FLAGS_VALID != 0 {
+        return Err(SystemError::EINVAL);
+    }
+    let _guard = SWAPON_MUTEX.lock();
+
+    let (inode, backend, identity) = resolve_swap_target(path)?;
+    if let SwapBackend::File(_) = backend {
+        if inode.metadata()?.flags.contains(InodeFlags::S_SWAPFILE) {
+            return Err(SystemError::EBUSY);
+        }
+    }
+
+    let ty = {
+        let infos = SWAP_INFO.read();
+        if infos.iter().flatten().any(|si| si.identity == identity) {
+            return Err(SystemError::EBUSY);
+        }
+        infos
+            .iter()
+            .position(|si| si.is_none())
+            .ok_or(SystemError::EPERM)?
+    };
+
+    let (counts, pages) = setup_swap_map(&backend)?;
+    let prio = if flags & SWAP_FLAG_PREFER != 0 {
+        (flags & SWAP_FLAG_PRIO_MASK) as i16
+    } else {
+        (LEAST_PRIORITY.fetch_sub(1, Ordering::Relaxed) - 1) as i16
+    };
+
+    let si = Arc::new(SwapInfo {
+        ty,
+        prio,
+        flags,
+        backend,
+        identity,
+        name: path.to_string(),
+        pages,
+        map: SpinLock::new(SwapMap {
+            counts,
+            inuse: 0,
+            cursor: 1,
+            writeok: true,
+        }),
+    });
+
+    if let SwapBackend::File(_) = si.backend {
+        set_swapfile_flag(&inode, true);
+    }
+
+    SWAP_INFO.write()[ty] = Some(si.clone());
+    TOTAL_SWAP_PAGES.fetch_add(pages, Ordering::Relaxed);
+    NR_SWAP_PAGES.fetch_add(pages, Ordering::Relaxed);
+    if NR_SWAPFILES.fetch_add(1, Ordering::Relaxed) == 0 {
+        vmscan::populate_anon_lru();
+    }
+
+    log::info!(
+        "Adding {}k swap on {}. Priority:{} extents:1 across:{}k",
+        pages * (MMArch::PAGE_SIZE >> 10),
+        si.name,
+        si.prio,
+        si.max() * (MMArch::PAGE_SIZE >> 10)
+    );
+    Ok(())
+}
+
+/// 停用交换设备，先把设备上的所有页面换入内存
+pub fn swapoff(path: &str) -> Result<(), SystemError> {
+    let _guard = SWAPON_MUTEX.lock();
+
+    let (inode, _backend, identity) = resolve_swap_target(path)?;
+    let si = SWAP_INFO
+        .read()
+        .iter()
+        .flatten()
+        .find(|si| si.identity == identity)
+        .cloned()
+        .ok_or(SystemError::EINVAL)?;
+
+    // 换入所有页面需要足够的空闲内存
+    let free = unsafe { LockedFrameAllocator.usage() }.free().data();
+    if si.inuse() > free {
+        return Err(SystemError::ENOMEM);
+    }
+
+    // 停止在这个设备上分配槽位
+    {
+        let mut map = si.map.lock();
+        map.writeok = false;
+        TOTAL_SWAP_PAGES.fetch_sub(si.pages, Ordering::Relaxed);
+        NR_SWAP_PAGES.fetch_sub(si.pages - map.inuse, Ordering::Relaxed);
+    }
+
+    if let Err(e) = try_to_unuse(&si) {
+        let mut map = si.map.lock();
+        map.writeok = true;
+        TOTAL_SWAP_PAGES.fetch_add(si.pages, Ordering::Relaxed);
+        NR_SWAP_PAGES.fetch_add(si.pages - map.inuse, Ordering::Relaxed);
+        return Err(e);
+    }
+
+    SWAP_INFO.write()[si.ty] = None;
+    if NR_SWAPFILES.fetch_sub(1, Ordering::Relaxed) == 1 {
+        vmscan::clear_anon_lru();
+    }
+    if si.flags & SWAP_FLAG_PREFER == 0 {
+        LEAST_PRIORITY.fetch_add(1, Ordering::Relaxed);
+    }
+    if let SwapBackend::File(_) = si.backend {
+        set_swapfile_flag(&inode, false);
+    }
+    Ok(())
+}
+
+/// swapoff时最多扫描所有地址空间的轮数
+const TRY_TO_UNUSE_MAX_ROUNDS: usize = 64;
+
+/// 把交换设备上的所有页面换入内存，并让引用它们的页表项重新指向内存中的页面
+fn try_to_unuse(si: &Arc<SwapInfo>) -> Result<(), SystemError> {
+    for round in 0..TRY_TO_UNUSE_MAX_ROUNDS {
+        vmscan::unuse_all_mm(si.ty)?;
+        // 没有页表项再引用的页面只是留在交换缓存中，直接丢弃
+        swap_state::drop_swap_cache_of(si.ty);
+
+        if si.inuse() == 0 {
+            return Ok(());
+        }
+        // 可能有正在fork或换入的进程还持有引用，稍后再试
+        if round < 8 {
+            sched_yield();
+        } else {
+            let _ = nanosleep(PosixTimeSpec::new(0, 10_000_000));
+        }
+    }
+    log::warn!("swapoff: {} still has {} slots in use", si.name, si.inuse());
+    Err(SystemError::EBUSY)
+}
+
+/// /proc/swaps中的一行
+pub struct SwapsLine {
+    pub name: String,
+    pub kind: &'static str,
+    pub size_kb: usize,
+    pub used_kb: usize,
+    pub prio: i16,
+}
+
+pub fn swaps_lines() -> Vec<SwapsLine> {
+    let page_kb = MMArch::PAGE_SIZE >> 10;
+    SWAP_INFO
+        .read()
+        .iter()
+        .flatten()
+        .map(|si| SwapsLine {
+            name: si.name.clone(),
+            kind: si.backend.kind(),
+            size_kb: si.pages * page_kb,
+            used_kb: si.inuse() * page_kb,
+            prio: si.prio,
+        })
+        .collect()
+}
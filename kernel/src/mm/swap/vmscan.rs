@@ -0,0 +1,388 @@
+//! 匿名页的回收
+//!
+//! 匿名页LRU只保存页面的弱引用，页面被释放后对应的项在扫描时丢弃。
+//! 换出一个页面前，先通过页面的`vma_set`和记录的虚拟地址找到所有映射它的页表项
+//! （反向映射）。只要有一个页表项的访问位被置位，就清除访问位、给页面第二次机会；
+//! 否则把所有页表项一次性替换为交换页表项，写回交换设备后释放页面。
+
+use alloc::{sync::Arc, vec::Vec};
+use system_error::SystemError;
+
+use crate::{
+    arch::{mm::PageMapper, MMArch},
+    libs::align::align_up,
+    mm::{
+        allocator::page_frame::PageFrameCount,
+        lru::{self, ReclaimMode, VmEvent, SWAP_CLUSTER_MAX},
+        mmu_gather::MmuGather,
+        page::{page_manager, page_reclaimer_lock, Page, PageFlags, PageReclaimer, PageType},
+        ucontext::{AddressSpace, LockedVMA},
+        MemoryManagementArch, VirtAddr, VmFlags,
+    },
+    process::all_process,
+};
+
+use super::{
+    swap_active,
+    swap_state::{add_to_swap_cache, delete_from_swap_cache, do_swap_in},
+    swapfile::{get_swap_page, swap_duplicate, swap_info_get},
+    SwapEntry, PSWPOUT,
+};
+
+/// 一个PTE页表覆盖的地址范围
+const PTE_TABLE_SPAN: usize = MMArch::PAGE_SIZE << MMArch::PAGE_ENTRY_SHIFT;
+
+enum ScanResult {
+    /// 页面已被换出并释放
+    Reclaimed,
+    /// 页面暂时不能回收，放回LRU
+    Keep,
+    /// 页面不再是可换出的匿名页，移出LRU
+    Remove,
+}
+
+/// 所有用户进程的地址空间（去重）
+fn all_mms() -> Vec<Arc<AddressSpace>> {
+    let procs: Vec<_> = all_process()
+        .lock_irqsave()
+        .as_ref()
+        .map(|map| map.values().cloned().collect())
+        .unwrap_or_default();
+    let mut mms: Vec<Arc<AddressSpace>> = Vec::new();
+    for pcb in procs {
+        if let Some(mm) = pcb.basic().user_vm() {
+            if !mms.iter().any(|m| Arc::ptr_eq(m, &mm)) {
+                mms.push(mm);
+            }
+        }
+    }
+    mms
+}
+
+/// 启用第一个交换设备时，把所有进程中已有的私有匿名页加入匿名页LRU
+pub fn populate_anon_lru() {
+    for mm in all_mms() {
+        let Some(guard) = mm.try_read() else {
+            continue;
+        };
+        let mapper = &guard.user_mapper.utable;
+        for vma in guard.mappings.iter_vmas() {
+            let region = {
+                let vma_guard = vma.lock();
+                if vma_guard.vm_flags().contains(VmFlags::VM_SHARED) {
+                    continue;
+                }
+                *vma_guard.region()
+            };
+            let mut addr = region.start();
+            while addr < region.end() {
+                if mapper.get_table(addr, 0).is_none() {
+                    addr = VirtAddr::new(align_up(addr.data() + 1, PTE_TABLE_SPAN));
+                    continue;
+                }
+                if let Some(page) = mapper
+                    .translate(addr)
+                    .and_then(|(paddr, _)| page_manager().get(&paddr))
+                {
+                    let mut page_guard = page.write();
+                    if matches!(page_guard.page_type(), PageType::Normal)
+                        && page_guard.map_count() != 0
+                    {
+                        if page_guard.anon_address().is_none() {
+                            page_guard.set_anon_address(Some(addr));
+                        }
+                        drop(page_guard);
+                        page_reclaimer_lock().add_anon_page(&page);
+                    }
+                }
+                addr += MMArch::PAGE_SIZE;
+            }
+        }
+    }
+}
+
+/// 停用最后一个交换设备时清空匿名页LRU
+pub fn clear_anon_lru() {
+    let mut reclaimer = page_reclaimer_lock();
+    while !reclaimer.drain_anon_lru(SWAP_CLUSTER_MAX).is_empty() {}
+}
+
+/// 从匿名页LRU中扫描最多`count`个页面并尝试换出，返回换出的页数
+pub fn shrink_anon(count: usize, mode: ReclaimMode) -> usize {
+    if !swap_active() {
+        return 0;
+    }
+    let victims = page_reclaimer_lock().drain_anon_lru(count);
+    let scanned = victims.len();
+    let mut reclaimed = 0;
+    for victim in victims {
+        let Some(page) = victim.upgrade() else {
+            continue;
+        };
+        // 页面可能已经离开页面管理器（正在被释放）
+        let managed = page_manager()
+            .get(&page.phys_address())
+            .is_some_and(|p| Arc::ptr_eq(&p, &page));
+        if !managed {
+            continue;
+        }
+        match try_to_swap_out(&page) {
+            ScanResult::Reclaimed => reclaimed += 1,
+            ScanResult::Keep => page_reclaimer_lock().add_anon_page(&page),
+            ScanResult::Remove => {}
+        }
+    }
+    lru::count_reclaim(mode, false, scanned, reclaimed);
+    reclaimed
+}
+
+/// 内存不足时由缺页路径调用：空闲页低于`low`水位时唤醒回收线程，
+/// 低于`min`水位时同步回收一批页缓存页面，仍然不足时换出匿名页
+///
+/// 调用者不能持有任何地址空间的锁。
+pub fn try_to_free_pages() {
+    // 没有交换设备时只有页缓存可回收，抽样检查水位以免每次缺页都统计空闲页
+    if !swap_active() && !lru::watermark_check_due() {
+        return;
+    }
+    let wmark = lru::watermarks();
+    let free = lru::nr_free_pages();
+    if free < wmark.low {
+        PageReclaimer::wakeup_claim_thread();
+    }
+    if free >= wmark.min {
+        return;
+    }
+    lru::count_vm_events(VmEvent::AllocStall, 1);
+    let reclaimed =
+        PageReclaimer::shrink_list(PageFrameCount::new(SWAP_CLUSTER_MAX), ReclaimMode::Direct);
+    if reclaimed < SWAP_CLUSTER_MAX {
+        shrink_anon(SWAP_CLUSTER_MAX - reclaimed, ReclaimMode::Direct);
+    }
+}
+
+/// 把页面写到它在交换缓存中对应的槽位
+fn swap_writepage(page: &Page, entry: SwapEntry) -> Result<(), SystemError> {
+    let si = swap_info_get(entry.ty()).ok_or(SystemError::EIO)?;
+    let guard = page.read();
+    si.write_page(entry.offset(), unsafe { guard.as_slice() })
+}
+
+/// 尝试换出一个匿名页
+fn try_to_swap_out(page: &Arc<Page>) -> ScanResult {
+    let (vmas, addr) = {
+        let guard = page.read();
+        if !matches!(guard.page_type(), PageType::Normal)
+            || guard.flags().contains(PageFlags::PG_UNEVICTABLE)
+        {
+            return ScanResult::Remove;
+        }
+        let vmas: Vec<Arc<LockedVMA>> = guard.vma_set().iter().cloned().collect();
+        (vmas, guard.anon_address())
+    };
+
+    if vmas.is_empty() {
+        return free_unmapped_swap_page(page);
+    }
+    let Some(addr) = addr else {
+        return ScanResult::Remove;
+    };
+
+    // 收集映射该页面的地址空间，按ID排序后依次加锁，避免与其他回收者死锁
+    let mut mms: Vec<Arc<AddressSpace>> = Vec::with_capacity(vmas.len());
+    for vma in vmas.iter() {
+        let vma_guard = vma.lock();
+        let vm_flags = *vma_guard.vm_flags();
+        if vm_flags.intersects(VmFlags::VM_SHARED | VmFlags::VM_LOCKED)
+            || !vma_guard.region().contains(addr)
+        {
+            return ScanResult::Remove;
+        }
+        let Some(mm) = vma_guard.address_space().and_then(|mm| mm.upgrade()) else {
+            return ScanResult::Keep;
+        };
+        drop(vma_guard);
+        if !mms.iter().any(|m| Arc::ptr_eq(m, &mm)) {
+            mms.push(mm);
+        }
+    }
+    mms.sort_by_key(|mm| mm.id());
+
+    // 地址空间正忙（缺页、mmap等）时不等待，下一轮再来
+    let mut mm_guards = Vec::with_capacity(mms.len());
+    for mm in mms.iter() {
+        match mm.try_read() {
+            Some(guard) => mm_guards.push(guard),
+            None => return ScanResult::Keep,
+        }
+    }
+    let _pt_edits: Vec<_> = mms.iter().map(|mm| mm.page_table_edit()).collect();
+
+    let mapper_of = |vma: &Arc<LockedVMA>| -> Option<&PageMapper> {
+        let mm = vma.lock().address_space()?.upgrade()?;
+        let idx = mms.iter().position(|m| Arc::ptr_eq(m, &mm))?;
+        Some(&mm_guards[idx].user_mapper.utable)
+    };
+
+    // 检查每个映射都指向这个页面，同时收集访问位
+    let paddr = page.phys_address();
+    let mut referenced = false;
+    let mut dirty = false;
+    for vma in vmas.iter() {
+        let Some(mapper) = mapper_of(vma) else {
+            return ScanResult::Keep;
+        };
+        if mapper.huge_pmd(addr).is_some() {
+            return ScanResult::Remove;
+        }
+        let Some(pte) = mapper.get_entry(addr, 0) else {
+            return ScanResult::Keep;
+        };
+        if pte.address() != Ok(paddr) {
+            return ScanResult::Keep;
+        }
+        let flags = pte.flags();
+        referenced |= flags.has_flag(MMArch::ENTRY_FLAG_ACCESSED);
+        dirty |= flags.has_flag(MMArch::ENTRY_FLAG_DIRTY);
+    }
+
+    if referenced {
+        // 最近被访问过：清除访问位后放回LRU。与Linux在x86上的做法一样不刷新TLB，
+        // 访问位只是一个提示，TLB中残留的项最多让页面多留在内存中一轮。
+        for vma in vmas.iter() {
+            let Some(mapper) = mapper_of(vma) else {
+                continue;
+            };
+            if let Some((_, flags)) = mapper.translate(addr) {
+                if let Some(flush) = unsafe { mapper.remap_present(addr, flags.set_access(false)) }
+                {
+                    unsafe { flush.ignore() };
+                }
+            }
+        }
+        return ScanResult::Keep;
+    }
+
+    let mut guard = page.write();
+    if guard.map_count() != vmas.len() {
+        return ScanResult::Keep;
+    }
+    let entry = match guard.swap_entry() {
+        Some(entry) => entry,
+        None => {
+            let Some(entry) = get_swap_page() else {
+                // 交换设备已满
+                return ScanResult::Keep;
+            };
+            add_to_swap_cache(entry, page, &mut guard);
+            guard.add_flags(PageFlags::PG_DIRTY);
+            entry
+        }
+    };
+    if dirty {
+        guard.add_flags(PageFlags::PG_DIRTY);
+    }
+
+    // 把所有映射替换为交换页表项
+    let mut tlbs: Vec<MmuGather<'_>> = mms.iter().map(MmuGather::gather).collect();
+    for vma in vmas.iter() {
+        let mm = vma.lock().address_space().and_then(|mm| mm.upgrade());
+        let Some(idx) = mm.and_then(|mm| mms.iter().position(|m| Arc::ptr_eq(m, &mm))) else {
+            continue;
+        };
+        if swap_duplicate(entry).is_err() {
+            break;
+        }
+        let mapper = &mm_guards[idx].user_mapper.utable;
+        match unsafe { mapper.replace_leaf_entry(addr, entry.to_pte()) } {
+            Some((old, flush)) => {
+                // 检查访问位之后页面可能又被写过
+                if old.flags().has_flag(MMArch::ENTRY_FLAG_DIRTY) {
+                    guard.add_flags(PageFlags::PG_DIRTY);
+                }
+                unsafe { flush.ignore() };
+                tlbs[idx].accumulate_range(addr);
+                guard.remove_vma(vma);
+            }
+            None => super::swapfile::swap_free(entry),
+        }
+    }
+    for tlb in tlbs {
+        tlb.finish();
+    }
+    drop(_pt_edits);
+    drop(mm_guards);
+
+    if guard.map_count() != 0 {
+        // 部分映射没能替换，页面仍在交换缓存中，交换页表项换入时能找到它
+        return ScanResult::Keep;
+    }
+    drop(guard);
+    free_unmapped_swap_page(page)
+}
+
+/// 回收一个已经没有映射、只留在交换缓存中的页面，脏页先写回交换设备
+fn free_unmapped_swap_page(page: &Arc<Page>) -> ScanResult {
+    let mut guard = page.write();
+    if guard.map_count() != 0 {
+        return ScanResult::Keep;
+    }
+    let Some(entry) = guard.swap_entry() else {
+        // 既没有映射也不在交换缓存中，页面正在被释放
+        return ScanResult::Remove;
+    };
+
+    if guard.flags().contains(PageFlags::PG_DIRTY) {
+        drop(guard);
+        let r = swap_writepage(page, entry);
+        guard = page.write();
+        if let Err(e) = r {
+            log::error!("swap writepage {:?} failed: {:?}", entry, e);
+            return ScanResult::Keep;
+        }
+        guard.remove_flags(PageFlags::PG_DIRTY);
+        PSWPOUT.fetch_add(1, core::sync::atomic::Ordering::Relaxed);
+        // 写回期间页面被重新映射了
+        if guard.map_count() != 0 || guard.swap_entry() != Some(entry) {
+            return ScanResult::Keep;
+        }
+    }
+
+    delete_from_swap_cache(&mut guard);
+    drop(guard);
+    page_manager().remove_page(&page.phys_address());
+    ScanResult::Reclaimed
+}
+
+/// 把地址空间中所有指向交换设备`ty`的交换页表项换入内存（swapoff时调用）
+pub fn unuse_all_mm(ty: usize) -> Result<(), SystemError> {
+    for mm in all_mms() {
+        let mut guard = mm.write();
+        let vmas: Vec<Arc<LockedVMA>> = guard.mappings.iter_vmas().cloned().collect();
+        let mapper = &mut guard.user_mapper.utable;
+        for vma in vmas {
+            let region = *vma.lock().region();
+            let mut addr = region.start();
+            while addr < region.end() {
+                if mapper.get_table(addr, 0).is_none() {
+                    addr = VirtAddr::new(align_up(addr.data() + 1, PTE_TABLE_SPAN));
+                    continue;
+                }
+                let entry = mapper
+                    .get_entry(addr, 0)
+                    .and_then(|pte| SwapEntry::from_pte(&pte))
+                    .filter(|entry| entry.ty() == ty);
+                if let Some(entry) = entry {
+                    loop {
+                        match unsafe { do_swap_in(mapper, &mm, &vma, addr, entry) } {
+                            Err(SystemError::EAGAIN) => continue,
+                            r => break r?,
+                        }
+                    }
+                }
+                addr += MMArch::PAGE_SIZE;
+            }
+        }
+    }
+    Ok(())
+}
@@ -23,6 +23,8 @@ mod sys_munlockall;
 mod sys_munmap;
 mod sys_process_vm;
 pub mod sys_sbrk;
+mod sys_swapoff;
+mod sys_swapon;
 
 bitflags! {
     /// Memory protection flags
@@ -3,7 +3,7 @@ use crate::arch::{interrupt::TrapFrame, syscall::nr::SYS_FADVISE64};
 use crate::filesystem::vfs::file::FileMode;
 use crate::filesystem::vfs::FileType;
 use crate::libs::align::page_align_up;
-use crate::mm::readahead::{force_page_cache_readahead, MAX_READAHEAD};
+use crate::mm::readahead::force_page_cache_readahead;
 use crate::mm::MemoryManagementArch;
 use crate::process::ProcessManager;
 use crate::syscall::table::{FormattedSyscallParam, Syscall};
@@ -121,14 +121,14 @@ pub fn do_fadvise(fd: i32, offset: i64, len: i64, advise: i32) -> Result<usize,
 
     match PosixFadviseFlag::from_i32(advise)? {
         PosixFadviseFlag::Normal => {
-            file.set_ra_pages(MAX_READAHEAD);
+            file.set_ra_pages(inode.fs().ra_pages());
             file.remove_mode_flags(FileMode::FMODE_RANDOM | FileMode::FMODE_NOREUSE);
         }
         PosixFadviseFlag::Random => {
             file.set_mode_flags(FileMode::FMODE_RANDOM);
         }
         PosixFadviseFlag::Sequential => {
-            file.set_ra_pages(MAX_READAHEAD * 2);
+            file.set_ra_pages(inode.fs().ra_pages() * 2);
             file.remove_mode_flags(FileMode::FMODE_RANDOM);
         }
         PosixFadviseFlag::WillNeed => {
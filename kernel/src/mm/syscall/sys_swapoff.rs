@@ -0,0 +1,48 @@
+//! System call handler for the swapoff system call.
+
+use crate::arch::{interrupt::TrapFrame, syscall::nr::SYS_SWAPOFF};
+use crate::filesystem::vfs::MAX_PATHLEN;
+use crate::mm::swap::swapfile;
+use crate::process::{cred::CAPFlags, ProcessManager};
+use crate::syscall::{
+    table::{FormattedSyscallParam, Syscall},
+    user_access::vfs_check_and_clone_cstr,
+};
+use system_error::SystemError;
+
+use alloc::vec::Vec;
+
+/// # swapoff(path)
+///
+/// 停用`path`指定的交换空间，需要CAP_SYS_ADMIN。
+/// 交换空间中的所有页面都会先被换回内存，内存不足以容纳它们时返回ENOMEM。
+pub struct SysSwapoffHandle;
+
+impl Syscall for SysSwapoffHandle {
+    fn num_args(&self) -> usize {
+        1
+    }
+
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        if !ProcessManager::current_pcb()
+            .cred()
+            .has_capability(CAPFlags::CAP_SYS_ADMIN)
+        {
+            return Err(SystemError::EPERM);
+        }
+
+        let path = vfs_check_and_clone_cstr(args[0] as *const u8, Some(MAX_PATHLEN))?;
+        let path = path.to_str().map_err(|_| SystemError::EINVAL)?;
+        swapfile::swapoff(path)?;
+        Ok(0)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![FormattedSyscallParam::new(
+            "path",
+            format!("{:#x}", args[0]),
+        )]
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_SWAPOFF, SysSwapoffHandle);
@@ -0,0 +1,58 @@
+//! System call handler for the swapon system call.
+
+use crate::arch::{interrupt::TrapFrame, syscall::nr::SYS_SWAPON};
+use crate::filesystem::vfs::MAX_PATHLEN;
+use crate::mm::swap::swapfile;
+use crate::process::{cred::CAPFlags, ProcessManager};
+use crate::syscall::{
+    table::{FormattedSyscallParam, Syscall},
+    user_access::vfs_check_and_clone_cstr,
+};
+use system_error::SystemError;
+
+use alloc::vec::Vec;
+
+/// # swapon(path, swapflags)
+///
+/// 启用`path`指定的块设备或交换文件作为交换空间，需要CAP_SYS_ADMIN。
+/// 交换区必须已经由mkswap写入了SWAPSPACE2格式的头部。
+pub struct SysSwaponHandle;
+
+impl Syscall for SysSwaponHandle {
+    fn num_args(&self) -> usize {
+        2
+    }
+
+    fn handle(&self, args: &[usize], _frame: &mut TrapFrame) -> Result<usize, SystemError> {
+        if !ProcessManager::current_pcb()
+            .cred()
+            .has_capability(CAPFlags::CAP_SYS_ADMIN)
+        {
+            return Err(SystemError::EPERM);
+        }
+
+        let path = vfs_check_and_clone_cstr(Self::path(args), Some(MAX_PATHLEN))?;
+        let path = path.to_str().map_err(|_| SystemError::EINVAL)?;
+        swapfile::swapon(path, Self::flags(args))?;
+        Ok(0)
+    }
+
+    fn entry_format(&self, args: &[usize]) -> Vec<FormattedSyscallParam> {
+        vec![
+            FormattedSyscallParam::new("path", format!("{:#x}", args[0])),
+            FormattedSyscallParam::new("swapflags", format!("{:#x}", Self::flags(args))),
+        ]
+    }
+}
+
+impl SysSwaponHandle {
+    fn path(args: &[usize]) -> *const u8 {
+        args[0] as *const u8
+    }
+
+    fn flags(args: &[usize]) -> u32 {
+        args[1] as u32
+    }
+}
+
+syscall_table_macros::declare_syscall!(SYS_SWAPON, SysSwaponHandle);
@@ -11,14 +11,17 @@ use crate::{
     filesystem::{
         sysfs::{
             file::sysfs_emit_str, Attribute, AttributeGroup, SysFSOps, SysFSOpsSupport,
-            SYSFS_ATTR_MODE_RO,
+            SYSFS_ATTR_MODE_RO, SYSFS_ATTR_MODE_RW,
         },
         vfs::InodeMode,
     },
     init::initcall::INITCALL_POSTCORE,
     libs::casting::DowncastArc,
     misc::ksysfs::sys_kernel_kobj,
-    mm::{page_cache_stats, MemoryManagementArch},
+    mm::{
+        huge_memory::{self, ThpMode},
+        page_cache_stats, MemoryManagementArch,
+    },
 };
 
 use crate::driver::base::kobject::CommonKobj;
@@ -486,6 +489,56 @@ impl Attribute for AttrShmemKb {
     }
 }
 
+#[derive(Debug)]
+struct ThpAttrGroup;
+
+impl AttributeGroup for ThpAttrGroup {
+    fn name(&self) -> Option<&str> {
+        None
+    }
+
+    fn attrs(&self) -> &[&'static dyn Attribute] {
+        &[&AttrThpEnabled]
+    }
+
+    fn is_visible(
+        &self,
+        _kobj: Arc<dyn KObject>,
+        attr: &'static dyn Attribute,
+    ) -> Option<InodeMode> {
+        Some(attr.mode())
+    }
+}
+
+/// `/sys/kernel/mm/transparent_hugepage/enabled`：透明大页的启用策略
+#[derive(Debug)]
+struct AttrThpEnabled;
+
+impl Attribute for AttrThpEnabled {
+    fn name(&self) -> &str {
+        "enabled"
+    }
+
+    fn mode(&self) -> InodeMode {
+        SYSFS_ATTR_MODE_RW
+    }
+
+    fn support(&self) -> SysFSOpsSupport {
+        SysFSOpsSupport::ATTR_SHOW | SysFSOpsSupport::ATTR_STORE
+    }
+
+    fn show(&self, _kobj: Arc<dyn KObject>, buf: &mut [u8]) -> Result<usize, SystemError> {
+        sysfs_emit_str(buf, &huge_memory::thp_mode_string())
+    }
+
+    fn store(&self, _kobj: Arc<dyn KObject>, buf: &[u8]) -> Result<usize, SystemError> {
+        let s = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        let mode = ThpMode::parse(s.trim_end_matches('\0')).ok_or(SystemError::EINVAL)?;
+        huge_memory::set_thp_mode(mode);
+        Ok(buf.len())
+    }
+}
+
 #[unified_init(INITCALL_POSTCORE)]
 fn pagecache_sysfs_init() -> Result<(), SystemError> {
     let kernel_kobj = sys_kernel_kobj();
@@ -497,6 +550,25 @@ fn pagecache_sysfs_init() -> Result<(), SystemError> {
         },
     );
 
+    let thp_kobj = CommonKobj::new("transparent_hugepage".to_string());
+    thp_kobj.set_parent(Some(Arc::downgrade(&(mm_kobj.clone() as Arc<dyn KObject>))));
+    KObjectManager::init_and_add_kobj(thp_kobj.clone(), Some(&DynamicKObjKType)).unwrap_or_else(
+        |e| {
+            log::warn!(
+                "Failed to add transparent_hugepage kobject to sysfs: {:?}",
+                e
+            );
+        },
+    );
+    crate::filesystem::sysfs::sysfs_instance()
+        .create_groups(&(thp_kobj as Arc<dyn KObject>), &[&ThpAttrGroup])
+        .unwrap_or_else(|e| {
+            log::warn!(
+                "Failed to create transparent_hugepage sysfs groups: {:?}",
+                e
+            );
+        });
+
     let pagecache_kobj = CommonKobj::new("pagecache".to_string());
     pagecache_kobj.set_parent(Some(Arc::downgrade(&(mm_kobj as Arc<dyn KObject>))));
     KObjectManager::init_and_add_kobj(pagecache_kobj.clone(), Some(&DynamicKObjKType))
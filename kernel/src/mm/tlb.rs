@@ -6,6 +6,13 @@
 //! - per-CPU `TlbState`: records the mm currently loaded on this CPU and the latest tlb_gen it has caught up to.
 //! - `FlushTlbInfo`: cross-CPU shootdown context.
 //! - `flush_tlb_multi`: synchronous cross-CPU broadcast with ack, using `CsdFlushTlb` for polling.
+//! - per-CPU ASID slots (`TlbState::ctxs`): when the hardware tags TLB entries with an address space identifier
+//!   (x86_64 PCID, RISC-V/LoongArch ASID), each CPU keeps the last `TLB_NR_DYN_ASIDS` mms it ran in their own ASID
+//!   and switching back to one of them only flushes if its `tlb_gen` moved on in the meantime (Linux `choose_new_asid`).
+//! - lazy TLB: a CPU running a kernel thread keeps the previous user mm loaded and marks itself lazy. Shootdowns that
+//!   free no page tables skip lazy CPUs; they catch up through `tlb_gen` when they switch to a user mm again.
+//! - generation catch-up: a CPU that is more than one generation behind flushes its whole ASID and jumps to the
+//!   current `tlb_gen`, so concurrent initiators on the same mm find it caught up and skip its IPI.
 //!
 //! Design invariants:
 //! - INV-1: At any point, if CPU `c`'s hardware page table equals `mm.table_paddr`, then bit `c` in `mm.active_cpus` is 1.
@@ -14,11 +21,18 @@
 //! - INV-4: When `flush_tlb_multi` returns, all target CPUs have finished executing `local_flush_tlb_func`.
 //! - INV-5: When `freed_tables == true`, the receiving end must handle it (simplified: in this iteration the sender
 //!   sends to all active CPUs regardless, and the receiver unconditionally executes).
+//! - INV-6: A CPU that is not in `active_cpus` may still hold entries for the mm under an inactive ASID. They are only
+//!   reachable after `switch_mm_irqs_off`, which reads `tlb_gen` after setting the `active_cpus` bit and flushes the
+//!   ASID if the slot is behind.
+//! - INV-7: An initiator may skip a CPU in `active_cpus` only if that CPU reports this mm loaded at a generation
+//!   `>= new_tlb_gen`, or it is lazy and no page tables were freed. A lazy CPU clears its flag before reading `tlb_gen`
+//!   in `switch_mm_irqs_off`, the initiator bumps `tlb_gen` before reading the flag (both SeqCst), so one of the two
+//!   sides always sees the other.
 
-use core::sync::atomic::{compiler_fence, Ordering};
+use core::sync::atomic::{compiler_fence, AtomicBool, AtomicU64, AtomicUsize, Ordering};
 
 #[cfg(target_arch = "x86_64")]
-use core::{hint::spin_loop, sync::atomic::AtomicBool};
+use core::hint::spin_loop;
 
 use alloc::sync::Arc;
 #[allow(unused_imports)]
@@ -31,7 +45,11 @@ use crate::{
         InterruptArch,
     },
     libs::cpumask::CpuMask,
-    mm::{percpu::PerCpuVar, ucontext::AddressSpace, MemoryManagementArch, VirtAddr},
+    mm::{
+        percpu::{PerCpu, PerCpuVar},
+        ucontext::AddressSpace,
+        MemoryManagementArch, VirtAddr,
+    },
     smp::{
         core::smp_get_processor_id,
         cpu::{smp_cpu_manager, ProcessorId},
@@ -47,6 +65,28 @@ pub const TLB_FLUSH_ALL: VirtAddr = VirtAddr::new(usize::MAX);
 /// Cf. Linux `tlb_single_page_flush_ceiling`: above this threshold, fall back to full-mm flush.
 pub const TLB_SINGLE_PAGE_FLUSH_CEILING: usize = 33;
 
+/// Current full-flush threshold, tunable through `/proc/sys/vm/tlb_single_page_flush_ceiling`.
+static TLB_FLUSH_CEILING: AtomicUsize = AtomicUsize::new(TLB_SINGLE_PAGE_FLUSH_CEILING);
+
+/// Ranges longer than this many pages are flushed as a whole mm
+#[inline]
+pub fn tlb_single_page_flush_ceiling() -> usize {
+    TLB_FLUSH_CEILING.load(Ordering::Relaxed)
+}
+
+pub fn set_tlb_single_page_flush_ceiling(pages: usize) {
+    TLB_FLUSH_CEILING.store(pages, Ordering::Relaxed);
+}
+
+/// Number of recently used mms each CPU keeps in their own ASID (cf. Linux `TLB_NR_DYN_ASIDS`).
+pub const TLB_NR_DYN_ASIDS: usize = 6;
+
+/// Number of ASID slots in use on this machine; 0 when the hardware has no ASIDs.
+#[inline]
+pub fn nr_dyn_asids() -> usize {
+    core::cmp::min(MMArch::user_asid_count(), TLB_NR_DYN_ASIDS)
+}
+
 /// Context for a single shootdown. Lives on the initiator's stack, spanning the entire IPI wait window.
 #[derive(Debug)]
 #[allow(dead_code)]
@@ -62,9 +102,8 @@ pub struct FlushTlbInfo {
     /// Page size shift (currently fixed at `PAGE_SHIFT`; huge-page stride not yet supported)
     pub stride_shift: u8,
     /// Whether page-table pages were also freed.
-    /// Current simplified policy: the sender sends IPI to all CPUs in `active_cpus`
-    /// regardless of the `freed_tables` value, and the receiver always performs the flush.
-    /// This field is retained for future lazy TLB decision-making.
+    /// Lazy CPUs may still walk the freed tables speculatively, so such a shootdown is sent to them too,
+    /// and the receiver always flushes the whole ASID (paging-structure caches included).
     pub freed_tables: bool,
     /// Initiating CPU
     pub initiating_cpu: ProcessorId,
@@ -90,23 +129,112 @@ impl FlushTlbInfo {
     }
 }
 
+/// One ASID slot of a CPU
+#[derive(Debug, Clone, Copy)]
+struct TlbContext {
+    /// `AddressSpace::id` of the mm whose entries are cached under this ASID; 0 means none.
+    ctx_id: u64,
+    /// The mm tlb_gen the entries under this ASID have caught up to
+    tlb_gen: u64,
+}
+
+impl TlbContext {
+    const EMPTY: Self = Self {
+        ctx_id: 0,
+        tlb_gen: 0,
+    };
+}
+
+/// Per-CPU shootdown counters, exported through `/proc/tlb_shootdown` and summed into `/proc/vmstat`
+#[derive(Debug)]
+pub struct TlbFlushStat {
+    /// Shootdown IPIs this CPU sent
+    pub ipi_sent: AtomicU64,
+    /// Shootdown IPIs this CPU handled
+    pub ipi_received: AtomicU64,
+    /// Remote CPUs this CPU did not interrupt because they were lazy or already caught up
+    pub ipi_skipped: AtomicU64,
+    /// Whole-ASID flushes done on behalf of a shootdown
+    pub flush_all: AtomicU64,
+    /// Pages invalidated one by one on behalf of a shootdown
+    pub pages_flushed: AtomicU64,
+}
+
+impl TlbFlushStat {
+    const fn new() -> Self {
+        Self {
+            ipi_sent: AtomicU64::new(0),
+            ipi_received: AtomicU64::new(0),
+            ipi_skipped: AtomicU64::new(0),
+            flush_all: AtomicU64::new(0),
+            pages_flushed: AtomicU64::new(0),
+        }
+    }
+
+    #[inline]
+    fn add(counter: &AtomicU64, n: u64) {
+        counter.fetch_add(n, Ordering::Relaxed);
+    }
+}
+
 /// Per-CPU TLB state
 #[derive(Debug)]
 pub struct TlbState {
     /// The mm currently loaded in hardware on this CPU (weak reference; drop does not prevent mm release)
     loaded_mm: Option<Arc<AddressSpace>>,
+    /// `AddressSpace::id` of `loaded_mm` (0 if none), readable by shootdown initiators on other CPUs
+    loaded_mm_id: AtomicU64,
     /// The mm tlb_gen this CPU has caught up to
-    loaded_tlb_gen: u64,
+    loaded_tlb_gen: AtomicU64,
+    /// Running a kernel thread on top of `loaded_mm` (Linux `cpu_tlbstate_shared.is_lazy`)
+    is_lazy: AtomicBool,
+    /// ASID `loaded_mm` runs under (meaningless without hardware ASIDs)
+    loaded_asid: usize,
+    /// Slot to evict when the next mm without a slot is switched in (round robin)
+    next_asid: usize,
+    /// ASID slots, indexed by ASID
+    ctxs: [TlbContext; TLB_NR_DYN_ASIDS],
+    stat: TlbFlushStat,
 }
 
 impl TlbState {
     const fn new() -> Self {
         Self {
             loaded_mm: None,
-            loaded_tlb_gen: 0,
+            loaded_mm_id: AtomicU64::new(0),
+            loaded_tlb_gen: AtomicU64::new(0),
+            is_lazy: AtomicBool::new(false),
+            loaded_asid: 0,
+            next_asid: 0,
+            ctxs: [TlbContext::EMPTY; TLB_NR_DYN_ASIDS],
+            stat: TlbFlushStat::new(),
         }
     }
 
+    /// Pick the ASID `next` will run under on this CPU (cf. Linux `choose_new_asid`).
+    ///
+    /// Returns the ASID and whether the entries cached under it must be flushed first.
+    fn choose_new_asid(&mut self, next: &AddressSpace, next_tlb_gen: u64) -> (usize, bool) {
+        let nr = nr_dyn_asids();
+        if nr == 0 {
+            return (0, true);
+        }
+        for asid in 0..nr {
+            if self.ctxs[asid].ctx_id == next.id() {
+                return (asid, self.ctxs[asid].tlb_gen < next_tlb_gen);
+            }
+        }
+        let asid = self.next_asid;
+        self.next_asid = (asid + 1) % nr;
+        (asid, true)
+    }
+
+    /// Record that the loaded mm has caught up to `tlb_gen`
+    fn set_loaded_tlb_gen(&mut self, tlb_gen: u64) {
+        self.loaded_tlb_gen.store(tlb_gen, Ordering::Release);
+        self.ctxs[self.loaded_asid].tlb_gen = tlb_gen;
+    }
+
     /// Get the currently loaded mm (clones the Arc)
     #[allow(dead_code)]
     pub fn loaded_mm(&self) -> Option<Arc<AddressSpace>> {
@@ -123,10 +251,52 @@ impl TlbState {
         }
     }
 
-    #[allow(dead_code)]
     pub fn loaded_tlb_gen(&self) -> u64 {
-        self.loaded_tlb_gen
+        self.loaded_tlb_gen.load(Ordering::Acquire)
     }
+
+    /// Whether a shootdown of `mm` up to `new_tlb_gen` must interrupt this CPU (cf. Linux `should_flush_tlb`).
+    ///
+    /// May be called from any CPU; see INV-7.
+    fn should_flush(&self, mm: &AddressSpace, new_tlb_gen: u64, freed_tables: bool) -> bool {
+        if self.loaded_mm_id.load(Ordering::Acquire) == mm.id()
+            && self.loaded_tlb_gen.load(Ordering::Acquire) >= new_tlb_gen
+        {
+            return false;
+        }
+        freed_tables || !self.is_lazy.load(Ordering::SeqCst)
+    }
+}
+
+/// This CPU's shootdown counters, `None` before `tlb_init`
+pub fn tlb_cpu_stat(cpu: ProcessorId) -> Option<&'static TlbFlushStat> {
+    let states = unsafe { TLB_STATE.as_ref() }?;
+    Some(unsafe { &states.force_get(cpu).stat })
+}
+
+/// Shootdown counters summed over all CPUs
+#[derive(Debug, Default, Clone, Copy)]
+pub struct TlbFlushStats {
+    pub ipi_sent: u64,
+    pub ipi_received: u64,
+    pub ipi_skipped: u64,
+    pub flush_all: u64,
+    pub pages_flushed: u64,
+}
+
+pub fn tlb_flush_stats() -> TlbFlushStats {
+    let mut sum = TlbFlushStats::default();
+    for cpu in 0..PerCpu::MAX_CPU_NUM {
+        let Some(stat) = tlb_cpu_stat(ProcessorId::new(cpu)) else {
+            break;
+        };
+        sum.ipi_sent += stat.ipi_sent.load(Ordering::Relaxed);
+        sum.ipi_received += stat.ipi_received.load(Ordering::Relaxed);
+        sum.ipi_skipped += stat.ipi_skipped.load(Ordering::Relaxed);
+        sum.flush_all += stat.flush_all.load(Ordering::Relaxed);
+        sum.pages_flushed += stat.pages_flushed.load(Ordering::Relaxed);
+    }
+    sum
 }
 
 /// Return this CPU's hardware-loaded mm tracked by the lazy TLB state.
@@ -184,7 +354,7 @@ static FLUSH_TLB_GLOBAL_LOCK: SpinLock<()> = SpinLock::new(());
 
 /// Initialize this module. Must be called after `PerCpu::init()`.
 pub fn tlb_init() {
-    let cpu_num = crate::mm::percpu::PerCpu::MAX_CPU_NUM as usize;
+    let cpu_num = PerCpu::MAX_CPU_NUM as usize;
 
     let mut states: Vec<TlbState> = Vec::with_capacity(cpu_num);
     for _ in 0..cpu_num {
@@ -241,17 +411,73 @@ pub fn tlb_state_force(cpu: ProcessorId) -> &'static TlbState {
     unsafe { tlb_state().force_get(cpu) }
 }
 
-/// After context switch, update this CPU's TlbState to the new mm.
+/// Load `next`'s page table on this CPU and update this CPU's TlbState (cf. Linux `switch_mm_irqs_off`).
+///
+/// With hardware ASIDs, `next` reuses the ASID this CPU last ran it under and the TLB is only flushed if `next.tlb_gen`
+/// moved past that slot's generation; an mm without a slot evicts one round robin and flushes it. Switching to the
+/// already loaded mm does not touch the hardware unless a flush was missed.
 ///
 /// # Safety
 ///
 /// - The caller must execute this with interrupts disabled (to ensure per-CPU data is not preempted).
-/// - `mm.active_cpus` must already include this CPU (set the bit before calling this function during switch).
-pub unsafe fn tlb_state_set_loaded_mm(mm: Arc<AddressSpace>) {
+/// - `next.active_cpus` must already include this CPU: `tlb_gen` is read afterwards, so a concurrent
+///   `flush_tlb_mm_range` either targets this CPU or is seen here through the generation (INV-6).
+pub unsafe fn switch_mm_irqs_off(next: &Arc<AddressSpace>) {
     let st = tlb_state_local_mut();
-    let new_gen = mm.tlb_gen.load(Ordering::SeqCst);
-    st.loaded_mm = Some(mm);
-    st.loaded_tlb_gen = new_gen;
+    // Leave lazy mode before reading tlb_gen: a shootdown that skipped this CPU bumped the generation first (INV-7).
+    st.is_lazy.store(false, Ordering::SeqCst);
+    compiler_fence(Ordering::SeqCst);
+    let next_tlb_gen = next.tlb_gen.load(Ordering::SeqCst);
+
+    if st.loaded_is(next) {
+        if st.loaded_tlb_gen() < next_tlb_gen {
+            MMArch::invalidate_current_asid();
+            st.set_loaded_tlb_gen(next_tlb_gen);
+        }
+        return;
+    }
+
+    let (asid, need_flush) = st.choose_new_asid(next, next_tlb_gen);
+    MMArch::switch_user_table(next.table_paddr(), asid, need_flush);
+    compiler_fence(Ordering::SeqCst);
+
+    st.ctxs[asid] = TlbContext {
+        ctx_id: next.id(),
+        tlb_gen: next_tlb_gen,
+    };
+    st.loaded_asid = asid;
+    // Publish the generation before the id, so a remote `should_flush` never pairs `next.id()` with the
+    // generation of the previous mm.
+    st.loaded_tlb_gen.store(next_tlb_gen, Ordering::Release);
+    st.loaded_mm_id.store(next.id(), Ordering::Release);
+    st.loaded_mm = Some(next.clone());
+}
+
+/// Keep the loaded mm while running a task without a user mm (cf. Linux `enter_lazy_tlb`).
+///
+/// Until the next `switch_mm_irqs_off`, shootdowns that free no page tables skip this CPU.
+///
+/// # Safety
+///
+/// The caller must execute this with interrupts disabled.
+pub unsafe fn enter_lazy_tlb() {
+    tlb_state_local_mut().is_lazy.store(true, Ordering::SeqCst);
+}
+
+/// Forget every ASID slot of this CPU except the loaded one, so each is flushed before it is used again.
+///
+/// Used when a kernel mapping changed and the hardware cannot invalidate it in other ASIDs directly.
+pub fn invalidate_other_asids() {
+    // Before tlb_init no ASID has been handed out yet.
+    let Some(states) = (unsafe { TLB_STATE.as_ref() }) else {
+        return;
+    };
+    let st = states.get_mut();
+    for asid in 0..nr_dyn_asids() {
+        if asid != st.loaded_asid {
+            st.ctxs[asid] = TlbContext::EMPTY;
+        }
+    }
 }
 
 /// Clear this CPU's loaded_mm (used for the final state when a process exits and user_vm is set to None).
@@ -263,38 +489,45 @@ pub unsafe fn tlb_state_set_loaded_mm(mm: Arc<AddressSpace>) {
 pub unsafe fn tlb_state_clear_loaded_mm() {
     let st = tlb_state_local_mut();
     st.loaded_mm = None;
-    st.loaded_tlb_gen = 0;
+    st.loaded_mm_id.store(0, Ordering::Release);
+    st.loaded_tlb_gen.store(0, Ordering::Release);
 }
 
-/// Context-aware local TLB flush.
+/// Context-aware local TLB flush (cf. Linux `flush_tlb_func`).
 ///
 /// Policy:
-/// - Full mm or range exceeding `TLB_SINGLE_PAGE_FLUSH_CEILING` pages → `invalidate_all`.
-/// - Otherwise, invalidate page by page via `invalidate_page`.
+/// - This CPU already caught up to `info.new_tlb_gen` (a later flush got here first) → nothing to do.
+/// - This request is the only generation this CPU is behind, and its range is within
+///   `tlb_single_page_flush_ceiling` pages → invalidate page by page via `invalidate_page`.
+/// - Otherwise (full mm, freed tables, large range, or other generations pending whose ranges are unknown here)
+///   → `invalidate_current_asid` and catch up to the mm's current `tlb_gen`.
 ///
-/// Only updates `loaded_tlb_gen` when this CPU's loaded_mm matches `info.mm`.
+/// Only acts when this CPU's loaded_mm matches `info.mm`.
 pub fn local_flush_tlb_func(info: &FlushTlbInfo) {
-    let loaded_matches = {
-        let st = tlb_state_force(smp_get_processor_id());
-        st.loaded_is(&info.mm)
-    };
+    let st = tlb_state_local_mut();
+    if !st.loaded_is(&info.mm) {
+        // This CPU has already switched to a different mm. Entries it may still hold for this
+        // mm under an inactive ASID are flushed when switching back, since that slot's tlb_gen
+        // is now behind (INV-6).
+        return;
+    }
 
-    if !loaded_matches {
-        // This CPU has already switched to a different mm; the previous CR3 write implicitly
-        // invalidated the entire TLB, no further flush needed.
+    let local_gen = st.loaded_tlb_gen();
+    if info.new_tlb_gen <= local_gen {
         return;
     }
+    let mm_gen = info.mm.tlb_gen.load(Ordering::SeqCst);
 
     // When intermediate page-table pages have been freed, per-page invlpg cannot clear
     // Paging-Structure Cache (PSC) entries pointing to the reclaimed intermediate PT;
     // a full-mm invalidation is required, matching Linux `tlb->freed_tables` semantics.
-    let must_full = info.is_flush_all()
-        || info.freed_tables
-        || info.range_pages() > TLB_SINGLE_PAGE_FLUSH_CEILING;
+    let partial = !info.is_flush_all()
+        && !info.freed_tables
+        && info.new_tlb_gen == local_gen + 1
+        && info.new_tlb_gen == mm_gen
+        && info.range_pages() <= tlb_single_page_flush_ceiling();
 
-    if must_full {
-        unsafe { MMArch::invalidate_all() };
-    } else {
+    if partial {
         let stride = 1usize << info.stride_shift;
         let mut addr = info.start.data();
         let end = info.end.data();
@@ -302,11 +535,12 @@ pub fn local_flush_tlb_func(info: &FlushTlbInfo) {
             unsafe { MMArch::invalidate_page(VirtAddr::new(addr)) };
             addr = addr.saturating_add(stride);
         }
-    }
-
-    let st = tlb_state_local_mut();
-    if st.loaded_tlb_gen < info.new_tlb_gen {
-        st.loaded_tlb_gen = info.new_tlb_gen;
+        TlbFlushStat::add(&st.stat.pages_flushed, info.range_pages() as u64);
+        st.set_loaded_tlb_gen(info.new_tlb_gen);
+    } else {
+        unsafe { MMArch::invalidate_current_asid() };
+        TlbFlushStat::add(&st.stat.flush_all, 1);
+        st.set_loaded_tlb_gen(mm_gen);
     }
 }
 
@@ -337,6 +571,7 @@ pub fn remote_flush_tlb_on_ipi() {
         // it will not be freed before done=true.
         let info = unsafe { &*info_ptr };
 
+        TlbFlushStat::add(&tlb_state_local_mut().stat.ipi_received, 1);
         local_flush_tlb_func(info);
 
         compiler_fence(Ordering::SeqCst);
@@ -364,6 +599,8 @@ fn flush_tlb_multi(target_cpus: &CpuMask, info: &FlushTlbInfo) {
     let active: CpuMask = target_cpus & online;
 
     let my_cpu = smp_get_processor_id();
+    let sent = active.iter_cpu().filter(|&cpu| cpu != my_cpu).count();
+    TlbFlushStat::add(&tlb_state_force(my_cpu).stat.ipi_sent, sent as u64);
 
     #[cfg(target_arch = "x86_64")]
     {
@@ -428,6 +665,10 @@ fn flush_tlb_multi(target_cpus: &CpuMask, info: &FlushTlbInfo) {
 /// - `end`: end virtual address (exclusive). If equal to `TLB_FLUSH_ALL`, flush the entire mm.
 /// - `stride_shift`: page size shift (typically `MMArch::PAGE_SHIFT`)
 /// - `freed_tables`: whether page-table pages were also freed
+///
+/// Concurrent initiators on the same mm are batched: the generation is bumped before queueing for
+/// the shootdown lock, and CPUs that a previous shootdown already brought up to it are not interrupted
+/// again. Lazy CPUs are skipped unless page tables were freed (INV-7).
 pub fn flush_tlb_mm_range(
     mm: &Arc<AddressSpace>,
     start: VirtAddr,
@@ -435,6 +676,21 @@ pub fn flush_tlb_mm_range(
     stride_shift: u8,
     freed_tables: bool,
 ) {
+    // Past the ceiling one full flush is cheaper than invalidating page by page on every target.
+    let (start, end) = if end != TLB_FLUSH_ALL
+        && (end.data().saturating_sub(start.data()) >> stride_shift)
+            > tlb_single_page_flush_ceiling()
+    {
+        (VirtAddr::new(0), TLB_FLUSH_ALL)
+    } else {
+        (start, end)
+    };
+
+    // Publish barrier: ensure page table writes are visible to other CPUs before the generation increment.
+    compiler_fence(Ordering::SeqCst);
+    let new_gen = mm.tlb_gen.fetch_add(1, Ordering::SeqCst) + 1;
+    compiler_fence(Ordering::SeqCst);
+
     // Serialize before disabling local interrupts. If a CPU spins for the
     // shootdown CSD slots with IRQs disabled, it cannot service another CPU's
     // TLB IPI, and two concurrent flush initiators can deadlock.
@@ -448,15 +704,10 @@ pub fn flush_tlb_mm_range(
     let _flush_guard = FLUSH_TLB_GLOBAL_LOCK.lock();
 
     // Disable interrupts to protect the entire initiation process:
-    // - Prevent migration during inc_tlb_gen and snapshot of active_cpus;
+    // - Prevent migration while snapshotting active_cpus;
     // - Prevent being scheduled out while waiting for IPI ack.
     let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
 
-    // Publish barrier: ensure page table writes are visible to other CPUs before the generation increment.
-    compiler_fence(Ordering::SeqCst);
-    let new_gen = mm.tlb_gen.fetch_add(1, Ordering::SeqCst) + 1;
-    compiler_fence(Ordering::SeqCst);
-
     let this_cpu = smp_get_processor_id();
 
     let info = FlushTlbInfo {
@@ -470,26 +721,28 @@ pub fn flush_tlb_mm_range(
     };
 
     // Snapshot the remote target set.
-    let remote_mask: CpuMask = {
+    let mut remote_mask: CpuMask = {
         let g = mm.active_cpus.lock();
         let mut m = g.clone();
         // Exclude this CPU; local flush is handled separately
         m.set(this_cpu, false);
         m
     };
+    let mut skipped = 0;
+    for cpu in remote_mask.clone().iter_cpu() {
+        if !tlb_state_force(cpu).should_flush(mm, new_gen, freed_tables) {
+            remote_mask.set(cpu, false);
+            skipped += 1;
+        }
+    }
+    TlbFlushStat::add(&tlb_state_force(this_cpu).stat.ipi_skipped, skipped);
 
     if !remote_mask.is_empty() {
         flush_tlb_multi(&remote_mask, &info);
     }
 
     // If this CPU is currently using this mm, perform local flush
-    let loaded_local = {
-        let st = tlb_state_force(this_cpu);
-        st.loaded_is(mm)
-    };
-    if loaded_local {
-        local_flush_tlb_func(&info);
-    }
+    local_flush_tlb_func(&info);
 
     compiler_fence(Ordering::SeqCst);
     drop(irq_guard);
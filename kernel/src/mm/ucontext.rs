@@ -32,10 +32,16 @@ use crate::{
         align::page_align_up,
         cpumask::CpuMask,
         mutex::{Mutex, MutexGuard},
-        rwsem::RwSem,
+        rwsem::{RwSem, RwSemReadGuard, RwSemWriteGuard},
         spinlock::SpinLock,
     },
-    mm::{mmu_gather::MmuGather, page::page_manager_lock, PhysAddr},
+    mm::{
+        huge_memory::{self, HPAGE_PMD_SIZE},
+        mmu_gather::MmuGather,
+        page::{page_manager, PageEntry},
+        swap::{swap_state, swapfile, SwapEntry},
+        PhysAddr,
+    },
     process::{cred::CAPFlags, resource::RLimitID, ProcessManager},
 };
 
@@ -89,13 +95,22 @@ pub struct AddressSpace {
     /// `flush_tlb_*` must increment this after publishing page table writes and before snapshotting `active_cpus`;
     /// remote CPUs receiving IPI write this to per-CPU `TlbState::loaded_tlb_gen` as a "caught-up generation" marker.
     pub tlb_gen: AtomicU64,
-    /// Serialize all user page-table edits for this mm.
+    /// Serialize user page-table edits for this mm.
     ///
     /// This is intentionally separate from `inner: RwSem<InnerAddressSpace>`:
     /// file-rmap walkers need to edit remote PTEs under `mapping->i_mmap.read()`
     /// without taking `mm.write()`, while fault/munmap/mprotect/mremap paths must
     /// still synchronize with those edits.
-    page_table_edit_lock: Mutex<()>,
+    ///
+    /// Edits spanning arbitrary ranges take it for writing ([`Self::page_table_edit`]).
+    /// Page faults only touch the last-level table covering the faulting address;
+    /// they take it for reading plus one of `pte_locks` ([`Self::pte_lock`]), so
+    /// faults on disjoint regions of the same mm run in parallel.
+    page_table_edit_lock: RwSem<()>,
+    /// Split PTE locks, hashed by the last-level page table (PMD-sized region).
+    ///
+    /// Each lock covers the PMD entry of its regions and the PTE table it points to.
+    pte_locks: [Mutex<()>; PTE_LOCK_BUCKETS],
     /// 使用RwSem而非RwLock，因为地址空间操作可能需要进行I/O（如页缺失时的文件读取）
     inner: RwSem<InnerAddressSpace>,
 }
@@ -110,7 +125,8 @@ impl AddressSpace {
             table_paddr,
             active_cpus: SpinLock::new(CpuMask::new()),
             tlb_gen: AtomicU64::new(0),
-            page_table_edit_lock: Mutex::new(()),
+            page_table_edit_lock: RwSem::new(()),
+            pte_locks: core::array::from_fn(|_| Mutex::new(())),
             inner: RwSem::new(inner),
         });
         // Back-fill the Weak<AddressSpace> so that InnerAddressSpace methods can obtain
@@ -158,15 +174,6 @@ impl AddressSpace {
         return false;
     }
 
-    /// 将此地址空间的页表设置为当前页表（无锁）
-    ///
-    /// 此方法用于调度器上下文中的快速页表切换，无需获取RwSem锁。
-    /// 安全性由调用者保证：只在进程切换时使用。
-    #[inline(always)]
-    pub unsafe fn make_current(&self) {
-        MMArch::set_table(PageTableKind::User, self.table_paddr);
-    }
-
     /// Add the specified CPU to this mm's `active_cpus`.
     ///
     /// The caller should invoke this after the hardware has loaded this mm's page table, or immediately before loading,
@@ -207,14 +214,44 @@ impl AddressSpace {
         crate::mm::tlb::flush_tlb_mm(self);
     }
 
+    /// Lock out all other page-table edits of this mm (including faults).
     #[inline]
-    pub fn page_table_edit(&self) -> MutexGuard<'_, ()> {
+    pub fn page_table_edit(&self) -> RwSemWriteGuard<'_, ()> {
         debug_assert!(
             CurrentIrqArch::is_irq_enabled(),
             "page_table_edit_lock must not be taken with interrupts disabled"
         );
-        self.page_table_edit_lock.lock()
+        self.page_table_edit_lock.write()
     }
+
+    /// Lock the last-level page table covering `addr` (and the PMD entry pointing to it).
+    ///
+    /// The holder may only edit entries inside the PMD-sized region containing `addr`.
+    /// Page tables above PMD level must be allocated under [`Self::page_table_edit`].
+    #[inline]
+    pub fn pte_lock(&self, addr: VirtAddr) -> PteLockGuard<'_> {
+        debug_assert!(
+            CurrentIrqArch::is_irq_enabled(),
+            "page_table_edit_lock must not be taken with interrupts disabled"
+        );
+        let edit = self.page_table_edit_lock.read();
+        let bucket = (addr.data() / HPAGE_PMD_SIZE) % PTE_LOCK_BUCKETS;
+        PteLockGuard {
+            _pte: self.pte_locks[bucket].lock(),
+            _edit: edit,
+        }
+    }
+}
+
+/// Number of split PTE locks per address space.
+const PTE_LOCK_BUCKETS: usize = 64;
+
+/// Guard returned by [`AddressSpace::pte_lock`].
+///
+/// Fields drop in declaration order: the PTE lock is released before the shared edit lock.
+pub struct PteLockGuard<'a> {
+    _pte: MutexGuard<'a, ()>,
+    _edit: RwSemReadGuard<'a, ()>,
 }
 
 impl Drop for AddressSpace {
@@ -273,6 +310,9 @@ pub struct InnerAddressSpace {
     pub start_data: VirtAddr,
     pub end_data: VirtAddr,
 
+    /// vDSO镜像的起始地址（vvar页位于其前方），未映射vDSO时为0
+    pub vdso_base: VirtAddr,
+
     /// Weak reference back to the outer `AddressSpace`.
     ///
     /// Back-filled by `AddressSpace::new` after constructing the Arc; used by internal
@@ -309,6 +349,7 @@ impl InnerAddressSpace {
             end_code: VirtAddr(0),
             start_data: VirtAddr(0),
             end_data: VirtAddr(0),
+            vdso_base: VirtAddr(0),
             outer: Weak::new(),
         };
 
@@ -354,6 +395,7 @@ impl InnerAddressSpace {
         new_guard.end_code = self.end_code;
         new_guard.start_data = self.start_data;
         new_guard.end_data = self.end_data;
+        new_guard.vdso_base = self.vdso_base;
 
         // 遍历父进程的每个VMA，根据VMA属性进行适当的复制
         // 参考 Linux: https://code.dragonos.org.cn/xref/linux-6.6.21/mm/memory.c#copy_page_range
@@ -414,7 +456,18 @@ impl InnerAddressSpace {
                 let _parent_pt_edit = parent_mm.page_table_edit();
                 let old_mapper = &mut self.user_mapper.utable;
                 let new_mapper = &mut new_guard.user_mapper.utable;
-                let mut page_manager_guard = page_manager_lock();
+                // 写时复制按4K页进行，先拆分父进程私有映射中的透明大页
+                if !is_shared {
+                    unsafe {
+                        huge_memory::split_huge_pmd_range(
+                            old_mapper,
+                            region,
+                            false,
+                            &mut parent_tlb,
+                        )?
+                    };
+                }
+                let page_manager_guard = page_manager();
 
                 while current_page < end_page {
                     if let Some((phys_addr, old_flags)) = old_mapper.translate(current_page) {
@@ -449,6 +502,28 @@ impl InnerAddressSpace {
                                 page.write().insert_vma(new_vma.clone());
                             }
                         }
+                    } else if let Some(entry) = (!is_shared)
+                        .then(|| old_mapper.get_entry(current_page, 0))
+                        .flatten()
+                        .and_then(|pte| SwapEntry::from_pte(&pte))
+                    {
+                        // 已被换出的私有页：子进程共享同一个交换槽位
+                        if swapfile::swap_duplicate(entry).is_ok() {
+                            if unsafe { new_mapper.map_nonpresent(current_page, entry.to_pte()) }
+                                .is_none()
+                            {
+                                swapfile::swap_free(entry);
+                                warn!("Failed to map swap entry {:?} at {:?} in child process (current_pid: {:?})",
+                                      entry, current_page, ProcessManager::current_pcb().raw_pid());
+                            }
+                        } else {
+                            warn!(
+                                "Failed to duplicate swap entry {:?} at {:?} (current_pid: {:?})",
+                                entry,
+                                current_page,
+                                ProcessManager::current_pcb().raw_pid()
+                            );
+                        }
                     }
                     current_page = VirtAddr::new(current_page.data() + MMArch::PAGE_SIZE);
                 }
@@ -565,7 +640,7 @@ impl InnerAddressSpace {
 
     fn mark_present_page_unevictable(&mut self, addr: VirtAddr) {
         if let Some((paddr, _)) = self.user_mapper.utable.translate(addr) {
-            let mut page_manager_guard = page_manager_lock();
+            let page_manager_guard = page_manager();
             let page = page_manager_guard.get_unwrap(&paddr);
             page.write().add_flags(PageFlags::PG_UNEVICTABLE);
         }
@@ -1269,7 +1344,16 @@ impl InnerAddressSpace {
 
         {
             let _pt_edit = mm.page_table_edit();
-            let mut page_manager_guard = page_manager_lock();
+            // 按4K页搬移映射，先拆分源区间内的透明大页
+            unsafe {
+                huge_memory::split_huge_pmd_range(
+                    mapper,
+                    VirtRegion::new(old_vaddr, move_len),
+                    false,
+                    &mut tlb,
+                )?
+            };
+            let page_manager_guard = page_manager();
             let mut off = 0usize;
             while off < move_len {
                 let src = old_vaddr + off;
@@ -1299,8 +1383,27 @@ impl InnerAddressSpace {
                     let mut pg = page.write();
                     if !dontunmap {
                         pg.remove_vma(old_vma.as_ref());
+                        if pg.anon_address() == Some(src) {
+                            pg.set_anon_address(Some(dst));
+                        }
                     }
                     pg.insert_vma(new_vma.clone());
+                } else if let Some(entry) = mapper
+                    .get_entry(src, 0)
+                    .and_then(|pte| SwapEntry::from_pte(&pte))
+                {
+                    // 已被换出的页：搬移（或在DONTUNMAP时复制）交换页表项
+                    if dontunmap {
+                        swapfile::swap_duplicate(entry)?;
+                    } else if let Some((_, flush)) =
+                        unsafe { mapper.replace_leaf_entry(src, PageEntry::from_usize(0)) }
+                    {
+                        unsafe { flush.ignore() };
+                    }
+                    if unsafe { mapper.map_nonpresent(dst, entry.to_pte()) }.is_none() {
+                        swapfile::swap_free(entry);
+                        return Err(SystemError::ENOMEM);
+                    }
                 }
                 off += MMArch::PAGE_SIZE;
             }
@@ -1352,6 +1455,19 @@ impl InnerAddressSpace {
         let mm = self.outer_addr_space().ok_or(SystemError::EFAULT)?;
         let mut tlb = MmuGather::gather(&mm);
 
+        // 跨越区间边界的透明大页需要先拆分，完全落在区间内的大页由 VMA::unmap 整体释放
+        {
+            let _pt_edit = mm.page_table_edit();
+            unsafe {
+                huge_memory::split_huge_pmd_range(
+                    &mut self.user_mapper.utable,
+                    region_to_unmap,
+                    true,
+                    &mut tlb,
+                )?
+            };
+        }
+
         // 遍历每个相关的 VMA，将当前的 VMA 拆分为可能的三块 VMA，然后删除与需要删除的区域相交的部分。
         // 示意图：对每个与 region_to_unmap 相交的 VMA，按交集拆分成三段（before / intersection / after），
         // 然后仅对 intersection 段执行解除映射；before/after 重新插回 mappings。
@@ -1429,6 +1545,12 @@ impl InnerAddressSpace {
         let regions = self.mappings.conflicts(region).collect::<Vec<_>>();
         // debug!("mprotect: regions: {:?}", regions);
 
+        // 页表项的权限需要按4K页修改，先拆分区间内的透明大页
+        {
+            let _pt_edit = mm.page_table_edit();
+            unsafe { huge_memory::split_huge_pmd_range(mapper, region, false, &mut tlb)? };
+        }
+
         for r in regions {
             // debug!("mprotect: r: {:?}", r);
             let r = *r.lock().region();
@@ -1704,7 +1826,7 @@ impl InnerAddressSpace {
         let mut vaddr = start;
         while vaddr < end {
             if let Some((paddr, _)) = mapper.translate(vaddr) {
-                let mut page_manager_guard = page_manager_lock();
+                let page_manager_guard = page_manager();
                 let page = page_manager_guard.get_unwrap(&paddr);
                 let mut page_guard = page.write();
                 if !Self::page_should_remain_unevictable(&page_guard) {
@@ -1745,6 +1867,17 @@ impl InnerAddressSpace {
             }
         }
 
+        if matches!(
+            behavior,
+            MadvFlags::MADV_DONTNEED | MadvFlags::MADV_DONTNEED_LOCKED
+        ) {
+            // 跨越区间边界的透明大页需要先拆分，区间内的大页由 do_madvise 整体释放
+            let _pt_edit = mm.page_table_edit();
+            unsafe { huge_memory::split_huge_pmd_range(mapper, region, true, &mut tlb)? };
+        } else if behavior == MadvFlags::MADV_HUGEPAGE {
+            huge_memory::khugepaged_enter(&mm);
+        }
+
         for r in regions {
             let r = *r.lock().region();
             let r = self.mappings.remove_vma(&r).unwrap();
@@ -2321,7 +2454,7 @@ impl LockedVMA {
         let mut self_guard = self.lock();
 
         // 获取物理页的anon_vma的守卫
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
 
         // 获取映射的物理地址
         if let Some((paddr, _flags)) = mapper.translate(self_guard.region().start()) {
@@ -2348,7 +2481,13 @@ impl LockedVMA {
         }
 
         for page in self_guard.region.pages() {
+            // 透明大页整体落在VMA内，一次取消整个PMD的映射，剩余的子页在translate时已无映射
+            if unsafe { huge_memory::zap_huge_pmd(self, mapper, page.virt_address(), tlb) } {
+                continue;
+            }
             if mapper.translate(page.virt_address()).is_none() {
+                // 已被换出的页只需释放交换槽位
+                unsafe { swap_state::zap_swap_pte(mapper, page.virt_address()) };
                 continue;
             }
             let (paddr, _, flush, freed_tables) =
@@ -2360,6 +2499,7 @@ impl LockedVMA {
             let can_dealloc = {
                 let mut page_guard = page_arc.write();
                 page_guard.remove_vma(self);
+                swap_state::try_to_free_swap(&mut page_guard);
                 // The physical page's VMA list length is 0 and it is not marked as non-reclaimable, so it can be freed.
                 // TODO: LRU-based physical page reclamation in the future
                 page_guard.can_deallocate()
@@ -2403,7 +2543,7 @@ impl LockedVMA {
         };
         drop(self_guard);
 
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         for page in intersection.pages() {
             if mapper.translate(page.virt_address()).is_none() {
                 continue;
@@ -2527,7 +2667,7 @@ impl LockedVMA {
         });
 
         // 重新设置before、after这两个VMA里面的物理页的anon_vma
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         if let Some(before) = before.clone() {
             let virt_iter = before.lock().region.iter_pages();
             for frame in virt_iter {
@@ -2745,12 +2885,12 @@ impl AnonSharedMapping {
     pub fn get_or_create_page(&self, pgoff: usize) -> Result<Arc<Page>, SystemError> {
         let mut guard = self.pages.lock_irqsave();
         if let Some(paddr) = guard.get(&pgoff).copied() {
-            let mut pm = page_manager_lock();
+            let pm = page_manager();
             return Ok(pm.get_unwrap(&paddr));
         }
 
         // Allocate while holding the map lock to avoid duplicate creations.
-        let mut pm = page_manager_lock();
+        let pm = page_manager();
         let mut allocator = LockedFrameAllocator;
         let page = pm.create_one_page(PageType::Normal, PageFlags::empty(), &mut allocator)?;
         // Mark shared-anon pages as unevictable so shrinking/unmapping doesn't drop their contents.
@@ -2768,7 +2908,7 @@ impl Drop for AnonSharedMapping {
             guard.values().copied().collect()
         };
 
-        let mut pm = page_manager_lock();
+        let pm = page_manager();
         for paddr in pages {
             if let Some(page) = pm.get(&paddr) {
                 let mut pg = page.write();
@@ -2819,6 +2959,14 @@ impl VMA {
         return self.vm_file.clone();
     }
 
+    /// 判断VMA是否为私有匿名映射（不关联文件、共享匿名对象或SysV SHM）
+    pub fn is_private_anonymous(&self) -> bool {
+        !self.vm_flags.contains(VmFlags::VM_SHARED)
+            && self.vm_file.is_none()
+            && self.shared_anon.is_none()
+            && self.shm_id.is_none()
+    }
+
     pub fn address_space(&self) -> Option<Weak<AddressSpace>> {
         return self.user_address_space.clone();
     }
@@ -2996,7 +3144,7 @@ impl VMA {
         }
 
         // 将VMA加入到anon_vma中
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         cur_phy = params.phys;
         for _ in 0..params.count.data() {
             let paddr = cur_phy.phys_address();
@@ -3065,7 +3213,7 @@ impl VMA {
         // debug!("VMA::zeroed: flusher dropped");
 
         // 清空这些内存并将VMA加入到anon_vma中
-        let mut page_manager_guard = page_manager_lock();
+        let page_manager_guard = page_manager();
         let virt_iter: VirtPageFrameIter =
             VirtPageFrameIter::new(destination, destination.add(page_count));
         for frame in virt_iter {
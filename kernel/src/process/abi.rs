@@ -51,8 +51,10 @@ pub enum AtType {
     RseqAlign = 28,
     /// Filename of program.
     ExecFn = 31,
+    /// Base address of the vDSO image.
+    SysInfoEhdr = 33,
     /// Minimal stack size for signal delivery.
-    MinSigStackSize,
+    MinSigStackSize = 51,
 }
 
 impl TryFrom<u32> for AtType {
@@ -85,6 +87,7 @@ impl TryFrom<u32> for AtType {
             27 => Ok(AtType::RseqFeatureSize),
             28 => Ok(AtType::RseqAlign),
             31 => Ok(AtType::ExecFn),
+            33 => Ok(AtType::SysInfoEhdr),
             51 => Ok(AtType::MinSigStackSize),
             _ => Err("Invalid value for AtType"),
         }
@@ -259,8 +259,8 @@ fn do_execve_switch_user_vm(new_vm: Arc<AddressSpace>) -> Option<Arc<AddressSpac
     let old_address_space = basic_info.user_vm();
 
     // INV-1: when execve switches mm, first clear this CPU from the old mm's active_cpus,
-    // then switch the hardware page table, then add this CPU to the new mm's active_cpus,
-    // and finally update per-CPU TlbState.
+    // then add this CPU to the new mm's active_cpus, and finally switch the hardware page
+    // table together with the per-CPU TlbState (which reads tlb_gen after the bit is set).
     // Note: on the execve path the old/new mm are always different (the new mm is a freshly
     // created AddressSpace::new result).
     if let Some(old_vm) = old_address_space.as_ref() {
@@ -285,10 +285,8 @@ fn do_execve_switch_user_vm(new_vm: Arc<AddressSpace>) -> Option<Arc<AddressSpac
     );
 
     // 切换到新的用户地址空间
-    unsafe { new_vm.make_current() };
-
     new_vm.active_cpus_set(cpu);
-    unsafe { crate::mm::tlb::tlb_state_set_loaded_mm(new_vm.clone()) };
+    unsafe { crate::mm::tlb::switch_mm_irqs_off(&new_vm) };
 
     drop(irq_guard);
 
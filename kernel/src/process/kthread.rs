@@ -1,4 +1,5 @@
 use core::{
+    any::Any,
     hint::spin_loop,
     sync::atomic::{compiler_fence, AtomicBool, Ordering},
 };
@@ -59,11 +60,23 @@ bitflags! {
     }
 }
 
-#[derive(Debug)]
 pub struct KernelThreadPcbPrivate {
     flags: KernelThreadFlags,
     result: usize,
     exited: Arc<Completion>,
+    /// 内核线程自己挂上的私有数据，类似Linux的`kthread_data()`
+    data: Option<Arc<dyn Any + Send + Sync>>,
+}
+
+impl core::fmt::Debug for KernelThreadPcbPrivate {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("KernelThreadPcbPrivate")
+            .field("flags", &self.flags)
+            .field("result", &self.result)
+            .field("exited", &self.exited)
+            .field("has_data", &self.data.is_some())
+            .finish()
+    }
 }
 
 #[allow(dead_code)]
@@ -73,6 +86,7 @@ impl KernelThreadPcbPrivate {
             flags: KernelThreadFlags::empty(),
             result: 0,
             exited: Arc::new(Completion::new()),
+            data: None,
         }
     }
 
@@ -95,6 +109,14 @@ impl KernelThreadPcbPrivate {
     pub fn exited_completion(&self) -> Arc<Completion> {
         self.exited.clone()
     }
+
+    pub fn data(&self) -> Option<Arc<dyn Any + Send + Sync>> {
+        self.data.clone()
+    }
+
+    pub fn set_data(&mut self, data: Option<Arc<dyn Any + Send + Sync>>) {
+        self.data = data;
+    }
 }
 
 impl Default for KernelThreadPcbPrivate {
@@ -400,7 +422,25 @@ impl KernelThreadMechanism {
     /// - Some(Arc<ProcessControlBlock>) 创建成功，返回新创建的内核线程的PCB
     #[allow(dead_code)]
     pub fn create(func: KernelThreadClosure, name: String) -> Option<Arc<ProcessControlBlock>> {
+        Self::create_with_info(KernelThreadCreateInfo::new(func, name))
+    }
+
+    /// 创建一个绑定在`cpu`上的内核线程，它只会在该cpu上运行
+    ///
+    /// ## 返回值
+    ///
+    /// - Some(Arc<ProcessControlBlock>) 创建成功，返回新创建的内核线程的PCB
+    pub fn create_on_cpu(
+        func: KernelThreadClosure,
+        name: String,
+        cpu: ProcessorId,
+    ) -> Option<Arc<ProcessControlBlock>> {
         let info = KernelThreadCreateInfo::new(func, name);
+        info.set_per_cpu(cpu).ok()?;
+        Self::create_with_info(info)
+    }
+
+    fn create_with_info(info: Arc<KernelThreadCreateInfo>) -> Option<Arc<ProcessControlBlock>> {
         while unsafe { KTHREAD_DAEMON_PCB.is_none() } {
             // 等待kthreadd启动
             spin_loop()
@@ -1006,11 +1006,10 @@ impl ProcessManager {
                 let mut basic = pcb.basic_mut();
                 let old_vm = unsafe { basic.replace_user_vm(None) };
                 idle_vm.active_cpus_set(cpu);
-                unsafe { idle_vm.make_current() };
+                unsafe { crate::mm::tlb::switch_mm_irqs_off(&idle_vm) };
                 if let Some(old_vm) = old_vm.as_ref() {
                     old_vm.active_cpus_clear(cpu);
                 }
-                unsafe { crate::mm::tlb::tlb_state_set_loaded_mm(idle_vm) };
                 drop(basic);
                 drop(irq_guard);
                 old_vm
@@ -1474,6 +1473,8 @@ bitflags! {
         const DEFER_UNHASH = 1 << 14;
         /// PID links and visible-thread accounting have already been released.
         const PID_UNHASHED = 1 << 15;
+        /// 当前进程是工作队列的工作者线程，睡眠/唤醒时需要通知所在的工作者池
+        const WQ_WORKER = 1 << 16;
     }
 }
 
@@ -1514,7 +1515,7 @@ pub struct CpuItimer {
 
 #[derive(Debug, Clone)]
 pub struct ProcessItimer {
-    pub timer: Arc<crate::time::timer::Timer>,
+    pub timer: Arc<crate::time::hrtimer::HrTimer>,
     pub config: crate::time::syscall::Itimerval,
 }
 
@@ -3121,6 +3122,11 @@ impl ProcessSchedulerInfo {
         self.pi_lock.lock_irqsave()
     }
 
+    /// 尝试获取 pi_lock，用于已经持有 rq_lock、不能按锁序等待的路径（如负载均衡）。
+    pub fn try_pi_lock_irqsave(&self) -> Result<SpinLockGuard<'_, PiProtected>, SystemError> {
+        self.pi_lock.try_lock_irqsave()
+    }
+
     // pub fn virtual_runtime(&self) -> isize {
     //     return self.virtual_runtime.load(Ordering::SeqCst);
     // }
@@ -1,7 +1,8 @@
 //! POSIX interval timers (timer_create/timer_settime/...) for a process.
 //!
 //! This is a minimal-but-correct implementation for gVisor `timers.cc` tests:
-//! - CLOCK_MONOTONIC based timers
+//! - CLOCK_REALTIME / CLOCK_MONOTONIC / CLOCK_BOOTTIME timers on soft-mode hrtimers
+//! - relative and TIMER_ABSTIME arming
 //! - SIGEV_NONE / SIGEV_SIGNAL / SIGEV_THREAD / SIGEV_THREAD_ID
 //! - coalescing: at most one pending signal per (signo,timerid); overruns accumulate
 
@@ -17,14 +18,19 @@ use crate::{
     ipc::signal_types::{PosixSigval, SigCode, SigInfo, SigType},
     process::{pid::PidType, ProcessControlBlock, ProcessFlags, ProcessManager, RawPid},
     time::{
-        jiffies::NSEC_PER_JIFFY,
+        hrtimer::{
+            hrtimer_clock_to_ktime, hrtimer_forward, HrTimer, HrTimerFunction, HrTimerMode,
+            HrTimerRestart,
+        },
+        sleep::timespec_to_ktime,
         syscall::PosixClockID,
-        timer::{clock, Jiffies, Timer, TimerFunction},
+        timekeep::ktime_t,
+        timekeeping::ktime_get,
         PosixTimeSpec,
     },
 };
 
-use core::{mem::size_of, time::Duration};
+use core::mem::size_of;
 
 /// 用户态 itimerspec
 #[repr(C)]
@@ -72,15 +78,19 @@ pub struct PosixIntervalTimer {
     pub clockid: PosixClockID,
     pub notify: PosixTimerNotify,
     pub interval: PosixTimeSpec,
-    pub timer: Option<Arc<Timer>>,
-    pub expire_jiffies: Option<u64>,
+    pub timer: Option<Arc<HrTimer>>,
+    /// 下一次到期的时刻（单调时钟）。周期定时器在回调中先更新这里，
+    /// 避免 gettime() 在重新入队之前的窗口看到 0
+    pub expires: Option<ktime_t>,
+    /// 每次 settime 递增，回调据此识别已经被替换掉的旧定时器
+    arm_seq: u64,
     pub pending_overrun_acc: i32,
     pub last_overrun: i32,
 }
 
 impl PosixIntervalTimer {
     fn is_armed(&self) -> bool {
-        self.timer.is_some() && self.expire_jiffies.is_some()
+        self.timer.is_some() && self.expires.is_some()
     }
 }
 
@@ -125,8 +135,10 @@ impl ProcessPosixTimers {
         clockid: PosixClockID,
         sev: Option<PosixSigevent>,
     ) -> Result<i32, SystemError> {
-        // gVisor tests only use CLOCK_MONOTONIC.
-        if clockid != PosixClockID::Monotonic {
+        if !matches!(
+            clockid,
+            PosixClockID::Realtime | PosixClockID::Monotonic | PosixClockID::Boottime
+        ) {
             return Err(SystemError::EINVAL);
         }
 
@@ -204,7 +216,8 @@ impl ProcessPosixTimers {
                 notify,
                 interval: PosixTimeSpec::default(),
                 timer: None,
-                expire_jiffies: None,
+                expires: None,
+                arm_seq: 0,
                 pending_overrun_acc: 0,
                 last_overrun: 0,
             },
@@ -236,16 +249,10 @@ impl ProcessPosixTimers {
             it_interval: t.interval,
             ..Default::default()
         };
-        if let Some(exp) = t.expire_jiffies {
-            let now = clock();
-            if exp > now {
-                let remaining_j = exp - now;
-                let remaining_ns: u64 = remaining_j.saturating_mul(NSEC_PER_JIFFY as u64);
-                out.it_value = PosixTimeSpec {
-                    tv_sec: (remaining_ns / 1_000_000_000) as i64,
-                    tv_nsec: (remaining_ns % 1_000_000_000) as i64,
-                }
-            }
+        if let Some(expires) = t.expires {
+            // 已到期但信号还未处理的定时器仍视为在运行，报告最小的剩余时间
+            let remaining = expires.saturating_sub(ktime_get()).max(1);
+            out.it_value = PosixTimeSpec::from_ns(remaining as u64);
         }
         Ok(out)
     }
@@ -260,6 +267,7 @@ impl ProcessPosixTimers {
         pcb: &Arc<ProcessControlBlock>,
         timerid: i32,
         new_value: PosixItimerspec,
+        abstime: bool,
     ) -> Result<PosixItimerspec, SystemError> {
         let old = self.gettime(timerid)?;
         let t = self.get_timer_mut(timerid)?;
@@ -268,7 +276,8 @@ impl ProcessPosixTimers {
         if let Some(old_timer) = t.timer.take() {
             old_timer.cancel();
         }
-        t.expire_jiffies = None;
+        t.expires = None;
+        t.arm_seq = t.arm_seq.wrapping_add(1);
 
         // timer_settime 会重置 overrun（包含已排队信号的 overrun）
         t.pending_overrun_acc = 0;
@@ -289,15 +298,19 @@ impl ProcessPosixTimers {
             return Ok(old);
         }
 
-        let delay = timespec_to_duration(&new_value.it_value)?;
-        let expire_jiffies = clock() + <Jiffies as From<Duration>>::from(delay).data();
-
-        let helper = PosixTimerHelper::new(Arc::downgrade(pcb), timerid);
-        let new_timer = Timer::new(helper, expire_jiffies);
-        new_timer.activate();
+        // 绝对时刻已经过去时定时器立即到期
+        let value = timespec_to_ktime(&new_value.it_value);
+        let expires = if abstime {
+            hrtimer_clock_to_ktime(t.clockid, value).ok_or(SystemError::EINVAL)?
+        } else {
+            ktime_get().saturating_add(value)
+        };
 
-        t.expire_jiffies = Some(expire_jiffies);
-        t.timer = Some(new_timer);
+        let helper = PosixTimerHelper::new(Arc::downgrade(pcb), timerid, t.arm_seq);
+        let new_timer = HrTimer::new(helper, HrTimerMode::Soft);
+        t.expires = Some(expires);
+        t.timer = Some(new_timer.clone());
+        new_timer.start(expires);
         Ok(old)
     }
 }
@@ -306,48 +319,54 @@ impl ProcessPosixTimers {
 struct PosixTimerHelper {
     pcb: Weak<ProcessControlBlock>,
     timerid: i32,
+    arm_seq: u64,
 }
 
 impl PosixTimerHelper {
-    fn new(pcb: Weak<ProcessControlBlock>, timerid: i32) -> Box<Self> {
-        Box::new(Self { pcb, timerid })
+    fn new(pcb: Weak<ProcessControlBlock>, timerid: i32, arm_seq: u64) -> Box<Self> {
+        Box::new(Self {
+            pcb,
+            timerid,
+            arm_seq,
+        })
     }
 }
 
-impl TimerFunction for PosixTimerHelper {
-    fn run(&mut self) -> Result<(), SystemError> {
+impl HrTimerFunction for PosixTimerHelper {
+    fn run(&mut self, expires: ktime_t, now: ktime_t) -> HrTimerRestart {
         let pcb = match self.pcb.upgrade() {
             Some(p) => p,
-            None => return Ok(()),
+            None => return HrTimerRestart::NoRestart,
         };
 
-        // 在 softirq/timer 上下文执行：核心逻辑放在持锁区域内，避免并发打架。
+        // 在 HRTIMER 软中断中执行：核心逻辑放在持锁区域内，避免并发打架。
         let mut timers = pcb.posix_timers_irqsave();
         let t = match timers.timers.get_mut(&self.timerid) {
             Some(t) => t,
-            None => return Ok(()),
+            None => return HrTimerRestart::NoRestart,
         };
 
-        // 已经被 disarm/delete
-        if !t.is_armed() {
-            return Ok(());
+        // 已经被 disarm/delete，或者已经被新的 settime 替换
+        if !t.is_armed() || t.arm_seq != self.arm_seq {
+            return HrTimerRestart::NoRestart;
         }
 
-        // 周期性定时器：先重建下一次，避免 gettime() 在回调窗口看到 0（PeriodicSilent 期望仍在运行）
+        // 周期性定时器：先算出下一次到期的时刻，避免 gettime() 在回调窗口看到 0（PeriodicSilent 期望仍在运行）。
+        // 错过的周期与 Linux 一样记为 overrun
         let is_periodic = !t.interval.is_empty();
-        if is_periodic {
-            let interval = timespec_to_duration(&t.interval)?;
-            let expire_jiffies = clock() + <Jiffies as From<Duration>>::from(interval).data();
-            let helper = PosixTimerHelper::new(Arc::downgrade(&pcb), self.timerid);
-            let next_timer = Timer::new(helper, expire_jiffies);
-            next_timer.activate();
-            t.expire_jiffies = Some(expire_jiffies);
-            t.timer = Some(next_timer);
+        let restart = if is_periodic {
+            let mut next = expires;
+            let overruns = hrtimer_forward(&mut next, now, timespec_to_ktime(&t.interval));
+            let missed = overruns.saturating_sub(1).min(i32::MAX as u64) as i32;
+            t.pending_overrun_acc = t.pending_overrun_acc.saturating_add(missed);
+            t.expires = Some(next);
+            HrTimerRestart::Restart(next)
         } else {
             // one-shot：本次触发后应停止
             t.timer = None;
-            t.expire_jiffies = None;
-        }
+            t.expires = None;
+            HrTimerRestart::NoRestart
+        };
 
         match t.notify {
             PosixTimerNotify::None => {
@@ -464,7 +483,7 @@ impl TimerFunction for PosixTimerHelper {
             }
         }
 
-        Ok(())
+        restart
     }
 }
 
@@ -474,8 +493,3 @@ fn validate_timespec(ts: &PosixTimeSpec) -> Result<(), SystemError> {
     }
     Ok(())
 }
-
-fn timespec_to_duration(ts: &PosixTimeSpec) -> Result<Duration, SystemError> {
-    validate_timespec(ts)?;
-    Ok(Duration::new(ts.tv_sec as u64, ts.tv_nsec as u32))
-}
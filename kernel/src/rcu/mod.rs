@@ -1,9 +1,18 @@
 #![allow(dead_code)]
 
-use alloc::{boxed::Box, collections::VecDeque, string::ToString, sync::Arc};
+//! 读-复制-更新（RCU）
+//!
+//! 宽限期状态按Linux Tree RCU的方式组织：
+//!
+//! - 回调挂在入队cpu自己的链表上，按需要等待的宽限期号分段（见[`segcblist`]）；
+//! - 静止状态通过分层的合并树（见[`tree`]）报告，只有一组cpu都报告完才会碰上层节点的锁；
+//! - 全局只保留宽限期号和请求号，入队时无锁读取，只有需要开始新的宽限期时才加锁；
+//! - 回调默认由`rcu_gp`线程调用，`rcu_nocbs=`列出的cpu交给各自的`rcuo/N`线程。
+
+use alloc::{boxed::Box, format, string::ToString, sync::Arc, vec::Vec};
 use core::{
     ptr::{self, NonNull},
-    sync::atomic::{fence, AtomicBool, AtomicPtr, Ordering},
+    sync::atomic::{fence, AtomicBool, AtomicPtr, AtomicU64, AtomicUsize, Ordering},
 };
 
 use log::{error, warn};
@@ -11,7 +20,10 @@ use log::{error, warn};
 use crate::{
     libs::{cpumask::CpuMask, spinlock::SpinLock, wait_queue::WaitQueue},
     mm::percpu::PerCpu,
-    process::{kthread::KernelThreadClosure, kthread::KernelThreadMechanism, ProcessManager},
+    process::{
+        kthread::KernelThreadClosure, kthread::KernelThreadMechanism, preempt::PreemptGuard,
+        ProcessManager,
+    },
     sched::SchedPolicy,
     smp::{
         core::smp_get_processor_id,
@@ -19,8 +31,15 @@ use crate::{
     },
 };
 
+mod segcblist;
 mod selftest;
-pub use selftest::run_debug_selftests;
+mod tree;
+
+use segcblist::RcuSegCbList;
+pub use selftest::{run_debug_selftests, run_debug_stress};
+use tree::RcuTree;
+
+kernel_cmdline_param_kv!(RCU_NOCBS_PARAM, rcu_nocbs, "");
 
 pub(crate) type RcuRawCallback = unsafe fn(NonNull<RcuHead>);
 
@@ -293,11 +312,29 @@ enum CallbackKind {
 }
 
 struct CallbackItem {
-    target_gp: u64,
-    seq: u64,
     kind: CallbackKind,
 }
 
+impl CallbackItem {
+    fn invoke(self) {
+        match self.kind {
+            CallbackKind::RawHead { head, func } => {
+                let head = head.0;
+                // SAFETY: `head` is queued only once and the callback owns
+                // the right to recycle or requeue it after execution.
+                unsafe {
+                    head.as_ref().queued.store(false, Ordering::Release);
+                    func(head);
+                }
+            }
+            CallbackKind::Deferred(call) => call.invoke(),
+        }
+    }
+}
+
+/// 一次从done段取出并调用的回调个数上限，每批结束后唤醒rcu_barrier的等待者
+const RCU_BATCH_LIMIT: usize = 64;
+
 #[derive(Clone, Copy, Debug, Default)]
 struct RcuCpuState {
     in_idle_eqs: bool,
@@ -305,70 +342,109 @@ struct RcuCpuState {
     irq_from_idle_eqs: bool,
 }
 
-struct RcuStateInner {
-    gp_seq: u64,
-    completed_gp_seq: u64,
-    requested_gp_seq: u64,
-    next_callback_seq: u64,
-    completed_callback_seq: u64,
-    gp_active: bool,
-    waiting_cpus: CpuMask,
-    cpu_states: [RcuCpuState; PerCpu::MAX_CPU_NUM as usize],
-    pending_callbacks: VecDeque<CallbackItem>,
-    ready_callbacks: VecDeque<CallbackItem>,
-}
-
-impl RcuStateInner {
-    fn new() -> Self {
+impl RcuCpuState {
+    const fn new() -> Self {
         Self {
-            gp_seq: 0,
-            completed_gp_seq: 0,
-            requested_gp_seq: 0,
-            next_callback_seq: 1,
-            completed_callback_seq: 0,
-            gp_active: false,
-            waiting_cpus: CpuMask::new(),
-            cpu_states: [RcuCpuState::default(); PerCpu::MAX_CPU_NUM as usize],
-            pending_callbacks: VecDeque::new(),
-            ready_callbacks: VecDeque::new(),
+            in_idle_eqs: false,
+            irq_nesting: 0,
+            irq_from_idle_eqs: false,
         }
     }
+}
 
-    fn allocate_callback_seq(&mut self) -> u64 {
-        let seq = self.next_callback_seq;
-        self.next_callback_seq += 1;
-        seq
-    }
+struct RcuCpuCallbacks {
+    list: RcuSegCbList,
+    /// 入队的回调总数
+    queued: u64,
+    /// 调用完成的回调总数，rcu_barrier据此判断之前入队的回调是否都执行完了
+    invoked: u64,
+}
 
-    fn request_future_gp(&mut self) -> u64 {
-        let target_gp = self.gp_seq + 1;
-        if self.requested_gp_seq < target_gp {
-            self.requested_gp_seq = target_gp;
+/// per-cpu的RCU状态
+///
+/// 回调链表和idle/中断状态都只在本cpu上修改，宽限期初始化和回调调用者偶尔从其他cpu访问，
+/// 按cache line对齐避免相邻cpu之间的伪共享。
+#[repr(align(64))]
+struct RcuData {
+    callbacks: SpinLock<RcuCpuCallbacks>,
+    state: SpinLock<RcuCpuState>,
+    /// 当前宽限期可能在等待本cpu，报告静止状态的快速路径据此跳过叶子节点的锁
+    qs_pending: AtomicBool,
+    /// 加速宽限期请求本cpu在IPI中报告静止状态
+    exp_request: AtomicBool,
+    /// 还没有调用的回调个数，用于无锁判断是否需要唤醒调用者
+    nr_cbs: AtomicUsize,
+    /// 是否有人正在调用本cpu的回调，保证同一cpu上的回调按顺序逐个执行
+    invoking: AtomicBool,
+    /// 回调交给`rcuo/N`内核线程调用（`rcu_nocbs=`）
+    offloaded: AtomicBool,
+    nocb_pending: AtomicBool,
+    nocb_wait: WaitQueue,
+}
+
+impl RcuData {
+    const fn new() -> Self {
+        Self {
+            callbacks: SpinLock::new(RcuCpuCallbacks {
+                list: RcuSegCbList::new(),
+                queued: 0,
+                invoked: 0,
+            }),
+            state: SpinLock::new(RcuCpuState::new()),
+            qs_pending: AtomicBool::new(false),
+            exp_request: AtomicBool::new(false),
+            nr_cbs: AtomicUsize::new(0),
+            invoking: AtomicBool::new(false),
+            offloaded: AtomicBool::new(false),
+            nocb_pending: AtomicBool::new(false),
+            nocb_wait: WaitQueue::default(),
         }
-        target_gp
     }
+}
 
-    fn has_ready_work(&self) -> bool {
-        !self.ready_callbacks.is_empty()
-    }
+static RCU_DATA: [RcuData; PerCpu::MAX_CPU_NUM as usize] =
+    [const { RcuData::new() }; PerCpu::MAX_CPU_NUM as usize];
+
+#[inline]
+fn rcu_data(cpu: ProcessorId) -> &'static RcuData {
+    &RCU_DATA[cpu.data() as usize]
+}
+
+struct RcuGpState {
+    /// 最近一次开始的宽限期号
+    gp_seq: u64,
+    gp_active: bool,
 }
 
 struct RcuState {
     initialized: AtomicBool,
     worker_started: AtomicBool,
     worker_should_stop: AtomicBool,
-    inner: SpinLock<RcuStateInner>,
+    /// 宽限期的开始与结束，持有时按从根到叶子的顺序获取合并树节点的锁
+    gp: SpinLock<RcuGpState>,
+    /// `(宽限期号 << 1) | 是否正在进行`，供入队和等待者无锁读取
+    gp_seq: AtomicU64,
+    /// 已经请求的最大宽限期号
+    requested_gp_seq: AtomicU64,
+    /// 有未卸载cpu的回调可能可以调用了，rcu_gp线程醒来时清除
+    worker_pending: AtomicBool,
     state_wait: WaitQueue,
     worker_wait: WaitQueue,
 }
 
 impl RcuState {
-    fn new() -> Self {
+    const fn new() -> Self {
         Self {
             initialized: AtomicBool::new(false),
             worker_started: AtomicBool::new(false),
             worker_should_stop: AtomicBool::new(false),
-            inner: SpinLock::new(RcuStateInner::new()),
+            gp: SpinLock::new(RcuGpState {
+                gp_seq: 0,
+                gp_active: false,
+            }),
+            gp_seq: AtomicU64::new(0),
+            requested_gp_seq: AtomicU64::new(0),
+            worker_pending: AtomicBool::new(false),
             state_wait: WaitQueue::default(),
             worker_wait: WaitQueue::default(),
         }
@@ -378,51 +454,12 @@ impl RcuState {
         self.initialized.load(Ordering::Acquire)
     }
 
-    fn pump_grace_periods(inner: &mut RcuStateInner) -> bool {
-        let mut ready_changed = false;
-        loop {
-            if inner.gp_active {
-                if !inner.waiting_cpus.is_empty() {
-                    break;
-                }
-                inner.completed_gp_seq = inner.gp_seq;
-                inner.gp_active = false;
-
-                while inner
-                    .pending_callbacks
-                    .front()
-                    .is_some_and(|cb| cb.target_gp <= inner.completed_gp_seq)
-                {
-                    if let Some(cb) = inner.pending_callbacks.pop_front() {
-                        inner.ready_callbacks.push_back(cb);
-                        ready_changed = true;
-                    }
-                }
-                continue;
-            }
-
-            let need_gp = inner.requested_gp_seq > inner.completed_gp_seq
-                || inner
-                    .pending_callbacks
-                    .front()
-                    .is_some_and(|cb| cb.target_gp > inner.completed_gp_seq);
-            if !need_gp {
-                break;
-            }
-
-            inner.gp_seq += 1;
-            inner.gp_active = true;
-            inner.waiting_cpus = online_non_idle_cpus(&inner.cpu_states);
-        }
-
-        ready_changed
-    }
-
     fn wake_state_waiters(&self) {
         self.state_wait.wake_all();
     }
 
     fn wake_worker(&self) {
+        self.worker_pending.store(true, Ordering::Release);
         self.worker_wait.wake_all();
     }
 
@@ -431,73 +468,217 @@ impl RcuState {
             return;
         }
 
-        self.process_ready_callbacks();
+        rcu_process_callbacks(true);
     }
+}
 
-    fn process_ready_callbacks(&self) {
-        loop {
-            let next = {
-                let mut inner = self.inner.lock_irqsave();
-                inner.ready_callbacks.pop_front()
-            };
+static RCU_STATE: RcuState = RcuState::new();
 
-            let Some(callback) = next else {
-                break;
-            };
+lazy_static! {
+    static ref RCU_TREE: RcuTree = RcuTree::new(PerCpu::MAX_CPU_NUM as usize);
+}
 
-            match callback.kind {
-                CallbackKind::RawHead { head, func } => {
-                    let head = head.0;
-                    // SAFETY: `head` is queued only once and the callback owns
-                    // the right to recycle or requeue it after execution.
-                    unsafe {
-                        head.as_ref().queued.store(false, Ordering::Release);
-                        func(head);
-                    }
-                }
-                CallbackKind::Deferred(call) => call.invoke(),
-            }
+#[inline]
+fn rcu_enabled() -> bool {
+    RCU_STATE.is_initialized()
+}
 
-            {
-                let mut inner = self.inner.lock_irqsave();
-                inner.completed_callback_seq = callback.seq;
-            }
+#[inline]
+const fn gp_seq_encode(gp_seq: u64, active: bool) -> u64 {
+    (gp_seq << 1) | active as u64
+}
+
+/// 新入队的回调需要等待的宽限期号
+///
+/// 正在进行的宽限期可能开始于调用者删除旧数据之前，必须等它的下一个宽限期结束；
+/// 没有宽限期在进行时等下一个即可。两种情况都是当前宽限期号加一。
+#[inline]
+fn rcu_gp_snapshot() -> u64 {
+    fence(Ordering::SeqCst);
+    (RCU_STATE.gp_seq.load(Ordering::SeqCst) >> 1) + 1
+}
 
-            self.wake_state_waiters();
+/// 最近一个已经结束的宽限期号
+#[inline]
+fn rcu_completed_gp() -> u64 {
+    let seq = RCU_STATE.gp_seq.load(Ordering::Acquire);
+    (seq >> 1) - (seq & 1)
+}
+
+/// 宽限期初始化时判断叶子节点下的`cpu`是否需要报告静止状态
+fn rcu_gp_init_cpu(cpu: ProcessorId) -> bool {
+    if smp_cpu_manager_initialized() {
+        if !smp_cpu_manager().is_online_cpu(cpu) {
+            return false;
         }
+    } else if cpu != smp_get_processor_id() {
+        return false;
     }
+
+    // 与进入idle的路径构成Dekker式的配对：要么这里看到cpu已经进入idle，
+    // 要么那边看到qs_pending，从而去叶子节点上清除自己的位
+    let data = rcu_data(cpu);
+    data.qs_pending.store(true, Ordering::SeqCst);
+    fence(Ordering::SeqCst);
+    !cpu_in_idle_eqs(&data.state.lock_irqsave())
 }
 
-lazy_static! {
-    static ref RCU_STATE: RcuState = RcuState::new();
+fn rcu_gp_finish(gp: &mut RcuGpState) {
+    gp.gp_active = false;
+    RCU_STATE
+        .gp_seq
+        .store(gp_seq_encode(gp.gp_seq, false), Ordering::SeqCst);
 }
 
-#[inline]
-fn rcu_enabled() -> bool {
-    RCU_STATE.is_initialized()
+/// 在没有宽限期进行且有人请求时开始新的宽限期
+///
+/// ## 返回值
+///
+/// 是否有宽限期在这里直接结束（没有需要等待的cpu）
+fn rcu_gp_advance(gp: &mut RcuGpState, waiting: &mut CpuMask) -> bool {
+    let mut completed = false;
+    while !gp.gp_active && RCU_STATE.requested_gp_seq.load(Ordering::SeqCst) > gp.gp_seq {
+        gp.gp_seq += 1;
+        gp.gp_active = true;
+        RCU_STATE
+            .gp_seq
+            .store(gp_seq_encode(gp.gp_seq, true), Ordering::SeqCst);
+        fence(Ordering::SeqCst);
+
+        if !RCU_TREE.gp_init(gp.gp_seq, rcu_gp_init_cpu, waiting) {
+            break;
+        }
+        rcu_gp_finish(gp);
+        completed = true;
+    }
+    completed
+}
+
+/// 宽限期结束之后唤醒等待者和回调的调用者
+fn rcu_gp_completed() {
+    RCU_STATE.wake_state_waiters();
+
+    let mut wake_worker = false;
+    for data in RCU_DATA.iter() {
+        if data.nr_cbs.load(Ordering::Acquire) == 0 {
+            continue;
+        }
+        if data.offloaded.load(Ordering::Acquire) {
+            data.nocb_pending.store(true, Ordering::Release);
+            data.nocb_wait.wake_all();
+        } else {
+            wake_worker = true;
+        }
+    }
+
+    if wake_worker {
+        RCU_STATE.wake_worker();
+        RCU_STATE.maybe_process_ready_callbacks_inline();
+    }
 }
 
-fn online_non_idle_cpus(cpu_states: &[RcuCpuState; PerCpu::MAX_CPU_NUM as usize]) -> CpuMask {
+fn rcu_gp_kick(waiting: &CpuMask) {
+    if waiting.is_empty() {
+        return;
+    }
+    // 停了tick的nohz_full cpu可能一直停留在用户态，踢一下让它经过中断出口报告静止状态
+    crate::time::tick_sched::tick_nohz_full_kick_mask(waiting);
+}
+
+/// 请求`target`号宽限期
+///
+/// 请求号已经覆盖`target`时只读一次全局的原子量，不碰宽限期锁
+fn rcu_request_gp(target: u64) {
+    let requested = &RCU_STATE.requested_gp_seq;
+    if requested.load(Ordering::Acquire) >= target
+        || requested.fetch_max(target, Ordering::AcqRel) >= target
+    {
+        return;
+    }
+
     let mut waiting = CpuMask::new();
+    let completed = {
+        let mut gp = RCU_STATE.gp.lock_irqsave();
+        rcu_gp_advance(&mut gp, &mut waiting)
+    };
+    rcu_gp_kick(&waiting);
+    if completed {
+        rcu_gp_completed();
+    }
+}
 
-    if smp_cpu_manager_initialized() {
-        let cpu_manager = smp_cpu_manager();
-        for cpu in cpu_manager.present_cpus().iter_cpu() {
-            if !cpu_manager.is_online_cpu(cpu) {
-                continue;
+/// 合并树的根节点被清空，结束`gp_seq`号宽限期并按需开始下一个
+fn rcu_report_gp_end(gp_seq: u64) {
+    let mut waiting = CpuMask::new();
+    {
+        let mut gp = RCU_STATE.gp.lock_irqsave();
+        if !gp.gp_active || gp.gp_seq != gp_seq {
+            return;
+        }
+        rcu_gp_finish(&mut gp);
+        rcu_gp_advance(&mut gp, &mut waiting);
+    }
+    rcu_gp_kick(&waiting);
+    rcu_gp_completed();
+}
+
+/// 调用`cpu`上宽限期已经结束的回调
+///
+/// 同一时刻只有一个调用者处理某个cpu的链表；抢不到调用权时直接返回，
+/// 持有者放弃调用权之后会再检查一次链表。
+fn rcu_do_batch(cpu: ProcessorId) {
+    let data = rcu_data(cpu);
+    loop {
+        if data.invoking.swap(true, Ordering::Acquire) {
+            return;
+        }
+
+        loop {
+            let batch: Vec<CallbackItem> = {
+                let mut cbs = data.callbacks.lock_irqsave();
+                cbs.list.advance(rcu_completed_gp());
+                (0..RCU_BATCH_LIMIT)
+                    .map_while(|_| cbs.list.pop_done())
+                    .collect()
+            };
+            if batch.is_empty() {
+                break;
             }
 
-            if cpu_in_idle_eqs(&cpu_states[cpu.data() as usize]) {
-                continue;
+            let n = batch.len();
+            for callback in batch {
+                callback.invoke();
             }
 
-            waiting.set(cpu, true);
+            data.callbacks.lock_irqsave().invoked += n as u64;
+            data.nr_cbs.fetch_sub(n, Ordering::Release);
+            RCU_STATE.wake_state_waiters();
+        }
+
+        data.invoking.store(false, Ordering::Release);
+
+        let again = data
+            .callbacks
+            .lock_irqsave()
+            .list
+            .advance(rcu_completed_gp());
+        if !again {
+            return;
         }
-    } else {
-        waiting.set(smp_get_processor_id(), true);
     }
+}
 
-    waiting
+/// 调用各cpu上已经就绪的回调，`include_offloaded`为false时跳过交给rcuo线程的cpu
+fn rcu_process_callbacks(include_offloaded: bool) {
+    for (cpu, data) in RCU_DATA.iter().enumerate() {
+        if data.nr_cbs.load(Ordering::Acquire) == 0 {
+            continue;
+        }
+        if !include_offloaded && data.offloaded.load(Ordering::Acquire) {
+            continue;
+        }
+        rcu_do_batch(ProcessorId::new(cpu as u32));
+    }
 }
 
 #[inline]
@@ -510,22 +691,17 @@ fn cpu_in_idle_eqs(cpu_state: &RcuCpuState) -> bool {
     cpu_state.in_idle_eqs && cpu_state.irq_nesting == 0
 }
 
-fn enter_cpu_idle_eqs(inner: &mut RcuStateInner, cpu: ProcessorId) -> bool {
-    let cpu_idx = cpu.data() as usize;
-    debug_assert_eq!(inner.cpu_states[cpu_idx].irq_nesting, 0);
-
-    inner.cpu_states[cpu_idx].in_idle_eqs = true;
-    let ready_changed = if inner.gp_active && inner.waiting_cpus.get(cpu).unwrap_or(false) {
-        inner.waiting_cpus.set(cpu, false);
-        RcuState::pump_grace_periods(inner)
-    } else {
-        false
-    };
-    ready_changed || inner.has_ready_work()
+fn enter_cpu_idle_eqs(cpu: ProcessorId) {
+    {
+        let mut state = rcu_data(cpu).state.lock_irqsave();
+        debug_assert_eq!(state.irq_nesting, 0);
+        state.in_idle_eqs = true;
+    }
+    report_quiescent_state(cpu);
 }
 
-fn exit_cpu_idle_eqs(inner: &mut RcuStateInner, cpu: ProcessorId) {
-    inner.cpu_states[cpu.data() as usize].in_idle_eqs = false;
+fn exit_cpu_idle_eqs(cpu: ProcessorId) {
+    rcu_data(cpu).state.lock_irqsave().in_idle_eqs = false;
 }
 
 fn report_quiescent_state(cpu: ProcessorId) {
@@ -533,43 +709,33 @@ fn report_quiescent_state(cpu: ProcessorId) {
         return;
     }
 
-    let (wake_worker, wake_waiters) = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        if inner.gp_active && inner.waiting_cpus.get(cpu).unwrap_or(false) {
-            inner.waiting_cpus.set(cpu, false);
-        }
-        let ready_changed = RcuState::pump_grace_periods(&mut inner);
-        (ready_changed || inner.has_ready_work(), true)
-    };
-
-    if wake_waiters {
-        RCU_STATE.wake_state_waiters();
+    fence(Ordering::SeqCst);
+    if !rcu_data(cpu).qs_pending.swap(false, Ordering::AcqRel) {
+        return;
     }
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
+
+    rcu_report_qs_cpu(cpu);
+}
+
+/// 在合并树上清除`cpu`的位，不经过qs_pending的快速路径
+fn rcu_report_qs_cpu(cpu: ProcessorId) {
+    if let Some(gp_seq) = RCU_TREE.report_cpu(cpu) {
+        rcu_report_gp_end(gp_seq);
     }
 }
 
 fn queue_callback(kind: CallbackKind) {
-    let wake_worker = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let target_gp = inner.request_future_gp();
-        let seq = inner.allocate_callback_seq();
-        inner.pending_callbacks.push_back(CallbackItem {
-            target_gp,
-            seq,
-            kind,
-        });
-        let ready_changed = RcuState::pump_grace_periods(&mut inner);
-        ready_changed || inner.has_ready_work()
+    let data = rcu_data(smp_get_processor_id());
+    let target_gp = {
+        let mut cbs = data.callbacks.lock_irqsave();
+        let target_gp = rcu_gp_snapshot();
+        cbs.list.enqueue(target_gp, CallbackItem { kind });
+        cbs.queued += 1;
+        data.nr_cbs.fetch_add(1, Ordering::Release);
+        target_gp
     };
 
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
-    }
+    rcu_request_gp(target_gp);
 }
 
 fn queue_raw_callback(head: NonNull<RcuHead>, func: RcuRawCallback) {
@@ -590,7 +756,7 @@ fn worker_main() -> i32 {
                 return Some(());
             }
 
-            if RCU_STATE.inner.lock_irqsave().has_ready_work() {
+            if RCU_STATE.worker_pending.swap(false, Ordering::AcqRel) {
                 return Some(());
             }
 
@@ -601,23 +767,76 @@ fn worker_main() -> i32 {
             break;
         }
 
-        RCU_STATE.process_ready_callbacks();
+        rcu_process_callbacks(false);
     }
 
     0
 }
 
+/// `rcuo/N`：调用`rcu_nocbs=`中第N个cpu的回调
+fn nocb_main(cpu: usize) -> i32 {
+    let data = &RCU_DATA[cpu];
+    loop {
+        data.nocb_wait.wait_until(|| {
+            if RCU_STATE.worker_should_stop.load(Ordering::Acquire) {
+                return Some(());
+            }
+
+            if data.nocb_pending.swap(false, Ordering::AcqRel) {
+                return Some(());
+            }
+
+            None
+        });
+
+        if RCU_STATE.worker_should_stop.load(Ordering::Acquire) {
+            break;
+        }
+
+        rcu_do_batch(ProcessorId::new(cpu as u32));
+    }
+
+    0
+}
+
+/// 按`rcu_nocbs=`把cpu的回调交给各自的rcuo内核线程
+fn start_nocb_threads() {
+    let Some(list) = RCU_NOCBS_PARAM.value_str().filter(|s| !s.is_empty()) else {
+        return;
+    };
+    let Some(mask) = crate::time::tick_sched::parse_cpulist(list) else {
+        warn!("RCU: invalid rcu_nocbs= cpu list '{}'", list);
+        return;
+    };
+
+    for cpu in mask.iter_cpu() {
+        let data = rcu_data(cpu);
+        data.offloaded.store(true, Ordering::Release);
+
+        let closure = KernelThreadClosure::UsizeClosure((Box::new(nocb_main), cpu.data() as usize));
+        if KernelThreadMechanism::create_and_run(closure, format!("rcuo/{}", cpu.data())).is_none()
+        {
+            data.offloaded.store(false, Ordering::Release);
+            error!(
+                "failed to create RCU callback offload thread for cpu {}",
+                cpu.data()
+            );
+            continue;
+        }
+
+        data.nocb_pending.store(true, Ordering::Release);
+        data.nocb_wait.wake_all();
+    }
+}
+
 pub fn init() {
     let already = RCU_STATE.initialized.swap(true, Ordering::AcqRel);
     if already {
         return;
     }
 
-    {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let cpu = smp_get_processor_id();
-        inner.cpu_states[cpu.data() as usize].in_idle_eqs = false;
-    }
+    lazy_static::initialize(&RCU_TREE);
+    exit_cpu_idle_eqs(smp_get_processor_id());
 }
 
 pub fn start_worker() {
@@ -637,6 +856,7 @@ pub fn start_worker() {
         return;
     }
 
+    start_nocb_threads();
     RCU_STATE.wake_worker();
 }
 
@@ -647,6 +867,11 @@ pub fn shutdown_worker() {
 
     RCU_STATE.worker_should_stop.store(true, Ordering::Release);
     RCU_STATE.wake_worker();
+    for data in RCU_DATA.iter() {
+        if data.offloaded.load(Ordering::Acquire) {
+            data.nocb_wait.wake_all();
+        }
+    }
 }
 
 pub fn rcu_read_lock() -> RcuReadGuard {
@@ -737,19 +962,11 @@ pub fn synchronize_rcu() {
         debug_assert!(!rcu_read_lock_held());
     }
 
-    let target_gp = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let target_gp = inner.request_future_gp();
-        RcuState::pump_grace_periods(&mut inner);
-        target_gp
-    };
-
-    RCU_STATE.wake_state_waiters();
-    RCU_STATE.wake_worker();
+    let target_gp = rcu_gp_snapshot();
+    rcu_request_gp(target_gp);
 
     RCU_STATE.state_wait.wait_until(|| {
-        let completed = RCU_STATE.inner.lock_irqsave().completed_gp_seq;
-        if completed >= target_gp {
+        if rcu_completed_gp() >= target_gp {
             Some(())
         } else {
             None
@@ -757,36 +974,57 @@ pub fn synchronize_rcu() {
     });
 }
 
-pub fn rcu_barrier() {
+/// 请求当前宽限期还在等待的其他cpu立即报告静止状态
+fn rcu_exp_kick_cpus() {
+    let mut waiting = CpuMask::new();
+    RCU_TREE.waiting_cpus(&mut waiting);
+
+    let this_cpu = smp_get_processor_id();
+    for cpu in waiting.iter_cpu().filter(|&cpu| cpu != this_cpu) {
+        rcu_data(cpu).exp_request.store(true, Ordering::Release);
+        #[cfg(target_arch = "x86_64")]
+        crate::arch::interrupt::ipi::send_ipi(
+            crate::exception::ipi::IpiKind::KickCpu,
+            crate::exception::ipi::IpiTarget::Specified(cpu),
+        );
+    }
+}
+
+/// 与[`synchronize_rcu`]语义相同，但不等各cpu自然经过静止状态
+///
+/// 向宽限期还在等待的cpu发送IPI，不在读端临界区内的cpu在中断处理中直接报告静止状态；
+/// 正在读端临界区内的cpu照常在退出之后的上下文切换或返回用户态时报告。
+/// 每开始一个新的宽限期就重新踢一遍，直到覆盖调用时刻的宽限期结束。
+///
+/// 目前只有x86_64支持KickCpu IPI，其他架构上退化为[`synchronize_rcu`]。
+pub fn synchronize_rcu_expedited() {
     if !rcu_enabled() {
         return;
     }
 
-    let target_cb = {
-        let inner = RCU_STATE.inner.lock_irqsave();
-        inner.next_callback_seq.saturating_sub(1)
-    };
-
-    if target_cb == 0 {
-        return;
+    if rcu_read_lock_held() {
+        warn!("synchronize_rcu_expedited() called inside rcu_read_lock() region");
+        debug_assert!(!rcu_read_lock_held());
     }
 
+    let target_gp = rcu_gp_snapshot();
+    rcu_request_gp(target_gp);
+
     loop {
-        if !RCU_STATE.worker_started.load(Ordering::Acquire) {
-            RCU_STATE.maybe_process_ready_callbacks_inline();
+        let seq = RCU_STATE.gp_seq.load(Ordering::Acquire);
+        if rcu_completed_gp() >= target_gp {
+            return;
         }
 
-        let done = {
-            let inner = RCU_STATE.inner.lock_irqsave();
-            inner.completed_callback_seq >= target_cb
-        };
-        if done {
-            return;
+        {
+            // 调用者不在读端临界区内，本cpu直接报告
+            let _guard = PreemptGuard::new();
+            report_quiescent_state(smp_get_processor_id());
         }
+        rcu_exp_kick_cpus();
 
         RCU_STATE.state_wait.wait_until(|| {
-            let completed = RCU_STATE.inner.lock_irqsave().completed_callback_seq;
-            if completed >= target_cb {
+            if RCU_STATE.gp_seq.load(Ordering::Acquire) != seq || rcu_completed_gp() >= target_gp {
                 Some(())
             } else {
                 None
@@ -795,6 +1033,73 @@ pub fn rcu_barrier() {
     }
 }
 
+/// KickCpu IPI中调用：响应加速宽限期的请求
+pub fn rcu_exp_handler() {
+    if !rcu_enabled() {
+        return;
+    }
+
+    let cpu = smp_get_processor_id();
+    let data = rcu_data(cpu);
+    if !data.exp_request.swap(false, Ordering::AcqRel) {
+        return;
+    }
+
+    // 被打断的上下文关了抢占（包括持有自旋锁、处于读端临界区）或者本身是中断/软中断时，
+    // 它可能正在访问受RCU保护的数据，只能等它自然经过静止状态
+    let pcb = ProcessManager::current_pcb();
+    if pcb.preempt_count() != 0
+        || pcb.rcu_read_depth() != 0
+        || data.state.lock_irqsave().irq_nesting > 1
+    {
+        return;
+    }
+
+    data.qs_pending.store(false, Ordering::Release);
+    rcu_report_qs_cpu(cpu);
+}
+
+pub fn rcu_barrier() {
+    if !rcu_enabled() {
+        return;
+    }
+
+    // 记下每个cpu此刻已经入队的回调数，同一cpu上的回调按顺序执行，
+    // 调用完成数追上这个值就说明之前的回调都执行完了
+    let targets: Vec<(usize, u64)> = RCU_DATA
+        .iter()
+        .enumerate()
+        .filter_map(|(cpu, data)| {
+            let cbs = data.callbacks.lock_irqsave();
+            (cbs.invoked < cbs.queued).then_some((cpu, cbs.queued))
+        })
+        .collect();
+
+    if targets.is_empty() {
+        return;
+    }
+
+    let done = || {
+        targets
+            .iter()
+            .all(|&(cpu, queued)| RCU_DATA[cpu].callbacks.lock_irqsave().invoked >= queued)
+    };
+
+    loop {
+        if !RCU_STATE.worker_started.load(Ordering::Acquire) {
+            RCU_STATE.maybe_process_ready_callbacks_inline();
+        }
+
+        if done() {
+            return;
+        }
+
+        RCU_STATE
+            .state_wait
+            .wait_until(|| if done() { Some(()) } else { None });
+    }
+}
+
 pub fn note_context_switch() {
     if !rcu_enabled() {
         return;
@@ -829,17 +1134,7 @@ pub fn enter_idle() {
         return;
     }
 
-    let cpu = smp_get_processor_id();
-    let wake_worker = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        enter_cpu_idle_eqs(&mut inner, cpu)
-    };
-
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
-    }
+    enter_cpu_idle_eqs(smp_get_processor_id());
 }
 
 pub fn exit_idle() {
@@ -853,9 +1148,18 @@ pub fn exit_idle() {
         return;
     }
 
-    let cpu = smp_get_processor_id();
-    let mut inner = RCU_STATE.inner.lock_irqsave();
-    exit_cpu_idle_eqs(&mut inner, cpu);
+    exit_cpu_idle_eqs(smp_get_processor_id());
+}
+
+/// 当前宽限期是否还在等待`cpu`报告静止状态
+///
+/// nohz_full cpu在返回true时不能停止tick
+pub fn rcu_needs_cpu(cpu: ProcessorId) -> bool {
+    if !rcu_enabled() {
+        return false;
+    }
+
+    RCU_TREE.cpu_waited(cpu)
 }
 
 pub fn irq_enter() {
@@ -863,13 +1167,11 @@ pub fn irq_enter() {
         return;
     }
 
-    let cpu = smp_get_processor_id();
-    let mut inner = RCU_STATE.inner.lock_irqsave();
-    let cpu_state = &mut inner.cpu_states[cpu.data() as usize];
-    if cpu_state.irq_nesting == 0 {
-        cpu_state.irq_from_idle_eqs = cpu_in_idle_eqs(cpu_state);
+    let mut state = rcu_data(smp_get_processor_id()).state.lock_irqsave();
+    if state.irq_nesting == 0 {
+        state.irq_from_idle_eqs = cpu_in_idle_eqs(&state);
     }
-    cpu_state.irq_nesting += 1;
+    state.irq_nesting += 1;
 }
 
 /// Returns true when this call exits the outermost IRQ nesting level.
@@ -878,9 +1180,11 @@ pub fn irq_is_outermost() -> bool {
         return true;
     }
 
-    let cpu = smp_get_processor_id();
-    let inner = RCU_STATE.inner.lock_irqsave();
-    inner.cpu_states[cpu.data() as usize].irq_nesting == 1
+    rcu_data(smp_get_processor_id())
+        .state
+        .lock_irqsave()
+        .irq_nesting
+        == 1
 }
 
 /// Returns true when this call exits the outermost IRQ nesting level.
@@ -890,35 +1194,25 @@ pub fn irq_exit(resume_idle_eqs: bool) -> bool {
     }
 
     let cpu = smp_get_processor_id();
-    let (outermost, wake_worker) = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let cpu_idx = cpu.data() as usize;
-        assert!(
-            inner.cpu_states[cpu_idx].irq_nesting > 0,
-            "rcu::irq_exit without irq_enter"
-        );
-        inner.cpu_states[cpu_idx].irq_nesting -= 1;
-        if inner.cpu_states[cpu_idx].irq_nesting != 0 {
-            (false, false)
-        } else {
-            let resume_idle_eqs = inner.cpu_states[cpu_idx].irq_from_idle_eqs && resume_idle_eqs;
-            inner.cpu_states[cpu_idx].irq_from_idle_eqs = false;
-            if resume_idle_eqs {
-                (true, enter_cpu_idle_eqs(&mut inner, cpu))
-            } else {
-                inner.cpu_states[cpu_idx].in_idle_eqs = false;
-                (true, false)
-            }
+    let resume_idle_eqs = {
+        let mut state = rcu_data(cpu).state.lock_irqsave();
+        assert!(state.irq_nesting > 0, "rcu::irq_exit without irq_enter");
+        state.irq_nesting -= 1;
+        if state.irq_nesting != 0 {
+            return false;
         }
+
+        let resume_idle_eqs = state.irq_from_idle_eqs && resume_idle_eqs;
+        state.irq_from_idle_eqs = false;
+        state.in_idle_eqs = resume_idle_eqs;
+        resume_idle_eqs
     };
 
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
+    if resume_idle_eqs {
+        report_quiescent_state(cpu);
     }
 
-    outermost
+    true
 }
 
 pub fn cpu_offline(cpu: ProcessorId) {
@@ -926,31 +1220,29 @@ pub fn cpu_offline(cpu: ProcessorId) {
         return;
     }
 
-    let wake_worker = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        if inner.gp_active && inner.waiting_cpus.get(cpu).unwrap_or(false) {
-            inner.waiting_cpus.set(cpu, false);
-        }
-        let ready_changed = RcuState::pump_grace_periods(&mut inner);
-        ready_changed || inner.has_ready_work()
-    };
-
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
-    }
+    // 下线的cpu不会再进入读端临界区，直接清除它在当前宽限期中的位；
+    // 它链表上剩下的回调仍由rcu_gp线程（或rcuo线程）调用
+    rcu_data(cpu).qs_pending.store(false, Ordering::Release);
+    rcu_report_qs_cpu(cpu);
 }
 
+/// 返回(最近开始的宽限期号, 已经结束的宽限期号, 调用完成的回调数, 等待宽限期的回调数, 就绪未调用的回调数)
 #[allow(dead_code)]
 pub fn debug_snapshot() -> (u64, u64, u64, usize, usize) {
-    let inner = RCU_STATE.inner.lock_irqsave();
+    let (mut invoked, mut pending, mut ready) = (0, 0, 0);
+    for data in RCU_DATA.iter() {
+        let cbs = data.callbacks.lock_irqsave();
+        invoked += cbs.invoked;
+        pending += cbs.list.pending_len();
+        ready += cbs.list.done_len();
+    }
+
     (
-        inner.gp_seq,
-        inner.completed_gp_seq,
-        inner.completed_callback_seq,
-        inner.pending_callbacks.len(),
-        inner.ready_callbacks.len(),
+        RCU_STATE.gp_seq.load(Ordering::Acquire) >> 1,
+        rcu_completed_gp(),
+        invoked,
+        pending,
+        ready,
     )
 }
 
@@ -961,7 +1253,5 @@ pub fn debug_force_quiescent_state() {
 
 #[allow(dead_code)]
 pub fn debug_current_cpu_in_idle_eqs() -> bool {
-    let cpu = smp_get_processor_id();
-    let inner = RCU_STATE.inner.lock_irqsave();
-    cpu_in_idle_eqs(&inner.cpu_states[cpu.data() as usize])
+    cpu_in_idle_eqs(&rcu_data(smp_get_processor_id()).state.lock_irqsave())
 }
@@ -0,0 +1,93 @@
+//! 按宽限期号分段的per-cpu回调链表
+//!
+//! 回调入队时记下它需要等待的宽限期号，号相同的回调放在同一段里。宽限期结束时
+//! 整段移入`done`，不需要逐个检查；调用者只从`done`的队首取回调，保证同一cpu上的回调
+//! 按入队顺序执行。
+
+use alloc::collections::VecDeque;
+
+use super::CallbackItem;
+
+/// 等待同一个宽限期结束的一段回调
+struct RcuCbSegment {
+    gp_seq: u64,
+    callbacks: VecDeque<CallbackItem>,
+}
+
+pub(super) struct RcuSegCbList {
+    /// 宽限期已经结束、可以调用的回调
+    done: VecDeque<CallbackItem>,
+    /// 还在等待宽限期的回调，按宽限期号递增排列
+    segments: VecDeque<RcuCbSegment>,
+    /// `segments`中的回调总数
+    pending: usize,
+}
+
+impl RcuSegCbList {
+    pub const fn new() -> Self {
+        Self {
+            done: VecDeque::new(),
+            segments: VecDeque::new(),
+            pending: 0,
+        }
+    }
+
+    /// 把回调挂到等待`gp_seq`号宽限期的段上
+    ///
+    /// 宽限期号比队尾的段还小时并入队尾的段：多等几个宽限期总是安全的，
+    /// 这样段始终保持有序，回调也不会越过先入队的回调执行。
+    pub fn enqueue(&mut self, gp_seq: u64, item: CallbackItem) {
+        match self.segments.back_mut() {
+            Some(seg) if seg.gp_seq >= gp_seq => seg.callbacks.push_back(item),
+            _ => {
+                let mut callbacks = VecDeque::new();
+                callbacks.push_back(item);
+                self.segments.push_back(RcuCbSegment { gp_seq, callbacks });
+            }
+        }
+        self.pending += 1;
+    }
+
+    /// 把等待的宽限期已经结束（号不大于`completed`）的段移入`done`
+    ///
+    /// ## 返回值
+    ///
+    /// `done`中是否有回调
+    pub fn advance(&mut self, completed: u64) -> bool {
+        while self
+            .segments
+            .front()
+            .is_some_and(|seg| seg.gp_seq <= completed)
+        {
+            let mut seg = self.segments.pop_front().unwrap();
+            self.pending -= seg.callbacks.len();
+            if self.done.is_empty() {
+                self.done = seg.callbacks;
+            } else {
+                self.done.append(&mut seg.callbacks);
+            }
+        }
+        !self.done.is_empty()
+    }
+
+    pub fn pop_done(&mut self) -> Option<CallbackItem> {
+        self.done.pop_front()
+    }
+
+    /// 最早一段回调等待的宽限期号
+    pub fn next_gp_seq(&self) -> Option<u64> {
+        self.segments.front().map(|seg| seg.gp_seq)
+    }
+
+    pub fn pending_len(&self) -> usize {
+        self.pending
+    }
+
+    pub fn done_len(&self) -> usize {
+        self.done.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.pending == 0 && self.done.is_empty()
+    }
+}
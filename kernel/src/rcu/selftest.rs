@@ -15,6 +15,7 @@ use crate::{
     },
     process::preempt::PreemptGuard,
     smp::{core::smp_get_processor_id, cpu::ProcessorId},
+    time::timekeeping::ktime_get,
 };
 use system_error::SystemError;
 
@@ -131,12 +132,9 @@ struct RcuSelftestCpuStateGuard {
 
 impl RcuSelftestCpuStateGuard {
     fn new_active(cpu: ProcessorId) -> Self {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let cpu_idx = cpu.data() as usize;
-        let saved = inner.cpu_states[cpu_idx];
-        inner.cpu_states[cpu_idx].in_idle_eqs = false;
-        inner.cpu_states[cpu_idx].irq_nesting = 0;
-        inner.cpu_states[cpu_idx].irq_from_idle_eqs = false;
+        let mut state = rcu_data(cpu).state.lock_irqsave();
+        let saved = *state;
+        *state = RcuCpuState::new();
         Self { cpu, saved }
     }
 }
@@ -148,58 +146,40 @@ impl Drop for RcuSelftestCpuStateGuard {
 }
 
 fn restore_cpu_state_after_selftest(cpu: ProcessorId, saved: RcuCpuState) {
-    let wake_worker = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let cpu_idx = cpu.data() as usize;
-        inner.cpu_states[cpu_idx] = saved;
-        if inner.gp_active && inner.waiting_cpus.get(cpu).unwrap_or(false) {
-            inner.waiting_cpus.set(cpu, false);
-        }
-        RcuState::pump_grace_periods(&mut inner) || inner.has_ready_work()
-    };
+    *rcu_data(cpu).state.lock_irqsave() = saved;
+    // 测试期间开始的宽限期可能还在等本cpu，测试本身不在读端临界区内
+    rcu_report_qs_cpu(cpu);
+}
 
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
-    }
+/// 本cpu链表上(等待宽限期的回调数, 就绪未调用的回调数)
+fn cpu_callback_counts(cpu: ProcessorId) -> (usize, usize) {
+    let cbs = rcu_data(cpu).callbacks.lock_irqsave();
+    (cbs.list.pending_len(), cbs.list.done_len())
 }
 
 fn run_idle_irq_wakeup_selftest() -> Result<(), &'static str> {
-    let cpu = smp_get_processor_id();
-    let cpu_idx = cpu.data() as usize;
-
     rcu_barrier();
-    let (_, _, _, pending_before, ready_before) = debug_snapshot();
-    if pending_before != 0 || ready_before != 0 {
-        return Err("rcu callback queues were not empty before idle IRQ selftest");
-    }
 
     let _irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
     let _preempt_guard = PreemptGuard::new();
+    let cpu = smp_get_processor_id();
+    if cpu_callback_counts(cpu) != (0, 0) {
+        return Err("rcu callback queues were not empty before idle IRQ selftest");
+    }
     let cpu_state_guard = RcuSelftestCpuStateGuard::new_active(cpu);
 
-    let wake_worker = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let wake_worker = enter_cpu_idle_eqs(&mut inner, cpu);
-        if !cpu_in_idle_eqs(&inner.cpu_states[cpu_idx]) {
+    enter_cpu_idle_eqs(cpu);
+    {
+        let mut state = rcu_data(cpu).state.lock_irqsave();
+        if !cpu_in_idle_eqs(&state) {
             return Err("internal idle EQS helper failed to mark the CPU idle");
         }
 
-        let cpu_state = &mut inner.cpu_states[cpu_idx];
-        cpu_state.irq_from_idle_eqs = cpu_in_idle_eqs(cpu_state);
-        cpu_state.irq_nesting += 1;
-        if cpu_in_idle_eqs(cpu_state) {
+        state.irq_from_idle_eqs = cpu_in_idle_eqs(&state);
+        state.irq_nesting += 1;
+        if cpu_in_idle_eqs(&state) {
             return Err("internal idle IRQ helper failed to exit the idle EQS state");
         }
-
-        wake_worker
-    };
-
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
     }
 
     let idle_hits = Arc::new(AtomicUsize::new(0));
@@ -210,52 +190,40 @@ fn run_idle_irq_wakeup_selftest() -> Result<(), &'static str> {
         }
     });
 
-    let pre_exit_error = {
-        let inner = RCU_STATE.inner.lock_irqsave();
-        if idle_hits.load(Ordering::SeqCst) != 0 {
-            Some("idle IRQ callback ran before the interrupted CPU returned to idle")
-        } else if !inner.gp_active || !inner.waiting_cpus.get(cpu).unwrap_or(false) {
-            Some("idle IRQ selftest did not put the current CPU in waiting_cpus")
-        } else if inner.pending_callbacks.len() != 1 || !inner.ready_callbacks.is_empty() {
-            Some("idle IRQ selftest corrupted callback queue state before irq_exit")
-        } else {
-            None
+    if idle_hits.load(Ordering::SeqCst) != 0 {
+        return Err("idle IRQ callback ran before the interrupted CPU returned to idle");
+    }
+    if cpu_callback_counts(cpu) != (1, 0) {
+        return Err("idle IRQ selftest corrupted callback queue state before irq_exit");
+    }
+    let target_gp = rcu_data(cpu)
+        .callbacks
+        .lock_irqsave()
+        .list
+        .next_gp_seq()
+        .ok_or("idle IRQ selftest callback was not segmented by grace period")?;
+    {
+        // 回调等待的宽限期一旦开始，就必须等待处于中断中的本cpu
+        let gp = RCU_STATE.gp.lock_irqsave();
+        if gp.gp_seq > target_gp
+            || (gp.gp_active && gp.gp_seq == target_gp && !RCU_TREE.cpu_waited(cpu))
+        {
+            return Err("idle IRQ selftest did not make the grace period wait for the current CPU");
         }
-    };
-    if let Some(error) = pre_exit_error {
-        return Err(error);
     }
 
-    let idle_irq_exit_result = {
-        let mut inner = RCU_STATE.inner.lock_irqsave();
-        let cpu_state = &mut inner.cpu_states[cpu_idx];
-        if cpu_state.irq_nesting != 1 || !cpu_state.irq_from_idle_eqs {
-            Err("idle IRQ selftest lost the interrupted-idle state")
-        } else {
-            cpu_state.irq_nesting -= 1;
-            cpu_state.irq_from_idle_eqs = false;
-            Ok(enter_cpu_idle_eqs(&mut inner, cpu))
-        }
-    };
-    let wake_worker = match idle_irq_exit_result {
-        Ok(wake_worker) => wake_worker,
-        Err(error) => {
-            return Err(error);
+    {
+        let mut state = rcu_data(cpu).state.lock_irqsave();
+        if state.irq_nesting != 1 || !state.irq_from_idle_eqs {
+            return Err("idle IRQ selftest lost the interrupted-idle state");
         }
-    };
-
-    RCU_STATE.wake_state_waiters();
-    if wake_worker {
-        RCU_STATE.wake_worker();
-        RCU_STATE.maybe_process_ready_callbacks_inline();
+        state.irq_nesting -= 1;
+        state.irq_from_idle_eqs = false;
     }
+    enter_cpu_idle_eqs(cpu);
 
-    let post_exit_waiting = {
-        let inner = RCU_STATE.inner.lock_irqsave();
-        inner.waiting_cpus.get(cpu).unwrap_or(false)
-    };
-    if post_exit_waiting {
-        return Err("idle IRQ exit left the current CPU in waiting_cpus");
+    if RCU_TREE.cpu_waited(cpu) {
+        return Err("idle IRQ exit left the current CPU in the combining tree");
     }
 
     drop(cpu_state_guard);
@@ -809,3 +777,94 @@ pub fn run_debug_selftests() -> String {
 
     report
 }
+
+/// 压力模式中连续入队的回调个数
+const RCU_STRESS_CALLBACKS: usize = 20000;
+/// 压力模式中测量宽限期延迟的次数
+const RCU_STRESS_GPS: usize = 16;
+/// 压力模式中测量读端开销的次数
+const RCU_STRESS_READS: usize = 100000;
+
+/// 一组延迟样本的(最小, 平均, 最大)，单位us
+fn latency_summary(samples: &[i64]) -> (i64, i64, i64) {
+    let min = samples.iter().copied().min().unwrap_or(0);
+    let max = samples.iter().copied().max().unwrap_or(0);
+    let avg = samples.iter().sum::<i64>() / samples.len().max(1) as i64;
+    (min / 1000, avg / 1000, max / 1000)
+}
+
+fn measure_gp_latency(sync: fn()) -> (i64, i64, i64) {
+    let samples: Vec<i64> = (0..RCU_STRESS_GPS)
+        .map(|_| {
+            let start = ktime_get();
+            sync();
+            ktime_get() - start
+        })
+        .collect();
+    latency_summary(&samples)
+}
+
+/// 吞吐量与延迟的压力测试，结果以`key=value`逐行输出
+///
+/// - 连续入队大量回调，统计每次入队的开销和从入队到全部调用完毕的回调吞吐量；
+/// - 反复调用`synchronize_rcu`与`synchronize_rcu_expedited`，统计宽限期延迟；
+/// - 统计一对`rcu_read_lock`/`rcu_read_unlock`的开销。
+pub fn run_debug_stress() -> String {
+    let mut report = String::new();
+    if !rcu_enabled() {
+        report.push_str("status=fail:rcu is not initialized\n");
+        return report;
+    }
+
+    rcu_barrier();
+    let (gp_before, _, _, _, _) = debug_snapshot();
+
+    let hits = Arc::new(AtomicUsize::new(0));
+    let start = ktime_get();
+    for _ in 0..RCU_STRESS_CALLBACKS {
+        let hits = hits.clone();
+        rcu_defer(move || {
+            hits.fetch_add(1, Ordering::Relaxed);
+        });
+    }
+    let queued = ktime_get();
+    rcu_barrier();
+    let finished = ktime_get();
+    let (gp_after, _, _, _, _) = debug_snapshot();
+
+    let invoked = hits.load(Ordering::SeqCst);
+    let total_ns = (finished - start).max(1);
+    let enqueue_ns = (queued - start) / RCU_STRESS_CALLBACKS as i64;
+    let cbs_per_sec = RCU_STRESS_CALLBACKS as i64 * 1_000_000_000 / total_ns;
+
+    let sync = measure_gp_latency(synchronize_rcu);
+    let expedited = measure_gp_latency(synchronize_rcu_expedited);
+
+    let start = ktime_get();
+    for _ in 0..RCU_STRESS_READS {
+        let _guard = rcu_read_lock();
+    }
+    let read_ns = (ktime_get() - start) / RCU_STRESS_READS as i64;
+
+    report.push_str(if invoked == RCU_STRESS_CALLBACKS {
+        "status=ok\n"
+    } else {
+        "status=fail:not every stress callback ran before rcu_barrier returned\n"
+    });
+    report.push_str(&format!("callbacks={}\n", RCU_STRESS_CALLBACKS));
+    report.push_str(&format!("callbacks_invoked={}\n", invoked));
+    report.push_str(&format!("callback_enqueue_ns={}\n", enqueue_ns));
+    report.push_str(&format!("callbacks_per_sec={}\n", cbs_per_sec));
+    report.push_str(&format!("callback_gps={}\n", gp_after - gp_before));
+    report.push_str(&format!(
+        "sync_us_min_avg_max={}/{}/{}\n",
+        sync.0, sync.1, sync.2
+    ));
+    report.push_str(&format!(
+        "sync_expedited_us_min_avg_max={}/{}/{}\n",
+        expedited.0, expedited.1, expedited.2
+    ));
+    report.push_str(&format!("read_lock_unlock_ns={}\n", read_ns));
+
+    report
+}
@@ -0,0 +1,229 @@
+//! 静止状态的分层合并树
+//!
+//! 宽限期开始时，每个叶子节点记下它覆盖的cpu中需要等待的那些（`qsmask`），
+//! 上层节点记下还没有完成的子节点。cpu报告静止状态时只锁自己所在的叶子，
+//! 叶子清空之后才去锁父节点，以此类推，根节点清空即宽限期结束。
+//! 大部分报告因此只在同一个叶子下的少数cpu之间竞争，不再争抢全局锁。
+//!
+//! 节点按层从根到叶子存放，宽限期初始化也按这个顺序进行：父节点总是先于子节点
+//! 进入新的宽限期，子节点向上报告时不会碰到还停留在上一个宽限期的父节点。
+
+use alloc::vec::Vec;
+
+use crate::{
+    libs::{cpumask::CpuMask, spinlock::SpinLock},
+    smp::cpu::ProcessorId,
+};
+
+/// 每个叶子节点覆盖的cpu数
+pub(super) const RCU_FANOUT_LEAF: usize = 16;
+/// 非叶子节点的子节点数上限（qsmask的位数）
+const RCU_FANOUT: usize = 64;
+
+#[derive(Debug)]
+struct RcuNodeInner {
+    /// 本节点所处的宽限期号
+    gp_seq: u64,
+    /// 叶子节点：还没有报告静止状态的cpu；非叶子节点：还没有完成的子节点
+    qsmask: u64,
+}
+
+#[derive(Debug)]
+struct RcuNode {
+    inner: SpinLock<RcuNodeInner>,
+    parent: Option<usize>,
+    /// 本节点在父节点`qsmask`中对应的位
+    grpmask: u64,
+    /// 叶子节点覆盖的cpu号，或者非叶子节点的子节点下标，左闭右开
+    lo: usize,
+    hi: usize,
+    leaf: bool,
+}
+
+impl RcuNode {
+    /// 非叶子节点在宽限期开始时需要等待的子节点
+    fn children_mask(&self) -> u64 {
+        let n = self.hi - self.lo;
+        if n >= RCU_FANOUT {
+            u64::MAX
+        } else {
+            (1u64 << n) - 1
+        }
+    }
+}
+
+#[derive(Debug)]
+pub(super) struct RcuTree {
+    nodes: Vec<RcuNode>,
+    /// 第一个叶子节点的下标
+    leaf_base: usize,
+}
+
+impl RcuTree {
+    pub fn new(nr_cpus: usize) -> Self {
+        // 从叶子往上逐层计算节点数，直到只剩一个根节点
+        let mut counts = alloc::vec![nr_cpus.div_ceil(RCU_FANOUT_LEAF).max(1)];
+        while *counts.last().unwrap() > 1 {
+            counts.push(counts.last().unwrap().div_ceil(RCU_FANOUT));
+        }
+        counts.reverse();
+
+        let mut bases = Vec::with_capacity(counts.len());
+        let mut total = 0;
+        for count in counts.iter() {
+            bases.push(total);
+            total += count;
+        }
+
+        let depth = counts.len();
+        let mut nodes = Vec::with_capacity(total);
+        for level in 0..depth {
+            let leaf = level == depth - 1;
+            for i in 0..counts[level] {
+                let (parent, grpmask) = if level == 0 {
+                    (None, 0)
+                } else {
+                    (
+                        Some(bases[level - 1] + i / RCU_FANOUT),
+                        1u64 << (i % RCU_FANOUT),
+                    )
+                };
+                let (lo, hi) = if leaf {
+                    (
+                        i * RCU_FANOUT_LEAF,
+                        ((i + 1) * RCU_FANOUT_LEAF).min(nr_cpus),
+                    )
+                } else {
+                    let child_base = bases[level + 1];
+                    (
+                        child_base + i * RCU_FANOUT,
+                        child_base + ((i + 1) * RCU_FANOUT).min(counts[level + 1]),
+                    )
+                };
+                nodes.push(RcuNode {
+                    inner: SpinLock::new(RcuNodeInner {
+                        gp_seq: 0,
+                        qsmask: 0,
+                    }),
+                    parent,
+                    grpmask,
+                    lo,
+                    hi,
+                    leaf,
+                });
+            }
+        }
+
+        Self {
+            nodes,
+            leaf_base: bases[depth - 1],
+        }
+    }
+
+    #[inline]
+    fn leaf_of(&self, cpu: ProcessorId) -> (&RcuNode, u64) {
+        let cpu = cpu.data() as usize;
+        (
+            &self.nodes[self.leaf_base + cpu / RCU_FANOUT_LEAF],
+            1u64 << (cpu % RCU_FANOUT_LEAF),
+        )
+    }
+
+    /// 进入`gp_seq`号宽限期，调用者持有全局宽限期锁
+    ///
+    /// ## 参数
+    ///
+    /// - `needs_qs`：叶子节点初始化时对其覆盖的每个cpu调用，返回该cpu是否需要报告静止状态
+    /// - `waiting`：记录需要等待的cpu
+    ///
+    /// ## 返回值
+    ///
+    /// 没有任何需要等待的cpu（宽限期可以立即结束）时返回true
+    pub fn gp_init<F>(&self, gp_seq: u64, mut needs_qs: F, waiting: &mut CpuMask) -> bool
+    where
+        F: FnMut(ProcessorId) -> bool,
+    {
+        for node in self.nodes.iter() {
+            let mut inner = node.inner.lock_irqsave();
+            inner.gp_seq = gp_seq;
+            inner.qsmask = if node.leaf {
+                let mut mask = 0;
+                for cpu in node.lo..node.hi {
+                    let cpu = ProcessorId::new(cpu as u32);
+                    if needs_qs(cpu) {
+                        mask |= 1u64 << (cpu.data() as usize % RCU_FANOUT_LEAF);
+                        waiting.set(cpu, true);
+                    }
+                }
+                mask
+            } else {
+                node.children_mask()
+            };
+
+            if inner.qsmask == 0 {
+                drop(inner);
+                self.report_up(node.parent, node.grpmask, gp_seq);
+            }
+        }
+
+        self.nodes[0].inner.lock_irqsave().qsmask == 0
+    }
+
+    /// 报告`cpu`经过了静止状态
+    ///
+    /// ## 返回值
+    ///
+    /// 这次报告清空了根节点时返回宽限期号，调用者负责结束该宽限期
+    pub fn report_cpu(&self, cpu: ProcessorId) -> Option<u64> {
+        let (leaf, bit) = self.leaf_of(cpu);
+        let mut inner = leaf.inner.lock_irqsave();
+        if inner.qsmask & bit == 0 {
+            return None;
+        }
+        inner.qsmask &= !bit;
+        if inner.qsmask != 0 {
+            return None;
+        }
+        let gp_seq = inner.gp_seq;
+        drop(inner);
+        self.report_up(leaf.parent, leaf.grpmask, gp_seq)
+    }
+
+    /// 子节点清空之后逐层向上清除对应的位
+    fn report_up(&self, mut parent: Option<usize>, mut mask: u64, gp_seq: u64) -> Option<u64> {
+        loop {
+            let Some(idx) = parent else {
+                return Some(gp_seq);
+            };
+            let node = &self.nodes[idx];
+            let mut inner = node.inner.lock_irqsave();
+            if inner.gp_seq != gp_seq || inner.qsmask & mask == 0 {
+                return None;
+            }
+            inner.qsmask &= !mask;
+            if inner.qsmask != 0 {
+                return None;
+            }
+            mask = node.grpmask;
+            parent = node.parent;
+        }
+    }
+
+    /// 当前宽限期是否还在等待`cpu`
+    pub fn cpu_waited(&self, cpu: ProcessorId) -> bool {
+        let (leaf, bit) = self.leaf_of(cpu);
+        leaf.inner.lock_irqsave().qsmask & bit != 0
+    }
+
+    /// 收集当前宽限期还在等待的cpu
+    pub fn waiting_cpus(&self, mask: &mut CpuMask) {
+        for leaf in self.nodes[self.leaf_base..].iter() {
+            let qsmask = leaf.inner.lock_irqsave().qsmask;
+            for cpu in leaf.lo..leaf.hi {
+                if qsmask & (1u64 << (cpu % RCU_FANOUT_LEAF)) != 0 {
+                    mask.set(ProcessorId::new(cpu as u32), true);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,565 @@
+//! CFS负载均衡
+//!
+//! - 周期均衡：`scheduler_tick()`发现到了`rq.next_balance`时触发SCHED软中断，
+//!   软中断里自底向上检查本cpu的调度域，到了均衡间隔的调度域执行一次`load_balance()`；
+//! - newidle均衡：cpu上没有可运行的任务、idle循环停机之前，先尝试从别的cpu拉一个任务；
+//! - 主动均衡：最忙的cpu上只剩正在运行、无法直接拉走的任务时（例如同一核心的两个SMT兄弟
+//!   各跑一个任务而另一个核心空闲，或者排队的任务都绑定在那个cpu上），通过迁移当前任务的
+//!   机制（`NEED_MIGRATE`）把它推到本cpu。
+//!
+//! 组和队列的负载取PELT维护的`cfs_rq.avg.load_avg`/`util_avg`，任务本身的负载取其权重。
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use alloc::{sync::Arc, vec::Vec};
+use system_error::SystemError;
+
+use crate::{
+    exception::softirq::{softirq_vectors, SoftirqNumber, SoftirqVec},
+    libs::cpumask::CpuMask,
+    process::{ProcessControlBlock, ProcessFlags},
+    smp::{core::smp_get_processor_id, cpu::ProcessorId},
+    time::{clocksource::HZ, timer::clock},
+};
+
+use super::{
+    cpu_is_online, cpu_rq, idle_cpu, rq_is_idle_cpu, select_task_rq,
+    topology::{
+        build_sched_domains, cpu_llc_shared, cpu_sched_domains, LlcShared, SchedDomain,
+        SchedDomainLevel,
+    },
+    CpuRunQueue, DequeueFlag, LoadWeight, OnRq, SchedPolicy, WakeupFlags, SCHED_CAPACITY_SCALE,
+};
+
+/// 一次均衡最多检查的任务数
+const SYSCTL_SCHED_NR_MIGRATE: usize = 32;
+/// 任务在这段时间（ns）内运行过，认为它的缓存还是热的，尽量不迁移
+const SYSCTL_SCHED_MIGRATION_COST: u64 = 500_000;
+
+/// nr_running >= 2 的rq个数，为0时newidle均衡无任务可拉，直接返回
+static NR_OVERLOADED_RQS: AtomicUsize = AtomicUsize::new(0);
+
+#[inline]
+pub(super) fn set_rq_overload(overload: bool) {
+    if overload {
+        NR_OVERLOADED_RQS.fetch_add(1, Ordering::Relaxed);
+    } else {
+        NR_OVERLOADED_RQS.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum CpuIdleType {
+    /// 周期均衡时cpu空闲
+    Idle,
+    /// 周期均衡时cpu忙碌
+    NotIdle,
+    /// cpu刚刚变为空闲
+    NewlyIdle,
+}
+
+/// 调度组的状态，越往后越忙
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+enum GroupType {
+    /// 还有空闲的cpu或算力
+    HasSpare,
+    /// 每个cpu都在运行任务，但没有任务在排队
+    FullyBusy,
+    /// 任务数超过了cpu数
+    Overloaded,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum MigrationType {
+    /// 按任务个数迁移
+    Task,
+    /// 按负载迁移
+    Load,
+}
+
+#[derive(Debug, Default)]
+struct GroupStats {
+    load: usize,
+    util: usize,
+    nr_running: usize,
+    idle_cpus: usize,
+    weight: usize,
+    capacity: usize,
+    avg_load: usize,
+}
+
+impl GroupStats {
+    fn group_type(&self, imbalance_pct: usize) -> GroupType {
+        if self.nr_running > self.weight {
+            GroupType::Overloaded
+        } else if self.nr_running < self.weight || self.capacity * 100 > self.util * imbalance_pct {
+            GroupType::HasSpare
+        } else {
+            GroupType::FullyBusy
+        }
+    }
+}
+
+/// 空闲cpu的cfs_rq不会被更新，平均值停留在最后一次出队时，按0计算
+#[inline]
+pub(super) fn cpu_load(rq: &CpuRunQueue) -> usize {
+    if rq.cfs.h_nr_running == 0 {
+        0
+    } else {
+        rq.cfs.avg.load_avg
+    }
+}
+
+#[inline]
+fn cpu_util(rq: &CpuRunQueue) -> usize {
+    if rq.cfs.h_nr_running == 0 {
+        0
+    } else {
+        rq.cfs.avg.util_avg.min(SCHED_CAPACITY_SCALE as usize)
+    }
+}
+
+fn group_stats(group: &CpuMask) -> GroupStats {
+    let mut stats = GroupStats::default();
+    for cpu in group.iter_cpu() {
+        if !cpu_is_online(cpu) {
+            continue;
+        }
+        let rq = cpu_rq(cpu.data() as usize);
+        stats.load += cpu_load(&rq);
+        stats.util += cpu_util(&rq);
+        stats.nr_running += rq.nr_running;
+        if idle_cpu(cpu) {
+            stats.idle_cpus += 1;
+        }
+        stats.weight += 1;
+    }
+    stats.capacity = stats.weight * SCHED_CAPACITY_SCALE as usize;
+    if stats.capacity > 0 {
+        stats.avg_load = stats.load * SCHED_CAPACITY_SCALE as usize / stats.capacity;
+    }
+    stats
+}
+
+/// 一次均衡的参数
+struct LbEnv<'a> {
+    sd: &'a SchedDomain,
+    dst_cpu: ProcessorId,
+    idle: CpuIdleType,
+    migration_type: MigrationType,
+    /// 还需要迁移的任务数或负载
+    imbalance: usize,
+    /// 检查过的任务都不允许在dst_cpu上运行
+    all_pinned: bool,
+}
+
+/// 周期均衡时只让本组的第一个空闲cpu（都不空闲时是第一个cpu）执行，避免同组的cpu重复拉任务
+fn should_we_balance(env: &LbEnv) -> bool {
+    if env.idle == CpuIdleType::NewlyIdle {
+        return true;
+    }
+    let local = &env.sd.groups[0];
+    let balance_cpu = local
+        .iter_cpu()
+        .find(|&cpu| cpu_is_online(cpu) && idle_cpu(cpu))
+        .or_else(|| local.iter_cpu().find(|&cpu| cpu_is_online(cpu)));
+    balance_cpu == Some(env.dst_cpu)
+}
+
+/// 找出调度域内最忙的组，并计算需要迁移的量
+fn find_busiest_group(env: &mut LbEnv) -> Option<usize> {
+    let sd = env.sd;
+    let stats: Vec<GroupStats> = sd.groups.iter().map(group_stats).collect();
+    let local = &stats[0];
+    let local_type = local.group_type(sd.imbalance_pct);
+
+    let mut busiest: Option<(usize, GroupType)> = None;
+    for (i, group) in stats.iter().enumerate().skip(1) {
+        if group.nr_running == 0 {
+            continue;
+        }
+        let group_type = group.group_type(sd.imbalance_pct);
+        let better = match busiest {
+            None => true,
+            Some((b, b_type)) => {
+                let b = &stats[b];
+                if group_type != b_type {
+                    group_type > b_type
+                } else if group_type == GroupType::HasSpare {
+                    // 空闲cpu越少越忙
+                    group.idle_cpus < b.idle_cpus
+                        || (group.idle_cpus == b.idle_cpus && group.nr_running > b.nr_running)
+                } else {
+                    group.avg_load > b.avg_load
+                }
+            }
+        };
+        if better {
+            busiest = Some((i, group_type));
+        }
+    }
+    let (busiest_idx, busiest_type) = busiest?;
+    let busiest = &stats[busiest_idx];
+
+    if local_type == GroupType::HasSpare {
+        // 本组还有空闲：把任务数（或空闲cpu数）拉平
+        let nr_diff = busiest.nr_running.saturating_sub(local.nr_running);
+        let idle_diff = local.idle_cpus.saturating_sub(busiest.idle_cpus);
+        env.migration_type = MigrationType::Task;
+        env.imbalance = (nr_diff / 2).max(idle_diff / 2);
+        return (env.imbalance > 0).then_some(busiest_idx);
+    }
+
+    if busiest_type != GroupType::Overloaded {
+        return None;
+    }
+
+    // 两边都没有空闲：按平均负载拉平，差距在imbalance_pct以内时不动
+    if busiest.avg_load <= local.avg_load
+        || busiest.avg_load * 100 <= local.avg_load * sd.imbalance_pct
+    {
+        return None;
+    }
+    let (total_load, total_capacity) = stats
+        .iter()
+        .fold((0, 0), |(l, c), s| (l + s.load, c + s.capacity));
+    let sds_avg = total_load * SCHED_CAPACITY_SCALE as usize / total_capacity.max(1);
+    if local.avg_load >= sds_avg {
+        return None;
+    }
+
+    env.migration_type = MigrationType::Load;
+    env.imbalance = core::cmp::min(
+        (busiest.avg_load.saturating_sub(sds_avg)) * busiest.capacity,
+        (sds_avg - local.avg_load) * local.capacity,
+    ) / SCHED_CAPACITY_SCALE as usize;
+    (env.imbalance > 0).then_some(busiest_idx)
+}
+
+/// 在最忙的组里找出最忙的cpu
+fn find_busiest_queue(env: &LbEnv, group: &CpuMask) -> Option<ProcessorId> {
+    let mut busiest: Option<(ProcessorId, usize)> = None;
+    for cpu in group.iter_cpu() {
+        if cpu == env.dst_cpu || !cpu_is_online(cpu) {
+            continue;
+        }
+        let rq = cpu_rq(cpu.data() as usize);
+        if rq.cfs.h_nr_running == 0 {
+            continue;
+        }
+        let metric = match env.migration_type {
+            MigrationType::Task => rq.nr_running,
+            MigrationType::Load => {
+                let load = cpu_load(&rq);
+                // 只有一个任务且负载超过不均衡量，搬过来也只是换个地方不均衡
+                if rq.nr_running == 1 && load > env.imbalance {
+                    continue;
+                }
+                load
+            }
+        };
+        if busiest.is_none_or(|(_, m)| metric > m) {
+            busiest = Some((cpu, metric));
+        }
+    }
+    busiest.map(|(cpu, _)| cpu)
+}
+
+#[inline]
+fn task_allowed_on(pcb: &Arc<ProcessControlBlock>, cpu: ProcessorId) -> Option<bool> {
+    // 调用者持有rq锁，按锁序不能等待pi_lock
+    let pi_guard = pcb.sched_info().try_pi_lock_irqsave().ok()?;
+    Some(pi_guard.cpus_allowed.get(cpu).unwrap_or(false))
+}
+
+/// 检查排队中的任务能否迁移到dst_cpu
+fn can_migrate_task(src: &CpuRunQueue, pcb: &Arc<ProcessControlBlock>, env: &mut LbEnv) -> bool {
+    if pcb.sched_info().policy() != SchedPolicy::CFS
+        || Arc::ptr_eq(&src.current(), pcb)
+        || *pcb.sched_info().on_rq.lock_irqsave() != OnRq::Queued
+        || !pcb.sched_info().state().is_runnable()
+        || pcb
+            .flags()
+            .intersects(ProcessFlags::KTHREAD | ProcessFlags::NEED_MIGRATE)
+    {
+        return false;
+    }
+
+    match task_allowed_on(pcb, env.dst_cpu) {
+        Some(true) => env.all_pinned = false,
+        Some(false) => return false,
+        None => {
+            env.all_pinned = false;
+            return false;
+        }
+    }
+
+    // 多次失败之后不再考虑缓存热度
+    if env.sd.nr_balance_failed.load(Ordering::Relaxed) > env.sd.cache_nice_tries {
+        return true;
+    }
+    let se = pcb.sched_info().sched_entity();
+    src.clock_task.saturating_sub(se.exec_start) >= SYSCTL_SCHED_MIGRATION_COST
+}
+
+/// 持有src rq锁，把任务从src上摘下来，返回摘下的任务
+fn detach_tasks(src: &mut CpuRunQueue, env: &mut LbEnv) -> Vec<Arc<ProcessControlBlock>> {
+    let mut detached = Vec::new();
+    if src.nr_running <= 1 {
+        return detached;
+    }
+
+    let candidates: Vec<_> = src
+        .cfs_tasks
+        .iter()
+        .take(SYSCTL_SCHED_NR_MIGRATE)
+        .map(|se| se.pcb())
+        .collect();
+
+    for pcb in candidates {
+        if env.imbalance == 0 || src.nr_running <= 1 {
+            break;
+        }
+        if !can_migrate_task(src, &pcb, env) {
+            continue;
+        }
+
+        match env.migration_type {
+            MigrationType::Task => env.imbalance -= 1,
+            MigrationType::Load => {
+                let load = LoadWeight::scale_load_down(pcb.sched_info().sched_entity().load.weight)
+                    as usize;
+                // 任务比不均衡量还重，搬过来只会反过来不均衡；失败次数越多要求越宽松
+                let failed = env.sd.nr_balance_failed.load(Ordering::Relaxed).min(31);
+                if (load >> failed) > env.imbalance {
+                    continue;
+                }
+                env.imbalance = env.imbalance.saturating_sub(load);
+            }
+        }
+
+        src.dequeue_task(
+            pcb.clone(),
+            DequeueFlag::DEQUEUE_MOVE | DequeueFlag::DEQUEUE_NOCLOCK,
+        );
+        crate::process::rseq::Rseq::on_migrate(&pcb);
+        *pcb.sched_info().on_rq.lock_irqsave() = OnRq::None;
+        pcb.sched_info().set_on_cpu(None);
+        detached.push(pcb);
+
+        // newidle只需要拉一个任务就能让本cpu忙起来
+        if env.idle == CpuIdleType::NewlyIdle {
+            break;
+        }
+    }
+
+    detached
+}
+
+/// 把摘下的任务放到dst_cpu上
+///
+/// 任务摘下后到这里之间可能被修改了亲和性：在pi_lock下重新检查，不允许时另选cpu。
+fn attach_task(pcb: &Arc<ProcessControlBlock>, dst_cpu: ProcessorId) {
+    let pi_guard = pcb.sched_info().pi_lock_irqsave();
+    let target = if pi_guard.cpus_allowed.get(dst_cpu).unwrap_or(false) && cpu_is_online(dst_cpu) {
+        dst_cpu
+    } else {
+        select_task_rq(
+            pcb,
+            dst_cpu,
+            WakeupFlags::WF_MIGRATED,
+            &pi_guard.cpus_allowed,
+        )
+    };
+    super::enqueue_task_on_cpu(pcb, target, WakeupFlags::WF_MIGRATED, false);
+    drop(pi_guard);
+}
+
+/// 最忙的cpu上只有正在运行的任务可以迁移时，让它在下次调度时迁移到dst_cpu
+fn active_balance(src_cpu: ProcessorId, dst_cpu: ProcessorId) -> bool {
+    let rq = cpu_rq(src_cpu.data() as usize);
+    let (rq, guard) = rq.self_lock();
+    let current = rq.current();
+    if current.sched_info().policy() != SchedPolicy::CFS
+        || current
+            .flags()
+            .intersects(ProcessFlags::KTHREAD | ProcessFlags::NEED_MIGRATE)
+        || task_allowed_on(&current, dst_cpu) != Some(true)
+    {
+        return false;
+    }
+
+    current.sched_info().set_migrate_to(Some(dst_cpu));
+    current
+        .flags()
+        .insert(ProcessFlags::NEED_MIGRATE | ProcessFlags::NEED_SCHEDULE);
+    drop(guard);
+    super::send_resched_ipi(src_cpu);
+    true
+}
+
+/// 在调度域`sd`内为`this_cpu`做一次均衡，返回拉过来的任务数
+fn load_balance(this_cpu: ProcessorId, sd: &SchedDomain, idle: CpuIdleType) -> usize {
+    let mut env = LbEnv {
+        sd,
+        dst_cpu: this_cpu,
+        idle,
+        migration_type: MigrationType::Task,
+        imbalance: 0,
+        all_pinned: true,
+    };
+
+    if !should_we_balance(&env) {
+        return 0;
+    }
+
+    let busiest_cpu =
+        find_busiest_group(&mut env).and_then(|group| find_busiest_queue(&env, &sd.groups[group]));
+    let Some(busiest_cpu) = busiest_cpu else {
+        sd.nr_balance_failed.store(0, Ordering::Relaxed);
+        let interval = sd.balance_interval.load(Ordering::Relaxed);
+        if interval < sd.max_interval {
+            sd.balance_interval.store(interval * 2, Ordering::Relaxed);
+        }
+        return 0;
+    };
+
+    let src = cpu_rq(busiest_cpu.data() as usize);
+    let (src, guard) = src.self_lock();
+    src.update_rq_clock();
+    let src_nr_running = src.nr_running;
+    let detached = detach_tasks(src, &mut env);
+    drop(guard);
+
+    for pcb in detached.iter() {
+        attach_task(pcb, this_cpu);
+    }
+
+    if !detached.is_empty() {
+        sd.nr_balance_failed.store(0, Ordering::Relaxed);
+        sd.balance_interval
+            .store(sd.min_interval, Ordering::Relaxed);
+        return detached.len();
+    }
+
+    // newidle失败很常见，不计入失败次数
+    if idle != CpuIdleType::NewlyIdle {
+        sd.nr_balance_failed.fetch_add(1, Ordering::Relaxed);
+    }
+
+    // 本cpu空闲而对面只有一个在运行的任务（例如共享同一核心的SMT兄弟），
+    // 或者多次拉不动（排队的任务都绑定在对面），主动把对面正在运行的任务推过来
+    let need_active = (idle != CpuIdleType::NotIdle
+        && env.migration_type == MigrationType::Task
+        && src_nr_running == 1
+        && sd.level != SchedDomainLevel::Smt)
+        || sd.nr_balance_failed.load(Ordering::Relaxed) > sd.cache_nice_tries + 2;
+    if need_active && active_balance(busiest_cpu, this_cpu) {
+        // 避免在迁移完成之前再次触发
+        sd.nr_balance_failed
+            .store(sd.cache_nice_tries + 1, Ordering::Relaxed);
+        return 0;
+    }
+
+    if env.all_pinned {
+        let interval = sd.balance_interval.load(Ordering::Relaxed);
+        if interval < sd.max_interval {
+            sd.balance_interval.store(interval * 2, Ordering::Relaxed);
+        }
+    }
+    0
+}
+
+/// 周期均衡：自底向上检查本cpu的各个调度域，并计算下一次均衡的时间
+fn rebalance_domains(this_cpu: ProcessorId) {
+    let rq = cpu_rq(this_cpu.data() as usize);
+    let mut idle = if rq_is_idle_cpu(&rq) {
+        CpuIdleType::Idle
+    } else {
+        CpuIdleType::NotIdle
+    };
+
+    let now = clock();
+    let mut next_balance = now + 60 * HZ;
+    for sd in cpu_sched_domains(this_cpu) {
+        let mut interval = sd.interval(idle == CpuIdleType::NotIdle);
+        if now >= sd.last_balance.load(Ordering::Relaxed) + interval {
+            if let Some(llc) = cpu_llc_shared(this_cpu) {
+                if llc.span_weight == sd.span_weight {
+                    update_idle_cpu_scan(llc, sd.imbalance_pct);
+                }
+            }
+            if load_balance(this_cpu, sd, idle) > 0 {
+                // 拉到任务之后本cpu就不空闲了，上层按忙碌的间隔检查
+                idle = CpuIdleType::NotIdle;
+            }
+            sd.last_balance.store(now, Ordering::Relaxed);
+            interval = sd.interval(idle == CpuIdleType::NotIdle);
+        }
+        next_balance = next_balance.min(sd.last_balance.load(Ordering::Relaxed) + interval);
+    }
+
+    let (rq, _guard) = rq.self_lock();
+    rq.next_balance = next_balance;
+}
+
+/// 根据LLC的利用率更新唤醒时最多检查的空闲cpu数：利用率越高，找到空闲cpu的机会越小，
+/// 扫描就越少，按`nr = weight * (1 - (util / capacity)^2)`计算
+fn update_idle_cpu_scan(llc: &LlcShared, imbalance_pct: usize) {
+    let sum_util: usize = llc
+        .span
+        .iter_cpu()
+        .filter(|&cpu| cpu_is_online(cpu))
+        .map(|cpu| cpu_util(&cpu_rq(cpu.data() as usize)))
+        .sum();
+    let capacity = (llc.span_weight * SCHED_CAPACITY_SCALE as usize) as u64;
+    let util = ((sum_util * imbalance_pct / 100) as u64).min(capacity);
+    let weight = llc.span_weight as u64;
+    let nr = weight - weight * util * util / (capacity * capacity).max(1);
+    llc.nr_idle_scan.store(nr as usize, Ordering::Relaxed);
+}
+
+/// 在`scheduler_tick()`中调用，到了均衡时间时触发SCHED软中断
+#[inline]
+pub(super) fn trigger_load_balance(rq: &CpuRunQueue) {
+    if clock() >= rq.next_balance && !cpu_sched_domains(rq.cpu).is_empty() {
+        softirq_vectors().raise_softirq(SoftirqNumber::SCHED);
+    }
+}
+
+/// cpu即将空闲时尝试从其他cpu拉一个任务，在idle循环停机之前调用
+///
+/// ## 返回值
+/// - `true`: 本cpu上已经有可运行的任务，调用者应当调度而不是停机
+pub fn newidle_balance() -> bool {
+    if NR_OVERLOADED_RQS.load(Ordering::Relaxed) == 0 {
+        return false;
+    }
+
+    let this_cpu = smp_get_processor_id();
+    let rq = cpu_rq(this_cpu.data() as usize);
+    for sd in cpu_sched_domains(this_cpu) {
+        if rq.nr_running > 0 {
+            break;
+        }
+        load_balance(this_cpu, sd, CpuIdleType::NewlyIdle);
+    }
+    rq.nr_running > 0
+}
+
+#[derive(Debug)]
+struct SchedSoftirq;
+
+impl SoftirqVec for SchedSoftirq {
+    fn run(&self) {
+        rebalance_domains(smp_get_processor_id());
+    }
+}
+
+/// 建立调度域并注册负载均衡软中断，在所有cpu启动之后调用
+#[inline(never)]
+pub fn sched_balance_init() -> Result<(), SystemError> {
+    build_sched_domains();
+    softirq_vectors().register_softirq(SoftirqNumber::SCHED, Arc::new(SchedSoftirq))?;
+    Ok(())
+}
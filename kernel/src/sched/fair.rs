@@ -1135,7 +1135,9 @@ impl CfsRunQueue {
             let rq = rq.force_mut_locked();
 
             // TODO:numa
-            let _ = rq.cfs_tasks.extract_if(|x| Arc::ptr_eq(x, se));
+            rq.cfs_tasks
+                .extract_if(|x| Arc::ptr_eq(x, se))
+                .for_each(drop);
         }
 
         self.nr_running -= 1;
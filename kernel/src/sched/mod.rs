@@ -1,3 +1,4 @@
+pub mod balance;
 pub mod clock;
 pub mod completion;
 pub mod cputime;
@@ -11,11 +12,12 @@ pub mod loadavg;
 pub mod pelt;
 pub mod prio;
 pub mod syscall;
+pub mod topology;
 
 use core::{
     intrinsics::{likely, unlikely},
     panic::Location,
-    sync::atomic::{compiler_fence, fence, AtomicUsize, Ordering},
+    sync::atomic::{compiler_fence, fence, AtomicU64, AtomicUsize, Ordering},
 };
 
 use alloc::{
@@ -57,6 +59,7 @@ use self::{
     fair::{CfsRunQueue, CompletelyFairScheduler, FairSchedEntity},
     fifo::FifoScheduler,
     prio::{PrioUtil, MAX_RT_PRIO},
+    topology::{cpus_share_cache, LlcShared},
 };
 
 static mut CPU_IRQ_TIME: Option<Vec<&'static mut IrqTime>> = None;
@@ -65,6 +68,19 @@ pub static IDLE_CPUS: AtomicCpuMask = AtomicCpuMask::new();
 // 这里虽然rq是percpu的，但是在负载均衡的时候需要修改对端cpu的rq，所以仍需加锁
 static CPU_RUNQUEUE: Lazy<PerCpuVar<Arc<CpuRunQueue>>> = PerCpuVar::define_lazy();
 
+/// 每个cpu上发生的任务切换次数
+///
+/// 休眠锁的乐观自旋用它判断锁的持有者是否仍在某个cpu上运行：持有者加锁时记录所在cpu及其切换次数，
+/// 只要该cpu没有再发生切换，持有者就一定还在运行，而不需要访问持有者的pcb。
+static CPU_SWITCH_SEQ: [AtomicU64; PerCpu::MAX_CPU_NUM as usize] =
+    [const { AtomicU64::new(0) }; PerCpu::MAX_CPU_NUM as usize];
+
+/// 获取指定cpu上的任务切换次数
+#[inline(always)]
+pub fn cpu_switch_seq(cpu: ProcessorId) -> u64 {
+    CPU_SWITCH_SEQ[cpu.data() as usize].load(Ordering::Acquire)
+}
+
 pub const SCHED_FIXEDPOINT_SHIFT: u64 = 10;
 #[allow(dead_code)]
 pub const SCHED_FIXEDPOINT_SCALE: u64 = 1 << SCHED_FIXEDPOINT_SHIFT;
@@ -120,6 +136,27 @@ fn boot_in_progress() -> bool {
     )
 }
 
+/// cpu是否正在运行idle进程。LLC的空闲状态建立之后以LLC的掩码为准，之前使用全局掩码
+#[inline]
+pub fn idle_cpu(cpu: ProcessorId) -> bool {
+    match topology::cpu_llc_shared(cpu) {
+        Some(llc) => llc.idle_cpus.get(cpu),
+        None => IDLE_CPUS.get(cpu),
+    }
+}
+
+#[inline]
+fn set_cpu_idle(cpu: ProcessorId, idle: bool) {
+    if topology::update_llc_idle(cpu, idle) {
+        return;
+    }
+    if idle {
+        IDLE_CPUS.set(cpu);
+    } else {
+        IDLE_CPUS.clear(cpu);
+    }
+}
+
 pub fn pick_idle_cpu(allowed: &CpuMask) -> Option<ProcessorId> {
     if !smp_cpu_manager_initialized() {
         return IDLE_CPUS.first_and(allowed);
@@ -127,7 +164,7 @@ pub fn pick_idle_cpu(allowed: &CpuMask) -> Option<ProcessorId> {
 
     allowed
         .iter_cpu()
-        .find(|&cpu| IDLE_CPUS.get(cpu) && cpu_is_online(cpu))
+        .find(|&cpu| idle_cpu(cpu) && cpu_is_online(cpu))
 }
 
 #[inline]
@@ -135,6 +172,11 @@ fn cpu_allowed_and_online(allowed: &CpuMask, cpu: ProcessorId) -> bool {
     allowed.get(cpu).unwrap_or(false) && (!smp_cpu_manager_initialized() || cpu_is_online(cpu))
 }
 
+#[inline]
+fn available_idle_cpu(allowed: &CpuMask, cpu: ProcessorId) -> bool {
+    idle_cpu(cpu) && cpu_allowed_and_online(allowed, cpu)
+}
+
 #[inline]
 fn first_allowed_online_cpu(allowed: &CpuMask) -> Option<ProcessorId> {
     allowed
@@ -142,16 +184,145 @@ fn first_allowed_online_cpu(allowed: &CpuMask) -> Option<ProcessorId> {
         .find(|&cpu| !smp_cpu_manager_initialized() || cpu_is_online(cpu))
 }
 
+/// 不加锁读取远端rq的任务数，只用于选核时的估计
+#[inline]
 fn rq_nr_running(cpu: ProcessorId) -> usize {
-    let rq = cpu_rq(cpu.data() as usize);
-    let (rq, _guard) = rq.self_lock();
-    rq.nr_running
+    cpu_rq(cpu.data() as usize).nr_running
+}
+
+/// 在LLC内找一个所有SMT兄弟都空闲的核心，找不到时清除`has_idle_cores`提示
+fn select_idle_core(
+    llc: &LlcShared,
+    allowed: &CpuMask,
+    target: ProcessorId,
+) -> Option<ProcessorId> {
+    let found = llc
+        .idle_cores
+        .iter_and_wrap(allowed, target)
+        .find(|&cpu| topology::smt_core_idle(cpu) && cpu_is_online(cpu));
+    if found.is_none() {
+        llc.has_idle_cores.store(false, Ordering::Relaxed);
+    }
+    found
+}
+
+/// 从`target`开始在LLC的空闲掩码中查找，最多检查`nr`个候选cpu
+fn select_idle_cpu(
+    llc: &LlcShared,
+    allowed: &CpuMask,
+    target: ProcessorId,
+    nr: usize,
+) -> Option<ProcessorId> {
+    llc.idle_cpus
+        .iter_and_wrap(allowed, target)
+        .take(nr)
+        .find(|&cpu| cpu_is_online(cpu))
+}
+
+/// 在`target`所在的LLC内为被唤醒的任务找一个空闲cpu，找不到时返回`target`
+///
+/// 依次尝试：`target`本身、与之共享LLC的`prev`、空闲核心、空闲cpu。
+/// 只查找`target`的LLC，代价与系统中cpu总数无关；跨LLC的不均衡留给负载均衡处理。
+fn select_idle_sibling(allowed: &CpuMask, prev: ProcessorId, target: ProcessorId) -> ProcessorId {
+    if available_idle_cpu(allowed, target) {
+        return target;
+    }
+    if prev != target && cpus_share_cache(prev, target) && available_idle_cpu(allowed, prev) {
+        return prev;
+    }
+
+    let Some(llc) = topology::cpu_llc_shared(target) else {
+        // LLC的空闲状态还没有建立（启动早期）
+        return pick_idle_cpu(allowed).unwrap_or(target);
+    };
+
+    if llc.has_smt && llc.has_idle_cores.load(Ordering::Relaxed) {
+        if let Some(cpu) = select_idle_core(llc, allowed, target) {
+            return cpu;
+        }
+    }
+
+    let nr = if SCHED_FEATURES.contains(SchedFeature::SIS_UTIL) {
+        llc.nr_idle_scan.load(Ordering::Relaxed)
+    } else {
+        llc.span_weight
+    };
+    select_idle_cpu(llc, allowed, target, nr).unwrap_or(target)
+}
+
+/// 决定被唤醒的任务是拉到唤醒者所在的`this_cpu`，还是留在原来的`prev_cpu`
+///
+/// 唤醒者和被唤醒者通常在交换数据，放在同一个LLC里能共享缓存。
+/// 先看两边是否空闲，再比较两边的负载（对`prev_cpu`略有偏向，避免来回搬动）。
+fn wake_affine(
+    pcb: &Arc<ProcessControlBlock>,
+    this_cpu: ProcessorId,
+    prev_cpu: ProcessorId,
+    sync: bool,
+) -> ProcessorId {
+    if idle_cpu(this_cpu) && cpus_share_cache(this_cpu, prev_cpu) {
+        return if idle_cpu(prev_cpu) {
+            prev_cpu
+        } else {
+            this_cpu
+        };
+    }
+
+    let this_rq = cpu_rq(this_cpu.data() as usize);
+    // 唤醒者马上就要睡眠，它所在的cpu上只剩被唤醒的任务
+    if sync && this_rq.nr_running == 1 {
+        return this_cpu;
+    }
+    if idle_cpu(prev_cpu) {
+        return prev_cpu;
+    }
+
+    let imbalance_pct = topology::cpu_sched_domains(this_cpu)
+        .iter()
+        .find(|sd| sd.span.get(prev_cpu).unwrap_or(false))
+        .map(|sd| sd.imbalance_pct)
+        .unwrap_or(117);
+    let task_load =
+        LoadWeight::scale_load_down(pcb.sched_info().sched_entity().load.weight) as usize;
+
+    let mut this_eff_load = balance::cpu_load(&this_rq);
+    if sync {
+        let current_load = LoadWeight::scale_load_down(
+            ProcessManager::current_pcb()
+                .sched_info()
+                .sched_entity()
+                .load
+                .weight,
+        ) as usize;
+        if current_load > this_eff_load {
+            return this_cpu;
+        }
+        this_eff_load -= current_load;
+    }
+    // 各cpu的算力相同，不需要按算力缩放
+    this_eff_load = (this_eff_load + task_load) * 100;
+
+    let prev_eff_load = balance::cpu_load(&cpu_rq(prev_cpu.data() as usize))
+        .saturating_sub(task_load)
+        * (100 + (imbalance_pct - 100) / 2)
+        + sync as usize;
+
+    if this_eff_load < prev_eff_load {
+        this_cpu
+    } else {
+        prev_cpu
+    }
 }
 
 fn select_fork_idle_cpu(allowed: &CpuMask, fallback_cpu: ProcessorId) -> Option<ProcessorId> {
-    let idle_cpu = allowed
-        .iter_cpu()
-        .find(|&cpu| cpu_allowed_and_online(allowed, cpu) && IDLE_CPUS.get(cpu))?;
+    // 优先找与父进程共享LLC的空闲cpu
+    let idle_cpu = topology::cpu_llc_shared(fallback_cpu)
+        .and_then(|llc| select_idle_cpu(llc, allowed, fallback_cpu, llc.span_weight))
+        .or_else(|| {
+            allowed
+                .iter_cpu()
+                .find(|&cpu| available_idle_cpu(allowed, cpu))
+        })?;
 
     if idle_cpu == fallback_cpu || !cpu_allowed_and_online(allowed, fallback_cpu) {
         return Some(idle_cpu);
@@ -216,11 +387,19 @@ pub fn select_task_rq(
     }
 
     if wake_flags.contains(WakeupFlags::WF_TTWU) {
-        if let Some(idle_cpu) = pick_idle_cpu(allowed) {
-            return idle_cpu;
+        let mut target = fallback_cpu;
+        if fallback_cpu == prev_cpu
+            && current_cpu != prev_cpu
+            && cpu_allowed_and_online(allowed, current_cpu)
+        {
+            target = wake_affine(
+                pcb,
+                current_cpu,
+                prev_cpu,
+                wake_flags.contains(WakeupFlags::WF_SYNC),
+            );
         }
-
-        return select_least_loaded_cpu(allowed, fallback_cpu);
+        return select_idle_sibling(allowed, fallback_cpu, target);
     }
 
     fallback_cpu
@@ -819,8 +998,13 @@ impl CpuRunQueue {
 
         self.nr_running = prev + nr_running;
         loadavg::inc_nr_running(nr_running);
-        if prev < 2 && self.nr_running >= 2 && !self.overload {
-            self.overload = true;
+        if prev < 2 && self.nr_running >= 2 {
+            if !self.overload {
+                self.overload = true;
+                balance::set_rq_overload(true);
+            }
+            // 多于一个任务时需要tick做时间片轮转，nohz_full cpu要恢复tick
+            crate::time::tick_sched::tick_nohz_full_kick_cpu(self.cpu);
         }
     }
 
@@ -829,6 +1013,7 @@ impl CpuRunQueue {
         loadavg::dec_nr_running(count);
         if self.nr_running < 2 && self.overload {
             self.overload = false;
+            balance::set_rq_overload(false);
         }
     }
 
@@ -1026,14 +1211,24 @@ pub enum OnRq {
 }
 
 impl ProcessManager {
-    pub fn update_process_times(user_tick: bool) {
+    /// `ticks`为距离本cpu上一次记账经过的tick数，停tick之后的第一次tick可能大于1
+    pub fn update_process_times(user_tick: bool, ticks: u64) {
         let pcb = Self::current_pcb();
-        CpuTimeFunc::irqtime_account_process_tick(&pcb, user_tick, 1);
+        if ticks > 0 {
+            CpuTimeFunc::irqtime_account_process_tick(&pcb, user_tick, ticks);
+        }
 
         scheduler_tick();
     }
 }
 
+/// cpu上的调度类是否不再需要tick（对标Linux sched_can_stop_tick）
+///
+/// 只有一个可运行任务时没有时间片轮转的需要。无锁读取，调用者需要容忍过时的值
+pub(crate) fn sched_can_stop_tick(cpu: ProcessorId) -> bool {
+    rq_nr_running(cpu) <= 1
+}
+
 /// ## 时钟tick时调用此函数
 pub fn scheduler_tick() {
     fence(Ordering::SeqCst);
@@ -1059,8 +1254,9 @@ pub fn scheduler_tick() {
 
     rq.calculate_global_load_tick();
 
+    balance::trigger_load_balance(rq);
+
     drop(guard);
-    // TODO:处理负载均衡
 }
 
 /// ## 执行调度
@@ -1068,8 +1264,18 @@ pub fn scheduler_tick() {
 #[inline]
 pub fn schedule(sched_mod: SchedMode) {
     let _guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
-    assert_eq!(ProcessManager::current_pcb().preempt_count(), 0);
+    let current = ProcessManager::current_pcb();
+    assert_eq!(current.preempt_count(), 0);
+    // 工作者线程在执行工作项时睡眠，工作者池可能需要另派一个工作者接着干活
+    let wq_worker = current.flags().contains(ProcessFlags::WQ_WORKER);
+    if wq_worker && current.sched_info().state().is_blocked() {
+        crate::exception::workqueue::wq_worker_sleeping(&current);
+    }
+    drop(current);
     __schedule(sched_mod);
+    if wq_worker {
+        crate::exception::workqueue::wq_worker_running(&ProcessManager::current_pcb());
+    }
 }
 
 /// IO 调度函数：标记当前进程正在等待 IO 并触发调度
@@ -1237,9 +1443,9 @@ fn __schedule_inner(sched_mod: SchedMode, current: Option<Arc<ProcessControlBloc
 
     let next = rq.pick_next_task(prev.clone());
     if task_is_idle(&next) {
-        IDLE_CPUS.set(rq.cpu);
+        set_cpu_idle(rq.cpu, true);
     } else if task_is_idle(&prev) {
-        IDLE_CPUS.clear(rq.cpu);
+        set_cpu_idle(rq.cpu, false);
     }
 
     prev.flags().remove(ProcessFlags::NEED_SCHEDULE);
@@ -1248,6 +1454,7 @@ fn __schedule_inner(sched_mod: SchedMode, current: Option<Arc<ProcessControlBloc
         crate::process::rseq::Rseq::on_preempt(&prev);
 
         rq.set_current(Arc::downgrade(&next));
+        CPU_SWITCH_SEQ[rq.cpu.data() as usize].fetch_add(1, Ordering::Release);
         compiler_fence(Ordering::SeqCst);
         account_context_switch();
         if let Some(dest_cpu) = migrate_prev_to {
@@ -1261,6 +1468,8 @@ fn __schedule_inner(sched_mod: SchedMode, current: Option<Arc<ProcessControlBloc
         }
         drop(guard);
 
+        crate::time::tick_sched::tick_nohz_task_switch(&prev, &next);
+
         unsafe { ProcessManager::switch_process(prev, next) };
     } else {
         assert!(
@@ -1374,7 +1583,7 @@ pub fn enqueue_task_on_cpu(
     );
 
     if was_idle && !rq_is_idle_cpu(rq) {
-        IDLE_CPUS.clear(target_cpu);
+        set_cpu_idle(target_cpu, false);
     }
 
     rq.check_preempt_current(pcb, wake_flags);
@@ -1471,6 +1680,12 @@ pub fn sched_init() {
     cputime::init_kernel_cpu_stat();
 }
 
+/// 所有cpu启动之后，根据cpu拓扑建立调度域并开启负载均衡
+#[inline(never)]
+pub fn sched_init_smp() {
+    balance::sched_balance_init().expect("sched balance init failed");
+}
+
 #[inline]
 pub fn send_resched_ipi(cpu: ProcessorId) {
     send_ipi(IpiKind::KickCpu, IpiTarget::Specified(cpu));
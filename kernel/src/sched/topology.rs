@@ -0,0 +1,364 @@
+//! 调度域
+//!
+//! 每个cpu自底向上有一串调度域：SMT（同一核心）→ MC（共享LLC）→ PKG（同一封装）→ SYS（所有cpu）。
+//! 调度域由若干调度组组成，组就是下一层拓扑的范围，负载均衡在调度域内比较各组的负载，
+//! 把任务从最忙的组拉到本cpu所在的组。只有一个组的层级（例如没有SMT时的SMT层）会被省略。
+//!
+//! 同一LLC内的cpu还共享一份空闲状态（`LlcShared`），唤醒选核时只需在LLC内的空闲掩码里查找，
+//! 不用扫描所有cpu。
+
+use core::sync::atomic::{fence, AtomicBool, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+
+use alloc::{sync::Arc, vec::Vec};
+use log::info;
+
+use crate::{
+    libs::{
+        cpumask::{AtomicCpuMask, CpuMask},
+        lazy_init::Lazy,
+    },
+    smp::{
+        cpu::{smp_cpu_manager, ProcessorId},
+        topology::{cpu_llc_mask, cpu_package_mask, cpu_smt_mask},
+    },
+    time::clocksource::HZ,
+};
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SchedDomainLevel {
+    Smt,
+    Mc,
+    Pkg,
+    Sys,
+}
+
+impl SchedDomainLevel {
+    /// 该层级调度组的范围（即下一层拓扑的范围）
+    fn group_mask(&self, cpu: ProcessorId) -> CpuMask {
+        match self {
+            SchedDomainLevel::Smt => CpuMask::from_cpu(cpu),
+            SchedDomainLevel::Mc => cpu_smt_mask(cpu),
+            SchedDomainLevel::Pkg => cpu_llc_mask(cpu),
+            SchedDomainLevel::Sys => cpu_package_mask(cpu),
+        }
+    }
+
+    fn span(&self, cpu: ProcessorId) -> CpuMask {
+        match self {
+            SchedDomainLevel::Smt => cpu_smt_mask(cpu),
+            SchedDomainLevel::Mc => cpu_llc_mask(cpu),
+            SchedDomainLevel::Pkg => cpu_package_mask(cpu),
+            SchedDomainLevel::Sys => smp_cpu_manager().present_cpus().clone(),
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct SchedDomain {
+    pub level: SchedDomainLevel,
+    /// 调度域包含的cpu
+    pub span: CpuMask,
+    pub span_weight: usize,
+    /// 调度组，第0个是本cpu所在的组
+    pub groups: Vec<CpuMask>,
+    /// 均衡间隔的上下限（jiffies）
+    pub min_interval: u64,
+    pub max_interval: u64,
+    /// 本cpu忙碌时，均衡间隔放大的倍数
+    pub busy_factor: u64,
+    /// 最忙的组的负载超过本组的百分比，超过才认为不均衡
+    pub imbalance_pct: usize,
+    /// 连续失败多少次之后不再考虑任务的缓存热度
+    pub cache_nice_tries: u32,
+    /// 当前的均衡间隔（jiffies），均衡成功时回到下限，无事可做时加倍
+    pub balance_interval: AtomicU64,
+    pub last_balance: AtomicU64,
+    pub nr_balance_failed: AtomicU32,
+}
+
+impl SchedDomain {
+    fn new(cpu: ProcessorId, level: SchedDomainLevel) -> Option<Self> {
+        let span = level.span(cpu);
+        if !span.get(cpu).unwrap_or(false) {
+            return None;
+        }
+
+        let mut covered = CpuMask::new();
+        let mut groups = Vec::new();
+        // 本cpu所在的组放在最前面
+        for first in core::iter::once(cpu).chain(span.iter_cpu()) {
+            if covered.get(first).unwrap_or(false) {
+                continue;
+            }
+            let group = &level.group_mask(first) & &span;
+            for c in group.iter_cpu() {
+                covered.set(c, true);
+            }
+            groups.push(group);
+        }
+        if groups.len() < 2 {
+            return None;
+        }
+
+        let span_weight = span.iter_cpu().count();
+        let (imbalance_pct, cache_nice_tries) = match level {
+            SchedDomainLevel::Smt => (110, 0),
+            SchedDomainLevel::Mc | SchedDomainLevel::Pkg => (117, 1),
+            SchedDomainLevel::Sys => (125, 2),
+        };
+        let min_interval = msecs_to_jiffies(span_weight as u64);
+
+        Some(Self {
+            level,
+            span,
+            span_weight,
+            groups,
+            min_interval,
+            max_interval: msecs_to_jiffies(2 * span_weight as u64),
+            busy_factor: 16,
+            imbalance_pct,
+            cache_nice_tries,
+            balance_interval: AtomicU64::new(min_interval),
+            last_balance: AtomicU64::new(0),
+            nr_balance_failed: AtomicU32::new(0),
+        })
+    }
+
+    /// 本次的均衡间隔，cpu忙碌时放大`busy_factor`倍，减少对正在运行的任务的打扰
+    pub fn interval(&self, cpu_busy: bool) -> u64 {
+        let mut interval = self.balance_interval.load(Ordering::Relaxed);
+        if cpu_busy {
+            interval *= self.busy_factor;
+        }
+        interval.clamp(1, max_load_balance_interval())
+    }
+}
+
+#[inline]
+fn msecs_to_jiffies(ms: u64) -> u64 {
+    (ms * HZ / 1000).max(1)
+}
+
+/// 均衡间隔的上限：每个cpu 0.1秒
+fn max_load_balance_interval() -> u64 {
+    HZ * smp_cpu_manager().present_cpus_count() as u64 / 10
+}
+
+static SCHED_DOMAINS: Lazy<Vec<Vec<SchedDomain>>> = Lazy::new();
+
+/// 根据cpu拓扑为每个cpu建立调度域，在所有cpu启动之后调用
+#[inline(never)]
+pub fn build_sched_domains() {
+    let present = smp_cpu_manager().present_cpus();
+    let max_cpu = present
+        .last()
+        .map(|cpu| cpu.data() as usize + 1)
+        .unwrap_or(0);
+
+    let mut domains = Vec::with_capacity(max_cpu);
+    for cpu in 0..max_cpu {
+        let cpu = ProcessorId::new(cpu as u32);
+        let mut sds: Vec<SchedDomain> = Vec::new();
+        if present.get(cpu).unwrap_or(false) {
+            for level in [
+                SchedDomainLevel::Smt,
+                SchedDomainLevel::Mc,
+                SchedDomainLevel::Pkg,
+                SchedDomainLevel::Sys,
+            ] {
+                let Some(sd) = SchedDomain::new(cpu, level) else {
+                    continue;
+                };
+                // 与下一层范围相同的调度域没有意义
+                if sds
+                    .last()
+                    .is_some_and(|child| child.span_weight == sd.span_weight)
+                {
+                    continue;
+                }
+                sds.push(sd);
+            }
+        }
+        domains.push(sds);
+    }
+
+    if let Some(sds) = domains.first() {
+        for sd in sds {
+            info!(
+                "sched domain of cpu 0: {:?} span {:?}, {} groups",
+                sd.level,
+                sd.span,
+                sd.groups.len()
+            );
+        }
+    }
+
+    SCHED_DOMAINS.init(domains);
+    build_llc_shared();
+}
+
+/// `cpu`自底向上的调度域，调度域建立之前为空
+pub fn cpu_sched_domains(cpu: ProcessorId) -> &'static [SchedDomain] {
+    SCHED_DOMAINS
+        .try_get()
+        .and_then(|domains| domains.get(cpu.data() as usize))
+        .map(|sds| sds.as_slice())
+        .unwrap_or(&[])
+}
+
+/// 同一LLC内的cpu共享的空闲状态
+///
+/// cpu进出idle时只写自己所在LLC的掩码，避免所有cpu争抢同一条缓存行
+pub struct LlcShared {
+    pub span: CpuMask,
+    pub span_weight: usize,
+    /// LLC内是否有多个SMT兄弟组成的核心
+    pub has_smt: bool,
+    /// LLC内正在运行idle进程的cpu
+    pub idle_cpus: AtomicCpuMask,
+    /// LLC内所有SMT兄弟都空闲的核心上的cpu
+    pub idle_cores: AtomicCpuMask,
+    /// 可能存在空闲核心。只是提示：置位后由选核时的查找来确认，查找失败时清除
+    pub has_idle_cores: AtomicBool,
+    /// 唤醒时在LLC内最多检查多少个空闲cpu，由负载均衡根据LLC的利用率定期更新
+    pub nr_idle_scan: AtomicUsize,
+}
+
+struct CpuLlc {
+    shared: Arc<LlcShared>,
+    /// 同一核心上的cpu（包括自己）
+    smt_siblings: Vec<ProcessorId>,
+}
+
+static CPU_LLC: Lazy<Vec<Option<CpuLlc>>> = Lazy::new();
+
+fn build_llc_shared() {
+    let present = smp_cpu_manager().present_cpus();
+    let max_cpu = present
+        .last()
+        .map(|cpu| cpu.data() as usize + 1)
+        .unwrap_or(0);
+
+    let mut llcs: Vec<Arc<LlcShared>> = Vec::new();
+    let mut cpu_llc = Vec::with_capacity(max_cpu);
+    for cpu in 0..max_cpu {
+        let cpu = ProcessorId::new(cpu as u32);
+        if !present.get(cpu).unwrap_or(false) {
+            cpu_llc.push(None);
+            continue;
+        }
+
+        let smt_siblings: Vec<ProcessorId> = cpu_smt_mask(cpu).iter_cpu().collect();
+        let shared = match llcs.iter().find(|llc| llc.span.get(cpu).unwrap_or(false)) {
+            Some(llc) => llc.clone(),
+            None => {
+                let span = cpu_llc_mask(cpu);
+                let span_weight = span.iter_cpu().count();
+                let llc = Arc::new(LlcShared {
+                    has_smt: span
+                        .iter_cpu()
+                        .any(|c| cpu_smt_mask(c).iter_cpu().count() > 1),
+                    span,
+                    span_weight,
+                    idle_cpus: AtomicCpuMask::new(),
+                    idle_cores: AtomicCpuMask::new(),
+                    has_idle_cores: AtomicBool::new(false),
+                    nr_idle_scan: AtomicUsize::new(span_weight),
+                });
+                llcs.push(llc.clone());
+                llc
+            }
+        };
+        cpu_llc.push(Some(CpuLlc {
+            shared,
+            smt_siblings,
+        }));
+    }
+
+    // 用全局掩码里的状态初始化，此后cpu进出idle时只更新LLC的掩码
+    for (cpu, llc) in cpu_llc.iter().enumerate() {
+        if let Some(llc) = llc {
+            let cpu = ProcessorId::new(cpu as u32);
+            if super::IDLE_CPUS.get(cpu) {
+                llc.shared.idle_cpus.set(cpu);
+            }
+        }
+    }
+    for llc in cpu_llc.iter().flatten() {
+        if llc.smt_siblings.len() > 1
+            && llc
+                .smt_siblings
+                .iter()
+                .all(|&c| llc.shared.idle_cpus.get(c))
+        {
+            llc.smt_siblings
+                .iter()
+                .for_each(|&c| llc.shared.idle_cores.set(c));
+            llc.shared.has_idle_cores.store(true, Ordering::Relaxed);
+        }
+    }
+
+    info!("{} LLC idle domains", llcs.len());
+    CPU_LLC.init(cpu_llc);
+}
+
+#[inline]
+fn cpu_llc(cpu: ProcessorId) -> Option<&'static CpuLlc> {
+    CPU_LLC.try_get()?.get(cpu.data() as usize)?.as_ref()
+}
+
+/// `cpu`所在LLC的共享空闲状态，拓扑建立之前为`None`
+#[inline]
+pub fn cpu_llc_shared(cpu: ProcessorId) -> Option<&'static LlcShared> {
+    cpu_llc(cpu).map(|llc| llc.shared.as_ref())
+}
+
+/// 两个cpu是否共享最后一级缓存
+#[inline]
+pub fn cpus_share_cache(a: ProcessorId, b: ProcessorId) -> bool {
+    match (cpu_llc(a), cpu_llc(b)) {
+        (Some(x), Some(y)) => Arc::ptr_eq(&x.shared, &y.shared),
+        _ => true,
+    }
+}
+
+/// 更新`cpu`在所在LLC中的空闲状态，返回`false`表示LLC状态尚未建立
+pub fn update_llc_idle(cpu: ProcessorId, idle: bool) -> bool {
+    let Some(llc) = cpu_llc(cpu) else {
+        return false;
+    };
+    let shared = &llc.shared;
+    if idle {
+        if shared.idle_cpus.get(cpu) {
+            return true;
+        }
+        shared.idle_cpus.set(cpu);
+        if llc.smt_siblings.len() > 1 {
+            // 与兄弟cpu同时进入idle时，保证至少一方能看到整个核心都空闲
+            fence(Ordering::SeqCst);
+            if llc.smt_siblings.iter().all(|&c| shared.idle_cpus.get(c)) {
+                llc.smt_siblings
+                    .iter()
+                    .for_each(|&c| shared.idle_cores.set(c));
+                shared.has_idle_cores.store(true, Ordering::Relaxed);
+            }
+        }
+    } else if shared.idle_cpus.get(cpu) {
+        shared.idle_cpus.clear(cpu);
+        if shared.idle_cores.get(cpu) {
+            llc.smt_siblings
+                .iter()
+                .for_each(|&c| shared.idle_cores.clear(c));
+        }
+    }
+    true
+}
+
+/// `cpu`所在核心的所有SMT兄弟是否都空闲
+pub fn smt_core_idle(cpu: ProcessorId) -> bool {
+    cpu_llc(cpu).is_some_and(|llc| {
+        llc.smt_siblings
+            .iter()
+            .all(|&c| llc.shared.idle_cpus.get(c))
+    })
+}
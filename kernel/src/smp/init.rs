@@ -29,6 +29,7 @@ fn do_ap_start_stage2() {
     {
         crate::arch::x86_64::mm::X86_64MMArch::init_current_cpu_nxe();
         crate::driver::clocksource::kvm_clock::kvmclock_init_secondary();
+        crate::arch::x86_64::vdso::vdso_setup_getcpu();
     }
     arch_syscall_init().expect("AP core failed to initialize syscall");
 }
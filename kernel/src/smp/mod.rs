@@ -8,12 +8,14 @@ use crate::{
 use self::{
     core::smp_get_processor_id,
     cpu::{smp_cpu_manager, smp_cpu_manager_init, CpuHpCpuState, ProcessorId},
+    topology::{init_cpu_topology, CpuTopologyId},
 };
 
 pub mod core;
 pub mod cpu;
 pub mod init;
 mod syscall;
+pub mod topology;
 
 pub fn kick_cpu(cpu_id: ProcessorId) -> Result<(), SystemError> {
     // todo: 增加对cpu_id的有效性检查
@@ -39,6 +41,13 @@ pub trait SMPArch {
     ///
     /// 如果目标CPU已经启动，返回Ok。
     fn start_cpu(cpu_id: ProcessorId, hp_state: &CpuHpCpuState) -> Result<(), SystemError>;
+
+    /// 获取cpu在SMT/LLC/封装层级上的编号，在所有cpu启动之后调用
+    ///
+    /// 默认每个cpu单独一个核心，所有cpu共享LLC和封装
+    fn topology_id(cpu_id: ProcessorId) -> CpuTopologyId {
+        CpuTopologyId::flat(cpu_id)
+    }
 }
 
 /// 早期SMP初始化
@@ -54,4 +63,6 @@ pub fn smp_init() {
     smp_cpu_manager().bringup_nonboot_cpus();
 
     CurrentSMPArch::post_init().expect("SMP post init failed");
+
+    init_cpu_topology();
 }
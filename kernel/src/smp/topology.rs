@@ -0,0 +1,138 @@
+//! CPU拓扑
+//!
+//! 记录每个cpu的SMT兄弟、共享最后一级缓存（LLC）的cpu以及同一物理封装内的cpu。
+//! 拓扑在所有cpu启动之后由`smp_init()`建立，调度域据此划分负载均衡的范围。
+
+use alloc::vec::Vec;
+use log::info;
+
+use crate::{
+    arch::CurrentSMPArch,
+    libs::{cpumask::CpuMask, lazy_init::Lazy},
+    smp::{
+        cpu::{smp_cpu_manager, ProcessorId},
+        SMPArch,
+    },
+};
+
+/// 一个cpu在各个拓扑层级上的编号，编号相同的cpu属于同一个核心/LLC/封装
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct CpuTopologyId {
+    pub core_id: u32,
+    pub llc_id: u32,
+    pub package_id: u32,
+}
+
+impl CpuTopologyId {
+    /// 没有拓扑信息时的默认值：每个cpu单独一个核心，所有cpu共享LLC和封装
+    pub const fn flat(cpu: ProcessorId) -> Self {
+        Self {
+            core_id: cpu.data(),
+            llc_id: 0,
+            package_id: 0,
+        }
+    }
+}
+
+#[derive(Debug)]
+struct CpuTopology {
+    id: CpuTopologyId,
+    smt_mask: CpuMask,
+    llc_mask: CpuMask,
+    package_mask: CpuMask,
+}
+
+static CPU_TOPOLOGY: Lazy<Vec<CpuTopology>> = Lazy::new();
+
+/// 根据各个present cpu的拓扑编号建立兄弟cpu掩码
+#[inline(never)]
+pub fn init_cpu_topology() {
+    let present = smp_cpu_manager().present_cpus();
+    let max_cpu = present
+        .last()
+        .map(|cpu| cpu.data() as usize + 1)
+        .unwrap_or(0);
+
+    let ids: Vec<Option<CpuTopologyId>> = (0..max_cpu)
+        .map(|cpu| {
+            let cpu = ProcessorId::new(cpu as u32);
+            present
+                .get(cpu)
+                .unwrap_or(false)
+                .then(|| CurrentSMPArch::topology_id(cpu))
+        })
+        .collect();
+
+    let mask_of = |pred: &dyn Fn(&CpuTopologyId) -> bool| {
+        let mut mask = CpuMask::new();
+        for (cpu, id) in ids.iter().enumerate() {
+            if id.as_ref().is_some_and(pred) {
+                mask.set(ProcessorId::new(cpu as u32), true);
+            }
+        }
+        mask
+    };
+
+    let mut topology = Vec::with_capacity(max_cpu);
+    for (cpu, id) in ids.iter().enumerate() {
+        let id = id.unwrap_or(CpuTopologyId::flat(ProcessorId::new(cpu as u32)));
+        topology.push(CpuTopology {
+            id,
+            smt_mask: mask_of(&|x: &CpuTopologyId| {
+                x.package_id == id.package_id && x.core_id == id.core_id
+            }),
+            llc_mask: mask_of(&|x: &CpuTopologyId| {
+                x.package_id == id.package_id && x.llc_id == id.llc_id
+            }),
+            package_mask: mask_of(&|x: &CpuTopologyId| x.package_id == id.package_id),
+        });
+    }
+
+    for (cpu, t) in topology.iter().enumerate() {
+        info!(
+            "cpu {}: core {} llc {} package {}, smt {:?}, llc {:?}",
+            cpu, t.id.core_id, t.id.llc_id, t.id.package_id, t.smt_mask, t.llc_mask
+        );
+    }
+
+    CPU_TOPOLOGY.init(topology);
+}
+
+#[inline]
+fn cpu_topology(cpu: ProcessorId) -> Option<&'static CpuTopology> {
+    CPU_TOPOLOGY.try_get()?.get(cpu.data() as usize)
+}
+
+/// 拓扑是否已经建立
+#[inline]
+pub fn cpu_topology_initialized() -> bool {
+    CPU_TOPOLOGY.initialized()
+}
+
+/// 与`cpu`位于同一物理核心上的cpu（包括自己）
+pub fn cpu_smt_mask(cpu: ProcessorId) -> CpuMask {
+    cpu_topology(cpu)
+        .map(|t| t.smt_mask.clone())
+        .unwrap_or_else(|| CpuMask::from_cpu(cpu))
+}
+
+/// 与`cpu`共享最后一级缓存的cpu（包括自己）
+pub fn cpu_llc_mask(cpu: ProcessorId) -> CpuMask {
+    cpu_topology(cpu)
+        .map(|t| t.llc_mask.clone())
+        .unwrap_or_else(|| smp_cpu_manager().present_cpus().clone())
+}
+
+/// 与`cpu`位于同一物理封装内的cpu（包括自己）
+pub fn cpu_package_mask(cpu: ProcessorId) -> CpuMask {
+    cpu_topology(cpu)
+        .map(|t| t.package_mask.clone())
+        .unwrap_or_else(|| smp_cpu_manager().present_cpus().clone())
+}
+
+/// `cpu`的拓扑编号
+pub fn cpu_topology_id(cpu: ProcessorId) -> CpuTopologyId {
+    cpu_topology(cpu)
+        .map(|t| t.id)
+        .unwrap_or(CpuTopologyId::flat(cpu))
+}
@@ -1,8 +1,11 @@
 use crate::arch::interrupt::TrapFrame;
 use crate::arch::mm::LockedFrameAllocator;
 use crate::arch::syscall::nr::SYS_SYSINFO;
+use crate::arch::MMArch;
 use crate::mm::allocator::page_frame::FrameAllocator;
 use crate::mm::allocator::slab::slab_usage;
+use crate::mm::swap::swapfile::swap_totals;
+use crate::mm::MemoryManagementArch;
 use crate::process::ProcessManager;
 use crate::syscall::table::FormattedSyscallParam;
 use crate::syscall::table::Syscall;
@@ -105,8 +108,9 @@ fn do_sysinfo(info: *mut PosixSysInfo) -> Result<usize, SystemError> {
     sysinfo.freeram = mem.free().bytes() as u64 + slab_usage.free();
     sysinfo.sharedram = 0;
     sysinfo.bufferram = 0;
-    sysinfo.totalswap = 0;
-    sysinfo.freeswap = 0;
+    let (swap_total, swap_free) = swap_totals();
+    sysinfo.totalswap = (swap_total * MMArch::PAGE_SIZE) as u64;
+    sysinfo.freeswap = (swap_free * MMArch::PAGE_SIZE) as u64;
     sysinfo.procs = ProcessManager::current_pidns().pid_allocated() as u16;
     sysinfo.pad = 0;
     sysinfo.totalhigh = 0;
@@ -0,0 +1,224 @@
+//! 时钟事件设备的单次模式（高精度模式）
+//!
+//! 架构支持单次模式、时钟源连续计数并且没有指定`highres=off`时，每个cpu在下一次时钟中断中
+//! 把本地时钟事件设备切换到单次模式（对标Linux tick_switch_to_oneshot/hrtimer_switch_to_hres）。
+//! 此后周期tick由软件模拟：每次中断之后把设备编程为下一次tick和本cpu最早的hrtimer中较早的一个。
+//! nohz停tick时只需要把下一次tick推后，恢复tick时再拉回来。
+//!
+//! 没有切换的cpu仍然工作在周期模式：nohz停tick时直接把硬件编程为若干个tick之后触发，
+//! hrtimer在每个tick中检查。
+
+use core::sync::atomic::{AtomicBool, AtomicI64, Ordering};
+
+use log::info;
+
+use crate::{
+    arch::{interrupt::ipi::send_ipi, CurrentTimeArch},
+    exception::ipi::{IpiKind, IpiTarget},
+    mm::percpu::PerCpu,
+    smp::{core::smp_get_processor_id, cpu::ProcessorId},
+};
+
+use super::{
+    hrtimer::{hrtimer_next_event_for_clockevents, KTIME_MAX},
+    jiffies::TICK_NESC,
+    tick_sched::tick_nohz_timer_enqueued,
+    timekeep::ktime_t,
+    timekeeping::{ktime_get, timekeeping_valid_for_hres},
+    timer::clock,
+    TimeArch,
+};
+
+kernel_cmdline_param_kv!(HIGHRES_PARAM, highres, "");
+
+/// 一个tick的长度（ns）
+const TICK_NSEC: ktime_t = TICK_NESC as ktime_t;
+/// 编程的最小间隔，避免过近的事件在写入计数器之前就已经过期
+const CLOCKEVENT_MIN_DELTA_NS: ktime_t = 1000;
+/// 模拟tick允许提前的量：时钟事件设备和时钟源之间的频率换算误差可能让中断略早于预定时刻到来
+const TICK_EMULATION_SLACK_NS: ktime_t = TICK_NSEC / 16;
+
+/// 允许切换到高精度模式
+static HRES_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// per-cpu的时钟事件设备状态
+#[derive(Debug)]
+struct TickDevice {
+    /// 设备已经切换到单次模式，tick由软件模拟
+    hres_active: AtomicBool,
+    /// 下一次tick的时刻（单调时钟），停tick之后为唤醒时刻
+    tick_next: AtomicI64,
+    /// 设备当前编程的到期时刻
+    next_event: AtomicI64,
+    /// 别的cpu往本cpu的hrtimer队列上放了更早的定时器，需要本cpu重新编程
+    remote_enqueued: AtomicBool,
+}
+
+impl TickDevice {
+    const fn new() -> Self {
+        Self {
+            hres_active: AtomicBool::new(false),
+            tick_next: AtomicI64::new(KTIME_MAX),
+            next_event: AtomicI64::new(KTIME_MAX),
+            remote_enqueued: AtomicBool::new(false),
+        }
+    }
+}
+
+static TICK_DEVICES: [TickDevice; PerCpu::MAX_CPU_NUM as usize] =
+    [const { TickDevice::new() }; PerCpu::MAX_CPU_NUM as usize];
+
+#[inline]
+fn tick_device(cpu: ProcessorId) -> &'static TickDevice {
+    &TICK_DEVICES[cpu.data() as usize]
+}
+
+/// `cpu`是否工作在高精度模式
+#[inline]
+pub fn tick_hres_active(cpu: ProcessorId) -> bool {
+    tick_device(cpu).hres_active.load(Ordering::Acquire)
+}
+
+/// 允许各cpu切换到高精度模式，在时钟源选定之后调用
+pub fn tick_oneshot_init() {
+    if HIGHRES_PARAM.value_str() == Some("off") {
+        info!("hrtimer: high resolution mode disabled by highres=off");
+        return;
+    }
+    HRES_ENABLED.store(true, Ordering::Release);
+}
+
+/// 时钟中断中调用：尝试把本cpu切换到高精度模式，返回本cpu是否处于高精度模式
+///
+/// 时钟源变得不连续时退回周期模式，否则模拟的tick永远等不到单调时钟前进
+pub fn tick_check_oneshot_change(cpu: ProcessorId) -> bool {
+    let dev = tick_device(cpu);
+    let hres = dev.hres_active.load(Ordering::Relaxed);
+    let valid = HRES_ENABLED.load(Ordering::Relaxed) && timekeeping_valid_for_hres();
+    if hres == valid {
+        return hres;
+    }
+
+    if !valid {
+        dev.hres_active.store(false, Ordering::Release);
+        dev.tick_next.store(KTIME_MAX, Ordering::Relaxed);
+        CurrentTimeArch::clockevent_resume_periodic();
+        info!("hrtimer: cpu {} switched back to periodic mode", cpu.data());
+        return false;
+    }
+
+    let next = ktime_get() + TICK_NSEC;
+    if !CurrentTimeArch::clockevent_program_oneshot(TICK_NSEC as u64) {
+        // 架构不支持单次模式
+        HRES_ENABLED.store(false, Ordering::Relaxed);
+        return false;
+    }
+    dev.tick_next.store(next, Ordering::Relaxed);
+    dev.next_event.store(next, Ordering::Relaxed);
+    dev.hres_active.store(true, Ordering::Release);
+    info!(
+        "hrtimer: cpu {} switched to high resolution mode",
+        cpu.data()
+    );
+    true
+}
+
+/// 高精度模式下判断这次中断是否需要执行tick，需要时推进下一次tick的时刻
+///
+/// nohz启用时jiffies按单调时钟补齐，直接跳到`now`之后的下一个tick；否则每次只推进一个tick，
+/// 中断来晚了会连续补上，保证周期tick推进的jiffies不丢
+pub fn tick_emulation_due(cpu: ProcessorId, now: ktime_t, nohz: bool) -> bool {
+    let dev = tick_device(cpu);
+    let next = dev.tick_next.load(Ordering::Relaxed);
+    if now.saturating_add(TICK_EMULATION_SLACK_NS) < next {
+        return false;
+    }
+
+    let advance = if nohz && now > next {
+        ((now - next) / TICK_NSEC + 1) * TICK_NSEC
+    } else {
+        TICK_NSEC
+    };
+    dev.tick_next
+        .store(next.saturating_add(advance), Ordering::Relaxed);
+    true
+}
+
+/// 把本cpu的时钟事件设备编程为下一次tick和最早的hrtimer中较早的一个（中断已关闭）
+pub fn clockevents_reprogram(cpu: ProcessorId) {
+    let dev = tick_device(cpu);
+    let next = dev
+        .tick_next
+        .load(Ordering::Relaxed)
+        .min(hrtimer_next_event_for_clockevents(cpu));
+    dev.next_event.store(next, Ordering::Relaxed);
+
+    let delta = next
+        .saturating_sub(ktime_get())
+        .max(CLOCKEVENT_MIN_DELTA_NS);
+    CurrentTimeArch::clockevent_program_oneshot(delta as u64);
+}
+
+/// `cpu`的hrtimer队列上来了一个新的最早到期的定时器（中断已关闭）
+///
+/// 高精度模式下比设备编程的时刻更早时重新编程，别的cpu通过IPI通知；
+/// 低精度模式下按jiffies交给nohz判断是否需要叫醒停了tick的cpu
+pub fn clockevents_hrtimer_enqueued(cpu: ProcessorId, expires: ktime_t) {
+    let dev = tick_device(cpu);
+    if dev.hres_active.load(Ordering::Acquire) {
+        if expires >= dev.next_event.load(Ordering::Relaxed) {
+            return;
+        }
+        if cpu == smp_get_processor_id() {
+            clockevents_reprogram(cpu);
+        } else {
+            dev.remote_enqueued.store(true, Ordering::Release);
+            send_ipi(IpiKind::KickCpu, IpiTarget::Specified(cpu));
+        }
+        return;
+    }
+
+    let delta = expires.saturating_sub(ktime_get()).max(0) as u64;
+    tick_nohz_timer_enqueued(cpu, clock() + delta.div_ceil(TICK_NSEC as u64));
+}
+
+/// 被别的cpu踢醒时调用：迁移过来的hrtimer可能比设备编程的时刻更早
+pub fn clockevents_kick_check() {
+    let cpu = smp_get_processor_id();
+    let dev = tick_device(cpu);
+    if dev.remote_enqueued.swap(false, Ordering::AcqRel) && dev.hres_active.load(Ordering::Acquire)
+    {
+        clockevents_reprogram(cpu);
+    }
+}
+
+/// nohz停tick：把本cpu的下一次tick推后`ticks`个tick（中断已关闭）。返回false表示无法停tick
+pub fn tick_program_stop(ticks: u64) -> bool {
+    let delta = ticks.saturating_mul(TICK_NSEC as u64).min(KTIME_MAX as u64);
+    let cpu = smp_get_processor_id();
+    let dev = tick_device(cpu);
+    if dev.hres_active.load(Ordering::Relaxed) {
+        dev.tick_next.store(
+            ktime_get().saturating_add(delta as ktime_t),
+            Ordering::Relaxed,
+        );
+        clockevents_reprogram(cpu);
+        return true;
+    }
+    CurrentTimeArch::clockevent_program_oneshot(delta)
+}
+
+/// nohz恢复本cpu的tick（中断已关闭）
+pub fn tick_program_resume() {
+    let cpu = smp_get_processor_id();
+    let dev = tick_device(cpu);
+    if dev.hres_active.load(Ordering::Relaxed) {
+        let next = ktime_get() + TICK_NSEC;
+        if next < dev.tick_next.load(Ordering::Relaxed) {
+            dev.tick_next.store(next, Ordering::Relaxed);
+            clockevents_reprogram(cpu);
+        }
+        return;
+    }
+    CurrentTimeArch::clockevent_resume_periodic();
+}
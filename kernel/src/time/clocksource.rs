@@ -216,6 +216,18 @@ impl TimerFunction for WatchdogTimerFunc {
     }
 }
 
+/// vDSO在用户态读取时钟源的方式，取值与 arch/x86_64/vdso/vdso.h 保持一致
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u32)]
+pub enum VdsoClockMode {
+    /// 用户态无法读取，退回系统调用
+    None = 0,
+    /// 用户态直接rdtsc
+    Tsc = 1,
+    /// 用户态读取kvm-clock的pvclock页
+    Pvclock = 2,
+}
+
 /// 时钟源的特性
 pub trait Clocksource: Send + Sync + Debug {
     // TODO 返回值类型可能需要改变
@@ -235,6 +247,10 @@ pub trait Clocksource: Send + Sync + Debug {
     fn vread(&self) -> Result<CycleNum, SystemError> {
         return Err(SystemError::ENOSYS);
     }
+    /// vDSO能否在用户态读取该时钟源
+    fn vdso_clock_mode(&self) -> VdsoClockMode {
+        VdsoClockMode::None
+    }
     /// suspend function for the clocksource, if necessary
     fn suspend(&self) -> Result<(), SystemError> {
         return Err(SystemError::ENOSYS);
@@ -0,0 +1,492 @@
+//! 高精度定时器（hrtimer）
+//!
+//! 到期时刻是单调时钟（`ktime_get`）的纳秒数。每个cpu有两棵按到期时刻排序的红黑树，
+//! 对标Linux kernel/time/hrtimer.c：
+//!
+//! - `Hard`模式的定时器在时钟中断中直接执行，回调运行在关中断的上下文中，不能睡眠
+//! - `Soft`模式的定时器在时钟中断中发现到期之后，由`HRTIMER`软中断执行
+//!
+//! 高精度模式下（见`clockevents`）时钟事件设备工作在单次模式，每次编程为下一次tick和
+//! 本cpu最早的定时器中较早的一个。架构不支持单次模式、时钟源不连续或者`highres=off`时，
+//! 定时器在每个tick中检查，精度退化为一个tick。
+//!
+//! 定时器总是挂到启动它的cpu上，cpu下线时迁移到另一个在线cpu。
+
+use core::{
+    fmt::Debug,
+    sync::atomic::{AtomicBool, AtomicI64, AtomicU32, AtomicU64, Ordering},
+};
+
+use alloc::{
+    boxed::Box,
+    sync::{Arc, Weak},
+    vec::Vec,
+};
+use log::info;
+
+use crate::{
+    arch::CurrentIrqArch,
+    exception::{
+        softirq::{softirq_vectors, SoftirqNumber, SoftirqVec},
+        InterruptArch,
+    },
+    libs::{rbtree::RBTree, spinlock::SpinLock},
+    mm::percpu::PerCpu,
+    process::{ProcessControlBlock, ProcessManager},
+    smp::{
+        core::smp_get_processor_id,
+        cpu::{smp_cpu_manager, ProcessorId},
+    },
+};
+
+use super::{
+    clockevents::{clockevents_hrtimer_enqueued, clockevents_reprogram, tick_hres_active},
+    syscall::PosixClockID,
+    timekeep::ktime_t,
+    timekeeping::{ktime_get, ktime_get_real_offset},
+};
+
+/// 定时器不在任何cpu的队列上
+const HRTIMER_NOT_QUEUED: u32 = u32::MAX;
+pub const KTIME_MAX: ktime_t = i64::MAX;
+
+lazy_static! {
+    static ref HRTIMER_BASES: Vec<HrTimerCpuBase> = (0..PerCpu::MAX_CPU_NUM)
+        .map(|_| HrTimerCpuBase::new())
+        .collect();
+}
+
+#[inline]
+fn hrtimer_base(cpu: ProcessorId) -> &'static HrTimerCpuBase {
+    &HRTIMER_BASES[cpu.data() as usize]
+}
+
+/// 定时器回调的执行上下文
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum HrTimerMode {
+    /// 在时钟中断中执行
+    Hard = 0,
+    /// 在HRTIMER软中断中执行
+    Soft = 1,
+}
+
+/// 定时器回调的返回值
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum HrTimerRestart {
+    NoRestart,
+    /// 以给定的到期时刻重新入队（周期定时器），一般由`hrtimer_forward`计算
+    Restart(ktime_t),
+}
+
+/// 高精度定时器要执行的函数的特征
+pub trait HrTimerFunction: Send + Sync + Debug {
+    /// `expires`为这次触发的到期时刻，`now`为处理这一批到期定时器时的单调时钟
+    fn run(&mut self, expires: ktime_t, now: ktime_t) -> HrTimerRestart;
+}
+
+#[derive(Debug)]
+pub struct HrTimer {
+    func: SpinLock<Box<dyn HrTimerFunction>>,
+    mode: HrTimerMode,
+    /// 定时器所在队列的cpu，不在队列上时为`HRTIMER_NOT_QUEUED`
+    cpu: AtomicU32,
+    /// 到期时刻，只在持有所在cpu队列的锁时修改
+    expires: AtomicI64,
+    /// 入队序号，和到期时刻一起组成红黑树的键
+    seq: AtomicU64,
+    /// 每次启动或取消时加一。回调执行期间被取消或者重新启动过的定时器，不再按回调的返回值重新入队
+    generation: AtomicU64,
+    /// 入队时的`generation`
+    queued_generation: AtomicU64,
+    self_ref: Weak<HrTimer>,
+}
+
+impl HrTimer {
+    pub fn new(func: Box<dyn HrTimerFunction>, mode: HrTimerMode) -> Arc<Self> {
+        Arc::new_cyclic(|self_ref| HrTimer {
+            func: SpinLock::new(func),
+            mode,
+            cpu: AtomicU32::new(HRTIMER_NOT_QUEUED),
+            expires: AtomicI64::new(0),
+            seq: AtomicU64::new(0),
+            generation: AtomicU64::new(0),
+            queued_generation: AtomicU64::new(0),
+            self_ref: self_ref.clone(),
+        })
+    }
+
+    /// 在当前cpu上启动定时器，`expires`是单调时钟的绝对时刻。已经启动的定时器按新的时刻重新入队
+    pub fn start(&self, expires: ktime_t) {
+        let self_arc = self.self_ref.upgrade().unwrap();
+        self.generation.fetch_add(1, Ordering::SeqCst);
+
+        // 关中断保证入队和重新编程时钟事件设备都发生在同一个cpu上
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let cpu = smp_get_processor_id();
+        let new_first = loop {
+            // 队列持有的引用不是最后一个，可以直接释放
+            self.detach_queued();
+
+            let mut base = hrtimer_base(cpu).inner.lock();
+            // 抢占所有权，防止并发的start把同一个定时器挂到两个队列上
+            if self
+                .cpu
+                .compare_exchange(
+                    HRTIMER_NOT_QUEUED,
+                    cpu.data(),
+                    Ordering::AcqRel,
+                    Ordering::Relaxed,
+                )
+                .is_err()
+            {
+                continue;
+            }
+            break base.enqueue(self_arc, expires);
+        };
+
+        if new_first {
+            clockevents_hrtimer_enqueued(cpu, expires);
+        }
+        drop(irq_guard);
+    }
+
+    /// 以当前时刻加上`delta_ns`为到期时刻启动定时器
+    pub fn start_relative(&self, delta_ns: ktime_t) {
+        self.start(ktime_get().saturating_add(delta_ns.max(0)));
+    }
+
+    /// 把定时器从所在的队列上摘下来，返回队列持有的引用（需要在锁外释放）
+    fn detach_queued(&self) -> Option<Arc<HrTimer>> {
+        loop {
+            let cpu = self.cpu.load(Ordering::SeqCst);
+            if cpu == HRTIMER_NOT_QUEUED {
+                return None;
+            }
+
+            let mut base = hrtimer_base(ProcessorId::new(cpu)).inner.lock_irqsave();
+            // 加锁期间定时器可能已经到期或者被迁移到别的cpu，重新检查
+            if self.cpu.load(Ordering::Relaxed) != cpu {
+                continue;
+            }
+            return base.detach(self);
+        }
+    }
+
+    /// 取消定时器，返回取消前是否还在队列上
+    ///
+    /// 不等待正在别的cpu上执行的回调，但保证它返回`Restart`时不会再入队。
+    /// 调用者可能持有回调也需要的锁，回调需要自己判断定时器是否已经失效
+    pub fn cancel(&self) -> bool {
+        self.generation.fetch_add(1, Ordering::SeqCst);
+        self.detach_queued().is_some()
+    }
+
+    /// 定时器是否在队列上等待到期
+    #[inline]
+    pub fn is_queued(&self) -> bool {
+        self.cpu.load(Ordering::Acquire) != HRTIMER_NOT_QUEUED
+    }
+
+    /// 最近一次启动时设置的到期时刻
+    #[inline]
+    pub fn expires(&self) -> ktime_t {
+        self.expires.load(Ordering::Acquire)
+    }
+
+    /// 距离到期的剩余时间（ns），不在队列上时为0
+    pub fn remaining(&self) -> ktime_t {
+        if !self.is_queued() {
+            return 0;
+        }
+        (self.expires() - ktime_get()).max(0)
+    }
+}
+
+/// 把`clockid`时钟的绝对时刻换算为单调时钟，不支持的时钟返回None
+///
+/// 墙上时间按当前的偏移换算，之后再修改墙上时间不会影响已经启动的定时器（没有clock_was_set处理）
+pub fn hrtimer_clock_to_ktime(clockid: PosixClockID, time: ktime_t) -> Option<ktime_t> {
+    match clockid {
+        PosixClockID::Realtime => Some(time.saturating_sub(ktime_get_real_offset())),
+        // 系统暂不支持挂起，boottime与monotonic相同
+        PosixClockID::Monotonic | PosixClockID::Boottime => Some(time),
+        _ => None,
+    }
+}
+
+/// 把周期定时器的到期时刻向后推进整数个`interval`，直到晚于`now`，返回推进的周期数
+///
+/// 对标Linux hrtimer_forward，回调据此计算重新入队的时刻，错过的周期记为overrun
+pub fn hrtimer_forward(expires: &mut ktime_t, now: ktime_t, interval: ktime_t) -> u64 {
+    if interval <= 0 || now < *expires {
+        return 0;
+    }
+    let overruns = ((now - *expires) / interval + 1) as u64;
+    *expires = expires.saturating_add(interval.saturating_mul(overruns as i64));
+    overruns
+}
+
+/// per-cpu的定时器队列
+#[derive(Debug)]
+struct HrTimerCpuBase {
+    inner: SpinLock<HrTimerCpuBaseInner>,
+}
+
+#[derive(Debug)]
+struct HrTimerCpuBaseInner {
+    /// 按`HrTimerMode`索引
+    queues: [RBTree<(ktime_t, u64), Arc<HrTimer>>; 2],
+    next_seq: u64,
+    /// 已经触发了HRTIMER软中断但还没有执行，此时软定时器不参与下一次事件的计算
+    soft_pending: bool,
+}
+
+impl HrTimerCpuBase {
+    fn new() -> Self {
+        Self {
+            inner: SpinLock::new(HrTimerCpuBaseInner {
+                queues: [RBTree::new(), RBTree::new()],
+                next_seq: 0,
+                soft_pending: false,
+            }),
+        }
+    }
+}
+
+impl HrTimerCpuBaseInner {
+    /// 入队，返回它是否成为了这个cpu上最早到期的定时器
+    ///
+    /// 调用者已经把`timer.cpu`设置为本cpu
+    fn enqueue(&mut self, timer: Arc<HrTimer>, expires: ktime_t) -> bool {
+        let new_first = expires < self.next_event();
+        let seq = self.next_seq;
+        self.next_seq += 1;
+        timer.expires.store(expires, Ordering::Release);
+        timer.seq.store(seq, Ordering::Relaxed);
+        timer
+            .queued_generation
+            .store(timer.generation.load(Ordering::SeqCst), Ordering::Relaxed);
+        self.queues[timer.mode as usize].insert((expires, seq), timer);
+        new_first
+    }
+
+    fn detach(&mut self, timer: &HrTimer) -> Option<Arc<HrTimer>> {
+        let key = (
+            timer.expires.load(Ordering::Relaxed),
+            timer.seq.load(Ordering::Relaxed),
+        );
+        let r = self.queues[timer.mode as usize].remove(&key);
+        timer.cpu.store(HRTIMER_NOT_QUEUED, Ordering::Release);
+        r
+    }
+
+    #[inline]
+    fn first_expires(&self, mode: HrTimerMode) -> Option<ktime_t> {
+        self.queues[mode as usize]
+            .get_first()
+            .map(|(&(expires, _), _)| expires)
+    }
+
+    /// 下一个需要时钟中断处理的到期时刻，没有定时器时为`KTIME_MAX`
+    fn next_event(&self) -> ktime_t {
+        let hard = self.first_expires(HrTimerMode::Hard).unwrap_or(KTIME_MAX);
+        if self.soft_pending {
+            return hard;
+        }
+        hard.min(self.first_expires(HrTimerMode::Soft).unwrap_or(KTIME_MAX))
+    }
+
+    fn take_all(&mut self) -> Vec<Arc<HrTimer>> {
+        let mut timers = Vec::new();
+        for queue in self.queues.iter_mut() {
+            while let Some((_, timer)) = queue.pop_first() {
+                timer.cpu.store(HRTIMER_NOT_QUEUED, Ordering::Release);
+                timers.push(timer);
+            }
+        }
+        timers
+    }
+}
+
+/// 执行本cpu上`mode`队列中到期的定时器
+///
+/// 每个回调在锁外执行，回调中可以启动或取消任何定时器（包括自己）
+fn hrtimer_run_queue(cpu: ProcessorId, mode: HrTimerMode, now: ktime_t) {
+    let base = hrtimer_base(cpu);
+    let mut guard = base.inner.lock_irqsave();
+    loop {
+        match guard.first_expires(mode) {
+            Some(expires) if expires <= now => {}
+            _ => break,
+        }
+        let ((expires, _), timer) = guard.queues[mode as usize].pop_first().unwrap();
+        let generation = timer.queued_generation.load(Ordering::Relaxed);
+        timer.cpu.store(HRTIMER_NOT_QUEUED, Ordering::Release);
+        drop(guard);
+
+        let restart = timer.func.lock_irqsave().run(expires, now);
+        let HrTimerRestart::Restart(expires) = restart else {
+            // 可能是最后一个引用，在锁外释放
+            drop(timer);
+            guard = base.inner.lock_irqsave();
+            continue;
+        };
+
+        guard = base.inner.lock_irqsave();
+        // 先抢占所有权再检查代数，与cancel中先加代数再检查所有权配对：
+        // 回调执行期间定时器被取消或者被别处重新启动过时，以别处的操作为准
+        if timer
+            .cpu
+            .compare_exchange(
+                HRTIMER_NOT_QUEUED,
+                cpu.data(),
+                Ordering::SeqCst,
+                Ordering::Relaxed,
+            )
+            .is_ok()
+        {
+            if timer.generation.load(Ordering::SeqCst) == generation {
+                guard.enqueue(timer, expires);
+            } else {
+                timer.cpu.store(HRTIMER_NOT_QUEUED, Ordering::Release);
+            }
+        }
+    }
+}
+
+/// 时钟中断中调用（中断已关闭）：执行到期的硬定时器，有到期的软定时器时触发HRTIMER软中断
+pub fn hrtimer_interrupt(cpu: ProcessorId, now: ktime_t) {
+    hrtimer_run_queue(cpu, HrTimerMode::Hard, now);
+
+    let mut base = hrtimer_base(cpu).inner.lock();
+    if !base.soft_pending
+        && base
+            .first_expires(HrTimerMode::Soft)
+            .is_some_and(|expires| expires <= now)
+    {
+        base.soft_pending = true;
+        drop(base);
+        softirq_vectors().raise_softirq(SoftirqNumber::HRTIMER);
+    }
+}
+
+/// 低精度模式下由每个tick调用
+pub fn hrtimer_run_queues(cpu: ProcessorId) {
+    // 队列为空时不读时钟源
+    if hrtimer_base(cpu).inner.lock_irqsave().next_event() == KTIME_MAX {
+        return;
+    }
+    hrtimer_interrupt(cpu, ktime_get());
+}
+
+/// 获取`cpu`上最早的到期时刻（包括软定时器），队列为空时返回None
+pub fn hrtimer_get_next_event(cpu: ProcessorId) -> Option<ktime_t> {
+    let base = hrtimer_base(cpu).inner.lock_irqsave();
+    let hard = base.first_expires(HrTimerMode::Hard);
+    let soft = base.first_expires(HrTimerMode::Soft);
+    match (hard, soft) {
+        (Some(h), Some(s)) => Some(h.min(s)),
+        (h, s) => h.or(s),
+    }
+}
+
+/// 获取需要时钟中断处理的下一个到期时刻，已经交给软中断的软定时器不计入
+pub(super) fn hrtimer_next_event_for_clockevents(cpu: ProcessorId) -> ktime_t {
+    hrtimer_base(cpu).inner.lock_irqsave().next_event()
+}
+
+#[derive(Debug)]
+struct HrTimerSoftirq;
+
+impl SoftirqVec for HrTimerSoftirq {
+    fn run(&self) {
+        let cpu = smp_get_processor_id();
+        hrtimer_run_queue(cpu, HrTimerMode::Soft, ktime_get());
+
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        hrtimer_base(cpu).inner.lock().soft_pending = false;
+        // 剩下的软定时器重新参与时钟事件设备的编程
+        if tick_hres_active(cpu) {
+            clockevents_reprogram(cpu);
+        }
+        drop(irq_guard);
+    }
+}
+
+/// cpu下线时把它队列上的定时器迁移到另一个在线cpu
+pub fn hrtimer_migrate_cpu(dead: ProcessorId) {
+    let cpu_manager = smp_cpu_manager();
+    let Some(target) = cpu_manager
+        .present_cpus()
+        .iter_cpu()
+        .find(|&cpu| cpu != dead && cpu_manager.is_online_cpu(cpu))
+    else {
+        return;
+    };
+
+    let timers = hrtimer_base(dead).inner.lock_irqsave().take_all();
+    if timers.is_empty() {
+        return;
+    }
+    let nr_timers = timers.len();
+    let mut new_first = false;
+    let next_event = {
+        let mut new_base = hrtimer_base(target).inner.lock_irqsave();
+        for timer in timers {
+            if timer
+                .cpu
+                .compare_exchange(
+                    HRTIMER_NOT_QUEUED,
+                    target.data(),
+                    Ordering::AcqRel,
+                    Ordering::Relaxed,
+                )
+                .is_ok()
+            {
+                let expires = timer.expires();
+                new_first |= new_base.enqueue(timer, expires);
+            }
+        }
+        new_base.next_event()
+    };
+
+    info!(
+        "hrtimer: migrated {} timer(s) from cpu {} to cpu {}",
+        nr_timers,
+        dead.data(),
+        target.data()
+    );
+    if new_first {
+        clockevents_hrtimer_enqueued(target, next_event);
+    }
+}
+
+/// 唤醒睡眠进程的定时器函数
+#[derive(Debug)]
+pub struct HrTimerWakeUp {
+    pcb: Arc<ProcessControlBlock>,
+    expired: Arc<AtomicBool>,
+}
+
+impl HrTimerWakeUp {
+    pub fn new(pcb: Arc<ProcessControlBlock>, expired: Arc<AtomicBool>) -> Box<Self> {
+        Box::new(Self { pcb, expired })
+    }
+}
+
+impl HrTimerFunction for HrTimerWakeUp {
+    fn run(&mut self, _expires: ktime_t, _now: ktime_t) -> HrTimerRestart {
+        self.expired.store(true, Ordering::SeqCst);
+        ProcessManager::wakeup(&self.pcb).ok();
+        HrTimerRestart::NoRestart
+    }
+}
+
+/// 初始化高精度定时器
+#[inline(never)]
+pub fn hrtimer_init() {
+    softirq_vectors()
+        .register_softirq(SoftirqNumber::HRTIMER, Arc::new(HrTimerSoftirq))
+        .expect("Failed to register hrtimer softirq");
+    info!("hrtimer initialized successfully");
+}
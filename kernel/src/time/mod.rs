@@ -9,15 +9,19 @@ use crate::time::syscall::PosixTimeval;
 
 use self::timekeeping::getnstimeofday;
 
+pub mod clockevents;
 pub mod clocksource;
+pub mod hrtimer;
 pub mod jiffies;
 pub mod sleep;
 pub mod syscall;
 pub mod tick_common;
+pub mod tick_sched;
 pub mod timeconv;
 pub mod timekeep;
 pub mod timekeeping;
 pub mod timer;
+pub mod vsyscall;
 
 /* Time structures. (Partitially taken from smoltcp)
 
@@ -585,6 +589,16 @@ pub trait TimeArch {
 
     /// 将CPU的时钟周期数转换为纳秒
     fn cycles2ns(cycles: usize) -> usize;
+
+    /// 把本cpu的时钟事件设备切换到单次模式，编程为`ns`纳秒之后触发一次
+    ///
+    /// 超出硬件计数范围时由架构自行截断。返回false表示该架构不支持单次模式
+    fn clockevent_program_oneshot(_ns: u64) -> bool {
+        false
+    }
+
+    /// 把本cpu的时钟事件设备恢复为周期模式
+    fn clockevent_resume_periodic() {}
 }
 
 /// 获取系统运行时间（秒）
@@ -1,21 +1,36 @@
-use core::hint::spin_loop;
+use core::{
+    hint::spin_loop,
+    sync::atomic::{AtomicBool, Ordering},
+};
 
-use alloc::{boxed::Box, sync::Arc};
+use alloc::sync::Arc;
 use system_error::SystemError;
 
 use crate::{
     arch::{CurrentIrqArch, CurrentTimeArch},
     exception::InterruptArch,
-    process::ProcessManager,
+    process::{ProcessFlags, ProcessManager, ProcessState},
     sched::{schedule, SchedMode},
-    time::timekeeping::getnstimeofday,
+    smp::core::smp_get_processor_id,
 };
 
 use super::{
-    timer::{next_n_us_timer_jiffies, Timer, WakeUpHelper},
-    PosixTimeSpec, TimeArch,
+    clockevents::tick_hres_active,
+    hrtimer::{hrtimer_clock_to_ktime, HrTimer, HrTimerMode, HrTimerWakeUp},
+    syscall::PosixClockID,
+    timekeep::ktime_t,
+    timekeeping::ktime_get,
+    PosixTimeSpec, TimeArch, NSEC_PER_SEC,
 };
 
+/// 把合法的timespec换算为纳秒，超出范围时饱和
+#[inline]
+pub fn timespec_to_ktime(ts: &PosixTimeSpec) -> ktime_t {
+    ts.tv_sec
+        .saturating_mul(NSEC_PER_SEC as i64)
+        .saturating_add(ts.tv_nsec)
+}
+
 /// @brief 休眠指定时间（单位：纳秒）
 ///
 /// @param sleep_time 指定休眠的时间
@@ -27,8 +42,11 @@ pub fn nanosleep(sleep_time: PosixTimeSpec) -> Result<PosixTimeSpec, SystemError
     if sleep_time.tv_nsec < 0 || sleep_time.tv_nsec >= 1000000000 {
         return Err(SystemError::EINVAL);
     }
-    // 对于小于500us的时间，使用spin/rdtsc来进行定时
-    if sleep_time.tv_nsec < 500000 && sleep_time.tv_sec == 0 {
+    // 低精度模式下定时器的粒度是一个tick，对于小于500us的时间，使用spin/rdtsc来进行定时
+    if sleep_time.tv_nsec < 500000
+        && sleep_time.tv_sec == 0
+        && !tick_hres_active(smp_get_processor_id())
+    {
         let expired_tsc: usize = CurrentTimeArch::cal_expire_cycles(sleep_time.tv_nsec as usize);
         while CurrentTimeArch::get_cycles() < expired_tsc {
             spin_loop()
@@ -39,40 +57,63 @@ pub fn nanosleep(sleep_time: PosixTimeSpec) -> Result<PosixTimeSpec, SystemError
         });
     }
 
-    let total_sleep_time_us: u64 =
-        sleep_time.tv_sec as u64 * 1000000 + sleep_time.tv_nsec as u64 / 1000;
-    // 创建定时器
-    let handler: Box<WakeUpHelper> = WakeUpHelper::new(ProcessManager::current_pcb());
-    let timer: Arc<Timer> = Timer::new(handler, next_n_us_timer_jiffies(total_sleep_time_us));
+    let deadline = ktime_get().saturating_add(timespec_to_ktime(&sleep_time));
+    hrtimer_sleep_until(deadline)?;
 
-    let start_time = getnstimeofday();
-    timer.activate();
+    let remaining = deadline.saturating_sub(ktime_get()).max(0);
+    Ok(PosixTimeSpec::from_ns(remaining as u64))
+}
+
+/// 睡眠到`clockid`时钟的绝对时刻`deadline`
+pub fn clock_nanosleep_until(
+    clockid: PosixClockID,
+    deadline: &PosixTimeSpec,
+) -> Result<(), SystemError> {
+    let deadline =
+        hrtimer_clock_to_ktime(clockid, timespec_to_ktime(deadline)).ok_or(SystemError::EINVAL)?;
+    if deadline <= ktime_get() {
+        return Ok(());
+    }
+    hrtimer_sleep_until(deadline)
+}
+
+/// 睡眠到单调时钟`deadline`（纳秒）
+///
+/// Linux 语义：等待可能出现伪唤醒；只有在收到未被屏蔽的信号时才中断，返回ERESTARTSYS。
+/// 对于 job-control stop/continue 这类不应直接对用户态暴露的唤醒，应继续等待直到到期。
+pub fn hrtimer_sleep_until(deadline: ktime_t) -> Result<(), SystemError> {
+    let pcb = ProcessManager::current_pcb();
+    let expired = Arc::new(AtomicBool::new(false));
+    let timer = HrTimer::new(
+        HrTimerWakeUp::new(pcb.clone(), expired.clone()),
+        HrTimerMode::Hard,
+    );
+    timer.start(deadline);
 
-    // Linux 语义：等待可能出现伪唤醒；只有在收到未被屏蔽的信号时才中断。
-    // 对于 job-control stop/continue 这类不应直接对用户态暴露的唤醒，应继续等待直到到期。
     loop {
-        let irq_guard: crate::exception::IrqFlagsGuard =
-            unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
         ProcessManager::mark_sleep(true).ok();
+        // 定时器可能在别的cpu上（迁移之后）先于mark_sleep到期，此时唤醒已经丢失
+        if expired.load(Ordering::SeqCst) {
+            if pcb.sched_info().state().is_blocked() {
+                pcb.sched_info().set_state(ProcessState::Runnable);
+            }
+            pcb.flags().remove(ProcessFlags::NEED_SCHEDULE);
+            drop(irq_guard);
+            return Ok(());
+        }
         drop(irq_guard);
         schedule(SchedMode::SM_NONE);
 
-        if timer.timeout() {
-            break;
+        if expired.load(Ordering::SeqCst) {
+            return Ok(());
         }
 
         // 未到期而被唤醒：若存在未屏蔽待处理信号，则视为被信号打断；否则认为是伪唤醒，继续等待。
-        let current_pcb = ProcessManager::current_pcb();
-        let has_real_signal =
-            current_pcb.has_pending_signal_fast() && current_pcb.has_pending_not_masked_signal();
+        let has_real_signal = pcb.has_pending_signal_fast() && pcb.has_pending_not_masked_signal();
         if has_real_signal {
             timer.cancel();
             return Err(SystemError::ERESTARTSYS);
         }
     }
-
-    let end_time = getnstimeofday();
-    let real_sleep_time = end_time - start_time;
-    let rm_time: PosixTimeSpec = (sleep_time - real_sleep_time.into()).into();
-    Ok(rm_time)
 }
@@ -1,20 +1,20 @@
 use crate::process::ProcessManager;
-use crate::time::timekeeping::getnstimeofday;
+use crate::time::timekeeping::{getnstimeofday, ktime_get};
 use crate::time::PosixTimeSpec;
 
 use super::{PosixClockID, CPUCLOCK_PERTHREAD_MASK};
 
 pub(crate) fn posix_clock_now(clock_id: PosixClockID) -> PosixTimeSpec {
     match clock_id {
-        PosixClockID::Realtime => getnstimeofday(),
-        // 单调/boottime/raw/coarse/alarm 等目前仍复用 realtime（后续可补齐真正语义）。
+        PosixClockID::Realtime | PosixClockID::RealtimeCoarse | PosixClockID::RealtimeAlarm => {
+            getnstimeofday()
+        }
+        // 单调时钟不受settimeofday影响；系统暂不支持挂起，boottime与monotonic相同。
         PosixClockID::Monotonic
         | PosixClockID::Boottime
         | PosixClockID::MonotonicRaw
-        | PosixClockID::RealtimeCoarse
         | PosixClockID::MonotonicCoarse
-        | PosixClockID::RealtimeAlarm
-        | PosixClockID::BoottimeAlarm => getnstimeofday(),
+        | PosixClockID::BoottimeAlarm => PosixTimeSpec::from_ns(ktime_get().max(0) as u64),
 
         PosixClockID::ProcessCPUTimeID => {
             let pcb = ProcessManager::current_pcb();
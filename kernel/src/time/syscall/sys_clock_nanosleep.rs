@@ -4,12 +4,11 @@ use crate::ipc::signal::{RestartBlock, RestartBlockData};
 use crate::process::ProcessManager;
 use crate::syscall::table::{FormattedSyscallParam, Syscall};
 use crate::syscall::user_access::{UserBufferReader, UserBufferWriter};
-use crate::time::timekeeping::getnstimeofday;
-use crate::time::{sleep::nanosleep, PosixTimeSpec};
+use crate::time::{sleep::clock_nanosleep_until, PosixTimeSpec};
 use alloc::vec::Vec;
 use system_error::SystemError;
 
-use super::{PosixClockID, PosixClockID::*};
+use super::{posix_clock_now, PosixClockID, PosixClockID::*};
 
 pub struct SysClockNanosleep;
 
@@ -27,26 +26,6 @@ impl SysClockNanosleep {
         args[3] as *mut PosixTimeSpec
     }
 
-    #[inline]
-    fn ktime_now(clockid: PosixClockID) -> PosixTimeSpec {
-        // 暂时使用 realtime 近似；后续区分 monotonic/boottime
-        // - Realtime：使用 getnstimeofday()
-        // - Monotonic/Boottime：暂与 Realtime 等价（后续引入真正单调/启动时钟）
-        match clockid {
-            Realtime => getnstimeofday(),
-            Monotonic | Boottime => getnstimeofday(),
-            ProcessCPUTimeID => {
-                let pcb = ProcessManager::current_pcb();
-                PosixTimeSpec::from_ns(pcb.process_cputime_ns())
-            }
-            ThreadCPUTimeID => {
-                let pcb = ProcessManager::current_pcb();
-                PosixTimeSpec::from_ns(pcb.thread_cputime_ns())
-            }
-            _ => getnstimeofday(),
-        }
-    }
-
     #[inline]
     fn is_valid_timespec(ts: &PosixTimeSpec) -> bool {
         ts.tv_sec >= 0 && ts.tv_nsec >= 0 && ts.tv_nsec < 1_000_000_000
@@ -123,14 +102,8 @@ impl SysClockNanosleep {
                 )?;
                 Ok(())
             }
-            _ => {
-                let now = Self::ktime_now(clockid);
-                let remain = Self::calc_remaining(deadline, &now);
-                if remain.tv_sec == 0 && remain.tv_nsec == 0 {
-                    return Ok(());
-                }
-                nanosleep(remain).map(|_| ())
-            }
+            // 墙上时钟和单调时钟的睡眠由hrtimer在到期时刻精确唤醒
+            _ => clock_nanosleep_until(clockid, deadline),
         }
     }
 }
@@ -183,13 +156,13 @@ impl Syscall for SysClockNanosleep {
                 tv_nsec: rq.tv_nsec,
             }
         } else {
-            let now = Self::ktime_now(clockid);
+            let now = posix_clock_now(clockid);
             Self::add_timespec(&now, &rq)
         };
 
         // 立即到期检查（ABS）
         if is_abstime {
-            let now = Self::ktime_now(clockid);
+            let now = posix_clock_now(clockid);
             let remain = Self::calc_remaining(&deadline, &now);
             if remain.tv_sec == 0 && remain.tv_nsec == 0 {
                 return Ok(0);
@@ -216,7 +189,7 @@ impl Syscall for SysClockNanosleep {
                 } else {
                     // 相对睡眠：写回剩余时间，并设置restart block
                     if let Some(ref mut w) = rmtp_writer {
-                        let now = Self::ktime_now(clockid);
+                        let now = posix_clock_now(clockid);
                         let remain = Self::calc_remaining(&deadline, &now);
                         // log::debug!(
                         //     "clock_nanosleep: REL interrupted -> write rem {{sec={}, nsec={}}}",
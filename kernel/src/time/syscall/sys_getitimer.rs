@@ -5,15 +5,14 @@ use crate::{
         table::{FormattedSyscallParam, Syscall},
         user_access::UserBufferWriter,
     },
-    time::{
-        syscall::{ItimerType, Itimerval, PosixSusecondsT, PosixTimeT, PosixTimeval},
-        timer::{self, Jiffies},
-    },
+    time::syscall::{ItimerType, Itimerval, PosixTimeval},
 };
 use alloc::vec::Vec;
 use core::mem::size_of;
 use system_error::SystemError;
 
+use super::sys_setitimer::itimer_real_remaining;
+
 pub struct SysGetitimerHandle;
 
 impl SysGetitimerHandle {
@@ -44,16 +43,7 @@ impl Syscall for SysGetitimerHandle {
                 // 读取真实时间定时器
                 if let Some(current_itimer) = itimers.real.as_ref() {
                     itv.it_interval = current_itimer.config.it_interval;
-                    let now = timer::clock();
-                    let expires = current_itimer.timer.inner().expire_jiffies;
-
-                    if expires > now {
-                        let remaining_jiffies = Jiffies::new(expires - now);
-                        let remaining_duration = core::time::Duration::from(remaining_jiffies);
-                        itv.it_value.tv_sec = remaining_duration.as_secs() as PosixTimeT;
-                        itv.it_value.tv_usec =
-                            remaining_duration.subsec_micros() as PosixSusecondsT;
-                    }
+                    itv.it_value = itimer_real_remaining(&current_itimer.timer);
                 }
             }
             ItimerType::Virtual => {
@@ -7,8 +7,9 @@ use crate::{
         user_access::{UserBufferReader, UserBufferWriter},
     },
     time::{
+        hrtimer::{hrtimer_forward, HrTimer, HrTimerFunction, HrTimerMode, HrTimerRestart},
         syscall::{ItimerType, Itimerval, PosixTimeval},
-        timer::{self, Jiffies, Timer, TimerFunction},
+        timekeep::ktime_t,
     },
 };
 use alloc::{
@@ -16,7 +17,7 @@ use alloc::{
     sync::{Arc, Weak},
     vec::Vec,
 };
-use core::{mem::size_of, time::Duration};
+use core::mem::size_of;
 use system_error::SystemError;
 
 impl ItimerType {
@@ -27,14 +28,7 @@ impl ItimerType {
                 let mut old_itv = Itimerval::default();
                 if let Some(current_itimer) = itimers.real.as_ref() {
                     old_itv.it_interval = current_itimer.config.it_interval;
-                    let now = timer::clock();
-                    let expires = current_itimer.timer.inner().expire_jiffies;
-                    if expires > now {
-                        let remaining_jiffies = Jiffies::new(expires - now);
-                        let remaining_duration = Duration::from(remaining_jiffies);
-                        old_itv.it_value.tv_sec = remaining_duration.as_secs() as i64;
-                        old_itv.it_value.tv_usec = remaining_duration.subsec_micros() as i32;
-                    }
+                    old_itv.it_value = itimer_real_remaining(&current_itimer.timer);
                 }
                 old_itv
             }
@@ -70,15 +64,9 @@ impl ItimerType {
                 }
                 // 如果 it_value 非零，创建并激活新的真实时间定时器
                 if new_config.it_value.tv_sec > 0 || new_config.it_value.tv_usec > 0 {
-                    let value_duration = Duration::new(
-                        new_config.it_value.tv_sec as u64,
-                        new_config.it_value.tv_usec as u32 * 1000,
-                    );
-                    let expire_jiffies =
-                        timer::clock() + <Jiffies as From<Duration>>::from(value_duration).data();
-                    let helper = ItimerHelper::new(pcb, ItimerType::Real, new_config.it_interval);
-                    let new_timer = Timer::new(helper, expire_jiffies);
-                    new_timer.activate();
+                    let helper = ItimerHelper::new(pcb, new_config.it_interval);
+                    let new_timer = HrTimer::new(helper, HrTimerMode::Soft);
+                    new_timer.start_relative(new_config.it_value.to_ns() as ktime_t);
 
                     // 将新的定时器放回 itimers
                     itimers.real = Some(crate::process::ProcessItimer {
@@ -109,32 +97,37 @@ impl ItimerType {
     }
 }
 
+/// ITIMER_REAL的剩余时间，已经到期的一次性定时器为0
+pub(super) fn itimer_real_remaining(timer: &HrTimer) -> PosixTimeval {
+    let remaining = timer.remaining();
+    if remaining <= 0 {
+        return PosixTimeval::default();
+    }
+    // 不足1us的剩余时间向上取整，避免把未到期的定时器报告为已解除
+    PosixTimeval::from_ns((remaining as u64).div_ceil(1000) * 1000)
+}
+
+/// ITIMER_REAL到期时向线程组发送SIGALRM，周期定时器在软中断中直接推后重新入队
 #[derive(Debug)]
 struct ItimerHelper {
     target_pcb: Weak<ProcessControlBlock>,
-    which: ItimerType,
-    interval: PosixTimeval,
+    interval: ktime_t,
 }
 
 impl ItimerHelper {
-    fn new(
-        target_pcb: Arc<ProcessControlBlock>,
-        which: ItimerType,
-        interval: PosixTimeval,
-    ) -> Box<Self> {
+    fn new(target_pcb: Arc<ProcessControlBlock>, interval: PosixTimeval) -> Box<Self> {
         Box::new(Self {
             target_pcb: Arc::downgrade(&target_pcb),
-            which,
-            interval,
+            interval: interval.to_ns() as ktime_t,
         })
     }
 }
 
-impl TimerFunction for ItimerHelper {
-    fn run(&mut self) -> Result<(), SystemError> {
+impl HrTimerFunction for ItimerHelper {
+    fn run(&mut self, expires: ktime_t, now: ktime_t) -> HrTimerRestart {
         let pcb = match self.target_pcb.upgrade() {
             Some(pcb) => pcb,
-            None => return Ok(()), // 进程已退出
+            None => return HrTimerRestart::NoRestart, // 进程已退出
         };
 
         // 根据Linux行为，ITIMER_REAL (SIGALRM) 优先发送给线程组的leader。
@@ -145,34 +138,13 @@ impl TimerFunction for ItimerHelper {
             let _ = send_signal_to_pid(pcb.raw_pid(), Signal::SIGALRM);
         }
 
-        // 周期性定时器，则重新启动定时器
-        if self.interval.tv_sec > 0 || self.interval.tv_usec > 0 {
-            let interval_duration = Duration::new(
-                self.interval.tv_sec as u64,
-                self.interval.tv_usec as u32 * 1000,
-            );
-            let expire_jiffies =
-                timer::clock() + <Jiffies as From<Duration>>::from(interval_duration).data();
-
-            let next_helper = ItimerHelper::new(pcb.clone(), self.which, self.interval);
-            let next_timer = Timer::new(next_helper, expire_jiffies);
-            next_timer.activate();
-
-            let mut itimers = pcb.itimers_irqsave();
-            let new_itimer = crate::process::ProcessItimer {
-                timer: next_timer,
-                config: Itimerval {
-                    it_interval: self.interval,
-                    it_value: self.interval, // 下一次的值就是间隔
-                },
-            };
-            itimers.real = Some(new_itimer);
-        } else {
-            // 一次性定时器，从 PCB 中清除
-            let mut itimers = pcb.itimers_irqsave();
-            itimers.real = None;
+        // 周期性定时器，则重新启动定时器。错过的周期合并为一次信号，与Linux相同
+        if self.interval > 0 {
+            let mut expires = expires;
+            hrtimer_forward(&mut expires, now, self.interval);
+            return HrTimerRestart::Restart(expires);
         }
-        Ok(())
+        HrTimerRestart::NoRestart
     }
 }
 
@@ -12,6 +12,9 @@ use core::mem::size_of;
 use syscall_table_macros::declare_syscall;
 use system_error::SystemError;
 
+/// it_value 是定时器所用时钟的绝对时刻
+const TIMER_ABSTIME: i32 = 1;
+
 pub struct SysTimerSettimeHandle;
 
 impl SysTimerSettimeHandle {
@@ -40,8 +43,7 @@ impl Syscall for SysTimerSettimeHandle {
         let new_value_ptr = Self::new_value(args);
         let old_value_ptr = Self::old_value(args);
 
-        // 暂不支持 TIMER_ABSTIME 等 flag
-        if flags != 0 {
+        if flags & !TIMER_ABSTIME != 0 {
             return Err(SystemError::EINVAL);
         }
         if new_value_ptr.is_null() {
@@ -53,9 +55,12 @@ impl Syscall for SysTimerSettimeHandle {
         let new_value = reader.buffer_protected(0)?.read_one::<PosixItimerspec>(0)?;
 
         let pcb = ProcessManager::current_pcb();
-        let old = pcb
-            .posix_timers_irqsave()
-            .settime(&pcb, timerid, new_value)?;
+        let old = pcb.posix_timers_irqsave().settime(
+            &pcb,
+            timerid,
+            new_value,
+            flags & TIMER_ABSTIME != 0,
+        )?;
 
         if !old_value_ptr.is_null() {
             let mut writer =
@@ -6,13 +6,41 @@ use crate::{
     time::timer::run_local_timer,
 };
 
-use super::timer::{clock, update_timer_jiffies};
+use super::{
+    clockevents::{clockevents_reprogram, tick_check_oneshot_change, tick_emulation_due},
+    hrtimer::{hrtimer_interrupt, hrtimer_run_queues},
+    tick_sched::{tick_nohz_active, tick_sched_handle},
+    timekeeping::ktime_get,
+    timer::{clock, update_timer_jiffies},
+};
 
 /// # 函数的功能
 /// 用于周期滴答的事件处理
+///
+/// 高精度模式下每次中断先执行到期的hrtimer，到了模拟tick的时刻才执行tick，
+/// 最后把时钟事件设备编程为下一个事件
 pub fn tick_handle_periodic(trap_frame: &TrapFrame) {
     let cpu_id = smp_get_processor_id();
 
+    if tick_check_oneshot_change(cpu_id) {
+        let now = ktime_get();
+        hrtimer_interrupt(cpu_id, now);
+        if tick_emulation_due(cpu_id, now, tick_nohz_active()) {
+            tick_handle(cpu_id, trap_frame);
+        }
+        clockevents_reprogram(cpu_id);
+        return;
+    }
+
+    hrtimer_run_queues(cpu_id);
+    tick_handle(cpu_id, trap_frame);
+}
+
+fn tick_handle(cpu_id: ProcessorId, trap_frame: &TrapFrame) {
+    if tick_nohz_active() {
+        tick_sched_handle(cpu_id, trap_frame);
+        return;
+    }
     tick_periodic(cpu_id, trap_frame);
 }
 
@@ -20,8 +48,9 @@ fn tick_periodic(cpu_id: ProcessorId, trap_frame: &TrapFrame) {
     if cpu_id.data() == 0 {
         update_timer_jiffies(1);
         loadavg::calc_global_load(clock());
-        run_local_timer();
     }
+    // 每个cpu处理自己时间轮上的定时器
+    run_local_timer();
 
-    ProcessManager::update_process_times(trap_frame.is_from_user());
+    ProcessManager::update_process_times(trap_frame.is_from_user(), 1);
 }
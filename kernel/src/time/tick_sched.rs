@@ -0,0 +1,498 @@
+//! 无tick（NO_HZ）支持
+//!
+//! - 空闲cpu进入idle时停止周期tick，把本cpu的时钟事件设备编程为下一个需要醒来的时刻
+//! - `nohz_full=`指定的cpu在只运行一个任务时也停止tick，只保留每秒一次的残余tick
+//!
+//! 停tick之后jiffies不再由固定的cpu推进：任何cpu在处理tick或者从停tick状态进入中断时，
+//! 都根据单调时钟把jiffies补齐。负载统计由持有do_timer职责的cpu处理，该cpu在idle中停tick时
+//! 放弃职责，但最多睡眠一秒，保证时间维护不会中断太久。
+//!
+//! 定时器挂在各cpu自己的时间轮上，每个cpu停tick时把唤醒时刻限制在本地时间轮最早的到期时刻之前。
+//! 高精度模式下停tick只是推后软件模拟的tick，hrtimer照常编程时钟事件设备；低精度模式下
+//! hrtimer在tick中检查，唤醒时刻还要限制在最早的hrtimer之前。
+//!
+//! 停tick期间跳过的tick在tick恢复、任务切换或者下一次tick到来时一次性记账到cputime。
+
+use core::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering};
+
+use alloc::sync::Arc;
+use log::{info, warn};
+
+use crate::{
+    arch::{interrupt::ipi::send_ipi, interrupt::TrapFrame, CurrentIrqArch},
+    exception::{
+        ipi::{IpiKind, IpiTarget},
+        InterruptArch,
+    },
+    libs::{cpumask::CpuMask, spinlock::SpinLock},
+    mm::percpu::PerCpu,
+    process::{ProcessControlBlock, ProcessFlags, ProcessManager},
+    sched::{clock::SchedClock, cputime::CpuTimeFunc, loadavg, sched_can_stop_tick, SchedPolicy},
+    smp::{
+        core::smp_get_processor_id,
+        cpu::{smp_cpu_manager, ProcessorId},
+    },
+};
+
+use super::{
+    clockevents::{tick_hres_active, tick_program_resume, tick_program_stop},
+    clocksource::HZ,
+    hrtimer::hrtimer_get_next_event,
+    jiffies::TICK_NESC,
+    timekeeping::ktime_get,
+    timer::{clock, run_local_timer, timer_get_next_expire, update_timer_jiffies},
+};
+
+kernel_cmdline_param_kv!(NOHZ_PARAM, nohz, "");
+kernel_cmdline_param_kv!(NOHZ_FULL_PARAM, nohz_full, "");
+
+/// 没有cpu持有do_timer职责
+const TICK_DO_TIMER_NONE: u32 = u32::MAX;
+/// nohz_full cpu停tick之后保留的残余tick间隔
+const NOHZ_FULL_MAX_DEFER_TICKS: u64 = HZ;
+/// 负责全局定时器的cpu在idle中最长的睡眠时间，避免时钟源在两次更新墙上时间之间回绕
+const NOHZ_TIMEKEEPING_MAX_DEFER_TICKS: u64 = HZ;
+
+static NOHZ_ACTIVE: AtomicBool = AtomicBool::new(false);
+/// 是否存在nohz_full cpu，用于让RCU等热路径快速跳过检查
+static NOHZ_FULL_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// 负责推进jiffies之外的全局工作（负载统计）的cpu
+static TICK_DO_TIMER_CPU: AtomicU32 = AtomicU32::new(0);
+/// 最后一个放弃do_timer职责的cpu，没有cpu持有职责时由它定期醒来维护时间
+static TICK_DO_TIMER_LAST: AtomicU32 = AtomicU32::new(0);
+
+/// 上一次推进jiffies时对应的单调时钟（ns），无锁读取作为快速路径
+static LAST_JIFFIES_UPDATE: AtomicU64 = AtomicU64::new(0);
+static JIFFIES_UPDATE_LOCK: SpinLock<()> = SpinLock::new(());
+
+/// per-cpu的tick状态
+#[derive(Debug)]
+pub struct TickSched {
+    /// 该cpu是否在`nohz_full=`列表中
+    full: AtomicBool,
+    tick_stopped: AtomicBool,
+    /// tick是不是在idle中停下的
+    stopped_in_idle: AtomicBool,
+    /// 停tick时被打断的上下文是否为用户态，用于跳过的tick的记账
+    stopped_user: AtomicBool,
+    /// 本cpu上一次记账时的jiffies
+    last_tick_jiffies: AtomicU64,
+    /// 停tick之后编程的唤醒时刻（jiffies）
+    next_event: AtomicU64,
+}
+
+impl TickSched {
+    const fn new() -> Self {
+        Self {
+            full: AtomicBool::new(false),
+            tick_stopped: AtomicBool::new(false),
+            stopped_in_idle: AtomicBool::new(false),
+            stopped_user: AtomicBool::new(false),
+            last_tick_jiffies: AtomicU64::new(0),
+            next_event: AtomicU64::new(u64::MAX),
+        }
+    }
+
+    #[inline]
+    pub fn tick_stopped(&self) -> bool {
+        self.tick_stopped.load(Ordering::Relaxed)
+    }
+
+    #[inline]
+    pub fn is_full(&self) -> bool {
+        self.full.load(Ordering::Relaxed)
+    }
+
+    /// 取走上一次记账以来经过的tick数
+    fn take_elapsed_ticks(&self) -> u64 {
+        let now = clock();
+        let last = self.last_tick_jiffies.swap(now, Ordering::Relaxed);
+        now.saturating_sub(last)
+    }
+}
+
+static TICK_SCHED: [TickSched; PerCpu::MAX_CPU_NUM as usize] =
+    [const { TickSched::new() }; PerCpu::MAX_CPU_NUM as usize];
+
+#[inline]
+fn tick_sched(cpu: ProcessorId) -> &'static TickSched {
+    &TICK_SCHED[cpu.data() as usize]
+}
+
+#[inline]
+pub fn tick_nohz_active() -> bool {
+    NOHZ_ACTIVE.load(Ordering::Acquire)
+}
+
+#[inline]
+fn task_is_idle(pcb: &Arc<ProcessControlBlock>) -> bool {
+    pcb.sched_info().policy() == SchedPolicy::IDLE
+}
+
+#[inline]
+fn monotonic_ns() -> u64 {
+    SchedClock::sched_clock_cpu(smp_get_processor_id())
+}
+
+/// 解析`1-3,5`形式的cpu列表
+pub(crate) fn parse_cpulist(list: &str) -> Option<CpuMask> {
+    let mut mask = CpuMask::new();
+    for part in list.split(',').map(str::trim).filter(|p| !p.is_empty()) {
+        let (start, end) = match part.split_once('-') {
+            Some((s, e)) => (s.trim().parse::<u32>().ok()?, e.trim().parse::<u32>().ok()?),
+            None => {
+                let cpu = part.parse::<u32>().ok()?;
+                (cpu, cpu)
+            }
+        };
+        if start > end || end >= PerCpu::MAX_CPU_NUM {
+            return None;
+        }
+        for cpu in start..=end {
+            mask.set(ProcessorId::new(cpu), true);
+        }
+    }
+    Some(mask)
+}
+
+/// 启用nohz，在所有cpu启动并且调度域建立之后调用
+pub fn tick_nohz_init() {
+    if NOHZ_PARAM.value_str() == Some("off") {
+        info!("NOHZ: disabled by nohz=off");
+        return;
+    }
+
+    let this_cpu = smp_get_processor_id();
+    let now = monotonic_ns();
+    if now == 0 {
+        warn!("NOHZ: no usable monotonic clock, keeping the periodic tick");
+        return;
+    }
+
+    let cpu_manager = smp_cpu_manager();
+    let mut nr_full = 0;
+    if let Some(list) = NOHZ_FULL_PARAM.value_str().filter(|s| !s.is_empty()) {
+        match parse_cpulist(list) {
+            Some(mask) => {
+                for cpu in mask.iter_cpu() {
+                    // 引导cpu负责时间维护，不能成为nohz_full cpu
+                    if cpu == this_cpu || !cpu_manager.is_online_cpu(cpu) {
+                        warn!("NOHZ: cpu {} cannot be nohz_full, ignored", cpu.data());
+                        continue;
+                    }
+                    tick_sched(cpu).full.store(true, Ordering::Relaxed);
+                    nr_full += 1;
+                }
+            }
+            None => warn!("NOHZ: invalid nohz_full= cpu list '{}'", list),
+        }
+    }
+
+    LAST_JIFFIES_UPDATE.store(now, Ordering::Relaxed);
+    let jiffies = clock();
+    for cpu in cpu_manager.present_cpus().iter_cpu() {
+        tick_sched(cpu)
+            .last_tick_jiffies
+            .store(jiffies, Ordering::Relaxed);
+    }
+    TICK_DO_TIMER_CPU.store(this_cpu.data(), Ordering::Relaxed);
+    TICK_DO_TIMER_LAST.store(this_cpu.data(), Ordering::Relaxed);
+
+    NOHZ_FULL_ENABLED.store(nr_full > 0, Ordering::Relaxed);
+    NOHZ_ACTIVE.store(true, Ordering::Release);
+    info!("NOHZ: tickless idle enabled, {} nohz_full cpu(s)", nr_full);
+}
+
+/// 根据单调时钟推进jiffies（对标Linux tick_do_update_jiffies64）
+fn tick_do_update_jiffies64() {
+    let now = monotonic_ns();
+    let tick_ns = TICK_NESC as u64;
+    if now.saturating_sub(LAST_JIFFIES_UPDATE.load(Ordering::Relaxed)) < tick_ns {
+        return;
+    }
+
+    let _guard = JIFFIES_UPDATE_LOCK.lock_irqsave();
+    let last = LAST_JIFFIES_UPDATE.load(Ordering::Relaxed);
+    let delta = now.saturating_sub(last);
+    if delta < tick_ns {
+        return;
+    }
+    let ticks = delta / tick_ns;
+    LAST_JIFFIES_UPDATE.store(last + ticks * tick_ns, Ordering::Relaxed);
+    update_timer_jiffies(ticks);
+}
+
+/// 把上一次记账以来跳过的tick记到`pcb`上
+fn tick_nohz_account_ticks(ts: &TickSched, pcb: &Arc<ProcessControlBlock>, user: bool) {
+    let ticks = ts.take_elapsed_ticks();
+    if ticks > 0 {
+        CpuTimeFunc::irqtime_account_process_tick(pcb, user, ticks);
+    }
+}
+
+/// nohz_full cpu上正在运行的任务是否可以不要tick
+fn tick_nohz_full_can_stop(cpu: ProcessorId, pcb: &Arc<ProcessControlBlock>) -> bool {
+    if !sched_can_stop_tick(cpu) || crate::rcu::rcu_needs_cpu(cpu) {
+        return false;
+    }
+
+    // CPU时间定时器和等待CPU时间时钟的线程依赖tick推进
+    {
+        let itimers = pcb.itimers_irqsave();
+        if itimers.virt.is_active || itimers.prof.is_active {
+            return false;
+        }
+    }
+    pcb.cputime_wait_queue().is_empty()
+}
+
+/// 停止本cpu的tick。返回false表示下一个事件太近或者架构不支持，tick保持运行
+fn tick_nohz_stop_tick(cpu: ProcessorId, ts: &TickSched, idle: bool, user: bool) -> bool {
+    let now = clock();
+    let mut defer = if idle {
+        u64::MAX
+    } else {
+        NOHZ_FULL_MAX_DEFER_TICKS
+    };
+
+    if let Some(expire) = tick_nohz_next_expire(cpu) {
+        defer = defer.min(expire.saturating_sub(now));
+    }
+
+    // 持有do_timer职责的cpu停tick之后由它负责时间维护
+    let do_timer = TICK_DO_TIMER_CPU.load(Ordering::Relaxed);
+    let owns_global = do_timer == cpu.data()
+        || (do_timer == TICK_DO_TIMER_NONE
+            && TICK_DO_TIMER_LAST.load(Ordering::Relaxed) == cpu.data());
+    if owns_global {
+        defer = defer.min(NOHZ_TIMEKEEPING_MAX_DEFER_TICKS);
+    }
+
+    if defer <= 1 || !tick_program_stop(defer) {
+        return false;
+    }
+
+    if owns_global {
+        TICK_DO_TIMER_LAST.store(cpu.data(), Ordering::Relaxed);
+        TICK_DO_TIMER_CPU.store(TICK_DO_TIMER_NONE, Ordering::Relaxed);
+    }
+    ts.next_event
+        .store(now.saturating_add(defer), Ordering::Relaxed);
+    ts.stopped_in_idle.store(idle, Ordering::Relaxed);
+    ts.stopped_user.store(user, Ordering::Relaxed);
+    ts.tick_stopped.store(true, Ordering::Release);
+    true
+}
+
+/// 恢复本cpu的周期tick，跳过的tick记到`pcb`上
+fn tick_nohz_restart_tick(ts: &TickSched, pcb: &Arc<ProcessControlBlock>) {
+    tick_do_update_jiffies64();
+    tick_nohz_account_ticks(ts, pcb, ts.stopped_user.load(Ordering::Relaxed));
+    ts.tick_stopped.store(false, Ordering::Release);
+    ts.stopped_in_idle.store(false, Ordering::Relaxed);
+    tick_program_resume();
+}
+
+/// nohz启用之后的tick处理（对标Linux tick_nohz_handler）
+pub fn tick_sched_handle(cpu: ProcessorId, trap_frame: &TrapFrame) {
+    let ts = tick_sched(cpu);
+    let user_tick = trap_frame.is_from_user();
+
+    // nohz_full cpu不承担时间维护职责
+    if !ts.is_full() && TICK_DO_TIMER_CPU.load(Ordering::Relaxed) == TICK_DO_TIMER_NONE {
+        TICK_DO_TIMER_CPU
+            .compare_exchange(
+                TICK_DO_TIMER_NONE,
+                cpu.data(),
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+            )
+            .ok();
+    }
+    tick_do_update_jiffies64();
+    if TICK_DO_TIMER_CPU.load(Ordering::Relaxed) == cpu.data() {
+        loadavg::calc_global_load(clock());
+    }
+    run_local_timer();
+
+    ProcessManager::update_process_times(user_tick, ts.take_elapsed_ticks());
+
+    let current = ProcessManager::current_pcb();
+    if task_is_idle(&current) {
+        // 停tick状态下为定时器或残余tick醒来，重新编程下一次唤醒
+        if ts.tick_stopped() && !tick_nohz_stop_tick(cpu, ts, true, false) {
+            tick_nohz_restart_tick(ts, &current);
+        }
+        return;
+    }
+
+    if ts.is_full()
+        && tick_nohz_full_can_stop(cpu, &current)
+        && tick_nohz_stop_tick(cpu, ts, false, user_tick)
+    {
+        return;
+    }
+    if ts.tick_stopped() {
+        tick_nohz_restart_tick(ts, &current);
+    }
+}
+
+/// idle循环在睡眠之前调用，尝试停止本cpu的tick
+pub fn tick_nohz_idle_stop_tick() {
+    if !tick_nohz_active() {
+        return;
+    }
+
+    let _irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+    let current = ProcessManager::current_pcb();
+    if current.flags().contains(ProcessFlags::NEED_SCHEDULE) {
+        return;
+    }
+
+    let cpu = smp_get_processor_id();
+    let ts = tick_sched(cpu);
+    // 已经在idle中停了tick的cpu只有本地时间轮上出现了更早的定时器时才需要重新编程
+    if ts.tick_stopped()
+        && ts.stopped_in_idle.load(Ordering::Relaxed)
+        && !tick_nohz_timer_earlier(cpu, ts)
+    {
+        return;
+    }
+
+    tick_do_update_jiffies64();
+    if !tick_nohz_stop_tick(cpu, ts, true, false) && ts.tick_stopped() {
+        tick_nohz_restart_tick(ts, &current);
+    }
+}
+
+/// 中断入口：停了tick的cpu先补齐jiffies，中断处理函数看到的是最新的时间
+pub fn tick_nohz_irq_enter() {
+    if !tick_nohz_active() {
+        return;
+    }
+
+    if tick_sched(smp_get_processor_id()).tick_stopped() {
+        tick_do_update_jiffies64();
+    }
+}
+
+/// 最外层中断出口：nohz_full cpu上停tick的条件不再满足，或者本地时间轮上出现了
+/// 比编程的唤醒时刻更早的定时器时恢复tick，由下一次tick重新判断
+///
+/// idle中停下的tick由任务切换恢复，或者由idle循环重新编程
+pub fn tick_nohz_irq_exit() {
+    if !NOHZ_FULL_ENABLED.load(Ordering::Relaxed) || !tick_nohz_active() {
+        return;
+    }
+
+    let cpu = smp_get_processor_id();
+    let ts = tick_sched(cpu);
+    if !ts.is_full() || !ts.tick_stopped() {
+        return;
+    }
+
+    let current = ProcessManager::current_pcb();
+    if task_is_idle(&current)
+        || (tick_nohz_full_can_stop(cpu, &current) && !tick_nohz_timer_earlier(cpu, ts))
+    {
+        return;
+    }
+    tick_nohz_restart_tick(ts, &current);
+}
+
+/// 任务切换时调用（中断已关闭）。停tick期间的时间记到`prev`上，切到非idle任务时恢复tick
+///
+/// nohz_full cpu在下一次tick时重新判断是否可以停tick
+pub fn tick_nohz_task_switch(prev: &Arc<ProcessControlBlock>, next: &Arc<ProcessControlBlock>) {
+    if !tick_nohz_active() {
+        return;
+    }
+
+    let ts = tick_sched(smp_get_processor_id());
+    if !ts.tick_stopped() {
+        return;
+    }
+
+    tick_do_update_jiffies64();
+    tick_nohz_account_ticks(ts, prev, ts.stopped_user.load(Ordering::Relaxed));
+    if task_is_idle(next) {
+        return;
+    }
+    tick_nohz_restart_tick(ts, next);
+}
+
+fn tick_nohz_kick(cpu: ProcessorId) {
+    if cpu == smp_get_processor_id() {
+        send_ipi(IpiKind::KickCpu, IpiTarget::Current);
+    } else {
+        send_ipi(IpiKind::KickCpu, IpiTarget::Specified(cpu));
+    }
+}
+
+/// 停了tick的nohz_full cpu需要重新评估tick（例如多了一个可运行任务）时调用
+pub fn tick_nohz_full_kick_cpu(cpu: ProcessorId) {
+    if !NOHZ_FULL_ENABLED.load(Ordering::Relaxed) {
+        return;
+    }
+
+    let ts = tick_sched(cpu);
+    if ts.is_full() && ts.tick_stopped() {
+        tick_nohz_kick(cpu);
+    }
+}
+
+/// 踢一遍`mask`中停了tick的nohz_full cpu（不含当前cpu）
+pub fn tick_nohz_full_kick_mask(mask: &CpuMask) {
+    if !NOHZ_FULL_ENABLED.load(Ordering::Relaxed) {
+        return;
+    }
+
+    let this_cpu = smp_get_processor_id();
+    for cpu in mask.iter_cpu().filter(|&cpu| cpu != this_cpu) {
+        tick_nohz_full_kick_cpu(cpu);
+    }
+}
+
+/// 停tick时需要醒来处理的最早定时器（jiffies）
+///
+/// 低精度模式下hrtimer由tick检查，也要算在内
+fn tick_nohz_next_expire(cpu: ProcessorId) -> Option<u64> {
+    let wheel = timer_get_next_expire(cpu);
+    if tick_hres_active(cpu) {
+        return wheel;
+    }
+    let hrtimer = hrtimer_get_next_event(cpu).map(|expires| {
+        let delta = expires.saturating_sub(ktime_get()).max(0) as u64;
+        clock() + delta.div_ceil(TICK_NESC as u64)
+    });
+    match (wheel, hrtimer) {
+        (Some(a), Some(b)) => Some(a.min(b)),
+        (a, b) => a.or(b),
+    }
+}
+
+/// 本地最早的定时器是否早于停tick时编程的唤醒时刻
+fn tick_nohz_timer_earlier(cpu: ProcessorId, ts: &TickSched) -> bool {
+    tick_nohz_next_expire(cpu).is_some_and(|expire| expire < ts.next_event.load(Ordering::Relaxed))
+}
+
+/// `cpu`上来了一个新的最早到期的定时器。该cpu停了tick并且编程的唤醒时刻更晚时，
+/// 叫醒它在中断出口或者idle循环中重新编程
+///
+/// 本cpu的idle任务在中断上下文中入队的定时器不需要叫醒，中断返回之后idle循环会重新编程
+pub fn tick_nohz_timer_enqueued(cpu: ProcessorId, expire_jiffies: u64) {
+    if !tick_nohz_active() {
+        return;
+    }
+
+    let ts = tick_sched(cpu);
+    if !ts.tick_stopped() || ts.next_event.load(Ordering::Relaxed) <= expire_jiffies {
+        return;
+    }
+
+    if cpu == smp_get_processor_id() && task_is_idle(&ProcessManager::current_pcb()) {
+        return;
+    }
+    tick_nohz_kick(cpu);
+}
@@ -17,8 +17,9 @@ use crate::{
 
 use super::timekeep::{ktime_t, timespec_to_ktime};
 use super::{
-    clocksource::{clocksource_cyc2ns, Clocksource, CycleNum, HZ},
+    clocksource::{clocksource_cyc2ns, Clocksource, ClocksourceFlags, CycleNum, HZ},
     syscall::PosixTimeval,
+    vsyscall::{update_vsyscall, update_vsyscall_coarse, VsyscallTime},
     NSEC_PER_SEC,
 };
 /// NTP周期频率
@@ -32,6 +33,8 @@ pub const NTP_SCALE_SHIFT: u32 = 32;
 pub static TIMEKEEPING_SUSPENDED: AtomicBool = AtomicBool::new(false);
 /// timekeeper全局变量，用于管理timekeeper模块
 static mut __TIMEKEEPER: Option<Timekeeper> = None;
+/// 当前时钟源是否连续计数，只有这样单调时钟才能在两次tick之间精确推进，可以用于高精度定时器
+static TIMEKEEPING_VALID_FOR_HRES: AtomicBool = AtomicBool::new(false);
 
 #[derive(Debug)]
 pub struct Timekeeper {
@@ -123,6 +126,12 @@ impl Timekeeper {
         timekeeper.clock.replace(clock.clone());
 
         let clock_data = clock.clocksource_data();
+        TIMEKEEPING_VALID_FOR_HRES.store(
+            clock_data
+                .flags
+                .contains(ClocksourceFlags::CLOCK_SOURCE_IS_CONTINUOUS),
+            Ordering::Release,
+        );
         let mut temp = NTP_INTERVAL_LENGTH << clock_data.shift;
         let ntpinterval = temp;
         temp += (clock_data.mult / 2) as u64;
@@ -140,6 +149,7 @@ impl Timekeeper {
         timekeeper.ntp_error_shift = (NTP_SCALE_SHIFT - clock_data.shift) as i32;
 
         timekeeper.mult = clock_data.mult;
+        timekeeping_update_vsyscall(&timekeeper);
     }
 
     pub fn timekeeping_get_ns(&self) -> i64 {
@@ -313,6 +323,12 @@ pub fn timekeeping_is_initialized() -> bool {
     unsafe { __TIMEKEEPER.is_some() }
 }
 
+/// 当前时钟源能否支撑高精度定时器（时钟源连续计数，而不是随tick推进的jiffies）
+#[inline]
+pub fn timekeeping_valid_for_hres() -> bool {
+    TIMEKEEPING_VALID_FOR_HRES.load(Ordering::Acquire)
+}
+
 pub fn timekeeper_init() {
     unsafe { __TIMEKEEPER = Some(Timekeeper::new()) };
 }
@@ -351,6 +367,29 @@ pub fn getnstimeofday() -> PosixTimeSpec {
     return xtime;
 }
 
+/// # 获取单调时钟(最小单位:nsec)
+///
+/// 等于墙上时间加上wall_to_monotonic，即timekeeping初始化以来经过的时间，不受settimeofday影响。
+/// 高精度定时器的到期时刻都用这个时钟表示
+pub fn ktime_get() -> ktime_t {
+    let (xtime, wtm) = loop {
+        if let Some(tk) = timekeeper().inner.try_read_irqsave() {
+            break (tk.xtime, tk.wall_to_monotonic);
+        }
+    };
+    let nsecs = timekeeper().timekeeping_get_ns();
+
+    (xtime.tv_sec + wtm.tv_sec) * NSEC_PER_SEC as i64 + xtime.tv_nsec + wtm.tv_nsec + nsecs
+}
+
+/// # 获取墙上时间相对于单调时钟的偏移(最小单位:nsec)
+///
+/// 墙上时间 = 单调时钟 + 偏移，用于把CLOCK_REALTIME的绝对时刻换算为单调时钟
+pub fn ktime_get_real_offset() -> ktime_t {
+    let wtm = timekeeper().inner.read_irqsave().wall_to_monotonic;
+    -(wtm.tv_sec * NSEC_PER_SEC as i64 + wtm.tv_nsec)
+}
+
 /// # 获取1970.1.1至今的UTC时间戳(最小单位:usec)
 ///
 /// ## 返回值
@@ -365,7 +404,20 @@ pub fn do_gettimeofday() -> PosixTimeval {
 }
 
 pub fn do_settimeofday64(time: PosixTimeSpec) -> Result<(), SystemError> {
-    timekeeper().inner.write_irqsave().xtime = time;
+    let mut tk = timekeeper().inner.write_irqsave();
+    // 墙上时间跳变时同步调整wall_to_monotonic，保持单调时钟连续
+    let delta =
+        (tk.xtime.tv_sec - time.tv_sec) * NSEC_PER_SEC as i64 + (tk.xtime.tv_nsec - time.tv_nsec);
+    let wtm =
+        tk.wall_to_monotonic.tv_sec * NSEC_PER_SEC as i64 + tk.wall_to_monotonic.tv_nsec + delta;
+    tk.wall_to_monotonic = PosixTimeSpec::new(
+        wtm.div_euclid(NSEC_PER_SEC as i64),
+        wtm.rem_euclid(NSEC_PER_SEC as i64),
+    );
+    tk.xtime = time;
+    update_rt_offset(&mut tk);
+    timekeeping_update_vsyscall(&tk);
+    drop(tk);
     // todo: 模仿linux，实现时间误差校准。
     // https://code.dragonos.org.cn/xref/linux-6.6.21/kernel/time/timekeeping.c?fi=do_settimeofday64#1312
     return Ok(());
@@ -417,6 +469,10 @@ pub fn update_wall_time() {
     let clock_data = clock.clocksource_data();
     // 计算从上一次更新周期以来经过的时钟周期数
     let mut offset = (clock.read().div(clock_data.cycle_last).data()) & clock_data.mask.bits();
+    // 刷新vDSO的COARSE时钟快照
+    let real = timespec_ns(&tk.xtime)
+        + clocksource_cyc2ns(CycleNum::new(offset), tk.mult, tk.shift as u32) as i64;
+    update_vsyscall_coarse(real, real + timespec_ns(&tk.wall_to_monotonic));
     // 检查offset是否达到了一个NTP周期间隔
     if offset < tk.cycle_interval.data() {
         return;
@@ -469,6 +525,43 @@ pub fn timekeeping_update(timekeeper: &mut TimekeeperData) {
 
     // 更新实时时钟偏移量，用于跟踪硬件时钟与系统时间的差异，以便进行时间校正
     update_rt_offset(timekeeper);
+    timekeeping_update_vsyscall(timekeeper);
+}
+
+#[inline]
+fn timespec_ns(ts: &PosixTimeSpec) -> ktime_t {
+    ts.tv_sec * NSEC_PER_SEC as i64 + ts.tv_nsec
+}
+
+/// # 把当前的换算参数发布到vDSO数据页
+///
+/// 各时钟的基准取时钟源`cycle_last`时刻的值，用户态在此基础上加上计数器的增量
+fn timekeeping_update_vsyscall(tk: &TimekeeperData) {
+    let Some(clock) = tk.clock.as_ref() else {
+        return;
+    };
+    let clock_data = clock.clocksource_data();
+    let realtime = timespec_ns(&tk.xtime);
+    let monotonic = realtime + timespec_ns(&tk.wall_to_monotonic);
+    update_vsyscall(&VsyscallTime {
+        clock_mode: clock.vdso_clock_mode(),
+        cycle_last: clock_data.cycle_last.data(),
+        mask: clock_data.mask.bits(),
+        mult: tk.mult,
+        shift: tk.shift as u32,
+        realtime,
+        monotonic,
+        boottime: monotonic + timespec_ns(&tk.total_sleep_time),
+    });
+}
+
+/// # vDSO数据页登记后，发布一次完整的数据
+pub fn timekeeping_vsyscall_init() {
+    if !timekeeping_is_initialized() {
+        return;
+    }
+    let tk = timekeeper().inner.write_irqsave();
+    timekeeping_update_vsyscall(&tk);
 }
 
 /// # 更新实时偏移量(墙上之间与单调时间的差值)
@@ -1,7 +1,18 @@
+//! 内核定时器
+//!
+//! 每个cpu有一个分层时间轮（对标Linux kernel/time/timer.c），定时器总是挂到激活它的cpu上：
+//!
+//! - 共`LVL_DEPTH`层，每层`LVL_SIZE`个桶，第n层一个桶覆盖`8^n`个jiffies。
+//!   入队时按照到期时间距离时间轮时钟的远近选层，插入和取消都是O(1)
+//! - 高层的定时器不逐级下沉（没有cascade），而是按所在层的粒度向上取整后到期，
+//!   因此越远的定时器误差越大，最大约为剩余时间的1/8
+//! - 软中断一次把所有到期的桶整体摘下，释放锁之后批量执行
+//! - cpu下线时把它时间轮上的定时器迁移到另一个在线cpu
+
 use core::{
     fmt::Debug,
     intrinsics::unlikely,
-    sync::atomic::{compiler_fence, AtomicBool, AtomicU64, Ordering},
+    sync::atomic::{compiler_fence, AtomicU32, AtomicU64, AtomicUsize, Ordering},
     time::Duration,
 };
 
@@ -10,7 +21,7 @@ use alloc::{
     sync::{Arc, Weak},
     vec::Vec,
 };
-use log::{error, info, warn};
+use log::{error, info};
 use system_error::SystemError;
 
 use crate::{
@@ -20,18 +31,63 @@ use crate::{
         InterruptArch,
     },
     libs::spinlock::{SpinLock, SpinLockGuard},
+    mm::percpu::PerCpu,
     process::{ProcessControlBlock, ProcessManager},
     sched::{schedule, SchedMode},
+    smp::{
+        core::smp_get_processor_id,
+        cpu::{smp_cpu_manager, ProcessorId},
+    },
 };
 
-use super::{jiffies::NSEC_PER_JIFFY, timekeeping::update_wall_time};
+use super::{
+    jiffies::NSEC_PER_JIFFY, tick_sched::tick_nohz_timer_enqueued, timekeeping::update_wall_time,
+};
 
 const MAX_TIMEOUT: i64 = i64::MAX;
-const TIMER_RUN_CYCLE_THRESHOLD: usize = 20;
 static TIMER_JIFFIES: AtomicU64 = AtomicU64::new(0);
 
+/// 相邻两层之间粒度的倍数（以2为底的对数）
+const LVL_CLK_SHIFT: u32 = 3;
+const LVL_CLK_DIV: u64 = 1 << LVL_CLK_SHIFT;
+const LVL_CLK_MASK: u64 = LVL_CLK_DIV - 1;
+/// 每层的桶数（以2为底的对数），一层正好对应pending位图中的一个u64
+const LVL_BITS: u32 = 6;
+const LVL_SIZE: usize = 1 << LVL_BITS;
+const LVL_MASK: u64 = LVL_SIZE as u64 - 1;
+/// HZ=250时9层可以覆盖约12天，更远的定时器按最大超时处理
+const LVL_DEPTH: usize = 9;
+const WHEEL_SIZE: usize = LVL_SIZE * LVL_DEPTH;
+
+/// 第`lvl`层的粒度（以2为底的对数）
+#[inline(always)]
+const fn lvl_shift(lvl: usize) -> u32 {
+    lvl as u32 * LVL_CLK_SHIFT
+}
+
+/// 第`lvl`层（lvl >= 1）能表示的最小距离
+#[inline(always)]
+const fn lvl_start(lvl: usize) -> u64 {
+    (LVL_SIZE as u64 - 1) << ((lvl as u32 - 1) * LVL_CLK_SHIFT)
+}
+
+const WHEEL_TIMEOUT_CUTOFF: u64 = lvl_start(LVL_DEPTH);
+const WHEEL_TIMEOUT_MAX: u64 = WHEEL_TIMEOUT_CUTOFF - (1 << lvl_shift(LVL_DEPTH - 1));
+/// 时间轮为空时next_expiry相对于时钟的距离
+const NEXT_TIMER_MAX_DELTA: u64 = (1 << 30) - 1;
+
+/// 定时器不在任何时间轮上
+const TIMER_NOT_PENDING: u32 = u32::MAX;
+
 lazy_static! {
-    pub static ref TIMER_LIST: SpinLock<Vec<(u64, Arc<Timer>)>> = SpinLock::new(Vec::new());
+    static ref TIMER_BASES: Vec<TimerBase> = (0..PerCpu::MAX_CPU_NUM)
+        .map(|cpu| TimerBase::new(ProcessorId::new(cpu)))
+        .collect();
+}
+
+#[inline]
+fn timer_base(cpu: ProcessorId) -> &'static TimerBase {
+    &TIMER_BASES[cpu.data() as usize]
 }
 
 /// 定时器要执行的函数的特征
@@ -106,6 +162,32 @@ impl TimerFunction for WakeUpHelper {
 #[derive(Debug)]
 pub struct Timer {
     inner: SpinLock<InnerTimer>,
+    /// 定时器在时间轮中的位置
+    wheel: TimerWheelEntry,
+}
+
+/// 定时器在时间轮中的位置。`cpu`之外的字段只在持有该cpu时间轮的锁时读写
+#[derive(Debug)]
+struct TimerWheelEntry {
+    /// 定时器所在时间轮的cpu，不在时间轮上时为`TIMER_NOT_PENDING`
+    cpu: AtomicU32,
+    /// 所在的桶
+    idx: AtomicUsize,
+    /// 在桶中的下标
+    pos: AtomicUsize,
+    /// 入队时的到期时刻，迁移时据此重新选桶
+    expires: AtomicU64,
+}
+
+impl TimerWheelEntry {
+    const fn new() -> Self {
+        Self {
+            cpu: AtomicU32::new(TIMER_NOT_PENDING),
+            idx: AtomicUsize::new(0),
+            pos: AtomicUsize::new(0),
+            expires: AtomicU64::new(0),
+        }
+    }
 }
 
 impl Timer {
@@ -124,6 +206,7 @@ impl Timer {
                 self_ref: Weak::default(),
                 triggered: false,
             }),
+            wheel: TimerWheelEntry::new(),
         });
 
         result.inner.lock().self_ref = Arc::downgrade(&result);
@@ -135,41 +218,59 @@ impl Timer {
         return self.inner.lock_irqsave();
     }
 
-    /// @brief 将定时器插入到定时器链表中
+    /// @brief 将定时器插入到当前cpu的时间轮中。已经在时间轮上的定时器会按照新的到期时刻重新入队
     pub fn activate(&self) {
-        let mut timer_list = TIMER_LIST.lock_irqsave();
         let inner_guard = self.inner();
-
-        // 链表为空，则直接插入
-        if timer_list.is_empty() {
-            // FIXME push_timer
-            timer_list.push((
-                inner_guard.expire_jiffies,
-                inner_guard.self_ref.upgrade().unwrap(),
-            ));
-
-            drop(inner_guard);
-            drop(timer_list);
-            compiler_fence(Ordering::SeqCst);
-
-            return;
-        }
         let expire_jiffies = inner_guard.expire_jiffies;
         let self_arc = inner_guard.self_ref.upgrade().unwrap();
         drop(inner_guard);
-        let mut split_pos: usize = timer_list.len();
-        for (pos, elt) in timer_list.iter().enumerate() {
-            if Arc::ptr_eq(&self_arc, &elt.1) {
-                warn!("Timer already in list");
-            }
-            if elt.0 > expire_jiffies {
-                split_pos = pos;
-                break;
+
+        let cpu = smp_get_processor_id();
+        let (new_first, next_expiry) = loop {
+            // 时间轮持有的引用不是最后一个，可以直接释放
+            self.detach_pending();
+
+            let mut base = timer_base(cpu).inner.lock_irqsave();
+            // 抢占所有权，防止并发的activate把同一个定时器挂到两个时间轮上
+            if self
+                .wheel
+                .cpu
+                .compare_exchange(
+                    TIMER_NOT_PENDING,
+                    cpu.data(),
+                    Ordering::AcqRel,
+                    Ordering::Relaxed,
+                )
+                .is_err()
+            {
+                continue;
             }
+            base.forward(clock());
+            let new_first = base.enqueue(self_arc, expire_jiffies);
+            break (new_first, base.next_expiry);
+        };
+
+        compiler_fence(Ordering::SeqCst);
+        if new_first {
+            tick_nohz_timer_enqueued(cpu, next_expiry);
         }
-        timer_list.insert(split_pos, (expire_jiffies, self_arc));
+    }
+
+    /// 把定时器从所在的时间轮上摘下来，返回时间轮持有的引用（需要在锁外释放）
+    fn detach_pending(&self) -> Option<Arc<Timer>> {
+        loop {
+            let cpu = self.wheel.cpu.load(Ordering::Acquire);
+            if cpu == TIMER_NOT_PENDING {
+                return None;
+            }
 
-        drop(timer_list);
+            let mut base = timer_base(ProcessorId::new(cpu)).inner.lock_irqsave();
+            // 加锁期间定时器可能已经到期或者被迁移到别的cpu，重新检查
+            if self.wheel.cpu.load(Ordering::Relaxed) != cpu {
+                continue;
+            }
+            return Some(base.detach(self));
+        }
     }
 
     #[inline]
@@ -193,13 +294,10 @@ impl Timer {
     }
 
     /// ## 取消定时器任务
+    ///
+    /// 返回定时器取消前是否还在时间轮上
     pub fn cancel(&self) -> bool {
-        let this_arc = self.inner().self_ref.upgrade().unwrap();
-        TIMER_LIST
-            .lock_irqsave()
-            .extract_if(.., |x| Arc::ptr_eq(&this_arc, &x.1))
-            .for_each(drop);
-        true
+        self.detach_pending().is_some()
     }
 }
 
@@ -216,59 +314,232 @@ pub struct InnerTimer {
     triggered: bool,
 }
 
+/// per-cpu的时间轮
 #[derive(Debug)]
-pub struct DoTimerSoftirq {
-    running: AtomicBool,
+struct TimerBase {
+    inner: SpinLock<TimerBaseInner>,
 }
 
-impl DoTimerSoftirq {
-    pub fn new() -> Self {
-        return DoTimerSoftirq {
-            running: AtomicBool::new(false),
-        };
+impl TimerBase {
+    fn new(cpu: ProcessorId) -> Self {
+        let clk = clock();
+        Self {
+            inner: SpinLock::new(TimerBaseInner {
+                cpu,
+                clk,
+                next_expiry: clk + NEXT_TIMER_MAX_DELTA,
+                next_expiry_recalc: false,
+                timers_pending: false,
+                pending_map: [0; LVL_DEPTH],
+                vectors: Vec::new(),
+            }),
+        }
     }
+}
+
+#[derive(Debug)]
+struct TimerBaseInner {
+    cpu: ProcessorId,
+    /// 下一个要处理的jiffy，执行到期定时器期间比jiffies大1
+    clk: u64,
+    /// 最早的非空桶的到期时刻
+    next_expiry: u64,
+    /// 有桶被清空，next_expiry可能偏早，需要重新计算
+    next_expiry_recalc: bool,
+    timers_pending: bool,
+    /// 每层一个u64，置位表示对应的桶非空
+    pending_map: [u64; LVL_DEPTH],
+    /// 第一次入队时才分配，没有上线的cpu不占内存
+    vectors: Vec<Vec<Arc<Timer>>>,
+}
 
-    fn set_run(&self) -> bool {
-        let x = self
-            .running
-            .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed);
-        return x.is_ok();
+impl TimerBaseInner {
+    /// 计算`expires`在第`lvl`层的桶，返回(桶下标, 桶的到期时刻)
+    ///
+    /// 按该层的粒度向上取整，保证定时器不会提前到期
+    #[inline]
+    fn calc_index(expires: u64, lvl: usize) -> (usize, u64) {
+        let expires = (expires >> lvl_shift(lvl)) + 1;
+        let bucket_expiry = expires << lvl_shift(lvl);
+        (
+            lvl * LVL_SIZE + (expires & LVL_MASK) as usize,
+            bucket_expiry,
+        )
     }
 
-    fn clear_run(&self) {
-        self.running.store(false, Ordering::Release);
+    fn calc_wheel_index(expires: u64, clk: u64) -> (usize, u64) {
+        if expires < clk {
+            // 已经过期的定时器放到下一个要处理的桶里
+            return ((clk & LVL_MASK) as usize, clk);
+        }
+
+        let delta = expires - clk;
+        match (0..LVL_DEPTH).find(|&lvl| delta < lvl_start(lvl + 1)) {
+            Some(lvl) => Self::calc_index(expires, lvl),
+            None => Self::calc_index(clk + WHEEL_TIMEOUT_MAX, LVL_DEPTH - 1),
+        }
     }
-}
-impl SoftirqVec for DoTimerSoftirq {
-    fn run(&self) {
-        if !self.set_run() {
+
+    /// 停了tick的cpu上时钟可能远远落后于jiffies，入队之前先把时钟推到不越过任何定时器的位置，
+    /// 否则近期的定时器会落到粒度很粗的高层
+    fn forward(&mut self, now: u64) {
+        if now <= self.clk {
             return;
         }
-        // 最多只处理TIMER_RUN_CYCLE_THRESHOLD个计时器
-        for _ in 0..TIMER_RUN_CYCLE_THRESHOLD {
-            // debug!("DoTimerSoftirq run");
-            let timer_list = TIMER_LIST.try_lock_irqsave();
-            if timer_list.is_err() {
-                continue;
+        if self.next_expiry > now {
+            self.clk = now;
+        } else if self.next_expiry >= self.clk {
+            self.clk = self.next_expiry;
+        }
+    }
+
+    /// 入队，返回该定时器是否成为了时间轮上最早到期的定时器
+    fn enqueue(&mut self, timer: Arc<Timer>, expires: u64) -> bool {
+        if self.vectors.is_empty() {
+            self.vectors.resize_with(WHEEL_SIZE, Vec::new);
+        }
+
+        let (idx, bucket_expiry) = Self::calc_wheel_index(expires, self.clk);
+        let bucket = &mut self.vectors[idx];
+        timer.wheel.idx.store(idx, Ordering::Relaxed);
+        timer.wheel.pos.store(bucket.len(), Ordering::Relaxed);
+        timer.wheel.expires.store(expires, Ordering::Relaxed);
+        timer.wheel.cpu.store(self.cpu.data(), Ordering::Release);
+        bucket.push(timer);
+        self.pending_map[idx / LVL_SIZE] |= 1 << (idx % LVL_SIZE);
+
+        if bucket_expiry < self.next_expiry {
+            self.next_expiry = bucket_expiry;
+            self.timers_pending = true;
+            self.next_expiry_recalc = false;
+            return true;
+        }
+        false
+    }
+
+    /// 从桶中删除，桶内最后一个定时器补到空出来的位置上
+    fn detach(&mut self, timer: &Timer) -> Arc<Timer> {
+        let idx = timer.wheel.idx.load(Ordering::Relaxed);
+        let pos = timer.wheel.pos.load(Ordering::Relaxed);
+        let bucket = &mut self.vectors[idx];
+        let removed = bucket.swap_remove(pos);
+        debug_assert!(core::ptr::eq(Arc::as_ptr(&removed), timer));
+        if let Some(moved) = bucket.get(pos) {
+            moved.wheel.pos.store(pos, Ordering::Relaxed);
+        }
+        if bucket.is_empty() {
+            self.pending_map[idx / LVL_SIZE] &= !(1 << (idx % LVL_SIZE));
+            self.next_expiry_recalc = true;
+        }
+        timer.wheel.cpu.store(TIMER_NOT_PENDING, Ordering::Release);
+        removed
+    }
+
+    /// 第`lvl`层从`clk`开始（含）下一个非空桶的距离
+    #[inline]
+    fn next_pending_bucket(&self, lvl: usize, clk: u64) -> Option<u64> {
+        let map = self.pending_map[lvl].rotate_right((clk & LVL_MASK) as u32);
+        (map != 0).then(|| map.trailing_zeros() as u64)
+    }
+
+    /// 逐层查找最早的非空桶（对标Linux __next_timer_interrupt）
+    fn recalc_next_expiry(&mut self) {
+        let mut next = self.clk + NEXT_TIMER_MAX_DELTA;
+        let mut clk = self.clk;
+        for lvl in 0..LVL_DEPTH {
+            let lvl_clk = clk & LVL_CLK_MASK;
+            if let Some(pos) = self.next_pending_bucket(lvl, clk) {
+                next = next.min((clk + pos) << lvl_shift(lvl));
+                // 在进入下一层的桶之前就会到期，不用再往上找
+                if pos <= ((LVL_CLK_DIV - lvl_clk) & LVL_CLK_MASK) {
+                    break;
+                }
             }
-            let mut timer_list = timer_list.unwrap();
+            // 本层时钟的低位不为0时，上一层下一个要处理的桶要再往后一个
+            clk = (clk >> LVL_CLK_SHIFT) + (lvl_clk != 0) as u64;
+        }
+        self.next_expiry = next;
+        self.next_expiry_recalc = false;
+        self.timers_pending = next != self.clk + NEXT_TIMER_MAX_DELTA;
+    }
+
+    /// 最早到期时刻，时间轮为空时返回None
+    fn next_expiry(&mut self) -> Option<u64> {
+        if self.next_expiry_recalc {
+            self.recalc_next_expiry();
+        }
+        self.timers_pending.then_some(self.next_expiry)
+    }
 
-            if timer_list.is_empty() {
+    /// 把时钟推到next_expiry，并摘下各层在该时刻到期的桶
+    fn collect_expired(&mut self, expired: &mut Vec<Arc<Timer>>) {
+        self.clk = self.next_expiry;
+        let mut clk = self.clk;
+        for lvl in 0..LVL_DEPTH {
+            let pos = (clk & LVL_MASK) as usize;
+            if self.pending_map[lvl] & (1 << pos) != 0 {
+                self.pending_map[lvl] &= !(1 << pos);
+                let bucket = core::mem::take(&mut self.vectors[lvl * LVL_SIZE + pos]);
+                for timer in bucket.iter() {
+                    timer.wheel.cpu.store(TIMER_NOT_PENDING, Ordering::Release);
+                }
+                expired.extend(bucket);
+            }
+            // 只有本层时钟走完一圈，上一层才前进一个桶
+            if clk & LVL_CLK_MASK != 0 {
                 break;
             }
+            clk >>= LVL_CLK_SHIFT;
+        }
+    }
 
-            let (front_jiffies, timer_list_front) = timer_list.first().unwrap().clone();
-            // debug!("to lock timer_list_front");
+    /// 摘下截至`now`到期的所有定时器
+    fn expire_timers(&mut self, now: u64, expired: &mut Vec<Arc<Timer>>) {
+        while now >= self.clk && now >= self.next_expiry {
+            self.collect_expired(expired);
+            self.clk += 1;
+            self.recalc_next_expiry();
+        }
+    }
 
-            if front_jiffies >= TIMER_JIFFIES.load(Ordering::SeqCst) {
-                break;
+    /// 摘下时间轮上所有的定时器
+    fn take_all(&mut self) -> Vec<Arc<Timer>> {
+        let mut timers = Vec::new();
+        for (lvl, map) in self.pending_map.iter_mut().enumerate() {
+            while *map != 0 {
+                let pos = map.trailing_zeros() as usize;
+                *map &= !(1 << pos);
+                timers.extend(core::mem::take(&mut self.vectors[lvl * LVL_SIZE + pos]));
             }
-            timer_list.remove(0);
-            drop(timer_list);
-            timer_list_front.run();
         }
+        self.next_expiry = self.clk + NEXT_TIMER_MAX_DELTA;
+        self.next_expiry_recalc = false;
+        self.timers_pending = false;
+        timers
+    }
+}
+
+#[derive(Debug)]
+pub struct DoTimerSoftirq;
+
+impl DoTimerSoftirq {
+    pub fn new() -> Self {
+        return DoTimerSoftirq;
+    }
+}
 
-        self.clear_run();
+impl SoftirqVec for DoTimerSoftirq {
+    fn run(&self) {
+        let mut expired = Vec::new();
+        timer_base(smp_get_processor_id())
+            .inner
+            .lock_irqsave()
+            .expire_timers(clock(), &mut expired);
+
+        // 在锁外批量执行，定时器函数可以重新激活自己或者别的定时器
+        for timer in expired {
+            timer.run();
+        }
     }
 }
 
@@ -345,32 +616,17 @@ pub fn schedule_timeout(mut timeout: i64) -> Result<i64, SystemError> {
     }
 }
 
-pub fn timer_get_first_expire() -> Result<u64, SystemError> {
-    // FIXME
-    // debug!("rs_timer_get_first_expire,timer_jif = {:?}", TIMER_JIFFIES);
-    for _ in 0..10 {
-        match TIMER_LIST.try_lock_irqsave() {
-            Ok(timer_list) => {
-                // debug!("rs_timer_get_first_expire TIMER_LIST lock successfully");
-                if timer_list.is_empty() {
-                    // debug!("timer_list is empty");
-                    return Ok(0);
-                } else {
-                    // debug!("timer_list not empty");
-                    return Ok(timer_list.first().unwrap().0);
-                }
-            }
-            // 加锁失败返回啥？？
-            Err(_) => continue,
-        }
-    }
-    return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+/// 获取`cpu`的时间轮上最早的到期时刻（jiffies），时间轮为空时返回None
+///
+/// 到期时刻按桶的粒度向上取整，jiffies到达该值时定时器软中断会处理它
+pub fn timer_get_next_expire(cpu: ProcessorId) -> Option<u64> {
+    timer_base(cpu).inner.lock_irqsave().next_expiry()
 }
 
-/// 检查是否需要触发定时器软中断，如果需要则触发
+/// 检查本cpu是否有到期的定时器，如果有则触发定时器软中断
 pub fn try_raise_timer_softirq() {
-    if let Ok(first_expire) = timer_get_first_expire() {
-        if first_expire <= clock() {
+    if let Some(next_expiry) = timer_get_next_expire(smp_get_processor_id()) {
+        if next_expiry <= clock() {
             softirq_vectors().raise_softirq(SoftirqNumber::TIMER);
         }
     }
@@ -382,6 +638,57 @@ pub fn run_local_timer() {
     try_raise_timer_softirq();
 }
 
+/// cpu下线时把它时间轮上的定时器迁移到另一个在线cpu
+pub fn timer_migrate_cpu(dead: ProcessorId) {
+    let cpu_manager = smp_cpu_manager();
+    let Some(target) = cpu_manager
+        .present_cpus()
+        .iter_cpu()
+        .find(|&cpu| cpu != dead && cpu_manager.is_online_cpu(cpu))
+    else {
+        return;
+    };
+
+    // 按cpu号从小到大加锁，避免两个cpu同时下线时互相迁移造成死锁
+    let (first, second) = if dead.data() < target.data() {
+        (dead, target)
+    } else {
+        (target, dead)
+    };
+    let mut first_guard = timer_base(first).inner.lock_irqsave();
+    let mut second_guard = timer_base(second).inner.lock();
+    let (old_base, new_base) = if first == dead {
+        (&mut *first_guard, &mut *second_guard)
+    } else {
+        (&mut *second_guard, &mut *first_guard)
+    };
+
+    let timers = old_base.take_all();
+    if timers.is_empty() {
+        return;
+    }
+    let nr_timers = timers.len();
+    new_base.forward(clock());
+    let mut new_first = false;
+    for timer in timers {
+        let expires = timer.wheel.expires.load(Ordering::Relaxed);
+        new_first |= new_base.enqueue(timer, expires);
+    }
+    let next_expiry = new_base.next_expiry;
+    drop(second_guard);
+    drop(first_guard);
+
+    info!(
+        "timer: migrated {} timer(s) from cpu {} to cpu {}",
+        nr_timers,
+        dead.data(),
+        target.data()
+    );
+    if new_first {
+        tick_nohz_timer_enqueued(target, next_expiry);
+    }
+}
+
 /// 更新系统时间片
 pub fn update_timer_jiffies(add_jiffies: u64) -> u64 {
     let prev = TIMER_JIFFIES.fetch_add(add_jiffies, Ordering::SeqCst);
@@ -0,0 +1,144 @@
+//! vDSO数据页（vvar）的更新
+//!
+//! 架构代码在启动时分配vvar页并通过[`vdso_data_register`]登记，此后timekeeping在时钟源切换、
+//! 设置墙上时间时发布完整的换算参数（[`update_vsyscall`]），在每个tick刷新COARSE时钟的快照
+//! （[`update_vsyscall_coarse`]）。用户态的vDSO按与内核相同的算法计算时间，
+//! 通过seq计数判断读到的数据是否完整（对标Linux kernel/time/vsyscall.c）。
+//!
+//! 数据页的布局必须与 arch/x86_64/vdso/vdso.h 中的 struct vdso_data 保持一致。
+
+use core::{
+    mem::size_of,
+    ptr::null_mut,
+    sync::atomic::{fence, AtomicI32, AtomicPtr, AtomicU32, AtomicU64, Ordering},
+};
+
+use super::{
+    clocksource::VdsoClockMode,
+    syscall::{PosixClockID, PosixTimeZone, CLOCK_BOOTTIME},
+    timekeep::ktime_t,
+    NSEC_PER_SEC,
+};
+
+/// vvar中按clockid索引的时间基准个数
+const VDSO_BASES: usize = CLOCK_BOOTTIME as usize + 1;
+
+/// getcpu快速路径：不可用，退回系统调用
+pub const VDSO_GETCPU_NONE: u32 = 0;
+/// getcpu快速路径：rdtscp读出IA32_TSC_AUX中的cpu号
+pub const VDSO_GETCPU_RDTSCP: u32 = 1;
+
+#[repr(C)]
+#[derive(Debug)]
+struct VdsoTimestamp {
+    sec: AtomicU64,
+    nsec: AtomicU64,
+}
+
+/// 与用户态共享的vDSO数据页
+#[repr(C)]
+#[derive(Debug)]
+pub struct VdsoData {
+    seq: AtomicU32,
+    clock_mode: AtomicU32,
+    cycle_last: AtomicU64,
+    mask: AtomicU64,
+    mult: AtomicU32,
+    shift: AtomicU32,
+    basetime: [VdsoTimestamp; VDSO_BASES],
+    tz_minuteswest: AtomicI32,
+    tz_dsttime: AtomicI32,
+    getcpu_mode: AtomicU32,
+}
+
+const _: () = assert!(size_of::<VdsoData>() == 176);
+
+/// timekeeper发布给vDSO的换算参数，时间基准都是`cycle_last`时刻的值（纳秒）
+#[derive(Debug)]
+pub struct VsyscallTime {
+    pub clock_mode: VdsoClockMode,
+    pub cycle_last: u64,
+    pub mask: u64,
+    pub mult: u32,
+    pub shift: u32,
+    pub realtime: ktime_t,
+    pub monotonic: ktime_t,
+    pub boottime: ktime_t,
+}
+
+static VDSO_DATA: AtomicPtr<VdsoData> = AtomicPtr::new(null_mut());
+
+impl VdsoData {
+    /// 开始更新，之后用户态读到奇数seq会等待
+    fn write_begin(&self) {
+        let seq = self.seq.load(Ordering::Relaxed);
+        self.seq.store(seq.wrapping_add(1), Ordering::Relaxed);
+        fence(Ordering::Release);
+    }
+
+    fn write_end(&self) {
+        fence(Ordering::Release);
+        let seq = self.seq.load(Ordering::Relaxed);
+        self.seq.store(seq.wrapping_add(1), Ordering::Relaxed);
+    }
+
+    fn set_base(&self, clock: PosixClockID, ns: ktime_t) {
+        let base = &self.basetime[clock.raw_value() as usize];
+        base.sec
+            .store(ns.div_euclid(NSEC_PER_SEC as i64) as u64, Ordering::Relaxed);
+        base.nsec
+            .store(ns.rem_euclid(NSEC_PER_SEC as i64) as u64, Ordering::Relaxed);
+    }
+}
+
+#[inline]
+fn vdso_data() -> Option<&'static VdsoData> {
+    let ptr = VDSO_DATA.load(Ordering::Acquire);
+    if ptr.is_null() {
+        return None;
+    }
+    Some(unsafe { &*ptr })
+}
+
+/// 登记vvar页，`data`指向一个已清零、内核可写的页
+///
+/// 登记之后由调用者通过timekeeping发布一次完整的数据
+pub fn vdso_data_register(data: &'static VdsoData, tz: &PosixTimeZone, getcpu_mode: u32) {
+    data.tz_minuteswest
+        .store(tz.tz_minuteswest, Ordering::Relaxed);
+    data.tz_dsttime.store(tz.tz_dsttime, Ordering::Relaxed);
+    data.getcpu_mode.store(getcpu_mode, Ordering::Relaxed);
+    VDSO_DATA.store(data as *const VdsoData as *mut VdsoData, Ordering::Release);
+}
+
+/// 发布新的换算参数（持有timekeeper写锁）
+pub fn update_vsyscall(t: &VsyscallTime) {
+    let Some(vd) = vdso_data() else {
+        return;
+    };
+    vd.write_begin();
+    vd.clock_mode.store(t.clock_mode as u32, Ordering::Relaxed);
+    vd.cycle_last.store(t.cycle_last, Ordering::Relaxed);
+    vd.mask.store(t.mask, Ordering::Relaxed);
+    vd.mult.store(t.mult, Ordering::Relaxed);
+    vd.shift.store(t.shift, Ordering::Relaxed);
+    vd.set_base(PosixClockID::Realtime, t.realtime);
+    vd.set_base(PosixClockID::Monotonic, t.monotonic);
+    // 与posix_clock_now一致，MONOTONIC_RAW暂时等同于MONOTONIC
+    vd.set_base(PosixClockID::MonotonicRaw, t.monotonic);
+    vd.set_base(PosixClockID::Boottime, t.boottime);
+    vd.set_base(PosixClockID::RealtimeCoarse, t.realtime);
+    vd.set_base(PosixClockID::MonotonicCoarse, t.monotonic);
+    vd.write_end();
+}
+
+/// 刷新COARSE时钟和time()使用的快照，每个tick调用一次（持有timekeeper写锁）
+pub fn update_vsyscall_coarse(realtime: ktime_t, monotonic: ktime_t) {
+    let Some(vd) = vdso_data() else {
+        return;
+    };
+    vd.write_begin();
+    vd.set_base(PosixClockID::RealtimeCoarse, realtime);
+    vd.set_base(PosixClockID::MonotonicCoarse, monotonic);
+    vd.write_end();
+}
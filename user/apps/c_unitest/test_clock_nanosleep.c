@@ -184,6 +184,73 @@ static int test_rel_interrupt_with_restart(void)
     return 0;
 }
 
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static long env_long(const char *name, long def)
+{
+    const char *env = getenv(name);
+    if (env && *env && atol(env) > 0) return atol(env);
+    return def;
+}
+
+/*
+ * 唤醒延迟：按固定周期做绝对时刻的CLOCK_MONOTONIC睡眠，统计每次醒来时刻相对deadline的延迟。
+ * 高精度定时器下延迟在几十微秒量级，按tick检查时约为半个到一个tick。
+ *
+ * 环境变量：
+ *   CLOCK_NANOSLEEP_LAT_ITERS   采样次数，默认200
+ *   CLOCK_NANOSLEEP_LAT_US      睡眠周期，默认1000us
+ *   CLOCK_NANOSLEEP_LAT_P50_US  p50上限，设置时才检查（默认只报告）
+ */
+static int test_wakeup_lateness(void)
+{
+    long iters = env_long("CLOCK_NANOSLEEP_LAT_ITERS", 200);
+    long period_us = env_long("CLOCK_NANOSLEEP_LAT_US", 1000);
+    long p50_max_us = env_long("CLOCK_NANOSLEEP_LAT_P50_US", 0);
+    int64_t *lat = calloc((size_t)iters, sizeof(int64_t));
+    if (!lat) return -1;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    int early = 0;
+    for (long i = 0; i < iters; i++) {
+        next.tv_nsec += period_us * 1000L;
+        while (next.tv_nsec >= 1000000000L) { next.tv_sec += 1; next.tv_nsec -= 1000000000L; }
+        int r = do_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (r != 0) {
+            perror("clock_nanosleep lateness");
+            free(lat);
+            return -1;
+        }
+        lat[i] = (int64_t)(now.tv_sec - next.tv_sec) * 1000000000LL + (now.tv_nsec - next.tv_nsec);
+        if (lat[i] < 0) early++;
+        /* 睡过了头时从当前时刻重新对齐，避免后续deadline全部落在过去 */
+        if (lat[i] > period_us * 1000L) next = now;
+    }
+
+    qsort(lat, (size_t)iters, sizeof(int64_t), cmp_i64);
+    int64_t p50 = lat[iters * 50 / 100];
+    int64_t p90 = lat[iters * 90 / 100];
+    int64_t p99 = lat[iters * 99 / 100];
+    int64_t max = lat[iters - 1];
+    fprintf(stderr, "[lateness] %ld x %ldus: p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus early=%d\n",
+            iters, period_us, p50 / 1e3, p90 / 1e3, p99 / 1e3, max / 1e3, early);
+    free(lat);
+
+    if (early) { fprintf(stderr, "lateness: %d wakeups before the deadline\n", early); return -1; }
+    if (p50_max_us && p50 > p50_max_us * 1000L) {
+        fprintf(stderr, "lateness: p50 %.1fus exceeds %ldus\n", p50 / 1e3, p50_max_us);
+        return -1;
+    }
+    return 0;
+}
+
 static int test_abs_interrupt_eintr(void)
 {
     struct sigaction sa; memset(&sa, 0, sizeof(sa));
@@ -227,6 +294,10 @@ int main(void)
     if (test_abs_interrupt_eintr() == 0) print_pass("clock_nanosleep: abs EINTR");
     else { print_failed("clock_nanosleep: abs EINTR"); fails++; }
 
+    print_run("clock_nanosleep: wakeup lateness percentiles");
+    if (test_wakeup_lateness() == 0) print_pass("clock_nanosleep: wakeup lateness percentiles");
+    else { print_failed("clock_nanosleep: wakeup lateness percentiles"); fails++; }
+
     // 等待所有信号线程完成
     for (int i = 0; i < g_thread_count; i++) {
         void *retval;
@@ -7,6 +7,7 @@
 #include <time.h>
 #include <errno.h>
 #include <stdint.h>
+#include <linux/futex.h>
 
 #define FUTEX_WAIT_REQUEUE_PI 11
 #define FUTEX_CMP_REQUEUE_PI 12
@@ -15,12 +16,151 @@ static long futex(uint32_t *uaddr, int futex_op, uint32_t val, const struct time
     return syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
 }
 
-int main() {
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#define BENCH_PROCS 4
+#define BENCH_WAKE_ITERS 200000
+#define BENCH_PINGPONG_ITERS 20000
+
+/*
+ * 多个进程各自对不同的共享futex做没有等待者的FUTEX_WAKE。
+ * 这条路径只检查槽位上的等待者计数，不应该互相争锁。
+ */
+static int bench_wake_no_waiters(void) {
+    uint32_t *words = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (words == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    long long start = now_ns();
+    for (int p = 0; p < BENCH_PROCS; p++) {
+        if (fork() == 0) {
+            uint32_t *w = &words[p * 16];
+            for (int i = 0; i < BENCH_WAKE_ITERS; i++) {
+                if (futex(w, FUTEX_WAKE, 1, NULL, NULL, 0) != 0)
+                    _exit(1);
+            }
+            _exit(0);
+        }
+    }
+
+    int fails = 0;
+    for (int p = 0; p < BENCH_PROCS; p++) {
+        int status;
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            fails++;
+    }
+    long long elapsed = now_ns() - start;
+    printf("Bench: FUTEX_WAKE without waiters, %d procs: %lld ns/op\n", BENCH_PROCS,
+           elapsed / ((long long)BENCH_PROCS * BENCH_WAKE_ITERS));
+    munmap(words, 4096);
+    return fails ? -1 : 0;
+}
+
+/*
+ * 每对进程在各自的共享futex上做wait/wake乒乓，多对同时进行
+ */
+static int bench_ping_pong(void) {
+    uint32_t *words = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (words == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    long long start = now_ns();
+    for (int p = 0; p < BENCH_PROCS * 2; p++) {
+        if (fork() == 0) {
+            uint32_t *w = &words[(p / 2) * 16];
+            // 偶数进程把值从0改成1，奇数进程把值从1改回0
+            uint32_t mine = p % 2, next = !mine;
+            for (int i = 0; i < BENCH_PINGPONG_ITERS; i++) {
+                while (__atomic_load_n(w, __ATOMIC_ACQUIRE) != mine) {
+                    long r = futex(w, FUTEX_WAIT, next, NULL, NULL, 0);
+                    if (r != 0 && errno != EAGAIN && errno != EINTR)
+                        _exit(1);
+                }
+                __atomic_store_n(w, next, __ATOMIC_RELEASE);
+                futex(w, FUTEX_WAKE, 1, NULL, NULL, 0);
+            }
+            _exit(0);
+        }
+    }
+
+    int fails = 0;
+    for (int p = 0; p < BENCH_PROCS * 2; p++) {
+        int status;
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            fails++;
+    }
+    long long elapsed = now_ns() - start;
+    printf("Bench: wait/wake ping-pong, %d pairs: %lld ns/round trip\n", BENCH_PROCS,
+           elapsed / BENCH_PINGPONG_ITERS);
+    munmap(words, 4096);
+    return fails ? -1 : 0;
+}
+
+/*
+ * FUTEX_CMP_REQUEUE之后，等待者必须真正挂到第二个futex上
+ */
+static int test_requeue(void) {
+    uint32_t *words = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (words == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    uint32_t *f1 = &words[0], *f2 = &words[64], *ready = &words[128];
+
+    for (int p = 0; p < BENCH_PROCS; p++) {
+        if (fork() == 0) {
+            __atomic_fetch_add(ready, 1, __ATOMIC_SEQ_CST);
+            while (futex(f1, FUTEX_WAIT, 0, NULL, NULL, 0) != 0 && errno == EINTR)
+                ;
+            _exit(0);
+        }
+    }
+    while (__atomic_load_n(ready, __ATOMIC_SEQ_CST) != BENCH_PROCS)
+        usleep(1000);
+    // 给子进程留出进入等待的时间
+    usleep(200000);
+
+    int ret = 0;
+    long r = futex(f1, FUTEX_CMP_REQUEUE, 0, (void *)(long)BENCH_PROCS, f2, 0);
+    // 返回值是唤醒与转移的等待者总数
+    if (r != BENCH_PROCS) {
+        printf("Requeue: FUTEX_CMP_REQUEUE returned %ld, expected %d\n", r, BENCH_PROCS);
+        ret = -1;
+    }
+    if (futex(f1, FUTEX_WAKE, BENCH_PROCS, NULL, NULL, 0) != 0) {
+        printf("Requeue: waiters left on the source futex\n");
+        ret = -1;
+    }
+    long woken = futex(f2, FUTEX_WAKE, BENCH_PROCS, NULL, NULL, 0);
+    if (woken != BENCH_PROCS) {
+        printf("Requeue: woke %ld waiters on the target futex, expected %d\n", woken, BENCH_PROCS);
+        ret = -1;
+        // 不让子进程永远挂着
+        futex(f1, FUTEX_WAKE, BENCH_PROCS, NULL, NULL, 0);
+        futex(f2, FUTEX_WAKE, BENCH_PROCS, NULL, NULL, 0);
+    }
+    for (int p = 0; p < BENCH_PROCS; p++)
+        wait(NULL);
+    munmap(words, 4096);
+    return ret;
+}
+
+static int test_robust_list(void) {
     // 创建共享内存区域
     uint32_t *shared_futex = mmap(NULL, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
     if (shared_futex == MAP_FAILED) {
         perror("mmap");
-        exit(1);
+        return -1;
     }
 
     // 初始化futex
@@ -95,8 +235,30 @@ int main() {
         printf("Parent: Done\n");
     } else {
         perror("fork");
-        exit(1);
+        return -1;
     }
-    
+
     return 0;
+}
+
+int main() {
+    int fails = 0;
+
+    // fork之前不能留有未输出的缓冲
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (test_robust_list() != 0)
+        fails++;
+
+    if (test_requeue() == 0)
+        printf("Requeue: PASS\n");
+    else
+        fails++;
+
+    if (bench_wake_no_waiters() != 0)
+        fails++;
+    if (bench_ping_pong() != 0)
+        fails++;
+
+    return fails ? 1 : 0;
 }
\ No newline at end of file
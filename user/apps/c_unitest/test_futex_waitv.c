@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+#ifndef SYS_futex_wake
+#define SYS_futex_wake 454
+#endif
+#ifndef SYS_futex_wait
+#define SYS_futex_wait 455
+#endif
+#ifndef SYS_futex_requeue
+#define SYS_futex_requeue 456
+#endif
+
+#define F2_SIZE_U32 0x02
+#define F2_NUMA 0x04
+#define F2_PRIVATE 128
+
+struct waitv {
+    uint64_t val;
+    uint64_t uaddr;
+    uint32_t flags;
+    uint32_t __reserved;
+};
+
+// test output helpers
+static inline void print_run(const char *name) { fprintf(stderr, "[RUN] %s\n", name); }
+static inline void print_pass(const char *name) { fprintf(stderr, "[PASS] %s\n", name); }
+static inline void print_failed(const char *name) { fprintf(stderr, "[FAILED] %s\n", name); }
+
+static long futex(uint32_t *uaddr, int op, uint32_t val, const void *timeout, uint32_t *uaddr2,
+                  uint32_t val3)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, uaddr2, val3);
+}
+
+static long futex_waitv(struct waitv *w, unsigned int nr, const struct timespec *abs)
+{
+    return syscall(SYS_futex_waitv, w, nr, 0, abs, CLOCK_MONOTONIC);
+}
+
+static void deadline_after_ms(struct timespec *ts, long ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_nsec += ms * 1000000L;
+    ts->tv_sec += ts->tv_nsec / 1000000000L;
+    ts->tv_nsec %= 1000000000L;
+}
+
+static uint32_t words[8] __attribute__((aligned(64)));
+
+static void set_waitv(struct waitv *w, int n)
+{
+    memset(w, 0, sizeof(*w) * n);
+    for (int i = 0; i < n; i++) {
+        w[i].uaddr = (uintptr_t)&words[i];
+        w[i].val = 0;
+        w[i].flags = F2_SIZE_U32 | F2_PRIVATE;
+    }
+}
+
+static int test_waitv_validate(void)
+{
+    struct waitv w[4];
+    set_waitv(w, 4);
+    words[2] = 1;
+    // 任意一个futex的值不匹配时立即返回EAGAIN
+    if (futex_waitv(w, 4, NULL) != -1 || errno != EAGAIN) {
+        fprintf(stderr, "mismatch: expected EAGAIN, errno=%d\n", errno);
+        return -1;
+    }
+    words[2] = 0;
+
+    w[1].flags = 0x03 | F2_PRIVATE;  // u64
+    if (futex_waitv(w, 4, NULL) != -1 || errno != EINVAL) {
+        fprintf(stderr, "u64 size: expected EINVAL, errno=%d\n", errno);
+        return -1;
+    }
+    set_waitv(w, 4);
+    if (futex_waitv(w, 0, NULL) != -1 || errno != EINVAL) {
+        fprintf(stderr, "nr=0: expected EINVAL, errno=%d\n", errno);
+        return -1;
+    }
+
+    struct timespec ts;
+    deadline_after_ms(&ts, 50);
+    if (futex_waitv(w, 4, &ts) != -1 || errno != ETIMEDOUT) {
+        fprintf(stderr, "timeout: expected ETIMEDOUT, errno=%d\n", errno);
+        return -1;
+    }
+    return 0;
+}
+
+static void *wake_third(void *arg)
+{
+    (void)arg;
+    usleep(100000);
+    __atomic_store_n(&words[3], 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex_wake, &words[3], 0xffffffffUL, 1, F2_SIZE_U32 | F2_PRIVATE);
+    return NULL;
+}
+
+static int test_waitv_wake(void)
+{
+    struct waitv w[4];
+    memset(words, 0, sizeof(words));
+    set_waitv(w, 4);
+
+    pthread_t th;
+    pthread_create(&th, NULL, wake_third, NULL);
+    struct timespec ts;
+    deadline_after_ms(&ts, 5000);
+    long r = futex_waitv(w, 4, &ts);
+    pthread_join(th, NULL);
+    if (r != 3) {
+        fprintf(stderr, "waitv returned %ld (errno=%d), expected index 3\n", r, errno);
+        return -1;
+    }
+    return 0;
+}
+
+static int test_futex2_numa(void)
+{
+    // FUTEX2_NUMA：futex字后面紧跟节点号，-1表示不指定
+    static uint32_t pair[2] __attribute__((aligned(8))) = {0, (uint32_t)-1};
+    struct timespec ts;
+    deadline_after_ms(&ts, 20);
+    long r = syscall(SYS_futex_wait, pair, 0UL, 0xffffffffUL, F2_SIZE_U32 | F2_NUMA | F2_PRIVATE,
+                     &ts, CLOCK_MONOTONIC);
+    if (r != -1 || errno != ETIMEDOUT) {
+        fprintf(stderr, "numa wait: expected ETIMEDOUT, errno=%d\n", errno);
+        return -1;
+    }
+    pair[1] = 12345;
+    r = syscall(SYS_futex_wake, pair, 0xffffffffUL, 1, F2_SIZE_U32 | F2_NUMA | F2_PRIVATE);
+    if (r != -1 || errno != EINVAL) {
+        fprintf(stderr, "bad numa node: expected EINVAL, errno=%d\n", errno);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 条件变量广播：等待者都在cond上FUTEX_WAIT_REQUEUE_PI，广播时用FUTEX_CMP_REQUEUE_PI
+ * 把它们转移到PI互斥锁上，之后由解锁逐个交接，不出现惊群
+ */
+#define NR_WAITERS 4
+static uint32_t cond_word;
+static uint32_t pi_mutex;
+static int ready, acquired;
+
+static void *requeue_waiter(void *arg)
+{
+    (void)arg;
+    uint32_t tid = syscall(SYS_gettid);
+    __atomic_fetch_add(&ready, 1, __ATOMIC_SEQ_CST);
+    long r;
+    do {
+        r = futex(&cond_word, FUTEX_WAIT_REQUEUE_PI | FUTEX_PRIVATE_FLAG, 0, NULL, &pi_mutex, 0);
+    } while (r != 0 && errno == EINTR);
+    if (r != 0) {
+        fprintf(stderr, "WAIT_REQUEUE_PI: errno=%d\n", errno);
+        return (void *)1;
+    }
+    if ((__atomic_load_n(&pi_mutex, __ATOMIC_SEQ_CST) & FUTEX_TID_MASK) != tid) {
+        fprintf(stderr, "WAIT_REQUEUE_PI returned without owning the mutex\n");
+        return (void *)1;
+    }
+    __atomic_fetch_add(&acquired, 1, __ATOMIC_SEQ_CST);
+    // 解锁：没有等待者时用户态直接释放，否则交给内核
+    uint32_t expected = tid;
+    if (!__atomic_compare_exchange_n(&pi_mutex, &expected, 0, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_SEQ_CST))
+        futex(&pi_mutex, FUTEX_UNLOCK_PI | FUTEX_PRIVATE_FLAG, 0, NULL, NULL, 0);
+    return NULL;
+}
+
+static int test_requeue_pi(void)
+{
+    pthread_t th[NR_WAITERS];
+    cond_word = 0;
+    pi_mutex = 0;
+    for (int i = 0; i < NR_WAITERS; i++) pthread_create(&th[i], NULL, requeue_waiter, NULL);
+    while (__atomic_load_n(&ready, __ATOMIC_SEQ_CST) != NR_WAITERS) usleep(1000);
+    usleep(200000);
+
+    // 普通的FUTEX_WAKE不能唤醒REQUEUE_PI等待者
+    if (futex(&cond_word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, NULL, 0) != -1 ||
+        errno != EINVAL) {
+        fprintf(stderr, "FUTEX_WAKE on requeue-pi waiters: expected EINVAL, errno=%d\n", errno);
+        return -1;
+    }
+
+    long r = futex(&cond_word, FUTEX_CMP_REQUEUE_PI | FUTEX_PRIVATE_FLAG, 1,
+                   (void *)(long)NR_WAITERS, &pi_mutex, 0);
+    if (r != NR_WAITERS) {
+        fprintf(stderr, "CMP_REQUEUE_PI returned %ld (errno=%d), expected %d\n", r, errno,
+                NR_WAITERS);
+        return -1;
+    }
+
+    int fails = 0;
+    for (int i = 0; i < NR_WAITERS; i++) {
+        void *ret;
+        pthread_join(th[i], &ret);
+        if (ret) fails++;
+    }
+    if (fails || acquired != NR_WAITERS || pi_mutex != 0) {
+        fprintf(stderr, "requeue-pi: %d failures, %d acquired, mutex=%#x\n", fails, acquired,
+                pi_mutex);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    if (syscall(SYS_futex_waitv, NULL, 0, 0, NULL, 0) == -1 && errno == ENOSYS) {
+        fprintf(stderr, "futex_waitv not supported, skip\n");
+        return 0;
+    }
+
+    print_run("futex_waitv: validation and timeout");
+    if (test_waitv_validate() == 0) print_pass("futex_waitv: validation and timeout");
+    else { print_failed("futex_waitv: validation and timeout"); fails++; }
+
+    print_run("futex_waitv: woken by futex_wake");
+    if (test_waitv_wake() == 0) print_pass("futex_waitv: woken by futex_wake");
+    else { print_failed("futex_waitv: woken by futex_wake"); fails++; }
+
+    print_run("futex2: NUMA node word");
+    if (test_futex2_numa() == 0) print_pass("futex2: NUMA node word");
+    else { print_failed("futex2: NUMA node word"); fails++; }
+
+    print_run("futex: CMP_REQUEUE_PI condvar broadcast");
+    if (test_requeue_pi() == 0) print_pass("futex: CMP_REQUEUE_PI condvar broadcast");
+    else { print_failed("futex: CMP_REQUEUE_PI condvar broadcast"); fails++; }
+
+    return fails == 0 ? 0 : 1;
+}
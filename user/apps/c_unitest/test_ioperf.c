@@ -30,6 +30,17 @@ struct options {
     int time_sec;
     int fsync_end;
     uint64_t seed;
+    int fadvise;
+    int drop_cache;
+    int ra_stats;
+};
+
+/* /proc/vmstat 中的文件预读计数器 */
+struct ra_stats {
+    long long ra_pages;
+    long long ra_sync;
+    long long ra_async;
+    long long ra_stall;
 };
 
 struct thread_ctx {
@@ -88,6 +99,62 @@ static int parse_mode(const char *s, enum io_mode *out)
     return -1;
 }
 
+static int parse_fadvise(const char *s, int *out)
+{
+    if (strcmp(s, "normal") == 0) {
+        *out = POSIX_FADV_NORMAL;
+        return 0;
+    }
+    if (strcmp(s, "random") == 0) {
+        *out = POSIX_FADV_RANDOM;
+        return 0;
+    }
+    if (strcmp(s, "sequential") == 0) {
+        *out = POSIX_FADV_SEQUENTIAL;
+        return 0;
+    }
+    return -1;
+}
+
+static long long vmstat_read(const char *name)
+{
+    static char buf[16384];
+    int fd = open("/proc/vmstat", O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t off = 0;
+    while (off < sizeof(buf) - 1) {
+        ssize_t n = read(fd, buf + off, sizeof(buf) - 1 - off);
+        if (n <= 0) {
+            break;
+        }
+        off += (size_t)n;
+    }
+    close(fd);
+    buf[off] = '\0';
+
+    size_t len = strlen(name);
+    for (char *line = buf; line != NULL && *line != '\0';) {
+        if (strncmp(line, name, len) == 0 && line[len] == ' ') {
+            return strtoll(line + len + 1, NULL, 10);
+        }
+        line = strchr(line, '\n');
+        if (line != NULL) {
+            line++;
+        }
+    }
+    return -1;
+}
+
+static void ra_stats_snapshot(struct ra_stats *st)
+{
+    st->ra_pages = vmstat_read("file_ra");
+    st->ra_sync = vmstat_read("file_ra_sync");
+    st->ra_async = vmstat_read("file_ra_async");
+    st->ra_stall = vmstat_read("file_ra_stall");
+}
+
 static int parse_u64(const char *s, uint64_t *out)
 {
     errno = 0;
@@ -160,12 +227,17 @@ static void print_usage(FILE *out)
             "  -t, --time SEC          run time-based (override size loop)\n"
             "      --fsync             fsync at end (default off)\n"
             "      --seed N            random seed (default 1)\n"
+            "      --fadvise ADVICE    posix_fadvise each fd: normal | random | sequential\n"
+            "      --drop-cache        drop the file's page cache before reading\n"
+            "      --ra-stats          report readahead counters from /proc/vmstat\n"
             "  -h, --help              show help\n"
             "\n"
             "Examples:\n"
             "  test_ioperf -f /tmp/t.dat -r write --bs 128K --size 512M\n"
             "  test_ioperf -f /tmp/t.dat -r read  --bs 4K --jobs 4\n"
-            "  test_ioperf -f /tmp/t.dat -r randread --bs 4K --time 5\n");
+            "  test_ioperf -f /tmp/t.dat -r randread --bs 4K --time 5\n"
+            "  test_ioperf -f /tmp/t.dat -r read  --bs 4K --drop-cache --ra-stats\n"
+            "  test_ioperf -f /tmp/t.dat -r read  --bs 4K --drop-cache --ra-stats --fadvise random\n");
 }
 
 static int open_file_for_mode(const struct options *opt)
@@ -302,6 +374,17 @@ static void *worker(void *arg)
         return NULL;
     }
 
+    if (ctx->opt.fadvise >= 0) {
+        int rc = posix_fadvise(fd, 0, 0, ctx->opt.fadvise);
+        if (rc != 0) {
+            ctx->err = rc;
+            ctx->err_op = "posix_fadvise";
+            free(buf);
+            close(fd);
+            return NULL;
+        }
+    }
+
     unsigned char pat = (unsigned char)(0xA5u ^ (unsigned char)ctx->tid);
     memset(buf, pat, ctx->opt.bs);
 
@@ -504,6 +587,15 @@ static int normalize_options(struct options *opt, uint64_t *file_size_inout, uin
         }
     }
 
+    if (opt->drop_cache) {
+        /* 只有干净页会被丢弃，先把脏页写回 */
+        if (fsync(fd) != 0 || posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+            fprintf(stderr, "drop cache failed: %s\n", strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+
     close(fd);
 
     *file_size_inout = file_size;
@@ -521,6 +613,7 @@ int main(int argc, char **argv)
     opt.time_sec = 0;
     opt.fsync_end = 0;
     opt.seed = 1;
+    opt.fadvise = -1;
 
     static struct option long_opts[] = {
         {"file", required_argument, NULL, 'f'},
@@ -531,6 +624,9 @@ int main(int argc, char **argv)
         {"time", required_argument, NULL, 't'},
         {"fsync", no_argument, NULL, 1000},
         {"seed", required_argument, NULL, 1001},
+        {"fadvise", required_argument, NULL, 1002},
+        {"drop-cache", no_argument, NULL, 1003},
+        {"ra-stats", no_argument, NULL, 1004},
         {"help", no_argument, NULL, 'h'},
         {0, 0, 0, 0},
     };
@@ -589,6 +685,18 @@ int main(int argc, char **argv)
                 return 2;
             }
             break;
+        case 1002:
+            if (parse_fadvise(optarg, &opt.fadvise) != 0) {
+                fprintf(stderr, "invalid --fadvise: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 1003:
+            opt.drop_cache = 1;
+            break;
+        case 1004:
+            opt.ra_stats = 1;
+            break;
         case 'h':
             print_usage(stdout);
             return 0;
@@ -617,6 +725,9 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    struct ra_stats ra_before;
+    ra_stats_snapshot(&ra_before);
+
     pthread_barrier_t barrier;
     if (pthread_barrier_init(&barrier, NULL, (unsigned)opt.jobs) != 0) {
         fprintf(stderr, "pthread_barrier_init failed\n");
@@ -678,6 +789,9 @@ int main(int argc, char **argv)
         }
     }
 
+    struct ra_stats ra_after;
+    ra_stats_snapshot(&ra_after);
+
     pthread_barrier_destroy(&barrier);
     free(threads);
     free(ctxs);
@@ -708,5 +822,16 @@ int main(int argc, char **argv)
     printf("mode=%s file=%s jobs=%d bs=%zuB\n", mode_str(opt.mode), opt.path, opt.jobs, opt.bs);
     printf("bytes=%" PRIu64 " ops=%" PRIu64 " time=%.6f s\n", total_bytes, total_ops, elapsed);
     printf("bw=%.2f MiB/s iops=%.2f avg_lat=%.2f us\n", bw, iops, avg_lat_us);
+    if (opt.ra_stats) {
+        if (ra_before.ra_pages < 0 || ra_after.ra_pages < 0) {
+            printf("readahead: counters not available in /proc/vmstat\n");
+        } else {
+            long long stalls = ra_after.ra_stall - ra_before.ra_stall;
+            printf("readahead: pages=%lld sync=%lld async=%lld stalls=%lld (%.2f per MiB)\n",
+                   ra_after.ra_pages - ra_before.ra_pages, ra_after.ra_sync - ra_before.ra_sync,
+                   ra_after.ra_async - ra_before.ra_async, stalls,
+                   mib > 0 ? (double)stalls / mib : 0.0);
+        }
+    }
     return 0;
 }
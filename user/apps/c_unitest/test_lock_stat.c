@@ -0,0 +1,196 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SYSCTL_PATH "/proc/sys/kernel/lock_stat"
+#define STAT_PATH "/proc/lock_stat"
+#define NR_THREADS 4
+
+// test output helpers
+static inline void print_run(const char *name) { fprintf(stderr, "[RUN] %s\n", name); }
+static inline void print_pass(const char *name) { fprintf(stderr, "[PASS] %s\n", name); }
+static inline void print_failed(const char *name) { fprintf(stderr, "[FAILED] %s\n", name); }
+
+static int write_str(const char *path, const char *s)
+{
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -errno;
+    ssize_t n = write(fd, s, strlen(s));
+    int err = n < 0 ? -errno : 0;
+    close(fd);
+    return err;
+}
+
+static ssize_t read_all(const char *path, char *buf, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -errno;
+    size_t off = 0;
+    while (off + 1 < size) {
+        ssize_t n = read(fd, buf + off, size - 1 - off);
+        if (n <= 0) break;
+        off += n;
+    }
+    buf[off] = '\0';
+    close(fd);
+    return off;
+}
+
+/*
+ * 解析 /proc/lock_stat，返回所有类别的加锁次数之和；*classes 为类别数
+ */
+static long long sum_acquisitions(int *classes)
+{
+    static char buf[1 << 20];
+    if (read_all(STAT_PATH, buf, sizeof(buf)) < 0) return -1;
+
+    long long total = 0;
+    int n = 0;
+    char *save = NULL;
+    char *line = strtok_r(buf, "\n", &save);
+    if (!line || strncmp(line, "class", 5) != 0) {
+        fprintf(stderr, "lock_stat: missing header\n");
+        return -1;
+    }
+    while ((line = strtok_r(NULL, "\n", &save)) != NULL) {
+        char site[512], type[16];
+        long long acq, cont, spin, sleep, spin_us, sleep_us;
+        if (sscanf(line, "%511s %15s %lld %lld %lld %lld %lld %lld", site, type, &acq, &cont,
+                   &spin, &sleep, &spin_us, &sleep_us) != 8) {
+            fprintf(stderr, "lock_stat: bad line '%s'\n", line);
+            return -1;
+        }
+        if (strcmp(type, "mutex") != 0 && strcmp(type, "rwsem") != 0) {
+            fprintf(stderr, "lock_stat: bad type '%s'\n", type);
+            return -1;
+        }
+        if (spin + sleep > cont) {
+            fprintf(stderr, "lock_stat: %s slow-path acquisitions exceed contentions\n", site);
+            return -1;
+        }
+        total += acq;
+        n++;
+    }
+    if (classes) *classes = n;
+    return total;
+}
+
+static int test_sysctl(void)
+{
+    char buf[16];
+    if (write_str(SYSCTL_PATH, "1") != 0) {
+        perror("enable lock_stat");
+        return -1;
+    }
+    if (read_all(SYSCTL_PATH, buf, sizeof(buf)) < 0 || buf[0] != '1') {
+        fprintf(stderr, "sysctl: expected 1, got '%s'\n", buf);
+        return -1;
+    }
+    if (write_str(SYSCTL_PATH, "2") != -EINVAL) {
+        fprintf(stderr, "sysctl: invalid value accepted\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 多个线程在同一地址空间里反复mmap/munmap并读写同一个文件，制造内核休眠锁上的争用
+ */
+static void *worker(void *arg)
+{
+    const char *path = arg;
+    char buf[256];
+    for (int i = 0; i < 2000; i++) {
+        void *p = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            *(volatile char *)p = 1;
+            munmap(p, 4096);
+        }
+        int fd = open(path, O_RDWR);
+        if (fd >= 0) {
+            pwrite(fd, buf, sizeof(buf), (i % 16) * sizeof(buf));
+            pread(fd, buf, sizeof(buf), 0);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+static int test_collect(void)
+{
+    char path[] = "/tmp/lock_stat_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+
+    pthread_t th[NR_THREADS];
+    for (int i = 0; i < NR_THREADS; i++) pthread_create(&th[i], NULL, worker, path);
+    for (int i = 0; i < NR_THREADS; i++) pthread_join(th[i], NULL);
+    unlink(path);
+
+    int classes = 0;
+    long long total = sum_acquisitions(&classes);
+    fprintf(stderr, "[collect] %d classes, %lld acquisitions\n", classes, total);
+    if (total <= 0 || classes == 0) {
+        fprintf(stderr, "collect: no lock activity recorded\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int test_clear(void)
+{
+    long long before = sum_acquisitions(NULL);
+    if (write_str(STAT_PATH, "0") != 0) {
+        perror("clear lock_stat");
+        return -1;
+    }
+    long long after = sum_acquisitions(NULL);
+    fprintf(stderr, "[clear] acquisitions %lld -> %lld\n", before, after);
+    // 清零之后到再次读取之间仍会有少量加锁
+    if (after < 0 || after >= before) {
+        fprintf(stderr, "clear: counters were not reset\n");
+        return -1;
+    }
+    if (write_str(STAT_PATH, "1") != -EINVAL) {
+        fprintf(stderr, "clear: only 0 should be accepted\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    struct stat st;
+
+    if (stat(SYSCTL_PATH, &st) != 0 || stat(STAT_PATH, &st) != 0) {
+        fprintf(stderr, "lock_stat not supported, skip\n");
+        return 0;
+    }
+
+    print_run("lock_stat: sysctl switch");
+    if (test_sysctl() == 0) print_pass("lock_stat: sysctl switch");
+    else { print_failed("lock_stat: sysctl switch"); fails++; }
+
+    print_run("lock_stat: contention is recorded");
+    if (test_collect() == 0) print_pass("lock_stat: contention is recorded");
+    else { print_failed("lock_stat: contention is recorded"); fails++; }
+
+    print_run("lock_stat: clear");
+    if (test_clear() == 0) print_pass("lock_stat: clear");
+    else { print_failed("lock_stat: clear"); fails++; }
+
+    write_str(SYSCTL_PATH, "0");
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 无tick（nohz）测试
+ *
+ * 1. 绑定到一个cpu上忙循环读取CLOCK_MONOTONIC，统计相邻两次读取之间的最大间隔和超过
+ *    阈值的次数。该cpu在nohz_full=列表中时，间隔主要来自每秒一次的残余tick。
+ * 2. 检查忙循环期间线程cpu时间与墙上时间基本一致，停tick之后跳过的tick必须被补记。
+ * 3. 在停了tick的空闲cpu上睡眠，检查定时器仍能按时唤醒，且/proc/stat中的idle时间在增长。
+ *
+ * 环境变量：
+ *   NOHZ_CPU     忙循环绑定的cpu，默认为最后一个在线cpu
+ *   NOHZ_SECONDS 忙循环时间，默认2秒
+ */
+
+#define JITTER_THRESHOLD_NS 10000LL
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static int64_t clock_ns(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int env_int(const char *name, int def) {
+    const char *env = getenv(name);
+    if (env && atoi(env) >= 0 && *env) {
+        return atoi(env);
+    }
+    return def;
+}
+
+/* 读取/proc/stat中所有cpu的idle+iowait时间（USER_HZ） */
+static long long read_idle_ticks(void) {
+    FILE *fp = fopen("/proc/stat", "r");
+    if (!fp) {
+        return -1;
+    }
+    long long user, nice, system, idle, iowait;
+    int n = fscanf(fp, "cpu %lld %lld %lld %lld %lld", &user, &nice, &system,
+                   &idle, &iowait);
+    fclose(fp);
+    return n == 5 ? idle + iowait : -1;
+}
+
+static void test_busy_loop(int cpu, int seconds) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    char msg[128];
+    snprintf(msg, sizeof(msg), "pin busy loop to cpu %d", cpu);
+    CHECK(sched_setaffinity(0, sizeof(set), &set) == 0, msg);
+
+    int64_t start = clock_ns(CLOCK_MONOTONIC);
+    int64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    int64_t end = start + (int64_t)seconds * 1000000000LL;
+    int64_t prev = start;
+    int64_t max_gap = 0;
+    long nr_gaps = 0;
+    long nr_reads = 0;
+    for (;;) {
+        int64_t now = clock_ns(CLOCK_MONOTONIC);
+        int64_t gap = now - prev;
+        if (gap > max_gap) {
+            max_gap = gap;
+        }
+        if (gap > JITTER_THRESHOLD_NS) {
+            nr_gaps++;
+        }
+        prev = now;
+        nr_reads++;
+        if (now >= end) {
+            break;
+        }
+    }
+    int64_t wall = clock_ns(CLOCK_MONOTONIC) - start;
+    int64_t cputime = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+
+    printf("busy loop on cpu %d: %ld reads, %ld gaps > %lld us (%.1f/s), max gap %.1f us\n",
+           cpu, nr_reads, nr_gaps, JITTER_THRESHOLD_NS / 1000,
+           (double)nr_gaps * 1e9 / (double)wall, (double)max_gap / 1000.0);
+    printf("busy loop cputime %.3f s over %.3f s wall\n", (double)cputime / 1e9,
+           (double)wall / 1e9);
+
+    CHECK(nr_reads > 0 && wall >= (int64_t)seconds * 1000000000LL,
+          "monotonic clock advances during busy loop");
+    /* tick粒度的记账误差加上残余tick之间补记的延迟，允许20%的偏差 */
+    CHECK(cputime >= wall * 8 / 10 && cputime <= wall * 12 / 10,
+          "thread cputime tracks wall time while the tick may be stopped");
+}
+
+static void test_idle_timers(void) {
+    long long idle_before = read_idle_ticks();
+    int64_t worst = 0;
+    for (int i = 0; i < 10; i++) {
+        struct timespec req = {.tv_sec = 0, .tv_nsec = 50 * 1000000L};
+        int64_t t0 = clock_ns(CLOCK_MONOTONIC);
+        nanosleep(&req, NULL);
+        int64_t late = clock_ns(CLOCK_MONOTONIC) - t0 - req.tv_nsec;
+        if (late > worst) {
+            worst = late;
+        }
+    }
+    long long idle_after = read_idle_ticks();
+
+    printf("50ms nanosleep worst overshoot %.2f ms\n", (double)worst / 1e6);
+    CHECK(worst >= 0, "nanosleep does not return early");
+    CHECK(worst < 20 * 1000000LL, "timers still fire on time with tickless idle");
+    if (idle_before >= 0 && idle_after >= 0) {
+        CHECK(idle_after > idle_before, "idle time keeps accumulating with the tick stopped");
+    }
+}
+
+int main(void) {
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int cpu = env_int("NOHZ_CPU", ncpu > 0 ? ncpu - 1 : 0);
+    int seconds = env_int("NOHZ_SECONDS", 2);
+    if (seconds <= 0) {
+        seconds = 1;
+    }
+
+    printf("nohz: %d CPUs online\n", ncpu);
+    test_busy_loop(cpu, seconds);
+    test_idle_timers();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+// ==============================================
+//
+//              本文件用于测试页帧分配在多CPU上的扩展性。
+//              每个线程绑定到一个CPU，反复 mmap 匿名内存、
+//              逐页写入触发缺页、再 munmap 释放，
+//              统计 1..N 个CPU并发时每秒分配的页帧数。
+//
+//              可通过环境变量 PAGE_ALLOC_ROUNDS 调整每个线程的轮数。
+//
+// ==============================================
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+#define PAGES_PER_ROUND 256
+#define DEFAULT_ROUNDS 200
+
+struct worker_ctx {
+    pthread_t tid;
+    int cpu;
+    int rounds;
+    atomic_int *start;
+    uint64_t pages;
+    int failed;
+};
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *worker(void *arg) {
+    struct worker_ctx *ctx = (struct worker_ctx *)arg;
+    const size_t len = (size_t)PAGES_PER_ROUND * PAGE_SIZE;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(ctx->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        // 绑核失败不影响测试，只是结果可能不够准确
+        printf("[WARN] sched_setaffinity(cpu=%d) failed: errno=%d(%s)\n",
+               ctx->cpu, errno, strerror(errno));
+    }
+
+    while (atomic_load_explicit(ctx->start, memory_order_acquire) == 0) {
+        sched_yield();
+    }
+
+    for (int r = 0; r < ctx->rounds; r++) {
+        volatile unsigned char *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            printf("[FAIL] mmap failed: errno=%d(%s)\n", errno, strerror(errno));
+            ctx->failed = 1;
+            return NULL;
+        }
+        for (size_t off = 0; off < len; off += PAGE_SIZE) {
+            p[off] = (unsigned char)r;
+        }
+        munmap((void *)p, len);
+        ctx->pages += PAGES_PER_ROUND;
+    }
+    return NULL;
+}
+
+static int run_with_threads(int nr_threads, int rounds, double *pages_per_sec) {
+    struct worker_ctx *ctxs = calloc(nr_threads, sizeof(*ctxs));
+    atomic_int start = 0;
+    if (!ctxs) {
+        printf("[FAIL] calloc failed\n");
+        return -1;
+    }
+
+    for (int i = 0; i < nr_threads; i++) {
+        ctxs[i].cpu = i;
+        ctxs[i].rounds = rounds;
+        ctxs[i].start = &start;
+        if (pthread_create(&ctxs[i].tid, NULL, worker, &ctxs[i]) != 0) {
+            printf("[FAIL] pthread_create failed\n");
+            atomic_store_explicit(&start, 1, memory_order_release);
+            for (int j = 0; j < i; j++) {
+                pthread_join(ctxs[j].tid, NULL);
+            }
+            free(ctxs);
+            return -1;
+        }
+    }
+
+    int64_t begin = now_ns();
+    atomic_store_explicit(&start, 1, memory_order_release);
+
+    uint64_t total_pages = 0;
+    int failed = 0;
+    for (int i = 0; i < nr_threads; i++) {
+        pthread_join(ctxs[i].tid, NULL);
+        total_pages += ctxs[i].pages;
+        failed |= ctxs[i].failed;
+    }
+    int64_t elapsed = now_ns() - begin;
+    free(ctxs);
+
+    if (failed) {
+        return -1;
+    }
+    *pages_per_sec = elapsed > 0 ? (double)total_pages * 1e9 / (double)elapsed : 0.0;
+    return 0;
+}
+
+int main(void) {
+    int rounds = DEFAULT_ROUNDS;
+    const char *env = getenv("PAGE_ALLOC_ROUNDS");
+    if (env && env[0]) {
+        int parsed = atoi(env);
+        if (parsed > 0) {
+            rounds = parsed;
+        }
+    }
+
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1) {
+        ncpus = 1;
+    }
+
+    printf("page alloc scaling: %d rounds x %d pages per thread, %ld cpus\n",
+           rounds, PAGES_PER_ROUND, ncpus);
+    printf("%8s %16s %10s\n", "threads", "pages/sec", "speedup");
+
+    double base = 0.0;
+    for (int n = 1; n <= ncpus; n++) {
+        double pps = 0.0;
+        if (run_with_threads(n, rounds, &pps) != 0) {
+            printf("[FAIL] run with %d threads failed\n", n);
+            return 1;
+        }
+        if (n == 1) {
+            base = pps;
+        }
+        printf("%8d %16.0f %9.2fx\n", n, pps, base > 0 ? pps / base : 0.0);
+    }
+
+    printf("[PASS] page alloc scaling\n");
+    return 0;
+}
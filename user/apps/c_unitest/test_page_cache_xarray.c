@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 页缓存XArray索引测试
+ *
+ * 1. 在相距很远的页索引上写入数据（让基数树增长到多层），读回校验并截断；
+ * 2. 另一个线程不停写入同一个文件时，fsync 仍能在有限时间内完成
+ *    （只回写开始时打上 TOWRITE 标记的页面）；
+ * 3. 多个线程并发读取已缓存的页面（无锁查找路径），数据保持一致。
+ */
+
+#define TEST_FILE "page_cache_xarray_test.dat"
+#define PAGE 4096
+#define HOT_PAGES 64
+#define READERS 4
+#define READ_ROUNDS 200
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fill_page(char *page, unsigned long idx) {
+    for (int i = 0; i < PAGE; i += (int)sizeof(idx)) {
+        memcpy(page + i, &idx, sizeof(idx));
+    }
+}
+
+static void test_sparse(void) {
+    /* 索引跨越 1、2、3 层树高 */
+    static const unsigned long indices[] = {0, 1, 63, 64, 4095, 4096, 300000};
+    const int n = sizeof(indices) / sizeof(indices[0]);
+    char page[PAGE], back[PAGE];
+
+    int fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0, "create sparse file");
+    if (fd < 0) {
+        return;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        fill_page(page, indices[i]);
+        ok &= pwrite(fd, page, PAGE, (off_t)indices[i] * PAGE) == PAGE;
+    }
+    CHECK(ok, "write pages at sparse indices");
+
+    ok = 1;
+    for (int i = 0; i < n; i++) {
+        fill_page(page, indices[i]);
+        ok &= pread(fd, back, PAGE, (off_t)indices[i] * PAGE) == PAGE &&
+              memcmp(page, back, PAGE) == 0;
+    }
+    CHECK(ok, "sparse pages read back");
+
+    memset(page, 0, PAGE);
+    CHECK(pread(fd, back, PAGE, 100L * PAGE) == PAGE &&
+              memcmp(page, back, PAGE) == 0,
+          "hole reads as zeros");
+    CHECK(fsync(fd) == 0, "fsync sparse file");
+
+    CHECK(ftruncate(fd, 64L * PAGE) == 0, "truncate below the far pages");
+    struct stat st;
+    CHECK(fstat(fd, &st) == 0 && st.st_size == 64L * PAGE,
+          "size after truncate");
+    fill_page(page, 63);
+    CHECK(pread(fd, back, PAGE, 63L * PAGE) == PAGE &&
+              memcmp(page, back, PAGE) == 0,
+          "page below truncation point kept");
+    CHECK(pread(fd, back, PAGE, 4096L * PAGE) == 0,
+          "read past truncation point returns EOF");
+
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+static atomic_int g_stop;
+
+static void *writer_thread(void *arg) {
+    int fd = *(int *)arg;
+    char page[PAGE];
+    unsigned long gen = 0;
+    while (!atomic_load(&g_stop)) {
+        fill_page(page, gen);
+        if (pwrite(fd, page, PAGE, (off_t)(gen % HOT_PAGES) * PAGE) != PAGE) {
+            break;
+        }
+        gen++;
+    }
+    return NULL;
+}
+
+static void test_fsync_livelock(void) {
+    int fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0, "create file for fsync test");
+    if (fd < 0) {
+        return;
+    }
+
+    pthread_t tid;
+    atomic_store(&g_stop, 0);
+    CHECK(pthread_create(&tid, NULL, writer_thread, &fd) == 0,
+          "start writer thread");
+
+    double worst = 0;
+    int ok = 1;
+    for (int i = 0; i < 20; i++) {
+        double t0 = now_sec();
+        ok &= fsync(fd) == 0;
+        double dt = now_sec() - t0;
+        if (dt > worst) {
+            worst = dt;
+        }
+    }
+    atomic_store(&g_stop, 1);
+    pthread_join(tid, NULL);
+
+    printf("fsync under concurrent writes: worst %.3f s\n", worst);
+    CHECK(ok, "fsync succeeds while another thread writes");
+    CHECK(worst < 5.0, "fsync finishes while the file keeps getting dirty");
+
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+static int g_read_fd = -1;
+
+static void *reader_thread(void *arg) {
+    long bad = 0;
+    char page[PAGE], back[PAGE];
+    (void)arg;
+    for (int r = 0; r < READ_ROUNDS; r++) {
+        for (unsigned long i = 0; i < HOT_PAGES; i++) {
+            fill_page(page, i);
+            if (pread(g_read_fd, back, PAGE, (off_t)i * PAGE) != PAGE ||
+                memcmp(page, back, PAGE) != 0) {
+                bad++;
+            }
+        }
+    }
+    return (void *)bad;
+}
+
+static void test_concurrent_readers(void) {
+    g_read_fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(g_read_fd >= 0, "create file for reader test");
+    if (g_read_fd < 0) {
+        return;
+    }
+    char page[PAGE];
+    int ok = 1;
+    for (unsigned long i = 0; i < HOT_PAGES; i++) {
+        fill_page(page, i);
+        ok &= pwrite(g_read_fd, page, PAGE, (off_t)i * PAGE) == PAGE;
+    }
+    CHECK(ok, "populate cached pages");
+
+    pthread_t tids[READERS];
+    double t0 = now_sec();
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&tids[i], NULL, reader_thread, NULL);
+    }
+    long bad = 0;
+    for (int i = 0; i < READERS; i++) {
+        void *ret;
+        pthread_join(tids[i], &ret);
+        bad += (long)ret;
+    }
+    double dt = now_sec() - t0;
+    printf("%d readers x %d pages x %d rounds: %.3f s (%.0f pages/s)\n",
+           READERS, HOT_PAGES, READ_ROUNDS, dt,
+           (double)READERS * HOT_PAGES * READ_ROUNDS / (dt > 0 ? dt : 1e-9));
+    CHECK(bad == 0, "concurrent cached reads return correct data");
+
+    close(g_read_fd);
+    unlink(TEST_FILE);
+}
+
+int main(void) {
+    test_sparse();
+    test_fsync_livelock();
+    test_concurrent_readers();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
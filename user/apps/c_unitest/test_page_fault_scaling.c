@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 多线程缺页扩展性测试
+ *
+ * 1. 1/2/4/.../MAX_THREADS 个线程各自在不相交的区域上触发匿名页缺页，
+ *    报告每秒缺页数和相对单线程的加速比；
+ * 2. 多个线程同时对同一批页面的不同字节写入（匿名私有映射和文件私有映射），
+ *    检查并发缺页不会让某个线程的写入丢失。
+ *
+ * 环境变量 FAULT_SCALING_MAX_THREADS 可以修改最大线程数（默认64）。
+ */
+
+#define PAGE 4096
+#define PAGES_PER_THREAD 2048
+#define RACE_PAGES 256
+#define RACE_THREADS 8
+#define RACE_ROUNDS 16
+#define TEST_FILE "page_fault_scaling_test.dat"
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static pthread_barrier_t g_barrier;
+
+struct fault_arg {
+    volatile unsigned char *base;
+    long bad;
+};
+
+static void *fault_thread(void *p) {
+    struct fault_arg *arg = p;
+    pthread_barrier_wait(&g_barrier);
+    for (size_t i = 0; i < PAGES_PER_THREAD; i++) {
+        arg->base[i * PAGE] = (unsigned char)(i + 1);
+    }
+    for (size_t i = 0; i < PAGES_PER_THREAD; i++) {
+        if (arg->base[i * PAGE] != (unsigned char)(i + 1)) {
+            arg->bad++;
+        }
+    }
+    return NULL;
+}
+
+/* 返回每秒缺页数，失败时返回负数 */
+static double run_disjoint(int nthreads, long *bad) {
+    size_t len = (size_t)nthreads * PAGES_PER_THREAD * PAGE;
+    unsigned char *mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return -1;
+    }
+    /* 测量的是4K缺页，不让透明大页参与 */
+    madvise(mem, len, MADV_NOHUGEPAGE);
+
+    pthread_t *tids = calloc((size_t)nthreads, sizeof(pthread_t));
+    struct fault_arg *args = calloc((size_t)nthreads, sizeof(*args));
+    if (!tids || !args) {
+        munmap(mem, len);
+        free(tids);
+        free(args);
+        return -1;
+    }
+
+    pthread_barrier_init(&g_barrier, NULL, (unsigned)nthreads + 1);
+    for (int i = 0; i < nthreads; i++) {
+        args[i].base = mem + (size_t)i * PAGES_PER_THREAD * PAGE;
+        pthread_create(&tids[i], NULL, fault_thread, &args[i]);
+    }
+    double t0 = now_sec();
+    pthread_barrier_wait(&g_barrier);
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(tids[i], NULL);
+        *bad += args[i].bad;
+    }
+    double dt = now_sec() - t0;
+    pthread_barrier_destroy(&g_barrier);
+
+    munmap(mem, len);
+    free(tids);
+    free(args);
+    return (double)nthreads * PAGES_PER_THREAD / (dt > 0 ? dt : 1e-9);
+}
+
+static void test_scaling(void) {
+    int max_threads = 64;
+    const char *env = getenv("FAULT_SCALING_MAX_THREADS");
+    if (env && atoi(env) > 0) {
+        max_threads = atoi(env);
+    }
+
+    long bad = 0;
+    double base = 0;
+    int ok = 1;
+    printf("%8s %14s %8s\n", "threads", "faults/s", "speedup");
+    for (int n = 1; n <= max_threads; n *= 2) {
+        double rate = run_disjoint(n, &bad);
+        if (rate < 0) {
+            ok = 0;
+            break;
+        }
+        if (n == 1) {
+            base = rate;
+        }
+        printf("%8d %14.0f %8.2f\n", n, rate, rate / base);
+    }
+    CHECK(ok, "fault in disjoint regions from 1..N threads");
+    CHECK(bad == 0, "every faulted page holds its own data");
+}
+
+struct race_arg {
+    volatile unsigned char *base;
+    int id;
+};
+
+static void *race_thread(void *p) {
+    struct race_arg *arg = p;
+    pthread_barrier_wait(&g_barrier);
+    /* 所有线程同时缺页同一批页面，各自只写自己的字节 */
+    for (size_t i = 0; i < RACE_PAGES; i++) {
+        arg->base[i * PAGE + (size_t)arg->id] = (unsigned char)(arg->id + 1);
+    }
+    return NULL;
+}
+
+/* 返回丢失的写入数 */
+static long race_once(unsigned char *mem) {
+    pthread_t tids[RACE_THREADS];
+    struct race_arg args[RACE_THREADS];
+
+    pthread_barrier_init(&g_barrier, NULL, RACE_THREADS);
+    for (int i = 0; i < RACE_THREADS; i++) {
+        args[i].base = mem;
+        args[i].id = i;
+        pthread_create(&tids[i], NULL, race_thread, &args[i]);
+    }
+    for (int i = 0; i < RACE_THREADS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_barrier_destroy(&g_barrier);
+
+    long lost = 0;
+    for (size_t i = 0; i < RACE_PAGES; i++) {
+        for (int t = 0; t < RACE_THREADS; t++) {
+            if (mem[i * PAGE + (size_t)t] != (unsigned char)(t + 1)) {
+                lost++;
+            }
+        }
+    }
+    return lost;
+}
+
+static void test_same_page_race_anon(void) {
+    long lost = 0;
+    int ok = 1;
+    for (int r = 0; r < RACE_ROUNDS; r++) {
+        unsigned char *mem = mmap(NULL, RACE_PAGES * PAGE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            ok = 0;
+            break;
+        }
+        lost += race_once(mem);
+        munmap(mem, RACE_PAGES * PAGE);
+    }
+    CHECK(ok, "map anonymous pages for the race test");
+    CHECK(lost == 0, "concurrent anonymous faults on one page lose no writes");
+}
+
+static void test_same_page_race_file(void) {
+    int fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0, "create file for private mapping race");
+    if (fd < 0) {
+        return;
+    }
+    CHECK(ftruncate(fd, RACE_PAGES * PAGE) == 0, "size file");
+
+    long lost = 0;
+    int ok = 1;
+    for (int r = 0; r < RACE_ROUNDS; r++) {
+        /* 私有文件映射：每次写缺页都要写时复制，并发时只能保留一份副本 */
+        unsigned char *mem = mmap(NULL, RACE_PAGES * PAGE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE, fd, 0);
+        if (mem == MAP_FAILED) {
+            ok = 0;
+            break;
+        }
+        lost += race_once(mem);
+        munmap(mem, RACE_PAGES * PAGE);
+    }
+    CHECK(ok, "map file privately for the race test");
+    CHECK(lost == 0, "concurrent copy-on-write faults on one page lose no writes");
+
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+int main(void) {
+    test_scaling();
+    test_same_page_race_anon();
+    test_same_page_race_file();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * CFS负载均衡测试
+ *
+ * 1. 所有忙循环线程先绑定在CPU 0上启动，再把亲和性放开到所有CPU：
+ *    放开亲和性本身不会迁移线程，只能靠周期/newidle/主动均衡把它们分散开，
+ *    报告运行过程中用到的CPU数、总吞吐相对全部挤在CPU 0上时的倍数、各线程进度的差距；
+ * 2. 绑定在某个CPU上的线程在其他CPU空闲时也不会被均衡走。
+ *
+ * 环境变量 SCHED_BALANCE_SECONDS 可以修改每轮的运行时间（默认2秒）。
+ */
+
+#define MAX_WORKERS 256
+#define SPIN_CHUNK (1 << 16)
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void sleep_sec(double s) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)s;
+    ts.tv_nsec = (long)((s - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static double run_seconds(void) {
+    const char *env = getenv("SCHED_BALANCE_SECONDS");
+    if (env && atof(env) > 0) {
+        return atof(env);
+    }
+    return 2.0;
+}
+
+static int set_affinity_one(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static int set_affinity_all(int ncpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < ncpu; i++) {
+        CPU_SET(i, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+struct worker {
+    pthread_t tid;
+    atomic_long progress;
+    atomic_int last_cpu;
+    int pinned_cpu; /* <0表示启动后放开亲和性 */
+    int ncpu;
+    int wrong_cpu;
+    int setup_ok;
+};
+
+static atomic_int g_start;
+static atomic_int g_widen;
+static atomic_int g_stop;
+static atomic_int g_ready;
+
+static void *worker_main(void *p) {
+    struct worker *w = p;
+    int target = w->pinned_cpu >= 0 ? w->pinned_cpu : 0;
+    w->setup_ok = set_affinity_one(target) == 0;
+    atomic_fetch_add(&g_ready, 1);
+    while (!atomic_load(&g_start)) {
+    }
+
+    int widened = 0;
+    volatile unsigned long sink = 0;
+    while (!atomic_load(&g_stop)) {
+        if (!widened && w->pinned_cpu < 0 && atomic_load(&g_widen)) {
+            if (set_affinity_all(w->ncpu) != 0) {
+                w->setup_ok = 0;
+            }
+            widened = 1;
+        }
+        for (int i = 0; i < SPIN_CHUNK; i++) {
+            sink += (unsigned long)i;
+        }
+        atomic_fetch_add(&w->progress, 1);
+        int cpu = sched_getcpu();
+        atomic_store(&w->last_cpu, cpu);
+        if (w->pinned_cpu >= 0 && cpu != w->pinned_cpu) {
+            w->wrong_cpu++;
+        }
+    }
+    return NULL;
+}
+
+static int start_workers(struct worker *ws, int n) {
+    atomic_store(&g_start, 0);
+    atomic_store(&g_widen, 0);
+    atomic_store(&g_stop, 0);
+    atomic_store(&g_ready, 0);
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&ws[i].tid, NULL, worker_main, &ws[i]) != 0) {
+            return -1;
+        }
+    }
+    while (atomic_load(&g_ready) < n) {
+        sched_yield();
+    }
+    atomic_store(&g_start, 1);
+    return 0;
+}
+
+static void stop_workers(struct worker *ws, int n) {
+    atomic_store(&g_stop, 1);
+    for (int i = 0; i < n; i++) {
+        pthread_join(ws[i].tid, NULL);
+    }
+}
+
+static long total_progress(struct worker *ws, int n) {
+    long sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += atomic_load(&ws[i].progress);
+    }
+    return sum;
+}
+
+static void test_spread(int ncpu) {
+    if (ncpu < 2) {
+        printf("SKIP: only one CPU online, nothing to balance\n");
+        return;
+    }
+
+    int n = ncpu < MAX_WORKERS ? ncpu : MAX_WORKERS;
+    struct worker *ws = calloc((size_t)n, sizeof(*ws));
+    for (int i = 0; i < n; i++) {
+        ws[i].pinned_cpu = -1;
+        ws[i].ncpu = ncpu;
+    }
+    CHECK(start_workers(ws, n) == 0, "start busy threads on CPU 0");
+
+    double secs = run_seconds();
+
+    /* 全部挤在CPU 0上时的吞吐 */
+    sleep_sec(0.2);
+    long p0 = total_progress(ws, n);
+    double t0 = now_sec();
+    sleep_sec(secs / 4);
+    double packed_rate = (double)(total_progress(ws, n) - p0) / (now_sec() - t0);
+
+    atomic_store(&g_widen, 1);
+    double widen_at = now_sec();
+
+    /* 等待均衡把线程分散开，记录各线程的进度 */
+    sleep_sec(secs / 2);
+    long before[MAX_WORKERS];
+    for (int i = 0; i < n; i++) {
+        before[i] = atomic_load(&ws[i].progress);
+    }
+    t0 = now_sec();
+
+    int used[MAX_WORKERS] = {0};
+    int distinct = 0;
+    double sample_end = now_sec() + secs / 2;
+    while (now_sec() < sample_end) {
+        for (int i = 0; i < n; i++) {
+            int cpu = atomic_load(&ws[i].last_cpu);
+            if (cpu >= 0 && cpu < MAX_WORKERS && !used[cpu]) {
+                used[cpu] = 1;
+                distinct++;
+            }
+        }
+        sleep_sec(0.01);
+    }
+
+    double dt = now_sec() - t0;
+    long min_delta = -1, max_delta = 0, sum_delta = 0;
+    for (int i = 0; i < n; i++) {
+        long d = atomic_load(&ws[i].progress) - before[i];
+        sum_delta += d;
+        if (min_delta < 0 || d < min_delta) {
+            min_delta = d;
+        }
+        if (d > max_delta) {
+            max_delta = d;
+        }
+    }
+    stop_workers(ws, n);
+
+    int setup_ok = 1;
+    for (int i = 0; i < n; i++) {
+        setup_ok &= ws[i].setup_ok;
+    }
+    free(ws);
+
+    double spread_rate = (double)sum_delta / dt;
+    printf("%d threads on %d CPUs: %d CPUs used %.1fs after widening affinity\n",
+           n, ncpu, distinct, now_sec() - widen_at);
+    printf("throughput %.2fx of all-on-CPU0, per-thread progress min/max %.2f\n",
+           packed_rate > 0 ? spread_rate / packed_rate : 0.0,
+           max_delta > 0 ? (double)min_delta / (double)max_delta : 0.0);
+
+    CHECK(setup_ok, "set thread affinity");
+    CHECK(distinct > 1, "threads started on CPU 0 spread to other CPUs");
+    CHECK(min_delta > 0, "every thread keeps making progress while balanced");
+}
+
+static void test_pinned_stays(int ncpu) {
+    if (ncpu < 2) {
+        printf("SKIP: only one CPU online, pinning is trivial\n");
+        return;
+    }
+
+    /* 两个线程绑定在最后一个CPU上，其他CPU全部空闲 */
+    struct worker ws[2];
+    memset(ws, 0, sizeof(ws));
+    for (int i = 0; i < 2; i++) {
+        ws[i].pinned_cpu = ncpu - 1;
+        ws[i].ncpu = ncpu;
+    }
+    CHECK(start_workers(ws, 2) == 0, "start pinned threads");
+    sleep_sec(run_seconds() / 2);
+    stop_workers(ws, 2);
+
+    CHECK(ws[0].setup_ok && ws[1].setup_ok, "pin threads to the last CPU");
+    CHECK(ws[0].wrong_cpu == 0 && ws[1].wrong_cpu == 0,
+          "balancing never moves a pinned thread off its CPU");
+}
+
+int main(void) {
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) {
+        ncpu = 1;
+    }
+
+    test_spread(ncpu);
+    test_pinned_stays(ncpu);
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * swapon/swapoff 与匿名页换出/换入测试
+ *
+ * 在普通文件上手工写入 SWAPSPACE2 头部（等价于 mkswap），启用后分配超过空闲内存的
+ * 匿名内存并写入校验数据，迫使内核换出匿名页；随后读回校验、fork 后在子进程中校验，
+ * 最后 swapoff 把所有页面换回内存并再次校验。
+ *
+ * 用法: test_swap [交换文件路径] [交换空间大小MB]
+ */
+
+#define DEFAULT_SWAP_PATH "/tmp/test_swap.img"
+#define DEFAULT_SWAP_MB 64
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static size_t page_size(void) {
+    long ps = sysconf(_SC_PAGESIZE);
+    return ps > 0 ? (size_t)ps : 4096;
+}
+
+/* 读取 /proc/meminfo 中某一项的值（kB），失败返回 -1 */
+static long meminfo_kb(const char *key) {
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (!fp) {
+        return -1;
+    }
+    char line[256];
+    size_t klen = strlen(key);
+    long val = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            val = strtol(line + klen + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return val;
+}
+
+static int proc_swaps_contains(const char *path) {
+    FILE *fp = fopen("/proc/swaps", "r");
+    if (!fp) {
+        return 0;
+    }
+    char line[512];
+    int found = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, path, strlen(path)) == 0) {
+            found = 1;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+/* 创建交换文件并写入 SWAPSPACE2 头部 */
+static int make_swapfile(const char *path, size_t pages) {
+    size_t ps = page_size();
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    char *buf = calloc(1, ps);
+    if (!buf) {
+        close(fd);
+        return -1;
+    }
+    /* 交换文件中的每一页都需要真实分配，不能是空洞 */
+    for (size_t i = 0; i < pages; i++) {
+        if (write(fd, buf, ps) != (ssize_t)ps) {
+            free(buf);
+            close(fd);
+            return -1;
+        }
+    }
+
+    uint32_t *info = (uint32_t *)(buf + 1024);
+    info[0] = 1;                    /* version */
+    info[1] = (uint32_t)pages - 1;  /* last_page */
+    info[2] = 0;                    /* nr_badpages */
+    memcpy(buf + ps - 10, "SWAPSPACE2", 10);
+    int ok = pwrite(fd, buf, ps, 0) == (ssize_t)ps && fsync(fd) == 0;
+    free(buf);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static inline uint64_t pattern(size_t idx) {
+    return (uint64_t)idx * 0x9E3779B97F4A7C15ULL + 0x1234;
+}
+
+static void fill(char *mem, size_t pages) {
+    size_t ps = page_size();
+    for (size_t i = 0; i < pages; i++) {
+        uint64_t *p = (uint64_t *)(mem + i * ps);
+        p[0] = pattern(i);
+        p[ps / sizeof(uint64_t) - 1] = ~pattern(i);
+    }
+}
+
+/* 返回校验失败的页数 */
+static size_t verify(const char *mem, size_t pages) {
+    size_t ps = page_size();
+    size_t bad = 0;
+    for (size_t i = 0; i < pages; i++) {
+        const uint64_t *p = (const uint64_t *)(mem + i * ps);
+        if (p[0] != pattern(i) || p[ps / sizeof(uint64_t) - 1] != ~pattern(i)) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static void test_invalid_args(const char *path) {
+    errno = 0;
+    CHECK(syscall(SYS_swapon, "/nonexistent/swapfile", 0) == -1 &&
+              errno == ENOENT,
+          "swapon on missing path returns ENOENT");
+
+    errno = 0;
+    CHECK(syscall(SYS_swapoff, path) == -1 && errno == EINVAL,
+          "swapoff on inactive swap file returns EINVAL");
+}
+
+static void test_swap_stress(const char *path, size_t swap_pages) {
+    size_t ps = page_size();
+    long total_kb = meminfo_kb("SwapTotal");
+    CHECK(total_kb > 0, "SwapTotal is non-zero after swapon");
+    CHECK(proc_swaps_contains(path), "/proc/swaps lists the swap file");
+
+    errno = 0;
+    CHECK(syscall(SYS_swapon, path, 0) == -1 && errno == EBUSY,
+          "second swapon of the same file returns EBUSY");
+
+    /* 超出空闲内存的部分必须被换出，只使用一半交换空间，留出余量 */
+    long free_kb = meminfo_kb("MemFree");
+    size_t pages = (free_kb > 0 ? (size_t)free_kb * 1024 / ps : 0) +
+                   swap_pages / 2;
+    printf("allocating %zu pages (MemFree=%ld kB, SwapTotal=%ld kB)\n", pages,
+           free_kb, total_kb);
+
+    char *mem = mmap(NULL, pages * ps, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    CHECK(mem != MAP_FAILED, "mmap anonymous region larger than free memory");
+    if (mem == MAP_FAILED) {
+        return;
+    }
+
+    fill(mem, pages);
+    long swap_free_kb = meminfo_kb("SwapFree");
+    CHECK(swap_free_kb >= 0 && swap_free_kb < total_kb,
+          "anonymous pages were swapped out");
+    CHECK(verify(mem, pages) == 0, "data intact after swap-in");
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* 子进程与父进程共享交换槽位，读回的数据必须一致 */
+        _exit(verify(mem, pages) == 0 ? 0 : 1);
+    }
+    int status = 0;
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+              WEXITSTATUS(status) == 0,
+          "forked child sees intact swapped data");
+
+    /* swapoff 需要把剩余页面全部换回，先释放一部分内存 */
+    size_t keep = pages - swap_pages / 2;
+    munmap(mem + keep * ps, (pages - keep) * ps);
+    CHECK(syscall(SYS_swapoff, path) == 0, "swapoff succeeds");
+    CHECK(!proc_swaps_contains(path), "/proc/swaps no longer lists the file");
+    CHECK(meminfo_kb("SwapTotal") == 0, "SwapTotal is zero after swapoff");
+    CHECK(verify(mem, keep) == 0, "data intact after swapoff");
+
+    munmap(mem, keep * ps);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : DEFAULT_SWAP_PATH;
+    size_t swap_mb = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_SWAP_MB;
+    size_t swap_pages = swap_mb * 1024 * 1024 / page_size();
+
+    if (make_swapfile(path, swap_pages) != 0) {
+        perror("make_swapfile");
+        return 1;
+    }
+
+    test_invalid_args(path);
+
+    errno = 0;
+    if (syscall(SYS_swapon, path, 0) != 0) {
+        if (errno == EPERM || errno == ENOSYS) {
+            printf("SKIP: swapon unavailable (errno=%d)\n", errno);
+            unlink(path);
+            return 0;
+        }
+        CHECK(0, "swapon on prepared swap file");
+        unlink(path);
+        printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+        return 1;
+    }
+    CHECK(1, "swapon on prepared swap file");
+
+    test_swap_stress(path, swap_pages - 1);
+    unlink(path);
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
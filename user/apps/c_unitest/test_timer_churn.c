@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 内核定时器抖动（timer churn）微基准测试
+ *
+ * 1. 单线程循环arm/disarm ITIMER_REAL，每次都是一次定时器入队和一次取消，统计每秒操作数。
+ * 2. 先让若干线程阻塞在带超时的poll上，时间轮里挂上大量未到期的定时器，再重复第1步。
+ *    插入和取消是O(1)时，吞吐量不应随未到期定时器的数量明显下降。
+ * 3. 每个cpu一个子进程并发arm/disarm，统计总吞吐量（各cpu的时间轮互不竞争）。
+ * 4. 正确性：不同距离的nanosleep不提前返回，远处定时器的误差在时间轮粒度以内；
+ *    取消后的定时器不再触发。
+ *
+ * 环境变量：
+ *   TIMER_CHURN_PENDING  第2步中阻塞在poll上的线程数，默认256
+ *   TIMER_CHURN_MS       每一轮测量的时间，默认500ms
+ */
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static volatile sig_atomic_t g_alarms = 0;
+
+static void on_alarm(int sig) {
+    (void)sig;
+    g_alarms++;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int env_int(const char *name, int def) {
+    const char *env = getenv(name);
+    if (env && atoi(env) >= 0 && *env) {
+        return atoi(env);
+    }
+    return def;
+}
+
+static int arm_itimer(long usec) {
+    struct itimerval it;
+    memset(&it, 0, sizeof(it));
+    it.it_value.tv_sec = usec / 1000000;
+    it.it_value.tv_usec = usec % 1000000;
+    return setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/* 在ms毫秒内循环arm(10s)/disarm，返回每秒arm+disarm的次数，出错返回-1 */
+static double churn_rate(int ms) {
+    int64_t start = now_ns();
+    int64_t end = start + (int64_t)ms * 1000000LL;
+    long ops = 0;
+    for (;;) {
+        for (int i = 0; i < 64; i++) {
+            if (arm_itimer(10 * 1000000L) != 0 || arm_itimer(0) != 0) {
+                return -1;
+            }
+        }
+        ops += 64;
+        if (now_ns() >= end) {
+            break;
+        }
+    }
+    return (double)ops * 1e9 / (double)(now_ns() - start);
+}
+
+struct pending_ctx {
+    int fd;
+    int ready;
+};
+
+static void *pending_waiter(void *arg) {
+    struct pending_ctx *ctx = arg;
+    struct pollfd pfd = {.fd = ctx->fd, .events = POLLIN};
+    __atomic_add_fetch(&ctx->ready, 1, __ATOMIC_SEQ_CST);
+    /* 超时时间各不相同，让定时器分散到时间轮的各层 */
+    poll(&pfd, 1, 30000 + (int)(((uintptr_t)&pfd >> 4) % 30000));
+    return NULL;
+}
+
+static void test_churn(int nr_pending, int ms) {
+    double base = churn_rate(ms);
+    printf("churn with no pending timers: %.0f arm+disarm/s\n", base);
+    CHECK(base > 0, "arm/disarm ITIMER_REAL in a loop");
+
+    int pipefd[2];
+    CHECK(pipe(pipefd) == 0, "create wake-up pipe");
+    struct pending_ctx ctx = {.fd = pipefd[0], .ready = 0};
+    pthread_t *threads = calloc((size_t)nr_pending, sizeof(pthread_t));
+    int created = 0;
+    for (int i = 0; i < nr_pending; i++) {
+        if (pthread_create(&threads[i], NULL, pending_waiter, &ctx) != 0) {
+            break;
+        }
+        created++;
+    }
+    while (__atomic_load_n(&ctx.ready, __ATOMIC_SEQ_CST) < created) {
+        usleep(1000);
+    }
+    /* 等待所有线程真正进入poll睡眠 */
+    usleep(50 * 1000);
+
+    double loaded = churn_rate(ms);
+    printf("churn with %d pending timers: %.0f arm+disarm/s (%.2fx)\n", created,
+           loaded, base > 0 ? loaded / base : 0.0);
+    CHECK(created == nr_pending, "park threads in poll with long timeouts");
+    CHECK(loaded > 0 && loaded >= base / 2,
+          "churn throughput does not collapse with many pending timers");
+
+    char c = 'x';
+    write(pipefd[1], &c, 1);
+    for (int i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+static void test_parallel_churn(int ms) {
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu <= 0) {
+        ncpu = 1;
+    }
+    int pipefd[2];
+    CHECK(pipe(pipefd) == 0, "create result pipe");
+
+    for (int i = 0; i < ncpu; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+            double rate = churn_rate(ms);
+            write(pipefd[1], &rate, sizeof(rate));
+            _exit(rate > 0 ? 0 : 1);
+        }
+    }
+
+    double total = 0;
+    int ok = 1;
+    for (int i = 0; i < ncpu; i++) {
+        double rate = 0;
+        if (read(pipefd[0], &rate, sizeof(rate)) != sizeof(rate)) {
+            ok = 0;
+        }
+        total += rate;
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = 0;
+        }
+    }
+    close(pipefd[0]);
+    close(pipefd[1]);
+    printf("parallel churn on %d cpus: %.0f arm+disarm/s total\n", ncpu, total);
+    CHECK(ok, "per-cpu churn children complete");
+}
+
+static void test_accuracy(void) {
+    /* 分别落在时间轮的第0、1、2层 */
+    static const long sleep_ms[] = {20, 300, 2100};
+    for (size_t i = 0; i < sizeof(sleep_ms) / sizeof(sleep_ms[0]); i++) {
+        struct timespec req = {.tv_sec = sleep_ms[i] / 1000,
+                               .tv_nsec = (sleep_ms[i] % 1000) * 1000000L};
+        int64_t t0 = now_ns();
+        nanosleep(&req, NULL);
+        int64_t elapsed = now_ns() - t0;
+        int64_t want = (int64_t)sleep_ms[i] * 1000000LL;
+        /* 粒度约为距离的1/8，另外留10ms给tick和调度延迟 */
+        int64_t slack = want / 8 + 10 * 1000000LL;
+        char msg[128];
+        printf("nanosleep %ld ms took %.2f ms\n", sleep_ms[i], (double)elapsed / 1e6);
+        snprintf(msg, sizeof(msg), "nanosleep %ld ms does not return early", sleep_ms[i]);
+        CHECK(elapsed >= want, msg);
+        snprintf(msg, sizeof(msg), "nanosleep %ld ms wakes within wheel granularity",
+                 sleep_ms[i]);
+        CHECK(elapsed <= want + slack, msg);
+    }
+
+    g_alarms = 0;
+    CHECK(arm_itimer(50 * 1000) == 0, "arm ITIMER_REAL for 50ms");
+    CHECK(arm_itimer(0) == 0, "cancel ITIMER_REAL");
+    usleep(120 * 1000);
+    CHECK(g_alarms == 0, "cancelled timer does not fire");
+
+    CHECK(arm_itimer(30 * 1000) == 0, "arm ITIMER_REAL for 30ms");
+    int64_t deadline = now_ns() + 1000000000LL;
+    while (g_alarms == 0 && now_ns() < deadline) {
+        usleep(5 * 1000);
+    }
+    CHECK(g_alarms == 1, "armed timer fires exactly once");
+}
+
+int main(void) {
+    int nr_pending = env_int("TIMER_CHURN_PENDING", 256);
+    int ms = env_int("TIMER_CHURN_MS", 500);
+    if (ms <= 0) {
+        ms = 100;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_alarm;
+    sigemptyset(&sa.sa_mask);
+    CHECK(sigaction(SIGALRM, &sa, NULL) == 0, "install SIGALRM handler");
+
+    test_churn(nr_pending, ms);
+    test_parallel_churn(ms);
+    test_accuracy();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
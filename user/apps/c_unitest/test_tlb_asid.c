@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 进程切换与TLB（PCID/ASID）测试
+ *
+ * 1. 两个进程通过管道来回切换，每次切换后各自访问一批页面，
+ *    报告每次往返的耗时（有ASID时切换回来不需要重新填充TLB）；
+ * 2. fork后父子进程交替写同一批写时复制页面，各自只能看到自己的数据；
+ * 3. 一个进程在切换间隙反复munmap/mmap同一段地址，切换回来后不会读到旧映射。
+ */
+
+#define PAGE 4096
+#define WS_PAGES 64
+#define ROUNDS 20000
+#define COW_PAGES 32
+#define COW_ROUNDS 200
+#define REMAP_ROUNDS 200
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned long touch(volatile unsigned char *ws) {
+    unsigned long sum = 0;
+    for (int i = 0; i < WS_PAGES; i++) {
+        sum += ws[(size_t)i * PAGE];
+    }
+    return sum;
+}
+
+/* 在两个管道上来回传递一个字节，每次收到后访问自己的工作集 */
+static int ping_pong(int rfd, int wfd, volatile unsigned char *ws, int first) {
+    char c = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        if (first && write(wfd, &c, 1) != 1) {
+            return -1;
+        }
+        if (read(rfd, &c, 1) != 1) {
+            return -1;
+        }
+        c = (char)touch(ws);
+        if (!first && write(wfd, &c, 1) != 1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void test_switch_latency(void) {
+    int ab[2], ba[2];
+    CHECK(pipe(ab) == 0 && pipe(ba) == 0, "create ping-pong pipes");
+
+    unsigned char *ws = mmap(NULL, WS_PAGES * PAGE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(ws != MAP_FAILED, "map working set");
+    if (ws == MAP_FAILED) {
+        return;
+    }
+    for (int i = 0; i < WS_PAGES; i++) {
+        ws[(size_t)i * PAGE] = (unsigned char)i;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* 子进程写一遍，拿到自己的物理页 */
+        for (int i = 0; i < WS_PAGES; i++) {
+            ws[(size_t)i * PAGE] = (unsigned char)(i + 1);
+        }
+        _exit(ping_pong(ab[0], ba[1], ws, 0) == 0 ? 0 : 1);
+    }
+
+    double t0 = now_sec();
+    int ok = ping_pong(ba[0], ab[1], ws, 1) == 0;
+    double dt = now_sec() - t0;
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    printf("%d round trips, %d pages touched per switch: %.0f ns/round trip\n",
+           ROUNDS, WS_PAGES, dt * 1e9 / ROUNDS);
+    CHECK(ok && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "processes ping-pong through pipes");
+
+    munmap(ws, WS_PAGES * PAGE);
+    close(ab[0]);
+    close(ab[1]);
+    close(ba[0]);
+    close(ba[1]);
+}
+
+/* 父子进程轮流写同一批写时复制页面，每轮检查自己上一轮写入的值 */
+static int cow_side(int rfd, int wfd, volatile unsigned char *mem,
+                    unsigned char tag, int first) {
+    char c = 0;
+    int bad = 0;
+    for (int r = 0; r < COW_ROUNDS; r++) {
+        if (!first || r > 0) {
+            if (read(rfd, &c, 1) != 1) {
+                return -1;
+            }
+        }
+        for (int i = 0; i < COW_PAGES; i++) {
+            volatile unsigned char *p = mem + (size_t)i * PAGE;
+            if (r > 0 && p[0] != (unsigned char)(tag + r - 1)) {
+                bad++;
+            }
+            p[0] = (unsigned char)(tag + r);
+        }
+        if (write(wfd, &c, 1) != 1) {
+            return -1;
+        }
+    }
+    return bad;
+}
+
+static void test_cow_isolation(void) {
+    int ab[2], ba[2];
+    CHECK(pipe(ab) == 0 && pipe(ba) == 0, "create pipes for COW test");
+
+    unsigned char *mem = mmap(NULL, COW_PAGES * PAGE, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(mem != MAP_FAILED, "map COW pages");
+    if (mem == MAP_FAILED) {
+        return;
+    }
+    memset(mem, 0, COW_PAGES * PAGE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(cow_side(ab[0], ba[1], mem, 100, 0) == 0 ? 0 : 1);
+    }
+    int bad = cow_side(ba[0], ab[1], mem, 0, 1);
+    /* 子进程最后一次写入之后还在等父进程，读掉最后一个字节 */
+    char c;
+    (void)read(ba[0], &c, 1);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    CHECK(bad == 0, "parent only sees its own copy-on-write data");
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "child only sees its own copy-on-write data");
+
+    munmap(mem, COW_PAGES * PAGE);
+    close(ab[0]);
+    close(ab[1]);
+    close(ba[0]);
+    close(ba[1]);
+}
+
+static void test_remap_across_switches(void) {
+    int ab[2], ba[2];
+    CHECK(pipe(ab) == 0 && pipe(ba) == 0, "create pipes for remap test");
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* 对端只负责让CPU切换到另一个地址空间 */
+        char c;
+        close(ab[1]);
+        close(ba[0]);
+        while (read(ab[0], &c, 1) == 1) {
+            if (write(ba[1], &c, 1) != 1) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+    close(ab[0]);
+    close(ba[1]);
+
+    unsigned char *hint = NULL;
+    int bad = 0, ok = 1;
+    for (int r = 0; r < REMAP_ROUNDS; r++) {
+        unsigned char *p = mmap(hint, PAGE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS |
+                                    (hint ? MAP_FIXED : 0),
+                                -1, 0);
+        if (p == MAP_FAILED) {
+            ok = 0;
+            break;
+        }
+        hint = p;
+        /* 新映射必须是全零页，读到上一轮的值说明用到了旧的TLB条目 */
+        if (p[0] != 0) {
+            bad++;
+        }
+        p[0] = (unsigned char)(r + 1);
+
+        char c = 0;
+        if (write(ab[1], &c, 1) != 1 || read(ba[0], &c, 1) != 1) {
+            ok = 0;
+            break;
+        }
+        if (p[0] != (unsigned char)(r + 1)) {
+            bad++;
+        }
+        munmap(p, PAGE);
+    }
+    close(ab[1]);
+    close(ba[0]);
+    waitpid(pid, NULL, 0);
+
+    CHECK(ok, "remap one address between context switches");
+    CHECK(bad == 0, "no stale translation survives munmap across switches");
+}
+
+int main(void) {
+    test_switch_latency();
+    test_cow_isolation();
+    test_remap_across_switches();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
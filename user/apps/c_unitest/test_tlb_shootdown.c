@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * TLB shootdown测试
+ *
+ * 1. 其他线程不停读取同一页时，主线程反复madvise(MADV_DONTNEED)并写入新值，
+ *    读者不能通过旧的TLB条目读到已经释放的页面；
+ * 2. 其他线程在别的CPU上运行时，主线程做munmap风暴（已访问/未访问的小区间），
+ *    报告每秒操作数和/proc/vmstat中nr_tlb_*计数器的增量（每次操作的IPI数）；
+ * 3. /proc/tlb_shootdown和/proc/sys/vm/tlb_single_page_flush_ceiling可以读写。
+ *
+ * 环境变量 TLB_SHOOTDOWN_THREADS 可以修改读者线程数（默认3）。
+ */
+
+#define PAGE 4096
+#define DONTNEED_ROUNDS 20000
+#define STORM_ROUNDS 20000
+#define STORM_PAGES 4
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+struct tlb_counters {
+    long long sent;
+    long long received;
+    long long flush_all;
+    long long flush_one;
+};
+
+/* 读取/proc/vmstat中的nr_tlb_*，不存在时返回-1 */
+static int read_tlb_counters(struct tlb_counters *c) {
+    FILE *f = fopen("/proc/vmstat", "r");
+    if (!f) {
+        return -1;
+    }
+    char name[64];
+    long long value;
+    int found = 0;
+    memset(c, 0, sizeof(*c));
+    while (fscanf(f, "%63s %lld", name, &value) == 2) {
+        if (strcmp(name, "nr_tlb_remote_flush") == 0) {
+            c->sent = value;
+            found++;
+        } else if (strcmp(name, "nr_tlb_remote_flush_received") == 0) {
+            c->received = value;
+            found++;
+        } else if (strcmp(name, "nr_tlb_local_flush_all") == 0) {
+            c->flush_all = value;
+            found++;
+        } else if (strcmp(name, "nr_tlb_local_flush_one") == 0) {
+            c->flush_one = value;
+            found++;
+        }
+    }
+    fclose(f);
+    return found == 4 ? 0 : -1;
+}
+
+static int nr_readers(void) {
+    const char *env = getenv("TLB_SHOOTDOWN_THREADS");
+    if (env && atoi(env) > 0) {
+        return atoi(env);
+    }
+    return 3;
+}
+
+static atomic_int g_stop;
+static atomic_uint g_seq;
+static volatile unsigned int *g_page;
+
+/* seqlock风格：序号为偶数且读前读后不变时，页面里必须是序号/2 */
+static void *dontneed_reader(void *p) {
+    long *stale = p;
+    while (!atomic_load(&g_stop)) {
+        unsigned int s1 = atomic_load(&g_seq);
+        if (s1 & 1) {
+            continue;
+        }
+        unsigned int v = g_page[0];
+        atomic_thread_fence(memory_order_seq_cst);
+        unsigned int s2 = atomic_load(&g_seq);
+        if (s1 == s2 && v != s1 / 2) {
+            (*stale)++;
+        }
+    }
+    return NULL;
+}
+
+static void test_dontneed_visibility(void) {
+    int n = nr_readers();
+    unsigned int *page = mmap(NULL, PAGE, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(page != MAP_FAILED, "map shared page for readers");
+    if (page == MAP_FAILED) {
+        return;
+    }
+    g_page = page;
+    page[0] = 0;
+    atomic_store(&g_seq, 0);
+    atomic_store(&g_stop, 0);
+
+    pthread_t *tids = calloc((size_t)n, sizeof(pthread_t));
+    long *stale = calloc((size_t)n, sizeof(long));
+    for (int i = 0; i < n; i++) {
+        pthread_create(&tids[i], NULL, dontneed_reader, &stale[i]);
+    }
+
+    int ok = 1;
+    for (unsigned int r = 1; r <= DONTNEED_ROUNDS; r++) {
+        atomic_store(&g_seq, 2 * r - 1);
+        if (madvise(page, PAGE, MADV_DONTNEED) != 0) {
+            ok = 0;
+            break;
+        }
+        page[0] = r;
+        atomic_store(&g_seq, 2 * r);
+    }
+    atomic_store(&g_stop, 1);
+
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        pthread_join(tids[i], NULL);
+        total += stale[i];
+    }
+    free(tids);
+    free(stale);
+    munmap(page, PAGE);
+
+    CHECK(ok, "madvise(MADV_DONTNEED) while other threads read the page");
+    CHECK(total == 0, "no reader sees a freed page through a stale TLB entry");
+}
+
+static void *spinner(void *p) {
+    (void)p;
+    while (!atomic_load(&g_stop)) {
+    }
+    return NULL;
+}
+
+/* 返回每秒操作数，失败时返回负数 */
+static double munmap_storm(int touch) {
+    double t0 = now_sec();
+    for (int r = 0; r < STORM_ROUNDS; r++) {
+        unsigned char *p = mmap(NULL, STORM_PAGES * PAGE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return -1;
+        }
+        if (touch) {
+            for (int i = 0; i < STORM_PAGES; i++) {
+                p[(size_t)i * PAGE] = (unsigned char)r;
+            }
+        }
+        if (munmap(p, STORM_PAGES * PAGE) != 0) {
+            return -1;
+        }
+    }
+    double dt = now_sec() - t0;
+    return STORM_ROUNDS / (dt > 0 ? dt : 1e-9);
+}
+
+static void test_munmap_storm(void) {
+    int n = nr_readers();
+    atomic_store(&g_stop, 0);
+    pthread_t *tids = calloc((size_t)n, sizeof(pthread_t));
+    for (int i = 0; i < n; i++) {
+        pthread_create(&tids[i], NULL, spinner, NULL);
+    }
+
+    int ok = 1;
+    int have_counters = 1;
+    printf("%10s %12s %10s %10s %10s %10s\n", "pattern", "ops/s", "ipi/op",
+           "recv/op", "full/op", "pages/op");
+    for (int touch = 1; touch >= 0; touch--) {
+        struct tlb_counters before, after;
+        have_counters = read_tlb_counters(&before) == 0;
+        double rate = munmap_storm(touch);
+        if (rate < 0) {
+            ok = 0;
+            break;
+        }
+        if (have_counters && read_tlb_counters(&after) == 0) {
+            printf("%10s %12.0f %10.2f %10.2f %10.2f %10.2f\n",
+                   touch ? "touched" : "untouched", rate,
+                   (double)(after.sent - before.sent) / STORM_ROUNDS,
+                   (double)(after.received - before.received) / STORM_ROUNDS,
+                   (double)(after.flush_all - before.flush_all) / STORM_ROUNDS,
+                   (double)(after.flush_one - before.flush_one) / STORM_ROUNDS);
+        } else {
+            printf("%10s %12.0f %10s %10s %10s %10s\n",
+                   touch ? "touched" : "untouched", rate, "-", "-", "-", "-");
+        }
+    }
+
+    atomic_store(&g_stop, 1);
+    for (int i = 0; i < n; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    CHECK(ok, "mmap/munmap storm with threads running on other CPUs");
+    if (!have_counters) {
+        printf("SKIP: /proc/vmstat has no nr_tlb_* counters\n");
+    }
+}
+
+static void test_procfs(void) {
+    FILE *f = fopen("/proc/tlb_shootdown", "r");
+    if (!f && errno == ENOENT) {
+        printf("SKIP: /proc/tlb_shootdown not present\n");
+    } else {
+        char line[256];
+        int rows = 0;
+        int header = f && fgets(line, sizeof(line), f) &&
+                     strncmp(line, "cpu ipi_sent", 12) == 0;
+        while (f && fgets(line, sizeof(line), f)) {
+            rows++;
+        }
+        if (f) {
+            fclose(f);
+        }
+        CHECK(header && rows > 0, "/proc/tlb_shootdown lists every CPU");
+    }
+
+    const char *path = "/proc/sys/vm/tlb_single_page_flush_ceiling";
+    f = fopen(path, "r");
+    if (!f && errno == ENOENT) {
+        printf("SKIP: %s not present\n", path);
+        return;
+    }
+    long old = -1;
+    CHECK(f && fscanf(f, "%ld", &old) == 1 && old >= 0,
+          "read tlb_single_page_flush_ceiling");
+    if (f) {
+        fclose(f);
+    }
+    if (old < 0) {
+        return;
+    }
+
+    long now = -1;
+    f = fopen(path, "w");
+    int wrote = f && fprintf(f, "%ld\n", old + 1) > 0;
+    if (f) {
+        fclose(f);
+    }
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%ld", &now) != 1) {
+            now = -1;
+        }
+        fclose(f);
+    }
+    CHECK(wrote && now == old + 1, "write tlb_single_page_flush_ceiling");
+
+    f = fopen(path, "w");
+    if (f) {
+        fprintf(f, "%ld\n", old);
+        fclose(f);
+    }
+}
+
+int main(void) {
+    test_dontneed_visibility();
+    test_munmap_storm();
+    test_procfs();
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
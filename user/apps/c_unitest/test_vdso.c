@@ -0,0 +1,196 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/auxv.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#ifndef AT_SYSINFO_EHDR
+#define AT_SYSINFO_EHDR 33
+#endif
+
+// test output helpers
+static inline void print_run(const char *name) { fprintf(stderr, "[RUN] %s\n", name); }
+static inline void print_pass(const char *name) { fprintf(stderr, "[PASS] %s\n", name); }
+static inline void print_failed(const char *name) { fprintf(stderr, "[FAILED] %s\n", name); }
+
+static inline int64_t ts_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static inline int sys_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    return (int)syscall(SYS_clock_gettime, (int)clk, ts);
+}
+
+static long env_long(const char *name, long def)
+{
+    const char *env = getenv(name);
+    if (env && *env && atol(env) > 0) return atol(env);
+    return def;
+}
+
+static int test_auxv(void)
+{
+    unsigned long base = getauxval(AT_SYSINFO_EHDR);
+    fprintf(stderr, "[auxv] AT_SYSINFO_EHDR=%#lx\n", base);
+    if (base == 0) {
+        fprintf(stderr, "auxv: no vdso\n");
+        return -1;
+    }
+    if (memcmp((const void *)base, "\177ELF", 4) != 0) {
+        fprintf(stderr, "auxv: vdso base does not point to an ELF header\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * libc的clock_gettime走vDSO，与系统调用交替读取时必须保持单调，且两者之差不超过一次调用的开销
+ */
+static int test_clock_agree(clockid_t clk, const char *name, int64_t slack_ns)
+{
+    struct timespec a, b, c;
+    for (int i = 0; i < 1000; i++) {
+        if (sys_clock_gettime(clk, &a) != 0 || clock_gettime(clk, &b) != 0 ||
+            sys_clock_gettime(clk, &c) != 0) {
+            perror("clock_gettime");
+            return -1;
+        }
+        if (b.tv_nsec < 0 || b.tv_nsec >= 1000000000L) {
+            fprintf(stderr, "%s: invalid tv_nsec %ld\n", name, b.tv_nsec);
+            return -1;
+        }
+        if (ts_ns(&b) + slack_ns < ts_ns(&a) || ts_ns(&b) > ts_ns(&c) + slack_ns) {
+            fprintf(stderr, "%s: vdso %lld not within syscall [%lld, %lld]\n", name,
+                    (long long)ts_ns(&b), (long long)ts_ns(&a), (long long)ts_ns(&c));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_monotonic(void)
+{
+    struct timespec prev, now;
+    clock_gettime(CLOCK_MONOTONIC, &prev);
+    for (int i = 0; i < 1000000; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (ts_ns(&now) < ts_ns(&prev)) {
+            fprintf(stderr, "monotonic: went backwards %lld -> %lld\n",
+                    (long long)ts_ns(&prev), (long long)ts_ns(&now));
+            return -1;
+        }
+        prev = now;
+    }
+    return 0;
+}
+
+static int test_coarse(void)
+{
+    struct timespec coarse, fine;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &coarse);
+    clock_gettime(CLOCK_MONOTONIC, &fine);
+    // COARSE时钟是上一个tick的快照，落后不超过几个tick
+    int64_t lag = ts_ns(&fine) - ts_ns(&coarse);
+    fprintf(stderr, "[coarse] monotonic lag=%lldns\n", (long long)lag);
+    if (lag < 0 || lag > 100 * 1000000LL) {
+        fprintf(stderr, "coarse: monotonic lag out of range\n");
+        return -1;
+    }
+
+    time_t t = time(NULL);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (t > tv.tv_sec || tv.tv_sec - t > 1) {
+        fprintf(stderr, "coarse: time()=%ld gettimeofday=%ld\n", (long)t, (long)tv.tv_sec);
+        return -1;
+    }
+    return 0;
+}
+
+static int test_getcpu(void)
+{
+    int cpu = sched_getcpu();
+    unsigned sys_cpu = ~0U;
+    syscall(SYS_getcpu, &sys_cpu, NULL, NULL);
+    fprintf(stderr, "[getcpu] sched_getcpu=%d syscall=%u\n", cpu, sys_cpu);
+    if (cpu < 0) {
+        perror("sched_getcpu");
+        return -1;
+    }
+    if (cpu >= sysconf(_SC_NPROCESSORS_CONF)) {
+        fprintf(stderr, "getcpu: cpu %d out of range\n", cpu);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 对比vDSO和系统调用的单次开销，只报告结果；设置 VDSO_MAX_NS 时检查vDSO路径的上限
+ */
+static int test_overhead(void)
+{
+    long iters = env_long("VDSO_BENCH_ITERS", 1000000);
+    long max_ns = env_long("VDSO_MAX_NS", 0);
+    struct timespec t0, t1, ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < iters; i++) clock_gettime(CLOCK_MONOTONIC, &ts);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double vdso_ns = (double)(ts_ns(&t1) - ts_ns(&t0)) / iters;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < iters / 10; i++) sys_clock_gettime(CLOCK_MONOTONIC, &ts);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sys_ns = (double)(ts_ns(&t1) - ts_ns(&t0)) / (iters / 10);
+
+    fprintf(stderr, "[overhead] clock_gettime: vdso=%.1fns syscall=%.1fns\n", vdso_ns, sys_ns);
+    if (max_ns && vdso_ns > max_ns) {
+        fprintf(stderr, "overhead: vdso %.1fns exceeds %ldns\n", vdso_ns, max_ns);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    print_run("vdso: AT_SYSINFO_EHDR");
+    if (test_auxv() == 0) print_pass("vdso: AT_SYSINFO_EHDR");
+    else { print_failed("vdso: AT_SYSINFO_EHDR"); fails++; }
+
+    print_run("vdso: clocks agree with syscall");
+    if (test_clock_agree(CLOCK_REALTIME, "realtime", 0) == 0 &&
+        test_clock_agree(CLOCK_MONOTONIC, "monotonic", 0) == 0 &&
+        test_clock_agree(CLOCK_BOOTTIME, "boottime", 0) == 0 &&
+        test_clock_agree(CLOCK_MONOTONIC_RAW, "monotonic_raw", 0) == 0)
+        print_pass("vdso: clocks agree with syscall");
+    else { print_failed("vdso: clocks agree with syscall"); fails++; }
+
+    print_run("vdso: monotonic never goes backwards");
+    if (test_monotonic() == 0) print_pass("vdso: monotonic never goes backwards");
+    else { print_failed("vdso: monotonic never goes backwards"); fails++; }
+
+    print_run("vdso: coarse clocks and time()");
+    if (test_coarse() == 0) print_pass("vdso: coarse clocks and time()");
+    else { print_failed("vdso: coarse clocks and time()"); fails++; }
+
+    print_run("vdso: getcpu");
+    if (test_getcpu() == 0) print_pass("vdso: getcpu");
+    else { print_failed("vdso: getcpu"); fails++; }
+
+    print_run("vdso: clock_gettime overhead");
+    if (test_overhead() == 0) print_pass("vdso: clock_gettime overhead");
+    else { print_failed("vdso: clock_gettime overhead"); fails++; }
+
+    return fails == 0 ? 0 : 1;
+}
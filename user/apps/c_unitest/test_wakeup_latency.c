@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 唤醒延迟基准测试
+ *
+ * N对线程通过pipe或futex互相唤醒（ping-pong），每一轮往返包含两次睡眠和两次唤醒，
+ * 唤醒路径上的选核开销和被唤醒任务放到哪个cpu直接体现在往返延迟上。
+ * 报告每种方式的平均往返延迟、p50/p99以及每秒往返次数，并检查传递的数据没有错乱。
+ *
+ * 环境变量：
+ *   WAKEUP_PAIRS   线程对数，默认为在线cpu数的一半（至少1对）
+ *   WAKEUP_SECONDS 每种方式的运行时间，默认1秒
+ */
+
+#define MAX_PAIRS 64
+#define MAX_SAMPLES 4096
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+enum mode { MODE_PIPE, MODE_FUTEX };
+
+struct pair {
+    enum mode mode;
+    pthread_t ping_tid;
+    pthread_t pong_tid;
+    /* pipe模式：ping写to_pong[1]，pong写to_ping[1] */
+    int to_pong[2];
+    int to_ping[2];
+    /* futex模式：奇数表示轮到pong，偶数表示轮到ping */
+    atomic_uint turn;
+    long rounds;
+    int errors;
+    int nr_samples;
+    int64_t samples[MAX_SAMPLES];
+};
+
+static atomic_int g_stop;
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int env_int(const char *name, int def) {
+    const char *env = getenv(name);
+    if (env && atoi(env) > 0) {
+        return atoi(env);
+    }
+    return def;
+}
+
+static long futex_wait(atomic_uint *addr, unsigned int val) {
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static long futex_wake(atomic_uint *addr, int nr) {
+    return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, nr, NULL, NULL, 0);
+}
+
+/* 等到turn变成want，stop之后返回-1 */
+static int futex_wait_turn(atomic_uint *turn, unsigned int want) {
+    for (;;) {
+        unsigned int cur = atomic_load(turn);
+        if (cur == want) {
+            return 0;
+        }
+        if (atomic_load(&g_stop)) {
+            return -1;
+        }
+        futex_wait(turn, cur);
+    }
+}
+
+static void *pong_main(void *arg) {
+    struct pair *p = arg;
+    if (p->mode == MODE_PIPE) {
+        uint64_t v;
+        while (read(p->to_pong[0], &v, sizeof(v)) == (ssize_t)sizeof(v)) {
+            if (v == UINT64_MAX) {
+                break;
+            }
+            v++;
+            if (write(p->to_ping[1], &v, sizeof(v)) != (ssize_t)sizeof(v)) {
+                p->errors++;
+                break;
+            }
+        }
+        return NULL;
+    }
+
+    for (unsigned int next = 1;; next += 2) {
+        if (futex_wait_turn(&p->turn, next) != 0) {
+            break;
+        }
+        atomic_store(&p->turn, next + 1);
+        futex_wake(&p->turn, 1);
+    }
+    return NULL;
+}
+
+static void *ping_main(void *arg) {
+    struct pair *p = arg;
+    uint64_t expect = 0;
+    unsigned int turn = 0;
+
+    while (!atomic_load(&g_stop)) {
+        int64_t start = monotonic_ns();
+        if (p->mode == MODE_PIPE) {
+            uint64_t v = expect;
+            if (write(p->to_pong[1], &v, sizeof(v)) != (ssize_t)sizeof(v) ||
+                read(p->to_ping[0], &v, sizeof(v)) != (ssize_t)sizeof(v) ||
+                v != expect + 1) {
+                p->errors++;
+                break;
+            }
+            expect = v + 1;
+        } else {
+            atomic_store(&p->turn, turn + 1);
+            futex_wake(&p->turn, 1);
+            if (futex_wait_turn(&p->turn, turn + 2) != 0) {
+                break;
+            }
+            turn += 2;
+        }
+        int64_t rtt = monotonic_ns() - start;
+
+        /* 蓄水池采样，保留MAX_SAMPLES个往返延迟用于计算分位数 */
+        if (p->nr_samples < MAX_SAMPLES) {
+            p->samples[p->nr_samples++] = rtt;
+        } else {
+            long j = random() % (p->rounds + 1);
+            if (j < MAX_SAMPLES) {
+                p->samples[j] = rtt;
+            }
+        }
+        p->rounds++;
+    }
+
+    if (p->mode == MODE_PIPE) {
+        uint64_t v = UINT64_MAX;
+        if (write(p->to_pong[1], &v, sizeof(v)) != (ssize_t)sizeof(v)) {
+            p->errors++;
+        }
+    }
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_mode(enum mode mode, int nr_pairs, int seconds) {
+    const char *name = mode == MODE_PIPE ? "pipe" : "futex";
+    struct pair *pairs = calloc((size_t)nr_pairs, sizeof(*pairs));
+    int setup_ok = pairs != NULL;
+
+    atomic_store(&g_stop, 0);
+    for (int i = 0; setup_ok && i < nr_pairs; i++) {
+        struct pair *p = &pairs[i];
+        p->mode = mode;
+        if (mode == MODE_PIPE &&
+            (pipe(p->to_pong) != 0 || pipe(p->to_ping) != 0)) {
+            setup_ok = 0;
+            break;
+        }
+        if (pthread_create(&p->pong_tid, NULL, pong_main, p) != 0 ||
+            pthread_create(&p->ping_tid, NULL, ping_main, p) != 0) {
+            setup_ok = 0;
+            break;
+        }
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: start %d ping-pong pairs", name, nr_pairs);
+    CHECK(setup_ok, msg);
+    if (!setup_ok) {
+        exit(1);
+    }
+
+    int64_t t0 = monotonic_ns();
+    sleep((unsigned int)seconds);
+    atomic_store(&g_stop, 1);
+    for (int i = 0; mode == MODE_FUTEX && i < nr_pairs; i++) {
+        /* 改变futex的值，使正准备睡眠的一方也能返回并看到g_stop */
+        atomic_fetch_add(&pairs[i].turn, 1u << 30);
+        futex_wake(&pairs[i].turn, 2);
+    }
+    for (int i = 0; i < nr_pairs; i++) {
+        pthread_join(pairs[i].ping_tid, NULL);
+        pthread_join(pairs[i].pong_tid, NULL);
+    }
+    double elapsed = (double)(monotonic_ns() - t0) / 1e9;
+
+    long rounds = 0;
+    int errors = 0;
+    int nr_samples = 0;
+    for (int i = 0; i < nr_pairs; i++) {
+        rounds += pairs[i].rounds;
+        errors += pairs[i].errors;
+        nr_samples += pairs[i].nr_samples;
+    }
+
+    int64_t *all = malloc(sizeof(int64_t) * (size_t)(nr_samples > 0 ? nr_samples : 1));
+    int64_t sum = 0;
+    int k = 0;
+    for (int i = 0; i < nr_pairs; i++) {
+        for (int j = 0; j < pairs[i].nr_samples; j++) {
+            all[k++] = pairs[i].samples[j];
+            sum += pairs[i].samples[j];
+        }
+    }
+    qsort(all, (size_t)nr_samples, sizeof(int64_t), cmp_i64);
+    if (nr_samples > 0) {
+        printf("%s: %d pairs, %.0f round trips/s, rtt avg %.2f us p50 %.2f us p99 %.2f us\n",
+               name, nr_pairs, (double)rounds / elapsed,
+               (double)sum / nr_samples / 1000.0,
+               (double)all[nr_samples / 2] / 1000.0,
+               (double)all[(int)((long)nr_samples * 99 / 100)] / 1000.0);
+    }
+    free(all);
+
+    snprintf(msg, sizeof(msg), "%s: every pair completed round trips", name);
+    int all_progress = 1;
+    for (int i = 0; i < nr_pairs; i++) {
+        all_progress &= pairs[i].rounds > 0;
+    }
+    CHECK(all_progress, msg);
+    snprintf(msg, sizeof(msg), "%s: no lost or corrupted wakeups", name);
+    CHECK(errors == 0, msg);
+
+    for (int i = 0; mode == MODE_PIPE && i < nr_pairs; i++) {
+        close(pairs[i].to_pong[0]);
+        close(pairs[i].to_pong[1]);
+        close(pairs[i].to_ping[0]);
+        close(pairs[i].to_ping[1]);
+    }
+    free(pairs);
+}
+
+int main(void) {
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int nr_pairs = env_int("WAKEUP_PAIRS", ncpu / 2 > 0 ? ncpu / 2 : 1);
+    if (nr_pairs > MAX_PAIRS) {
+        nr_pairs = MAX_PAIRS;
+    }
+    int seconds = env_int("WAKEUP_SECONDS", 1);
+
+    printf("wakeup latency: %d CPUs online\n", ncpu);
+    run_mode(MODE_PIPE, nr_pairs, seconds);
+    run_mode(MODE_FUTEX, nr_pairs, seconds);
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}
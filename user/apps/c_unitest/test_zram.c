@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * zram 压缩内存块设备测试
+ *
+ * 通过 sysfs 设置 zram0 的大小，向 /dev/zram0 写入全0页、重复填充页、
+ * 可压缩的文本页和不可压缩的随机页，读回校验，并检查 mm_stat / io_stat /
+ * perf_stat 中的统计，最后 reset 设备。
+ */
+
+#define ZRAM_SYSFS "/sys/devices/virtual/block/zram0"
+#define ZRAM_DEV "/dev/zram0"
+#define DISKSIZE (4 * 1024 * 1024)
+#define PAGE 4096
+
+static int g_total = 0;
+static int g_failed = 0;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        g_total++;                                                             \
+        if (!(cond)) {                                                         \
+            g_failed++;                                                        \
+            fprintf(stderr, "FAIL: %s (line %d, errno=%d)\n", msg, __LINE__,   \
+                    errno);                                                    \
+        } else {                                                               \
+            printf("PASS: %s\n", msg);                                         \
+        }                                                                      \
+    } while (0)
+
+static int write_attr(const char *name, const char *val) {
+    char path[256];
+    snprintf(path, sizeof(path), ZRAM_SYSFS "/%s", name);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = write(fd, val, strlen(val));
+    close(fd);
+    return n == (ssize_t)strlen(val) ? 0 : -1;
+}
+
+static int read_attr(const char *name, char *buf, size_t len) {
+    char path[256];
+    snprintf(path, sizeof(path), ZRAM_SYSFS "/%s", name);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/* 读取 mm_stat / io_stat 中的第 idx 个字段 */
+static long long stat_field(const char *name, int idx) {
+    char buf[512];
+    if (read_attr(name, buf, sizeof(buf)) != 0) {
+        return -1;
+    }
+    char *p = buf;
+    for (int i = 0; i <= idx; i++) {
+        char *end;
+        long long v = strtoll(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        if (i == idx) {
+            return v;
+        }
+        p = end;
+    }
+    return -1;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+enum { PAGE_ZERO, PAGE_SAME, PAGE_TEXT, PAGE_RANDOM, NR_KINDS };
+
+static void fill_page(char *page, int kind, int idx) {
+    switch (kind) {
+    case PAGE_ZERO:
+        memset(page, 0, PAGE);
+        break;
+    case PAGE_SAME:
+        for (int i = 0; i < PAGE / 8; i++) {
+            ((uint64_t *)page)[i] = 0xdeadbeef00000000ULL | (uint64_t)idx;
+        }
+        break;
+    case PAGE_TEXT:
+        for (int i = 0; i < PAGE; i++) {
+            page[i] = "zram compresses pages with lz4 "[(i + idx) % 31];
+        }
+        break;
+    default:
+        for (int i = 0; i < PAGE / 8; i++) {
+            ((uint64_t *)page)[i] = rng();
+        }
+        break;
+    }
+}
+
+static void test_io(int fd) {
+    const int pages = 64;
+    char *buf = malloc((size_t)pages * PAGE);
+    char *back = malloc((size_t)pages * PAGE);
+    if (!buf || !back) {
+        CHECK(0, "allocate buffers");
+        free(buf);
+        free(back);
+        return;
+    }
+
+    for (int i = 0; i < pages; i++) {
+        fill_page(buf + (size_t)i * PAGE, i % NR_KINDS, i);
+    }
+    CHECK(pwrite(fd, buf, (size_t)pages * PAGE, 0) == (ssize_t)pages * PAGE,
+          "write mixed pages");
+    fsync(fd);
+
+    memset(back, 0xaa, (size_t)pages * PAGE);
+    CHECK(pread(fd, back, (size_t)pages * PAGE, 0) == (ssize_t)pages * PAGE,
+          "read mixed pages back");
+    CHECK(memcmp(buf, back, (size_t)pages * PAGE) == 0,
+          "data intact after compression");
+
+    /* 跨页的部分写 */
+    char patch[1000];
+    memset(patch, 'x', sizeof(patch));
+    off_t off = 3 * PAGE + 3600;
+    CHECK(pwrite(fd, patch, sizeof(patch), off) == (ssize_t)sizeof(patch),
+          "unaligned write across a page boundary");
+    memcpy(buf + off, patch, sizeof(patch));
+    CHECK(pread(fd, back, 2 * PAGE, 3 * PAGE) == 2 * PAGE &&
+              memcmp(back, buf + 3 * PAGE, 2 * PAGE) == 0,
+          "unaligned write preserves surrounding data");
+
+    long long orig = stat_field("mm_stat", 0);
+    long long compr = stat_field("mm_stat", 1);
+    long long same = stat_field("mm_stat", 5);
+    long long huge = stat_field("mm_stat", 7);
+    printf("mm_stat: orig=%lld compr=%lld same=%lld huge=%lld\n", orig, compr,
+           same, huge);
+    CHECK(orig == (long long)pages * PAGE, "orig_data_size counts all pages");
+    CHECK(same >= pages / NR_KINDS, "zero and same-filled pages detected");
+    CHECK(huge >= pages / NR_KINDS - 1, "random pages stored as huge pages");
+    CHECK(compr > 0 && compr < orig, "compressed size below original size");
+    CHECK(stat_field("io_stat", 0) == 0 && stat_field("io_stat", 1) == 0,
+          "no failed reads or writes");
+
+    char perf[512];
+    CHECK(read_attr("perf_stat", perf, sizeof(perf)) == 0 &&
+              strstr(perf, "compr_ratio") != NULL,
+          "perf_stat reports compression ratio");
+    printf("%s", perf);
+
+    free(buf);
+    free(back);
+}
+
+int main(void) {
+    char buf[128];
+    if (read_attr("disksize", buf, sizeof(buf)) != 0) {
+        printf("SKIP: zram not available\n");
+        return 0;
+    }
+    CHECK(read_attr("comp_algorithm", buf, sizeof(buf)) == 0 &&
+              strstr(buf, "[lz4]") != NULL,
+          "comp_algorithm shows lz4");
+
+    /* 设备可能残留上一次测试的配置 */
+    write_attr("reset", "1");
+    CHECK(write_attr("disksize", "4M") == 0, "set disksize");
+    CHECK(read_attr("disksize", buf, sizeof(buf)) == 0 &&
+              strtoll(buf, NULL, 10) == DISKSIZE,
+          "disksize reads back");
+    errno = 0;
+    CHECK(write_attr("disksize", "8M") != 0,
+          "changing disksize of an initialized device fails");
+
+    int fd = open(ZRAM_DEV, O_RDWR);
+    CHECK(fd >= 0, "open /dev/zram0");
+    if (fd >= 0) {
+        test_io(fd);
+        errno = 0;
+        char page[PAGE] = {0};
+        CHECK(pwrite(fd, page, PAGE, DISKSIZE) != PAGE,
+              "write past the end of the device fails");
+        close(fd);
+    }
+
+    CHECK(write_attr("reset", "1") == 0, "reset device");
+    CHECK(read_attr("disksize", buf, sizeof(buf)) == 0 &&
+              strtoll(buf, NULL, 10) == 0,
+          "disksize is zero after reset");
+    CHECK(access(ZRAM_DEV, F_OK) != 0, "/dev/zram0 removed after reset");
+
+    printf("Summary: %d/%d passed\n", g_total - g_failed, g_total);
+    return g_failed == 0 ? 0 : 1;
+}